@@ -6,6 +6,8 @@
 
 class CrHash;
 
+class CrMappedFileStream;
+
 using CrFixedPath = crstl::fixed_path512;
 
 namespace cr { namespace Platform { enum T : uint32_t; } }
\ No newline at end of file
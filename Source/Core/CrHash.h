@@ -7,12 +7,33 @@ warnings_off
 #include <xxhash.h>
 warnings_on
 
+#include <string.h>
+
+// Hashes are stored in caches on disk, so changing how they're computed invalidates those caches. Define CR_HASH_XXH64
+// to 1 to hash everything with XXH64 as before and keep existing caches valid
+#if !defined(CR_HASH_XXH64)
+#define CR_HASH_XXH64 0
+#endif
+
+namespace CrHashVersion
+{
+	enum T : uint32_t
+	{
+		XXH64,           // XXH64 for every size, and hashes combined by hashing them again
+		SizeSpecialized, // Mixing functions for keys of up to 16 bytes, XXH3 for anything larger
+		SizeSeeded,      // The size of small keys is part of the seed, and no key hashes to 0
+		CurrentVersion = CR_HASH_XXH64 ? XXH64 : SizeSeeded
+	};
+};
+
 class CrHash
 {
 public:
 
 	static const uint64_t HashSeed = 100;
 
+	static const CrHashVersion::T Version = CrHashVersion::CurrentVersion;
+
 	CrHash() : m_hash(0) {}
 
 	explicit CrHash(uint64_t hash) : m_hash(hash) {}
@@ -30,7 +51,7 @@ public:
 	template<typename T>
 	CrHash(const T& data)
 	{
-		m_hash = ComputeHash<T>(&data, sizeof(T));
+		m_hash = ComputeHash<T>(&data);
 	}
 
 	template<typename T>
@@ -47,8 +68,7 @@ public:
 	// Streaming operator, incrementally adds hash by combining existing hash with incoming hash
 	CrHash& operator << (CrHash other)
 	{
-		uint64_t hashes[2] = { m_hash, other.m_hash };
-		m_hash = ComputeHash(hashes, sizeof(hashes));
+		m_hash = Combine(m_hash, other.m_hash);
 		return *this;
 	}
 
@@ -62,22 +82,120 @@ public:
 		return m_hash != other.m_hash;
 	}
 
-	// TODO Select hash function at compile time based on the size of datatype.
+	// The hash function is picked by size, at compile time when the size is that of the type. Keys of up to 16 bytes,
+	// like handles and small descriptors, only need a mixing function. XXH3 is faster than XXH64 for anything larger,
+	// especially short inputs. Both versions give the same result for the same bytes. A hash of 0 means no hash, so
+	// no key hashes to it
 	// http://aras-p.info/blog/2016/08/09/More-Hash-Function-Tests/
 	template<typename T>
 	static uint64_t ComputeHash(const T* data)
 	{
+#if CR_HASH_XXH64
 		return XXH64(data, sizeof(T), HashSeed);
+#else
+		if constexpr (sizeof(T) < 8)
+		{
+			return HashSmall(data, sizeof(T));
+		}
+		else if constexpr (sizeof(T) == 8)
+		{
+			return Hash8(data);
+		}
+		else if constexpr (sizeof(T) == 16)
+		{
+			return Hash16(data);
+		}
+		else
+		{
+			return NonZero(XXH3_64bits_withSeed(data, sizeof(T), HashSeed));
+		}
+#endif
 	}
 
 	template<typename T>
 	static uint64_t ComputeHash(const T* data, uint64_t dataSize)
 	{
+#if CR_HASH_XXH64
 		return XXH64(data, dataSize, HashSeed);
+#else
+		if (dataSize < 8)
+		{
+			return HashSmall(data, dataSize);
+		}
+		else if (dataSize == 8)
+		{
+			return Hash8(data);
+		}
+		else if (dataSize == 16)
+		{
+			return Hash16(data);
+		}
+		else
+		{
+			return NonZero(XXH3_64bits_withSeed(data, (size_t)dataSize, HashSeed));
+		}
+#endif
+	}
+
+	// Order matters, Combine(a, b) and Combine(b, a) are different hashes
+	static uint64_t Combine(uint64_t first, uint64_t second)
+	{
+#if CR_HASH_XXH64
+		uint64_t hashes[2] = { first, second };
+		return XXH64(hashes, sizeof(hashes), HashSeed);
+#else
+		return NonZero(Mix(first ^ Mix(second ^ HashSeed)));
+#endif
 	}
 
 private:
 
+	// Finalizer of MurmurHash3. Every bit of the input affects every bit of the output, and it's a bijection, so
+	// different keys of up to 8 bytes never collide. Being a bijection, it also maps one key to 0
+	static constexpr uint64_t Mix(uint64_t value)
+	{
+		value ^= value >> 33;
+		value *= 0xff51afd7ed558ccdull;
+		value ^= value >> 33;
+		value *= 0xc4ceb9fe1a85ec53ull;
+		value ^= value >> 33;
+		return value;
+	}
+
+	// The key that would hash to 0 takes a hash of its own instead, which it shares with another key
+	static constexpr uint64_t NonZero(uint64_t hash)
+	{
+		return hash != 0 ? hash : 0x9e3779b97f4a7c15ull;
+	}
+
+	// Seeding the mix with the size means that keys with the same bytes but a different size, like 0 as a uint32_t
+	// and as a uint64_t, hash differently. Keys of different sizes can still collide, like with any other hash
+	static constexpr uint64_t SizeSeed(uint64_t dataSize)
+	{
+		return Mix(HashSeed ^ (dataSize << 56));
+	}
+
+	static uint64_t HashSmall(const void* data, uint64_t dataSize)
+	{
+		uint64_t value = 0;
+		memcpy(&value, data, (size_t)dataSize);
+		return NonZero(Mix(value ^ SizeSeed(dataSize)));
+	}
+
+	static uint64_t Hash8(const void* data)
+	{
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		return NonZero(Mix(value ^ SizeSeed(8)));
+	}
+
+	static uint64_t Hash16(const void* data)
+	{
+		uint64_t values[2];
+		memcpy(values, data, sizeof(values));
+		return NonZero(Mix(values[0] ^ Mix(values[1] ^ SizeSeed(16))));
+	}
+
 	// Don't hash pointers directly
 	template<typename T> CrHash(const T* data);
 	template<typename T> CrHash(T* data);
@@ -88,8 +206,7 @@ private:
 // Combine two hashes and return the hash of both
 inline CrHash operator + (CrHash first, CrHash second)
 {
-	uint64_t hashes[2] = { first.GetHash(), second.GetHash() };
-	return CrHash(hashes, sizeof(hashes));
+	return CrHash(CrHash::Combine(first.GetHash(), second.GetHash()));
 }
 
 namespace crstl
@@ -0,0 +1,416 @@
+#include "Core/CrCore_pch.h"
+
+#include "Core/CrCommandLine.h"
+#include "Core/CrHash.h"
+
+#include "crstl/sort.h"
+#include "crstl/timer.h"
+#include "crstl/vector.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Hashes are compared against XXH64 with the seed CrHash used for everything before it picked a function by size
+static uint64_t HashXXH64(const void* data, uint64_t dataSize)
+{
+	return XXH64(data, (size_t)dataSize, CrHash::HashSeed);
+}
+
+static uint64_t HashCrHash(const void* data, uint64_t dataSize)
+{
+	return CrHash::ComputeHash((const uint8_t*)data, dataSize);
+}
+
+typedef uint64_t (*HashFunction)(const void* data, uint64_t dataSize);
+
+// Deterministic keys, so that every run tests the same ones
+static uint64_t SplitMix64(uint64_t& state)
+{
+	uint64_t value = (state += 0x9e3779b97f4a7c15ull);
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+	return value ^ (value >> 31);
+}
+
+static uint32_t CountCollisions(crstl::vector<uint64_t>& hashes)
+{
+	crstl::sort(hashes.begin(), hashes.end());
+
+	uint32_t collisionCount = 0;
+
+	for (size_t i = 1; i < hashes.size(); ++i)
+	{
+		collisionCount += hashes[i] == hashes[i - 1] ? 1 : 0;
+	}
+
+	return collisionCount;
+}
+
+static uint32_t CountZeroes(const crstl::vector<uint64_t>& hashes)
+{
+	uint32_t zeroCount = 0;
+
+	for (uint64_t hash : hashes)
+	{
+		zeroCount += hash == 0 ? 1 : 0;
+	}
+
+	return zeroCount;
+}
+
+// Calls addKey(hashFunction, hashes) to fill in the hashes of every key in the set, and reports collisions and zero
+// hashes for both functions. Any collision in 64 bits among a few million keys means the function is broken for them
+template<typename AddKeysFunctionT>
+static bool TestCollisions(const char* keySetName, const AddKeysFunctionT& addKeys)
+{
+	crstl::vector<uint64_t> hashes;
+
+	addKeys(HashXXH64, hashes);
+	uint32_t keyCount = (uint32_t)hashes.size();
+	uint32_t xxh64ZeroCount = CountZeroes(hashes);
+	uint32_t xxh64CollisionCount = CountCollisions(hashes);
+
+	hashes.clear();
+
+	addKeys(HashCrHash, hashes);
+	uint32_t zeroCount = CountZeroes(hashes);
+	uint32_t collisionCount = CountCollisions(hashes);
+
+	bool passed = zeroCount == 0 && collisionCount == 0;
+
+	printf("  %-32s %9u keys, %u collisions, %u zero hashes (XXH64 %u, %u)%s\n",
+		keySetName, keyCount, collisionCount, zeroCount, xxh64CollisionCount, xxh64ZeroCount, passed ? "" : " FAILED");
+
+	return passed;
+}
+
+static bool TestCollisions(uint32_t keyCount)
+{
+	printf("Collisions\n");
+
+	bool passed = true;
+
+	passed &= TestCollisions("Sequential uint32_t", [keyCount](HashFunction hashFunction, crstl::vector<uint64_t>& hashes)
+	{
+		for (uint32_t i = 0; i < keyCount; ++i)
+		{
+			hashes.push_back(hashFunction(&i, sizeof(i)));
+		}
+	});
+
+	passed &= TestCollisions("Sequential uint64_t", [keyCount](HashFunction hashFunction, crstl::vector<uint64_t>& hashes)
+	{
+		for (uint64_t i = 0; i < keyCount; ++i)
+		{
+			hashes.push_back(hashFunction(&i, sizeof(i)));
+		}
+	});
+
+	// Only the top bits change, like handles with a generation in them
+	passed &= TestCollisions("uint64_t high bits", [keyCount](HashFunction hashFunction, crstl::vector<uint64_t>& hashes)
+	{
+		for (uint64_t i = 0; i < keyCount; ++i)
+		{
+			uint64_t key = i << 40;
+			hashes.push_back(hashFunction(&key, sizeof(key)));
+		}
+	});
+
+	// The same values as uint32_t and uint64_t. Keys of different sizes can collide, but shouldn't for these
+	passed &= TestCollisions("uint32_t and uint64_t", [keyCount](HashFunction hashFunction, crstl::vector<uint64_t>& hashes)
+	{
+		for (uint32_t i = 0; i < keyCount / 2; ++i)
+		{
+			uint64_t key = i;
+			hashes.push_back(hashFunction(&i, sizeof(i)));
+			hashes.push_back(hashFunction(&key, sizeof(key)));
+		}
+	});
+
+	// Descriptors where one member changes at a time
+	passed &= TestCollisions("16 byte keys", [keyCount](HashFunction hashFunction, crstl::vector<uint64_t>& hashes)
+	{
+		for (uint64_t i = 0; i < keyCount / 3; ++i)
+		{
+			uint64_t keys[3][2] = { { i, 0 }, { 0, i + 1 }, { i + 1, i + 1 } };
+			hashes.push_back(hashFunction(keys[0], sizeof(keys[0])));
+			hashes.push_back(hashFunction(keys[1], sizeof(keys[1])));
+			hashes.push_back(hashFunction(keys[2], sizeof(keys[2])));
+		}
+	});
+
+	passed &= TestCollisions("Strings", [keyCount](HashFunction hashFunction, crstl::vector<uint64_t>& hashes)
+	{
+		char key[64];
+
+		for (uint32_t i = 0; i < keyCount; ++i)
+		{
+			int keyLength = snprintf(key, sizeof(key), "Shaders/Material_%u.hlsl", i);
+			hashes.push_back(hashFunction(key, (uint64_t)keyLength));
+		}
+	});
+
+	// Keys made of zeroes, ones and the seed at every size a mixing function handles, and a few more
+	passed &= TestCollisions("Special values", [](HashFunction hashFunction, crstl::vector<uint64_t>& hashes)
+	{
+		const uint64_t specialValues[] = { 0, ~0ull, CrHash::HashSeed };
+
+		for (uint64_t specialValue : specialValues)
+		{
+			uint64_t key[8] = { specialValue, specialValue, specialValue, specialValue, specialValue, specialValue, specialValue, specialValue };
+
+			for (uint64_t keySize = 1; keySize <= sizeof(key); ++keySize)
+			{
+				hashes.push_back(hashFunction(key, keySize));
+			}
+		}
+
+		// Empty keys have no value
+		hashes.push_back(hashFunction(specialValues, 0));
+	});
+
+	bool combinePassed = true;
+
+	{
+		crstl::vector<uint64_t> hashes;
+
+		for (uint64_t i = 0; i < keyCount / 2; ++i)
+		{
+			hashes.push_back(CrHash::Combine(i, 0));
+			hashes.push_back(CrHash::Combine(0, i + 1));
+		}
+
+		uint32_t zeroCount = CountZeroes(hashes);
+		uint32_t collisionCount = CountCollisions(hashes);
+
+		combinePassed = zeroCount == 0 && collisionCount == 0;
+
+		printf("  %-32s %9u keys, %u collisions, %u zero hashes%s\n",
+			"Combine", (uint32_t)hashes.size(), collisionCount, zeroCount, combinePassed ? "" : " FAILED");
+	}
+
+	return passed && combinePassed;
+}
+
+// Flips every bit of random keys and counts how often each bit of the hash changes. A good hash changes every bit half
+// of the time, whichever input bit was flipped. Returns the worst deviation from that over all pairs of bits
+static double MeasureAvalanche(HashFunction hashFunction, uint32_t keySize, uint32_t sampleCount, double& averageFlipProbability)
+{
+	const uint32_t inputBitCount = keySize * 8;
+
+	crstl::vector<uint32_t> flipCounts;
+	flipCounts.resize(inputBitCount * 64);
+
+	for (uint32_t& flipCount : flipCounts)
+	{
+		flipCount = 0;
+	}
+
+	uint64_t randomState = keySize;
+
+	uint8_t key[64];
+
+	for (uint32_t sample = 0; sample < sampleCount; ++sample)
+	{
+		for (uint32_t i = 0; i < keySize; ++i)
+		{
+			key[i] = (uint8_t)SplitMix64(randomState);
+		}
+
+		uint64_t hash = hashFunction(key, keySize);
+
+		for (uint32_t inputBit = 0; inputBit < inputBitCount; ++inputBit)
+		{
+			key[inputBit / 8] ^= (uint8_t)(1u << (inputBit % 8));
+			uint64_t flippedBits = hash ^ hashFunction(key, keySize);
+			key[inputBit / 8] ^= (uint8_t)(1u << (inputBit % 8));
+
+			for (uint32_t outputBit = 0; outputBit < 64; ++outputBit)
+			{
+				flipCounts[inputBit * 64 + outputBit] += (uint32_t)((flippedBits >> outputBit) & 1);
+			}
+		}
+	}
+
+	double worstBias = 0.0;
+	double flipProbabilitySum = 0.0;
+
+	for (uint32_t flipCount : flipCounts)
+	{
+		double flipProbability = (double)flipCount / sampleCount;
+		double bias = flipProbability > 0.5 ? flipProbability - 0.5 : 0.5 - flipProbability;
+		worstBias = bias > worstBias ? bias : worstBias;
+		flipProbabilitySum += flipProbability;
+	}
+
+	averageFlipProbability = flipProbabilitySum / flipCounts.size();
+
+	return worstBias;
+}
+
+static bool TestAvalanche(uint32_t sampleCount)
+{
+	printf("Avalanche (probability of an output bit flipping, ideally 0.5)\n");
+
+	const uint32_t keySizes[] = { 1, 4, 7, 8, 12, 16, 24, 32, 64 };
+
+	bool passed = true;
+
+	for (uint32_t keySize : keySizes)
+	{
+		double averageFlipProbability = 0.0;
+		double worstBias = MeasureAvalanche(HashCrHash, keySize, sampleCount, averageFlipProbability);
+
+		double xxh64AverageFlipProbability = 0.0;
+		double xxh64WorstBias = MeasureAvalanche(HashXXH64, keySize, sampleCount, xxh64AverageFlipProbability);
+
+		// Sampling noise alone makes the worst of thousands of pairs of bits stray a few standard deviations from 0.5,
+		// where a standard deviation is 0.5 / sqrt(samples). Anything well beyond that is a bias in the function. Keys
+		// of a single byte only have as many different samples as values
+		double distinctSampleCount = keySize == 1 && sampleCount > 256 ? 256.0 : (double)sampleCount;
+		double maximumBias = 8.0 * 0.5 / sqrt(distinctSampleCount);
+
+		bool keySizePassed = worstBias < maximumBias;
+		passed &= keySizePassed;
+
+		printf("  %2u bytes: average %.4f, worst bias %.4f (XXH64 %.4f, %.4f)%s\n",
+			keySize, averageFlipProbability, worstBias, xxh64AverageFlipProbability, xxh64WorstBias, keySizePassed ? "" : " FAILED");
+	}
+
+	return passed;
+}
+
+// Hashes keys at different offsets of a buffer that fits in cache, so that we measure the function and not memory
+static double MeasureHashTime(HashFunction hashFunction, const crstl::vector<uint8_t>& buffer, uint64_t keySize, uint32_t hashCount, uint64_t& sink)
+{
+	uint64_t offsetRange = buffer.size() - keySize;
+
+	crstl::timer hashTime;
+
+	for (uint32_t i = 0; i < hashCount; ++i)
+	{
+		sink ^= hashFunction(buffer.data() + ((i * 64ull) % offsetRange), keySize);
+	}
+
+	return hashTime.elapsed().milliseconds() * 1e6 / hashCount;
+}
+
+template<typename KeyT>
+static double MeasureFixedSizeHashTime(uint32_t hashCount, uint64_t& sink)
+{
+	KeyT key = {};
+
+	crstl::timer hashTime;
+
+	for (uint32_t i = 0; i < hashCount; ++i)
+	{
+		// Make every key different so the hash can't be hoisted out of the loop
+		memcpy(&key, &i, sizeof(i));
+		sink ^= CrHash::ComputeHash(&key);
+	}
+
+	return hashTime.elapsed().milliseconds() * 1e6 / hashCount;
+}
+
+static void Benchmark(uint32_t hashCount)
+{
+	printf("Benchmark (ns per hash)\n");
+
+	crstl::vector<uint8_t> buffer;
+	buffer.resize(64 * 1024);
+
+	uint64_t randomState = 0;
+
+	for (uint8_t& value : buffer)
+	{
+		value = (uint8_t)SplitMix64(randomState);
+	}
+
+	uint64_t sink = 0;
+
+	const uint64_t keySizes[] = { 4, 8, 16, 24, 32, 64, 256, 1024, 4096 };
+
+	for (uint64_t keySize : keySizes)
+	{
+		// Fewer hashes of large keys so that every size takes about as long
+		uint32_t keyHashCount = (uint32_t)(hashCount / (1 + keySize / 64));
+
+		double crHashTime = MeasureHashTime(HashCrHash, buffer, keySize, keyHashCount, sink);
+		double xxh64Time = MeasureHashTime(HashXXH64, buffer, keySize, keyHashCount, sink);
+
+		printf("  %4llu bytes: CrHash %8.2f, XXH64 %8.2f (%.2fx)\n",
+			(unsigned long long)keySize, crHashTime, xxh64Time, crHashTime > 0.0 ? xxh64Time / crHashTime : 0.0);
+	}
+
+	// Sizes known at compile time skip the branches on the size
+	struct Key16 { uint64_t values[2]; };
+	struct Key32 { uint64_t values[4]; };
+
+	double uint32Time = MeasureFixedSizeHashTime<uint32_t>(hashCount, sink);
+	double uint64Time = MeasureFixedSizeHashTime<uint64_t>(hashCount, sink);
+	double key16Time = MeasureFixedSizeHashTime<Key16>(hashCount, sink);
+	double key32Time = MeasureFixedSizeHashTime<Key32>(hashCount, sink);
+
+	printf("  Typed keys: uint32_t %.2f, uint64_t %.2f, 16 bytes %.2f, 32 bytes %.2f\n", uint32Time, uint64Time, key16Time, key32Time);
+
+	{
+		crstl::timer combineTime;
+
+		for (uint32_t i = 0; i < hashCount; ++i)
+		{
+			sink = CrHash::Combine(sink, i);
+		}
+
+		double crHashCombineTime = combineTime.elapsed().milliseconds() * 1e6 / hashCount;
+
+		crstl::timer xxh64CombineTime;
+
+		for (uint32_t i = 0; i < hashCount; ++i)
+		{
+			uint64_t hashes[2] = { sink, i };
+			sink = XXH64(hashes, sizeof(hashes), CrHash::HashSeed);
+		}
+
+		double xxh64Time = xxh64CombineTime.elapsed().milliseconds() * 1e6 / hashCount;
+
+		printf("  Combine: CrHash %.2f, XXH64 of both hashes %.2f (%.2fx)\n", crHashCombineTime, xxh64Time, crHashCombineTime > 0.0 ? xxh64Time / crHashCombineTime : 0.0);
+	}
+
+	// Printing the result keeps the compiler from removing the loops
+	printf("  (%016llx)\n", (unsigned long long)sink);
+}
+
+// Checks CrHash for collisions, zero hashes and avalanche against XXH64, and measures both. Returns non-zero if any
+// of the checks fails, so that it can run as part of automated builds
+//
+// Usage:
+// -keys 1000000     : Keys in every collision test
+// -samples 4096     : Random keys per size in the avalanche test
+// -hashes 10000000  : Hashes per key size in the benchmark
+// -noBenchmark      : Only run the tests
+int main(int argc, char* argv[])
+{
+	CrCommandLineParser commandLine(argc, argv);
+
+	uint32_t keyCount = commandLine("-keys").empty() ? 1000000 : (uint32_t)atoi(commandLine("-keys").c_str());
+	uint32_t sampleCount = commandLine("-samples").empty() ? 4096 : (uint32_t)atoi(commandLine("-samples").c_str());
+	uint32_t hashCount = commandLine("-hashes").empty() ? 10000000 : (uint32_t)atoi(commandLine("-hashes").c_str());
+
+	printf("CrHash version %u\n", (uint32_t)CrHash::Version);
+
+	bool passed = true;
+
+	passed &= TestCollisions(keyCount);
+
+	passed &= TestAvalanche(sampleCount);
+
+	if (!commandLine["-noBenchmark"])
+	{
+		Benchmark(hashCount);
+	}
+
+	printf("%s\n", passed ? "Passed" : "Failed");
+
+	return passed ? 0 : 1;
+}
@@ -11,6 +11,9 @@ namespace cr
 			Count
 		};
 
+		// Platform the runtime is built for. Windows is the only target for now
+		constexpr Platform::T Current = Windows;
+
 		constexpr const char* ToString(Platform::T platform, bool lowercase = false)
 		{
 			switch (platform)
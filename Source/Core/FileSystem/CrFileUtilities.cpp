@@ -0,0 +1,68 @@
+#include "Core/CrCore_pch.h"
+
+#include "Core/FileSystem/CrFileUtilities.h"
+
+#include "crstl/filesystem.h"
+
+#include <atomic>
+#include <stdio.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace crcore
+{
+	CrFixedPath GetTemporaryFilePath(const CrFixedPath& filePath)
+	{
+		static std::atomic<uint32_t> TemporaryFileIndex(0);
+
+#if defined(_WIN32)
+		uint32_t processId = (uint32_t)GetCurrentProcessId();
+#else
+		uint32_t processId = (uint32_t)getpid();
+#endif
+
+		char temporarySuffix[64];
+		snprintf(temporarySuffix, sizeof(temporarySuffix), ".%u.%u.tmp", processId, TemporaryFileIndex++);
+
+		CrFixedPath temporaryFilePath = filePath;
+		temporaryFilePath += temporarySuffix;
+		return temporaryFilePath;
+	}
+
+	bool MoveFileOver(const CrFixedPath& sourceFilePath, const CrFixedPath& destinationFilePath)
+	{
+#if defined(_WIN32)
+		return MoveFileExA(sourceFilePath.c_str(), destinationFilePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		return rename(sourceFilePath.c_str(), destinationFilePath.c_str()) == 0;
+#endif
+	}
+
+	CrFixedPath GetAbsolutePath(const CrFixedPath& filePath)
+	{
+#if defined(_WIN32)
+		char absolutePath[MAX_PATH];
+		DWORD absolutePathLength = GetFullPathNameA(filePath.c_str(), MAX_PATH, absolutePath, nullptr);
+
+		if (absolutePathLength > 0 && absolutePathLength < MAX_PATH)
+		{
+			return CrFixedPath(absolutePath);
+		}
+
+		return filePath;
+#else
+		if (filePath.c_str()[0] == '/')
+		{
+			return filePath;
+		}
+
+		CrFixedPath absolutePath = crstl::current_directory_path().c_str();
+		absolutePath /= filePath.c_str();
+		return absolutePath;
+#endif
+	}
+}
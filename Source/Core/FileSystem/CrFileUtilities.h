@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Core/FileSystem/CrFixedPath.h"
+
+namespace crcore
+{
+	// Path next to the given one that no other thread or process writes to at the same time. Files are written
+	// there first and then moved over the real path with MoveFileOver
+	CrFixedPath GetTemporaryFilePath(const CrFixedPath& filePath);
+
+	// Moves the source file over the destination in a single step, so that anyone opening the destination
+	// finds either the old or the new file, never a partially written one. Both must be on the same volume
+	bool MoveFileOver(const CrFixedPath& sourceFilePath, const CrFixedPath& destinationFilePath);
+
+	// Resolves a relative path against the current working directory. Use it before handing a path to another
+	// process, which may have been started from a different directory
+	CrFixedPath GetAbsolutePath(const CrFixedPath& filePath);
+}
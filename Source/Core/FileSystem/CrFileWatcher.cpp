@@ -0,0 +1,257 @@
+#include "Core/CrCore_pch.h"
+
+#include "Core/FileSystem/CrFileWatcher.h"
+
+#include "crstl/filesystem.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#endif
+
+// Big enough to hold a few hundred notifications between polls
+static const uint32_t NotificationBufferSize = 64 * 1024;
+
+static void AddChangedFile(crstl::vector<crstl::string>& changedFiles, const crstl::string& filename)
+{
+	// Saving a file usually generates several notifications
+	for (const crstl::string& changedFile : changedFiles)
+	{
+		if (changedFile == filename)
+		{
+			return;
+		}
+	}
+
+	changedFiles.push_back(filename);
+}
+
+#if defined(_WIN32)
+
+static bool ReadDirectoryChanges(HANDLE directoryHandle, OVERLAPPED* overlapped, crstl::vector<uint8_t>& notificationBuffer)
+{
+	return ReadDirectoryChangesW(directoryHandle, notificationBuffer.data(), (DWORD)notificationBuffer.size(), FALSE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE, nullptr, overlapped, nullptr);
+}
+
+#endif
+
+CrFileWatcher::~CrFileWatcher()
+{
+	Close();
+}
+
+bool CrFileWatcher::Watch(const char* directory)
+{
+	Close();
+
+	m_directory = directory;
+	m_notificationBuffer.resize(NotificationBufferSize);
+
+#if defined(_WIN32)
+
+	crstl::wstring wDirectory;
+	wDirectory.append_convert(directory);
+
+	HANDLE directoryHandle = CreateFileW(wDirectory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+
+	if (directoryHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	OVERLAPPED* overlapped = new OVERLAPPED();
+	overlapped->hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+	if (overlapped->hEvent == nullptr || !ReadDirectoryChanges(directoryHandle, overlapped, m_notificationBuffer))
+	{
+		if (overlapped->hEvent)
+		{
+			CloseHandle(overlapped->hEvent);
+		}
+
+		delete overlapped;
+		CloseHandle(directoryHandle);
+		return false;
+	}
+
+	m_handle = (uintptr_t)directoryHandle;
+	m_watchHandle = (uintptr_t)overlapped;
+	return true;
+
+#elif defined(__linux__)
+
+	int inotifyHandle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (inotifyHandle < 0)
+	{
+		return false;
+	}
+
+	// Editors either write the file in place or write a temporary and rename it on top
+	int watchHandle = inotify_add_watch(inotifyHandle, directory, IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+
+	if (watchHandle < 0)
+	{
+		close(inotifyHandle);
+		return false;
+	}
+
+	m_handle = (uintptr_t)inotifyHandle;
+	m_watchHandle = (uintptr_t)watchHandle;
+	return true;
+
+#else
+
+	return false;
+
+#endif
+}
+
+void CrFileWatcher::Close()
+{
+	if (m_handle != InvalidHandle)
+	{
+#if defined(_WIN32)
+		OVERLAPPED* overlapped = (OVERLAPPED*)m_watchHandle;
+
+		// The pending read writes into our buffer, so it needs to be finished before we free anything
+		CancelIo((HANDLE)m_handle);
+		DWORD bytesTransferred = 0;
+		GetOverlappedResult((HANDLE)m_handle, overlapped, &bytesTransferred, TRUE);
+
+		CloseHandle(overlapped->hEvent);
+		delete overlapped;
+		CloseHandle((HANDLE)m_handle);
+#elif defined(__linux__)
+		inotify_rm_watch((int)m_handle, (int)m_watchHandle);
+		close((int)m_handle);
+#endif
+		m_handle = InvalidHandle;
+		m_watchHandle = InvalidHandle;
+	}
+}
+
+void CrFileWatcher::GetChangedFiles(crstl::vector<crstl::string>& changedFiles)
+{
+	if (m_handle == InvalidHandle)
+	{
+		return;
+	}
+
+#if defined(_WIN32)
+
+	OVERLAPPED* overlapped = (OVERLAPPED*)m_watchHandle;
+
+	while (true)
+	{
+		DWORD bytesTransferred = 0;
+
+		// Don't wait, if the read hasn't completed there is nothing to report
+		if (!GetOverlappedResult((HANDLE)m_handle, overlapped, &bytesTransferred, FALSE))
+		{
+			if (GetLastError() != ERROR_IO_INCOMPLETE)
+			{
+				Close();
+			}
+
+			return;
+		}
+
+		// No bytes means the buffer overflowed and the notifications were lost
+		if (bytesTransferred == 0)
+		{
+			AddAllFiles(changedFiles);
+		}
+		else
+		{
+			const uint8_t* notification = m_notificationBuffer.data();
+
+			while (true)
+			{
+				const FILE_NOTIFY_INFORMATION* notifyInformation = (const FILE_NOTIFY_INFORMATION*)notification;
+
+				int filenameLength = (int)(notifyInformation->FileNameLength / sizeof(WCHAR));
+				int utf8Length = WideCharToMultiByte(CP_UTF8, 0, notifyInformation->FileName, filenameLength, nullptr, 0, nullptr, nullptr);
+
+				crstl::string filename;
+				filename.resize(utf8Length);
+				WideCharToMultiByte(CP_UTF8, 0, notifyInformation->FileName, filenameLength, filename.data(), utf8Length, nullptr, nullptr);
+
+				AddChangedFile(changedFiles, filename);
+
+				if (notifyInformation->NextEntryOffset == 0)
+				{
+					break;
+				}
+
+				notification += notifyInformation->NextEntryOffset;
+			}
+		}
+
+		// Queue the next read before looking for more results, otherwise we'd miss changes in between
+		ResetEvent(overlapped->hEvent);
+
+		if (!ReadDirectoryChanges((HANDLE)m_handle, overlapped, m_notificationBuffer))
+		{
+			Close();
+			return;
+		}
+	}
+
+#elif defined(__linux__)
+
+	while (true)
+	{
+		ssize_t bytesRead = read((int)m_handle, m_notificationBuffer.data(), m_notificationBuffer.size());
+
+		// The descriptor is non-blocking, EAGAIN means there are no more events queued
+		if (bytesRead <= 0)
+		{
+			if (bytesRead < 0 && errno != EAGAIN && errno != EINTR)
+			{
+				Close();
+			}
+
+			return;
+		}
+
+		ssize_t offset = 0;
+
+		while (offset < bytesRead)
+		{
+			const inotify_event* event = (const inotify_event*)(m_notificationBuffer.data() + offset);
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				AddAllFiles(changedFiles);
+			}
+			else if (event->len > 0 && !(event->mask & IN_ISDIR))
+			{
+				AddChangedFile(changedFiles, crstl::string(event->name));
+			}
+
+			offset += sizeof(inotify_event) + event->len;
+		}
+	}
+
+#endif
+}
+
+void CrFileWatcher::AddAllFiles(crstl::vector<crstl::string>& changedFiles) const
+{
+	crstl::for_each_directory_entry(m_directory.c_str(), false, [&changedFiles](const crstl::directory_entry& entry)
+	{
+		if (!entry.is_directory)
+		{
+			AddChangedFile(changedFiles, crstl::string(entry.filename));
+		}
+
+		return true;
+	});
+}
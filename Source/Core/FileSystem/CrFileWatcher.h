@@ -0,0 +1,51 @@
+#pragma once
+
+#include "stdint.h"
+
+#include "crstl/string.h"
+#include "crstl/vector.h"
+
+// Reports files that are created, modified, renamed or deleted inside a directory. The OS queues
+// the changes as they happen and we collect them without blocking, so the watcher can be polled
+// every frame. It uses inotify on Linux and ReadDirectoryChangesW on Windows
+class CrFileWatcher
+{
+public:
+
+	CrFileWatcher() {}
+
+	~CrFileWatcher();
+
+	CrFileWatcher(const CrFileWatcher&) = delete;
+
+	CrFileWatcher& operator = (const CrFileWatcher&) = delete;
+
+	// Starts watching the files directly inside this directory, not its subdirectories. Returns
+	// false if the directory doesn't exist or the platform has no way of watching it
+	bool Watch(const char* directory);
+
+	void Close();
+
+	bool IsWatching() const { return m_handle != InvalidHandle; }
+
+	// Adds the filenames that changed since the last call, each only once. If the OS dropped
+	// notifications because too many changes happened at once, every file in the directory is added
+	void GetChangedFiles(crstl::vector<crstl::string>& changedFiles);
+
+private:
+
+	static const uintptr_t InvalidHandle = ~(uintptr_t)0;
+
+	void AddAllFiles(crstl::vector<crstl::string>& changedFiles) const;
+
+	crstl::string m_directory;
+
+	// Directory handle on Windows, inotify file descriptor elsewhere
+	uintptr_t m_handle = InvalidHandle;
+
+	// Overlapped structure of the pending directory read on Windows, watch descriptor elsewhere
+	uintptr_t m_watchHandle = InvalidHandle;
+
+	// The OS writes notifications here. On Windows it is filled asynchronously so it must outlive each call
+	crstl::vector<uint8_t> m_notificationBuffer;
+};
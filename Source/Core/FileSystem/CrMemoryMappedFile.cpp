@@ -0,0 +1,146 @@
+#include "Core/CrCore_pch.h"
+
+#include "Core/FileSystem/CrMemoryMappedFile.h"
+
+#include "crstl/string.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CrMemoryMappedFile::CrMemoryMappedFile(const char* filePath)
+{
+#if defined(_WIN32)
+
+	crstl::wstring wFilePath;
+	wFilePath.append_convert(filePath);
+
+	// Allow other handles to write to the file while it is mapped, so that append-only files can keep growing
+	HANDLE fileHandle = CreateFileW(wFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	LARGE_INTEGER fileSize;
+
+	// Empty files cannot be mapped
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(fileHandle);
+		return;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+	if (mappingHandle == nullptr)
+	{
+		CloseHandle(fileHandle);
+		return;
+	}
+
+	void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+	if (data == nullptr)
+	{
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return;
+	}
+
+	m_data = (const uint8_t*)data;
+	m_size = (uint64_t)fileSize.QuadPart;
+	m_fileHandle = (uintptr_t)fileHandle;
+	m_mappingHandle = (uintptr_t)mappingHandle;
+
+#else
+
+	int fileDescriptor = open(filePath, O_RDONLY);
+
+	if (fileDescriptor < 0)
+	{
+		return;
+	}
+
+	struct stat fileStat;
+
+	if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fileDescriptor);
+		return;
+	}
+
+	void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+	if (data == MAP_FAILED)
+	{
+		close(fileDescriptor);
+		return;
+	}
+
+	m_data = (const uint8_t*)data;
+	m_size = (uint64_t)fileStat.st_size;
+	m_fileHandle = (uintptr_t)fileDescriptor;
+
+#endif
+}
+
+CrMemoryMappedFile::~CrMemoryMappedFile()
+{
+	Close();
+}
+
+CrMemoryMappedFile::CrMemoryMappedFile(CrMemoryMappedFile&& other)
+{
+	*this = static_cast<CrMemoryMappedFile&&>(other);
+}
+
+CrMemoryMappedFile& CrMemoryMappedFile::operator = (CrMemoryMappedFile&& other)
+{
+	if (this != &other)
+	{
+		Close();
+
+		m_data = other.m_data;
+		m_size = other.m_size;
+		m_fileHandle = other.m_fileHandle;
+		m_mappingHandle = other.m_mappingHandle;
+
+		other.m_data = nullptr;
+		other.m_size = 0;
+		other.m_fileHandle = 0;
+		other.m_mappingHandle = 0;
+	}
+
+	return *this;
+}
+
+void CrMemoryMappedFile::Close()
+{
+	if (m_data)
+	{
+#if defined(_WIN32)
+
+		UnmapViewOfFile(m_data);
+		CloseHandle((HANDLE)m_mappingHandle);
+		CloseHandle((HANDLE)m_fileHandle);
+
+#else
+
+		munmap((void*)m_data, (size_t)m_size);
+		close((int)m_fileHandle);
+
+#endif
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_fileHandle = 0;
+	m_mappingHandle = 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "stdint.h"
+
+// Read-only view of an entire file mapped into the address space of the process.
+// Reads through the mapping don't go through any intermediate buffers, the pages
+// are brought in by the OS as they are touched
+class CrMemoryMappedFile
+{
+public:
+
+	CrMemoryMappedFile() {}
+
+	CrMemoryMappedFile(const char* filePath);
+
+	~CrMemoryMappedFile();
+
+	CrMemoryMappedFile(const CrMemoryMappedFile&) = delete;
+
+	CrMemoryMappedFile& operator = (const CrMemoryMappedFile&) = delete;
+
+	CrMemoryMappedFile(CrMemoryMappedFile&& other);
+
+	CrMemoryMappedFile& operator = (CrMemoryMappedFile&& other);
+
+	void Close();
+
+	const uint8_t* GetData() const { return m_data; }
+
+	uint64_t GetSize() const { return m_size; }
+
+	bool IsValid() const { return m_data != nullptr; }
+
+	explicit operator bool() const { return IsValid(); }
+
+private:
+
+	const uint8_t* m_data = nullptr;
+
+	uint64_t m_size = 0;
+
+	// Platform-specific handles. File handle and mapping handle on Windows, file descriptor elsewhere
+	uintptr_t m_fileHandle = 0;
+
+	uintptr_t m_mappingHandle = 0;
+};
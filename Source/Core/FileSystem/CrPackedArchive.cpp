@@ -0,0 +1,584 @@
+#include "Core/CrCore_pch.h"
+
+#include "Core/FileSystem/CrPackedArchive.h"
+#include "Core/FileSystem/CrFileUtilities.h"
+#include "Core/Logging/ICrDebug.h"
+
+#include "crstl/filesystem.h"
+#include "crstl/sort.h"
+
+#include <stdio.h>
+
+// Compact when dead space takes over half of the archive, but don't bother for small archives
+static const uint64_t CompactionMinimumDeadBytes = 4 * 1024 * 1024;
+
+static const uint8_t RecordPadding[CrPackedArchive::RecordAlignment] = {};
+
+CrPackedArchive::~CrPackedArchive()
+{
+	Close();
+}
+
+uint64_t CrPackedArchive::AlignRecordSize(uint64_t size)
+{
+	return (size + RecordAlignment - 1) & ~((uint64_t)RecordAlignment - 1);
+}
+
+static uint64_t GetFirstRecordOffset()
+{
+	return (sizeof(CrPackedArchiveHeader) + CrPackedArchive::RecordAlignment - 1) & ~((uint64_t)CrPackedArchive::RecordAlignment - 1);
+}
+
+CrFixedPath CrPackedArchive::GetArchiveFilePath(const CrFixedPath& archivePath)
+{
+	CrFixedPath archiveFilePath = archivePath;
+	archiveFilePath += ".crarchive";
+	return archiveFilePath;
+}
+
+CrFixedPath CrPackedArchive::GetIndexFilePath(const CrFixedPath& archivePath)
+{
+	CrFixedPath indexFilePath = archivePath;
+	indexFilePath += ".crindex";
+	return indexFilePath;
+}
+
+bool CrPackedArchive::Open(const CrFixedPath& archivePath)
+{
+	Close();
+
+	m_archivePath = archivePath;
+
+	crstl::create_directories(archivePath.parent_path().c_str());
+
+	MapFiles();
+
+	m_isOpen = m_archiveMapping.IsValid();
+
+	return m_isOpen;
+}
+
+bool CrPackedArchive::OpenReadOnly(const CrFixedPath& archivePath)
+{
+	Close();
+
+	m_archivePath = archivePath;
+	m_readOnly = true;
+
+	MapFiles();
+
+	m_isOpen = m_archiveMapping.IsValid();
+
+	return m_isOpen;
+}
+
+void CrPackedArchive::Close()
+{
+	if (m_isOpen)
+	{
+		Flush();
+	}
+
+	m_archiveMapping.Close();
+	m_indexMapping.Close();
+	m_mappedEntries = nullptr;
+	m_mappedEntryCount = 0;
+	m_recoveredEntries.clear();
+	m_appendedEntries.clear();
+	m_removedEntries.clear();
+	m_archiveSize = 0;
+	m_deadBytes = 0;
+	m_isOpen = false;
+	m_readOnly = false;
+}
+
+void CrPackedArchive::MapFiles()
+{
+	CrFixedPath archiveFilePath = GetArchiveFilePath(m_archivePath);
+	CrFixedPath indexFilePath = GetIndexFilePath(m_archivePath);
+
+	m_archiveMapping = CrMemoryMappedFile(archiveFilePath.c_str());
+
+	bool validArchive = false;
+
+	if (m_archiveMapping.GetSize() >= GetFirstRecordOffset())
+	{
+		const CrPackedArchiveHeader* archiveHeader = (const CrPackedArchiveHeader*)m_archiveMapping.GetData();
+		validArchive =
+			archiveHeader->magic == CrPackedArchiveHeader::ArchiveMagic &&
+			archiveHeader->version == CrPackedArchiveVersion::CurrentVersion &&
+			archiveHeader->hashVersion == CrHash::Version;
+	}
+
+	if (!validArchive && m_readOnly)
+	{
+		CrLog("Archive %s is missing or invalid", archiveFilePath.c_str());
+		m_archiveMapping.Close();
+		return;
+	}
+
+	// Start a new archive if it doesn't exist or we cannot understand it
+	if (!validArchive)
+	{
+		m_archiveMapping.Close();
+
+		if (crstl::file archiveFile = crstl::file(archiveFilePath.c_str(), crstl::file_flags::write | crstl::file_flags::force_create))
+		{
+			CrPackedArchiveHeader archiveHeader = {};
+			archiveHeader.magic = CrPackedArchiveHeader::ArchiveMagic;
+			archiveHeader.version = CrPackedArchiveVersion::CurrentVersion;
+			archiveHeader.hashVersion = CrHash::Version;
+			archiveFile.write(&archiveHeader, sizeof(archiveHeader));
+			archiveFile.write(RecordPadding, GetFirstRecordOffset() - sizeof(archiveHeader));
+		}
+
+		crstl::delete_file(indexFilePath.c_str());
+
+		m_archiveMapping = CrMemoryMappedFile(archiveFilePath.c_str());
+
+		if (!m_archiveMapping)
+		{
+			CrLog("Could not create archive %s", archiveFilePath.c_str());
+			return;
+		}
+	}
+
+	m_archiveSize = m_archiveMapping.GetSize();
+
+	m_indexMapping = CrMemoryMappedFile(indexFilePath.c_str());
+
+	uint64_t indexedArchiveSize = GetFirstRecordOffset();
+
+	if (m_indexMapping.GetSize() >= sizeof(CrPackedArchiveHeader))
+	{
+		const CrPackedArchiveHeader* indexHeader = (const CrPackedArchiveHeader*)m_indexMapping.GetData();
+
+		bool validIndex =
+			indexHeader->magic == CrPackedArchiveHeader::IndexMagic &&
+			indexHeader->version == CrPackedArchiveVersion::CurrentVersion &&
+			indexHeader->hashVersion == CrHash::Version &&
+			indexHeader->archiveSize <= m_archiveSize &&
+			m_indexMapping.GetSize() == sizeof(CrPackedArchiveHeader) + indexHeader->entryCount * sizeof(CrPackedArchiveIndexEntry);
+
+		if (validIndex)
+		{
+			const CrPackedArchiveIndexEntry* indexEntries = (const CrPackedArchiveIndexEntry*)(m_indexMapping.GetData() + sizeof(CrPackedArchiveHeader));
+
+			// Every entry needs to point inside the part of the archive the index describes, otherwise finding it would
+			// return memory outside the mapping. An index we can't trust is rebuilt from the records
+			for (uint64_t i = 0; i < indexHeader->entryCount && validIndex; ++i)
+			{
+				const CrPackedArchiveIndexEntry& indexEntry = indexEntries[i];
+
+				validIndex =
+					indexEntry.offset >= GetFirstRecordOffset() + sizeof(CrPackedArchiveRecord) &&
+					indexEntry.offset <= indexHeader->archiveSize &&
+					indexEntry.size <= indexHeader->archiveSize - indexEntry.offset;
+			}
+
+			if (validIndex)
+			{
+				m_mappedEntries = indexEntries;
+				m_mappedEntryCount = indexHeader->entryCount;
+				indexedArchiveSize = indexHeader->archiveSize;
+			}
+		}
+
+		if (!validIndex)
+		{
+			CrLog("Index of archive %s is invalid, rebuilding it", archiveFilePath.c_str());
+			m_indexMapping.Close();
+		}
+	}
+
+	// Anything beyond what the index knows about was appended after the index was last written. The index
+	// may also be missing entirely, in which case we rebuild it from every record in the archive
+	bool validRecords = RecoverRecords(indexedArchiveSize);
+
+	crstl::vector<CrPackedArchiveIndexEntry> entries;
+	BuildIndex(entries);
+
+	uint64_t liveBytes = GetFirstRecordOffset();
+
+	for (const CrPackedArchiveIndexEntry& entry : entries)
+	{
+		liveBytes += AlignRecordSize(sizeof(CrPackedArchiveRecord) + entry.size);
+	}
+
+	m_deadBytes = m_archiveSize - liveBytes;
+
+	// A partially written record at the end means new records would be appended after garbage. Reading is
+	// fine, as recovery stopped before it
+	if (!validRecords && !m_readOnly)
+	{
+		CrLog("Archive %s has a truncated record, compacting", archiveFilePath.c_str());
+		Compact();
+	}
+}
+
+bool CrPackedArchive::RecoverRecords(uint64_t startOffset)
+{
+	const uint8_t* archiveData = m_archiveMapping.GetData();
+
+	uint64_t recordOffset = startOffset;
+
+	while (recordOffset + sizeof(CrPackedArchiveRecord) <= m_archiveSize)
+	{
+		const CrPackedArchiveRecord* record = (const CrPackedArchiveRecord*)(archiveData + recordOffset);
+
+		uint64_t recordSize = AlignRecordSize(sizeof(CrPackedArchiveRecord) + record->size);
+
+		if (record->size > m_archiveSize || recordOffset + recordSize > m_archiveSize)
+		{
+			m_archiveSize = recordOffset;
+			return false;
+		}
+
+		CrPackedArchiveIndexEntry entry;
+		entry.key = record->key;
+		entry.offset = recordOffset + sizeof(CrPackedArchiveRecord);
+		entry.size = record->size;
+
+		// Later records replace earlier ones
+		if (FindMappedEntry(entry.key))
+		{
+			m_removedEntries.insert(entry.key, true);
+		}
+
+		m_recoveredEntries.erase(entry.key);
+		m_recoveredEntries.insert(entry.key, entry);
+
+		recordOffset += recordSize;
+	}
+
+	return recordOffset == m_archiveSize;
+}
+
+const CrPackedArchiveIndexEntry* CrPackedArchive::FindMappedEntry(uint64_t key) const
+{
+	uint64_t first = 0;
+	uint64_t last = m_mappedEntryCount;
+
+	while (first < last)
+	{
+		uint64_t middle = first + (last - first) / 2;
+
+		if (m_mappedEntries[middle].key < key)
+		{
+			first = middle + 1;
+		}
+		else
+		{
+			last = middle;
+		}
+	}
+
+	if (first < m_mappedEntryCount && m_mappedEntries[first].key == key)
+	{
+		return &m_mappedEntries[first];
+	}
+
+	return nullptr;
+}
+
+CrPackedArchiveData CrPackedArchive::Find(uint64_t key) const
+{
+	CrPackedArchiveData archiveData;
+
+	const auto appendedIterator = m_appendedEntries.find(key);
+
+	if (appendedIterator != m_appendedEntries.end())
+	{
+		archiveData.data = appendedIterator->second.data.data();
+		archiveData.size = appendedIterator->second.data.size();
+		return archiveData;
+	}
+
+	const auto recoveredIterator = m_recoveredEntries.find(key);
+
+	if (recoveredIterator != m_recoveredEntries.end())
+	{
+		archiveData.data = m_archiveMapping.GetData() + recoveredIterator->second.offset;
+		archiveData.size = recoveredIterator->second.size;
+		return archiveData;
+	}
+
+	if (m_removedEntries.find(key) == m_removedEntries.end())
+	{
+		if (const CrPackedArchiveIndexEntry* mappedEntry = FindMappedEntry(key))
+		{
+			archiveData.data = m_archiveMapping.GetData() + mappedEntry->offset;
+			archiveData.size = mappedEntry->size;
+		}
+	}
+
+	return archiveData;
+}
+
+void CrPackedArchive::Append(uint64_t key, const void* data, uint64_t size)
+{
+	CrAssertMsg(m_isOpen, "Archive is not open");
+	CrAssertMsg(!m_readOnly, "Archive is read-only");
+
+	Remove(key);
+
+	CrFixedPath archiveFilePath = GetArchiveFilePath(m_archivePath);
+
+	if (crstl::file archiveFile = crstl::file(archiveFilePath.c_str(), crstl::file_flags::write | crstl::file_flags::create))
+	{
+		CrPackedArchiveRecord record;
+		record.key = key;
+		record.size = size;
+
+		uint64_t recordSize = AlignRecordSize(sizeof(CrPackedArchiveRecord) + size);
+
+		archiveFile.seek(crstl::file_seek_origin::begin, (int64_t)m_archiveSize);
+		archiveFile.write(&record, sizeof(record));
+		archiveFile.write(data, size);
+		archiveFile.write(RecordPadding, recordSize - sizeof(record) - size);
+
+		CrAppendedEntry appendedEntry;
+		appendedEntry.offset = m_archiveSize + sizeof(CrPackedArchiveRecord);
+		appendedEntry.data.resize(size);
+		memcpy(appendedEntry.data.data(), data, size);
+		m_appendedEntries.insert(key, appendedEntry);
+
+		m_archiveSize += recordSize;
+	}
+	else
+	{
+		CrLog("Could not append to archive %s", archiveFilePath.c_str());
+	}
+}
+
+void CrPackedArchive::Remove(uint64_t key)
+{
+	CrAssertMsg(!m_readOnly, "Archive is read-only");
+
+	CrPackedArchiveData existingData = Find(key);
+
+	if (existingData)
+	{
+		m_deadBytes += AlignRecordSize(sizeof(CrPackedArchiveRecord) + existingData.size);
+	}
+
+	m_appendedEntries.erase(key);
+	m_recoveredEntries.erase(key);
+
+	if (FindMappedEntry(key))
+	{
+		m_removedEntries.insert(key, true);
+	}
+}
+
+void CrPackedArchive::Flush()
+{
+	if (m_readOnly)
+	{
+		return;
+	}
+
+	if (m_appendedEntries.empty() && m_recoveredEntries.empty() && m_removedEntries.empty())
+	{
+		return;
+	}
+
+	if (m_deadBytes > CompactionMinimumDeadBytes && m_deadBytes * 2 > m_archiveSize)
+	{
+		Compact();
+		return;
+	}
+
+	crstl::vector<CrPackedArchiveIndexEntry> entries;
+	BuildIndex(entries);
+
+	// The index mapping needs to go before we can overwrite it
+	m_archiveMapping.Close();
+	m_indexMapping.Close();
+	m_mappedEntries = nullptr;
+	m_mappedEntryCount = 0;
+
+	WriteIndex(entries);
+
+	m_recoveredEntries.clear();
+	m_appendedEntries.clear();
+	m_removedEntries.clear();
+
+	MapFiles();
+}
+
+void CrPackedArchive::Compact()
+{
+	if (m_readOnly)
+	{
+		CrLog("Cannot compact read-only archive %s", m_archivePath.c_str());
+		return;
+	}
+
+	crstl::vector<CrPackedArchiveIndexEntry> entries;
+	BuildIndex(entries);
+
+	CrFixedPath archiveFilePath = GetArchiveFilePath(m_archivePath);
+	CrFixedPath compactedFilePath = archiveFilePath;
+	compactedFilePath += ".compact";
+
+	uint64_t compactedArchiveSize = GetFirstRecordOffset();
+
+	// Write all live records into a new archive while the old one is still mapped
+	if (crstl::file compactedFile = crstl::file(compactedFilePath.c_str(), crstl::file_flags::write | crstl::file_flags::force_create))
+	{
+		CrPackedArchiveHeader archiveHeader = {};
+		archiveHeader.magic = CrPackedArchiveHeader::ArchiveMagic;
+		archiveHeader.version = CrPackedArchiveVersion::CurrentVersion;
+		archiveHeader.hashVersion = CrHash::Version;
+		compactedFile.write(&archiveHeader, sizeof(archiveHeader));
+		compactedFile.write(RecordPadding, GetFirstRecordOffset() - sizeof(archiveHeader));
+
+		for (CrPackedArchiveIndexEntry& entry : entries)
+		{
+			CrPackedArchiveData archiveData = Find(entry.key);
+
+			CrPackedArchiveRecord record;
+			record.key = entry.key;
+			record.size = archiveData.size;
+
+			uint64_t recordSize = AlignRecordSize(sizeof(CrPackedArchiveRecord) + archiveData.size);
+
+			compactedFile.write(&record, sizeof(record));
+			compactedFile.write(archiveData.data, archiveData.size);
+			compactedFile.write(RecordPadding, recordSize - sizeof(record) - archiveData.size);
+
+			entry.offset = compactedArchiveSize + sizeof(CrPackedArchiveRecord);
+			compactedArchiveSize += recordSize;
+		}
+	}
+	else
+	{
+		CrLog("Could not compact archive %s", archiveFilePath.c_str());
+		return;
+	}
+
+	uint64_t reclaimedBytes = m_archiveSize - compactedArchiveSize;
+
+	m_archiveMapping.Close();
+	m_indexMapping.Close();
+	m_mappedEntries = nullptr;
+	m_mappedEntryCount = 0;
+
+	// The index describes the old archive, so it must be gone before the new archive takes its place. If we're
+	// interrupted after this, the index is rebuilt from the records of whichever archive is there
+	crstl::delete_file(GetIndexFilePath(m_archivePath).c_str());
+
+	if (!crcore::MoveFileOver(compactedFilePath, archiveFilePath))
+	{
+		CrLog("Could not replace archive %s with its compacted version", archiveFilePath.c_str());
+		crstl::delete_file(compactedFilePath.c_str());
+		MapFiles();
+		return;
+	}
+
+	m_archiveSize = compactedArchiveSize;
+
+	WriteIndex(entries);
+
+	m_recoveredEntries.clear();
+	m_appendedEntries.clear();
+	m_removedEntries.clear();
+
+	CrLog("Compacted archive %s (%llu entries, reclaimed %llu bytes)", archiveFilePath.c_str(), (uint64_t)entries.size(), reclaimedBytes);
+
+	MapFiles();
+}
+
+uint64_t CrPackedArchive::GetEntryCount() const
+{
+	crstl::vector<CrPackedArchiveIndexEntry> entries;
+	BuildIndex(entries);
+	return entries.size();
+}
+
+void CrPackedArchive::BuildIndex(crstl::vector<CrPackedArchiveIndexEntry>& entries) const
+{
+	entries.clear();
+	entries.reserve(m_mappedEntryCount + m_recoveredEntries.size() + m_appendedEntries.size());
+
+	for (uint64_t i = 0; i < m_mappedEntryCount; ++i)
+	{
+		const CrPackedArchiveIndexEntry& mappedEntry = m_mappedEntries[i];
+
+		if (m_removedEntries.find(mappedEntry.key) == m_removedEntries.end())
+		{
+			entries.push_back(mappedEntry);
+		}
+	}
+
+	for (const auto& recoveredIterator : m_recoveredEntries)
+	{
+		entries.push_back(recoveredIterator.second);
+	}
+
+	for (const auto& appendedIterator : m_appendedEntries)
+	{
+		CrPackedArchiveIndexEntry entry;
+		entry.key = appendedIterator.first;
+		entry.offset = appendedIterator.second.offset;
+		entry.size = appendedIterator.second.data.size();
+		entries.push_back(entry);
+	}
+
+	crstl::sort(entries.begin(), entries.end());
+}
+
+void CrPackedArchive::WriteIndex(const crstl::vector<CrPackedArchiveIndexEntry>& entries) const
+{
+	CrFixedPath indexFilePath = GetIndexFilePath(m_archivePath);
+
+	if (crstl::file indexFile = crstl::file(indexFilePath.c_str(), crstl::file_flags::write | crstl::file_flags::force_create))
+	{
+		CrPackedArchiveHeader indexHeader = {};
+		indexHeader.magic = CrPackedArchiveHeader::IndexMagic;
+		indexHeader.version = CrPackedArchiveVersion::CurrentVersion;
+		indexHeader.hashVersion = CrHash::Version;
+		indexHeader.archiveSize = m_archiveSize;
+		indexHeader.entryCount = entries.size();
+
+		indexFile.write(&indexHeader, sizeof(indexHeader));
+		indexFile.write(entries.data(), entries.size() * sizeof(CrPackedArchiveIndexEntry));
+	}
+}
+
+bool CrPackedArchive::Merge(const CrFixedPath& outputPath, const crstl::vector<CrFixedPath>& inputPaths)
+{
+	CrPackedArchive outputArchive;
+
+	if (!outputArchive.Open(outputPath))
+	{
+		return false;
+	}
+
+	for (const CrFixedPath& inputPath : inputPaths)
+	{
+		if (!crstl::exists(GetArchiveFilePath(inputPath).c_str()))
+		{
+			CrLog("Archive %s not found", inputPath.c_str());
+			return false;
+		}
+
+		CrPackedArchive inputArchive;
+
+		if (!inputArchive.OpenReadOnly(inputPath))
+		{
+			return false;
+		}
+
+		inputArchive.ForEachEntry([&outputArchive](uint64_t key, const CrPackedArchiveData& archiveData)
+		{
+			outputArchive.Append(key, archiveData.data, archiveData.size);
+		});
+	}
+
+	// Replaced entries leave dead space behind, so the merged archive is always compacted
+	outputArchive.Compact();
+
+	return true;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "Core/CrHash.h"
+#include "Core/FileSystem/CrFixedPath.h"
+#include "Core/FileSystem/CrMemoryMappedFile.h"
+
+#include "crstl/open_hashmap.h"
+#include "crstl/vector.h"
+
+namespace CrPackedArchiveVersion
+{
+	enum T : uint32_t
+	{
+		InitialVersion,
+		HashVersion,
+		CurrentVersion = HashVersion
+	};
+};
+
+struct CrPackedArchiveHeader
+{
+	static const uint32_t ArchiveMagic = 0x41505243; // CRPA
+	static const uint32_t IndexMagic = 0x49505243; // CRPI
+
+	uint32_t magic;
+	uint32_t version;
+
+	// Keys are usually hashes, which are of no use once hashes are computed differently
+	uint32_t hashVersion;
+	uint32_t padding;
+
+	// For the index, the size of the archive it describes. Anything after it
+	// was appended later and needs to be recovered by walking the records
+	uint64_t archiveSize;
+	uint64_t entryCount;
+};
+
+// Every blob in the archive is preceded by a record header. This lets us rebuild the
+// index by walking the archive if it goes missing or goes out of date
+struct CrPackedArchiveRecord
+{
+	uint64_t key;
+	uint64_t size;
+};
+
+struct CrPackedArchiveIndexEntry
+{
+	uint64_t key;
+	uint64_t offset; // Offset of the data (not the record) from the start of the archive
+	uint64_t size;
+
+	bool operator < (const CrPackedArchiveIndexEntry& other) const { return key < other.key; }
+};
+
+struct CrPackedArchiveData
+{
+	const uint8_t* data = nullptr;
+	uint64_t size = 0;
+
+	explicit operator bool() const { return data != nullptr; }
+};
+
+// Append-only archive of blobs identified by a 64-bit key. It lives in two files, the archive
+// itself (blobs) and a sorted index. Both are memory mapped on open, so lookups are a binary search
+// and reads return a pointer straight into the mapping with no copies. New blobs are appended to the
+// end of the archive and live in memory until the next Flush, which rewrites the index and remaps.
+// Removed or replaced blobs leave dead space that Compact reclaims by rewriting only the live blobs
+class CrPackedArchive
+{
+public:
+
+	static const uint32_t RecordAlignment = 16;
+
+	CrPackedArchive() {}
+
+	~CrPackedArchive();
+
+	// Archive path without extension. The archive and index files are derived from it
+	bool Open(const CrFixedPath& archivePath);
+
+	// Opens an existing archive without ever writing to it. An archive that is missing or can't be understood
+	// fails to open instead of being recreated, and a truncated record at the end is ignored instead of compacted
+	bool OpenReadOnly(const CrFixedPath& archivePath);
+
+	void Close();
+
+	// Returns a view of the blob. Only valid until the next Flush or Compact
+	CrPackedArchiveData Find(uint64_t key) const;
+
+	// Adds a blob, replacing any blob with the same key
+	void Append(uint64_t key, const void* data, uint64_t size);
+
+	void Remove(uint64_t key);
+
+	// Writes the index and remaps the archive. If the archive has accumulated enough dead space,
+	// it compacts it first
+	void Flush();
+
+	// Rewrites the archive with only the live blobs into a new file, then replaces the archive with it
+	void Compact();
+
+	uint64_t GetEntryCount() const;
+
+	uint64_t GetArchiveSize() const { return m_archiveSize; }
+
+	uint64_t GetDeadBytes() const { return m_deadBytes; }
+
+	// Calls function(key, data) for every live blob in key order
+	template<typename FunctionT>
+	void ForEachEntry(const FunctionT& function) const
+	{
+		crstl::vector<CrPackedArchiveIndexEntry> entries;
+		BuildIndex(entries);
+
+		for (const CrPackedArchiveIndexEntry& entry : entries)
+		{
+			function(entry.key, Find(entry.key));
+		}
+	}
+
+	// Copies every blob of the input archives into the output archive. Blobs in later inputs replace blobs with the same key
+	static bool Merge(const CrFixedPath& outputPath, const crstl::vector<CrFixedPath>& inputPaths);
+
+	static CrFixedPath GetArchiveFilePath(const CrFixedPath& archivePath);
+
+	static CrFixedPath GetIndexFilePath(const CrFixedPath& archivePath);
+
+private:
+
+	struct CrAppendedEntry
+	{
+		uint64_t offset;
+		crstl::vector<uint8_t> data;
+	};
+
+	const CrPackedArchiveIndexEntry* FindMappedEntry(uint64_t key) const;
+
+	void MapFiles();
+
+	bool RecoverRecords(uint64_t startOffset);
+
+	void BuildIndex(crstl::vector<CrPackedArchiveIndexEntry>& entries) const;
+
+	void WriteIndex(const crstl::vector<CrPackedArchiveIndexEntry>& entries) const;
+
+	static uint64_t AlignRecordSize(uint64_t size);
+
+	CrFixedPath m_archivePath;
+
+	CrMemoryMappedFile m_archiveMapping;
+
+	CrMemoryMappedFile m_indexMapping;
+
+	// Sorted entries inside the index mapping
+	const CrPackedArchiveIndexEntry* m_mappedEntries = nullptr;
+
+	uint64_t m_mappedEntryCount = 0;
+
+	// Entries recovered from the end of the archive that the index didn't know about
+	crstl::open_hashmap<uint64_t, CrPackedArchiveIndexEntry> m_recoveredEntries;
+
+	// Entries appended since the last flush. We keep the data around as it's not in the mapping yet
+	crstl::open_hashmap<uint64_t, CrAppendedEntry> m_appendedEntries;
+
+	// Entries in the mapped index that have been removed or replaced
+	crstl::open_hashmap<uint64_t, bool> m_removedEntries;
+
+	// Total size of the archive file, including appended records
+	uint64_t m_archiveSize = 0;
+
+	// Bytes taken by records nobody references anymore
+	uint64_t m_deadBytes = 0;
+
+	bool m_isOpen = false;
+
+	bool m_readOnly = false;
+};
@@ -0,0 +1,473 @@
+#include "Core/CrCore_pch.h"
+
+#include "Core/IPC/CrLocalSocket.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+// Guards against corrupt or malicious size prefixes
+static const uint64_t MaxBufferSize = 1024ull * 1024ull * 1024ull;
+
+static crstl::string GetLocalSocketPath(const char* name)
+{
+#if defined(_WIN32)
+	crstl::string path = "\\\\.\\pipe\\";
+#else
+	crstl::string path = "/tmp/";
+#endif
+
+	path += name;
+	return path;
+}
+
+#if defined(_WIN32)
+
+static HANDLE CreatePipeInstance(const crstl::string& path, bool firstInstance)
+{
+	crstl::wstring wPath;
+	wPath.append_convert(path.c_str());
+
+	DWORD openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED;
+
+	// The first instance fails to be created if someone else owns the name, which is how we detect another server
+	if (firstInstance)
+	{
+		openMode |= FILE_FLAG_FIRST_PIPE_INSTANCE;
+	}
+
+	return CreateNamedPipeW(wPath.c_str(), openMode, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+		PIPE_UNLIMITED_INSTANCES, 64 * 1024, 64 * 1024, 0, nullptr);
+}
+
+static HANDLE CreateIoEvent()
+{
+	// Manual reset, as overlapped operations reset it themselves when they start
+	return CreateEventW(nullptr, TRUE, FALSE, nullptr);
+}
+
+// Waits for an overlapped operation that may still be in flight. If it doesn't complete in time it is cancelled,
+// and we wait for the cancellation to go through so that the buffer isn't written to after we return
+static bool CompletePipeOperation(HANDLE pipeHandle, OVERLAPPED& overlapped, BOOL completed, DWORD timeoutMilliseconds, DWORD& bytesTransferred)
+{
+	if (!completed)
+	{
+		if (GetLastError() != ERROR_IO_PENDING)
+		{
+			return false;
+		}
+
+		if (WaitForSingleObject(overlapped.hEvent, timeoutMilliseconds) != WAIT_OBJECT_0)
+		{
+			CancelIoEx(pipeHandle, &overlapped);
+			GetOverlappedResult(pipeHandle, &overlapped, &bytesTransferred, TRUE);
+			return false;
+		}
+	}
+
+	return GetOverlappedResult(pipeHandle, &overlapped, &bytesTransferred, FALSE) != 0;
+}
+
+#endif
+
+CrLocalSocket::~CrLocalSocket()
+{
+	Close();
+}
+
+CrLocalSocket::CrLocalSocket(CrLocalSocket&& other)
+{
+	m_handle = other.m_handle;
+	m_ioEvent = other.m_ioEvent;
+	m_serverInstance = other.m_serverInstance;
+	m_receiveTimeoutMilliseconds = other.m_receiveTimeoutMilliseconds;
+	other.m_handle = InvalidHandle;
+	other.m_ioEvent = 0;
+}
+
+CrLocalSocket& CrLocalSocket::operator = (CrLocalSocket&& other)
+{
+	if (this != &other)
+	{
+		Close();
+		m_handle = other.m_handle;
+		m_ioEvent = other.m_ioEvent;
+		m_serverInstance = other.m_serverInstance;
+		m_receiveTimeoutMilliseconds = other.m_receiveTimeoutMilliseconds;
+		other.m_handle = InvalidHandle;
+		other.m_ioEvent = 0;
+	}
+
+	return *this;
+}
+
+bool CrLocalSocket::Connect(const char* name)
+{
+	Close();
+
+	m_receiveTimeoutMilliseconds = 0;
+
+	crstl::string path = GetLocalSocketPath(name);
+
+#if defined(_WIN32)
+
+	crstl::wstring wPath;
+	wPath.append_convert(path.c_str());
+
+	while (true)
+	{
+		HANDLE pipeHandle = CreateFileW(wPath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+
+		if (pipeHandle != INVALID_HANDLE_VALUE)
+		{
+			HANDLE ioEvent = CreateIoEvent();
+
+			if (!ioEvent)
+			{
+				CloseHandle(pipeHandle);
+				return false;
+			}
+
+			m_handle = (uintptr_t)pipeHandle;
+			m_ioEvent = (uintptr_t)ioEvent;
+			m_serverInstance = false;
+			return true;
+		}
+
+		// The server exists but all instances are busy, wait for one to become available
+		if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(wPath.c_str(), 5000))
+		{
+			return false;
+		}
+	}
+
+#else
+
+	int socketHandle = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (socketHandle < 0)
+	{
+		return false;
+	}
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+	if (connect(socketHandle, (const sockaddr*)&address, sizeof(address)) != 0)
+	{
+		close(socketHandle);
+		return false;
+	}
+
+	m_handle = (uintptr_t)socketHandle;
+	return true;
+
+#endif
+}
+
+void CrLocalSocket::Close()
+{
+	if (m_handle != InvalidHandle)
+	{
+#if defined(_WIN32)
+		FlushFileBuffers((HANDLE)m_handle);
+
+		// The client end of a pipe can't be disconnected, closing it is enough
+		if (m_serverInstance)
+		{
+			DisconnectNamedPipe((HANDLE)m_handle);
+		}
+
+		CloseHandle((HANDLE)m_handle);
+		CloseHandle((HANDLE)m_ioEvent);
+		m_ioEvent = 0;
+#else
+		close((int)m_handle);
+#endif
+		m_handle = InvalidHandle;
+	}
+}
+
+void CrLocalSocket::Disconnect()
+{
+	if (m_handle != InvalidHandle)
+	{
+#if defined(_WIN32)
+		// Pending operations complete with an error either way
+		if (m_serverInstance)
+		{
+			DisconnectNamedPipe((HANDLE)m_handle);
+		}
+		else
+		{
+			CancelIoEx((HANDLE)m_handle, nullptr);
+		}
+#else
+		shutdown((int)m_handle, SHUT_RDWR);
+#endif
+	}
+}
+
+void CrLocalSocket::SetReceiveTimeout(uint32_t timeoutMilliseconds)
+{
+	m_receiveTimeoutMilliseconds = timeoutMilliseconds;
+
+#if !defined(_WIN32)
+	if (m_handle != InvalidHandle)
+	{
+		timeval timeout = {};
+		timeout.tv_sec = timeoutMilliseconds / 1000;
+		timeout.tv_usec = (timeoutMilliseconds % 1000) * 1000;
+		setsockopt((int)m_handle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	}
+#endif
+}
+
+bool CrLocalSocket::Send(const void* data, uint64_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+
+	while (size > 0)
+	{
+		uint32_t chunkSize = size > 0x40000000ull ? 0x40000000u : (uint32_t)size;
+
+#if defined(_WIN32)
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = (HANDLE)m_ioEvent;
+
+		BOOL completed = WriteFile((HANDLE)m_handle, bytes, chunkSize, nullptr, &overlapped);
+
+		DWORD bytesWritten = 0;
+		if (!CompletePipeOperation((HANDLE)m_handle, overlapped, completed, INFINITE, bytesWritten) || bytesWritten == 0)
+		{
+			return false;
+		}
+#else
+		ssize_t bytesWritten = send((int)m_handle, bytes, chunkSize, MSG_NOSIGNAL);
+		if (bytesWritten <= 0)
+		{
+			return false;
+		}
+#endif
+
+		bytes += bytesWritten;
+		size -= bytesWritten;
+	}
+
+	return true;
+}
+
+bool CrLocalSocket::Receive(void* data, uint64_t size)
+{
+	uint8_t* bytes = (uint8_t*)data;
+
+	while (size > 0)
+	{
+		uint32_t chunkSize = size > 0x40000000ull ? 0x40000000u : (uint32_t)size;
+
+#if defined(_WIN32)
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = (HANDLE)m_ioEvent;
+
+		BOOL completed = ReadFile((HANDLE)m_handle, bytes, chunkSize, nullptr, &overlapped);
+
+		DWORD timeoutMilliseconds = m_receiveTimeoutMilliseconds > 0 ? m_receiveTimeoutMilliseconds : INFINITE;
+
+		DWORD bytesRead = 0;
+		if (!CompletePipeOperation((HANDLE)m_handle, overlapped, completed, timeoutMilliseconds, bytesRead) || bytesRead == 0)
+		{
+			return false;
+		}
+#else
+		ssize_t bytesRead = recv((int)m_handle, bytes, chunkSize, 0);
+		if (bytesRead <= 0)
+		{
+			return false;
+		}
+#endif
+
+		bytes += bytesRead;
+		size -= bytesRead;
+	}
+
+	return true;
+}
+
+bool CrLocalSocket::SendBuffer(const crstl::vector<uint8_t>& buffer)
+{
+	uint64_t bufferSize = buffer.size();
+	return Send(&bufferSize, sizeof(bufferSize)) && Send(buffer.data(), bufferSize);
+}
+
+bool CrLocalSocket::ReceiveBuffer(crstl::vector<uint8_t>& buffer)
+{
+	uint64_t bufferSize = 0;
+
+	if (!Receive(&bufferSize, sizeof(bufferSize)) || bufferSize > MaxBufferSize)
+	{
+		return false;
+	}
+
+	buffer.resize((size_t)bufferSize);
+	return Receive(buffer.data(), bufferSize);
+}
+
+CrLocalSocketServer::~CrLocalSocketServer()
+{
+	Close();
+}
+
+bool CrLocalSocketServer::Listen(const char* name)
+{
+	Close();
+
+	m_path = GetLocalSocketPath(name);
+
+#if defined(_WIN32)
+
+	HANDLE pipeHandle = CreatePipeInstance(m_path, true);
+
+	if (pipeHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	m_handle = (uintptr_t)pipeHandle;
+
+#else
+
+	int socketHandle = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (socketHandle < 0)
+	{
+		return false;
+	}
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, m_path.c_str(), sizeof(address.sun_path) - 1);
+
+	// If we can connect to the path, another server owns it. Otherwise it was left behind by a server that didn't shut down cleanly
+	CrLocalSocket existingServer;
+	if (existingServer.Connect(name))
+	{
+		close(socketHandle);
+		return false;
+	}
+
+	unlink(m_path.c_str());
+
+	if (bind(socketHandle, (const sockaddr*)&address, sizeof(address)) != 0 || listen(socketHandle, 16) != 0)
+	{
+		close(socketHandle);
+		return false;
+	}
+
+	m_handle = (uintptr_t)socketHandle;
+
+#endif
+
+	m_listening = true;
+	return true;
+}
+
+bool CrLocalSocketServer::Accept(CrLocalSocket& socket)
+{
+	if (!m_listening)
+	{
+		return false;
+	}
+
+#if defined(_WIN32)
+
+	if (m_handle == CrLocalSocket::InvalidHandle)
+	{
+		HANDLE pipeHandle = CreatePipeInstance(m_path, false);
+
+		if (pipeHandle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		m_handle = (uintptr_t)pipeHandle;
+	}
+
+	// The event is used to wait for the connection, and then stays with the socket for its own transfers
+	HANDLE ioEvent = CreateIoEvent();
+
+	if (!ioEvent)
+	{
+		return false;
+	}
+
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = ioEvent;
+
+	// A client that connected between creating the instance and this call is reported as ERROR_PIPE_CONNECTED
+	BOOL connected = ConnectNamedPipe((HANDLE)m_handle, &overlapped);
+
+	if (!connected && GetLastError() != ERROR_PIPE_CONNECTED)
+	{
+		DWORD bytesTransferred = 0;
+
+		if (!CompletePipeOperation((HANDLE)m_handle, overlapped, FALSE, INFINITE, bytesTransferred))
+		{
+			CloseHandle(ioEvent);
+			CloseHandle((HANDLE)m_handle);
+			m_handle = CrLocalSocket::InvalidHandle;
+			return false;
+		}
+	}
+
+	// The connected instance now belongs to the socket, the next client gets a new one
+	socket.Close();
+	socket.m_handle = m_handle;
+	socket.m_ioEvent = (uintptr_t)ioEvent;
+	socket.m_serverInstance = true;
+	m_handle = CrLocalSocket::InvalidHandle;
+	return true;
+
+#else
+
+	int clientHandle = accept((int)m_handle, nullptr, nullptr);
+
+	if (clientHandle < 0)
+	{
+		return false;
+	}
+
+	socket.Close();
+	socket.m_handle = (uintptr_t)clientHandle;
+	return true;
+
+#endif
+}
+
+void CrLocalSocketServer::Close()
+{
+	if (m_handle != CrLocalSocket::InvalidHandle)
+	{
+#if defined(_WIN32)
+		CloseHandle((HANDLE)m_handle);
+#else
+		close((int)m_handle);
+#endif
+		m_handle = CrLocalSocket::InvalidHandle;
+	}
+
+#if !defined(_WIN32)
+	if (m_listening)
+	{
+		unlink(m_path.c_str());
+	}
+#endif
+
+	m_listening = false;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "stdint.h"
+
+#include "crstl/string.h"
+#include "crstl/vector.h"
+
+// Bidirectional byte stream between two processes on the same machine. It is a named pipe on
+// Windows and a Unix domain socket elsewhere. Sockets are identified by a name that both ends
+// agree on, and are only valid once connected (either through Connect or CrLocalSocketServer)
+class CrLocalSocket
+{
+public:
+
+	CrLocalSocket() {}
+
+	~CrLocalSocket();
+
+	CrLocalSocket(const CrLocalSocket&) = delete;
+
+	CrLocalSocket& operator = (const CrLocalSocket&) = delete;
+
+	CrLocalSocket(CrLocalSocket&& other);
+
+	CrLocalSocket& operator = (CrLocalSocket&& other);
+
+	// Connects to a server listening on this name. Returns false if there is no server
+	bool Connect(const char* name);
+
+	void Close();
+
+	// Breaks the connection, waking up any thread blocked sending or receiving on this socket.
+	// Unlike Close, this can be called from a different thread than the one using the socket
+	void Disconnect();
+
+	bool IsValid() const { return m_handle != InvalidHandle; }
+
+	// Receiving fails if no data arrives for this long. Zero waits forever, which is the default
+	void SetReceiveTimeout(uint32_t timeoutMilliseconds);
+
+	// Blocks until all the data has been sent or received. Returns false if the other end went away
+	bool Send(const void* data, uint64_t size);
+
+	bool Receive(void* data, uint64_t size);
+
+	// Buffers are sent with their size in front so that the other end knows how much to read
+	bool SendBuffer(const crstl::vector<uint8_t>& buffer);
+
+	bool ReceiveBuffer(crstl::vector<uint8_t>& buffer);
+
+private:
+
+	friend class CrLocalSocketServer;
+
+	static const uintptr_t InvalidHandle = ~(uintptr_t)0;
+
+	// Pipe handle on Windows, socket file descriptor elsewhere
+	uintptr_t m_handle = InvalidHandle;
+
+	// Windows only. Pipes are opened for overlapped I/O, which signals this event when a transfer completes
+	uintptr_t m_ioEvent = 0;
+
+	// Windows only. Whether the handle is a pipe instance created by CrLocalSocketServer, as opposed to the
+	// client end. Only server instances can be disconnected
+	bool m_serverInstance = false;
+
+	uint32_t m_receiveTimeoutMilliseconds = 0;
+};
+
+class CrLocalSocketServer
+{
+public:
+
+	CrLocalSocketServer() {}
+
+	~CrLocalSocketServer();
+
+	CrLocalSocketServer(const CrLocalSocketServer&) = delete;
+
+	CrLocalSocketServer& operator = (const CrLocalSocketServer&) = delete;
+
+	// Fails if another server is already listening on this name
+	bool Listen(const char* name);
+
+	// Blocks until a client connects
+	bool Accept(CrLocalSocket& socket);
+
+	void Close();
+
+	bool IsListening() const { return m_listening; }
+
+private:
+
+	bool m_listening = false;
+
+	// Full path to the pipe or socket
+	crstl::string m_path;
+
+	// Listening socket file descriptor. On Windows every connection needs its own pipe instance,
+	// and this is the instance the next client will connect to
+	uintptr_t m_handle = CrLocalSocket::InvalidHandle;
+};
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "ICrStream.h"
+#include "Core/Logging/ICrDebug.h"
+
+#include "crstl/string.h"
+#include "crstl/vector.h"
+
+#include <string.h>
+#include <type_traits>
+
+// Elements that live inside the memory of a stream. Only valid for as long as that memory is
+template<typename T>
+struct CrStreamSpan
+{
+	const T* begin() const { return data; }
+	const T* end() const { return data + size; }
+
+	const T& operator [] (uint64_t index) const { return data[index]; }
+
+	bool empty() const { return size == 0; }
+
+	const T* data = nullptr;
+	uint64_t size = 0;
+};
+
+// Stream over a block of memory of known size. Unlike CrMemoryStream it isn't an ICrStream, so serialization
+// functions templated on it resolve every operator at compile time. Nothing is read or written past the end of the
+// block. An access that doesn't fit overflows the stream, after which reads return zeros and writes are dropped,
+// so it's enough to deserialize everything and check IsValid once at the end. A write stream can also own its
+// memory through a vector, which grows instead of overflowing
+template<CrStreamType::T StreamTypeT>
+class CrBufferStream
+{
+public:
+
+	using MemoryT = typename std::conditional<StreamTypeT == CrStreamType::Read, const uint8_t, uint8_t>::type;
+
+	static bool IsReading() { return StreamTypeT == CrStreamType::Read; }
+	static bool IsWriting() { return StreamTypeT == CrStreamType::Write; }
+
+	CrBufferStream(MemoryT* memory, uint64_t sizeBytes)
+		: m_baseDataPointer(memory)
+		, m_currentPointer(memory)
+		, m_endPointer(memory + sizeBytes)
+		, m_overflowed(false)
+		, m_growableBuffer(nullptr) {}
+
+	// Writes into the vector, for when the size of the data isn't known upfront. Its previous contents are
+	// discarded, and its size is always what has been written so far
+	CrBufferStream(crstl::vector<uint8_t>& buffer)
+		: m_baseDataPointer(nullptr)
+		, m_currentPointer(nullptr)
+		, m_endPointer(nullptr)
+		, m_overflowed(false)
+		, m_growableBuffer(&buffer)
+	{
+		CrAssert(IsWriting());
+		buffer.clear();
+	}
+
+	CrBufferStream& operator << (bool& value) { Serialize(value); return *this; }
+	CrBufferStream& operator << (char& value) { Serialize(value); return *this; }
+
+	CrBufferStream& operator << (int8_t& value) { Serialize(value); return *this; }
+	CrBufferStream& operator << (int16_t& value) { Serialize(value); return *this; }
+	CrBufferStream& operator << (int32_t& value) { Serialize(value); return *this; }
+	CrBufferStream& operator << (int64_t& value) { Serialize(value); return *this; }
+
+	CrBufferStream& operator << (uint8_t& value) { Serialize(value); return *this; }
+	CrBufferStream& operator << (uint16_t& value) { Serialize(value); return *this; }
+	CrBufferStream& operator << (uint32_t& value) { Serialize(value); return *this; }
+	CrBufferStream& operator << (uint64_t& value) { Serialize(value); return *this; }
+
+	CrBufferStream& operator << (float& value) { Serialize(value); return *this; }
+	CrBufferStream& operator << (double& value) { Serialize(value); return *this; }
+
+	CrBufferStream& operator << (const bool& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+	CrBufferStream& operator << (const char& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+
+	CrBufferStream& operator << (const int8_t& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+	CrBufferStream& operator << (const int16_t& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+	CrBufferStream& operator << (const int32_t& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+	CrBufferStream& operator << (const int64_t& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+
+	CrBufferStream& operator << (const uint8_t& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+	CrBufferStream& operator << (const uint16_t& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+	CrBufferStream& operator << (const uint32_t& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+	CrBufferStream& operator << (const uint64_t& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+
+	CrBufferStream& operator << (const float& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+	CrBufferStream& operator << (const double& value) { CrAssert(IsWriting()); Write(&value, sizeof(value)); return *this; }
+
+	// Reading copies into the blob's memory, which must be large enough for the stored size
+	CrBufferStream& operator << (CrStreamDataBlob& dataBlob)
+	{
+		*this << dataBlob.size;
+		IsReading() ? Read(dataBlob.data, dataBlob.size) : Write(dataBlob.data, dataBlob.size);
+		return *this;
+	}
+
+	CrBufferStream& operator << (crstl::string& value)
+	{
+		uint32_t stringSize = (uint32_t)value.size();
+		*this << stringSize;
+
+		if (IsReading())
+		{
+			if (!Fits(stringSize))
+			{
+				value.clear();
+				return *this;
+			}
+
+			value.resize(stringSize);
+			Read(value.data(), stringSize);
+		}
+		else
+		{
+			Write(value.data(), stringSize);
+		}
+
+		return *this;
+	}
+
+	// Same layout as the generic vector operator, but the stored count is checked against what's left before
+	// anything is allocated
+	template<typename T>
+	CrBufferStream& SerializeVector(crstl::vector<T>& value)
+	{
+		uint32_t size = (uint32_t)value.size();
+		*this << size;
+
+		// Every element takes at least a byte, which bounds the count for those that aren't copied as they are
+		uint64_t minimumSizeBytes = std::is_trivially_copyable<T>::value ? (uint64_t)size * sizeof(T) : size;
+
+		if (IsReading())
+		{
+			if (!Fits(minimumSizeBytes))
+			{
+				value.clear();
+				return *this;
+			}
+
+			value.resize(size);
+		}
+
+		if (std::is_trivially_copyable<T>::value)
+		{
+			IsReading() ? Read(value.data(), minimumSizeBytes) : Write(value.data(), minimumSizeBytes);
+		}
+		else
+		{
+			for (T& v : value)
+			{
+				*this << v;
+			}
+		}
+
+		return *this;
+	}
+
+	// Points at the next count elements instead of copying them. Empty if they don't fit. Elements must be trivially
+	// copyable, and the memory suitably aligned for them
+	template<typename T>
+	CrStreamSpan<T> ReadSpan(uint64_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Spans can only point at trivially copyable types");
+		CrAssert(IsReading());
+
+		CrStreamSpan<T> span;
+
+		if (count <= GetRemainingBytes() / sizeof(T))
+		{
+			span.data = (const T*)m_currentPointer;
+			span.size = count;
+			m_currentPointer += count * sizeof(T);
+		}
+		else
+		{
+			m_overflowed = true;
+		}
+
+		return span;
+	}
+
+	// Reads a vector written by the vector operator without copying its elements
+	template<typename T>
+	CrStreamSpan<T> ReadVectorSpan()
+	{
+		uint32_t size = 0;
+		*this << size;
+		return ReadSpan<T>(size);
+	}
+
+	void Read(void* dstBuffer, uint64_t sizeBytes)
+	{
+		if (Fits(sizeBytes))
+		{
+			memcpy(dstBuffer, m_currentPointer, sizeBytes);
+			m_currentPointer += sizeBytes;
+		}
+		else
+		{
+			memset(dstBuffer, 0, sizeBytes);
+		}
+	}
+
+	void Write(const void* srcBuffer, uint64_t sizeBytes)
+	{
+		CrAssert(IsWriting());
+
+		if (Fits(sizeBytes))
+		{
+			memcpy((void*)m_currentPointer, srcBuffer, sizeBytes);
+			m_currentPointer += sizeBytes;
+		}
+	}
+
+	void Skip(uint64_t sizeBytes)
+	{
+		if (Fits(sizeBytes))
+		{
+			m_currentPointer += sizeBytes;
+		}
+	}
+
+	// False once anything didn't fit
+	bool IsValid() const { return !m_overflowed; }
+
+	uint64_t GetPosition() const { return (uint64_t)(m_currentPointer - m_baseDataPointer); }
+
+	uint64_t GetSizeBytes() const { return (uint64_t)(m_endPointer - m_baseDataPointer); }
+
+	uint64_t GetRemainingBytes() const { return (uint64_t)(m_endPointer - m_currentPointer); }
+
+private:
+
+	template<typename T>
+	void Serialize(T& value)
+	{
+		IsReading() ? Read(&value, sizeof(value)) : Write(&value, sizeof(value));
+	}
+
+	// Checks the access against what's left, and overflows the stream if it doesn't fit
+	bool Fits(uint64_t sizeBytes)
+	{
+		if (m_growableBuffer && !m_overflowed && sizeBytes > GetRemainingBytes())
+		{
+			Grow(sizeBytes);
+		}
+
+		if (!m_overflowed && sizeBytes <= GetRemainingBytes())
+		{
+			return true;
+		}
+
+		m_overflowed = true;
+		return false;
+	}
+
+	// Makes room for the access at the end of the vector. The vector may move, so the pointers follow it
+	void Grow(uint64_t sizeBytes)
+	{
+		uint64_t position = GetPosition();
+		m_growableBuffer->resize_uninitialized(position + sizeBytes);
+		m_baseDataPointer = m_growableBuffer->data();
+		m_currentPointer = m_baseDataPointer + position;
+		m_endPointer = m_baseDataPointer + m_growableBuffer->size();
+	}
+
+	MemoryT* m_baseDataPointer;
+	MemoryT* m_currentPointer;
+	MemoryT* m_endPointer;
+
+	bool m_overflowed;
+
+	crstl::vector<uint8_t>* m_growableBuffer;
+};
+
+// More specialized than the generic vector operator, so it takes over for these streams
+template<CrStreamType::T StreamTypeT, typename T>
+CrBufferStream<StreamTypeT>& operator << (CrBufferStream<StreamTypeT>& stream, crstl::vector<T>& value)
+{
+	return stream.SerializeVector(value);
+}
+
+typedef CrBufferStream<CrStreamType::Read> CrReadBufferStream;
+typedef CrBufferStream<CrStreamType::Write> CrWriteBufferStream;
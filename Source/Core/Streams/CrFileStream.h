@@ -1,10 +1,13 @@
 #pragma once
 
 #include "ICrStream.h"
+#include "CrBufferStream.h"
 
+#include "Core/FileSystem/CrMemoryMappedFile.h"
 #include "Core/Logging/ICrDebug.h"
 
 #include "crstl/filesystem.h"
+#include "crstl/vector.h"
 
 template<CrStreamType::T StreamTypeT>
 class CrFileStream final : public ICrStream
@@ -117,4 +120,69 @@ private:
 };
 
 typedef CrFileStream<CrStreamType::Read> CrReadFileStream;
-typedef CrFileStream<CrStreamType::Write> CrWriteFileStream;
\ No newline at end of file
+typedef CrFileStream<CrStreamType::Write> CrWriteFileStream;
+
+// Read-only stream over the whole contents of a file, which stay in memory for as long as the stream lives. The
+// file is mapped when possible, so decoders and deserializers can work on it in place instead of reading it into
+// their own buffers first. Files that can't be mapped, such as empty ones, are read into memory instead
+class CrMappedFileStream
+{
+public:
+
+	CrMappedFileStream() : m_stream(nullptr, 0) {}
+
+	CrMappedFileStream(const char* filePath) : CrMappedFileStream()
+	{
+		Open(filePath);
+	}
+
+	CrMappedFileStream(const CrMappedFileStream&) = delete;
+
+	CrMappedFileStream& operator = (const CrMappedFileStream&) = delete;
+
+	bool Open(const char* filePath)
+	{
+		m_mappedFile = CrMemoryMappedFile(filePath);
+		m_fileData.clear();
+		m_isOpen = false;
+
+		if (m_mappedFile)
+		{
+			m_stream = CrReadBufferStream(m_mappedFile.GetData(), m_mappedFile.GetSize());
+			m_isOpen = true;
+		}
+		else if (crstl::file file = crstl::file(filePath, crstl::file_flags::read))
+		{
+			m_fileData.resize_uninitialized(file.get_size());
+			file.read(m_fileData.data(), m_fileData.size());
+			m_stream = CrReadBufferStream(m_fileData.data(), m_fileData.size());
+			m_isOpen = true;
+		}
+
+		return m_isOpen;
+	}
+
+	bool IsOpen() const { return m_isOpen; }
+
+	explicit operator bool() const { return m_isOpen; }
+
+	bool IsMapped() const { return m_mappedFile.IsValid(); }
+
+	const uint8_t* GetData() const { return m_mappedFile ? m_mappedFile.GetData() : m_fileData.data(); }
+
+	uint64_t GetSize() const { return m_mappedFile ? m_mappedFile.GetSize() : m_fileData.size(); }
+
+	// Deserializes from the start of the file, checking every read against its size
+	CrReadBufferStream& GetStream() { return m_stream; }
+
+private:
+
+	CrMemoryMappedFile m_mappedFile;
+
+	// Contents of the file when it couldn't be mapped
+	crstl::vector<uint8_t> m_fileData;
+
+	CrReadBufferStream m_stream;
+
+	bool m_isOpen = false;
+};
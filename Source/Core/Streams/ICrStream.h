@@ -17,10 +17,9 @@ namespace CrStreamType
 struct CrStreamDataBlob
 {
 	CrStreamDataBlob() {}
-	CrStreamDataBlob(void* data, uint64_t size) : data(data), size((uint32_t)size) {}
-	CrStreamDataBlob(void* data, uint32_t size) : data(data), size(size) {}
+	CrStreamDataBlob(void* data, uint64_t size) : data(data), size(size) {}
 	void* data = nullptr;
-	uint32_t size = 0;
+	uint64_t size = 0;
 };
 
 // This pure virtual interface is used to enforce the functions in the
@@ -91,11 +90,11 @@ StreamT& operator << (StreamT& stream, crstl::vector<T>& value)
 	{
 		if (stream.IsReading())
 		{
-			stream.Read(value.data(), size);
+			stream.Read(value.data(), size * sizeof(T));
 		}
 		else
 		{
-			stream.Write(value.data(), size);
+			stream.Write(value.data(), size * sizeof(T));
 		}
 	}
 	else
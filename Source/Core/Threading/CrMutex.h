@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+// Thin wrappers so that code outside of Core doesn't depend on the standard library directly
+class CrMutex
+{
+public:
+
+	void Lock() { m_mutex.lock(); }
+
+	void Unlock() { m_mutex.unlock(); }
+
+private:
+
+	friend class CrConditionVariable;
+
+	std::mutex m_mutex;
+};
+
+class CrScopedLock
+{
+public:
+
+	CrScopedLock(CrMutex& mutex) : m_mutex(mutex) { m_mutex.Lock(); }
+
+	~CrScopedLock() { m_mutex.Unlock(); }
+
+	CrScopedLock(const CrScopedLock&) = delete;
+
+	CrScopedLock& operator = (const CrScopedLock&) = delete;
+
+private:
+
+	CrMutex& m_mutex;
+};
+
+class CrConditionVariable
+{
+public:
+
+	// The mutex must be locked. It is unlocked while waiting and locked again before returning. Like
+	// the standard condition variable it can wake up spuriously, so check the condition in a loop
+	void Wait(CrMutex& mutex)
+	{
+		std::unique_lock<std::mutex> lock(mutex.m_mutex, std::adopt_lock);
+		m_conditionVariable.wait(lock);
+		lock.release();
+	}
+
+	void NotifyAll() { m_conditionVariable.notify_all(); }
+
+private:
+
+	std::condition_variable m_conditionVariable;
+};
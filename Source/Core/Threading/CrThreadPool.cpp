@@ -0,0 +1,189 @@
+#include "Core/CrCore_pch.h"
+
+#include "Core/Threading/CrThreadPool.h"
+
+#include "crstl/deque.h"
+#include "crstl/vector.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <time.h>
+#endif
+
+struct CrThreadPoolState
+{
+	crstl::vector<std::thread> threads;
+
+	crstl::deque<CrJobFunction> jobs;
+
+	std::mutex mutex;
+
+	// Signaled when a job is submitted or the pool shuts down
+	std::condition_variable jobAvailable;
+
+	// Signaled when the last pending job finishes, or the last job of a ParallelFor
+	std::condition_variable jobsFinished;
+
+	// Jobs that have been submitted and haven't finished yet, including the ones running
+	uint32_t pendingJobCount = 0;
+
+	bool shutdown = false;
+};
+
+static void WorkerThreadFunction(CrThreadPoolState* state)
+{
+	while (true)
+	{
+		CrJobFunction job;
+
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->jobAvailable.wait(lock, [state]() { return state->shutdown || !state->jobs.empty(); });
+
+			if (state->jobs.empty())
+			{
+				return;
+			}
+
+			job = state->jobs.front();
+			state->jobs.pop_front();
+		}
+
+		job();
+
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->pendingJobCount--;
+
+			if (state->pendingJobCount == 0)
+			{
+				state->jobsFinished.notify_all();
+			}
+		}
+	}
+}
+
+CrThreadPool::CrThreadPool(uint32_t threadCount)
+{
+	m_state = crstl::unique_ptr<CrThreadPoolState>(new CrThreadPoolState());
+
+	if (threadCount == 0)
+	{
+		threadCount = GetHardwareThreadCount();
+	}
+
+	m_state->threads.reserve(threadCount);
+
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		m_state->threads.push_back(std::thread(WorkerThreadFunction, m_state.get()));
+	}
+}
+
+CrThreadPool::~CrThreadPool()
+{
+	Wait();
+
+	{
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+		m_state->shutdown = true;
+	}
+
+	m_state->jobAvailable.notify_all();
+
+	for (std::thread& thread : m_state->threads)
+	{
+		thread.join();
+	}
+}
+
+void CrThreadPool::Submit(const CrJobFunction& job)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_state->mutex);
+		m_state->jobs.push_back(job);
+		m_state->pendingJobCount++;
+	}
+
+	m_state->jobAvailable.notify_one();
+}
+
+void CrThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	m_state->jobsFinished.wait(lock, [this]() { return m_state->pendingJobCount == 0; });
+}
+
+void CrThreadPool::FinishParallelForJob(uint32_t& remainingJobCount)
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	remainingJobCount--;
+
+	// Notify while holding the lock, as the count lives on the stack of the waiting thread
+	if (remainingJobCount == 0)
+	{
+		m_state->jobsFinished.notify_all();
+	}
+}
+
+void CrThreadPool::WaitForParallelFor(const uint32_t& remainingJobCount)
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	m_state->jobsFinished.wait(lock, [&remainingJobCount]() { return remainingJobCount == 0; });
+}
+
+bool CrThreadPool::IsIdle() const
+{
+	std::unique_lock<std::mutex> lock(m_state->mutex);
+	return m_state->pendingJobCount == 0;
+}
+
+uint32_t CrThreadPool::GetThreadCount() const
+{
+	return (uint32_t)m_state->threads.size();
+}
+
+uint32_t CrThreadPool::GetHardwareThreadCount()
+{
+	uint32_t hardwareThreadCount = std::thread::hardware_concurrency();
+	return hardwareThreadCount > 0 ? hardwareThreadCount : 1;
+}
+
+double CrThreadPool::GetCurrentThreadCPUTimeMilliseconds()
+{
+#if defined(_WIN32)
+
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+
+	if (GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+	{
+		// Both are expressed in units of 100 nanoseconds
+		uint64_t kernelTicks = ((uint64_t)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime;
+		uint64_t userTicks = ((uint64_t)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime;
+		return (double)(kernelTicks + userTicks) / 10000.0;
+	}
+
+	return 0.0;
+
+#elif defined(__linux__)
+
+	timespec threadTime;
+
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &threadTime) == 0)
+	{
+		return (double)threadTime.tv_sec * 1000.0 + (double)threadTime.tv_nsec / 1000000.0;
+	}
+
+	return 0.0;
+
+#else
+
+	return 0.0;
+
+#endif
+}
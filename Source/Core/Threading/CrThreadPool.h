@@ -0,0 +1,67 @@
+#pragma once
+
+#include "stdint.h"
+
+#include "crstl/fixed_function.h"
+#include "crstl/unique_ptr.h"
+
+typedef crstl::fixed_function<128, void()> CrJobFunction;
+
+struct CrThreadPoolState;
+
+// Fixed set of worker threads that execute jobs in the order they were submitted. The
+// number of threads bounds how many jobs can run at the same time. Jobs must not wait
+// on other jobs of the same pool
+class CrThreadPool
+{
+public:
+
+	// A thread count of 0 uses one thread per hardware thread
+	CrThreadPool(uint32_t threadCount = 0);
+
+	// Waits for all submitted jobs before destroying the threads
+	~CrThreadPool();
+
+	void Submit(const CrJobFunction& job);
+
+	// Blocks until every job submitted so far has finished
+	void Wait();
+
+	// Whether every job submitted so far has finished. Unlike Wait, it never blocks
+	bool IsIdle() const;
+
+	uint32_t GetThreadCount() const;
+
+	static uint32_t GetHardwareThreadCount();
+
+	// Time the calling thread has spent running on a CPU, which unlike wall time excludes waiting for IO or locks
+	static double GetCurrentThreadCPUTimeMilliseconds();
+
+	// Runs function(i) for every i in [0, count) across the pool and waits for those jobs only. Jobs submitted
+	// by other threads, including other calls to ParallelFor, don't hold it up
+	template<typename FunctionT>
+	void ParallelFor(uint32_t count, const FunctionT& function)
+	{
+		uint32_t remainingJobCount = count;
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			Submit([this, &function, &remainingJobCount, i]()
+			{
+				function(i);
+				FinishParallelForJob(remainingJobCount);
+			});
+		}
+
+		WaitForParallelFor(remainingJobCount);
+	}
+
+private:
+
+	// The count belongs to one call to ParallelFor and is only accessed under the pool's lock
+	void FinishParallelForJob(uint32_t& remainingJobCount);
+
+	void WaitForParallelFor(const uint32_t& remainingJobCount);
+
+	crstl::unique_ptr<CrThreadPoolState> m_state;
+};
@@ -0,0 +1,74 @@
+#include "CrEngineInitialization.h"
+
+#include "Graphics/IGraphicsSystem.h"
+#include "Graphics/IDevice.h"
+#include "Graphics/CommonResources.h"
+#include "Graphics/CrShaderSources.h"
+#include "Graphics/CrShaderManager.h"
+#include "Graphics/CrMaterialCompiler.h"
+#include "Graphics/CrBuiltinPipelines.h"
+
+#include "Resource/CrResourceManager.h"
+#include "Resource/CrTextureStreamer.h"
+
+#include "Core/Input/CrInputManager.h"
+#include "Core/CrCommandLine.h"
+#include "Core/Logging/ICrDebug.h"
+
+#include "CrOSWindow.h"
+
+#include <stdlib.h>
+
+bool CrParseResolution(const crstl::string& resolution, uint32_t& width, uint32_t& height)
+{
+	size_t pos = resolution.find('x');
+
+	if (pos == crstl::string::npos)
+	{
+		CrLog("Resolution argument specified with an incorrect format! Expected format is <screenWidth>x<screenHeight>! Got \"%s\"", resolution.c_str());
+		return false;
+	}
+
+	width = atoi(resolution.substr(0, pos).c_str());
+	height = atoi(resolution.substr(pos + 1).c_str());
+	CrLog("Resolution set to %dx%d", width, height);
+	return true;
+}
+
+void CrInitializeEngine(const crgfx::GraphicsSystemDescriptor& graphicsSystemDescriptor, const crgfx::DeviceDescriptor& graphicsDeviceDescriptor)
+{
+	CrPrintProcessMemory("Before Render Device");
+
+	crgfx::InitializeGraphicsSystem(graphicsSystemDescriptor);
+	crgfx::CreateMainDevice(graphicsDeviceDescriptor);
+	crgfx::InitializeCommonResources();
+
+	CrPrintProcessMemory("After Graphics Device");
+
+	CrInputManager::Initialize();
+	CrShaderSources::Initialize();
+	CrShaderManager::Initialize();
+	CrMaterialCompiler::Initialize();
+	CrResourceManager::Initialize();
+
+	// Texture streaming budget in megabytes
+	CrTextureStreamingSettings textureStreamingSettings;
+	const crstl::string& textureBudget = crcore::CommandLine("-textureBudget");
+	if (!textureBudget.empty())
+	{
+		textureStreamingSettings.memoryBudget = (uint64_t)atoi(textureBudget.c_str()) * 1024 * 1024;
+	}
+
+	CrTextureStreamer::Initialize(textureStreamingSettings);
+	CrBuiltinPipelines::Initialize();
+	CrOSWindow::Initialize();
+}
+
+void CrDeinitializeEngine()
+{
+	CrTextureStreamer::Deinitialize();
+
+	CrResourceManager::Deinitialize();
+
+	crgfx::DeinitializeCommonResources();
+}
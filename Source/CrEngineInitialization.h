@@ -0,0 +1,24 @@
+#pragma once
+
+#include "crstl/string.h"
+
+#include <stdint.h>
+
+namespace crgfx
+{
+	struct GraphicsSystemDescriptor;
+	struct DeviceDescriptor;
+};
+
+// Setup shared by every executable that runs frames. Each one parses its own command line and decides how to
+// create the graphics system, and then everything else is brought up and torn down in the same order
+
+// Parses a resolution of the form <width>x<height>. Returns false and leaves the size untouched if it's malformed
+bool CrParseResolution(const crstl::string& resolution, uint32_t& width, uint32_t& height);
+
+// Creates the graphics system and its main device, followed by every system the frame needs. The texture
+// streaming budget is read from -textureBudget, in megabytes
+void CrInitializeEngine(const crgfx::GraphicsSystemDescriptor& graphicsSystemDescriptor, const crgfx::DeviceDescriptor& graphicsDeviceDescriptor);
+
+// Call after the frame has been deinitialized
+void CrDeinitializeEngine();
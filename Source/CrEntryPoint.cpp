@@ -1,11 +1,7 @@
 #include "Graphics/IGraphicsSystem.h"
 #include "Graphics/IDevice.h"
-#include "Graphics/CommonResources.h"
-#include "Graphics/CrShaderSources.h"
-#include "Graphics/CrShaderManager.h"
-#include "Graphics/CrMaterialCompiler.h"
-#include "Graphics/CrBuiltinPipelines.h"
 #include "Graphics/CrRendererConfig.h"
+#include "CrEngineInitialization.h"
 #include "CrFrame.h"
 
 #include "Core/Input/CrInputManager.h"
@@ -42,17 +38,7 @@ int main(int argc, char* argv[])
 	crstl::string resolution = crcore::CommandLine("-resolution").c_str();
 	if (!resolution.empty())
 	{
-		size_t pos = resolution.find('x');
-		if(pos != crstl::string::npos)
-		{
-			screenWidth = atoi(resolution.substr(0, pos).c_str());
-			screenHeight = atoi(resolution.substr(pos + 1).c_str());
-			CrLog("Resolution set to %dx%d", screenWidth, screenHeight);
-		} 
-		else
-		{
-			CrLog("Resolution argument specified with an incorrect format! Expected format is <screenWidth>x<screenHeight>! Got \"%s\"", resolution.c_str());
-		}
+		CrParseResolution(resolution, screenWidth, screenHeight);
 	}
 
 	if (dataPath.empty())
@@ -62,8 +48,6 @@ int main(int argc, char* argv[])
 
 	CrGlobalPaths::SetupGlobalPaths(argv[0], dataPath.c_str());
 
-	CrPrintProcessMemory("Before Render Device");
-
 	crgfx::GraphicsSystemDescriptor graphicsSystemDescriptor;
 	graphicsSystemDescriptor.graphicsApi      = crgfx::GraphicsApi::FromString(graphicsApiString.c_str());
 
@@ -77,21 +61,10 @@ int main(int argc, char* argv[])
 	graphicsSystemDescriptor.enableRenderDoc = enableRenderDoc;
 	graphicsSystemDescriptor.enablePIX = enablePIX;
 
-	crgfx::InitializeGraphicsSystem(graphicsSystemDescriptor);
-
 	crgfx::DeviceDescriptor graphicsDeviceDescriptor;
 	graphicsDeviceDescriptor.preferredVendor = crgfx::GraphicsVendor::FromString(graphicsVendorString.c_str());
-	crgfx::CreateMainDevice(graphicsDeviceDescriptor);
-	crgfx::InitializeCommonResources();
-
-	CrPrintProcessMemory("After Graphics Device");
 
-	CrInputManager::Initialize();
-	CrShaderSources::Initialize();
-	CrShaderManager::Initialize();
-	CrMaterialCompiler::Initialize();
-	CrBuiltinPipelines::Initialize();
-	CrOSWindow::Initialize();
+	CrInitializeEngine(graphicsSystemDescriptor, graphicsDeviceDescriptor);
 
 	CrOSWindowDescriptor osWindowDescriptor;
 	osWindowDescriptor.swapchainFormat = CrRendererConfig::SwapchainFormat;
@@ -139,7 +112,7 @@ int main(int argc, char* argv[])
 
 	frame.Deinitialize();
 
-	crgfx::DeinitializeCommonResources();
+	CrDeinitializeEngine();
 
 	return 0;
 }
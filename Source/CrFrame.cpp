@@ -10,6 +10,7 @@
 #include "Graphics/ITexture.h"
 #include "Graphics/ICommandBuffer.h"
 #include "Graphics/GPUBuffer.h"
+#include "Graphics/CommandStream.h"
 #include "Graphics/UI/CrImGuiRenderer.h"
 #include "Graphics/CrGPUTimingQueryTracker.h"
 
@@ -35,14 +36,19 @@
 #include "Core/CrPlatform.h"
 #include "Core/CrFrameTime.h"
 #include "Core/CrGlobalPaths.h"
+#include "Core/FileSystem/CrFixedPath.h"
+#include "Core/Logging/ICrDebug.h"
 
 #include "Resource/CrResourceManager.h"
+#include "Resource/CrTextureStreamer.h"
 
 #include "GeneratedShaders/BuiltinShaders.h"
 
 #include "Math/CrMath.h"
 #include "Math/CrHalf.h"
 
+#include "crstl/timer.h"
+
 #include "CrOSWindow.h"
 #include "Editor/CrImGuiViewports.h"
 
@@ -142,8 +148,8 @@ struct CrRenderPacketBatcher
 
 			for (uint32_t t = 0; t < m_material->m_textures.size(); ++t)
 			{
-				CrMaterial::TextureBinding binding = m_material->m_textures[t];
-				m_commandBuffer->BindTexture(binding.semantic, binding.texture.get());
+				const CrMaterial::TextureBinding& binding = m_material->m_textures[t];
+				m_commandBuffer->BindTexture(binding.semantic, binding.GetTexture());
 			}
 
 			crgfx::CrGPUBufferViewT<MaterialCB> materialBuffer = m_commandBuffer->AllocateConstantBuffer<MaterialCB>();
@@ -217,44 +223,9 @@ void CrFrame::Initialize(crstl::intrusive_ptr<CrOSWindow> mainWindow)
 
 	if (loadData)
 	{
-		CrRenderModelHandle nyraModel = CrResourceManager::LoadModel(CrResourceManager::GetFullResourcePath("nyra/nyra_pose_mod.fbx"));
-		CrRenderModelHandle jainaModel = CrResourceManager::LoadModel(CrResourceManager::GetFullResourcePath("jaina/storm_hero_jaina.fbx"));
-		CrRenderModelHandle damagedHelmet = CrResourceManager::LoadModel(CrResourceManager::GetFullResourcePath("gltf-helmet/DamagedHelmet.gltf"));
-
-		const uint32_t numModels = 100;
-
-		for (uint32_t i = 0; i < numModels; ++i)
-		{
-			CrModelInstanceID modelInstanceId = m_renderWorld->CreateModelInstance();
-			CrModelInstance& modelInstance = m_renderWorld->GetModelInstance(modelInstanceId);
-
-			float angle = 2.39996322f * i;
-			float radius = 30.0f * i / numModels;
-
-			float x = radius * sinf(angle);
-			float z = radius * cosf(angle);
-
-			float4x4 transformMatrix = float4x4::translation(x, 0.0f, z);
-
-			modelInstance.SetTransform(transformMatrix);
-
-			int r = rand();
-			CrRenderModelHandle renderModel;
-			if (r < RAND_MAX / 3)
-			{
-				renderModel = nyraModel;
-			}
-			else if (r < 2 * RAND_MAX / 3)
-			{
-				renderModel = jainaModel;
-			}
-			else
-			{
-				renderModel = damagedHelmet;
-			}
-		
-			modelInstance.SetRenderModel(renderModel);
-		}
+		m_models.push_back(ResourceManager->LoadModel(CrResourceManager::GetFullResourcePath("nyra/nyra_pose_mod.fbx")));
+		m_models.push_back(ResourceManager->LoadModel(CrResourceManager::GetFullResourcePath("jaina/storm_hero_jaina.fbx")));
+		m_models.push_back(ResourceManager->LoadModel(CrResourceManager::GetFullResourcePath("gltf-helmet/DamagedHelmet.gltf")));
 	}
 
 	m_renderWorld->SetCamera(m_camera);
@@ -394,13 +365,57 @@ void CrFrame::Initialize(crstl::intrusive_ptr<CrOSWindow> mainWindow)
 	m_mouseSelectionBuffer = crgfx::GPUBufferHandle(new crgfx::GPUBuffer(device.get(), mouseSelectionBufferDescriptor, 1, 4));
 }
 
+void CrFrame::CreateModelInstances()
+{
+	crstl::vector<CrRenderModelHandle> renderModels;
+
+	for (const CrModelResourceHandle& model : m_models)
+	{
+		if (model->IsLoaded())
+		{
+			renderModels.push_back(model->GetModel());
+		}
+	}
+
+	if (!renderModels.empty())
+	{
+		const uint32_t numModels = 100;
+
+		for (uint32_t i = 0; i < numModels; ++i)
+		{
+			CrModelInstanceID modelInstanceId = m_renderWorld->CreateModelInstance();
+			CrModelInstance& modelInstance = m_renderWorld->GetModelInstance(modelInstanceId);
+
+			float angle = 2.39996322f * i;
+			float radius = 30.0f * i / numModels;
+
+			float x = radius * sinf(angle);
+			float z = radius * cosf(angle);
+
+			float4x4 transformMatrix = float4x4::translation(x, 0.0f, z);
+
+			modelInstance.SetTransform(transformMatrix);
+
+			modelInstance.SetRenderModel(renderModels[rand() % renderModels.size()]);
+		}
+	}
+
+	m_modelInstancesCreated = true;
+}
+
 void CrFrame::Deinitialize()
 {
+	m_models.clear();
+
 	CrImGuiRenderer::Deinitialize();
 
 	CrEditor::Deinitialize();
 
 	m_drawCmdBuffers.clear();
+
+	m_commandStream.Clear();
+
+	m_commandStreamReplayCommandBuffer = nullptr;
 }
 
 void CrFrame::Process()
@@ -438,6 +453,27 @@ void CrFrame::Process()
 	const MouseState& mouseState = CrInput.GetMouseState();
 	const KeyboardState& keyboardState = CrInput.GetKeyboardState();
 
+	// Swap in builtin pipelines whose sources changed. This needs to happen before we start recording
+	BuiltinPipelines->Update();
+
+	// Create the GPU resources for anything that finished loading since last frame
+	ResourceManager->Update();
+
+	if (!m_modelInstancesCreated)
+	{
+		bool modelsFinished = true;
+
+		for (const CrModelResourceHandle& model : m_models)
+		{
+			modelsFinished &= model->IsFinished();
+		}
+
+		if (modelsFinished)
+		{
+			CreateModelInstances();
+		}
+	}
+
 	if (keyboardState.keyHeld[KeyboardKey::LeftCtrl] &&
 		keyboardState.keyHeld[KeyboardKey::LeftShift] &&
 		keyboardState.keyPressed[KeyboardKey::F5])
@@ -472,8 +508,21 @@ void CrFrame::Process()
 
 	m_renderWorld->ComputeVisibilityAndRenderPackets();
 
+	// Visibility has requested the texture detail for this frame
+	TextureStreamer->Update();
+
 	drawCommandBuffer->Begin();
 
+	// Everything recorded from here on is engine code issuing commands and the platform recording them. Capturing
+	// it lets a replay time the second part on its own
+	crstl::timer commandStreamCaptureTimer;
+
+	if (m_captureCommandStream)
+	{
+		m_commandStream.Clear();
+		drawCommandBuffer->SetCommandStream(&m_commandStream);
+	}
+
 	drawCommandBuffer->BindTexture(Textures::DiffuseTexture0, crgfx::WhiteSmallTexture.get());
 	drawCommandBuffer->BindTexture(Textures::NormalTexture0, crgfx::NormalsSmallTexture.get());
 	drawCommandBuffer->BindTexture(Textures::SpecularTexture0, crgfx::WhiteSmallTexture.get());
@@ -921,9 +970,35 @@ void CrFrame::Process()
 	// End the timing query tracker (inserts last timing query)
 	m_timingQueryTracker->EndFrame(drawCommandBuffer);
 
+	if (m_captureCommandStream)
+	{
+		drawCommandBuffer->SetCommandStream(nullptr);
+		m_commandStreamCaptureMilliseconds = (float)commandStreamCaptureTimer.elapsed().milliseconds();
+		m_captureCommandStream = false;
+	}
+
 	// End command buffer recording
 	drawCommandBuffer->End();
 
+	// Not while capturing, as that would read the stream as it's being written
+	if (m_replayCommandStream)
+	{
+		if (!m_commandStreamReplayCommandBuffer)
+		{
+			crgfx::CommandBufferDescriptor replayDescriptor;
+			replayDescriptor.name = "Command Stream Replay";
+			m_commandStreamReplayCommandBuffer = device->CreateCommandBuffer(replayDescriptor);
+		}
+
+		crgfx::CommandStreamReplayer replayer(m_commandStream);
+
+		m_commandStreamReplayCommandBuffer->Begin();
+		replayer.Replay(m_commandStreamReplayCommandBuffer.get(), m_commandStreamReplayStatistics);
+		m_commandStreamReplayCommandBuffer->End();
+
+		m_replayCommandStream = false;
+	}
+
 	// Submit command buffer (should be reworked)
 	drawCommandBuffer->Submit();
 
@@ -1029,6 +1104,11 @@ void CrFrame::DrawDebugUI()
 			ImGui::Text("CPU FPS: [Instant] %.2f fps [Average] %.2f fps", delta.ticks_per_second(), averageDelta.ticks_per_second());
 			ImGui::Text("Drawcalls: %d Instances: %d Vertices: %d", CrRenderingStatistics::GetDrawcallCount(), CrRenderingStatistics::GetInstanceCount(), CrRenderingStatistics::GetVertexCount());
 
+			const crgfx::GPUUploadStatistics& uploadStatistics = crgfx::GetDevice()->GetUploadStatistics();
+			ImGui::Text("Uploads: %u queued (%.2f MB) [Scheduled] %.2f MB [Immediate] %.2f MB [Max Latency] %.2fms",
+				uploadStatistics.queueDepth, uploadStatistics.queuedBytes / (1024.0 * 1024.0), uploadStatistics.scheduledBytes / (1024.0 * 1024.0),
+				uploadStatistics.immediateBytes / (1024.0 * 1024.0), uploadStatistics.maxLatencyMilliseconds);
+
 			ImDrawList* drawList = ImGui::GetWindowDrawList();
 
 			ImGuiTableFlags tableFlags = 0;
@@ -1133,6 +1213,58 @@ void CrFrame::DrawDebugUI()
 				ImGui::EndCombo();
 			}
 
+			ImGui::Separator();
+
+			bool meshletCullingEnabled = m_renderWorld->GetMeshletCullingEnabled();
+			if (ImGui::Checkbox("Meshlet Culling (CPU)", &meshletCullingEnabled))
+			{
+				m_renderWorld->SetMeshletCullingEnabled(meshletCullingEnabled);
+			}
+
+			if (meshletCullingEnabled)
+			{
+				const CrMeshletCullingStatistics& meshletStatistics = m_renderWorld->GetMeshletCullingStatistics();
+				ImGui::Text("Meshlets: %u/%u visible (%u frustum culled, %u backface culled)",
+					meshletStatistics.visibleMeshletCount, meshletStatistics.meshletCount, meshletStatistics.frustumCulledCount, meshletStatistics.backfaceCulledCount);
+				ImGui::Text("Triangles: %u/%u visible", meshletStatistics.visibleTriangleCount, meshletStatistics.triangleCount);
+			}
+
+			ImGui::Separator();
+
+			if (ImGui::Button("Capture Command Stream"))
+			{
+				m_captureCommandStream = true;
+			}
+
+			if (m_commandStream.GetCommandCount() > 0)
+			{
+				ImGui::SameLine();
+
+				if (ImGui::Button("Replay"))
+				{
+					m_replayCommandStream = true;
+				}
+
+				ImGui::SameLine();
+
+				if (ImGui::Button("Save"))
+				{
+					CrFixedPath commandStreamPath = CrFixedPath(CrGlobalPaths::GetTempEngineDirectory()) / "Frame.crcmd";
+					m_commandStream.Save(commandStreamPath.c_str());
+					CrLog("Command stream saved to %s", commandStreamPath.c_str());
+				}
+
+				ImGui::Text("Commands: %u (%u resources, %llu bytes)", m_commandStream.GetCommandCount(), m_commandStream.GetResourceCount(), (uint64_t)m_commandStream.GetData().size());
+				ImGui::Text("Hash: %016llx", m_commandStream.ComputeHash().GetHash());
+				ImGui::Text("Captured Recording: %.3f ms", m_commandStreamCaptureMilliseconds);
+
+				if (m_commandStreamReplayStatistics.commandCount > 0)
+				{
+					ImGui::Text("Replay: %.3f ms (%u/%u commands skipped)", m_commandStreamReplayStatistics.replayMilliseconds,
+						m_commandStreamReplayStatistics.skippedCommandCount, m_commandStreamReplayStatistics.commandCount);
+				}
+			}
+
 			ImGui::End();
 		}
 	}
@@ -1147,6 +1279,10 @@ void CrFrame::RecreateRenderTargets()
 
 	m_swapchain = m_mainWindow->GetSwapchain();
 
+	// The stream keeps the resources it recorded alive, and those are about to be recreated
+	m_commandStream.Clear();
+	m_commandStreamReplayStatistics = crgfx::CommandStreamReplayStatistics();
+
 	// Recreate depth stencil texture
 	crgfx::TextureDescriptor depthTextureDescriptor;
 	depthTextureDescriptor.width = m_swapchain->GetWidth();
@@ -3,8 +3,11 @@
 #include "Graphics/CrGraphicsForwardDeclarations.h"
 #include "Graphics/CrRenderGraph.h"
 #include "Graphics/CrBuiltinPipelines.h"
+#include "Graphics/CommandStream.h"
 #include "Graphics/RenderWorld/CrRenderWorld.h"
 
+#include "Resource/CrResource.h"
+
 #include "GeneratedShaders/ShaderMetadata.h"
 
 #include "crstl/unique_ptr.h"
@@ -32,6 +35,9 @@ public:
 
 	void RecreateRenderTargets();
 
+	// Places instances of the models once they've all finished loading
+	void CreateModelInstances();
+
 private:
 
 	uint32_t m_currentCommandBuffer = 0;
@@ -110,6 +116,11 @@ private:
 
 	CrRenderWorldHandle m_renderWorld;
 
+	// Models requested during initialization. They load in the background while we render
+	crstl::vector<CrModelResourceHandle> m_models;
+
+	bool m_modelInstancesCreated = false;
+
 	CrRenderGraph m_mainRenderGraph;
 
 	crstl::unique_ptr<CrGPUTimingQueryTracker> m_timingQueryTracker;
@@ -117,6 +128,20 @@ private:
 	// This would need to be buffered to account for multiple threads
 	crstl::intrusive_ptr<CrCPUStackAllocator> m_renderingStream;
 
+	// Calls made to the draw command buffer during a captured frame
+	crgfx::CommandStream m_commandStream;
+
+	// Replays are recorded here and never submitted, as we only want to time the recording
+	crgfx::CommandBufferHandle m_commandStreamReplayCommandBuffer;
+
+	crgfx::CommandStreamReplayStatistics m_commandStreamReplayStatistics;
+
+	float m_commandStreamCaptureMilliseconds = 0.0f;
+
+	bool m_captureCommandStream = false;
+
+	bool m_replayCommandStream = false;
+
 #if !defined(CR_CONFIG_FINAL)
 	GBufferDebugMode::T m_gbufferDebugMode = (GBufferDebugMode::T)0;
 #endif
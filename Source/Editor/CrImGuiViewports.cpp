@@ -82,6 +82,16 @@ static void ImGuiViewportsUpdateMonitors()
 	ImGuiViewportsBackendData* backendData = ImGuiViewportsGetBackendData();
 	ImGui::GetPlatformIO().Monitors.resize(0);
 	::EnumDisplayMonitors(nullptr, nullptr, ImGuiViewportsUpdateMonitors_EnumFunc, 0);
+
+	// Without a display, e.g. running headless, ImGui still needs a monitor to place viewports on
+	if (ImGui::GetPlatformIO().Monitors.Size == 0)
+	{
+		ImGuiPlatformMonitor imgui_monitor;
+		imgui_monitor.MainSize = ImGui::GetIO().DisplaySize;
+		imgui_monitor.WorkSize = ImGui::GetIO().DisplaySize;
+		ImGui::GetPlatformIO().Monitors.push_back(imgui_monitor);
+	}
+
 	backendData->WantUpdateMonitors = false;
 }
 
@@ -0,0 +1,1181 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "Graphics/CommandStream.h"
+#include "Graphics/ICommandBuffer.h"
+#include "Graphics/IDevice.h"
+#include "Graphics/IPipeline.h"
+#include "Graphics/ISampler.h"
+#include "Graphics/IGPUQueryPool.h"
+#include "Graphics/GPUBuffer.h"
+
+#include "Core/Streams/CrFileStream.h"
+#include "Core/Logging/ICrDebug.h"
+
+#include "Math/CrMath.h"
+
+#include "crstl/timer.h"
+
+namespace crgfx
+{
+	template<typename T>
+	static void ReadArgument(CrReadBufferStream& stream, T& value)
+	{
+		static_assert(!std::is_pointer<T>::value, "Pointers must be read as resources");
+		stream.Read(&value, sizeof(value));
+	}
+
+	static void ReadArgument(CrReadBufferStream& stream, float4& value)
+	{
+		float values[4];
+		stream.Read(values, sizeof(values));
+		value = float4(values[0], values[1], values[2], values[3]);
+	}
+
+	static void ReadArgument(CrReadBufferStream& stream, crgfx::TextureView& view)
+	{
+		ReadArgument(stream, view.key);
+	}
+
+	static void ReadArgument(CrReadBufferStream& stream, crgfx::TextureState& state)
+	{
+		ReadArgument(stream, state.layout);
+		ReadArgument(stream, state.stages);
+	}
+
+	static void ReadArgument(CrReadBufferStream& stream, CrGPUQueryId& query)
+	{
+		ReadArgument(stream, query.id);
+	}
+
+	// Points at the string inside the stream
+	static const char* ReadString(CrReadBufferStream& stream)
+	{
+		uint32_t length = 0;
+		ReadArgument(stream, length);
+
+		CrStreamSpan<char> string = stream.ReadSpan<char>(length);
+
+		if (string.empty() || string[string.size - 1] != '\0')
+		{
+			return "";
+		}
+
+		return string.data;
+	}
+
+	// Every argument must have been read, and nothing past the end of the command
+	static bool IsCommandComplete(const CrReadBufferStream& stream)
+	{
+		return stream.IsValid() && stream.GetRemainingBytes() == 0;
+	}
+
+	template<typename T>
+	static void WriteVector(CrWriteFileStream& file, const crstl::vector<T>& vector)
+	{
+		uint32_t size = (uint32_t)vector.size();
+		file << size;
+		file.Write(vector.data(), size * sizeof(T));
+	}
+
+	void CommandStream::Clear()
+	{
+		m_data.clear();
+		m_commandOffsets.clear();
+		m_resourceDescriptions.clear();
+		m_resources.clear();
+		m_resourceIndices.clear();
+	}
+
+	CrHash CommandStream::ComputeHash() const
+	{
+		CrHash hash(m_data.data(), m_data.size());
+		hash << CrHash(m_resourceDescriptions.data(), m_resourceDescriptions.size() * sizeof(CommandStreamResourceDescription));
+		return hash;
+	}
+
+	uint32_t CommandStream::FindFirstDifference(const CommandStream& other) const
+	{
+		uint32_t commandCount = CrMin(GetCommandCount(), other.GetCommandCount());
+
+		for (uint32_t commandIndex = 0; commandIndex < commandCount; ++commandIndex)
+		{
+			uint32_t commandStart = m_commandOffsets[commandIndex];
+			uint32_t commandEnd = commandIndex + 1 < GetCommandCount() ? m_commandOffsets[commandIndex + 1] : (uint32_t)m_data.size();
+
+			uint32_t otherCommandStart = other.m_commandOffsets[commandIndex];
+			uint32_t otherCommandEnd = commandIndex + 1 < other.GetCommandCount() ? other.m_commandOffsets[commandIndex + 1] : (uint32_t)other.m_data.size();
+
+			if (commandEnd - commandStart != otherCommandEnd - otherCommandStart ||
+				memcmp(&m_data[commandStart], &other.m_data[otherCommandStart], commandEnd - commandStart) != 0)
+			{
+				return commandIndex;
+			}
+		}
+
+		// One stream is a prefix of the other, so the first extra command is the difference
+		return commandCount;
+	}
+
+	void CommandStream::Save(const char* filePath) const
+	{
+		CrWriteFileStream commandStreamFile(filePath);
+
+		uint32_t version = CommandStreamVersion::CurrentVersion;
+		commandStreamFile << version;
+
+		WriteVector(commandStreamFile, m_resourceDescriptions);
+		WriteVector(commandStreamFile, m_commandOffsets);
+		WriteVector(commandStreamFile, m_data);
+	}
+
+	bool CommandStream::Load(const char* filePath)
+	{
+		Clear();
+
+		CrMappedFileStream commandStreamFile(filePath);
+
+		if (!commandStreamFile.IsOpen())
+		{
+			return false;
+		}
+
+		CrReadBufferStream& stream = commandStreamFile.GetStream();
+
+		uint32_t version = 0;
+		stream << version;
+
+		if (version != CommandStreamVersion::CurrentVersion)
+		{
+			CrLog("Command stream %s was saved with version %u, expected %u", filePath, version, (uint32_t)CommandStreamVersion::CurrentVersion);
+			return false;
+		}
+
+		stream << m_resourceDescriptions;
+		stream << m_commandOffsets;
+		stream << m_data;
+
+		// Commands must be in order and inside the data for replays to find their ends
+		bool validOffsets = true;
+
+		for (uint32_t commandIndex = 0; commandIndex < m_commandOffsets.size(); ++commandIndex)
+		{
+			uint32_t commandEnd = commandIndex + 1 < m_commandOffsets.size() ? m_commandOffsets[commandIndex + 1] : (uint32_t)m_data.size();
+			validOffsets &= m_commandOffsets[commandIndex] < commandEnd && commandEnd <= m_data.size();
+		}
+
+		if (!stream.IsValid() || !validOffsets)
+		{
+			CrLog("Command stream %s is corrupt", filePath);
+			Clear();
+			return false;
+		}
+
+		// There are no live resources behind a loaded stream
+		m_resources.resize(m_resourceDescriptions.size());
+
+		return true;
+	}
+
+	void CommandStream::WriteArgument(const float4& value)
+	{
+		float values[4];
+		hlslpp::store(values, value);
+		WriteBytes(values, sizeof(values));
+	}
+
+	void CommandStream::WriteArgument(const crgfx::TextureState& state)
+	{
+		WriteArgument(state.layout);
+		WriteArgument(state.stages);
+	}
+
+	void CommandStream::WriteArgument(const char* string)
+	{
+		uint32_t length = (uint32_t)strlen(string) + 1;
+		WriteArgument(length);
+		WriteBytes(string, length);
+	}
+
+	void CommandStream::WriteArgument(const crgfx::RenderTargetDescriptor& renderTarget)
+	{
+		WriteArgument(renderTarget.texture);
+		WriteArgument(renderTarget.mipmap);
+		WriteArgument(renderTarget.slice);
+		WriteArgument(renderTarget.clearColor);
+		WriteArgument(renderTarget.depthClearValue);
+		WriteArgument(renderTarget.stencilClearValue);
+		WriteArgument(renderTarget.loadOp);
+		WriteArgument(renderTarget.storeOp);
+		WriteArgument(renderTarget.stencilLoadOp);
+		WriteArgument(renderTarget.stencilStoreOp);
+		WriteArgument(renderTarget.initialState);
+		WriteArgument(renderTarget.usageState);
+		WriteArgument(renderTarget.finalState);
+	}
+
+	void CommandStream::WriteArgument(const crgfx::RenderPassBufferDescriptor& bufferTransition)
+	{
+		WriteArgument(bufferTransition.hardwareBuffer);
+		WriteArgument(bufferTransition.numElements);
+		WriteArgument(bufferTransition.stride);
+		WriteArgument(bufferTransition.offset);
+		WriteArgument(bufferTransition.sourceState);
+		WriteArgument(bufferTransition.sourceShaderStages);
+		WriteArgument(bufferTransition.destinationState);
+		WriteArgument(bufferTransition.destinationShaderStages);
+	}
+
+	void CommandStream::WriteArgument(const crgfx::RenderPassTextureDescriptor& textureTransition)
+	{
+		WriteArgument(textureTransition.texture);
+		WriteArgument(textureTransition.mipmapStart);
+		WriteArgument(textureTransition.mipmapCount);
+		WriteArgument(textureTransition.sliceStart);
+		WriteArgument(textureTransition.sliceCount);
+		WriteArgument(textureTransition.texturePlane);
+		WriteArgument(textureTransition.sourceState);
+		WriteArgument(textureTransition.destinationState);
+	}
+
+	void CommandStream::WriteArgument(const crgfx::RenderPassDescriptor& renderPass)
+	{
+		WriteArgument(renderPass.type);
+		WriteArgument(renderPass.debugName.c_str());
+		WriteArgument(renderPass.debugColor);
+
+		WriteArgument((uint32_t)renderPass.color.size());
+
+		for (const RenderTargetDescriptor& renderTarget : renderPass.color)
+		{
+			WriteArgument(renderTarget);
+		}
+
+		WriteArgument(renderPass.depth);
+
+		const RenderPassDescriptor::BufferTransitionVector* bufferTransitions[] = { &renderPass.beginBuffers, &renderPass.endBuffers };
+		const RenderPassDescriptor::TextureTransitionVector* textureTransitions[] = { &renderPass.beginTextures, &renderPass.endTextures };
+
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+			WriteArgument((uint32_t)bufferTransitions[i]->size());
+
+			for (const RenderPassBufferDescriptor& bufferTransition : *bufferTransitions[i])
+			{
+				WriteArgument(bufferTransition);
+			}
+
+			WriteArgument((uint32_t)textureTransitions[i]->size());
+
+			for (const RenderPassTextureDescriptor& textureTransition : *textureTransitions[i])
+			{
+				WriteArgument(textureTransition);
+			}
+		}
+	}
+
+	uint32_t CommandStream::FindOrAddResource(const GPUAutoDeletable* resource, crgfx::CommandStreamResourceType::T type, bool& added)
+	{
+		added = false;
+
+		if (!resource)
+		{
+			return NullResource;
+		}
+
+		const auto resourceIter = m_resourceIndices.find((uint64_t)resource);
+
+		if (resourceIter != m_resourceIndices.end())
+		{
+			return resourceIter->second;
+		}
+
+		uint32_t resourceIndex = (uint32_t)m_resourceDescriptions.size();
+		m_resourceIndices.insert((uint64_t)resource, resourceIndex);
+
+		CommandStreamResourceDescription description = {};
+		description.type = type;
+		m_resourceDescriptions.push_back(description);
+
+		m_resources.push_back(crstl::intrusive_ptr<GPUAutoDeletable>(const_cast<GPUAutoDeletable*>(resource)));
+
+		added = true;
+		return resourceIndex;
+	}
+
+	uint32_t CommandStream::AddResource(const IHardwareGPUBuffer* buffer)
+	{
+		bool added;
+		uint32_t resourceIndex = FindOrAddResource(buffer, CommandStreamResourceType::Buffer, added);
+
+		if (added)
+		{
+			CommandStreamResourceDescription& description = m_resourceDescriptions[resourceIndex];
+			description.usage = buffer->GetUsage();
+			description.access = buffer->GetAccess();
+			description.format = buffer->GetDataFormat();
+			description.numElements = buffer->GetNumElements();
+			description.strideBytes = buffer->GetStrideBytes();
+		}
+
+		return resourceIndex;
+	}
+
+	uint32_t CommandStream::AddResource(const crgfx::ITexture* texture)
+	{
+		bool added;
+		uint32_t resourceIndex = FindOrAddResource(texture, CommandStreamResourceType::Texture, added);
+
+		if (added)
+		{
+			CommandStreamResourceDescription& description = m_resourceDescriptions[resourceIndex];
+			description.usage = texture->GetUsage();
+			description.format = texture->GetFormat();
+			description.width = texture->GetWidth();
+			description.height = texture->GetHeight();
+			description.depth = texture->GetDepth();
+			description.mipmapCount = texture->GetMipmapCount();
+			description.arraySize = texture->GetSliceCount();
+			description.sampleCount = (uint32_t)texture->GetSampleCount();
+			description.textureType = (uint32_t)texture->GetType();
+		}
+
+		return resourceIndex;
+	}
+
+	uint32_t CommandStream::AddResource(const crgfx::ISampler* sampler)
+	{
+		bool added;
+		return FindOrAddResource(sampler, CommandStreamResourceType::Sampler, added);
+	}
+
+	uint32_t CommandStream::AddResource(const IGraphicsPipeline* graphicsPipeline)
+	{
+		bool added;
+		return FindOrAddResource(graphicsPipeline, CommandStreamResourceType::GraphicsPipeline, added);
+	}
+
+	uint32_t CommandStream::AddResource(const IComputePipeline* computePipeline)
+	{
+		bool added;
+		return FindOrAddResource(computePipeline, CommandStreamResourceType::ComputePipeline, added);
+	}
+
+	uint32_t CommandStream::AddResource(const IGPUQueryPool* queryPool)
+	{
+		bool added;
+		uint32_t resourceIndex = FindOrAddResource(queryPool, CommandStreamResourceType::QueryPool, added);
+
+		if (added)
+		{
+			CommandStreamResourceDescription& description = m_resourceDescriptions[resourceIndex];
+			description.numElements = queryPool->GetTotalQueryCount();
+			description.textureType = (uint32_t)queryPool->GetType();
+		}
+
+		return resourceIndex;
+	}
+
+	CommandStreamReplayer::CommandStreamReplayer(const CommandStream& commandStream) : m_commandStream(commandStream)
+	{
+		m_resources.resize(commandStream.GetResourceCount());
+	}
+
+	void CommandStreamReplayer::SetResource(uint32_t resourceIndex, GPUAutoDeletable* resource)
+	{
+		CrAssertMsg(resourceIndex < m_resources.size(), "Resource index out of range");
+		m_resources[resourceIndex] = crstl::intrusive_ptr<GPUAutoDeletable>(resource);
+	}
+
+	void CommandStreamReplayer::CreateStandInResources(crgfx::IDevice* renderDevice)
+	{
+		for (uint32_t resourceIndex = 0; resourceIndex < m_resources.size(); ++resourceIndex)
+		{
+			if (ResolveResource(resourceIndex, renderDevice))
+			{
+				continue;
+			}
+
+			const CommandStreamResourceDescription& description = m_commandStream.GetResourceDescription(resourceIndex);
+
+			switch (description.type)
+			{
+				case CommandStreamResourceType::Buffer:
+				{
+					HardwareGPUBufferDescriptor bufferDescriptor((BufferUsage::T)description.usage, (MemoryAccess::T)description.access, description.numElements, description.strideBytes);
+					bufferDescriptor.dataFormat = (DataFormat::T)description.format;
+					bufferDescriptor.name = "Command Stream Stand-in Buffer";
+					m_resources[resourceIndex] = crstl::intrusive_ptr<GPUAutoDeletable>(renderDevice->CreateHardwareGPUBuffer(bufferDescriptor));
+					break;
+				}
+				case CommandStreamResourceType::Texture:
+				{
+					TextureDescriptor textureDescriptor;
+					textureDescriptor.width = description.width;
+					textureDescriptor.height = description.height;
+					textureDescriptor.depth = description.depth;
+					textureDescriptor.mipmapCount = description.mipmapCount;
+					textureDescriptor.arraySize = description.arraySize;
+					textureDescriptor.format = (DataFormat::T)description.format;
+					textureDescriptor.sampleCount = (SampleCount)description.sampleCount;
+					textureDescriptor.type = (TextureType)description.textureType;
+					textureDescriptor.name = "Command Stream Stand-in Texture";
+
+					// Swapchain images can only be created by a swapchain, but a render target is used the same way
+					textureDescriptor.usage = description.usage;
+
+					if (textureDescriptor.usage & TextureUsage::SwapChain)
+					{
+						textureDescriptor.usage = (textureDescriptor.usage & ~TextureUsage::SwapChain) | TextureUsage::RenderTarget;
+					}
+
+					m_resources[resourceIndex] = crstl::intrusive_ptr<GPUAutoDeletable>(renderDevice->CreateTexture(textureDescriptor));
+					break;
+				}
+				case CommandStreamResourceType::Sampler:
+				{
+					m_resources[resourceIndex] = crstl::intrusive_ptr<GPUAutoDeletable>(renderDevice->CreateSampler(SamplerDescriptor()));
+					break;
+				}
+				case CommandStreamResourceType::QueryPool:
+				{
+					GPUQueryPoolDescriptor queryPoolDescriptor((QueryType)description.textureType, description.numElements);
+					m_resources[resourceIndex] = crstl::intrusive_ptr<GPUAutoDeletable>(renderDevice->CreateGPUQueryPool(queryPoolDescriptor));
+					break;
+				}
+				default:
+					break;
+			}
+		}
+	}
+
+	GPUAutoDeletable* CommandStreamReplayer::ResolveResource(uint32_t resourceIndex, const crgfx::IDevice* renderDevice) const
+	{
+		if (m_resources[resourceIndex])
+		{
+			return m_resources[resourceIndex].get();
+		}
+
+		GPUAutoDeletable* recordedResource = m_commandStream.GetResource(resourceIndex);
+
+		if (recordedResource && recordedResource->m_renderDevice == renderDevice)
+		{
+			return recordedResource;
+		}
+
+		return nullptr;
+	}
+
+	template<typename T>
+	bool CommandStreamReplayer::ReadResource(CrReadBufferStream& stream, crgfx::CommandStreamResourceType::T type, const T*& resource) const
+	{
+		uint32_t resourceIndex = CommandStream::NullResource;
+		ReadArgument(stream, resourceIndex);
+
+		resource = nullptr;
+
+		if (resourceIndex == CommandStream::NullResource)
+		{
+			return true;
+		}
+
+		if (resourceIndex < m_resolvedResources.size() && m_commandStream.GetResourceDescription(resourceIndex).type == type)
+		{
+			resource = static_cast<const T*>(m_resolvedResources[resourceIndex]);
+		}
+
+		return resource != nullptr;
+	}
+
+	bool CommandStreamReplayer::ReadRenderTarget(CrReadBufferStream& stream, crgfx::RenderTargetDescriptor& renderTarget) const
+	{
+		bool resolved = ReadResource(stream, CommandStreamResourceType::Texture, renderTarget.texture);
+		ReadArgument(stream, renderTarget.mipmap);
+		ReadArgument(stream, renderTarget.slice);
+		ReadArgument(stream, renderTarget.clearColor);
+		ReadArgument(stream, renderTarget.depthClearValue);
+		ReadArgument(stream, renderTarget.stencilClearValue);
+		ReadArgument(stream, renderTarget.loadOp);
+		ReadArgument(stream, renderTarget.storeOp);
+		ReadArgument(stream, renderTarget.stencilLoadOp);
+		ReadArgument(stream, renderTarget.stencilStoreOp);
+		ReadArgument(stream, renderTarget.initialState);
+		ReadArgument(stream, renderTarget.usageState);
+		ReadArgument(stream, renderTarget.finalState);
+		return resolved;
+	}
+
+	bool CommandStreamReplayer::ReadRenderPass(CrReadBufferStream& stream, crgfx::RenderPassDescriptor& renderPass) const
+	{
+		bool resolved = true;
+
+		ReadArgument(stream, renderPass.type);
+		renderPass.debugName = ReadString(stream);
+		ReadArgument(stream, renderPass.debugColor);
+
+		uint32_t colorCount = 0;
+		ReadArgument(stream, colorCount);
+
+		// A count that doesn't fit leaves the rest of the command unread, which makes it incomplete
+		if (colorCount > MaxRenderTargets)
+		{
+			return false;
+		}
+
+		for (uint32_t i = 0; i < colorCount; ++i)
+		{
+			RenderTargetDescriptor renderTarget;
+			resolved &= ReadRenderTarget(stream, renderTarget);
+			renderPass.color.push_back(renderTarget);
+		}
+
+		resolved &= ReadRenderTarget(stream, renderPass.depth);
+
+		RenderPassDescriptor::BufferTransitionVector* bufferTransitions[] = { &renderPass.beginBuffers, &renderPass.endBuffers };
+		RenderPassDescriptor::TextureTransitionVector* textureTransitions[] = { &renderPass.beginTextures, &renderPass.endTextures };
+
+		for (uint32_t i = 0; i < 2; ++i)
+		{
+			uint32_t bufferCount = 0;
+			ReadArgument(stream, bufferCount);
+
+			if (bufferCount > RenderPassDescriptor::MaxTransitionCount)
+			{
+				return false;
+			}
+
+			for (uint32_t j = 0; j < bufferCount; ++j)
+			{
+				const IHardwareGPUBuffer* buffer;
+				uint32_t numElements, stride, offset;
+				BufferState::T sourceState, destinationState;
+				ShaderStageFlags::T sourceShaderStages, destinationShaderStages;
+
+				resolved &= ReadResource(stream, CommandStreamResourceType::Buffer, buffer);
+				ReadArgument(stream, numElements);
+				ReadArgument(stream, stride);
+				ReadArgument(stream, offset);
+				ReadArgument(stream, sourceState);
+				ReadArgument(stream, sourceShaderStages);
+				ReadArgument(stream, destinationState);
+				ReadArgument(stream, destinationShaderStages);
+
+				bufferTransitions[i]->push_back(RenderPassBufferDescriptor(buffer, numElements, stride, offset, sourceState, sourceShaderStages, destinationState, destinationShaderStages));
+			}
+
+			uint32_t textureCount = 0;
+			ReadArgument(stream, textureCount);
+
+			if (textureCount > RenderPassDescriptor::MaxTransitionCount)
+			{
+				return false;
+			}
+
+			for (uint32_t j = 0; j < textureCount; ++j)
+			{
+				const ITexture* texture;
+				uint32_t mipmapStart, mipmapCount, sliceStart, sliceCount;
+				TexturePlane::T texturePlane;
+				TextureState sourceState, destinationState;
+
+				resolved &= ReadResource(stream, CommandStreamResourceType::Texture, texture);
+				ReadArgument(stream, mipmapStart);
+				ReadArgument(stream, mipmapCount);
+				ReadArgument(stream, sliceStart);
+				ReadArgument(stream, sliceCount);
+				ReadArgument(stream, texturePlane);
+				ReadArgument(stream, sourceState);
+				ReadArgument(stream, destinationState);
+
+				textureTransitions[i]->push_back(RenderPassTextureDescriptor(texture, mipmapStart, mipmapCount, sliceStart, sliceCount, texturePlane, sourceState, destinationState));
+			}
+		}
+
+		return resolved;
+	}
+
+	bool CommandStreamReplayer::Replay(crgfx::ICommandBuffer* commandBuffer, CommandStreamReplayStatistics& statistics)
+	{
+		crstl::timer replayTimer;
+
+		statistics = CommandStreamReplayStatistics();
+
+		// Resolve everything once so the loop is only the cost of decoding and recording
+		m_resolvedResources.resize(m_resources.size());
+
+		for (uint32_t resourceIndex = 0; resourceIndex < m_resources.size(); ++resourceIndex)
+		{
+			m_resolvedResources[resourceIndex] = ResolveResource(resourceIndex, commandBuffer->m_renderDevice);
+		}
+
+		const crstl::vector<uint8_t>& data = m_commandStream.GetData();
+		uint32_t commandCount = m_commandStream.GetCommandCount();
+
+		// Draws and dispatches need a pipeline and every binding they might use. Bindings that couldn't be resolved
+		// hold back draws and dispatches until the render pass ends, as passes rebind what they use
+		bool graphicsPipelineResolved = false;
+		bool computePipelineResolved = false;
+		bool bindingsResolved = true;
+
+		// A render pass that couldn't be resolved is skipped up to and including its end
+		bool skippingRenderPass = false;
+
+		for (uint32_t commandIndex = 0; commandIndex < commandCount; ++commandIndex)
+		{
+			uint32_t commandStart = m_commandStream.GetCommandOffset(commandIndex);
+			uint32_t commandEnd = commandIndex + 1 < commandCount ? m_commandStream.GetCommandOffset(commandIndex + 1) : (uint32_t)data.size();
+			CrReadBufferStream stream(&data[commandStart], commandEnd - commandStart);
+
+			CommandStreamOp::T op = CommandStreamOp::Count;
+			ReadArgument(stream, op);
+
+			statistics.commandCount++;
+
+			if (skippingRenderPass)
+			{
+				if (op == CommandStreamOp::EndRenderPass)
+				{
+					skippingRenderPass = false;
+					bindingsResolved = true;
+				}
+
+				statistics.skippedCommandCount++;
+				continue;
+			}
+
+			bool executed = true;
+
+			switch (op)
+			{
+				case CommandStreamOp::SetViewport:
+				{
+					Viewport viewport;
+					ReadArgument(stream, viewport);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					commandBuffer->SetViewport(viewport);
+					break;
+				}
+				case CommandStreamOp::SetScissor:
+				{
+					Rectangle scissor;
+					ReadArgument(stream, scissor);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					commandBuffer->SetScissor(scissor);
+					break;
+				}
+				case CommandStreamOp::SetStencilRef:
+				{
+					uint32_t stencilRef;
+					ReadArgument(stream, stencilRef);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					commandBuffer->SetStencilRef(stencilRef);
+					break;
+				}
+				case CommandStreamOp::BindIndexBuffer:
+				{
+					const IHardwareGPUBuffer* indexBuffer;
+					uint32_t byteOffset, sizeBytes;
+					DataFormat::T indexFormat;
+					executed = ReadResource(stream, CommandStreamResourceType::Buffer, indexBuffer);
+					ReadArgument(stream, byteOffset);
+					ReadArgument(stream, sizeBytes);
+					ReadArgument(stream, indexFormat);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					if (executed)
+					{
+						commandBuffer->BindIndexBuffer(indexBuffer, byteOffset, sizeBytes, indexFormat);
+					}
+					break;
+				}
+				case CommandStreamOp::BindVertexBuffer:
+				{
+					const IHardwareGPUBuffer* vertexBuffer;
+					uint32_t streamId, byteOffset, vertexCount, stride;
+					executed = ReadResource(stream, CommandStreamResourceType::Buffer, vertexBuffer);
+					ReadArgument(stream, streamId);
+					ReadArgument(stream, byteOffset);
+					ReadArgument(stream, vertexCount);
+					ReadArgument(stream, stride);
+
+					if (!IsCommandComplete(stream) || streamId >= MaxVertexStreams)
+					{
+						return false;
+					}
+
+
+					if (executed)
+					{
+						commandBuffer->BindVertexBuffer(vertexBuffer, streamId, byteOffset, vertexCount, stride);
+					}
+					break;
+				}
+				case CommandStreamOp::BindConstantBuffer:
+				{
+					ConstantBuffers::T constantBufferIndex;
+					const IHardwareGPUBuffer* constantBuffer;
+					uint32_t size, offset;
+					ReadArgument(stream, constantBufferIndex);
+					executed = ReadResource(stream, CommandStreamResourceType::Buffer, constantBuffer);
+					ReadArgument(stream, size);
+					ReadArgument(stream, offset);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					if (executed)
+					{
+						commandBuffer->BindConstantBuffer(constantBufferIndex, constantBuffer, size, offset);
+					}
+					break;
+				}
+				case CommandStreamOp::BindSampler:
+				{
+					Samplers::T samplerIndex;
+					const ISampler* sampler;
+					ReadArgument(stream, samplerIndex);
+					executed = ReadResource(stream, CommandStreamResourceType::Sampler, sampler);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					if (executed)
+					{
+						commandBuffer->BindSampler(samplerIndex, sampler);
+					}
+					break;
+				}
+				case CommandStreamOp::BindTexture:
+				{
+					Textures::T textureIndex;
+					const ITexture* texture;
+					TextureView view;
+					ReadArgument(stream, textureIndex);
+					executed = ReadResource(stream, CommandStreamResourceType::Texture, texture);
+					ReadArgument(stream, view);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					if (executed)
+					{
+						commandBuffer->BindTexture(textureIndex, texture, view);
+					}
+					break;
+				}
+				case CommandStreamOp::BindRWTexture:
+				{
+					RWTextures::T rwTextureIndex;
+					const ITexture* texture;
+					uint32_t mip;
+					ReadArgument(stream, rwTextureIndex);
+					executed = ReadResource(stream, CommandStreamResourceType::Texture, texture);
+					ReadArgument(stream, mip);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					if (executed)
+					{
+						commandBuffer->BindRWTexture(rwTextureIndex, texture, mip);
+					}
+					break;
+				}
+				case CommandStreamOp::BindStorageBuffer:
+				{
+					StorageBuffers::T storageBufferIndex;
+					const IHardwareGPUBuffer* buffer;
+					uint32_t numElements, stride, offset;
+					ReadArgument(stream, storageBufferIndex);
+					executed = ReadResource(stream, CommandStreamResourceType::Buffer, buffer);
+					ReadArgument(stream, numElements);
+					ReadArgument(stream, stride);
+					ReadArgument(stream, offset);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					if (executed)
+					{
+						commandBuffer->BindStorageBuffer(storageBufferIndex, buffer, numElements, stride, offset);
+					}
+					break;
+				}
+				case CommandStreamOp::BindRWStorageBuffer:
+				{
+					RWStorageBuffers::T rwStorageBufferIndex;
+					const IHardwareGPUBuffer* buffer;
+					uint32_t numElements, stride, offset;
+					ReadArgument(stream, rwStorageBufferIndex);
+					executed = ReadResource(stream, CommandStreamResourceType::Buffer, buffer);
+					ReadArgument(stream, numElements);
+					ReadArgument(stream, stride);
+					ReadArgument(stream, offset);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					if (executed)
+					{
+						commandBuffer->BindRWStorageBuffer(rwStorageBufferIndex, buffer, numElements, stride, offset);
+					}
+					break;
+				}
+				case CommandStreamOp::BindRWTypedBuffer:
+				{
+					RWTypedBuffers::T rwTypedBufferIndex;
+					const IHardwareGPUBuffer* buffer;
+					uint32_t numElements, stride, offset;
+					ReadArgument(stream, rwTypedBufferIndex);
+					executed = ReadResource(stream, CommandStreamResourceType::Buffer, buffer);
+					ReadArgument(stream, numElements);
+					ReadArgument(stream, stride);
+					ReadArgument(stream, offset);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					if (executed)
+					{
+						commandBuffer->BindRWTypedBuffer(rwTypedBufferIndex, buffer, numElements, stride, offset);
+					}
+					break;
+				}
+				case CommandStreamOp::BindGraphicsPipelineState:
+				{
+					const IGraphicsPipeline* graphicsPipeline;
+					graphicsPipelineResolved = ReadResource(stream, CommandStreamResourceType::GraphicsPipeline, graphicsPipeline);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					executed = graphicsPipelineResolved;
+					if (executed)
+					{
+						commandBuffer->BindGraphicsPipelineState(graphicsPipeline);
+					}
+					break;
+				}
+				case CommandStreamOp::BindComputePipelineState:
+				{
+					const IComputePipeline* computePipeline;
+					computePipelineResolved = ReadResource(stream, CommandStreamResourceType::ComputePipeline, computePipeline);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					executed = computePipelineResolved;
+					if (executed)
+					{
+						commandBuffer->BindComputePipelineState(computePipeline);
+					}
+					break;
+				}
+				case CommandStreamOp::ClearRenderTarget:
+				{
+					const ITexture* renderTarget;
+					float4 color;
+					uint32_t mip, slice, mipCount, sliceCount;
+					executed = ReadResource(stream, CommandStreamResourceType::Texture, renderTarget);
+					ReadArgument(stream, color);
+					ReadArgument(stream, mip);
+					ReadArgument(stream, slice);
+					ReadArgument(stream, mipCount);
+					ReadArgument(stream, sliceCount);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					if (executed)
+					{
+						commandBuffer->ClearRenderTarget(renderTarget, color, mip, slice, mipCount, sliceCount);
+					}
+					break;
+				}
+				case CommandStreamOp::Draw:
+				{
+					uint32_t vertexCount, instanceCount, firstVertex, firstInstance;
+					ReadArgument(stream, vertexCount);
+					ReadArgument(stream, instanceCount);
+					ReadArgument(stream, firstVertex);
+					ReadArgument(stream, firstInstance);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					executed = graphicsPipelineResolved && bindingsResolved;
+					if (executed)
+					{
+						commandBuffer->Draw(vertexCount, instanceCount, firstVertex, firstInstance);
+					}
+					break;
+				}
+				case CommandStreamOp::DrawIndexed:
+				{
+					uint32_t indexCount, instanceCount, firstIndex, vertexOffset, firstInstance;
+					ReadArgument(stream, indexCount);
+					ReadArgument(stream, instanceCount);
+					ReadArgument(stream, firstIndex);
+					ReadArgument(stream, vertexOffset);
+					ReadArgument(stream, firstInstance);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					executed = graphicsPipelineResolved && bindingsResolved;
+					if (executed)
+					{
+						commandBuffer->DrawIndexed(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+					}
+					break;
+				}
+				case CommandStreamOp::Dispatch:
+				{
+					uint32_t threadGroupCountX, threadGroupCountY, threadGroupCountZ;
+					ReadArgument(stream, threadGroupCountX);
+					ReadArgument(stream, threadGroupCountY);
+					ReadArgument(stream, threadGroupCountZ);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					executed = computePipelineResolved && bindingsResolved;
+					if (executed)
+					{
+						commandBuffer->Dispatch(threadGroupCountX, threadGroupCountY, threadGroupCountZ);
+					}
+					break;
+				}
+				case CommandStreamOp::DrawIndirect:
+				case CommandStreamOp::DrawIndexedIndirect:
+				{
+					const IHardwareGPUBuffer* indirectBuffer;
+					uint32_t offset, count;
+					executed = ReadResource(stream, CommandStreamResourceType::Buffer, indirectBuffer);
+					ReadArgument(stream, offset);
+					ReadArgument(stream, count);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					executed = executed && graphicsPipelineResolved && bindingsResolved;
+
+					if (executed)
+					{
+						if (op == CommandStreamOp::DrawIndirect)
+						{
+							commandBuffer->DrawIndirect(indirectBuffer, offset, count);
+						}
+						else
+						{
+							commandBuffer->DrawIndexedIndirect(indirectBuffer, offset, count);
+						}
+					}
+					break;
+				}
+				case CommandStreamOp::DispatchIndirect:
+				{
+					const IHardwareGPUBuffer* indirectBuffer;
+					uint32_t offset;
+					executed = ReadResource(stream, CommandStreamResourceType::Buffer, indirectBuffer);
+					ReadArgument(stream, offset);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					executed = executed && computePipelineResolved && bindingsResolved;
+					if (executed)
+					{
+						commandBuffer->DispatchIndirect(indirectBuffer, offset);
+					}
+					break;
+				}
+				case CommandStreamOp::BeginDebugEvent:
+				case CommandStreamOp::InsertDebugMarker:
+				{
+					const char* name = ReadString(stream);
+					float4 color;
+					ReadArgument(stream, color);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+
+					if (op == CommandStreamOp::BeginDebugEvent)
+					{
+						commandBuffer->BeginDebugEvent(name, color);
+					}
+					else
+					{
+						commandBuffer->InsertDebugMarker(name, color);
+					}
+					break;
+				}
+				case CommandStreamOp::EndDebugEvent:
+				{
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					commandBuffer->EndDebugEvent();
+					break;
+				}
+				case CommandStreamOp::BeginTimestampQuery:
+				case CommandStreamOp::EndTimestampQuery:
+				{
+					const IGPUQueryPool* queryPool;
+					CrGPUQueryId query;
+					executed = ReadResource(stream, CommandStreamResourceType::QueryPool, queryPool);
+					ReadArgument(stream, query);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+
+					if (executed)
+					{
+						if (op == CommandStreamOp::BeginTimestampQuery)
+						{
+							commandBuffer->BeginTimestampQuery(queryPool, query);
+						}
+						else
+						{
+							commandBuffer->EndTimestampQuery(queryPool, query);
+						}
+					}
+					break;
+				}
+				case CommandStreamOp::ResetGPUQueries:
+				case CommandStreamOp::ResolveGPUQueries:
+				{
+					const IGPUQueryPool* queryPool;
+					uint32_t start, count;
+					executed = ReadResource(stream, CommandStreamResourceType::QueryPool, queryPool);
+					ReadArgument(stream, start);
+					ReadArgument(stream, count);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+
+					if (executed)
+					{
+						if (op == CommandStreamOp::ResetGPUQueries)
+						{
+							commandBuffer->ResetGPUQueries(queryPool, start, count);
+						}
+						else
+						{
+							commandBuffer->ResolveGPUQueries(queryPool, start, count);
+						}
+					}
+					break;
+				}
+				case CommandStreamOp::BeginRenderPass:
+				{
+					RenderPassDescriptor renderPass;
+					executed = ReadRenderPass(stream, renderPass);
+
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+
+					if (executed)
+					{
+						commandBuffer->BeginRenderPass(renderPass);
+					}
+					else
+					{
+						skippingRenderPass = true;
+					}
+					break;
+				}
+				case CommandStreamOp::EndRenderPass:
+				{
+					if (!IsCommandComplete(stream))
+					{
+						return false;
+					}
+
+					commandBuffer->EndRenderPass();
+					bindingsResolved = true;
+					break;
+				}
+				default:
+					return false;
+			}
+
+			if (!executed)
+			{
+				statistics.skippedCommandCount++;
+
+				// Draws and dispatches that come after this binding could use it
+				if (op >= CommandStreamOp::BindIndexBuffer && op <= CommandStreamOp::BindRWTypedBuffer)
+				{
+					bindingsResolved = false;
+				}
+			}
+		}
+
+		statistics.replayMilliseconds = (float)replayTimer.elapsed().milliseconds();
+
+		return true;
+	}
+};
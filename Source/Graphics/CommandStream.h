@@ -0,0 +1,318 @@
+#pragma once
+
+#include "Graphics/ITexture.h"
+#include "Graphics/GPUDeletable.h"
+#include "Graphics/RenderPassDescriptor.h"
+#include "Graphics/CrGraphicsForwardDeclarations.h"
+
+#include "Core/CrHash.h"
+#include "Core/Streams/CrBufferStream.h"
+
+#include "Math/CrHlslppVectorFloatType.h"
+
+#include "crstl/intrusive_ptr.h"
+#include "crstl/open_hashmap.h"
+#include "crstl/vector.h"
+
+#include <string.h>
+#include <type_traits>
+
+namespace crgfx
+{
+	namespace CommandStreamVersion
+	{
+		enum T : uint32_t
+		{
+			InitialVersion,
+			CurrentVersion = InitialVersion
+		};
+	};
+
+	// One per public command buffer call. Overloads that forward to another call are recorded as that one
+	namespace CommandStreamOp
+	{
+		enum T : uint8_t
+		{
+			SetViewport,
+			SetScissor,
+			SetStencilRef,
+			BindIndexBuffer,
+			BindVertexBuffer,
+			BindConstantBuffer,
+			BindSampler,
+			BindTexture,
+			BindRWTexture,
+			BindStorageBuffer,
+			BindRWStorageBuffer,
+			BindRWTypedBuffer,
+			BindGraphicsPipelineState,
+			BindComputePipelineState,
+			ClearRenderTarget,
+			Draw,
+			DrawIndexed,
+			Dispatch,
+			DrawIndirect,
+			DrawIndexedIndirect,
+			DispatchIndirect,
+			BeginDebugEvent,
+			EndDebugEvent,
+			InsertDebugMarker,
+			BeginTimestampQuery,
+			EndTimestampQuery,
+			ResetGPUQueries,
+			ResolveGPUQueries,
+			BeginRenderPass,
+			EndRenderPass,
+			Count
+		};
+
+		inline const char* ToString(crgfx::CommandStreamOp::T op)
+		{
+			switch (op)
+			{
+				case SetViewport: return "SetViewport";
+				case SetScissor: return "SetScissor";
+				case SetStencilRef: return "SetStencilRef";
+				case BindIndexBuffer: return "BindIndexBuffer";
+				case BindVertexBuffer: return "BindVertexBuffer";
+				case BindConstantBuffer: return "BindConstantBuffer";
+				case BindSampler: return "BindSampler";
+				case BindTexture: return "BindTexture";
+				case BindRWTexture: return "BindRWTexture";
+				case BindStorageBuffer: return "BindStorageBuffer";
+				case BindRWStorageBuffer: return "BindRWStorageBuffer";
+				case BindRWTypedBuffer: return "BindRWTypedBuffer";
+				case BindGraphicsPipelineState: return "BindGraphicsPipelineState";
+				case BindComputePipelineState: return "BindComputePipelineState";
+				case ClearRenderTarget: return "ClearRenderTarget";
+				case Draw: return "Draw";
+				case DrawIndexed: return "DrawIndexed";
+				case Dispatch: return "Dispatch";
+				case DrawIndirect: return "DrawIndirect";
+				case DrawIndexedIndirect: return "DrawIndexedIndirect";
+				case DispatchIndirect: return "DispatchIndirect";
+				case BeginDebugEvent: return "BeginDebugEvent";
+				case EndDebugEvent: return "EndDebugEvent";
+				case InsertDebugMarker: return "InsertDebugMarker";
+				case BeginTimestampQuery: return "BeginTimestampQuery";
+				case EndTimestampQuery: return "EndTimestampQuery";
+				case ResetGPUQueries: return "ResetGPUQueries";
+				case ResolveGPUQueries: return "ResolveGPUQueries";
+				case BeginRenderPass: return "BeginRenderPass";
+				case EndRenderPass: return "EndRenderPass";
+				default: return "";
+			}
+		}
+	};
+
+	namespace CommandStreamResourceType
+	{
+		enum T : uint32_t
+		{
+			Buffer,
+			Texture,
+			Sampler,
+			GraphicsPipeline,
+			ComputePipeline,
+			QueryPool,
+			Count
+		};
+	};
+
+	// What a resource was created with. Enough to create a stand-in for buffers, textures and query pools, but not
+	// for pipelines, which need their shaders
+	struct CommandStreamResourceDescription
+	{
+		CommandStreamResourceType::T type;
+		uint32_t usage;
+		uint32_t access;
+		uint32_t format;
+		uint32_t numElements; // Query count for query pools
+		uint32_t strideBytes;
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;
+		uint32_t mipmapCount;
+		uint32_t arraySize;
+		uint32_t sampleCount;
+		uint32_t textureType; // Query type for query pools
+	};
+
+	// Compact binary recording of the calls made to a command buffer, set on it with SetCommandStream. Every command
+	// is an op followed by its arguments. Resources are indices into a table that describes them, so the same frame
+	// records the same bytes across runs and builds, and a stream can be replayed where the original resources don't
+	// exist. The contents of buffers aren't recorded, only the bindings that refer to them. Resources are kept alive
+	// by the stream until it's cleared
+	class CommandStream
+	{
+	public:
+
+		static const uint32_t NullResource = 0xffffffff;
+
+		void Clear();
+
+		template<typename... ArgsT>
+		void Record(crgfx::CommandStreamOp::T op, const ArgsT&... args)
+		{
+			m_commandOffsets.push_back((uint32_t)m_data.size());
+			WriteArgument(op);
+			(WriteArgument(args), ...);
+		}
+
+		const crstl::vector<uint8_t>& GetData() const { return m_data; }
+
+		uint32_t GetCommandCount() const { return (uint32_t)m_commandOffsets.size(); }
+
+		// Where the command starts in the data, i.e. where its op is
+		uint32_t GetCommandOffset(uint32_t commandIndex) const { return m_commandOffsets[commandIndex]; }
+
+		crgfx::CommandStreamOp::T GetCommandOp(uint32_t commandIndex) const { return (crgfx::CommandStreamOp::T)m_data[m_commandOffsets[commandIndex]]; }
+
+		uint32_t GetResourceCount() const { return (uint32_t)m_resourceDescriptions.size(); }
+
+		const CommandStreamResourceDescription& GetResourceDescription(uint32_t resourceIndex) const { return m_resourceDescriptions[resourceIndex]; }
+
+		// The resource that was recorded. Null in streams that were loaded from a file
+		GPUAutoDeletable* GetResource(uint32_t resourceIndex) const { return m_resources[resourceIndex].get(); }
+
+		// Covers the commands and the resource descriptions. Equal hashes mean both builds recorded the same frame
+		CrHash ComputeHash() const;
+
+		// Index of the first command whose encoding differs, or the command count if the streams are the same. Resources
+		// compare by index, which is the order they were first used in
+		uint32_t FindFirstDifference(const CommandStream& other) const;
+
+		void Save(const char* filePath) const;
+
+		bool Load(const char* filePath);
+
+	private:
+
+		void WriteBytes(const void* data, uint32_t sizeBytes)
+		{
+			size_t offset = m_data.size();
+			m_data.resize(offset + sizeBytes);
+			memcpy(&m_data[offset], data, sizeBytes);
+		}
+
+		template<typename T>
+		void WriteArgument(const T& value)
+		{
+			static_assert(!std::is_pointer<T>::value, "Pointers must be recorded as resources");
+			static_assert(std::is_trivially_copyable<T>::value, "Arguments are recorded as they are");
+			WriteBytes(&value, sizeof(value));
+		}
+
+		void WriteArgument(const float4& value);
+
+		void WriteArgument(const crgfx::TextureView& view) { WriteArgument(view.key); }
+
+		void WriteArgument(const crgfx::TextureState& state);
+
+		void WriteArgument(const CrGPUQueryId& query) { WriteArgument(query.id); }
+
+		// Length includes the terminator, so replays can point at the string in the stream
+		void WriteArgument(const char* string);
+
+		void WriteArgument(const crgfx::RenderTargetDescriptor& renderTarget);
+
+		void WriteArgument(const crgfx::RenderPassBufferDescriptor& bufferTransition);
+
+		void WriteArgument(const crgfx::RenderPassTextureDescriptor& textureTransition);
+
+		void WriteArgument(const crgfx::RenderPassDescriptor& renderPass);
+
+		void WriteArgument(const IHardwareGPUBuffer* buffer) { WriteArgument(AddResource(buffer)); }
+
+		void WriteArgument(const crgfx::ITexture* texture) { WriteArgument(AddResource(texture)); }
+
+		void WriteArgument(const crgfx::ISampler* sampler) { WriteArgument(AddResource(sampler)); }
+
+		void WriteArgument(const IGraphicsPipeline* graphicsPipeline) { WriteArgument(AddResource(graphicsPipeline)); }
+
+		void WriteArgument(const IComputePipeline* computePipeline) { WriteArgument(AddResource(computePipeline)); }
+
+		void WriteArgument(const IGPUQueryPool* queryPool) { WriteArgument(AddResource(queryPool)); }
+
+		// Returns the index of the resource in the table, adding it the first time it's seen
+		uint32_t AddResource(const IHardwareGPUBuffer* buffer);
+
+		uint32_t AddResource(const crgfx::ITexture* texture);
+
+		uint32_t AddResource(const crgfx::ISampler* sampler);
+
+		uint32_t AddResource(const IGraphicsPipeline* graphicsPipeline);
+
+		uint32_t AddResource(const IComputePipeline* computePipeline);
+
+		uint32_t AddResource(const IGPUQueryPool* queryPool);
+
+		// Looks the resource up, or adds it with an empty description of the given type that the caller fills in
+		uint32_t FindOrAddResource(const GPUAutoDeletable* resource, crgfx::CommandStreamResourceType::T type, bool& added);
+
+		crstl::vector<uint8_t> m_data;
+
+		crstl::vector<uint32_t> m_commandOffsets;
+
+		crstl::vector<CommandStreamResourceDescription> m_resourceDescriptions;
+
+		crstl::vector<crstl::intrusive_ptr<GPUAutoDeletable>> m_resources;
+
+		crstl::open_hashmap<uint64_t, uint32_t> m_resourceIndices;
+	};
+
+	struct CommandStreamReplayStatistics
+	{
+		uint32_t commandCount = 0;
+
+		// Commands that referenced resources that couldn't be resolved, and draws or dispatches that depended on them
+		uint32_t skippedCommandCount = 0;
+
+		float replayMilliseconds = 0.0f;
+	};
+
+	// Records a command stream into a command buffer through its public interface, so everything the engine does on
+	// top of the platform layer runs again, without the engine code that originally issued the calls. Resources that
+	// were recorded on the same device are used directly. Anything else needs to be provided with SetResource, or
+	// created with CreateStandInResources. Pipelines can't be created from a stream, so replaying on another device
+	// needs them mapped by hand, and draws and dispatches are skipped until a pipeline that can be resolved is bound
+	class CommandStreamReplayer
+	{
+	public:
+
+		CommandStreamReplayer(const CommandStream& commandStream);
+
+		// The resource must be of the type the stream describes for this index
+		void SetResource(uint32_t resourceIndex, GPUAutoDeletable* resource);
+
+		// Creates buffers, textures, samplers and query pools from their descriptions for those that can't be
+		// resolved on this device. Their contents are undefined
+		void CreateStandInResources(crgfx::IDevice* renderDevice);
+
+		// The command buffer must be recording. Returns false if the stream is malformed, in which case the command
+		// buffer may be left inside a render pass or debug event
+		bool Replay(crgfx::ICommandBuffer* commandBuffer, CommandStreamReplayStatistics& statistics);
+
+	private:
+
+		GPUAutoDeletable* ResolveResource(uint32_t resourceIndex, const crgfx::IDevice* renderDevice) const;
+
+		// Reads a resource index and looks up what it resolved to. False if it didn't resolve, or isn't of the type
+		// the command expects. Null resources are valid
+		template<typename T>
+		bool ReadResource(CrReadBufferStream& stream, crgfx::CommandStreamResourceType::T type, const T*& resource) const;
+
+		// False if any of the render targets or transitions didn't resolve
+		bool ReadRenderTarget(CrReadBufferStream& stream, crgfx::RenderTargetDescriptor& renderTarget) const;
+
+		bool ReadRenderPass(CrReadBufferStream& stream, crgfx::RenderPassDescriptor& renderPass) const;
+
+		const CommandStream& m_commandStream;
+
+		// Resources set by hand or created as stand-ins, indexed like the stream's table
+		crstl::vector<crstl::intrusive_ptr<GPUAutoDeletable>> m_resources;
+
+		// What every index resolves to during a replay, null where it couldn't be resolved
+		crstl::vector<GPUAutoDeletable*> m_resolvedResources;
+	};
+};
@@ -6,8 +6,11 @@
 #include "Graphics/IShader.h"
 #include "Graphics/CrRendererConfig.h"
 #include "Graphics/CrCommonVertexLayouts.h"
+#include "Graphics/CrShaderManager.h"
+#include "Graphics/CrShaderSources.h"
 
 #include "Core/CrGlobalPaths.h"
+#include "Core/Threading/CrThreadPool.h"
 #include "crstl/process.h"
 
 #include "GeneratedShaders/BuiltinShaders.h"
@@ -26,6 +29,16 @@ void CrBuiltinPipelines::Deinitialize()
 	delete BuiltinPipelines;
 }
 
+CrBuiltinPipelines::~CrBuiltinPipelines()
+{
+	// Recompilations in flight write into m_recompilations, so they need to finish before it goes away
+	if (m_recompilationThreadPool)
+	{
+		m_recompilationThreadPool->Wait();
+		m_recompilationThreadPool = nullptr;
+	}
+}
+
 CrBuiltinPipelines::CrBuiltinPipelines()
 {
 	// Builtin ubershaders
@@ -79,9 +92,9 @@ crgfx::GraphicsPipelineHandle CrBuiltinPipelines::GetGraphicsPipeline
 		const crgfx::DeviceProperties& properties = device->GetProperties();
 
 		crgfx::GraphicsShaderDescriptor graphicsShaderDescriptor;
-		graphicsShaderDescriptor.m_debugName += CrBuiltinShaders::GetMetadata(vertexShaderIndex, properties.graphicsApi).name.c_str();
+		graphicsShaderDescriptor.m_debugName += CrBuiltinShaders::GetMetadata(vertexShaderIndex, crgfx::GraphicsApi::GetShaderApi(properties.graphicsApi)).name.c_str();
 		graphicsShaderDescriptor.m_debugName += "_";
-		graphicsShaderDescriptor.m_debugName += CrBuiltinShaders::GetMetadata(pixelShaderIndex, properties.graphicsApi).name.c_str();
+		graphicsShaderDescriptor.m_debugName += CrBuiltinShaders::GetMetadata(pixelShaderIndex, crgfx::GraphicsApi::GetShaderApi(properties.graphicsApi)).name.c_str();
 		graphicsShaderDescriptor.m_bytecodes.push_back(vertexShaderBytecode);
 		graphicsShaderDescriptor.m_bytecodes.push_back(pixelShaderBytecode);
 
@@ -112,7 +125,7 @@ crgfx::ComputePipelineHandle CrBuiltinPipelines::GetComputePipeline(CrBuiltinCom
 		const crgfx::DeviceProperties& properties = renderDevice->GetProperties();
 
 		crgfx::ComputeShaderDescriptor computeShaderDescriptor;
-		computeShaderDescriptor.m_debugName = CrBuiltinCompute::GetMetadata(computeShaderIndex, properties.graphicsApi).name.c_str();
+		computeShaderDescriptor.m_debugName = CrBuiltinCompute::GetMetadata(computeShaderIndex, crgfx::GraphicsApi::GetShaderApi(properties.graphicsApi)).name.c_str();
 		computeShaderDescriptor.m_bytecode = crgfx::GetBuiltinComputeBytecode(computeShaderIndex);
 
 		crgfx::ComputeShaderHandle shader = renderDevice->CreateComputeShader(computeShaderDescriptor);
@@ -130,6 +143,12 @@ void CrBuiltinPipelines::RecompileBuiltinPipelines()
 {
 #if !defined(CR_CONFIG_FINAL)
 
+	// Let any background recompilation finish first, it will be applied on the next update
+	if (m_recompilationThreadPool)
+	{
+		m_recompilationThreadPool->Wait();
+	}
+
 	crgfx::IDevice* device = crgfx::GetDevice().get();
 	
 	const crgfx::DeviceProperties& deviceProperties = device->GetProperties();
@@ -151,7 +170,7 @@ void CrBuiltinPipelines::RecompileBuiltinPipelines()
 	commandLine += " -platform windows";
 	
 	commandLine += " -graphicsapi ";
-	commandLine += crgfx::GraphicsApi::ToString(deviceProperties.graphicsApi);
+	commandLine += crgfx::GraphicsApi::ToString(crgfx::GraphicsApi::GetShaderApi(deviceProperties.graphicsApi));
 	
 	crstl::process process
 	(
@@ -165,76 +184,47 @@ void CrBuiltinPipelines::RecompileBuiltinPipelines()
 
 		if (exitStatus.get_exit_code() == 0)
 		{
-			// Load the new pipelines after compilation
-			// Make sure we idle the device before attempting recompilation as this will destroy pipelines that could be in flight
-			device->WaitIdle();
+			// Load the new bytecode after compilation
+			crstl::vector<bool> modifiedGraphicsShaders(CrBuiltinShaders::Count, false);
+			crstl::vector<bool> modifiedComputeShaders(CrBuiltinCompute::Count, false);
 
-			for (auto iter = m_builtinComputePipelines.begin(); iter != m_builtinComputePipelines.end(); ++iter)
+			for (uint32_t i = 0; i < CrBuiltinCompute::Count; ++i)
 			{
-				crgfx::ComputePipelineHandle& computePipeline = iter->second;
-
-				const CrBuiltinComputeMetadata& builtinShaderMetadata = CrBuiltinCompute::GetMetadata(computePipeline->GetComputeShaderIndex(), deviceProperties.graphicsApi);
+				const CrBuiltinComputeMetadata& builtinShaderMetadata = CrBuiltinCompute::GetMetadata((CrBuiltinCompute::T)i, crgfx::GraphicsApi::GetShaderApi(deviceProperties.graphicsApi));
 
 				CrFixedPath binaryPath = outputPath;
 				binaryPath /= builtinShaderMetadata.uniqueBinaryName;
 
-				CrReadFileStream shaderBytecodeStream(binaryPath.c_str());
+				CrMappedFileStream shaderBytecodeFile(binaryPath.c_str());
 
-				if (shaderBytecodeStream.GetFile())
+				if (shaderBytecodeFile)
 				{
 					const crgfx::ShaderBytecodeHandle& bytecode = crgfx::ShaderBytecodeHandle(new crgfx::ShaderBytecode());
-					shaderBytecodeStream << *bytecode.get();
-
-					crgfx::ComputeShaderDescriptor computeShaderDescriptor;
-					computeShaderDescriptor.m_debugName = builtinShaderMetadata.name.c_str();
-					computeShaderDescriptor.m_bytecode = bytecode;
-
-					crgfx::ComputeShaderHandle shader = device->CreateComputeShader(computeShaderDescriptor);
-
-					computePipeline->Recompile(device, shader);
+					shaderBytecodeFile.GetStream() << *bytecode.get();
+					crgfx::SetBuiltinComputeBytecode((CrBuiltinCompute::T)i, bytecode);
+					modifiedComputeShaders[i] = true;
 				}
 			}
 
-			for (auto iter = m_builtinGraphicsPipelines.begin(); iter != m_builtinGraphicsPipelines.end(); ++iter)
+			for (uint32_t i = 0; i < CrBuiltinShaders::Count; ++i)
 			{
-				crgfx::GraphicsPipelineHandle& graphicsPipeline = iter->second;
-
-				const CrBuiltinShaderMetadata& vertexShaderMetadata = CrBuiltinShaders::GetMetadata(graphicsPipeline->GetVertexShaderIndex(), deviceProperties.graphicsApi);
-				const CrBuiltinShaderMetadata& pixelShaderMetadata = CrBuiltinShaders::GetMetadata(graphicsPipeline->GetPixelShaderIndex(), deviceProperties.graphicsApi);
-
-				crgfx::GraphicsShaderDescriptor graphicsShaderDescriptor;
-				graphicsShaderDescriptor.m_debugName += vertexShaderMetadata.name.c_str();
-				graphicsShaderDescriptor.m_debugName += "_";
-				graphicsShaderDescriptor.m_debugName += pixelShaderMetadata.name.c_str();
-
-				CrFixedPath vertexBinaryPath = outputPath;
-				vertexBinaryPath /= vertexShaderMetadata.uniqueBinaryName;
-
-				CrReadFileStream vertexShaderBytecodeStream(vertexBinaryPath.c_str());
+				const CrBuiltinShaderMetadata& builtinShaderMetadata = CrBuiltinShaders::GetMetadata((CrBuiltinShaders::T)i, crgfx::GraphicsApi::GetShaderApi(deviceProperties.graphicsApi));
 
-				if (vertexShaderBytecodeStream.GetFile())
-				{
-					const crgfx::ShaderBytecodeHandle& bytecode = crgfx::ShaderBytecodeHandle(new crgfx::ShaderBytecode());
-					vertexShaderBytecodeStream << *bytecode.get();
-					graphicsShaderDescriptor.m_bytecodes.push_back(bytecode);
-				}
-
-				CrFixedPath pixelBinaryPath = outputPath;
-				pixelBinaryPath /= pixelShaderMetadata.uniqueBinaryName;
+				CrFixedPath binaryPath = outputPath;
+				binaryPath /= builtinShaderMetadata.uniqueBinaryName;
 
-				CrReadFileStream pixelShaderBytecodeStream(pixelBinaryPath.c_str());
+				CrMappedFileStream shaderBytecodeFile(binaryPath.c_str());
 
-				if (pixelShaderBytecodeStream.GetFile())
+				if (shaderBytecodeFile)
 				{
 					const crgfx::ShaderBytecodeHandle& bytecode = crgfx::ShaderBytecodeHandle(new crgfx::ShaderBytecode());
-					pixelShaderBytecodeStream << *bytecode.get();
-					graphicsShaderDescriptor.m_bytecodes.push_back(bytecode);
+					shaderBytecodeFile.GetStream() << *bytecode.get();
+					crgfx::SetBuiltinShaderBytecode((CrBuiltinShaders::T)i, bytecode);
+					modifiedGraphicsShaders[i] = true;
 				}
-
-				crgfx::GraphicsShaderHandle shader = device->CreateGraphicsShader(graphicsShaderDescriptor);
-
-				graphicsPipeline->Recompile(device, shader);
 			}
+
+			RecompilePipelines(modifiedGraphicsShaders, modifiedComputeShaders);
 		}
 		else
 		{
@@ -251,4 +241,203 @@ void CrBuiltinPipelines::RecompileBuiltinPipelines()
 	}
 
 #endif
-}
\ No newline at end of file
+}
+
+void CrBuiltinPipelines::Update()
+{
+#if !defined(CR_CONFIG_FINAL)
+
+	if (!m_recompilations.empty())
+	{
+		// Only swap pipelines once every affected shader is ready, so that we never render a frame with a mix of old and new ones
+		if (m_recompilationThreadPool->IsIdle())
+		{
+			FinishRecompilation();
+		}
+	}
+	else
+	{
+		// Sources that change while we're recompiling stay queued in the file watcher until we're done
+		crstl::vector<crstl::string> modifiedSources;
+		ShaderSources->Update(modifiedSources);
+
+		if (!modifiedSources.empty())
+		{
+			StartRecompilation(modifiedSources);
+		}
+	}
+
+#endif
+}
+
+void CrBuiltinPipelines::StartRecompilation(const crstl::vector<crstl::string>& modifiedSources)
+{
+	crgfx::GraphicsApi::T graphicsApi = crgfx::GraphicsApi::GetShaderApi(crgfx::GetDevice()->GetProperties().graphicsApi);
+
+	// Jobs take a copy of everything they need so that they don't read the shader sources while they change
+	const auto AddRecompilation = [this, &modifiedSources](uint32_t shaderIndex, bool isCompute, crgfx::ShaderStage::T shaderStage,
+		const crstl::string& entryPoint, const crstl::string& sourceFile, const crstl::string& defines)
+	{
+		// Shaders without an entry point have no code for this graphics API
+		if (!entryPoint.empty() && !sourceFile.empty() && ShaderSources->DependsOnAny(sourceFile, modifiedSources))
+		{
+			CrBuiltinShaderRecompilation recompilation;
+			recompilation.shaderIndex = shaderIndex;
+			recompilation.isCompute = isCompute;
+			recompilation.shaderStage = shaderStage;
+			recompilation.sourcePath = ShaderSources->GetShaderSourcePath(sourceFile);
+			recompilation.entryPoint = entryPoint;
+
+			defines.split(';', [&recompilation](const crstl::string_view& view)
+			{
+				if (!view.empty())
+				{
+					recompilation.defines.AddDefine(crstl::string(view));
+				}
+			});
+
+			m_recompilations.push_back(recompilation);
+		}
+	};
+
+	for (uint32_t i = 0; i < CrBuiltinShaders::Count; ++i)
+	{
+		const CrBuiltinShaderMetadata& metadata = CrBuiltinShaders::GetMetadata((CrBuiltinShaders::T)i, graphicsApi);
+		AddRecompilation(i, false, metadata.shaderStage, metadata.entryPoint, metadata.sourceFile, metadata.defines);
+	}
+
+	for (uint32_t i = 0; i < CrBuiltinCompute::Count; ++i)
+	{
+		const CrBuiltinComputeMetadata& metadata = CrBuiltinCompute::GetMetadata((CrBuiltinCompute::T)i, graphicsApi);
+		AddRecompilation(i, true, crgfx::ShaderStage::Compute, metadata.entryPoint, metadata.sourceFile, metadata.defines);
+	}
+
+	if (m_recompilations.empty())
+	{
+		return;
+	}
+
+	if (!m_recompilationThreadPool)
+	{
+		m_recompilationThreadPool = crstl::unique_ptr<CrThreadPool>(new CrThreadPool());
+	}
+
+	CrLog("Recompiling %llu builtin shaders in the background", (uint64_t)m_recompilations.size());
+
+	for (CrBuiltinShaderRecompilation& recompilation : m_recompilations)
+	{
+		CrBuiltinShaderRecompilation* recompilationPointer = &recompilation;
+
+		m_recompilationThreadPool->Submit([recompilationPointer, graphicsApi]()
+		{
+			// A source that was deleted leaves the bytecode empty, which cancels the swap
+			if (!recompilationPointer->sourcePath.empty())
+			{
+				CrShaderBytecodeCompilationDescriptor bytecodeDescriptor(recompilationPointer->sourcePath, crstl::fixed_string128(recompilationPointer->entryPoint.c_str()),
+					recompilationPointer->shaderStage, graphicsApi, cr::Platform::Current);
+
+				recompilationPointer->bytecode = ShaderManager->CompileShaderBytecode(bytecodeDescriptor, recompilationPointer->defines);
+			}
+		});
+	}
+}
+
+void CrBuiltinPipelines::FinishRecompilation()
+{
+	bool success = true;
+
+	for (const CrBuiltinShaderRecompilation& recompilation : m_recompilations)
+	{
+		success &= recompilation.bytecode.get() != nullptr;
+	}
+
+	if (success)
+	{
+		crstl::vector<bool> modifiedGraphicsShaders(CrBuiltinShaders::Count, false);
+		crstl::vector<bool> modifiedComputeShaders(CrBuiltinCompute::Count, false);
+
+		for (const CrBuiltinShaderRecompilation& recompilation : m_recompilations)
+		{
+			if (recompilation.isCompute)
+			{
+				crgfx::SetBuiltinComputeBytecode((CrBuiltinCompute::T)recompilation.shaderIndex, recompilation.bytecode);
+				modifiedComputeShaders[recompilation.shaderIndex] = true;
+			}
+			else
+			{
+				crgfx::SetBuiltinShaderBytecode((CrBuiltinShaders::T)recompilation.shaderIndex, recompilation.bytecode);
+				modifiedGraphicsShaders[recompilation.shaderIndex] = true;
+			}
+		}
+
+		RecompilePipelines(modifiedGraphicsShaders, modifiedComputeShaders);
+
+		CrLog("Reloaded %llu builtin shaders", (uint64_t)m_recompilations.size());
+	}
+	else
+	{
+		// Keep every pipeline as it was until the sources compile again
+		CrLog("Builtin shaders failed to compile. Keeping previous pipelines");
+	}
+
+	m_recompilations.clear();
+}
+
+void CrBuiltinPipelines::RecompilePipelines(const crstl::vector<bool>& modifiedGraphicsShaders, const crstl::vector<bool>& modifiedComputeShaders)
+{
+#if !defined(CR_CONFIG_FINAL)
+
+	crgfx::IDevice* device = crgfx::GetDevice().get();
+
+	const crgfx::DeviceProperties& deviceProperties = device->GetProperties();
+
+	// Make sure we idle the device before attempting recompilation as this will destroy pipelines that could be in flight
+	device->WaitIdle();
+
+	for (auto iter = m_builtinComputePipelines.begin(); iter != m_builtinComputePipelines.end(); ++iter)
+	{
+		crgfx::ComputePipelineHandle& computePipeline = iter->second;
+
+		CrBuiltinCompute::T computeShaderIndex = computePipeline->GetComputeShaderIndex();
+
+		if (modifiedComputeShaders[computeShaderIndex])
+		{
+			crgfx::ComputeShaderDescriptor computeShaderDescriptor;
+			computeShaderDescriptor.m_debugName = CrBuiltinCompute::GetMetadata(computeShaderIndex, crgfx::GraphicsApi::GetShaderApi(deviceProperties.graphicsApi)).name.c_str();
+			computeShaderDescriptor.m_bytecode = crgfx::GetBuiltinComputeBytecode(computeShaderIndex);
+
+			crgfx::ComputeShaderHandle shader = device->CreateComputeShader(computeShaderDescriptor);
+
+			computePipeline->Recompile(device, shader);
+		}
+	}
+
+	for (auto iter = m_builtinGraphicsPipelines.begin(); iter != m_builtinGraphicsPipelines.end(); ++iter)
+	{
+		crgfx::GraphicsPipelineHandle& graphicsPipeline = iter->second;
+
+		CrBuiltinShaders::T vertexShaderIndex = graphicsPipeline->GetVertexShaderIndex();
+		CrBuiltinShaders::T pixelShaderIndex = graphicsPipeline->GetPixelShaderIndex();
+
+		if (modifiedGraphicsShaders[vertexShaderIndex] || modifiedGraphicsShaders[pixelShaderIndex])
+		{
+			crgfx::GraphicsShaderDescriptor graphicsShaderDescriptor;
+			graphicsShaderDescriptor.m_debugName += CrBuiltinShaders::GetMetadata(vertexShaderIndex, crgfx::GraphicsApi::GetShaderApi(deviceProperties.graphicsApi)).name.c_str();
+			graphicsShaderDescriptor.m_debugName += "_";
+			graphicsShaderDescriptor.m_debugName += CrBuiltinShaders::GetMetadata(pixelShaderIndex, crgfx::GraphicsApi::GetShaderApi(deviceProperties.graphicsApi)).name.c_str();
+			graphicsShaderDescriptor.m_bytecodes.push_back(crgfx::GetBuiltinShaderBytecode(vertexShaderIndex));
+			graphicsShaderDescriptor.m_bytecodes.push_back(crgfx::GetBuiltinShaderBytecode(pixelShaderIndex));
+
+			crgfx::GraphicsShaderHandle shader = device->CreateGraphicsShader(graphicsShaderDescriptor);
+
+			graphicsPipeline->Recompile(device, shader);
+		}
+	}
+
+#else
+
+	unused_parameter(modifiedGraphicsShaders);
+	unused_parameter(modifiedComputeShaders);
+
+#endif
+}
@@ -3,12 +3,39 @@
 #include "Graphics/CrGraphicsForwardDeclarations.h"
 #include "Graphics/IPipeline.h"
 #include "Graphics/VertexDescriptor.h"
+#include "Graphics/IShader.h"
+
+#include "Core/FileSystem/CrFixedPath.h"
 
 #include "crstl/open_hashmap.h"
+#include "crstl/string.h"
+#include "crstl/unique_ptr.h"
+#include "crstl/vector.h"
+
+class CrThreadPool;
 
 namespace CrBuiltinShaders { enum T : uint32_t; }
 namespace CrBuiltinCompute { enum T : uint32_t; }
 
+// A builtin shader being recompiled in the background because one of its sources changed
+struct CrBuiltinShaderRecompilation
+{
+	uint32_t shaderIndex = 0;
+
+	bool isCompute = false;
+
+	crgfx::ShaderStage::T shaderStage;
+
+	CrFixedPath sourcePath;
+
+	crstl::string entryPoint;
+
+	CrShaderCompilerDefines defines;
+
+	// Empty until compiled, and if compilation fails
+	crgfx::ShaderBytecodeHandle bytecode;
+};
+
 // A collection of all builtin pipelines compiled on boot. They are available to any program that wants them
 class CrBuiltinPipelines
 {
@@ -28,8 +55,14 @@ public:
 
 	crgfx::ComputePipelineHandle GetComputePipeline(CrBuiltinCompute::T computeShader);
 
+	// Recompiles every builtin shader and waits for it
 	void RecompileBuiltinPipelines();
 
+	// Checks for modified shader sources and recompiles the shaders that depend on them in the background. Once
+	// all of them have finished, the affected pipelines are swapped in together. Must be called at the start of
+	// the frame, before any pipeline is used
+	void Update();
+
 	// Ubershader builtin pipelines
 
 	crgfx::GraphicsPipelineHandle BasicUbershaderForward;
@@ -42,9 +75,24 @@ private:
 
 	CrBuiltinPipelines();
 
+	~CrBuiltinPipelines();
+
+	void StartRecompilation(const crstl::vector<crstl::string>& modifiedSources);
+
+	void FinishRecompilation();
+
+	// Recreates the pipelines that use any of the flagged shaders from the current builtin bytecode
+	void RecompilePipelines(const crstl::vector<bool>& modifiedGraphicsShaders, const crstl::vector<bool>& modifiedComputeShaders);
+
 	crstl::open_hashmap<uint64_t, crgfx::GraphicsPipelineHandle> m_builtinGraphicsPipelines;
 
 	crstl::open_hashmap<uint64_t, crgfx::ComputePipelineHandle> m_builtinComputePipelines;
+
+	// Created the first time sources change. Jobs only write to the bytecode of their own recompilation, and we only
+	// read them once the pool is idle
+	crstl::unique_ptr<CrThreadPool> m_recompilationThreadPool;
+
+	crstl::vector<CrBuiltinShaderRecompilation> m_recompilations;
 };
 
 extern CrBuiltinPipelines* BuiltinPipelines;
\ No newline at end of file
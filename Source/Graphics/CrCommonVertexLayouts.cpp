@@ -18,6 +18,26 @@ crgfx::VertexDescriptor PositionVertexDescriptor
 	crgfx::VertexAttribute(crgfx::VertexSemantic::Position, crgfx::DataFormat::RGBA16_Float, 0),
 });
 
+crgfx::VertexDescriptor PositionUnorm16VertexDescriptor
+({
+	crgfx::VertexAttribute(crgfx::VertexSemantic::Position, crgfx::DataFormat::RGBA16_Unorm, 0),
+});
+
+crgfx::VertexDescriptor PositionUnorm10VertexDescriptor
+({
+	crgfx::VertexAttribute(crgfx::VertexSemantic::Position, crgfx::DataFormat::RGB10A2_Unorm, 0),
+});
+
+const crgfx::VertexDescriptor& GetPositionVertexDescriptor(CrVertexPositionFormat::T positionFormat)
+{
+	switch (positionFormat)
+	{
+		case CrVertexPositionFormat::Unorm16: return PositionUnorm16VertexDescriptor;
+		case CrVertexPositionFormat::Unorm10: return PositionUnorm10VertexDescriptor;
+		default: return PositionVertexDescriptor;
+	}
+}
+
 crgfx::VertexDescriptor AdditionalVertexDescriptor
 ({
 	crgfx::VertexAttribute(crgfx::VertexSemantic::Color, crgfx::DataFormat::RGBA8_Unorm, 0),
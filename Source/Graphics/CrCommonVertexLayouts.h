@@ -14,11 +14,35 @@ struct SimpleVertex
 extern crgfx::VertexDescriptor SimpleVertexDescriptor;
 extern crgfx::VertexDescriptor NullVertexDescriptor;
 
+namespace CrVertexPositionFormat
+{
+	enum T : uint8_t
+	{
+		Half,    // Model space positions in RGBA16_Float
+		Unorm16, // Positions relative to the bounds of the mesh in RGBA16_Unorm
+		Unorm10, // Positions relative to the bounds of the mesh in RGB10A2_Unorm
+		Count
+	};
+};
+
 struct ComplexVertexPosition
 {
 	crgfx::VertexElement<half, crgfx::DataFormat::RGBA16_Float> position;
 };
 
+// Quantized positions cover the cube around the bounds of the mesh, so that going back to model space is a uniform
+// scale and a translation the renderer folds into the transform of the mesh. Normals don't need to change
+struct ComplexVertexPositionUnorm16
+{
+	crgfx::VertexElement<uint16_t, crgfx::DataFormat::RGBA16_Unorm> position;
+};
+
+struct ComplexVertexPositionUnorm10
+{
+	// 10 bits per component, with x in the lowest bits
+	uint32_t position;
+};
+
 struct ComplexVertexAdditional
 {
 	crgfx::VertexElement<uint8_t, crgfx::DataFormat::RGBA8_Unorm> color;
@@ -29,6 +53,12 @@ struct ComplexVertexAdditional
 
 extern crgfx::VertexDescriptor PositionVertexDescriptor;
 
+extern crgfx::VertexDescriptor PositionUnorm16VertexDescriptor;
+
+extern crgfx::VertexDescriptor PositionUnorm10VertexDescriptor;
+
+const crgfx::VertexDescriptor& GetPositionVertexDescriptor(CrVertexPositionFormat::T positionFormat);
+
 extern crgfx::VertexDescriptor AdditionalVertexDescriptor;
 
 extern crgfx::VertexDescriptor ComplexVertexDescriptor;
\ No newline at end of file
@@ -13,6 +13,10 @@ crgfx::GraphicsApi::T crgfx::GraphicsApi::FromString(const char* graphicsApiStri
 	{
 		return crgfx::GraphicsApi::D3D12;
 	}
+	else if (strcmp(graphicsApiString, "null") == 0)
+	{
+		return crgfx::GraphicsApi::Null;
+	}
 	else
 	{
 		return crgfx::GraphicsApi::Count;
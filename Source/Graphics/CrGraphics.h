@@ -20,6 +20,7 @@ namespace crgfx
 			Vulkan,
 			D3D12,
 			Metal,
+			Null, // CPU-only device that validates what it records
 			Count
 		};
 
@@ -30,10 +31,18 @@ namespace crgfx
 				case crgfx::GraphicsApi::Vulkan: return lowercase ? "vulkan" : "Vulkan";
 				case crgfx::GraphicsApi::D3D12:  return lowercase ? "d3d12"  : "D3D12";
 				case crgfx::GraphicsApi::Metal:  return lowercase ? "metal"  : "Metal";
+				case crgfx::GraphicsApi::Null:   return lowercase ? "null"   : "Null";
 				default: return lowercase ? "invalid" : "Invalid";
 			}
 		}
 
+		// Api whose shader bytecode a device consumes. The null device has no bytecode of its own, it reads the
+		// reflection out of the Vulkan shaders
+		constexpr crgfx::GraphicsApi::T GetShaderApi(crgfx::GraphicsApi::T graphicsApi)
+		{
+			return graphicsApi == crgfx::GraphicsApi::Null ? crgfx::GraphicsApi::Vulkan : graphicsApi;
+		}
+
 		crgfx::GraphicsApi::T FromString(const char* graphicsApiString);
 	}
 
@@ -114,6 +114,10 @@ namespace crgfx
 	class IHardwareGPUBuffer;
 	using HardwareGPUBufferHandle = crstl::intrusive_ptr<IHardwareGPUBuffer>;
 	struct HardwareGPUBufferDescriptor;
+	struct UploadMemory;
+
+	using GPUUploadId = uint64_t; // Zero is never a valid upload
+	namespace UploadPriority { enum T : uint8_t; }
 
 	class GPUBuffer;
 	using GPUBufferHandle = crstl::intrusive_ptr<GPUBuffer>;
@@ -164,6 +168,9 @@ class CrMaterial;
 using CrMaterialHandle = crstl::intrusive_ptr<CrMaterial>;
 struct CrShaderCompilerDefines;
 
+class CrStreamedTexture;
+using CrStreamedTextureHandle = crstl::intrusive_ptr<CrStreamedTexture>;
+
 class CrRenderModel;
 using CrRenderModelHandle = crstl::intrusive_ptr<CrRenderModel>;
 
@@ -81,4 +81,17 @@ void CrMaterial::AddTexture(const crgfx::TextureHandle& texture, Textures::T sem
 	binding.texture = texture;
 	binding.semantic = semantic;
 	m_textures.push_back(binding);
-}
\ No newline at end of file
+}
+
+void CrMaterial::AddTexture(const CrStreamedTextureHandle& streamedTexture, Textures::T semantic)
+{
+	TextureBinding binding;
+	binding.streamedTexture = streamedTexture;
+	binding.semantic = semantic;
+	m_textures.push_back(binding);
+}
+
+const crgfx::ITexture* CrMaterial::TextureBinding::GetTexture() const
+{
+	return streamedTexture ? streamedTexture->GetTexture().get() : texture.get();
+}
@@ -5,6 +5,7 @@
 
 #include "Graphics/IPipeline.h"
 #include "Graphics/ITexture.h"
+#include "Graphics/CrStreamedTexture.h"
 #include "Graphics/CrGraphicsForwardDeclarations.h"
 
 #include "Math/CrHlslppVectorFloatType.h"
@@ -47,6 +48,16 @@ namespace CrRefraction
 	};
 };
 
+namespace CrMaterialTextureMode
+{
+	enum T
+	{
+		Untextured = 0,
+		Textured = 1,
+		Count
+	};
+};
+
 // This enum contains the number of shader variations for this shader
 // It says nothing about the state of the shader
 namespace CrMaterialShaderVariant
@@ -104,6 +115,19 @@ struct CrMaterialDescriptor
 	float4 color;
 
 	float4 emissive;
+
+	CrMaterialBlendMode::T blendMode = CrMaterialBlendMode::Opaque;
+
+	CrAlphaTestMode::T alphaTestMode = CrAlphaTestMode::Always;
+
+	CrRefraction::T refraction = CrRefraction::Disabled;
+
+	CrMaterialTextureMode::T textureMode = CrMaterialTextureMode::Textured;
+
+	// Leave as Count to compile for the platform and graphics API we're running on
+	cr::Platform::T platform = cr::Platform::Count;
+
+	crgfx::GraphicsApi::T graphicsApi = crgfx::GraphicsApi::Count;
 };
 
 // High-level description of a shader
@@ -113,7 +137,7 @@ struct CrMaterialShaderDescriptor
 
 	CrHash ComputeHash() const
 	{
-		return CrHash(this, sizeof(*this));
+		return CrHash(*this);
 	}
 
 	CrMaterialBlendMode::T blendMode = CrMaterialBlendMode::Opaque;
@@ -122,6 +146,8 @@ struct CrMaterialShaderDescriptor
 
 	CrRefraction::T refraction = CrRefraction::Disabled;
 
+	CrMaterialTextureMode::T textureMode = CrMaterialTextureMode::Textured;
+
 	// Per-pass data
 	CrMaterialShaderVariant::T shaderVariant = CrMaterialShaderVariant::GBuffer;
 
@@ -134,7 +160,7 @@ struct CrMaterialShaderDescriptor
 	crgfx::GraphicsApi::T graphicsApi = crgfx::GraphicsApi::Count;
 };
 
-static_assert(sizeof(CrMaterialShaderDescriptor) == 28, "CrMaterialShaderDescriptor size mismatch");
+static_assert(sizeof(CrMaterialShaderDescriptor) == 32, "CrMaterialShaderDescriptor size mismatch");
 
 class CrMaterial final : public crstl::intrusive_ptr_interface_delete
 {
@@ -148,11 +174,17 @@ public:
 
 	void AddTexture(const crgfx::TextureHandle& texture, Textures::T semantic);
 
+	void AddTexture(const CrStreamedTextureHandle& streamedTexture, Textures::T semantic);
+
 //private: TODO Fix
 
 	struct TextureBinding
 	{
+		// The texture that is resident right now if it's streamed
+		const crgfx::ITexture* GetTexture() const;
+
 		crgfx::TextureHandle texture;
+		CrStreamedTextureHandle streamedTexture;
 		Textures::T semantic;
 	};
 
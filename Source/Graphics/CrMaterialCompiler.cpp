@@ -7,9 +7,11 @@
 #include "Graphics/CrShaderManager.h"
 #include "Graphics/IShader.h"
 #include "Graphics/CrShaderSources.h"
+#include "Graphics/ShaderCompiler/CrShaderCompiler.h"
 
 #include "Core/CrGlobalPaths.h"
 #include "Core/CrPlatform.h"
+#include "Core/Threading/CrThreadPool.h"
 
 crstl::string CrShaderHeaderGenerator::HashDefine = "#define ";
 
@@ -31,6 +33,64 @@ const char* GetMaterialShaderEnum(CrMaterialShaderVariant::T materialShaderVaria
 	}
 }
 
+template<>
+const char* GetMaterialShaderEnum(CrMaterialBlendMode::T blendMode)
+{
+	switch (blendMode)
+	{
+		case CrMaterialBlendMode::Opaque:       return "EMaterialBlendMode_Opaque";
+		case CrMaterialBlendMode::AlphaBlend:   return "EMaterialBlendMode_AlphaBlend";
+		case CrMaterialBlendMode::Transparency: return "EMaterialBlendMode_Transparency";
+		case CrMaterialBlendMode::Additive:     return "EMaterialBlendMode_Additive";
+		default: return "Invalid";
+	}
+}
+
+template<>
+const char* GetMaterialShaderEnum(CrAlphaTestMode::T alphaTestMode)
+{
+	switch (alphaTestMode)
+	{
+		case CrAlphaTestMode::Always:       return "EAlphaTestMode_Always";
+		case CrAlphaTestMode::Equal:        return "EAlphaTestMode_Equal";
+		case CrAlphaTestMode::Greater:      return "EAlphaTestMode_Greater";
+		case CrAlphaTestMode::Less:         return "EAlphaTestMode_Less";
+		case CrAlphaTestMode::GreaterEqual: return "EAlphaTestMode_GreaterEqual";
+		case CrAlphaTestMode::LessEqual:    return "EAlphaTestMode_LessEqual";
+		default: return "Invalid";
+	}
+}
+
+// Every shader permutation a set of materials needs, after deduplication
+struct CrMaterialShaderPermutation
+{
+	CrMaterialShaderDescriptor descriptor;
+
+	CrShaderCompilerDefines defines;
+
+	CrShaderSourceDependencies dependencies;
+
+	CrHash hash;
+
+	crgfx::ShaderBytecodeHandle bytecode;
+};
+
+struct CrPreprocessedUbershader
+{
+	CrHash hash;
+
+	CrShaderSourceDependencies dependencies;
+};
+
+static const char* UbershaderEntryPoints[crgfx::ShaderStage::GraphicsStageCount] =
+{
+	"UbershaderVS",
+	"UbershaderPS",
+	"UbershaderHS",
+	"UbershaderDS",
+	"UbershaderGS",
+};
+
 void CrShaderHeaderGenerator::Define(const char* define)
 {
 	m_header += HashDefine + define + "\n";
@@ -61,119 +121,233 @@ void CrMaterialCompiler::Deinitialize()
 CrMaterialCompiler::CrMaterialCompiler()
 {
 	CrAssert(ShaderSources != nullptr);
-	m_bytecodeDiskCache = CrShaderDiskCache(ShaderSources->GetUbershaderTempDirectory() / "Bytecode Cache", "Ubershader.hash", ShaderSources->GetUbershaderHash());
-}
+	m_bytecodeDiskCache = crstl::unique_ptr<CrShaderDiskCache>(new CrShaderDiskCache(ShaderSources->GetUbershaderTempDirectory() / "Bytecode Cache", "Ubershader.manifest", *ShaderSources));
 
-void CrMaterialCompiler::CreateMaterialShaderDefines(const CrMaterialShaderDescriptor& materialShaderDescriptor, CrShaderCompilerDefines& defines)
-{
-	crstl::string materialShaderVariantDefine = GetMaterialShaderEnum(materialShaderDescriptor.shaderVariant);
-	defines.AddDefine(materialShaderVariantDefine);
+	// Every permutation is compiled from source in memory and never shares a file with another compilation
+	m_compilationThreadPool = crstl::unique_ptr<CrThreadPool>(new CrThreadPool());
 }
 
-crgfx::ShaderBytecodeHandle CrMaterialCompiler::GetDiskCachedOrCompileShaderBytecode
-(const CrFixedPath& shaderSourcePath, const crstl::string& entryPoint, const CrHash& shaderHash, const CrMaterialShaderDescriptor& materialShaderDescriptor)
+CrMaterialCompiler::~CrMaterialCompiler()
 {
-	// Try to load bytecode from cache
-	crgfx::ShaderBytecodeHandle shaderBytecode = m_bytecodeDiskCache.LoadFromCache(shaderHash, materialShaderDescriptor.graphicsApi);
-	
-	// If we couldn't find the bytecode in the cache, compile and cache here
-	if (!shaderBytecode)
-	{
-		// Create defines
-		CrShaderCompilerDefines defines;
-		CreateMaterialShaderDefines(materialShaderDescriptor, defines);
-
-		CrShaderBytecodeCompilationDescriptor compilationDescriptor(shaderSourcePath, crstl::fixed_string128(entryPoint.c_str()),
-		materialShaderDescriptor.shaderStage, materialShaderDescriptor.graphicsApi, materialShaderDescriptor.platform);
 
-		// Compile bytecode
-		shaderBytecode = ShaderManager->CompileShaderBytecode(compilationDescriptor, defines);
+}
 
-		CrAssertMsg(shaderBytecode != nullptr, "Bytecode compilation failed.");
+void CrMaterialCompiler::CreateMaterialShaderDefines(const CrMaterialShaderDescriptor& materialShaderDescriptor, CrShaderCompilerDefines& defines)
+{
+	defines.AddDefine(GetMaterialShaderEnum(materialShaderDescriptor.shaderVariant));
+	defines.AddDefine(GetMaterialShaderEnum(materialShaderDescriptor.blendMode));
+	defines.AddDefine(GetMaterialShaderEnum(materialShaderDescriptor.alphaTestMode));
 
-		// Save to cache if compilation was successful
-		if (shaderBytecode)
-		{
-			m_bytecodeDiskCache.SaveToCache(shaderHash, materialShaderDescriptor.graphicsApi, shaderBytecode);
-		}
+	if (materialShaderDescriptor.refraction == CrRefraction::Enabled)
+	{
+		defines.AddDefine("REFRACTION");
 	}
 
-	return shaderBytecode;
+	if (materialShaderDescriptor.textureMode == CrMaterialTextureMode::Textured)
+	{
+		defines.AddDefine("TEXTURED");
+	}
 }
 
 CrMaterialHandle CrMaterialCompiler::CompileMaterial(const CrMaterialDescriptor& descriptor)
 {
-	unused_parameter(descriptor); // TODO
+	crstl::vector<CrMaterialDescriptor> descriptors;
+	descriptors.push_back(descriptor);
+
+	crstl::vector<CrMaterialHandle> materials;
+	CompileMaterials(descriptors, materials);
+
+	return materials[0];
+}
 
-	// TODO The graphics API should come from the descriptor
-	crgfx::GraphicsApi::T graphicsApi = crgfx::GetGraphicsApi();
-	cr::Platform::T platform = cr::Platform::Windows;
+void CrMaterialCompiler::CompileMaterials(const crstl::vector<CrMaterialDescriptor>& descriptors, crstl::vector<CrMaterialHandle>& materials)
+{
+	const uint32_t StagesPerVariant = crgfx::ShaderStage::Pixel + 1;
 
-	// Generate header with defines
-	CrShaderHeaderGenerator shaderHeaderGenerator;
-	shaderHeaderGenerator.Define("TEXTURED");
+	crstl::vector<CrMaterialShaderPermutation> permutations;
 
-	crstl::string patchedShaderSource;
-	patchedShaderSource += shaderHeaderGenerator.GetString();
-	patchedShaderSource += ShaderSources->GetUbershaderSource();
+	// Index into the permutations for every material, variant and stage
+	crstl::vector<uint32_t> permutationIndices;
+	permutationIndices.reserve(descriptors.size() * CrMaterialShaderVariant::Count * StagesPerVariant);
 
-	// Create directory for ubershader shaders
-	CrFixedPath patchedShaderSourcePath = ShaderSources->GetUbershaderTempDirectory();
+	crstl::open_hashmap<uint64_t, uint32_t> permutationMap;
 
-	// Make sure directory exists
-	crstl::create_directories(patchedShaderSourcePath.c_str());
+	// Preprocessing is the expensive part of working out a permutation, and materials in the same set tend to
+	// share most of their defines, so we only preprocess every set of defines once
+	crstl::open_hashmap<uint64_t, CrPreprocessedUbershader> preprocessedUbershaders;
 
-	patchedShaderSourcePath /= "ShaderTemp.hlsl";
+	const crstl::string& ubershaderSource = ShaderSources->GetUbershaderSource();
 
-	// Save patched code. We overwrite any existing file
-	if (crstl::file patchedSourceFile = crstl::file(patchedShaderSourcePath.c_str(), crstl::file_flags::force_create | crstl::file_flags::write))
+	for (const CrMaterialDescriptor& descriptor : descriptors)
 	{
-		patchedSourceFile.write((void*)patchedShaderSource.c_str(), patchedShaderSource.length());
+		CrMaterialShaderDescriptor materialShaderDescriptor;
+		materialShaderDescriptor.blendMode = descriptor.blendMode;
+		materialShaderDescriptor.alphaTestMode = descriptor.alphaTestMode;
+		materialShaderDescriptor.refraction = descriptor.refraction;
+		materialShaderDescriptor.textureMode = descriptor.textureMode;
+		materialShaderDescriptor.platform = descriptor.platform != cr::Platform::Count ? descriptor.platform : cr::Platform::Current;
+		materialShaderDescriptor.graphicsApi = descriptor.graphicsApi != crgfx::GraphicsApi::Count ? descriptor.graphicsApi : crgfx::GraphicsApi::GetShaderApi(crgfx::GetGraphicsApi());
+
+		for (CrMaterialShaderVariant::T variant = CrMaterialShaderVariant::First; variant < CrMaterialShaderVariant::Count; ++variant)
+		{
+			materialShaderDescriptor.shaderVariant = variant;
+
+			for (crgfx::ShaderStage::T stage = crgfx::ShaderStage::Vertex; stage <= crgfx::ShaderStage::Pixel; ++stage)
+			{
+				materialShaderDescriptor.shaderStage = stage;
+
+				CrMaterialShaderPermutation permutation;
+				permutation.descriptor = materialShaderDescriptor;
+				CreateMaterialShaderDefines(materialShaderDescriptor, permutation.defines);
+
+				// Preprocess the ubershader with the same defines the compiler will see. Descriptors that only differ in
+				// ways the code doesn't check end up with the same hash and share their bytecode
+				crstl::vector<crstl::string> preprocessorDefines = permutation.defines.GetDefines();
+				CrShaderCompiler::AddImplicitDefines(stage, materialShaderDescriptor.platform, materialShaderDescriptor.graphicsApi, preprocessorDefines);
+
+				CrHash definesHash;
+
+				for (const crstl::string& define : preprocessorDefines)
+				{
+					definesHash << CrHash(define.c_str(), (uint32_t)define.size());
+				}
+
+				CrHash preprocessedHash;
+
+				const auto preprocessedIterator = preprocessedUbershaders.find(definesHash.GetHash());
+
+				if (preprocessedIterator != preprocessedUbershaders.end())
+				{
+					preprocessedHash = preprocessedIterator->second.hash;
+					permutation.dependencies = preprocessedIterator->second.dependencies;
+				}
+				else
+				{
+					preprocessedHash = ShaderSources->ComputeUbershaderPreprocessedHash(preprocessorDefines, permutation.dependencies);
+
+					CrPreprocessedUbershader preprocessedUbershader;
+					preprocessedUbershader.hash = preprocessedHash;
+					preprocessedUbershader.dependencies = permutation.dependencies;
+					preprocessedUbershaders.insert(definesHash.GetHash(), preprocessedUbershader);
+				}
+
+				const char* entryPoint = UbershaderEntryPoints[stage];
+				permutation.hash = preprocessedHash;
+				permutation.hash << CrHash(entryPoint, (uint32_t)strlen(entryPoint));
+				permutation.hash << CrHash(stage);
+				permutation.hash << CrHash(materialShaderDescriptor.platform);
+				permutation.hash << CrHash(materialShaderDescriptor.graphicsApi);
+
+				const auto permutationIterator = permutationMap.find(permutation.hash.GetHash());
+
+				if (permutationIterator != permutationMap.end())
+				{
+					permutationIndices.push_back(permutationIterator->second);
+				}
+				else
+				{
+					uint32_t permutationIndex = (uint32_t)permutations.size();
+					permutationMap.insert(permutation.hash.GetHash(), permutationIndex);
+					permutationIndices.push_back(permutationIndex);
+					permutations.push_back(permutation);
+				}
+			}
+		}
 	}
 
-	CrMaterialHandle material = CrMaterialHandle(new CrMaterial());
+	// Working out the permutations only reads the shader sources, so it doesn't need to wait for other sets
+	CrScopedLock lock(m_compilationMutex);
 
-	CrMaterialShaderDescriptor baseShaderDescriptor;
-	baseShaderDescriptor.blendMode = CrMaterialBlendMode::Opaque;
-	baseShaderDescriptor.alphaTestMode = CrAlphaTestMode::Always;
-	baseShaderDescriptor.platform = platform;
-	baseShaderDescriptor.graphicsApi = graphicsApi;
+	// Look for every permutation in the caches first
+	crstl::vector<uint32_t> compilations;
 
-	crstl::string entryPoints[crgfx::ShaderStage::GraphicsStageCount] =
+	for (uint32_t i = 0; i < permutations.size(); ++i)
 	{
-		"UbershaderVS",
-		"UbershaderPS",
-		"UbershaderHS",
-		"UbershaderDS",
-		"UbershaderGS",
-	};
-
-	for (CrMaterialShaderVariant::T variant = CrMaterialShaderVariant::First; variant < CrMaterialShaderVariant::Count; ++variant)
+		CrMaterialShaderPermutation& permutation = permutations[i];
+
+		const auto bytecodeIterator = m_bytecodes.find(permutation.hash.GetHash());
+
+		if (bytecodeIterator != m_bytecodes.end())
+		{
+			permutation.bytecode = bytecodeIterator->second;
+		}
+		else
+		{
+			permutation.bytecode = m_bytecodeDiskCache->LoadFromCache(permutation.hash, permutation.descriptor.graphicsApi);
+
+			if (permutation.bytecode)
+			{
+				m_bytecodes.insert(permutation.hash.GetHash(), permutation.bytecode);
+			}
+			else
+			{
+				compilations.push_back(i);
+			}
+		}
+	}
+
+	if (!compilations.empty())
 	{
-		crgfx::GraphicsShaderDescriptor shaderDescriptor;
+		CrLog("Compiling %llu material shader permutations (%llu unique out of %llu)",
+			(uint64_t)compilations.size(), (uint64_t)permutations.size(), (uint64_t)permutationIndices.size());
 
-		CrMaterialShaderDescriptor materialShaderDescriptor = baseShaderDescriptor;
-		materialShaderDescriptor.shaderVariant = variant;
+		// Includes are resolved in the ubershader source, so we compile it from memory and each compilation is independent
+		CrFixedPath ubershaderPath = ShaderSources->GetUbershaderPath();
 
-		for (crgfx::ShaderStage::T stage = crgfx::ShaderStage::Vertex; stage <= crgfx::ShaderStage::Pixel; ++stage)
+		m_compilationThreadPool->ParallelFor((uint32_t)compilations.size(), [&](uint32_t i)
 		{
-			materialShaderDescriptor.shaderStage = stage;
+			CrMaterialShaderPermutation& permutation = permutations[compilations[i]];
+			const CrMaterialShaderDescriptor& descriptor = permutation.descriptor;
 
-			crgfx::ShaderBytecodeHandle bytecode = GetDiskCachedOrCompileShaderBytecode
-			(
-				patchedShaderSourcePath, 
-				entryPoints[stage], 
-				materialShaderDescriptor.ComputeHash(), 
-				materialShaderDescriptor
-			);
+			CrShaderBytecodeCompilationDescriptor compilationDescriptor(ubershaderPath, crstl::fixed_string128(UbershaderEntryPoints[descriptor.shaderStage]),
+				descriptor.shaderStage, descriptor.graphicsApi, descriptor.platform, ubershaderSource);
 
-			CrAssertMsg(bytecode != nullptr, "Bytecode is null. Compilation failed");
+			permutation.bytecode = ShaderManager->CompileShaderBytecode(compilationDescriptor, permutation.defines);
+		});
 
-			shaderDescriptor.m_bytecodes.push_back(bytecode);
+		// Only save to cache if compilation was successful
+		for (uint32_t permutationIndex : compilations)
+		{
+			const CrMaterialShaderPermutation& permutation = permutations[permutationIndex];
+
+			if (permutation.bytecode)
+			{
+				m_bytecodeDiskCache->SaveToCache(permutation.hash, permutation.descriptor.graphicsApi, permutation.dependencies, permutation.bytecode);
+				m_bytecodes.insert(permutation.hash.GetHash(), permutation.bytecode);
+			}
 		}
 
-		material->m_shaders[variant] = crgfx::GetDevice()->CreateGraphicsShader(shaderDescriptor);
+		m_bytecodeDiskCache->Flush();
 	}
 
-	return material;
-}
\ No newline at end of file
+	materials.reserve(materials.size() + descriptors.size());
+
+	const uint32_t* permutationIndex = permutationIndices.data();
+
+	for (uint32_t m = 0; m < descriptors.size(); ++m)
+	{
+		CrMaterialHandle material = CrMaterialHandle(new CrMaterial());
+
+		for (CrMaterialShaderVariant::T variant = CrMaterialShaderVariant::First; variant < CrMaterialShaderVariant::Count; ++variant)
+		{
+			crgfx::GraphicsShaderDescriptor shaderDescriptor;
+			bool compiled = true;
+
+			for (uint32_t s = 0; s < StagesPerVariant; ++s)
+			{
+				const crgfx::ShaderBytecodeHandle& bytecode = permutations[*permutationIndex++].bytecode;
+				compiled &= bytecode != nullptr;
+				shaderDescriptor.m_bytecodes.push_back(bytecode);
+			}
+
+			// The shader manager has already logged why. Models don't create pipelines for variants without a
+			// shader, so the material isn't drawn in that pass until its shaders compile
+			if (compiled)
+			{
+				material->m_shaders[variant] = crgfx::GetDevice()->CreateGraphicsShader(shaderDescriptor);
+			}
+		}
+
+		materials.push_back(material);
+	}
+}
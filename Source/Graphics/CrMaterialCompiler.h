@@ -4,8 +4,14 @@
 #include "Graphics/CrShaderDiskCache.h"
 
 #include "Core/CrCoreForwardDeclarations.h"
+#include "Core/Threading/CrMutex.h"
 
+#include "crstl/open_hashmap.h"
 #include "crstl/string.h"
+#include "crstl/unique_ptr.h"
+#include "crstl/vector.h"
+
+class CrThreadPool;
 
 struct CrMaterialDescriptor;
 struct CrMaterialShaderDescriptor;
@@ -47,21 +53,31 @@ public:
 
 	static void Deinitialize();
 
+	~CrMaterialCompiler();
+
 	// Creates set of defines based on the material shader descriptor
 	void CreateMaterialShaderDefines(const CrMaterialShaderDescriptor& materialShaderDescriptor, CrShaderCompilerDefines& defines);
 
 	// Compiles a material through its material descriptor
 	CrMaterialHandle CompileMaterial(const CrMaterialDescriptor& descriptor);
 
-	// Gets a material shader through the internal cache, or if not available, sends it off for compilation
-	crgfx::ShaderBytecodeHandle GetDiskCachedOrCompileShaderBytecode
-	(const CrFixedPath& shaderSourcePath, const crstl::string& entryPoint, const CrHash& shaderHash, const CrMaterialShaderDescriptor& materialShaderDescriptor);
+	// Compiles a set of materials at once. Shader permutations that preprocess to the same code are only compiled
+	// once, and every permutation that isn't cached is compiled in parallel
+	void CompileMaterials(const crstl::vector<CrMaterialDescriptor>& descriptors, crstl::vector<CrMaterialHandle>& materials);
 
 private:
 
 	CrMaterialCompiler();
 
-	CrShaderDiskCache m_bytecodeDiskCache;
+	crstl::unique_ptr<CrShaderDiskCache> m_bytecodeDiskCache;
+
+	crstl::unique_ptr<CrThreadPool> m_compilationThreadPool;
+
+	// Bytecodes loaded or compiled so far, by permutation hash, so that materials created later can reuse them
+	crstl::open_hashmap<uint64_t, crgfx::ShaderBytecodeHandle> m_bytecodes;
+
+	// Materials can be loaded from several threads, but the caches can only be used by one set at a time
+	CrMutex m_compilationMutex;
 };
 
 extern CrMaterialCompiler* MaterialCompiler;
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "CrMeshlet.h"
+
+#include "Math/CrHlslppVectorFloat.h"
+#include "Math/CrHlslppMatrixFloat.h"
+#include "Math/CrMath.h"
+
+#include <math.h>
+
+void CrMeshletCuller::Cull
+(
+	const CrMeshlet* meshlets, uint32_t meshletCount, const float4x4& worldTransform, const float4x4& world2ProjectionMatrix,
+	const float3& cameraPosition, bool isDoubleSided, crstl::vector<uint32_t>& visibleMeshlets, CrMeshletCullingStatistics& statistics
+)
+{
+	// Extract the frustum planes in world space from the columns of the projection. Points are inside when
+	// -w <= x <= w, -w <= y <= w and 0 <= z <= w, the same bounds the mesh visibility uses
+	float4x4 projectionColumns = transpose(world2ProjectionMatrix);
+
+	float4 planes[6] =
+	{
+		projectionColumns[3] + projectionColumns[0],
+		projectionColumns[3] - projectionColumns[0],
+		projectionColumns[3] + projectionColumns[1],
+		projectionColumns[3] - projectionColumns[1],
+		projectionColumns[2],
+		projectionColumns[3] - projectionColumns[2]
+	};
+
+	uint32_t planeCount = 0;
+
+	for (uint32_t p = 0; p < 6; ++p)
+	{
+		float planeLength = (float)length(planes[p].xyz);
+
+		// An infinite far plane has no normal. Nothing is ever behind it
+		if (planeLength > 1e-6f)
+		{
+			planes[planeCount++] = planes[p] / planeLength;
+		}
+	}
+
+	// Largest scale of the transform, so that the spheres still contain their meshlets
+	float transformScale = sqrtf(CrMax(CrMax((float)dot(worldTransform[0].xyz, worldTransform[0].xyz), (float)dot(worldTransform[1].xyz, worldTransform[1].xyz)), (float)dot(worldTransform[2].xyz, worldTransform[2].xyz)));
+
+	for (uint32_t m = 0; m < meshletCount; ++m)
+	{
+		const CrMeshlet& meshlet = meshlets[m];
+
+		statistics.meshletCount++;
+		statistics.triangleCount += meshlet.triangleCount;
+
+		float3 center = mul(float4(meshlet.center[0], meshlet.center[1], meshlet.center[2], 1.0f), worldTransform).xyz;
+		float radius = meshlet.radius * transformScale;
+
+		bool isInFrustum = true;
+
+		for (uint32_t p = 0; p < planeCount; ++p)
+		{
+			if ((float)dot(planes[p].xyz, center) + (float)planes[p].w < -radius)
+			{
+				isInFrustum = false;
+				break;
+			}
+		}
+
+		if (!isInFrustum)
+		{
+			statistics.frustumCulledCount++;
+			continue;
+		}
+
+		if (!isDoubleSided && meshlet.coneCutoff < 1.0f)
+		{
+			float3 coneApex = mul(float4(meshlet.coneApex[0], meshlet.coneApex[1], meshlet.coneApex[2], 1.0f), worldTransform).xyz;
+			float3 coneAxis = normalize(mul(float4(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2], 0.0f), worldTransform).xyz);
+
+			if ((float)dot(normalize(coneApex - cameraPosition), coneAxis) >= meshlet.coneCutoff)
+			{
+				statistics.backfaceCulledCount++;
+				continue;
+			}
+		}
+
+		statistics.visibleMeshletCount++;
+		statistics.visibleTriangleCount += meshlet.triangleCount;
+
+		visibleMeshlets.push_back(m);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Math/CrHlslppMatrixFloatType.h"
+
+#include "crstl/vector.h"
+
+// Small cluster of triangles of a mesh that can be culled on its own. Its vertices are indices into the vertex buffer
+// of the mesh, and its triangles are indices into its own vertices, three bytes per triangle. The layout is the same
+// in memory and in cooked models
+struct CrMeshlet
+{
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+
+	// Bounding sphere in model space
+	float center[3];
+	float radius;
+
+	// Every triangle faces away from a viewer inside the cone, i.e. dot(normalize(apex - viewer), axis) >= cutoff.
+	// A cutoff of 1 means the cone is too wide to ever cull the meshlet
+	float coneApex[3];
+	float coneAxis[3];
+	float coneCutoff;
+
+	uint32_t padding;
+};
+
+struct CrMeshletCullingStatistics
+{
+	uint32_t meshletCount = 0;
+
+	uint32_t visibleMeshletCount = 0;
+
+	uint32_t triangleCount = 0;
+
+	uint32_t visibleTriangleCount = 0;
+
+	uint32_t frustumCulledCount = 0;
+
+	uint32_t backfaceCulledCount = 0;
+};
+
+// Reference implementation of meshlet culling on the CPU. It tests the bounding sphere of each meshlet against the
+// frustum and its normal cone against the camera position, so that the result can be compared with a GPU version
+class CrMeshletCuller
+{
+public:
+
+	// Adds the indices of the meshlets that survive to visibleMeshlets. Backface culling needs a transform with uniform
+	// scale and is skipped for double sided meshes
+	static void Cull
+	(
+		const CrMeshlet* meshlets, uint32_t meshletCount, const float4x4& worldTransform, const float4x4& world2ProjectionMatrix,
+		const float3& cameraPosition, bool isDoubleSided, crstl::vector<uint32_t>& visibleMeshlets, CrMeshletCullingStatistics& statistics
+	);
+};
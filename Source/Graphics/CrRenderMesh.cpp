@@ -20,6 +20,35 @@ void CrRenderMesh::SetIndexBuffer(const crgfx::IndexBufferHandle& indexBuffer)
 	m_indexBuffer = indexBuffer;
 }
 
+void CrRenderMesh::SetPositionDequantization(float scale, const float3& offset)
+{
+	m_positionDequantization = float4x4::scale(scale);
+	m_positionDequantization[3] = float4(offset, 1.0f);
+	m_hasQuantizedPositions = true;
+}
+
+void CrRenderMesh::SetInstanceTransforms(const float4x4* instanceTransforms, uint32_t instanceCount)
+{
+	m_instanceTransforms.resize(instanceCount);
+
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		m_instanceTransforms[i] = instanceTransforms[i];
+	}
+}
+
+void CrRenderMesh::SetMeshlets(const CrMeshlet* meshlets, uint32_t meshletCount, const uint32_t* meshletVertices, uint32_t meshletVertexCount, const uint8_t* meshletTriangles, uint32_t meshletTriangleCount)
+{
+	m_meshlets.resize_uninitialized(meshletCount);
+	memcpy(m_meshlets.data(), meshlets, meshletCount * sizeof(CrMeshlet));
+
+	m_meshletVertices.resize_uninitialized(meshletVertexCount);
+	memcpy(m_meshletVertices.data(), meshletVertices, meshletVertexCount * sizeof(uint32_t));
+
+	m_meshletTriangles.resize_uninitialized(meshletTriangleCount * 3);
+	memcpy(m_meshletTriangles.data(), meshletTriangles, meshletTriangleCount * 3);
+}
+
 // TODO Figure out best way of passing multiple references
 //void CrMesh::AddVertexBuffers(std::initializer_list<const CrVertexBufferSharedHandle&> vertexBuffers)
 //{
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Graphics/CrVisibility.h"
+#include "Graphics/CrMeshlet.h"
 #include "Graphics/CrGraphicsForwardDeclarations.h"
 #include "Graphics/VertexDescriptor.h"
 
@@ -33,12 +34,49 @@ public:
 
 	bool GetIsDoubleSided() const { return m_isDoubleSided; }
 
+	// Texture coordinate units per unit of distance in model space, averaged over the surface of the mesh. Texture
+	// streaming uses it to know how much detail textures need. 0 if it's not known
+	void SetUVDensity(float uvDensity) { m_uvDensity = uvDensity; }
+
+	float GetUVDensity() const { return m_uvDensity; }
+
+	// Positions stored relative to the bounds of the mesh come back to model space as position * scale + offset. The
+	// renderer folds this into the transform of the mesh
+	void SetPositionDequantization(float scale, const float3& offset);
+
+	bool GetHasQuantizedPositions() const { return m_hasQuantizedPositions; }
+
+	const float4x4& GetPositionDequantization() const { return m_positionDequantization; }
+
+	// A mesh the model uses in several places is drawn once per instance transform, which takes it from its own space
+	// to the space of the model. Meshes without instance transforms are already in model space
+	void SetInstanceTransforms(const float4x4* instanceTransforms, uint32_t instanceCount);
+
+	const crstl::vector<float4x4>& GetInstanceTransforms() const { return m_instanceTransforms; }
+
+	// Copies the meshlets of the mesh, with their vertex and triangle indices. Triangles take three bytes each
+	void SetMeshlets(const CrMeshlet* meshlets, uint32_t meshletCount, const uint32_t* meshletVertices, uint32_t meshletVertexCount, const uint8_t* meshletTriangles, uint32_t meshletTriangleCount);
+
+	const crstl::vector<CrMeshlet>& GetMeshlets() const { return m_meshlets; }
+
+	const crstl::vector<uint32_t>& GetMeshletVertices() const { return m_meshletVertices; }
+
+	const crstl::vector<uint8_t>& GetMeshletTriangles() const { return m_meshletTriangles; }
+
 private:
 
 	void MergeVertexDescriptors();
 
 	bool m_isDoubleSided = false;
 
+	float m_uvDensity = 0.0f;
+
+	bool m_hasQuantizedPositions = false;
+
+	float4x4 m_positionDequantization;
+
+	crstl::vector<float4x4> m_instanceTransforms;
+
 	crstl::vector<crgfx::VertexBufferHandle> m_vertexBuffers;
 
 	crgfx::VertexDescriptor m_vertexDescriptor;
@@ -46,4 +84,11 @@ private:
 	crgfx::IndexBufferHandle m_indexBuffer;
 
 	CrBoundingBox m_boundingBox;
+
+	// Only on the CPU for now, for the meshlet culler
+	crstl::vector<CrMeshlet> m_meshlets;
+
+	crstl::vector<uint32_t> m_meshletVertices;
+
+	crstl::vector<uint8_t> m_meshletTriangles;
 };
\ No newline at end of file
@@ -68,8 +68,23 @@ void CrRenderModel::ComputeBoundingBoxFromMeshes()
 	for (const CrRenderMeshHandle& renderMesh : m_renderMeshes)
 	{
 		const CrBoundingBox& meshBox = renderMesh->GetBoundingBox();
-		minVertex = min(minVertex, meshBox.center - meshBox.extents);
-		maxVertex = max(maxVertex, meshBox.center + meshBox.extents);
+
+		if (renderMesh->GetInstanceTransforms().empty())
+		{
+			minVertex = min(minVertex, meshBox.center - meshBox.extents);
+			maxVertex = max(maxVertex, meshBox.center + meshBox.extents);
+		}
+		else
+		{
+			// Box around each instance of the mesh box in model space
+			for (const float4x4& instanceTransform : renderMesh->GetInstanceTransforms())
+			{
+				float3 center = mul(float4(meshBox.center, 1.0f), instanceTransform).xyz;
+				float3 extents = abs(instanceTransform[0].xyz) * meshBox.extents.x + abs(instanceTransform[1].xyz) * meshBox.extents.y + abs(instanceTransform[2].xyz) * meshBox.extents.z;
+				minVertex = min(minVertex, center - extents);
+				maxVertex = max(maxVertex, center + extents);
+			}
+		}
 	}
 
 	m_boundingBox.center  = (maxVertex + minVertex) * 0.5f;
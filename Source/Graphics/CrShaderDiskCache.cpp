@@ -1,85 +1,137 @@
 #include "Graphics/CrRendering_pch.h"
 
 #include "Graphics/CrShaderDiskCache.h"
-#include "Graphics/CrShaderManager.h"
 #include "Graphics/CrMaterial.h"
 #include "Graphics/IShader.h"
 
 #include "Core/CrHash.h"
 #include "Core/Streams/CrFileStream.h"
+#include "Core/Streams/CrBufferStream.h"
 
-CrShaderDiskCache::CrShaderDiskCache(const CrFixedPath& cachePath, const char* hashFilename, CrHash currentHash)
+CrShaderDiskCache::CrShaderDiskCache(const CrFixedPath& cachePath, const char* manifestFilename, const CrShaderSources& shaderSources)
 	: m_cachePath(cachePath)
 {
-	// We store the hash file at the same level as the folder
-	CrFixedPath hashPath = cachePath.parent_path() / hashFilename;
-	CrHash storedHash;
+	// We store the manifest at the same level as the folder
+	m_manifestPath = GetManifestPath(cachePath, manifestFilename);
 
-	bool clearCache = true;
+	bool validManifest = false;
 
-	// If we have a hash, check whether we've produced the same hash. If so, the cache is valid
-	// If not, create the hash file and store it
-	if (crstl::file hashFile = crstl::file(hashPath.c_str(), crstl::file_flags::read))
+	CrShaderDiskCacheManifest manifest;
+
+	if (crstl::exists(m_manifestPath.c_str()))
 	{
-		hashFile.read((void*)&storedHash, sizeof(storedHash));
+		CrMappedFileStream manifestFile(m_manifestPath.c_str());
+		CrReadBufferStream& manifestStream = manifestFile.GetStream();
+		manifestStream << manifest;
 
-		// If we have the same hash, the cache is valid and we don't need to do anything about it
-		// If not, delete the contents of the folder and start again
-		if (storedHash == currentHash)
-		{
-			clearCache = false;
-		}
+		// A manifest of a different version cannot be trusted, we start again. Neither can one whose hashes
+		// were computed differently, as none of them would match. A truncated manifest is as good as a missing one
+		validManifest = manifest.IsCurrent() && manifestStream.IsValid();
 	}
 
-	if (crstl::exists(cachePath.c_str()))
+	if (!crstl::exists(cachePath.c_str()))
+	{
+		// Make sure directory exists
+		crstl::create_directories(cachePath.c_str());
+	}
+	else if (!validManifest)
 	{
-		if (clearCache)
+		// Without a manifest we don't know what the cached bytecode was built from
+		crstl::for_each_directory_entry(cachePath.c_str(), true, [](const crstl::directory_entry& entry)
 		{
-			crstl::for_each_directory_entry(cachePath.c_str(), true, [](const crstl::directory_entry& entry)
+			if (!entry.is_directory)
 			{
-				if (!entry.is_directory)
-				{
-					CrFixedPath filePath = entry.directory;
-					filePath /= entry.filename;
-					crstl::delete_file(filePath.c_str());
-				}
-
-				return true;
-			});
-		}
+				CrFixedPath filePath = entry.directory;
+				filePath /= entry.filename;
+				crstl::delete_file(filePath.c_str());
+			}
+
+			return true;
+		});
 	}
-	else
+
+	m_archive.Open(GetArchivePath(cachePath));
+
+	uint32_t keptEntries = 0;
+	uint32_t evictedEntries = 0;
+
+	// Only evict the entries whose sources have changed since they were built
+	for (CrShaderDiskCacheEntry& entry : manifest.entries)
 	{
-		// Make sure directory exists
-		crstl::create_directories(cachePath.c_str());
+		CrHash entryKey = GetEntryKey(entry.hash, entry.graphicsApi);
+
+		if (shaderSources.AreDependenciesValid(entry.dependencies) && m_archive.Find(entryKey.GetHash()))
+		{
+			m_entries.insert(entryKey, entry);
+			keptEntries++;
+		}
+		else
+		{
+			m_archive.Remove(entryKey.GetHash());
+			evictedEntries++;
+		}
 	}
 
-	if (clearCache)
+	// Bytecode that made it into the archive but not the manifest was built from unknown sources
+	crstl::vector<uint64_t> orphanedKeys;
+
+	m_archive.ForEachEntry([this, &orphanedKeys](uint64_t key, const CrPackedArchiveData&)
 	{
-		crstl::file hashFile = crstl::file(hashPath.c_str(), crstl::file_flags::force_create | crstl::file_flags::write);
-		hashFile.write((void*)&currentHash, sizeof(currentHash));
+		if (m_entries.find(CrHash(key)) == m_entries.end())
+		{
+			orphanedKeys.push_back(key);
+		}
+	});
+
+	for (uint64_t orphanedKey : orphanedKeys)
+	{
+		m_archive.Remove(orphanedKey);
+		evictedEntries++;
 	}
+
+	m_manifestDirty = evictedEntries > 0 || !validManifest;
+
+	Flush();
+
+	// This writes the index and compacts the archive if eviction left too much dead space behind
+	m_archive.Flush();
+
+	CrLog("Shader disk cache %s: kept %u entries, evicted %u entries", cachePath.c_str(), keptEntries, evictedEntries);
 }
 
-CrFixedPath CrShaderDiskCache::CreateCachedFilePath(const CrHash& hash, crgfx::GraphicsApi::T graphicsApi) const
+CrShaderDiskCache::~CrShaderDiskCache()
 {
-	crstl::string hashString = crstl::string(hash.GetHash());
-	CrFixedPath cachedBytecodePath = m_cachePath;
-	cachedBytecodePath /= hashString.c_str();
-	cachedBytecodePath.replace_extension(CrShaderManager::GetShaderBytecodeExtension(graphicsApi));
-	return cachedBytecodePath;
+	Flush();
+
+	m_archive.Close();
 }
 
 crgfx::ShaderBytecodeHandle CrShaderDiskCache::LoadFromCache(const CrHash& hash, crgfx::GraphicsApi::T graphicsApi) const
 {
-	CrFixedPath cachedBytecodePath = CreateCachedFilePath(hash, graphicsApi);
-	
-	CrReadFileStream cachedBytecodeFile(cachedBytecodePath.c_str());
-	
-	if (cachedBytecodeFile.GetFile())
+	CrHash entryKey = GetEntryKey(hash, graphicsApi);
+
+	// Entries not listed in the manifest were built from unknown sources
+	if (m_entries.find(entryKey) == m_entries.end())
+	{
+		return nullptr;
+	}
+
+	// Deserialize straight from the mapped archive
+	CrPackedArchiveData archiveData = m_archive.Find(entryKey.GetHash());
+
+	if (archiveData)
 	{
+		CrReadBufferStream cachedBytecodeStream(archiveData.data, archiveData.size);
 		crgfx::ShaderBytecodeHandle shaderBytecode(new crgfx::ShaderBytecode());
-		cachedBytecodeFile << *shaderBytecode.get();
+		cachedBytecodeStream << *shaderBytecode.get();
+
+		// A damaged entry is a cache miss, the shader gets compiled again
+		if (!cachedBytecodeStream.IsValid())
+		{
+			CrLog("Shader cache entry %llx is truncated", (unsigned long long)entryKey.GetHash());
+			return nullptr;
+		}
+
 		return shaderBytecode;
 	}
 	else
@@ -88,13 +140,50 @@ crgfx::ShaderBytecodeHandle CrShaderDiskCache::LoadFromCache(const CrHash& hash,
 	}
 }
 
-void CrShaderDiskCache::SaveToCache(const CrHash& hash, crgfx::GraphicsApi::T graphicsApi, const crgfx::ShaderBytecodeHandle& bytecode) const
+void CrShaderDiskCache::SaveToCache(const CrHash& hash, crgfx::GraphicsApi::T graphicsApi, const CrShaderSourceDependencies& dependencies, const crgfx::ShaderBytecodeHandle& bytecode)
 {
 	if (bytecode)
 	{
-		CrFixedPath cachedBytecodePath = CreateCachedFilePath(hash, graphicsApi);
+		CrHash entryKey = GetEntryKey(hash, graphicsApi);
+
+		crstl::vector<uint8_t> bytecodeBuffer;
+		CrWriteBufferStream bytecodeStream(bytecodeBuffer);
+		bytecodeStream << *bytecode.get();
 
-		CrWriteFileStream writeFileStream(cachedBytecodePath.c_str());
-		writeFileStream << *bytecode.get();
+		// Appending doesn't rewrite the index. If we don't get to flush, the record is recovered on the next startup
+		m_archive.Append(entryKey.GetHash(), bytecodeBuffer.data(), bytecodeBuffer.size());
+
+		CrShaderDiskCacheEntry entry;
+		entry.hash = hash;
+		entry.graphicsApi = graphicsApi;
+		entry.dependencies = dependencies;
+		m_entries.erase(entryKey);
+		m_entries.insert(entryKey, entry);
+
+		m_manifestDirty = true;
+	}
+}
+
+void CrShaderDiskCache::Flush()
+{
+	// The bytecode is already in the archive, so an interrupted write never lists missing bytecode
+	if (m_manifestDirty)
+	{
+		WriteManifest();
+		m_manifestDirty = false;
 	}
 }
+
+void CrShaderDiskCache::WriteManifest() const
+{
+	CrShaderDiskCacheManifest manifest;
+	manifest.entries.reserve(m_entries.size());
+
+	for (const auto& entryIterator : m_entries)
+	{
+		manifest.entries.push_back(entryIterator.second);
+	}
+
+	CrWriteFileStream manifestFile(m_manifestPath.c_str());
+	manifestFile << manifest;
+}
\ No newline at end of file
@@ -1,28 +1,134 @@
 #pragma once
 
 #include "Graphics/CrGraphicsForwardDeclarations.h"
+#include "Graphics/CrShaderSources.h"
 
 #include "Core/CrCoreForwardDeclarations.h"
 #include "Core/FileSystem/CrFixedPath.h"
+#include "Core/FileSystem/CrPackedArchive.h"
+
+#include "crstl/open_hashmap.h"
 
 struct CrMaterialShaderDescriptor;
 
+namespace CrShaderDiskCacheVersion
+{
+	enum T : uint32_t
+	{
+		InitialVersion,
+		DependencyManifest,
+		PackedArchive,
+		PreprocessedHashes,
+		PermutationHashes,
+		HashVersion,
+		CurrentVersion = HashVersion
+	};
+};
+
+// Every cached bytecode records the sources it was built from
+struct CrShaderDiskCacheEntry
+{
+	CrHash hash;
+
+	crgfx::GraphicsApi::T graphicsApi = crgfx::GraphicsApi::Count;
+
+	CrShaderSourceDependencies dependencies;
+};
+
+template<typename StreamT>
+StreamT& operator << (StreamT& stream, CrShaderDiskCacheEntry& entry)
+{
+	uint64_t hash = entry.hash.GetHash();
+	stream << hash;
+	entry.hash = CrHash(hash);
+
+	stream << entry.graphicsApi;
+
+	uint32_t dependencyCount = (uint32_t)entry.dependencies.size();
+	stream << dependencyCount;
+	entry.dependencies.resize(dependencyCount);
+
+	for (CrShaderSourceDependency& dependency : entry.dependencies)
+	{
+		uint64_t dependencyHash = dependency.hash.GetHash();
+		stream << dependency.filename;
+		stream << dependencyHash;
+		dependency.hash = CrHash(dependencyHash);
+	}
+
+	return stream;
+}
+
+// Contents of the manifest file. Entries are only serialized if the manifest was written with the current
+// version and hash version, as they cannot be trusted otherwise
+struct CrShaderDiskCacheManifest
+{
+	bool IsCurrent() const
+	{
+		return version == CrShaderDiskCacheVersion::CurrentVersion && hashVersion == CrHash::Version;
+	}
+
+	uint32_t version = CrShaderDiskCacheVersion::CurrentVersion;
+
+	uint32_t hashVersion = CrHash::Version;
+
+	crstl::vector<CrShaderDiskCacheEntry> entries;
+};
+
+template<typename StreamT>
+StreamT& operator << (StreamT& stream, CrShaderDiskCacheManifest& manifest)
+{
+	stream << manifest.version;
+	stream << manifest.hashVersion;
+
+	if (manifest.IsCurrent())
+	{
+		stream << manifest.entries;
+	}
+
+	return stream;
+}
+
+// Bytecode is stored in a single packed archive inside the cache path, which is memory mapped
+// on startup so that loading from the cache doesn't need to open any files
 class CrShaderDiskCache
 {
 public:
 
-	CrShaderDiskCache() {}
+	// The manifest lists every entry in the cache together with the hashes of the sources it was built from.
+	// Entries whose dependencies no longer match the current sources are evicted, the rest are kept
+	CrShaderDiskCache(const CrFixedPath& cachePath, const char* manifestFilename, const CrShaderSources& shaderSources);
 
-	// The current hash is what we want to use this cache with. If the hash doesn't match, we'll delete the cache
-	CrShaderDiskCache(const CrFixedPath& cachePath, const char* hashFilename, CrHash currentHash);
-
-	CrFixedPath CreateCachedFilePath(const CrHash& hash, crgfx::GraphicsApi::T graphicsApi) const;
+	~CrShaderDiskCache();
 
 	crgfx::ShaderBytecodeHandle LoadFromCache(const CrHash& hash, crgfx::GraphicsApi::T graphicsApi) const;
 
-	void SaveToCache(const CrHash& hash, crgfx::GraphicsApi::T graphicsApi, const crgfx::ShaderBytecodeHandle& bytecode) const;
+	// Saved entries are only listed in the manifest once it's flushed. Until then they're cache misses for later runs
+	void SaveToCache(const CrHash& hash, crgfx::GraphicsApi::T graphicsApi, const CrShaderSourceDependencies& dependencies, const crgfx::ShaderBytecodeHandle& bytecode);
+
+	// Writes the manifest if entries were saved or evicted since it was last written. Meant to be called once
+	// a batch of shaders has been saved. It's also flushed on destruction
+	void Flush();
+
+	// The archive lives inside the cache path and the manifest next to it. Tools that work on a cache
+	// outside the engine use these to find them
+	static CrFixedPath GetArchivePath(const CrFixedPath& cachePath) { return cachePath / "Bytecode"; }
+
+	static CrFixedPath GetManifestPath(const CrFixedPath& cachePath, const char* manifestFilename) { return cachePath.parent_path() / manifestFilename; }
+
+	static CrHash GetEntryKey(const CrHash& hash, crgfx::GraphicsApi::T graphicsApi) { return hash + CrHash(graphicsApi); }
 
 private:
 
+	void WriteManifest() const;
+
 	CrFixedPath m_cachePath;
-};
\ No newline at end of file
+
+	CrPackedArchive m_archive;
+
+	CrFixedPath m_manifestPath;
+
+	crstl::open_hashmap<CrHash, CrShaderDiskCacheEntry> m_entries;
+
+	bool m_manifestDirty = false;
+};
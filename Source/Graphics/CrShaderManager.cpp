@@ -12,6 +12,14 @@
 #include "Core/CrPlatform.h"
 #include "Core/CrGlobalPaths.h"
 #include "Core/Streams/CrFileStream.h"
+#include "Core/Streams/CrBufferStream.h"
+#include "Core/CrCommandLine.h"
+
+// The shader compiler library, which includes the server client, is only linked on platforms that can run it
+#if defined(CR_SHADER_COMPILER_IN_PROCESS)
+#include "Graphics/ShaderCompiler/CrShaderCompiler.h"
+#include "Graphics/ShaderCompiler/CrShaderCompilerServer.h"
+#endif
 
 #include "crstl/process.h"
 #include "crstl/timer.h"
@@ -39,6 +47,11 @@ crgfx::GraphicsShaderHandle CrShaderManager::CompileGraphicsShader(const CrShade
 	{
 		crgfx::ShaderBytecodeHandle bytecode = CompileShaderBytecode(bytecodeDescriptor, shaderCompilationDescriptor.GetDefines());
 
+		if (!bytecode)
+		{
+			return nullptr;
+		}
+
 		graphicsShaderDescriptor.m_bytecodes.push_back(bytecode);
 	}
 
@@ -53,6 +66,11 @@ crgfx::ComputeShaderHandle CrShaderManager::CompileComputeShader(const CrShaderC
 	crgfx::ComputeShaderDescriptor computeShaderDescriptor;
 	computeShaderDescriptor.m_bytecode = CompileShaderBytecode(bytecodeDescriptor, shaderCompilationDescriptor.GetDefines());
 
+	if (!computeShaderDescriptor.m_bytecode)
+	{
+		return nullptr;
+	}
+
 	crgfx::ComputeShaderHandle computeShader = crgfx::GetDevice()->CreateComputeShader(computeShaderDescriptor);
 
 	return computeShader;
@@ -66,6 +84,47 @@ CrFixedPath CrShaderManager::GetCompiledShadersPath(cr::Platform::T platform, cr
 	return shaderCachePath;
 }
 
+CrShaderManager::CrShaderManager() : m_shaderCompilerServerAvailable(false)
+{
+#if defined(CR_SHADER_COMPILER_IN_PROCESS)
+	m_inProcessCompilation = !crcore::CommandLine["-outOfProcessShaderCompiler"];
+
+	// The shader compiler executable does the same when no PDB directory is given
+	CrShaderCompiler::PDBDirectory = CrGlobalPaths::GetTempEngineDirectory() + "Shader PDBs";
+
+	m_shaderCompilerServerName = crcore::CommandLine("-shaderCompilerServer");
+
+	if (!m_shaderCompilerServerName.empty())
+	{
+		CrShaderCompilerClient* shaderCompilerClient = new CrShaderCompilerClient();
+
+		if (shaderCompilerClient->Connect(m_shaderCompilerServerName.c_str()))
+		{
+			CrLog("Connected to shader compiler server %s", m_shaderCompilerServerName.c_str());
+			m_idleShaderCompilerClients.push_back(shaderCompilerClient);
+			m_shaderCompilerServerAvailable = true;
+		}
+		else
+		{
+			CrLog("Could not connect to shader compiler server %s, compiling in process", m_shaderCompilerServerName.c_str());
+			delete shaderCompilerClient;
+		}
+	}
+#else
+	m_inProcessCompilation = false;
+#endif
+}
+
+CrShaderManager::~CrShaderManager()
+{
+#if defined(CR_SHADER_COMPILER_IN_PROCESS)
+	for (CrShaderCompilerClient* shaderCompilerClient : m_idleShaderCompilerClients)
+	{
+		delete shaderCompilerClient;
+	}
+#endif
+}
+
 void CrShaderManager::Initialize()
 {
 	CrAssert(ShaderManager == nullptr);
@@ -88,15 +147,212 @@ crgfx::ShaderBytecodeHandle CrShaderManager::CompileShaderBytecode
 	const CrShaderBytecodeCompilationDescriptor& bytecodeDescriptor,
 	const CrShaderCompilerDefines& defines
 ) const
+{
+	if (m_inProcessCompilation)
+	{
+		return CompileShaderBytecodeInProcess(bytecodeDescriptor, defines);
+	}
+	else
+	{
+		return CompileShaderBytecodeOutOfProcess(bytecodeDescriptor, defines);
+	}
+}
+
+crgfx::ShaderBytecodeHandle CrShaderManager::CompileShaderBytecodeInProcess
+(
+	const CrShaderBytecodeCompilationDescriptor& bytecodeDescriptor,
+	const CrShaderCompilerDefines& defines
+) const
+{
+#if defined(CR_SHADER_COMPILER_IN_PROCESS)
+
+	CompilationDescriptor compilationDescriptor;
+	compilationDescriptor.inputPath   = bytecodeDescriptor.path;
+	compilationDescriptor.inputSource = bytecodeDescriptor.source;
+	compilationDescriptor.entryPoint  = bytecodeDescriptor.entryPoint.c_str();
+	compilationDescriptor.shaderStage = bytecodeDescriptor.stage;
+	compilationDescriptor.platform    = bytecodeDescriptor.platform;
+	compilationDescriptor.graphicsApi = bytecodeDescriptor.graphicsApi;
+	compilationDescriptor.defines     = defines.GetDefines();
+
+	CrShaderCompiler::CreatePDBDirectory(bytecodeDescriptor.platform, bytecodeDescriptor.graphicsApi);
+
+	crstl::timer compilationTime;
+
+	crstl::vector<uint8_t> compilationOutput;
+	crstl::string compilationStatus;
+	bool compiled = false;
+	bool success = false;
+
+	if (CrShaderCompilerClient* shaderCompilerClient = AcquireShaderCompilerClient())
+	{
+		success = shaderCompilerClient->Compile(compilationDescriptor, compilationOutput, compilationStatus);
+
+		// If the server went away we compile the shader ourselves
+		compiled = shaderCompilerClient->IsConnected();
+
+		ReleaseShaderCompilerClient(shaderCompilerClient);
+	}
+
+	if (!compiled)
+	{
+		success = CrShaderCompiler::Compile(compilationDescriptor, compilationOutput, compilationStatus);
+	}
+
+	if (success)
+	{
+		// The output has the same layout as the file the executable would have written
+		CrReadBufferStream compilationOutputStream(compilationOutput.data(), compilationOutput.size());
+		crgfx::ShaderBytecodeHandle bytecode = crgfx::ShaderBytecodeHandle(new crgfx::ShaderBytecode());
+		compilationOutputStream << *bytecode.get();
+
+		if (!compilationOutputStream.IsValid())
+		{
+			CrLog("Compilation output for %s is truncated", bytecodeDescriptor.entryPoint.c_str());
+			return nullptr;
+		}
+
+		CrLog("Compiled %s [%s] for %s %s %s (%f ms)",
+			bytecodeDescriptor.entryPoint.c_str(),
+			bytecodeDescriptor.path.c_str(),
+			cr::Platform::ToString(bytecodeDescriptor.platform),
+			crgfx::GraphicsApi::ToString(bytecodeDescriptor.graphicsApi),
+			compiled ? "through server" : "in process",
+			compilationTime.elapsed().milliseconds());
+
+		return bytecode;
+	}
+	else
+	{
+		// Shaders are compiled while their sources are being edited, so failing is expected. Callers keep what they had
+		CrLog("Failed to compile %s [%s]\n%s", bytecodeDescriptor.entryPoint.c_str(), bytecodeDescriptor.path.c_str(), compilationStatus.c_str());
+		return nullptr;
+	}
+
+#else
+
+	return CompileShaderBytecodeOutOfProcess(bytecodeDescriptor, defines);
+
+#endif
+}
+
+#if defined(CR_SHADER_COMPILER_IN_PROCESS)
+
+CrShaderCompilerClient* CrShaderManager::AcquireShaderCompilerClient() const
+{
+	{
+		CrScopedLock lock(m_shaderCompilerClientMutex);
+
+		if (!m_idleShaderCompilerClients.empty())
+		{
+			CrShaderCompilerClient* shaderCompilerClient = m_idleShaderCompilerClients.back();
+			m_idleShaderCompilerClients.pop_back();
+			return shaderCompilerClient;
+		}
+
+		if (!m_shaderCompilerServerAvailable)
+		{
+			return nullptr;
+		}
+	}
+
+	// Connect outside of the lock so that other threads can keep taking and returning connections
+	CrShaderCompilerClient* shaderCompilerClient = new CrShaderCompilerClient();
+
+	if (shaderCompilerClient->Connect(m_shaderCompilerServerName.c_str()))
+	{
+		return shaderCompilerClient;
+	}
+
+	CrLog("Could not open another connection to shader compiler server %s, compiling in process", m_shaderCompilerServerName.c_str());
+
+	{
+		CrScopedLock lock(m_shaderCompilerClientMutex);
+		m_shaderCompilerServerAvailable = false;
+	}
+
+	delete shaderCompilerClient;
+	return nullptr;
+}
+
+void CrShaderManager::ReleaseShaderCompilerClient(CrShaderCompilerClient* shaderCompilerClient) const
+{
+	CrScopedLock lock(m_shaderCompilerClientMutex);
+
+	if (shaderCompilerClient->IsConnected())
+	{
+		m_idleShaderCompilerClients.push_back(shaderCompilerClient);
+	}
+	else
+	{
+		// The server went away, don't open new connections to it
+		m_shaderCompilerServerAvailable = false;
+		delete shaderCompilerClient;
+	}
+}
+
+#endif
+
+crgfx::ShaderBytecodeHandle CrShaderManager::CompileShaderBytecodeOutOfProcess
+(
+	const CrShaderBytecodeCompilationDescriptor& bytecodeDescriptor,
+	const CrShaderCompilerDefines& defines
+) const
 {
 	CrFixedPath ShaderCacheDirectory = GetCompiledShadersPath(bytecodeDescriptor.platform, bytecodeDescriptor.graphicsApi);
 
 	crstl::create_directories(ShaderCacheDirectory.c_str());
 
+	CrFixedPath inputPath = bytecodeDescriptor.path;
+	bool temporaryInput = !bytecodeDescriptor.source.empty();
+
+	// Name the files we write after everything that affects the compilation, so that concurrent compilations
+	// never share their input or their output files
+	CrHash compilationHash(bytecodeDescriptor.path.c_str(), (uint32_t)bytecodeDescriptor.path.length());
+	compilationHash << CrHash(bytecodeDescriptor.source.c_str(), (uint32_t)bytecodeDescriptor.source.length());
+	compilationHash << CrHash(bytecodeDescriptor.entryPoint.c_str(), (uint32_t)bytecodeDescriptor.entryPoint.length());
+	compilationHash << CrHash(bytecodeDescriptor.stage);
+	compilationHash << CrHash(bytecodeDescriptor.platform);
+	compilationHash << CrHash(bytecodeDescriptor.graphicsApi);
+
+	for (const crstl::string& define : defines.GetDefines())
+	{
+		compilationHash << CrHash(define.c_str(), (uint32_t)define.length());
+	}
+
+	CrFixedPath compilationName = bytecodeDescriptor.path.filename();
+	size_t extensionDotPosition = compilationName.find_last_of(".");
+	if (extensionDotPosition != compilationName.npos)
+	{
+		compilationName.resize(extensionDotPosition);
+	}
+
+	char compilationHashString[32];
+	snprintf(compilationHashString, sizeof(compilationHashString), "_%016llx", (unsigned long long)compilationHash.GetHash());
+	compilationName += compilationHashString;
+
+	// The executable can only read its source from a file
+	if (temporaryInput)
+	{
+		inputPath = ShaderCacheDirectory;
+		inputPath /= compilationName.c_str();
+		inputPath += ".hlsl";
+
+		if (crstl::file inputFile = crstl::file(inputPath.c_str(), crstl::file_flags::force_create | crstl::file_flags::write))
+		{
+			inputFile.write((void*)bytecodeDescriptor.source.c_str(), bytecodeDescriptor.source.length());
+		}
+		else
+		{
+			CrLog("Could not write shader source to %s", inputPath.c_str());
+			return nullptr;
+		}
+	}
+
 	crstl::fixed_string512 commandLine;
 
 	commandLine += " -input \"";
-	commandLine += bytecodeDescriptor.path.c_str();
+	commandLine += inputPath.c_str();
 	commandLine += "\" ";
 	
 	commandLine += "-entrypoint ";
@@ -109,13 +365,7 @@ crgfx::ShaderBytecodeHandle CrShaderManager::CompileShaderBytecode
 
 	commandLine += "-reflection ";
 
-	CrFixedPath filename = bytecodeDescriptor.path.filename();
-	size_t extensionDotPosition = filename.find_last_of(".");
-	if (extensionDotPosition != filename.npos)
-	{
-		filename.resize(extensionDotPosition);
-	}
-
+	CrFixedPath filename = compilationName;
 	filename += "_";
 	filename += bytecodeDescriptor.entryPoint.c_str();
 	filename += GetShaderBytecodeExtension(bytecodeDescriptor.graphicsApi);
@@ -152,12 +402,23 @@ crgfx::ShaderBytecodeHandle CrShaderManager::CompileShaderBytecode
 	{
 		crstl::process_exit_status exitStatus = process.wait();
 
+		if (temporaryInput)
+		{
+			crstl::delete_file(inputPath.c_str());
+		}
+
 		if (exitStatus.get_exit_code() >= 0)
 		{
 			// Serialize in bytecode
-			CrReadFileStream compilationOutput(outputPath.c_str());
+			CrMappedFileStream compilationOutput(outputPath.c_str());
 			crgfx::ShaderBytecodeHandle bytecode = crgfx::ShaderBytecodeHandle(new crgfx::ShaderBytecode());
-			compilationOutput << *bytecode.get();
+			compilationOutput.GetStream() << *bytecode.get();
+
+			if (!compilationOutput.GetStream().IsValid())
+			{
+				CrLog("Compilation output %s is missing or truncated", outputPath.c_str());
+				return nullptr;
+			}
 
 			CrLog("Compiled %s [%s] for %s %s (%f ms)",
 				bytecodeDescriptor.entryPoint.c_str(),
@@ -173,7 +434,7 @@ crgfx::ShaderBytecodeHandle CrShaderManager::CompileShaderBytecode
 			crstl::string processOutput;
 			processOutput.resize_uninitialized(2048);
 			process.read_stdout(processOutput.data(), processOutput.size());
-			CrAssertMsg(false, "%s", processOutput.data());
+			CrLog("Failed to compile %s [%s]\n%s", bytecodeDescriptor.entryPoint.c_str(), bytecodeDescriptor.path.c_str(), processOutput.data());
 		}
 	}
 	else
@@ -4,7 +4,14 @@
 
 #include "Graphics/CrGraphicsForwardDeclarations.h"
 
+#include "Core/Threading/CrMutex.h"
+
+#include "crstl/string.h"
+#include "crstl/unique_ptr.h"
+#include "crstl/vector.h"
+
 class IDevice;
+class CrShaderCompilerClient;
 
 struct CrShaderCompilationDescriptor;
 struct CrShaderBytecodeCompilationDescriptor;
@@ -19,6 +26,10 @@ public:
 
 	static void Deinitialize();
 
+	~CrShaderManager();
+
+	// Shaders can be compiled from several threads at once. Out of process compilations name their input
+	// and output files after a hash of the whole compilation, so they never overlap either
 	crgfx::ShaderBytecodeHandle CompileShaderBytecode(const CrShaderBytecodeCompilationDescriptor& bytecodeDescriptor) const;
 
 	crgfx::ShaderBytecodeHandle CompileShaderBytecode(const CrShaderBytecodeCompilationDescriptor& bytecodeDescriptor, const CrShaderCompilerDefines& defines) const;
@@ -28,6 +39,40 @@ public:
 	crgfx::ComputeShaderHandle CompileComputeShader(const CrShaderCompilationDescriptor& bytecodeLoadDescriptor) const;
 
 	CrFixedPath GetCompiledShadersPath(cr::Platform::T platform, crgfx::GraphicsApi::T graphicsApi) const;
+
+private:
+
+	CrShaderManager();
+
+	// Compiles by calling the shader compiler library directly, in memory
+	crgfx::ShaderBytecodeHandle CompileShaderBytecodeInProcess(const CrShaderBytecodeCompilationDescriptor& bytecodeDescriptor, const CrShaderCompilerDefines& defines) const;
+
+	// Compiles by launching the shader compiler executable and reading back the file it produces
+	crgfx::ShaderBytecodeHandle CompileShaderBytecodeOutOfProcess(const CrShaderBytecodeCompilationDescriptor& bytecodeDescriptor, const CrShaderCompilerDefines& defines) const;
+
+	// Takes an idle connection to the shader compiler server, or connects a new one. Returns null if there is no
+	// server to compile through, in which case the caller compiles the shader itself. Only available where the
+	// shader compiler library is linked, see CR_SHADER_COMPILER_IN_PROCESS
+	CrShaderCompilerClient* AcquireShaderCompilerClient() const;
+
+	void ReleaseShaderCompilerClient(CrShaderCompilerClient* shaderCompilerClient) const;
+
+	// The shader compiler library is only linked into the runtime on platforms that can run it. Otherwise, or
+	// if requested through the command line, we fall back to launching the shader compiler executable
+	bool m_inProcessCompilation;
+
+	// Shader compiler server, if one was requested through the command line. Shaders compiled through the
+	// server are shared with other tools and survive restarting the runtime
+	crstl::string m_shaderCompilerServerName;
+
+	// A connection serves one compilation at a time, so every thread that compiles takes its own from here
+	// and gives it back when it's done. The pool grows up to the number of threads compiling at once
+	mutable crstl::vector<CrShaderCompilerClient*> m_idleShaderCompilerClients;
+
+	// Cleared once the server can't be connected to or went away, so we stop trying to open connections
+	mutable bool m_shaderCompilerServerAvailable;
+
+	mutable CrMutex m_shaderCompilerClientMutex;
 };
 
 extern CrShaderManager* ShaderManager;
\ No newline at end of file
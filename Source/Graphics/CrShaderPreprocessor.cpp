@@ -0,0 +1,1163 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "Graphics/CrShaderPreprocessor.h"
+
+#include <stdlib.h>
+
+// Guards against include cycles in files that don't have include guards
+static const uint32_t MaxIncludeDepth = 64;
+
+static bool IsIdentifierStart(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool IsIdentifierCharacter(char c)
+{
+	return IsIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+static bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static bool IsDirective(const CrShaderTokenLine& line)
+{
+	return !line.empty() && line[0].type == CrShaderTokenType::Punctuator && line[0].text == "#";
+}
+
+static const char* ThreeCharacterPunctuators[] = { "<<=", ">>=", "..." };
+
+static const char* TwoCharacterPunctuators[] =
+{
+	"##", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "++", "--", "->", "::",
+	"+=", "-=", "*=", "/=", "%=", "&=", "|=", "^="
+};
+
+// Gets the filename out of an include directive, either in quotes or angle brackets
+static bool GetIncludeFilename(const CrShaderTokenLine& line, crstl::string& filename)
+{
+	if (line.size() < 3)
+	{
+		return false;
+	}
+
+	const CrShaderToken& firstToken = line[2];
+
+	if (firstToken.type == CrShaderTokenType::String && firstToken.text.length() >= 2 && firstToken.text[0] == '"')
+	{
+		filename = firstToken.text.substr(1, firstToken.text.length() - 2);
+		return true;
+	}
+	else if (firstToken.text == "<")
+	{
+		filename.clear();
+
+		for (uint32_t i = 3; i < line.size(); ++i)
+		{
+			if (line[i].text == ">")
+			{
+				return true;
+			}
+
+			filename += line[i].text;
+		}
+	}
+
+	return false;
+}
+
+void CrShaderPreprocessor::Tokenize(const crstl::string& source, crstl::vector<CrShaderTokenLine>& lines)
+{
+	const char* c = source.c_str();
+	const char* end = c + source.length();
+
+	CrShaderTokenLine currentLine;
+	bool leadingSpace = false;
+
+	const auto EndLine = [&currentLine, &lines]()
+	{
+		if (!currentLine.empty())
+		{
+			lines.push_back(currentLine);
+			currentLine.clear();
+		}
+	};
+
+	while (c < end)
+	{
+		// Line continuations join two physical lines into one logical line
+		if (c[0] == '\\' && (c + 1 < end) && (c[1] == '\n' || (c[1] == '\r' && c + 2 < end && c[2] == '\n')))
+		{
+			c += c[1] == '\r' ? 3 : 2;
+			leadingSpace = true;
+		}
+		else if (c[0] == '\n')
+		{
+			EndLine();
+			leadingSpace = false;
+			c++;
+		}
+		else if (c[0] == ' ' || c[0] == '\t' || c[0] == '\r' || c[0] == '\f' || c[0] == '\v')
+		{
+			leadingSpace = true;
+			c++;
+		}
+		else if (c[0] == '/' && c + 1 < end && c[1] == '/')
+		{
+			while (c < end && c[0] != '\n')
+			{
+				c++;
+			}
+		}
+		else if (c[0] == '/' && c + 1 < end && c[1] == '*')
+		{
+			// A block comment is a single space, even if it spans several lines
+			c += 2;
+
+			while (c < end && !(c[0] == '*' && c + 1 < end && c[1] == '/'))
+			{
+				c++;
+			}
+
+			c = c < end ? c + 2 : end;
+			leadingSpace = true;
+		}
+		else
+		{
+			CrShaderToken token;
+			token.leadingSpace = leadingSpace;
+			leadingSpace = false;
+
+			const char* tokenStart = c;
+
+			if (IsIdentifierStart(c[0]))
+			{
+				token.type = CrShaderTokenType::Identifier;
+
+				while (c < end && IsIdentifierCharacter(c[0]))
+				{
+					c++;
+				}
+			}
+			else if (IsDigit(c[0]) || (c[0] == '.' && c + 1 < end && IsDigit(c[1])))
+			{
+				token.type = CrShaderTokenType::Number;
+
+				while (c < end && (IsIdentifierCharacter(c[0]) || c[0] == '.'))
+				{
+					// Exponents can be signed, e.g. 1.0e-5
+					if ((c[0] == 'e' || c[0] == 'E' || c[0] == 'p' || c[0] == 'P') && c + 1 < end && (c[1] == '+' || c[1] == '-'))
+					{
+						c++;
+					}
+
+					c++;
+				}
+			}
+			else if (c[0] == '"' || c[0] == '\'')
+			{
+				token.type = CrShaderTokenType::String;
+
+				char quote = c[0];
+				c++;
+
+				while (c < end && c[0] != quote && c[0] != '\n')
+				{
+					c += (c[0] == '\\' && c + 1 < end) ? 2 : 1;
+				}
+
+				c = c < end && c[0] == quote ? c + 1 : c;
+			}
+			else
+			{
+				token.type = CrShaderTokenType::Punctuator;
+
+				size_t punctuatorLength = 1;
+
+				for (const char* punctuator : ThreeCharacterPunctuators)
+				{
+					if (c + 3 <= end && c[0] == punctuator[0] && c[1] == punctuator[1] && c[2] == punctuator[2])
+					{
+						punctuatorLength = 3;
+						break;
+					}
+				}
+
+				if (punctuatorLength == 1)
+				{
+					for (const char* punctuator : TwoCharacterPunctuators)
+					{
+						if (c + 2 <= end && c[0] == punctuator[0] && c[1] == punctuator[1])
+						{
+							punctuatorLength = 2;
+							break;
+						}
+					}
+				}
+
+				c += punctuatorLength;
+			}
+
+			token.text = crstl::string(tokenStart, (size_t)(c - tokenStart));
+			currentLine.push_back(token);
+		}
+	}
+
+	EndLine();
+}
+
+CrHash CrShaderPreprocessor::HashSource(const crstl::string& source, crstl::vector<crstl::string>& includes)
+{
+	crstl::vector<CrShaderTokenLine> lines;
+	Tokenize(source, lines);
+
+	// Tokens are separated so that a b and ab don't hash the same. Directives end at the end of the line,
+	// so those are kept on their own lines
+	crstl::string hashableSource;
+
+	for (const CrShaderTokenLine& line : lines)
+	{
+		bool isDirective = IsDirective(line);
+
+		if (isDirective)
+		{
+			hashableSource += "\n";
+
+			crstl::string includeFilename;
+			if (line.size() >= 2 && line[1].text == "include" && GetIncludeFilename(line, includeFilename))
+			{
+				includes.push_back(includeFilename);
+			}
+		}
+
+		for (const CrShaderToken& token : line)
+		{
+			hashableSource += token.text;
+			hashableSource += " ";
+		}
+
+		if (isDirective)
+		{
+			hashableSource += "\n";
+		}
+	}
+
+	return CrHash(hashableSource.c_str(), (uint32_t)hashableSource.length());
+}
+
+// Scans a physical line for the start and end of block comments, so that we know whether the next line starts inside one
+static bool UpdateBlockCommentState(const crstl::string& line, bool insideBlockComment)
+{
+	for (size_t i = 0; i < line.length(); ++i)
+	{
+		if (insideBlockComment)
+		{
+			if (line[i] == '*' && i + 1 < line.length() && line[i + 1] == '/')
+			{
+				insideBlockComment = false;
+				i++;
+			}
+		}
+		else if (line[i] == '"')
+		{
+			// Skip strings, they may contain comment markers
+			for (i++; i < line.length() && line[i] != '"'; ++i)
+			{
+				i += line[i] == '\\' ? 1 : 0;
+			}
+		}
+		else if (line[i] == '/' && i + 1 < line.length())
+		{
+			if (line[i + 1] == '/')
+			{
+				break;
+			}
+			else if (line[i + 1] == '*')
+			{
+				insideBlockComment = true;
+				i++;
+			}
+		}
+	}
+
+	return insideBlockComment;
+}
+
+static bool ResolveIncludesRecursive
+(
+	const crstl::string& filename,
+	const CrShaderSourceLookup& sourceLookup,
+	crstl::vector<crstl::string>& includeStack,
+	crstl::vector<crstl::string>& pragmaOnceFiles,
+	crstl::string& resolvedSource
+)
+{
+	for (const crstl::string& onceFile : pragmaOnceFiles)
+	{
+		if (onceFile == filename)
+		{
+			return true;
+		}
+	}
+
+	if (includeStack.size() >= MaxIncludeDepth)
+	{
+		CrLog("Include depth exceeded while including %s. Is there an include cycle?", filename.c_str());
+		return false;
+	}
+
+	const crstl::string* source = sourceLookup(filename);
+
+	if (!source)
+	{
+		CrLog("Include file %s not found", filename.c_str());
+		return false;
+	}
+
+	includeStack.push_back(filename);
+
+	bool success = true;
+	bool insideBlockComment = false;
+	uint32_t lineNumber = 1;
+
+	source->split('\n', [&](const crstl::string_view& lineView)
+	{
+		crstl::string line(lineView);
+
+		bool startsInsideBlockComment = insideBlockComment;
+		insideBlockComment = UpdateBlockCommentState(line, insideBlockComment);
+
+		// Only lines that are directives can include files. Includes inside comments are left as they are
+		crstl::vector<CrShaderTokenLine> lineTokens;
+
+		if (!startsInsideBlockComment)
+		{
+			CrShaderPreprocessor::Tokenize(line, lineTokens);
+		}
+
+		crstl::string includeFilename;
+
+		if (lineTokens.size() == 1 && IsDirective(lineTokens[0]) && lineTokens[0].size() >= 2 && lineTokens[0][1].text == "pragma" &&
+			lineTokens[0].size() >= 3 && lineTokens[0][2].text == "once")
+		{
+			pragmaOnceFiles.push_back(filename);
+			resolvedSource += "\n";
+		}
+		else if (lineTokens.size() == 1 && IsDirective(lineTokens[0]) && lineTokens[0].size() >= 2 && lineTokens[0][1].text == "include" &&
+			GetIncludeFilename(lineTokens[0], includeFilename))
+		{
+			// Line directives make compiler errors point at the original files
+			resolvedSource += "#line 1 \"" + includeFilename + "\"\n";
+			success &= ResolveIncludesRecursive(includeFilename, sourceLookup, includeStack, pragmaOnceFiles, resolvedSource);
+			resolvedSource += "\n#line " + crstl::string(lineNumber + 1) + " \"" + filename + "\"\n";
+		}
+		else
+		{
+			resolvedSource += line;
+			resolvedSource += "\n";
+		}
+
+		lineNumber++;
+	});
+
+	includeStack.pop_back();
+
+	return success;
+}
+
+bool CrShaderPreprocessor::ResolveIncludes(const crstl::string& filename, const CrShaderSourceLookup& sourceLookup, crstl::string& resolvedSource)
+{
+	crstl::vector<crstl::string> includeStack;
+	crstl::vector<crstl::string> pragmaOnceFiles;
+	return ResolveIncludesRecursive(filename, sourceLookup, includeStack, pragmaOnceFiles, resolvedSource);
+}
+
+CrShaderPreprocessor::CrShaderPreprocessor(const CrShaderSourceLookup& sourceLookup) : m_sourceLookup(sourceLookup)
+{
+
+}
+
+void CrShaderPreprocessor::AddDefine(const crstl::string& define)
+{
+	// A define without a value is defined as 1, like the compiler does
+	size_t equalsPosition = define.find('=');
+
+	crstl::string defineLine = "#define ";
+
+	if (equalsPosition != define.npos)
+	{
+		defineLine += define.substr(0, equalsPosition);
+		defineLine += " ";
+		defineLine += define.substr(equalsPosition + 1);
+	}
+	else
+	{
+		defineLine += define;
+		defineLine += " 1";
+	}
+
+	crstl::vector<CrShaderTokenLine> lines;
+	Tokenize(defineLine, lines);
+
+	if (!lines.empty())
+	{
+		ParseDefine(lines[0]);
+	}
+}
+
+bool CrShaderPreprocessor::Preprocess(const crstl::string& filename)
+{
+	bool success = ProcessFile(filename, 0);
+	return success && m_errors.empty();
+}
+
+CrHash CrShaderPreprocessor::GetHash() const
+{
+	return CrHash(m_output.c_str(), (uint32_t)m_output.length());
+}
+
+void CrShaderPreprocessor::AddError(const crstl::string& filename, const char* message, const crstl::string& detail)
+{
+	m_errors += filename;
+	m_errors += ": ";
+	m_errors += message;
+	m_errors += detail;
+	m_errors += "\n";
+}
+
+bool CrShaderPreprocessor::ProcessFile(const crstl::string& filename, uint32_t includeDepth)
+{
+	for (const crstl::string& onceFile : m_pragmaOnceFiles)
+	{
+		if (onceFile == filename)
+		{
+			return true;
+		}
+	}
+
+	if (includeDepth >= MaxIncludeDepth)
+	{
+		AddError(filename, "Include depth exceeded. Is there an include cycle?", "");
+		return false;
+	}
+
+	const crstl::string* source = m_sourceLookup(filename);
+
+	if (!source)
+	{
+		AddError(filename, "Include file not found", "");
+		return false;
+	}
+
+	bool alreadyIncluded = false;
+
+	for (const crstl::string& includedFile : m_includedFiles)
+	{
+		alreadyIncluded |= includedFile == filename;
+	}
+
+	if (!alreadyIncluded)
+	{
+		m_includedFiles.push_back(filename);
+	}
+
+	crstl::vector<CrShaderTokenLine> lines;
+	Tokenize(*source, lines);
+
+	struct CrConditional
+	{
+		// Whether the code in the current branch reaches the compiler
+		bool active;
+
+		// Whether a previous branch of this conditional was taken, or the enclosing one is inactive
+		bool branchTaken;
+
+		bool parentActive;
+	};
+
+	crstl::vector<CrConditional> conditionals;
+	bool success = true;
+
+	for (const CrShaderTokenLine& line : lines)
+	{
+		bool active = conditionals.empty() || conditionals.back().active;
+
+		if (IsDirective(line))
+		{
+			// Macro invocations don't continue past directives
+			FlushTokens();
+
+			const crstl::string& directive = line.size() >= 2 ? line[1].text : crstl::string();
+
+			if (directive == "if" || directive == "ifdef" || directive == "ifndef")
+			{
+				CrConditional conditional;
+				conditional.parentActive = active;
+				conditional.active = false;
+
+				if (active)
+				{
+					if (directive == "if")
+					{
+						success &= EvaluateCondition(filename, line, 2, conditional.active);
+					}
+					else if (line.size() >= 3)
+					{
+						bool defined = m_macros.find(line[2].text) != m_macros.end();
+						conditional.active = directive == "ifdef" ? defined : !defined;
+					}
+					else
+					{
+						AddError(filename, "Missing macro name in #", directive);
+					}
+				}
+
+				conditional.branchTaken = conditional.active || !active;
+				conditionals.push_back(conditional);
+			}
+			else if (directive == "elif" || directive == "else")
+			{
+				if (conditionals.empty())
+				{
+					AddError(filename, "Unexpected #", directive);
+					continue;
+				}
+
+				CrConditional& conditional = conditionals.back();
+
+				if (conditional.branchTaken)
+				{
+					conditional.active = false;
+				}
+				else if (directive == "elif")
+				{
+					success &= EvaluateCondition(filename, line, 2, conditional.active);
+					conditional.branchTaken = conditional.active;
+				}
+				else
+				{
+					conditional.active = true;
+					conditional.branchTaken = true;
+				}
+			}
+			else if (directive == "endif")
+			{
+				if (conditionals.empty())
+				{
+					AddError(filename, "Unexpected #", directive);
+					continue;
+				}
+
+				conditionals.pop_back();
+			}
+			else if (active)
+			{
+				success &= ProcessDirective(filename, line, includeDepth);
+			}
+		}
+		else if (active)
+		{
+			for (const CrShaderToken& token : line)
+			{
+				m_pendingTokens.push_back(token);
+			}
+		}
+	}
+
+	FlushTokens();
+
+	if (!conditionals.empty())
+	{
+		AddError(filename, "Unterminated conditional", "");
+		success = false;
+	}
+
+	return success;
+}
+
+bool CrShaderPreprocessor::ProcessDirective(const crstl::string& filename, const CrShaderTokenLine& line, uint32_t includeDepth)
+{
+	// A lone # is a null directive
+	if (line.size() < 2)
+	{
+		return true;
+	}
+
+	const crstl::string& directive = line[1].text;
+
+	if (directive == "include")
+	{
+		crstl::string includeFilename;
+
+		if (!GetIncludeFilename(line, includeFilename))
+		{
+			AddError(filename, "Malformed #include", "");
+			return false;
+		}
+
+		return ProcessFile(includeFilename, includeDepth + 1);
+	}
+	else if (directive == "define")
+	{
+		if (!ParseDefine(line))
+		{
+			AddError(filename, "Malformed #define", "");
+			return false;
+		}
+	}
+	else if (directive == "undef")
+	{
+		if (line.size() >= 3)
+		{
+			m_macros.erase(line[2].text);
+		}
+	}
+	else if (directive == "pragma" && line.size() >= 3 && line[2].text == "once")
+	{
+		m_pragmaOnceFiles.push_back(filename);
+	}
+	else if (directive == "error")
+	{
+		crstl::string message;
+
+		for (uint32_t i = 2; i < line.size(); ++i)
+		{
+			message += line[i].text;
+			message += " ";
+		}
+
+		AddError(filename, "#error ", message);
+		return false;
+	}
+	else if (directive == "line")
+	{
+		// Line directives only change diagnostics
+	}
+	else
+	{
+		// Anything else, like other pragmas, reaches the compiler and can change the code it generates
+		m_output += "\n";
+
+		for (const CrShaderToken& token : line)
+		{
+			m_output += token.text;
+			m_output += " ";
+		}
+
+		m_output += "\n";
+	}
+
+	return true;
+}
+
+bool CrShaderPreprocessor::ParseDefine(const CrShaderTokenLine& line)
+{
+	if (line.size() < 3 || line[2].type != CrShaderTokenType::Identifier)
+	{
+		return false;
+	}
+
+	const crstl::string& macroName = line[2].text;
+
+	CrShaderMacro macro;
+	uint32_t bodyStart = 3;
+
+	// Function-like macros have the parenthesis right after the name
+	if (line.size() > 3 && line[3].text == "(" && !line[3].leadingSpace)
+	{
+		macro.functionLike = true;
+
+		uint32_t i = 4;
+
+		for (; i < line.size() && line[i].text != ")"; ++i)
+		{
+			if (line[i].type == CrShaderTokenType::Identifier)
+			{
+				macro.parameters.push_back(line[i].text);
+			}
+			else if (line[i].text == "...")
+			{
+				macro.parameters.push_back("__VA_ARGS__");
+				macro.variadic = true;
+			}
+			else if (line[i].text != ",")
+			{
+				return false;
+			}
+		}
+
+		if (i == line.size())
+		{
+			return false;
+		}
+
+		bodyStart = i + 1;
+	}
+
+	for (uint32_t i = bodyStart; i < line.size(); ++i)
+	{
+		macro.body.push_back(line[i]);
+	}
+
+	m_macros.erase(macroName);
+	m_macros.insert(macroName, macro);
+
+	return true;
+}
+
+void CrShaderPreprocessor::FlushTokens()
+{
+	if (m_pendingTokens.empty())
+	{
+		return;
+	}
+
+	crstl::vector<CrShaderToken> expandedTokens;
+	crstl::vector<crstl::string> disabledMacros;
+	ExpandTokens(m_pendingTokens, expandedTokens, disabledMacros);
+
+	for (const CrShaderToken& token : expandedTokens)
+	{
+		m_output += token.text;
+		m_output += " ";
+	}
+
+	m_pendingTokens.clear();
+}
+
+void CrShaderPreprocessor::ExpandTokens(const crstl::vector<CrShaderToken>& tokens, crstl::vector<CrShaderToken>& expandedTokens, crstl::vector<crstl::string>& disabledMacros)
+{
+	for (uint32_t i = 0; i < tokens.size(); ++i)
+	{
+		const CrShaderToken& token = tokens[i];
+
+		if (token.type != CrShaderTokenType::Identifier)
+		{
+			expandedTokens.push_back(token);
+			continue;
+		}
+
+		bool disabled = false;
+
+		for (const crstl::string& disabledMacro : disabledMacros)
+		{
+			disabled |= disabledMacro == token.text;
+		}
+
+		const auto macroIterator = m_macros.find(token.text);
+
+		if (disabled || macroIterator == m_macros.end())
+		{
+			expandedTokens.push_back(token);
+			continue;
+		}
+
+		// Copy the macro, expanding may redefine it through nested directives
+		const CrShaderMacro macro = macroIterator->second;
+
+		crstl::vector<crstl::vector<CrShaderToken>> arguments;
+
+		if (macro.functionLike)
+		{
+			// A function-like macro without arguments is just an identifier
+			if (i + 1 >= tokens.size() || tokens[i + 1].text != "(")
+			{
+				expandedTokens.push_back(token);
+				continue;
+			}
+
+			uint32_t depth = 0;
+			uint32_t argumentEnd = i + 1;
+			arguments.push_back(crstl::vector<CrShaderToken>());
+
+			for (; argumentEnd < tokens.size(); ++argumentEnd)
+			{
+				const crstl::string& text = tokens[argumentEnd].text;
+
+				if (text == "(")
+				{
+					depth++;
+
+					if (depth == 1)
+					{
+						continue;
+					}
+				}
+				else if (text == ")")
+				{
+					depth--;
+
+					if (depth == 0)
+					{
+						break;
+					}
+				}
+				else if (text == "," && depth == 1)
+				{
+					// Variadic macros gather the remaining arguments, commas included
+					if (!(macro.variadic && arguments.size() == macro.parameters.size()))
+					{
+						arguments.push_back(crstl::vector<CrShaderToken>());
+						continue;
+					}
+				}
+
+				arguments.back().push_back(tokens[argumentEnd]);
+			}
+
+			// Without a closing parenthesis the invocation is malformed, leave it to the compiler to report
+			if (argumentEnd == tokens.size())
+			{
+				expandedTokens.push_back(token);
+				continue;
+			}
+
+			i = argumentEnd;
+		}
+
+		crstl::vector<CrShaderToken> substitutedTokens;
+		SubstituteMacro(macro, arguments, substitutedTokens, disabledMacros);
+
+		// Rescan the result for more macros, with this one disabled
+		disabledMacros.push_back(token.text);
+		ExpandTokens(substitutedTokens, expandedTokens, disabledMacros);
+		disabledMacros.pop_back();
+	}
+}
+
+void CrShaderPreprocessor::SubstituteMacro
+(
+	const CrShaderMacro& macro,
+	const crstl::vector<crstl::vector<CrShaderToken>>& arguments,
+	crstl::vector<CrShaderToken>& substitutedTokens,
+	crstl::vector<crstl::string>& disabledMacros
+)
+{
+	const crstl::vector<CrShaderToken> emptyArgument;
+
+	const auto GetParameterIndex = [&macro](const CrShaderToken& token) -> int32_t
+	{
+		if (macro.functionLike && token.type == CrShaderTokenType::Identifier)
+		{
+			for (uint32_t i = 0; i < macro.parameters.size(); ++i)
+			{
+				if (macro.parameters[i] == token.text)
+				{
+					return (int32_t)i;
+				}
+			}
+		}
+
+		return -1;
+	};
+
+	const auto GetArgument = [&arguments, &emptyArgument](int32_t parameterIndex) -> const crstl::vector<CrShaderToken>&
+	{
+		return (uint32_t)parameterIndex < arguments.size() ? arguments[parameterIndex] : emptyArgument;
+	};
+
+	for (uint32_t i = 0; i < macro.body.size(); ++i)
+	{
+		const CrShaderToken& token = macro.body[i];
+
+		// Stringizing, #parameter
+		if (macro.functionLike && token.text == "#" && i + 1 < macro.body.size() && GetParameterIndex(macro.body[i + 1]) >= 0)
+		{
+			CrShaderToken stringToken;
+			stringToken.type = CrShaderTokenType::String;
+			stringToken.text = "\"";
+
+			const crstl::vector<CrShaderToken>& argument = GetArgument(GetParameterIndex(macro.body[i + 1]));
+
+			for (uint32_t j = 0; j < argument.size(); ++j)
+			{
+				if (j > 0 && argument[j].leadingSpace)
+				{
+					stringToken.text += " ";
+				}
+
+				const crstl::string& text = argument[j].text;
+
+				for (size_t k = 0; k < text.length(); ++k)
+				{
+					if (text[k] == '"' || text[k] == '\\')
+					{
+						stringToken.text += "\\";
+					}
+
+					stringToken.text += crstl::string(&text[k], 1);
+				}
+			}
+
+			stringToken.text += "\"";
+			substitutedTokens.push_back(stringToken);
+			i++;
+			continue;
+		}
+
+		// Token pasting, a ## b
+		if (token.text == "##" && i + 1 < macro.body.size())
+		{
+			const CrShaderToken& nextToken = macro.body[i + 1];
+			int32_t nextParameterIndex = GetParameterIndex(nextToken);
+
+			crstl::vector<CrShaderToken> pastedTokens;
+
+			if (nextParameterIndex >= 0)
+			{
+				pastedTokens = GetArgument(nextParameterIndex);
+			}
+			else
+			{
+				pastedTokens.push_back(nextToken);
+			}
+
+			uint32_t firstUnpasted = 0;
+
+			if (!substitutedTokens.empty() && !pastedTokens.empty())
+			{
+				CrShaderToken& pastedToken = substitutedTokens.back();
+				pastedToken.text += pastedTokens[0].text;
+
+				if (pastedToken.type == CrShaderTokenType::Number || pastedTokens[0].type == CrShaderTokenType::Identifier)
+				{
+					pastedToken.type = IsIdentifierStart(pastedToken.text[0]) ? CrShaderTokenType::Identifier : pastedToken.type;
+				}
+
+				firstUnpasted = 1;
+			}
+
+			for (uint32_t j = firstUnpasted; j < pastedTokens.size(); ++j)
+			{
+				substitutedTokens.push_back(pastedTokens[j]);
+			}
+
+			i++;
+			continue;
+		}
+
+		int32_t parameterIndex = GetParameterIndex(token);
+
+		if (parameterIndex >= 0)
+		{
+			const crstl::vector<CrShaderToken>& argument = GetArgument(parameterIndex);
+
+			// Arguments next to ## are pasted as they are, the rest are fully expanded first
+			bool isPasted = i + 1 < macro.body.size() && macro.body[i + 1].text == "##";
+
+			if (isPasted)
+			{
+				for (const CrShaderToken& argumentToken : argument)
+				{
+					substitutedTokens.push_back(argumentToken);
+				}
+			}
+			else
+			{
+				ExpandTokens(argument, substitutedTokens, disabledMacros);
+			}
+
+			continue;
+		}
+
+		substitutedTokens.push_back(token);
+	}
+}
+
+// Evaluates #if expressions once defined() has been resolved and macros expanded. Identifiers left over evaluate to 0
+struct CrShaderExpressionParser
+{
+	CrShaderExpressionParser(const crstl::vector<CrShaderToken>& tokens) : tokens(tokens) {}
+
+	const crstl::string& Peek() const
+	{
+		static const crstl::string EmptyToken;
+		return position < tokens.size() ? tokens[position].text : EmptyToken;
+	}
+
+	int64_t ParsePrimary()
+	{
+		if (position >= tokens.size())
+		{
+			error = true;
+			return 0;
+		}
+
+		const CrShaderToken& token = tokens[position++];
+
+		if (token.text == "(")
+		{
+			int64_t value = ParseConditional();
+
+			if (Peek() != ")")
+			{
+				error = true;
+			}
+
+			position++;
+			return value;
+		}
+		else if (token.text == "!") { return !ParsePrimary(); }
+		else if (token.text == "~") { return ~ParsePrimary(); }
+		else if (token.text == "-") { return -ParsePrimary(); }
+		else if (token.text == "+") { return ParsePrimary(); }
+		else if (token.type == CrShaderTokenType::Number)
+		{
+			// Integer suffixes are ignored by strtoll, base 0 handles hexadecimal and octal
+			return strtoll(token.text.c_str(), nullptr, 0);
+		}
+		else if (token.type == CrShaderTokenType::Identifier)
+		{
+			return token.text == "true" ? 1 : 0;
+		}
+
+		error = true;
+		return 0;
+	}
+
+	static int32_t GetPrecedence(const crstl::string& op)
+	{
+		if (op == "*" || op == "/" || op == "%") return 10;
+		if (op == "+" || op == "-") return 9;
+		if (op == "<<" || op == ">>") return 8;
+		if (op == "<" || op == "<=" || op == ">" || op == ">=") return 7;
+		if (op == "==" || op == "!=") return 6;
+		if (op == "&") return 5;
+		if (op == "^") return 4;
+		if (op == "|") return 3;
+		if (op == "&&") return 2;
+		if (op == "||") return 1;
+		return -1;
+	}
+
+	int64_t ParseBinary(int32_t minimumPrecedence)
+	{
+		int64_t left = ParsePrimary();
+
+		while (true)
+		{
+			crstl::string op = Peek();
+			int32_t precedence = GetPrecedence(op);
+
+			if (precedence < minimumPrecedence || precedence < 0)
+			{
+				return left;
+			}
+
+			position++;
+			int64_t right = ParseBinary(precedence + 1);
+
+			if      (op == "*")  { left = left * right; }
+			else if (op == "/")  { if (right == 0) { error = true; return 0; } left = left / right; }
+			else if (op == "%")  { if (right == 0) { error = true; return 0; } left = left % right; }
+			else if (op == "+")  { left = left + right; }
+			else if (op == "-")  { left = left - right; }
+			else if (op == "<<") { left = left << right; }
+			else if (op == ">>") { left = left >> right; }
+			else if (op == "<")  { left = left < right; }
+			else if (op == "<=") { left = left <= right; }
+			else if (op == ">")  { left = left > right; }
+			else if (op == ">=") { left = left >= right; }
+			else if (op == "==") { left = left == right; }
+			else if (op == "!=") { left = left != right; }
+			else if (op == "&")  { left = left & right; }
+			else if (op == "^")  { left = left ^ right; }
+			else if (op == "|")  { left = left | right; }
+			else if (op == "&&") { left = left && right; }
+			else if (op == "||") { left = left || right; }
+		}
+	}
+
+	int64_t ParseConditional()
+	{
+		int64_t condition = ParseBinary(1);
+
+		if (Peek() == "?")
+		{
+			position++;
+			int64_t trueValue = ParseConditional();
+
+			if (Peek() != ":")
+			{
+				error = true;
+				return 0;
+			}
+
+			position++;
+			int64_t falseValue = ParseConditional();
+			return condition ? trueValue : falseValue;
+		}
+
+		return condition;
+	}
+
+	const crstl::vector<CrShaderToken>& tokens;
+
+	uint32_t position = 0;
+
+	bool error = false;
+};
+
+bool CrShaderPreprocessor::EvaluateCondition(const crstl::string& filename, const CrShaderTokenLine& line, uint32_t firstToken, bool& result)
+{
+	// Resolve defined first, the macros it refers to must not be expanded
+	crstl::vector<CrShaderToken> conditionTokens;
+
+	for (uint32_t i = firstToken; i < line.size(); ++i)
+	{
+		if (line[i].text == "defined")
+		{
+			crstl::string macroName;
+
+			if (i + 1 < line.size() && line[i + 1].text == "(")
+			{
+				if (i + 3 < line.size() && line[i + 3].text == ")")
+				{
+					macroName = line[i + 2].text;
+				}
+
+				i += 3;
+			}
+			else if (i + 1 < line.size())
+			{
+				macroName = line[i + 1].text;
+				i += 1;
+			}
+
+			CrShaderToken definedToken;
+			definedToken.type = CrShaderTokenType::Number;
+			definedToken.text = m_macros.find(macroName) != m_macros.end() ? "1" : "0";
+			conditionTokens.push_back(definedToken);
+		}
+		else
+		{
+			conditionTokens.push_back(line[i]);
+		}
+	}
+
+	crstl::vector<CrShaderToken> expandedTokens;
+	crstl::vector<crstl::string> disabledMacros;
+	ExpandTokens(conditionTokens, expandedTokens, disabledMacros);
+
+	CrShaderExpressionParser parser(expandedTokens);
+	result = parser.ParseConditional() != 0;
+
+	if (parser.error || parser.position != expandedTokens.size())
+	{
+		crstl::string condition;
+
+		for (uint32_t i = firstToken; i < line.size(); ++i)
+		{
+			condition += line[i].text;
+			condition += " ";
+		}
+
+		AddError(filename, "Invalid conditional expression ", condition);
+		result = false;
+		return false;
+	}
+
+	return true;
+}
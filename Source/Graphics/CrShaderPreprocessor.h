@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Core/CrHash.h"
+
+#include "crstl/fixed_function.h"
+#include "crstl/open_hashmap.h"
+#include "crstl/string.h"
+#include "crstl/vector.h"
+
+namespace CrShaderTokenType
+{
+	enum T : uint8_t
+	{
+		Identifier,
+		Number,
+		String,
+		Punctuator
+	};
+};
+
+struct CrShaderToken
+{
+	crstl::string text;
+
+	CrShaderTokenType::T type = CrShaderTokenType::Punctuator;
+
+	// Whether there was whitespace or a comment before the token. Only needed to tell
+	// function-like macros apart, i.e. #define F(x) from #define F (x)
+	bool leadingSpace = false;
+};
+
+// Tokens of a logical line, i.e. after joining lines ending in a backslash and removing comments
+typedef crstl::vector<CrShaderToken> CrShaderTokenLine;
+
+// Returns the source of an included file or nullptr if it doesn't exist
+typedef crstl::fixed_function<32, const crstl::string*(const crstl::string& filename)> CrShaderSourceLookup;
+
+// Token-level preprocessor for HLSL sources. It follows the C preprocessor closely enough to know the code the
+// compiler will see: object and function-like macros (including # and ##), conditionals, and includes. The result
+// is a hash of the final token stream, which doesn't change with formatting, comments, code in inactive branches
+// or the way macros are spelled out, as well as the files that were actually included
+class CrShaderPreprocessor
+{
+public:
+
+	CrShaderPreprocessor(const CrShaderSourceLookup& sourceLookup);
+
+	// Adds a define the way it is passed to the compiler, either NAME or NAME=VALUE
+	void AddDefine(const crstl::string& define);
+
+	// Preprocesses the file and everything it includes. Returns false if there were errors, such as
+	// missing includes, malformed directives or an active #error
+	bool Preprocess(const crstl::string& filename);
+
+	// Hash of the preprocessed token stream
+	CrHash GetHash() const;
+
+	// Preprocessed tokens separated by spaces. Directives that reach the compiler (e.g. #pragma) are on their own lines
+	const crstl::string& GetOutput() const { return m_output; }
+
+	// The entry file and every file that was included while preprocessing, in the order they were first included
+	const crstl::vector<crstl::string>& GetIncludedFiles() const { return m_includedFiles; }
+
+	const crstl::string& GetErrors() const { return m_errors; }
+
+	// Hashes the tokens of a single source without expanding macros or evaluating conditionals, and returns every file
+	// it includes, even under inactive branches. Whitespace and comments don't change the hash
+	static CrHash HashSource(const crstl::string& source, crstl::vector<crstl::string>& includes);
+
+	// Replaces every #include directive with the contents of the file, recursively. Everything else is left as it is so that
+	// the result can still be compiled with different defines. Files that declare #pragma once are only inserted once
+	static bool ResolveIncludes(const crstl::string& filename, const CrShaderSourceLookup& sourceLookup, crstl::string& resolvedSource);
+
+	static void Tokenize(const crstl::string& source, crstl::vector<CrShaderTokenLine>& lines);
+
+private:
+
+	struct CrShaderMacro
+	{
+		crstl::vector<crstl::string> parameters;
+
+		crstl::vector<CrShaderToken> body;
+
+		bool functionLike = false;
+
+		// The last parameter is __VA_ARGS__ and takes any remaining arguments
+		bool variadic = false;
+	};
+
+	bool ProcessFile(const crstl::string& filename, uint32_t includeDepth);
+
+	bool ProcessDirective(const crstl::string& filename, const CrShaderTokenLine& line, uint32_t includeDepth);
+
+	bool ParseDefine(const CrShaderTokenLine& line);
+
+	bool EvaluateCondition(const crstl::string& filename, const CrShaderTokenLine& line, uint32_t firstToken, bool& result);
+
+	// Expands every macro in the tokens. Macros being expanded are disabled so that they don't recurse
+	void ExpandTokens(const crstl::vector<CrShaderToken>& tokens, crstl::vector<CrShaderToken>& expandedTokens, crstl::vector<crstl::string>& disabledMacros);
+
+	void SubstituteMacro(const CrShaderMacro& macro, const crstl::vector<crstl::vector<CrShaderToken>>& arguments, crstl::vector<CrShaderToken>& substitutedTokens, crstl::vector<crstl::string>& disabledMacros);
+
+	void FlushTokens();
+
+	void AddError(const crstl::string& filename, const char* message, const crstl::string& detail);
+
+	CrShaderSourceLookup m_sourceLookup;
+
+	crstl::open_hashmap<crstl::string, CrShaderMacro> m_macros;
+
+	// Code tokens are collected until the next directive, as macro invocations can span several lines
+	crstl::vector<CrShaderToken> m_pendingTokens;
+
+	crstl::vector<crstl::string> m_includedFiles;
+
+	crstl::vector<crstl::string> m_pragmaOnceFiles;
+
+	crstl::string m_output;
+
+	crstl::string m_errors;
+};
@@ -32,18 +32,10 @@ CrShaderSources::CrShaderSources()
 
 	crstl::create_directories(m_ubershaderTempDirectory.c_str());
 
-	// Files that contribute to ubershader building
-	// Perhaps more flexible in a text file
-	static const crstl::open_hashset<crstl::string> UbershaderFiles =
-	{
-		"BSDF.hlsl",
-		"Common.hlsl",
-		"Surface.hlsl",
-		UbershaderEntryFile,
-	};
-
 	const crstl::string& ShaderSourceDirectory = CrGlobalPaths::GetShaderSourceDirectory();
 
+	m_shaderSourceDirectory = ShaderSourceDirectory.c_str();
+
 	// Load all the files in this directory and put them in a hashmap based on filename
 	crstl::for_each_directory_entry(ShaderSourceDirectory.c_str(), false, [this](const crstl::directory_entry& entry)
 	{
@@ -52,148 +44,179 @@ CrShaderSources::CrShaderSources()
 			CrFixedPath shaderPath = entry.directory;
 			shaderPath /= entry.filename;
 
-			if (crstl::file shaderSourceFile = crstl::file(shaderPath.c_str(), crstl::file_flags::read))
-			{
-				crstl::string shaderSource(crstl::ctor_no_initialize, shaderSourceFile.get_size(), shaderSourceFile.get_size());
-				shaderSourceFile.read(shaderSource.data(), shaderSource.size());
-
-				// Preprocess the shader source to remove anything that cannot
-				// add anything meaningful to the final binary, such as whitespace, 
-				// tabs, lines, and comments
-
-				// Reserve an initial number of lines
-				crstl::vector<crstl::string> lines;
-				lines.reserve(200);
-
-				shaderSource.split('\n', [&lines](const crstl::string_view& view)
-				{
-					lines.push_back(crstl::string(view));
-				});
-
-				// TODO Add a competent preprocessor here, instead of manually parsing
-				crstl::vector<crstl::string> preprocessedLines;
-				for (crstl::string& line : lines)
-				{
-					if (!line.empty())
-					{
-						line.erase_all(' ');
-						line.erase_all('\t');
-						line.erase_all('\r');
-						line.erase_all('\n');
-
-						// Check empty again after we've removed everything
-						if (!line.empty())
-						{
-							char firstChar = line[0];
-							if (firstChar != '/')
-							{
-								preprocessedLines.push_back(line);
-							}
-						}
-					}
-				}
-
-				// This source is in a good format for hashing, as any spurious spaces,
-				// tabs, formatting of any sort won't affect the hash and therefore not
-				// trigger any extra compilations
-				// Only consider ubershader files for the ubershader hash
-				if (UbershaderFiles.find(entry.filename) != UbershaderFiles.end())
-				{
-					for (const crstl::string& line : preprocessedLines)
-					{
-						m_hashableUbershaderSource += line;
-					}
-				}
-
-				crstl::string filenameString = entry.filename;
-
-				m_shaderPaths.insert(filenameString, shaderPath);
-				m_shaderSources.insert(filenameString, shaderSource);
-			}
+			LoadShaderSource(crstl::string(entry.filename), shaderPath);
 		}
 
 		return true;
 	});
 
-	m_ubershaderHash = CrHash(m_hashableUbershaderSource.c_str(), m_hashableUbershaderSource.length());
+	ResolveUbershader();
+
+	// Start watching after loading so that we only hear about changes made from now on
+	if (!m_fileWatcher.Watch(ShaderSourceDirectory.c_str()))
+	{
+		CrLog("Could not watch shader source directory %s. Shaders will not be reloaded when their sources change", ShaderSourceDirectory.c_str());
+	}
+}
+
+bool CrShaderSources::LoadShaderSource(const crstl::string& filename, const CrFixedPath& shaderPath)
+{
+	if (crstl::file shaderSourceFile = crstl::file(shaderPath.c_str(), crstl::file_flags::read))
+	{
+		crstl::string shaderSource(crstl::ctor_no_initialize, shaderSourceFile.get_size(), shaderSourceFile.get_size());
+		shaderSourceFile.read(shaderSource.data(), shaderSource.size());
+
+		// Hash the tokens rather than the text, so that formatting and comments don't trigger any extra compilations
+		crstl::vector<crstl::string> includes;
+		CrHash shaderHash = CrShaderPreprocessor::HashSource(shaderSource, includes);
+
+		// Replace any previous version of the file
+		RemoveShaderSource(filename);
 
-	CrLog("Ubershader - Computed Hash: %ull", m_ubershaderHash.GetHash());
+		m_shaderPaths.insert(filename, shaderPath);
+		m_shaderSources.insert(filename, shaderSource);
+		m_shaderHashes.insert(filename, shaderHash);
+		m_shaderIncludes.insert(filename, includes);
+
+		return true;
+	}
+
+	return false;
+}
+
+void CrShaderSources::RemoveShaderSource(const crstl::string& filename)
+{
+	m_shaderPaths.erase(filename);
+	m_shaderSources.erase(filename);
+	m_shaderHashes.erase(filename);
+	m_shaderIncludes.erase(filename);
+}
+
+void CrShaderSources::ResolveUbershader()
+{
+	m_ubershaderDependencies.clear();
+	m_ubershaderHash.Reset();
+	m_resolvedUbershaderSource.clear();
+
+	// The ubershader hash is the combination of every file it depends on. Only these files can invalidate
+	// shaders built from the ubershader
+	GetShaderSourceDependencies(UbershaderEntryFile, m_ubershaderDependencies);
+
+	for (const CrShaderSourceDependency& dependency : m_ubershaderDependencies)
+	{
+		m_ubershaderHash << dependency.hash;
+	}
+
+	CrLog("Ubershader - Computed Hash: %llu (%llu dependencies)", m_ubershaderHash.GetHash(), (uint64_t)m_ubershaderDependencies.size());
 
 	// Resolve ubershader includes upfront. The only thing that really changes an ubershader
 	// is defines that we can either pass in from the compiler or inject at the top of the file
-	// TODO: Replace with a preprocessor
+	if (!CrShaderPreprocessor::ResolveIncludes(UbershaderEntryFile, GetSourceLookup(), m_resolvedUbershaderSource))
 	{
-		bool success = true;
+		CrLog("Could not resolve ubershader includes");
+	}
+}
 
-		// Prime the ubershader source with the entry file
-		const auto ubershaderEntryIterator = m_shaderSources.find(UbershaderEntryFile);
+CrShaderSourceLookup CrShaderSources::GetSourceLookup() const
+{
+	return [this](const crstl::string& filename) -> const crstl::string*
+	{
+		const auto sourceIterator = m_shaderSources.find(filename);
+		return sourceIterator != m_shaderSources.end() ? &sourceIterator->second : nullptr;
+	};
+}
 
-		if (ubershaderEntryIterator != m_shaderSources.end())
-		{
-			m_resolvedUbershaderSource = ubershaderEntryIterator->second;
+CrHash CrShaderSources::ComputePreprocessedHash(const crstl::string& filename, const crstl::vector<crstl::string>& defines, CrShaderSourceDependencies& dependencies) const
+{
+	CrShaderPreprocessor preprocessor(GetSourceLookup());
 
-			// For every include declaration, substitute with the actual source
-			size_t includePosition = m_resolvedUbershaderSource.find("#include");
+	for (const crstl::string& define : defines)
+	{
+		preprocessor.AddDefine(define);
+	}
 
-			while (includePosition != m_resolvedUbershaderSource.npos)
-			{
-				// Find the end of the line
-				size_t endLine = m_resolvedUbershaderSource.find('\n', includePosition);
-
-				// If there is no end line, we could be at the end of the file. Always
-				// assume there is an endLine
-				if (endLine == m_resolvedUbershaderSource.npos)
-				{
-					endLine = m_resolvedUbershaderSource.length();
-				}
-
-				bool includeSuccess = false;
-
-				// The include declaration may be malformed so be a little defensive about it
-				// We need to get the shader inside the quotes, look it up in the source cache,
-				// and replace the include declaration with the block of code behind it. Includes
-				// may be repeated, which is fine
-				size_t startQuote = m_resolvedUbershaderSource.find('"', includePosition);
-
-				if (startQuote != m_resolvedUbershaderSource.npos)
-				{
-					size_t endQuote = m_resolvedUbershaderSource.find('"', startQuote + 1);
-
-					if (endQuote != m_resolvedUbershaderSource.npos)
-					{
-						// Get the filename of the include
-						const crstl::string includeFilename = m_resolvedUbershaderSource.substr(startQuote + 1, endQuote - startQuote - 1);
-
-						const auto& includeFilenameIter = m_shaderSources.find(includeFilename);
-
-						// If the include filename is in the cache, we may proceed to inject it
-						if (includeFilenameIter != m_shaderSources.end())
-						{
-							const crstl::string& includedSourceFile = m_shaderSources.find(includeFilename)->second;
-							m_resolvedUbershaderSource.replace(includePosition, endLine - includePosition, includedSourceFile);
-							includeSuccess = true;
-						}
-						else
-						{
-							CrLog("Include file %s not found", includeFilename.c_str());
-						}
-					}
-				}
-
-				success &= includeSuccess;
-				includePosition = m_resolvedUbershaderSource.find("#include", includePosition + 1);
-			}
+	// Errors are reported by the compiler itself, there is no need to stop here
+	if (!preprocessor.Preprocess(filename))
+	{
+		CrLog("Preprocessing %s failed:\n%s", filename.c_str(), preprocessor.GetErrors().c_str());
+	}
+
+	for (const crstl::string& includedFile : preprocessor.GetIncludedFiles())
+	{
+		CrShaderSourceDependency dependency;
+		dependency.filename = includedFile;
+		dependency.hash = GetShaderSourceHash(includedFile);
+		dependencies.push_back(dependency);
+	}
 
-			if (!success)
+	return preprocessor.GetHash();
+}
+
+CrHash CrShaderSources::ComputeUbershaderPreprocessedHash(const crstl::vector<crstl::string>& defines, CrShaderSourceDependencies& dependencies) const
+{
+	return ComputePreprocessedHash(UbershaderEntryFile, defines, dependencies);
+}
+
+void CrShaderSources::Update(crstl::vector<crstl::string>& modifiedSources)
+{
+	crstl::vector<crstl::string> changedFiles;
+	m_fileWatcher.GetChangedFiles(changedFiles);
+
+	for (const crstl::string& filename : changedFiles)
+	{
+		CrHash previousHash = GetShaderSourceHash(filename);
+		bool existed = m_shaderHashes.find(filename) != m_shaderHashes.end();
+
+		CrFixedPath shaderPath = m_shaderSourceDirectory;
+		shaderPath /= filename.c_str();
+
+		if (LoadShaderSource(filename, shaderPath))
+		{
+			// Saving a file without changing anything meaningful (e.g. comments) doesn't need recompilation
+			if (!existed || GetShaderSourceHash(filename) != previousHash)
 			{
-				CrLog("Error parsing include declaration. Could not resolve ubershader include");
+				modifiedSources.push_back(filename);
 			}
 		}
-		else
+		else if (existed)
 		{
-			CrLog("Ubershader entry file not found in sources");
+			// Files that are deleted or renamed away invalidate anything that includes them
+			RemoveShaderSource(filename);
+			modifiedSources.push_back(filename);
 		}
 	}
+
+	if (!modifiedSources.empty())
+	{
+		for (const crstl::string& filename : modifiedSources)
+		{
+			CrLog("Shader source %s changed", filename.c_str());
+		}
+
+		if (DependsOnAny(UbershaderEntryFile, modifiedSources))
+		{
+			ResolveUbershader();
+		}
+	}
+}
+
+bool CrShaderSources::DependsOnAny(const crstl::string& filename, const crstl::vector<crstl::string>& modifiedSources) const
+{
+	CrShaderSourceDependencies dependencies;
+	GetShaderSourceDependencies(filename, dependencies);
+
+	for (const CrShaderSourceDependency& dependency : dependencies)
+	{
+		for (const crstl::string& modifiedSource : modifiedSources)
+		{
+			if (dependency.filename == modifiedSource)
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
 }
 
 const crstl::string& CrShaderSources::GetUbershaderSource() const
@@ -201,6 +224,11 @@ const crstl::string& CrShaderSources::GetUbershaderSource() const
 	return m_resolvedUbershaderSource;
 }
 
+CrFixedPath CrShaderSources::GetUbershaderPath() const
+{
+	return GetShaderSourcePath(UbershaderEntryFile);
+}
+
 const CrFixedPath& CrShaderSources::GetUbershaderTempDirectory() const
 {
 	return m_ubershaderTempDirectory;
@@ -209,4 +237,80 @@ const CrFixedPath& CrShaderSources::GetUbershaderTempDirectory() const
 const CrHash CrShaderSources::GetUbershaderHash() const
 {
 	return m_ubershaderHash;
+}
+
+const CrShaderSourceDependencies& CrShaderSources::GetUbershaderDependencies() const
+{
+	return m_ubershaderDependencies;
+}
+
+CrHash CrShaderSources::GetShaderSourceHash(const crstl::string& filename) const
+{
+	const auto hashIterator = m_shaderHashes.find(filename);
+
+	if (hashIterator != m_shaderHashes.end())
+	{
+		return hashIterator->second;
+	}
+	else
+	{
+		return CrHash();
+	}
+}
+
+void CrShaderSources::GetShaderSourceDependencies(const crstl::string& filename, CrShaderSourceDependencies& dependencies) const
+{
+	// Includes may be repeated across files, only add each one once
+	for (const CrShaderSourceDependency& dependency : dependencies)
+	{
+		if (dependency.filename == filename)
+		{
+			return;
+		}
+	}
+
+	CrShaderSourceDependency dependency;
+	dependency.filename = filename;
+	dependency.hash = GetShaderSourceHash(filename);
+	dependencies.push_back(dependency);
+
+	const auto includesIterator = m_shaderIncludes.find(filename);
+
+	if (includesIterator != m_shaderIncludes.end())
+	{
+		for (const crstl::string& includeFilename : includesIterator->second)
+		{
+			GetShaderSourceDependencies(includeFilename, dependencies);
+		}
+	}
+}
+
+bool CrShaderSources::AreDependenciesValid(const CrShaderSourceDependencies& dependencies) const
+{
+	for (const CrShaderSourceDependency& dependency : dependencies)
+	{
+		const auto hashIterator = m_shaderHashes.find(dependency.filename);
+
+		// A file that has been deleted invalidates the dependency too
+		if (hashIterator == m_shaderHashes.end() || hashIterator->second != dependency.hash)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+CrFixedPath CrShaderSources::GetShaderSourcePath(const crstl::string& filename) const
+{
+	const auto pathIterator = m_shaderPaths.find(filename);
+
+	if (pathIterator != m_shaderPaths.end())
+	{
+		return pathIterator->second;
+	}
+	else
+	{
+		return CrFixedPath();
+	}
 }
\ No newline at end of file
@@ -1,10 +1,25 @@
 #pragma once
 
 #include "Core/FileSystem/CrFixedPath.h"
+#include "Core/FileSystem/CrFileWatcher.h"
 #include "Core/CrHash.h"
 
+#include "Graphics/CrShaderPreprocessor.h"
+
 #include "crstl/open_hashmap.h"
 #include "crstl/string.h"
+#include "crstl/vector.h"
+
+// A source file a compiled shader was built from, and the hash of its contents
+// at the time. Any cached artifact that records its dependencies can be checked
+// against the current sources to know whether it is still valid
+struct CrShaderSourceDependency
+{
+	crstl::string filename;
+	CrHash hash;
+};
+
+typedef crstl::vector<CrShaderSourceDependency> CrShaderSourceDependencies;
 
 // Stores all the sources for our shaders (on a desktop development build)
 // so that we can recompile them as necessary. Also has the ability to
@@ -12,8 +27,9 @@
 // we need to hash the incoming code easily, to determine whether a shader
 // needs to be recompiled or not.
 // 
-// TODO File watchers for fast reload. These file watchers will notify other
-// systems that their sources have changed and need recompilation
+// The source directory is watched for changes. Systems that build shaders call
+// Update once per frame to pick up modified files and find out which of their
+// shaders depend on them
 class CrShaderSources
 {
 public:
@@ -24,19 +40,67 @@ public:
 
 	const crstl::string& GetUbershaderSource() const;
 
+	CrFixedPath GetUbershaderPath() const;
+
 	const CrFixedPath& GetUbershaderTempDirectory() const;
 
 	const CrHash GetUbershaderHash() const;
 
+	const CrShaderSourceDependencies& GetUbershaderDependencies() const;
+
+	// Returns the hash of a source file or an empty hash if it doesn't exist
+	CrHash GetShaderSourceHash(const crstl::string& filename) const;
+
+	// Collects the file and every file it includes, directly or indirectly
+	void GetShaderSourceDependencies(const crstl::string& filename, CrShaderSourceDependencies& dependencies) const;
+
+	// Preprocesses the file with the given defines (NAME or NAME=VALUE) and hashes the code the compiler will see. The
+	// dependencies are the files that were actually included. Defines the compiler adds implicitly need to be passed in too
+	CrHash ComputePreprocessedHash(const crstl::string& filename, const crstl::vector<crstl::string>& defines, CrShaderSourceDependencies& dependencies) const;
+
+	CrHash ComputeUbershaderPreprocessedHash(const crstl::vector<crstl::string>& defines, CrShaderSourceDependencies& dependencies) const;
+
+	// Whether all dependencies still have the same hash as the current sources
+	bool AreDependenciesValid(const CrShaderSourceDependencies& dependencies) const;
+
+	// Returns the full path of a source file or an empty path if it doesn't exist
+	CrFixedPath GetShaderSourcePath(const crstl::string& filename) const;
+
+	// Reloads the files that changed on disk since the last update and returns the ones whose hash changed,
+	// including the ones that were deleted. Only changes that can affect a compiled shader are reported.
+	// Must not be called while other threads are reading the sources
+	void Update(crstl::vector<crstl::string>& modifiedSources);
+
+	// Whether the file or anything it includes, directly or indirectly, is one of the modified sources
+	bool DependsOnAny(const crstl::string& filename, const crstl::vector<crstl::string>& modifiedSources) const;
+
 private:
 
 	CrShaderSources();
 
+	// Loads and hashes a source file, replacing any previous version of it. Returns false if it couldn't be read
+	bool LoadShaderSource(const crstl::string& filename, const CrFixedPath& shaderPath);
+
+	void RemoveShaderSource(const crstl::string& filename);
+
+	// Computes the ubershader hash and resolves its includes from the current sources
+	void ResolveUbershader();
+
+	CrShaderSourceLookup GetSourceLookup() const;
+
+	CrFileWatcher m_fileWatcher;
+
+	CrFixedPath m_shaderSourceDirectory;
+
 	crstl::open_hashmap<crstl::string, CrFixedPath> m_shaderPaths;
 
 	crstl::open_hashmap<crstl::string, crstl::string> m_shaderSources;
 
-	crstl::open_hashmap<crstl::string, crstl::string> m_ubershaderSources;
+	// Hash of the tokens of every source, so that formatting and comments don't affect it
+	crstl::open_hashmap<crstl::string, CrHash> m_shaderHashes;
+
+	// Files directly included by every source
+	crstl::open_hashmap<crstl::string, crstl::vector<crstl::string>> m_shaderIncludes;
 
 	// Path to the temp folder for built ubershaders
 	CrFixedPath m_ubershaderTempDirectory;
@@ -44,11 +108,10 @@ private:
 	// Ubershader source with resolved includes
 	crstl::string m_resolvedUbershaderSource;
 
-	// Ubershader source stripped of text elements that cannot affect
-	// the final binary (in order to hash it)
-	crstl::string m_hashableUbershaderSource;
+	// Sources the ubershader is built from, with their current hashes
+	CrShaderSourceDependencies m_ubershaderDependencies;
 
-	// Ubershader hash computed with current sources (used to determine whether shaders in cache are usable)
+	// Ubershader hash computed with current sources
 	CrHash m_ubershaderHash;
 };
 
@@ -0,0 +1,42 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "Graphics/CrStreamedTexture.h"
+#include "Graphics/ITexture.h"
+
+#include "Math/CrMath.h"
+
+CrStreamedTexture::CrStreamedTexture(const crgfx::TextureHandle& texture, uint32_t width, uint32_t height, uint32_t mipmapCount, uint32_t residentMipmap)
+	: m_texture(texture)
+	, m_width(width)
+	, m_height(height)
+	, m_mipmapCount(mipmapCount)
+	, m_residentMipmap(residentMipmap)
+	, m_requestedResolution(0.0f)
+	, m_lastRequestedFrame(0)
+{
+
+}
+
+CrStreamedTexture::~CrStreamedTexture()
+{
+
+}
+
+void CrStreamedTexture::SetTexture(const crgfx::TextureHandle& texture, uint32_t residentMipmap)
+{
+	m_texture = texture;
+	m_residentMipmap = residentMipmap;
+}
+
+void CrStreamedTexture::RequestResolution(float resolution, uint64_t frameIndex)
+{
+	if (m_lastRequestedFrame != frameIndex)
+	{
+		m_requestedResolution = resolution;
+		m_lastRequestedFrame = frameIndex;
+	}
+	else
+	{
+		m_requestedResolution = CrMax(m_requestedResolution, resolution);
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Graphics/CrGraphicsForwardDeclarations.h"
+
+#include "crstl/intrusive_ptr.h"
+
+// Texture that only has some of its mips in memory. The texture streamer replaces the texture with one that has
+// more or fewer of the top mips as they are needed, and materials reference this instead of the texture so they
+// always bind the current one. The render world tells it how much detail it needs every frame it's visible
+class CrStreamedTexture final : public crstl::intrusive_ptr_interface_delete
+{
+public:
+
+	CrStreamedTexture(const crgfx::TextureHandle& texture, uint32_t width, uint32_t height, uint32_t mipmapCount, uint32_t residentMipmap);
+
+	~CrStreamedTexture();
+
+	const crgfx::TextureHandle& GetTexture() const { return m_texture; }
+
+	// The texture starts at residentMipmap, i.e. its top mip is that mip of the full texture
+	void SetTexture(const crgfx::TextureHandle& texture, uint32_t residentMipmap);
+
+	// Dimensions of the full texture, not the resident part
+	uint32_t GetWidth() const { return m_width; }
+
+	uint32_t GetHeight() const { return m_height; }
+
+	uint32_t GetMipmapCount() const { return m_mipmapCount; }
+
+	uint32_t GetResidentMipmap() const { return m_residentMipmap; }
+
+	// Resolution is the number of pixels on screen a unit of texture coordinates covers, i.e. how large the top mip
+	// would need to be to have a texel per pixel. The largest one requested during the frame is kept
+	void RequestResolution(float resolution, uint64_t frameIndex);
+
+	float GetRequestedResolution() const { return m_requestedResolution; }
+
+	uint64_t GetLastRequestedFrame() const { return m_lastRequestedFrame; }
+
+private:
+
+	crgfx::TextureHandle m_texture;
+
+	uint32_t m_width;
+
+	uint32_t m_height;
+
+	uint32_t m_mipmapCount;
+
+	uint32_t m_residentMipmap;
+
+	float m_requestedResolution;
+
+	uint64_t m_lastRequestedFrame;
+};
@@ -704,6 +704,25 @@ namespace crgfx
 		m_openBufferUploads.erase(bufferUploadIter);
 	}
 
+	void DeviceD3D12::CopyBufferUploadsPS(const BufferUpload* bufferUploads, uint32_t count)
+	{
+		CommandBufferD3D12* d3d12CommandBuffer = static_cast<CommandBufferD3D12*>(GetAuxiliaryCommandBuffer().get());
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const BufferUpload& bufferUpload = bufferUploads[i];
+			const CrHardwareGPUBufferD3D12* d3d12DestinationBuffer = static_cast<const CrHardwareGPUBufferD3D12*>(bufferUpload.destinationBuffer);
+			const CrHardwareGPUBufferD3D12* d3d12StagingBuffer = static_cast<const CrHardwareGPUBufferD3D12*>(bufferUpload.stagingBuffer.get());
+
+			d3d12CommandBuffer->GetD3D12CommandList()->CopyBufferRegion
+			(
+				d3d12DestinationBuffer->GetD3D12Resource(), bufferUpload.destinationOffsetBytes,
+				d3d12StagingBuffer->GetD3D12Resource(), bufferUpload.sourceOffsetBytes,
+				bufferUpload.sizeBytes
+			);
+		}
+	}
+
 	HardwareGPUBufferHandle DeviceD3D12::DownloadBufferPS(const IHardwareGPUBuffer* sourceBuffer)
 	{
 		const CrHardwareGPUBufferD3D12* d3d12SourceBuffer = static_cast<const CrHardwareGPUBufferD3D12*>(sourceBuffer);
@@ -330,35 +330,35 @@ namespace crgfx
 		CreateDataFormatInfo(crgfx::DataFormat::RG11B10_Float,     4, 1, 1, 11, 11, 10, 0, 3, false, true, "rg11b10f"),
 		CreateDataFormatInfo(crgfx::DataFormat::RGB9E5_Float,      4, 1, 1,  9,  9,  9, 0, 3, false, true, "rgb9e5"),
 
-		// TODO the compressed formats need reviewing
-		CreateDataFormatInfo(crgfx::DataFormat::BC1_RGB_Unorm,     1, 4, 4,  8,  8,  8, 0, 3, true, false, "bc1"),
-		CreateDataFormatInfo(crgfx::DataFormat::BC1_RGB_SRGB,      1, 4, 4,  8,  8,  8, 0, 3, true, false, "bc1"),
-		CreateDataFormatInfo(crgfx::DataFormat::BC1_RGBA_Unorm,    1, 4, 4,  8,  8,  8, 8, 4, true, false, "bc1"),
-		CreateDataFormatInfo(crgfx::DataFormat::BC1_RGBA_SRGB,     1, 4, 4,  8,  8,  8, 8, 4, true, false, "bc1"),
+		// Block compressed formats store the size of a 4x4 block. The element sizes still need reviewing
+		CreateDataFormatInfo(crgfx::DataFormat::BC1_RGB_Unorm,     8, 4, 4,  8,  8,  8, 0, 3, true, false, "bc1"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC1_RGB_SRGB,      8, 4, 4,  8,  8,  8, 0, 3, true, false, "bc1"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC1_RGBA_Unorm,    8, 4, 4,  8,  8,  8, 8, 4, true, false, "bc1"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC1_RGBA_SRGB,     8, 4, 4,  8,  8,  8, 8, 4, true, false, "bc1"),
 
-		CreateDataFormatInfo(crgfx::DataFormat::BC2_Unorm,         2, 4, 4,  8,  8,  8, 8, 4, true, false, "bc2"),
-		CreateDataFormatInfo(crgfx::DataFormat::BC2_SRGB,          2, 4, 4,  8,  8,  8, 8, 4, true, false, "bc2"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC2_Unorm,        16, 4, 4,  8,  8,  8, 8, 4, true, false, "bc2"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC2_SRGB,         16, 4, 4,  8,  8,  8, 8, 4, true, false, "bc2"),
 
-		CreateDataFormatInfo(crgfx::DataFormat::BC3_Unorm,         2, 4, 4,  8,  8,  8, 8, 4, true, false, "bc3"),
-		CreateDataFormatInfo(crgfx::DataFormat::BC3_SRGB,          2, 4, 4,  8,  8,  8, 8, 4, true, false, "bc3"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC3_Unorm,        16, 4, 4,  8,  8,  8, 8, 4, true, false, "bc3"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC3_SRGB,         16, 4, 4,  8,  8,  8, 8, 4, true, false, "bc3"),
 
-		CreateDataFormatInfo(crgfx::DataFormat::BC4_Unorm,         1, 4, 4,  8,  8,  8, 8, 4, true, false, "bc4"),
-		CreateDataFormatInfo(crgfx::DataFormat::BC4_Snorm,         1, 4, 4,  8,  8,  8, 8, 4, true, false, "bc4"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC4_Unorm,         8, 4, 4,  8,  8,  8, 8, 4, true, false, "bc4"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC4_Snorm,         8, 4, 4,  8,  8,  8, 8, 4, true, false, "bc4"),
 
-		CreateDataFormatInfo(crgfx::DataFormat::BC5_Unorm,         2, 4, 4,  8,  8,  8, 8, 4, true, false, "bc5"),
-		CreateDataFormatInfo(crgfx::DataFormat::BC5_Snorm,         2, 4, 4,  8,  8,  8, 8, 4, true, false, "bc5"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC5_Unorm,        16, 4, 4,  8,  8,  8, 8, 4, true, false, "bc5"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC5_Snorm,        16, 4, 4,  8,  8,  8, 8, 4, true, false, "bc5"),
 
-		CreateDataFormatInfo(crgfx::DataFormat::BC6H_UFloat,       2, 4, 4,  8,  8,  8, 8, 4, true, true, "bc6h"),
-		CreateDataFormatInfo(crgfx::DataFormat::BC6H_SFloat,       2, 4, 4,  8,  8,  8, 8, 4, true, true, "bc6h"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC6H_UFloat,      16, 4, 4,  8,  8,  8, 8, 4, true, true, "bc6h"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC6H_SFloat,      16, 4, 4,  8,  8,  8, 8, 4, true, true, "bc6h"),
 
-		CreateDataFormatInfo(crgfx::DataFormat::BC7_Unorm,         2, 4, 4,  8,  8,  8, 8, 4, true, false, "bc7"),
-		CreateDataFormatInfo(crgfx::DataFormat::BC7_SRGB,          2, 4, 4,  8,  8,  8, 8, 4, true, false, "bc7"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC7_Unorm,        16, 4, 4,  8,  8,  8, 8, 4, true, false, "bc7"),
+		CreateDataFormatInfo(crgfx::DataFormat::BC7_SRGB,         16, 4, 4,  8,  8,  8, 8, 4, true, false, "bc7"),
 
-		CreateDataFormatInfo(crgfx::DataFormat::ETC2_RGB8_Unorm,   4, 4, 4,  8,  8,  8, 8, 4, true, false, "etc2"),
-		CreateDataFormatInfo(crgfx::DataFormat::ETC2_RGB8_SRGB,    4, 4, 4,  8,  8,  8, 8, 4, true, false, "etc2"),
+		CreateDataFormatInfo(crgfx::DataFormat::ETC2_RGB8_Unorm,   8, 4, 4,  8,  8,  8, 8, 4, true, false, "etc2"),
+		CreateDataFormatInfo(crgfx::DataFormat::ETC2_RGB8_SRGB,    8, 4, 4,  8,  8,  8, 8, 4, true, false, "etc2"),
 
-		CreateDataFormatInfo(crgfx::DataFormat::ETC2_RGB8A1_Unorm, 4, 4, 4,  8,  8,  8, 8, 4, true, false, "etc2"),
-		CreateDataFormatInfo(crgfx::DataFormat::ETC2_RGB8A1_SRGB,  4, 4, 4,  8,  8,  8, 8, 4, true, false, "etc2")
+		CreateDataFormatInfo(crgfx::DataFormat::ETC2_RGB8A1_Unorm, 8, 4, 4,  8,  8,  8, 8, 4, true, false, "etc2"),
+		CreateDataFormatInfo(crgfx::DataFormat::ETC2_RGB8A1_SRGB,  8, 4, 4,  8,  8,  8, 8, 4, true, false, "etc2")
 	};
 
 	//static_assert(DataFormats[crgfx::DataFormat::Last].format == crgfx::DataFormat::Last, "");
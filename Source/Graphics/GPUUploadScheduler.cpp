@@ -0,0 +1,270 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "GPUUploadScheduler.h"
+#include "IDevice.h"
+#include "GPUBuffer.h"
+
+#include "Core/CrFrameTime.h"
+#include "Core/Logging/ICrDebug.h"
+
+#include "Math/CrMath.h"
+
+#include "crstl/sort.h"
+
+namespace crgfx
+{
+	// Offsets of uploads within a staging page
+	static const uint32_t StagingPageAlignment = 16;
+
+	GPUUploadScheduler::GPUUploadScheduler(IDevice* renderDevice, uint64_t frameBudgetBytes, uint32_t stagingPageSizeBytes)
+		: m_renderDevice(renderDevice)
+		, m_frameBudgetBytes(frameBudgetBytes)
+		, m_stagingPageSizeBytes(stagingPageSizeBytes)
+	{
+
+	}
+
+	GPUUploadScheduler::~GPUUploadScheduler()
+	{
+		for (StagingPage& stagingPage : m_stagingPages)
+		{
+			if (stagingPage.stagingBuffer)
+			{
+				stagingPage.stagingBuffer->Unlock();
+			}
+		}
+	}
+
+	GPUUploadId GPUUploadScheduler::QueueUpload(const IHardwareGPUBuffer* destinationBuffer, const void* data, UploadPriority::T priority)
+	{
+		uint32_t sizeBytes = destinationBuffer->GetSizeBytes();
+		uint32_t alignedSizeBytes = (sizeBytes + StagingPageAlignment - 1) & ~(StagingPageAlignment - 1);
+
+		// Uploads larger than a page get a page of their own, and don't replace the current one
+		uint32_t pageIndex = NoPage;
+
+		if (alignedSizeBytes > m_stagingPageSizeBytes)
+		{
+			pageIndex = AllocatePage(sizeBytes);
+		}
+		else
+		{
+			if (m_currentPageIndex == NoPage || m_stagingPages[m_currentPageIndex].usedBytes + alignedSizeBytes > m_stagingPageSizeBytes)
+			{
+				uint32_t previousPageIndex = m_currentPageIndex;
+				m_currentPageIndex = AllocatePage(m_stagingPageSizeBytes);
+
+				// The previous page is full now, so it goes as soon as its uploads are done
+				if (previousPageIndex != NoPage && m_stagingPages[previousPageIndex].pendingUploadCount == 0)
+				{
+					ReleasePage(previousPageIndex);
+				}
+			}
+
+			pageIndex = m_currentPageIndex;
+		}
+
+		StagingPage& stagingPage = m_stagingPages[pageIndex];
+
+		uint32_t sourceOffsetBytes = stagingPage.usedBytes;
+		memcpy(stagingPage.data + sourceOffsetBytes, data, sizeBytes);
+
+		stagingPage.usedBytes += alignedSizeBytes;
+		stagingPage.pendingUploadCount++;
+
+		return AddUpload(destinationBuffer, stagingPage.stagingBuffer, sourceOffsetBytes, pageIndex, priority);
+	}
+
+	GPUUploadId GPUUploadScheduler::QueueUpload(const IHardwareGPUBuffer* destinationBuffer, UploadMemory& uploadMemory, UploadPriority::T priority)
+	{
+		CrAssertMsg(uploadMemory.data && uploadMemory.sizeBytes >= destinationBuffer->GetSizeBytes(), "Upload memory is too small for the buffer");
+
+		GPUUploadId uploadId = AddUpload(destinationBuffer, uploadMemory.stagingBuffer, 0, NoPage, priority);
+		uploadMemory = UploadMemory();
+		return uploadId;
+	}
+
+	bool GPUUploadScheduler::IsUploadComplete(GPUUploadId uploadId) const
+	{
+		return uploadId != 0 && uploadId < m_nextUploadId && m_queuedUploadIds.find(uploadId) == m_queuedUploadIds.end();
+	}
+
+	void GPUUploadScheduler::AddImmediateUpload(uint64_t sizeBytes)
+	{
+		BeginFrame();
+
+		m_frameBytes += sizeBytes;
+		m_statistics.immediateBytes += sizeBytes;
+	}
+
+	void GPUUploadScheduler::Schedule(bool flush, crstl::vector<BufferUpload>& bufferUploads)
+	{
+		BeginFrame();
+
+		if (m_queuedUploads.empty())
+		{
+			return;
+		}
+
+		crstl::sort(m_queuedUploads.begin(), m_queuedUploads.end());
+
+		uint64_t currentFrame = CrFrameTime::GetFrameIndex();
+		crstl::vector<QueuedUpload> remainingUploads;
+
+		// Staging buffers can be shared by several uploads, so they're counted by the last one seen. Uploads from
+		// the same page are next to each other often enough for this to be a good estimate
+		const IHardwareGPUBuffer* lastStagingBuffer = nullptr;
+
+		for (QueuedUpload& queuedUpload : m_queuedUploads)
+		{
+			// Once the budget runs out, nothing else goes this frame, so that lower priority uploads don't overtake
+			// the ones that didn't fit. The first upload of the frame goes regardless so that uploads larger than
+			// the budget aren't stuck forever
+			bool fitsInBudget = m_frameBytes + queuedUpload.sizeBytes <= m_frameBudgetBytes || m_statistics.scheduledBytes == 0;
+
+			if (!flush && (!fitsInBudget || !remainingUploads.empty()))
+			{
+				remainingUploads.push_back(queuedUpload);
+				continue;
+			}
+
+			BufferUpload bufferUpload;
+			bufferUpload.stagingBuffer = queuedUpload.stagingBuffer;
+			bufferUpload.destinationBuffer = queuedUpload.destinationBuffer.get();
+			bufferUpload.sizeBytes = queuedUpload.sizeBytes;
+			bufferUpload.sourceOffsetBytes = queuedUpload.sourceOffsetBytes;
+			bufferUpload.destinationOffsetBytes = 0;
+			bufferUploads.push_back(bufferUpload);
+
+			m_frameBytes += queuedUpload.sizeBytes;
+			m_statistics.scheduledBytes += queuedUpload.sizeBytes;
+
+			if (queuedUpload.stagingBuffer.get() != lastStagingBuffer)
+			{
+				lastStagingBuffer = queuedUpload.stagingBuffer.get();
+				m_statistics.stagingBufferCount++;
+			}
+
+			GPUUploadLatency uploadLatency;
+			uploadLatency.id = queuedUpload.id;
+			uploadLatency.sizeBytes = queuedUpload.sizeBytes;
+			uploadLatency.priority = queuedUpload.priority;
+			uploadLatency.latencyFrames = (uint32_t)(currentFrame - queuedUpload.queuedFrame);
+			uploadLatency.latencyMilliseconds = (float)queuedUpload.queuedTime.elapsed().milliseconds();
+			m_statistics.completedUploads.push_back(uploadLatency);
+
+			m_statistics.maxLatencyMilliseconds = CrMax(m_statistics.maxLatencyMilliseconds, uploadLatency.latencyMilliseconds);
+
+			m_queuedUploadIds.erase(queuedUpload.id);
+
+			if (queuedUpload.pageIndex == NoPage)
+			{
+				// Upload memory of its own. The copy holds on to it until the GPU is done
+				queuedUpload.stagingBuffer->Unlock();
+			}
+			else
+			{
+				StagingPage& stagingPage = m_stagingPages[queuedUpload.pageIndex];
+				stagingPage.pendingUploadCount--;
+
+				if (stagingPage.pendingUploadCount == 0 && queuedUpload.pageIndex != m_currentPageIndex)
+				{
+					ReleasePage(queuedUpload.pageIndex);
+				}
+			}
+		}
+
+		m_queuedUploads.swap(remainingUploads);
+
+		m_statistics.queueDepth = (uint32_t)m_queuedUploads.size();
+		m_statistics.queuedBytes = 0;
+
+		for (const QueuedUpload& queuedUpload : m_queuedUploads)
+		{
+			m_statistics.queuedBytes += queuedUpload.sizeBytes;
+		}
+	}
+
+	GPUUploadId GPUUploadScheduler::AddUpload
+	(
+		const IHardwareGPUBuffer* destinationBuffer, const HardwareGPUBufferHandle& stagingBuffer, uint32_t sourceOffsetBytes, uint32_t pageIndex, UploadPriority::T priority
+	)
+	{
+		CrAssertMsg(destinationBuffer->GetUsage() & crgfx::BufferUsage::TransferDst, "Buffer must have transfer destination usage enabled");
+
+		QueuedUpload queuedUpload;
+		queuedUpload.id = m_nextUploadId++;
+		queuedUpload.priority = priority;
+		queuedUpload.destinationBuffer = HardwareGPUBufferHandle(const_cast<IHardwareGPUBuffer*>(destinationBuffer));
+		queuedUpload.stagingBuffer = stagingBuffer;
+		queuedUpload.sourceOffsetBytes = sourceOffsetBytes;
+		queuedUpload.sizeBytes = destinationBuffer->GetSizeBytes();
+		queuedUpload.pageIndex = pageIndex;
+		queuedUpload.queuedFrame = CrFrameTime::GetFrameIndex();
+		m_queuedUploads.push_back(queuedUpload);
+
+		m_queuedUploadIds.insert(queuedUpload.id, pageIndex);
+
+		m_statistics.queueDepth = (uint32_t)m_queuedUploads.size();
+		m_statistics.queuedBytes += queuedUpload.sizeBytes;
+
+		return queuedUpload.id;
+	}
+
+	uint32_t GPUUploadScheduler::AllocatePage(uint32_t sizeBytes)
+	{
+		uint32_t pageIndex = NoPage;
+
+		for (uint32_t i = 0; i < m_stagingPages.size(); ++i)
+		{
+			if (!m_stagingPages[i].stagingBuffer)
+			{
+				pageIndex = i;
+				break;
+			}
+		}
+
+		if (pageIndex == NoPage)
+		{
+			pageIndex = (uint32_t)m_stagingPages.size();
+			m_stagingPages.push_back();
+		}
+
+		UploadMemory uploadMemory = m_renderDevice->AllocateUploadMemory(sizeBytes);
+
+		StagingPage& stagingPage = m_stagingPages[pageIndex];
+		stagingPage.stagingBuffer = uploadMemory.stagingBuffer;
+		stagingPage.data = uploadMemory.data;
+		stagingPage.sizeBytes = sizeBytes;
+		stagingPage.usedBytes = 0;
+		stagingPage.pendingUploadCount = 0;
+
+		return pageIndex;
+	}
+
+	void GPUUploadScheduler::ReleasePage(uint32_t pageIndex)
+	{
+		// Copies that were recorded from it keep it alive until the GPU is done
+		StagingPage& stagingPage = m_stagingPages[pageIndex];
+		stagingPage.stagingBuffer->Unlock();
+		stagingPage.stagingBuffer = nullptr;
+		stagingPage.data = nullptr;
+	}
+
+	void GPUUploadScheduler::BeginFrame()
+	{
+		uint64_t currentFrame = CrFrameTime::GetFrameIndex();
+
+		if (currentFrame != m_currentFrame)
+		{
+			m_currentFrame = currentFrame;
+			m_frameBytes = 0;
+
+			m_statistics.immediateBytes = 0;
+			m_statistics.scheduledBytes = 0;
+			m_statistics.stagingBufferCount = 0;
+			m_statistics.maxLatencyMilliseconds = 0.0f;
+			m_statistics.completedUploads.clear();
+		}
+	}
+}
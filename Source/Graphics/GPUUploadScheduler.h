@@ -0,0 +1,171 @@
+#pragma once
+
+#include "Graphics/CrGraphicsForwardDeclarations.h"
+
+#include "crstl/open_hashmap.h"
+#include "crstl/timer.h"
+#include "crstl/vector.h"
+
+namespace crgfx
+{
+	struct BufferUpload;
+
+	namespace UploadPriority
+	{
+		enum T : uint8_t
+		{
+			Low,
+			Normal,
+			High,
+			Count
+		};
+	};
+
+	struct GPUUploadLatency
+	{
+		GPUUploadId id;
+
+		uint32_t sizeBytes;
+
+		UploadPriority::T priority;
+
+		// Frames and time between queueing the upload and recording its copy
+		uint32_t latencyFrames;
+
+		float latencyMilliseconds;
+	};
+
+	struct GPUUploadStatistics
+	{
+		// Uploads waiting for their copy to be recorded, and their size
+		uint32_t queueDepth = 0;
+
+		uint64_t queuedBytes = 0;
+
+		// Bytes this frame from uploads that bypass the queue, i.e. the ones through Begin and End. They count
+		// against the budget too
+		uint64_t immediateBytes = 0;
+
+		// Bytes this frame from the queue, and the staging buffers they were copied from
+		uint64_t scheduledBytes = 0;
+
+		uint32_t stagingBufferCount = 0;
+
+		float maxLatencyMilliseconds = 0.0f;
+
+		// Every upload whose copy was recorded this frame
+		crstl::vector<GPUUploadLatency> completedUploads;
+	};
+
+	// Schedules buffer uploads so that large loads don't land in a single frame. Small uploads are written into shared
+	// staging pages rather than a staging buffer each, and every frame the copies of the highest priority uploads are
+	// recorded together, until the frame's byte budget runs out. The first upload of a frame always goes through so that
+	// uploads larger than the budget still make progress. Destination buffers are kept alive until their copy is
+	// recorded, and mustn't be used by the GPU before IsUploadComplete returns true
+	class GPUUploadScheduler
+	{
+	public:
+
+		GPUUploadScheduler(IDevice* renderDevice, uint64_t frameBudgetBytes, uint32_t stagingPageSizeBytes);
+
+		~GPUUploadScheduler();
+
+		// Copies the data into a staging page, so the caller can free it straight away
+		GPUUploadId QueueUpload(const IHardwareGPUBuffer* destinationBuffer, const void* data, UploadPriority::T priority);
+
+		// Takes over the upload memory, which must be at least as large as the buffer
+		GPUUploadId QueueUpload(const IHardwareGPUBuffer* destinationBuffer, UploadMemory& uploadMemory, UploadPriority::T priority);
+
+		// The copy has been recorded on the auxiliary command buffer. Work submitted later sees the data
+		bool IsUploadComplete(GPUUploadId uploadId) const;
+
+		void AddImmediateUpload(uint64_t sizeBytes);
+
+		// Picks the uploads that fit in what is left of the frame budget, or all of them when flushing, and adds
+		// their copies to bufferUploads
+		void Schedule(bool flush, crstl::vector<BufferUpload>& bufferUploads);
+
+		void SetFrameBudget(uint64_t frameBudgetBytes) { m_frameBudgetBytes = frameBudgetBytes; }
+
+		const GPUUploadStatistics& GetStatistics() const { return m_statistics; }
+
+	private:
+
+		struct StagingPage
+		{
+			HardwareGPUBufferHandle stagingBuffer;
+
+			uint8_t* data;
+
+			uint32_t sizeBytes;
+
+			uint32_t usedBytes;
+
+			// Uploads in the page whose copy hasn't been recorded. The page is released once it's full and they're done
+			uint32_t pendingUploadCount;
+		};
+
+		struct QueuedUpload
+		{
+			// Highest priority first, and oldest first within a priority
+			bool operator < (const QueuedUpload& other) const
+			{
+				return priority != other.priority ? priority > other.priority : id < other.id;
+			}
+
+			GPUUploadId id;
+
+			UploadPriority::T priority;
+
+			HardwareGPUBufferHandle destinationBuffer;
+
+			HardwareGPUBufferHandle stagingBuffer;
+
+			uint32_t sourceOffsetBytes;
+
+			uint32_t sizeBytes;
+
+			// Staging page it was written into, or NoPage if it brought its own upload memory
+			uint32_t pageIndex;
+
+			uint64_t queuedFrame;
+
+			crstl::timer queuedTime;
+		};
+
+		static const uint32_t NoPage = 0xffffffff;
+
+		GPUUploadId AddUpload(const IHardwareGPUBuffer* destinationBuffer, const HardwareGPUBufferHandle& stagingBuffer, uint32_t sourceOffsetBytes, uint32_t pageIndex, UploadPriority::T priority);
+
+		uint32_t AllocatePage(uint32_t sizeBytes);
+
+		void ReleasePage(uint32_t pageIndex);
+
+		void BeginFrame();
+
+		IDevice* m_renderDevice;
+
+		uint64_t m_frameBudgetBytes;
+
+		uint32_t m_stagingPageSizeBytes;
+
+		crstl::vector<StagingPage> m_stagingPages;
+
+		// Page small uploads are written into until it's full
+		uint32_t m_currentPageIndex = NoPage;
+
+		crstl::vector<QueuedUpload> m_queuedUploads;
+
+		// Ids of the uploads in the queue, for checking completion without searching it
+		crstl::open_hashmap<GPUUploadId, uint32_t> m_queuedUploadIds;
+
+		GPUUploadId m_nextUploadId = 1;
+
+		uint64_t m_currentFrame = 0xffffffffffffffffull;
+
+		// Bytes recorded this frame, between the queue and immediate uploads
+		uint64_t m_frameBytes = 0;
+
+		GPUUploadStatistics m_statistics;
+	};
+}
@@ -13,6 +13,7 @@ namespace crgfx
 {
 	ICommandBuffer::ICommandBuffer(crgfx::IDevice* renderDevice, const crgfx::CommandBufferDescriptor& descriptor) : GPUAutoDeletable(renderDevice)
 		, m_queueType(descriptor.queueType)
+		, m_commandStream(nullptr)
 		, m_submitted(false)
 		, m_recording(false)
 	{
@@ -117,21 +118,41 @@ namespace crgfx
 
 	void ICommandBuffer::BeginTimestampQuery(const IGPUQueryPool* queryPool, CrGPUQueryId query)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BeginTimestampQuery, queryPool, query);
+		}
+
 		BeginTimestampQueryPS(queryPool, query);
 	}
 
 	void ICommandBuffer::EndTimestampQuery(const IGPUQueryPool* queryPool, CrGPUQueryId query)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::EndTimestampQuery, queryPool, query);
+		}
+
 		EndTimestampQueryPS(queryPool, query);
 	}
 
 	void ICommandBuffer::ResetGPUQueries(const IGPUQueryPool* queryPool, uint32_t start, uint32_t count)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::ResetGPUQueries, queryPool, start, count);
+		}
+
 		ResetGPUQueriesPS(queryPool, start, count);
 	}
 
 	void ICommandBuffer::ResolveGPUQueries(const IGPUQueryPool* queryPool, uint32_t start, uint32_t count)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::ResolveGPUQueries, queryPool, start, count);
+		}
+
 		ResolveGPUQueriesPS(queryPool, start, count);
 	}
 
@@ -193,12 +214,18 @@ namespace crgfx
 	{
 		CrCommandBufferAssertMsg(!m_currentState.m_renderPassActive, "Render pass already active. Have you forgotten to close a render pass?");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BeginRenderPass, renderPassDescriptor);
+		}
+
 		m_currentState.m_currentRenderPass = renderPassDescriptor;
 		m_currentState.m_renderPassActive = true;
 
 		if (m_currentState.m_currentRenderPass.debugName.size() > 0)
 		{
-			BeginDebugEvent(m_currentState.m_currentRenderPass.debugName.c_str(), m_currentState.m_currentRenderPass.debugColor);
+			// Straight to the platform so command streams don't record it apart from the render pass
+			BeginDebugEventPS(m_currentState.m_currentRenderPass.debugName.c_str(), m_currentState.m_currentRenderPass.debugColor);
 		}
 
 #if defined(COMMAND_BUFFER_VALIDATION)
@@ -238,11 +265,16 @@ namespace crgfx
 	{
 		CrCommandBufferAssertMsg(m_currentState.m_renderPassActive, "Render pass not active. Have you forgotten to start a render pass?");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::EndRenderPass);
+		}
+
 		EndRenderPassPS();
 
 		if (m_currentState.m_currentRenderPass.debugName.size() > 0)
 		{
-			EndDebugEvent();
+			EndDebugEventPS();
 		}
 
 		m_currentState.m_renderPassActive = false;
@@ -7,6 +7,7 @@
 #include "Graphics/CrRenderingStatistics.h"
 #include "Graphics/RenderPassDescriptor.h"
 #include "Graphics/CrGPUStackAllocator.h"
+#include "Graphics/CommandStream.h"
 #include "Graphics/IGPUSynchronization.h"
 #include "Graphics/CrGraphicsForwardDeclarations.h"
 
@@ -112,6 +113,10 @@ namespace crgfx
 
 		void Submit();
 
+		// Records every call made through this interface into the stream, until it's set back to null. Calls made
+		// between Begin and End are what a replay expects to record into a command buffer that is recording
+		void SetCommandStream(CommandStream* commandStream) { m_commandStream = commandStream; }
+
 		void SetViewport(const Viewport& viewport);
 
 		void SetScissor(const Rectangle& scissor);
@@ -342,6 +347,9 @@ namespace crgfx
 
 		crstl::unique_ptr<CrGPUStackAllocator> m_indexBufferGPUStack;
 
+		// Where calls are being captured, if anywhere
+		CommandStream*               m_commandStream;
+
 		// Signal fence when execution completes
 		crgfx::GPUFenceHandle      m_completionFence;
 
@@ -355,6 +363,11 @@ namespace crgfx
 
 	inline void ICommandBuffer::SetViewport(const crgfx::Viewport& viewport)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::SetViewport, viewport);
+		}
+
 		if (m_currentState.m_viewport != viewport)
 		{
 			m_currentState.m_viewport = viewport;
@@ -364,6 +377,11 @@ namespace crgfx
 
 	inline void ICommandBuffer::SetScissor(const crgfx::Rectangle& scissor)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::SetScissor, scissor);
+		}
+
 		if (m_currentState.m_scissor != scissor)
 		{
 			m_currentState.m_scissor = scissor;
@@ -373,6 +391,11 @@ namespace crgfx
 
 	inline void ICommandBuffer::SetStencilRef(uint32_t stencilRef)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::SetStencilRef, stencilRef);
+		}
+
 		if (m_currentState.m_stencilRef != stencilRef)
 		{
 			m_currentState.m_stencilRef = stencilRef;
@@ -386,6 +409,11 @@ namespace crgfx
 		CrCommandBufferAssertMsg(indexBuffer->GetUsage() & crgfx::BufferUsage::Index, "Buffer must have index buffer flag");
 		CrCommandBufferAssertMsg(indexFormat == crgfx::DataFormat::R16_Uint || indexFormat == crgfx::DataFormat::R32_Uint, "Only these formats are allowed");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindIndexBuffer, indexBuffer, byteOffset, sizeBytes, indexFormat);
+		}
+
 		if (m_currentState.m_indexBuffer != indexBuffer ||
 			m_currentState.m_indexBufferOffset != byteOffset ||
 			m_currentState.m_indexBufferSize != sizeBytes ||
@@ -415,6 +443,11 @@ namespace crgfx
 		CrCommandBufferAssertMsg(vertexBuffer->GetUsage() & crgfx::BufferUsage::Vertex, "Buffer must have vertex buffer flag");
 		CrCommandBufferAssertMsg(stride < 2048, "Stride is too large");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindVertexBuffer, vertexBuffer, streamId, byteOffset, vertexCount, stride);
+		}
+
 		if (m_currentState.m_vertexBuffers[streamId].vertexBuffer != vertexBuffer || m_currentState.m_vertexBuffers[streamId].offset != byteOffset ||
 			m_currentState.m_vertexBuffers[streamId].vertexCount != vertexCount || m_currentState.m_vertexBuffers[streamId].stride != stride)
 		{
@@ -438,6 +471,11 @@ namespace crgfx
 
 	inline void ICommandBuffer::BindGraphicsPipelineState(const IGraphicsPipeline* graphicsPipeline)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindGraphicsPipelineState, graphicsPipeline);
+		}
+
 		if (m_currentState.m_graphicsPipeline != graphicsPipeline)
 		{
 			m_currentState.m_graphicsPipeline = graphicsPipeline;
@@ -447,6 +485,11 @@ namespace crgfx
 
 	inline void ICommandBuffer::BindComputePipelineState(const IComputePipeline* computePipeline)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindComputePipelineState, computePipeline);
+		}
+
 		if (m_currentState.m_computePipeline != computePipeline)
 		{
 			m_currentState.m_computePipeline = computePipeline;
@@ -456,6 +499,11 @@ namespace crgfx
 
 	inline void ICommandBuffer::ClearRenderTarget(const crgfx::ITexture* renderTarget, const float4& color, uint32_t mip, uint32_t slice, uint32_t mipCount, uint32_t sliceCount)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::ClearRenderTarget, renderTarget, color, mip, slice, mipCount, sliceCount);
+		}
+
 		ClearRenderTargetPS(renderTarget, color, mip, slice, mipCount, sliceCount);
 	}
 
@@ -463,6 +511,11 @@ namespace crgfx
 	{
 		CrCommandBufferAssertMsg(m_currentState.m_currentRenderPass.type == crgfx::RenderPassType::Graphics, "Render pass type must be Graphics");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::Draw, vertexCount, instanceCount, firstVertex, firstInstance);
+		}
+
 		FlushGraphicsRenderState();
 
 		DrawPS(vertexCount, instanceCount, firstVertex, firstInstance);
@@ -476,6 +529,11 @@ namespace crgfx
 	{
 		CrCommandBufferAssertMsg(m_currentState.m_currentRenderPass.type == crgfx::RenderPassType::Graphics, "Render pass type must be Graphics");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::DrawIndexed, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+		}
+
 		FlushGraphicsRenderState();
 
 		DrawIndexedPS(indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
@@ -489,6 +547,11 @@ namespace crgfx
 	{
 		CrCommandBufferAssertMsg(m_currentState.m_currentRenderPass.type == crgfx::RenderPassType::Graphics, "Render pass type must be Graphics");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::DrawIndirect, indirectBuffer, offset, count);
+		}
+
 		FlushGraphicsRenderState();
 
 		DrawIndirectPS(indirectBuffer, offset, count);
@@ -523,6 +586,11 @@ namespace crgfx
 
 	inline void ICommandBuffer::DrawIndexedIndirect(const IHardwareGPUBuffer* indirectBuffer, uint32_t offset, uint32_t count)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::DrawIndexedIndirect, indirectBuffer, offset, count);
+		}
+
 		FlushGraphicsRenderState();
 
 		DrawIndexedIndirectPS(indirectBuffer, offset, count);
@@ -535,6 +603,11 @@ namespace crgfx
 	{
 		CrCommandBufferAssertMsg(m_currentState.m_currentRenderPass.type == crgfx::RenderPassType::Compute, "Render pass type must be Compute");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::DispatchIndirect, indirectBuffer, offset);
+		}
+
 		FlushComputeRenderState();
 
 		DispatchIndirectPS(indirectBuffer, offset);
@@ -549,6 +622,11 @@ namespace crgfx
 	{
 		CrCommandBufferAssertMsg(m_currentState.m_currentRenderPass.type == crgfx::RenderPassType::Compute, "Render pass type must be Compute");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::Dispatch, threadGroupCountX, threadGroupCountY, threadGroupCountZ);
+		}
+
 		FlushComputeRenderState();
 
 		DispatchPS(threadGroupCountX, threadGroupCountY, threadGroupCountZ);
@@ -561,16 +639,31 @@ namespace crgfx
 
 	inline void ICommandBuffer::BeginDebugEvent(const char* eventName, const float4& color)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BeginDebugEvent, eventName, color);
+		}
+
 		BeginDebugEventPS(eventName, color);
 	}
 
 	inline void ICommandBuffer::EndDebugEvent()
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::EndDebugEvent);
+		}
+
 		EndDebugEventPS();
 	}
 
 	inline void ICommandBuffer::InsertDebugMarker(const char* markerName, const float4& color)
 	{
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::InsertDebugMarker, markerName, color);
+		}
+
 		InsertDebugMarkerPS(markerName, color);
 	}
 
@@ -580,6 +673,11 @@ namespace crgfx
 		CrCommandBufferAssertMsg(constantBuffer->HasUsage(crgfx::BufferUsage::Constant), "Buffer must have constant buffer flag");
 		CrCommandBufferAssertMsg(constantBufferIndex < ConstantBuffers::Count, "Invalid binding index");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindConstantBuffer, constantBufferIndex, constantBuffer, size, offset);
+		}
+
 		m_currentState.m_constantBuffers[constantBufferIndex] = ConstantBufferBinding(constantBuffer, size, offset);
 	}
 
@@ -593,6 +691,11 @@ namespace crgfx
 		CrCommandBufferAssertMsg(sampler != nullptr, "Sampler is null");
 		CrCommandBufferAssertMsg(samplerIndex < Samplers::Count, "Invalid binding index");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindSampler, samplerIndex, sampler);
+		}
+
 		m_currentState.m_samplers[samplerIndex] = sampler;
 	}
 
@@ -602,6 +705,11 @@ namespace crgfx
 		CrCommandBufferAssertMsg(textureIndex < Textures::Count, "Invalid binding index");
 		CrCommandBufferAssertMsg((view.plane == crgfx::TexturePlane::Plane0) ? true : crgfx::IsDepthStencilFormat(texture->GetFormat()), "Invalid plane specified");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindTexture, textureIndex, texture, view);
+		}
+
 		m_currentState.m_textures[textureIndex] = TextureBinding(texture, view);
 	}
 
@@ -612,6 +720,11 @@ namespace crgfx
 		CrCommandBufferAssertMsg(mip < texture->GetMipmapCount(), "Texture doesn't have enough mipmaps!");
 		CrCommandBufferAssertMsg(rwTextureIndex < RWTextures::Count, "Invalid binding index");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindRWTexture, rwTextureIndex, texture, mip);
+		}
+
 		m_currentState.m_rwTextures[rwTextureIndex] = RWTextureBinding(texture, mip);
 	}
 
@@ -622,6 +735,11 @@ namespace crgfx
 		CrCommandBufferAssertMsg(storageBufferIndex < StorageBuffers::Count, "Invalid binding index");
 		CrCommandBufferAssertMsg(numElements * stride <= buffer->GetSizeBytes(), "Bound size too large");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindStorageBuffer, storageBufferIndex, buffer, numElements, stride, offset);
+		}
+
 		m_currentState.m_storageBuffers[storageBufferIndex] = StorageBufferBinding(buffer, numElements, stride, offset);
 	}
 
@@ -643,6 +761,11 @@ namespace crgfx
 		CrCommandBufferAssertMsg(rwStorageBufferIndex < RWStorageBuffers::Count, "Invalid binding index");
 		CrCommandBufferAssertMsg(numElements * stride <= buffer->GetSizeBytes(), "Bound size too large");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindRWStorageBuffer, rwStorageBufferIndex, buffer, numElements, stride, offset);
+		}
+
 		m_currentState.m_rwStorageBuffers[rwStorageBufferIndex] = StorageBufferBinding(buffer, numElements, stride, offset);
 	}
 
@@ -661,6 +784,11 @@ namespace crgfx
 		CrCommandBufferAssertMsg(rwBufferIndex < RWTypedBuffers::Count, "Invalid binding index");
 		CrCommandBufferAssertMsg(numElements * stride <= buffer->GetSizeBytes(), "Bound size too large");
 
+		if (m_commandStream)
+		{
+			m_commandStream->Record(CommandStreamOp::BindRWTypedBuffer, rwBufferIndex, buffer, numElements, stride, offset);
+		}
+
 		m_currentState.m_rwTypedBuffers[rwBufferIndex].buffer = buffer;
 	}
 
@@ -14,7 +14,9 @@
 
 #include "Core/CrMacros.h"
 #include "Core/Logging/ICrDebug.h"
+#include "Core/Streams/CrFileStream.h"
 #include "Core/CrGlobalPaths.h"
+#include "Core/Threading/CrMutex.h"
 
 // TODO Improve this, how to best deal with the frame counter?
 // Seems like the wrong place to have it here
@@ -106,6 +108,10 @@ namespace crgfx
 		// to the active deletion lists to be waited on
 		CrDeletionList* m_currentDeletionList = nullptr;
 
+		// Handles can be released from any thread, e.g. when loading threads discard resources, so the current list is
+		// guarded. Everything else is only touched by Process and Finalize on the main thread
+		CrMutex m_currentDeletionListMutex;
+
 		// Active deletion lists have had fence signal commands scheduled on the GPU, and are waiting to receive that on the CPU. We want to
 		// push back, but then get front to query the fence
 		crstl::deque<CrDeletionList*> m_activeDeletionLists;
@@ -131,6 +137,8 @@ namespace crgfx
 		m_gpuDeletionQueue = crstl::unique_ptr<GPUDeletionQueue>(new GPUDeletionQueue());
 
 		m_gpuTransferCallbackQueue = crstl::unique_ptr<crgfx::GPUTransferCallbackQueue>(new GPUTransferCallbackQueue());
+
+		m_uploadScheduler = crstl::unique_ptr<GPUUploadScheduler>(new GPUUploadScheduler(this, descriptor.uploadBudgetBytesPerFrame, descriptor.uploadStagingPageSizeBytes));
 	}
 
 	IDevice::~IDevice()
@@ -176,6 +184,15 @@ namespace crgfx
 
 	void IDevice::ProcessQueuedCommands()
 	{
+		// Record the queued uploads that fit in the frame so that they go with this submission
+		crstl::vector<BufferUpload> bufferUploads;
+		m_uploadScheduler->Schedule(false, bufferUploads);
+
+		if (!bufferUploads.empty())
+		{
+			CopyBufferUploadsPS(bufferUploads.data(), (uint32_t)bufferUploads.size());
+		}
+
 		// If we have an auxiliary command buffer, it means we queued some commands
 		// and we need to submit the buffer now
 		if (m_auxiliaryCommandBuffer)
@@ -204,6 +221,9 @@ namespace crgfx
 		m_gpuTransferCallbackQueue->Process();
 		m_gpuTransferCallbackQueue = nullptr;
 
+		// Queued uploads are dropped. Their staging buffers go into the deletion queue
+		m_uploadScheduler = nullptr;
+
 		// Delete all resources that belong to the device. This puts them into the deletion queues
 		for (uint32_t i = 0; i < m_auxiliaryCommandBuffers.size(); ++i)
 		{
@@ -358,7 +378,7 @@ namespace crgfx
 
 	ISwapchain* IDevice::CreateSwapchain(const SwapchainDescriptor& swapchainDescriptor)
 	{
-		CrAssertMsg(swapchainDescriptor.window, "Window cannot be null");
+		CrAssertMsg(swapchainDescriptor.window || m_deviceProperties.graphicsApi == crgfx::GraphicsApi::Null, "Window cannot be null");
 		CrAssertMsg(swapchainDescriptor.format != crgfx::DataFormat::Invalid, "Must set a data format");
 
 		ISwapchain* swapchain = CreateSwapchainPS(swapchainDescriptor);
@@ -418,6 +438,15 @@ namespace crgfx
 
 	void IDevice::EndTextureUpload(const ITexture* texture)
 	{
+		// Immediate uploads take from the frame budget of queued ones
+		CrHash textureHash(&texture, sizeof(texture));
+		const auto textureUploadIter = m_openTextureUploads.find(textureHash);
+
+		if (textureUploadIter != m_openTextureUploads.end())
+		{
+			m_uploadScheduler->AddImmediateUpload(textureUploadIter->second.stagingBuffer->GetSizeBytes());
+		}
+
 		return EndTextureUploadPS(texture);
 	}
 
@@ -430,9 +459,85 @@ namespace crgfx
 
 	void IDevice::EndBufferUpload(const IHardwareGPUBuffer* destinationBuffer)
 	{
+		m_uploadScheduler->AddImmediateUpload(destinationBuffer->GetSizeBytes());
+
 		EndBufferUploadPS(destinationBuffer);
 	}
 
+	UploadMemory IDevice::AllocateUploadMemory(uint64_t sizeBytes)
+	{
+		CrAssertMsg(sizeBytes > 0 && sizeBytes <= 0xffffffff, "Invalid upload memory size");
+
+		HardwareGPUBufferDescriptor stagingBufferDescriptor(crgfx::BufferUsage::TransferSrc, crgfx::MemoryAccess::StagingUpload, (uint32_t)sizeBytes);
+		stagingBufferDescriptor.name = "Upload Memory Staging Buffer";
+
+		UploadMemory uploadMemory;
+		uploadMemory.stagingBuffer = CreateHardwareGPUBuffer(stagingBufferDescriptor);
+		uploadMemory.data = (uint8_t*)uploadMemory.stagingBuffer->Lock();
+		uploadMemory.sizeBytes = sizeBytes;
+		return uploadMemory;
+	}
+
+	void IDevice::UploadBuffer(const IHardwareGPUBuffer* destinationBuffer, UploadMemory& uploadMemory)
+	{
+		CrAssertMsg(destinationBuffer->GetUsage() & crgfx::BufferUsage::TransferDst, "Buffer must have transfer destination usage enabled");
+		CrAssertMsg(uploadMemory.data && uploadMemory.sizeBytes >= destinationBuffer->GetSizeBytes(), "Upload memory is too small for the buffer");
+
+		// Register the upload as if it had begun with this staging buffer. Ending it unlocks the staging buffer and
+		// records the copy the same way a regular upload does
+		BufferUpload bufferUpload;
+		bufferUpload.stagingBuffer = uploadMemory.stagingBuffer;
+		bufferUpload.destinationBuffer = destinationBuffer;
+		bufferUpload.sizeBytes = destinationBuffer->GetSizeBytes();
+		bufferUpload.sourceOffsetBytes = 0;
+		bufferUpload.destinationOffsetBytes = 0;
+
+		CrHash bufferHash(&destinationBuffer, sizeof(destinationBuffer));
+		m_openBufferUploads.insert(bufferHash, bufferUpload);
+
+		m_uploadScheduler->AddImmediateUpload(destinationBuffer->GetSizeBytes());
+
+		EndBufferUploadPS(destinationBuffer);
+
+		uploadMemory = UploadMemory();
+	}
+
+	GPUUploadId IDevice::QueueBufferUpload(const IHardwareGPUBuffer* destinationBuffer, const void* data, UploadPriority::T priority)
+	{
+		return m_uploadScheduler->QueueUpload(destinationBuffer, data, priority);
+	}
+
+	GPUUploadId IDevice::QueueBufferUpload(const IHardwareGPUBuffer* destinationBuffer, UploadMemory& uploadMemory, UploadPriority::T priority)
+	{
+		return m_uploadScheduler->QueueUpload(destinationBuffer, uploadMemory, priority);
+	}
+
+	bool IDevice::IsUploadComplete(GPUUploadId uploadId) const
+	{
+		return m_uploadScheduler->IsUploadComplete(uploadId);
+	}
+
+	void IDevice::FlushUploads()
+	{
+		crstl::vector<BufferUpload> bufferUploads;
+		m_uploadScheduler->Schedule(true, bufferUploads);
+
+		if (!bufferUploads.empty())
+		{
+			CopyBufferUploadsPS(bufferUploads.data(), (uint32_t)bufferUploads.size());
+		}
+	}
+
+	void IDevice::SetUploadBudget(uint64_t budgetBytesPerFrame)
+	{
+		m_uploadScheduler->SetFrameBudget(budgetBytesPerFrame);
+	}
+
+	const GPUUploadStatistics& IDevice::GetUploadStatistics() const
+	{
+		return m_uploadScheduler->GetStatistics();
+	}
+
 	void IDevice::DownloadBuffer(const IHardwareGPUBuffer* sourceBuffer, const GPUTransferCallback& callback)
 	{
 		CrAssertMsg(sourceBuffer->GetUsage() & crgfx::BufferUsage::TransferSrc, "Buffer must have transfer source usage enabled");
@@ -458,6 +563,14 @@ namespace crgfx
 		SubmitCommandBufferPS(commandBuffer, waitSemaphore, signalSemaphore, signalFence);
 	}
 
+	// Goes in front of the data the backend serializes
+	struct CrPipelineCacheHeader
+	{
+		uint32_t hashVersion;
+		uint32_t padding;
+		uint64_t dataSize;
+	};
+
 	void IDevice::StorePipelineCache(void* pipelineCacheData, size_t pipelineCacheSize)
 	{
 		if (m_isValidPipelineCache)
@@ -466,7 +579,12 @@ namespace crgfx
 
 			if (crstl::create_directories(m_pipelineCacheDirectory.c_str()))
 			{
-				crstl::file pipelineCacheFile = crstl::file(pipelineCachePath.c_str(), crstl::file_flags::write | crstl::file_flags::create);
+				CrPipelineCacheHeader pipelineCacheHeader = {};
+				pipelineCacheHeader.hashVersion = CrHash::Version;
+				pipelineCacheHeader.dataSize = pipelineCacheSize;
+
+				crstl::file pipelineCacheFile = crstl::file(pipelineCachePath.c_str(), crstl::file_flags::write | crstl::file_flags::force_create);
+				pipelineCacheFile.write(&pipelineCacheHeader, sizeof(pipelineCacheHeader));
 				pipelineCacheFile.write(pipelineCacheData, pipelineCacheSize);
 			}
 			else
@@ -476,19 +594,37 @@ namespace crgfx
 		}
 	}
 
-	void IDevice::LoadPipelineCache(crstl::vector<char>& pipelineCacheData)
+	bool IDevice::LoadPipelineCache(CrMappedFileStream& pipelineCacheFile, const uint8_t*& pipelineCacheData, uint64_t& pipelineCacheSize)
 	{
+		pipelineCacheData = nullptr;
+		pipelineCacheSize = 0;
+
 		if (m_isValidPipelineCache)
 		{
 			CrFixedPath pipelineCachePath = m_pipelineCacheDirectory + m_pipelineCacheFilename;
 
-			if (crstl::file file = crstl::file(pipelineCachePath.c_str(), crstl::file_flags::read))
+			if (pipelineCacheFile.Open(pipelineCachePath.c_str()))
 			{
-				pipelineCacheData.resize(file.get_size());
-				file.read(pipelineCacheData.data(), pipelineCacheData.size());
-				CrLog("Successfully loaded serialized pipeline cache from %s", pipelineCachePath.c_str());
+				CrReadBufferStream& pipelineCacheStream = pipelineCacheFile.GetStream();
+
+				CrPipelineCacheHeader pipelineCacheHeader = {};
+				pipelineCacheStream.Read(&pipelineCacheHeader, sizeof(pipelineCacheHeader));
+
+				// Caches stored with a different hash version are from a different build of the engine
+				if (pipelineCacheStream.IsValid() && pipelineCacheHeader.hashVersion == CrHash::Version && pipelineCacheHeader.dataSize == pipelineCacheStream.GetRemainingBytes())
+				{
+					pipelineCacheData = pipelineCacheFile.GetData() + pipelineCacheStream.GetPosition();
+					pipelineCacheSize = pipelineCacheHeader.dataSize;
+
+					CrLog("Successfully loaded serialized pipeline cache from %s", pipelineCachePath.c_str());
+					return true;
+				}
+
+				CrLog("Serialized pipeline cache %s is out of date", pipelineCachePath.c_str());
 			}
 		}
+
+		return false;
 	}
 
 	void GPUTransferCallbackQueue::Initialize(IDevice* renderDevice)
@@ -596,7 +732,7 @@ namespace crgfx
 
 	void GPUDeletionQueue::AddToQueue(GPUDeletable* deletable)
 	{
-		// TODO Add synchronization for multithreading
+		CrScopedLock lock(m_currentDeletionListMutex);
 		m_currentDeletionList->deletables.push_back(deletable);
 	}
 
@@ -648,6 +784,9 @@ namespace crgfx
 			}
 		}
 
+		// Deleting objects above can release more handles, so only lock once that's done
+		CrScopedLock lock(m_currentDeletionListMutex);
+
 		// 2. If there are any elements to delete, add the current list to the active
 		// list and submit a fence signal to the queue
 		if (!m_currentDeletionList->deletables.empty())
@@ -688,7 +827,11 @@ namespace crgfx
 		}
 
 		// Push current list to the main queue and signal it. These are the last remaining resources in flight
-		m_activeDeletionLists.push_back(m_currentDeletionList);
+		{
+			CrScopedLock lock(m_currentDeletionListMutex);
+			m_activeDeletionLists.push_back(m_currentDeletionList);
+		}
+
 		m_renderDevice->SignalFence(crgfx::CommandQueueType::Graphics, m_currentDeletionList->fence.get());
 
 		// Clear the rest of the resources that have been added to the lists, and wait for them
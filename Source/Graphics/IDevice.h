@@ -3,6 +3,7 @@
 #include "Graphics/CrGraphics.h"
 
 #include "Graphics/CrGraphicsForwardDeclarations.h"
+#include "Graphics/GPUUploadScheduler.h"
 
 #include "Core/CrHash.h"
 
@@ -93,9 +94,24 @@ namespace crgfx
 		uint32_t destinationOffsetBytes;
 	};
 
+	// Staging memory that isn't tied to a destination yet, so that it can be written before the buffer it goes to exists.
+	// It stays locked until it is uploaded
+	struct UploadMemory
+	{
+		crgfx::HardwareGPUBufferHandle stagingBuffer;
+		uint8_t* data = nullptr;
+		uint64_t sizeBytes = 0;
+	};
+
 	struct DeviceDescriptor
 	{
 		crgfx::GraphicsVendor::T preferredVendor = crgfx::GraphicsVendor::Unknown;
+
+		// Bytes of queued buffer uploads recorded per frame, see GPUUploadScheduler
+		uint64_t uploadBudgetBytesPerFrame = 32ull * 1024 * 1024;
+
+		// Size of the staging buffers small queued uploads are written into
+		uint32_t uploadStagingPageSizeBytes = 4 * 1024 * 1024;
 	};
 
 	class IDevice : public crstl::intrusive_ptr_interface_base
@@ -189,6 +205,30 @@ namespace crgfx
 
 		void EndBufferUpload(const IHardwareGPUBuffer* destinationBuffer);
 
+		// Allocates upload memory and locks it. Unlike the rest of the upload functions it can be called from any thread,
+		// so that loading threads can decode data straight into the memory the GPU copies from
+		UploadMemory AllocateUploadMemory(uint64_t sizeBytes);
+
+		// Uploads the contents of the upload memory into the buffer without copying them again. The upload memory is
+		// consumed and can't be written to afterwards
+		void UploadBuffer(const IHardwareGPUBuffer* destinationBuffer, UploadMemory& uploadMemory);
+
+		// Queued uploads are recorded when the frame budget allows it, highest priority first, rather than straight
+		// away. The buffer can't be used until the upload is complete. Don't mix them with immediate uploads to
+		// the same buffer, as the immediate one can land first
+		GPUUploadId QueueBufferUpload(const IHardwareGPUBuffer* destinationBuffer, const void* data, UploadPriority::T priority = UploadPriority::Normal);
+
+		GPUUploadId QueueBufferUpload(const IHardwareGPUBuffer* destinationBuffer, UploadMemory& uploadMemory, UploadPriority::T priority = UploadPriority::Normal);
+
+		bool IsUploadComplete(GPUUploadId uploadId) const;
+
+		// Records every queued upload regardless of the budget, for when something can't wait for them
+		void FlushUploads();
+
+		void SetUploadBudget(uint64_t budgetBytesPerFrame);
+
+		const GPUUploadStatistics& GetUploadStatistics() const;
+
 		void DownloadBuffer(const IHardwareGPUBuffer* buffer, const GPUTransferCallback& callback);
 
 		//-------------------------------
@@ -261,18 +301,26 @@ namespace crgfx
 
 		virtual void EndBufferUploadPS(const IHardwareGPUBuffer* destinationBuffer) = 0;
 
+		// Records the copies of scheduled uploads on the auxiliary command buffer. Their staging buffers have
+		// already been written to
+		virtual void CopyBufferUploadsPS(const BufferUpload* bufferUploads, uint32_t count) = 0;
+
 		virtual HardwareGPUBufferHandle DownloadBufferPS(const IHardwareGPUBuffer* sourceBuffer) = 0;
 
 		virtual void SubmitCommandBufferPS(const crgfx::ICommandBuffer* commandBuffer, const IGPUSemaphore* waitSemaphore, const IGPUSemaphore* signalSemaphore, const IGPUFence* signalFence) = 0;
 
 		void StorePipelineCache(void* pipelineCacheData, size_t pipelineCacheSize);
 
-		void LoadPipelineCache(crstl::vector<char>& pipelineCacheData);
+		// Maps the serialized pipeline cache, if there is a valid one, and points at the data the backend stored. The
+		// backend reads it in place
+		bool LoadPipelineCache(CrMappedFileStream& pipelineCacheFile, const uint8_t*& pipelineCacheData, uint64_t& pipelineCacheSize);
 
 		crstl::unique_ptr<GPUDeletionQueue> m_gpuDeletionQueue;
 
 		crstl::unique_ptr<crgfx::GPUTransferCallbackQueue> m_gpuTransferCallbackQueue;
 
+		crstl::unique_ptr<GPUUploadScheduler> m_uploadScheduler;
+
 		DeviceProperties m_deviceProperties;
 
 		// Texture uploads that have started but haven't been committed yet
@@ -14,7 +14,9 @@
 #include "D3D12/GraphicsSystemD3D12.h"
 #endif
 
-#include "Core/Streams/CrMemoryStream.h"
+#include "Null/GraphicsSystemNull.h"
+
+#include "Core/Streams/CrBufferStream.h"
 #include "Graphics/IShader.h"
 
 #include "GeneratedShaders/BuiltinShaders.h"
@@ -38,28 +40,30 @@ namespace crgfx
 
 		for (uint32_t i = 0; i < CrBuiltinShaders::Count; ++i)
 		{
-			const CrBuiltinShaderMetadata& metadata = CrBuiltinShaders::GetMetadata((CrBuiltinShaders::T)i, m_descriptor.graphicsApi);
+			const CrBuiltinShaderMetadata& metadata = CrBuiltinShaders::GetMetadata((CrBuiltinShaders::T)i, crgfx::GraphicsApi::GetShaderApi(m_descriptor.graphicsApi));
 
 			// Builtin shaders without code are not an error. Sometimes we need shader code that is specific to an API and we leave the entry blank. This only happens
 			// on multi-API platforms which is quite rare
 			if (metadata.shaderCode)
 			{
-				CrReadMemoryStream shaderBytecodeStream(metadata.shaderCode);
+				CrReadBufferStream shaderBytecodeStream(metadata.shaderCode, metadata.shaderCodeSize);
 				const ShaderBytecodeHandle& bytecode = ShaderBytecodeHandle(new ShaderBytecode());
 				shaderBytecodeStream << *bytecode.get();
+				CrAssertMsg(shaderBytecodeStream.IsValid(), "Builtin shader %s is truncated", metadata.name.c_str());
 				m_builtinShaderBytecodes[i] = bytecode;
 			}
 		}
 
 		for (uint32_t i = 0; i < CrBuiltinCompute::Count; ++i)
 		{
-			const CrBuiltinComputeMetadata& metadata = CrBuiltinCompute::GetMetadata((CrBuiltinCompute::T)i, m_descriptor.graphicsApi);
+			const CrBuiltinComputeMetadata& metadata = CrBuiltinCompute::GetMetadata((CrBuiltinCompute::T)i, crgfx::GraphicsApi::GetShaderApi(m_descriptor.graphicsApi));
 
 			if (metadata.shaderCode)
 			{
-				CrReadMemoryStream shaderBytecodeStream(metadata.shaderCode);
+				CrReadBufferStream shaderBytecodeStream(metadata.shaderCode, metadata.shaderCodeSize);
 				const ShaderBytecodeHandle& bytecode = ShaderBytecodeHandle(new ShaderBytecode());
 				shaderBytecodeStream << *bytecode.get();
+				CrAssertMsg(shaderBytecodeStream.IsValid(), "Builtin shader %s is truncated", metadata.name.c_str());
 				m_builtinComputeBytecodes[i] = bytecode;
 			}
 		}
@@ -90,6 +94,12 @@ namespace crgfx
 		}
 #endif
 
+		// The null backend has no dependencies, so it's available everywhere
+		if (graphicsSystemDescriptor.graphicsApi == crgfx::GraphicsApi::Null)
+		{
+			graphicsSystem = new GraphicsSystemNull(graphicsSystemDescriptor);
+		}
+
 		GraphicsSystem = crstl::unique_ptr<IGraphicsSystem>(graphicsSystem);
 	}
 
@@ -113,6 +123,16 @@ namespace crgfx
 		return GraphicsSystem->GetBuiltinComputeBytecode(builtinCompute);
 	}
 
+	void SetBuiltinShaderBytecode(CrBuiltinShaders::T builtinShader, const ShaderBytecodeHandle& bytecode)
+	{
+		GraphicsSystem->m_builtinShaderBytecodes[builtinShader] = bytecode;
+	}
+
+	void SetBuiltinComputeBytecode(CrBuiltinCompute::T builtinCompute, const ShaderBytecodeHandle& bytecode)
+	{
+		GraphicsSystem->m_builtinComputeBytecodes[builtinCompute] = bytecode;
+	}
+
 	crgfx::GraphicsApi::T GetGraphicsApi()
 	{
 		return GraphicsSystem->GetGraphicsApi();
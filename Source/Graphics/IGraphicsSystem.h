@@ -42,6 +42,11 @@ namespace crgfx
 
 	const ShaderBytecodeHandle& GetBuiltinComputeBytecode(CrBuiltinCompute::T builtinCompute);
 
+	// Replaces the bytecode of a builtin shader after it has been recompiled, so that pipelines created from now on use it
+	void SetBuiltinShaderBytecode(CrBuiltinShaders::T builtinShader, const ShaderBytecodeHandle& bytecode);
+
+	void SetBuiltinComputeBytecode(CrBuiltinCompute::T builtinCompute, const ShaderBytecodeHandle& bytecode);
+
 	crgfx::GraphicsApi::T GetGraphicsApi();
 
 	bool GetIsValidationEnabled();
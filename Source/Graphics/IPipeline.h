@@ -193,7 +193,7 @@ namespace crgfx
 
 		CrHash ComputeHash() const
 		{
-			return CrHash(this, sizeof(*this));
+			return CrHash(*this);
 		}
 
 		crgfx::PrimitiveTopology        primitiveTopology : 4;
@@ -432,8 +432,9 @@ namespace crgfx
 struct CrShaderBytecodeCompilationDescriptor
 {
 	CrShaderBytecodeCompilationDescriptor
-	(const CrFixedPath& path, const crstl::fixed_string128& entryPoint, crgfx::ShaderStage::T stage, crgfx::GraphicsApi::T graphicsApi, cr::Platform::T platform)
-		: path(path), entryPoint(entryPoint), stage(stage), graphicsApi(graphicsApi), platform(platform) {
+	(const CrFixedPath& path, const crstl::fixed_string128& entryPoint, crgfx::ShaderStage::T stage, crgfx::GraphicsApi::T graphicsApi, cr::Platform::T platform,
+	const crstl::string& source = crstl::string())
+		: path(path), entryPoint(entryPoint), stage(stage), graphicsApi(graphicsApi), platform(platform), source(source) {
 	}
 
 	const CrFixedPath               path;
@@ -441,6 +442,10 @@ struct CrShaderBytecodeCompilationDescriptor
 	const crgfx::ShaderStage::T     stage;
 	const crgfx::GraphicsApi::T     graphicsApi;
 	const cr::Platform::T           platform;
+
+	// Source code to compile. If empty it's read from path. The shader compiler executable gets a temporary
+	// file of its own for it, so its includes need to be resolved already
+	const crstl::string             source;
 };
 
 // Add defines to a shader compilation
@@ -155,6 +155,10 @@ namespace crgfx
 
 		crgfx::SampleCount GetSampleCount() const { return m_sampleCount; }
 
+		crgfx::TextureType GetType() const { return m_type; }
+
+		crgfx::TextureUsageFlags GetUsage() const { return m_usage; }
+
 		uint32_t GetWidth() const { return m_width; }
 
 		uint32_t GetHeight() const { return m_height; }
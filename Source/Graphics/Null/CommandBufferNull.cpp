@@ -0,0 +1,387 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "CommandBufferNull.h"
+#include "DeviceNull.h"
+#include "TextureNull.h"
+#include "GPUBufferNull.h"
+#include "GPUQueryPoolNull.h"
+#include "PipelineNull.h"
+
+#include "Graphics/IShader.h"
+
+#include "Core/CrMacros.h"
+#include "Core/Logging/ICrDebug.h"
+
+#include "Math/CrMath.h"
+
+namespace crgfx
+{
+	// Sizes of the arguments of each indirect command, as in DrawIndirectArguments and friends in ComputeCommon.hlsl
+	static const uint32_t DrawIndirectArgumentSizeBytes = 4 * sizeof(uint32_t);
+	static const uint32_t DrawIndexedIndirectArgumentSizeBytes = 5 * sizeof(uint32_t);
+	static const uint32_t DispatchIndirectArgumentSizeBytes = 3 * sizeof(uint32_t);
+
+	CommandBufferNull::CommandBufferNull(crgfx::IDevice* renderDevice, const crgfx::CommandBufferDescriptor& descriptor)
+		: ICommandBuffer(renderDevice, descriptor)
+		, m_debugEventDepth(0)
+	{
+
+	}
+
+	void CommandBufferNull::BeginPS()
+	{
+		m_debugEventDepth = 0;
+	}
+
+	void CommandBufferNull::EndPS()
+	{
+		CrCommandBufferAssertMsg(!m_currentState.m_renderPassActive, "Ending command buffer with an active render pass");
+		CrCommandBufferAssertMsg(m_debugEventDepth == 0, "Ending command buffer with %i debug events still open", m_debugEventDepth);
+	}
+
+	void CommandBufferNull::ClearRenderTargetPS(const crgfx::ITexture* renderTarget, const float4& color, uint32_t mip, uint32_t slice, uint32_t mipCount, uint32_t sliceCount)
+	{
+		unused_parameter(color);
+
+		CrCommandBufferAssertMsg(m_recording, "Command buffer is not recording");
+		CrCommandBufferAssertMsg(renderTarget->IsRenderTarget(), "Texture %s must be a render target to be cleared", renderTarget->GetDebugName());
+		CrCommandBufferAssertMsg(mip + mipCount <= renderTarget->GetMipmapCount(), "Clearing mipmaps past the end of texture %s", renderTarget->GetDebugName());
+		CrCommandBufferAssertMsg(slice + sliceCount <= renderTarget->GetSliceCount(), "Clearing slices past the end of texture %s", renderTarget->GetDebugName());
+	}
+
+	void CommandBufferNull::DrawPS(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+	{
+		unused_parameter(vertexCount);
+		unused_parameter(instanceCount);
+		unused_parameter(firstVertex);
+		unused_parameter(firstInstance);
+	}
+
+	void CommandBufferNull::DrawIndexedPS(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, uint32_t vertexOffset, uint32_t firstInstance)
+	{
+		unused_parameter(instanceCount);
+		unused_parameter(vertexOffset);
+		unused_parameter(firstInstance);
+
+		CrCommandBufferAssertMsg(m_currentState.m_indexBuffer != nullptr, "No index buffer bound");
+
+		uint32_t indexSizeBytes = crgfx::DataFormats[m_currentState.m_indexBufferFormat].dataOrBlockSize;
+		CrCommandBufferAssertMsg((uint64_t)(firstIndex + indexCount) * indexSizeBytes <= m_currentState.m_indexBufferSize, "Drawing indices past the end of the index buffer");
+	}
+
+	void CommandBufferNull::DispatchPS(uint32_t threadGroupCountX, uint32_t threadGroupCountY, uint32_t threadGroupCountZ)
+	{
+		unused_parameter(threadGroupCountX);
+		unused_parameter(threadGroupCountY);
+		unused_parameter(threadGroupCountZ);
+	}
+
+	void CommandBufferNull::DrawIndirectPS(const IHardwareGPUBuffer* indirectBuffer, uint32_t offset, uint32_t count)
+	{
+		ValidateIndirectBuffer(indirectBuffer, offset, DrawIndirectArgumentSizeBytes, count);
+	}
+
+	void CommandBufferNull::DrawIndexedIndirectPS(const IHardwareGPUBuffer* indirectBuffer, uint32_t offset, uint32_t count)
+	{
+		CrCommandBufferAssertMsg(m_currentState.m_indexBuffer != nullptr, "No index buffer bound");
+
+		ValidateIndirectBuffer(indirectBuffer, offset, DrawIndexedIndirectArgumentSizeBytes, count);
+	}
+
+	void CommandBufferNull::DispatchIndirectPS(const IHardwareGPUBuffer* indirectBuffer, uint32_t offset)
+	{
+		ValidateIndirectBuffer(indirectBuffer, offset, DispatchIndirectArgumentSizeBytes, 1);
+	}
+
+	void CommandBufferNull::BeginDebugEventPS(const char* eventName, const float4& color)
+	{
+		unused_parameter(eventName);
+		unused_parameter(color);
+
+		m_debugEventDepth++;
+	}
+
+	void CommandBufferNull::EndDebugEventPS()
+	{
+		CrCommandBufferAssertMsg(m_debugEventDepth > 0, "Ending debug event that was never begun");
+
+		m_debugEventDepth--;
+	}
+
+	void CommandBufferNull::InsertDebugMarkerPS(const char* markerName, const float4& color)
+	{
+		unused_parameter(markerName);
+		unused_parameter(color);
+	}
+
+	void CommandBufferNull::BeginTimestampQueryPS(const IGPUQueryPool* queryPool, CrGPUQueryId query)
+	{
+		const CrGPUQueryPoolNull* nullQueryPool = static_cast<const CrGPUQueryPoolNull*>(queryPool);
+		nullQueryPool->WriteQuery(query.id, static_cast<const DeviceNull*>(m_renderDevice)->GetTimestampNanoseconds());
+	}
+
+	void CommandBufferNull::EndTimestampQueryPS(const IGPUQueryPool* queryPool, CrGPUQueryId query)
+	{
+		const CrGPUQueryPoolNull* nullQueryPool = static_cast<const CrGPUQueryPoolNull*>(queryPool);
+		nullQueryPool->WriteQuery(query.id, static_cast<const DeviceNull*>(m_renderDevice)->GetTimestampNanoseconds());
+	}
+
+	void CommandBufferNull::ResetGPUQueriesPS(const IGPUQueryPool* queryPool, uint32_t start, uint32_t count)
+	{
+		static_cast<const CrGPUQueryPoolNull*>(queryPool)->ResetQueries(start, count);
+	}
+
+	void CommandBufferNull::ResolveGPUQueriesPS(const IGPUQueryPool* queryPool, uint32_t start, uint32_t count)
+	{
+		// Results are written where they're read from, so there is nothing to resolve
+		CrCommandBufferAssertMsg(start + count <= queryPool->GetTotalQueryCount(), "Resolving queries past the end of the pool");
+	}
+
+	void CommandBufferNull::FlushGraphicsRenderStatePS()
+	{
+		CrCommandBufferAssertMsg(m_recording, "Command buffer is not recording");
+		CrCommandBufferAssertMsg(m_currentState.m_renderPassActive, "Drawing outside of a render pass");
+		CrCommandBufferAssertMsg(m_currentState.m_graphicsPipeline != nullptr, "No graphics pipeline bound");
+
+		const GraphicsPipelineNull* nullGraphicsPipeline = static_cast<const GraphicsPipelineNull*>(m_currentState.m_graphicsPipeline);
+
+		for (uint32_t streamId = 0; streamId < nullGraphicsPipeline->GetVertexStreamCount(); ++streamId)
+		{
+			CrCommandBufferAssertMsg(m_currentState.m_vertexBuffers[streamId].vertexBuffer != nullptr, "Pipeline reads vertex stream %i but no vertex buffer is bound", streamId);
+		}
+
+		ValidateShaderBindings(nullGraphicsPipeline->GetShader()->GetBindingLayout());
+
+		// Render targets must have the formats the pipeline was created with
+		const crgfx::RenderTargetFormatDescriptor& renderTargetFormats = nullGraphicsPipeline->GetRenderTargetFormats();
+		const crgfx::RenderPassDescriptor& renderPass = m_currentState.m_currentRenderPass;
+
+		for (uint32_t i = 0; i < renderPass.color.size(); ++i)
+		{
+			crgfx::DataFormat::T pipelineFormat = renderTargetFormats.colorFormats[i];
+
+			if (pipelineFormat != crgfx::DataFormat::Invalid)
+			{
+				CrCommandBufferAssertMsg(renderPass.color[i].texture->GetFormat() == pipelineFormat, "Render target %i format doesn't match pipeline format", i);
+			}
+		}
+
+		if (renderTargetFormats.depthFormat != crgfx::DataFormat::Invalid)
+		{
+			CrCommandBufferAssertMsg(renderPass.depth.texture != nullptr, "Pipeline uses depth but the render pass has no depth target");
+
+			if (renderPass.depth.texture)
+			{
+				CrCommandBufferAssertMsg(renderPass.depth.texture->GetFormat() == renderTargetFormats.depthFormat, "Depth target format doesn't match pipeline format");
+			}
+		}
+	}
+
+	void CommandBufferNull::FlushComputeRenderStatePS()
+	{
+		CrCommandBufferAssertMsg(m_recording, "Command buffer is not recording");
+		CrCommandBufferAssertMsg(m_currentState.m_computePipeline != nullptr, "No compute pipeline bound");
+
+		ValidateShaderBindings(m_currentState.m_computePipeline->GetShader()->GetBindingLayout());
+	}
+
+	void CommandBufferNull::BeginRenderPassPS(const crgfx::RenderPassDescriptor& renderPassDescriptor)
+	{
+		CrCommandBufferAssertMsg(m_recording, "Command buffer is not recording");
+
+		ProcessBufferTransitions(renderPassDescriptor.beginBuffers);
+
+		ProcessTextureTransitions(renderPassDescriptor.beginTextures);
+
+		if (renderPassDescriptor.type == crgfx::RenderPassType::Graphics)
+		{
+			for (uint32_t i = 0; i < renderPassDescriptor.color.size(); ++i)
+			{
+				const RenderTargetDescriptor& renderTargetDescriptor = renderPassDescriptor.color[i];
+				const crgfx::ITexture* texture = renderTargetDescriptor.texture;
+
+				CrCommandBufferAssertMsg(texture->IsRenderTarget(), "Texture %s must be a render target", texture->GetDebugName());
+				CrCommandBufferAssertMsg(renderTargetDescriptor.mipmap < texture->GetMipmapCount(), "Render target mipmap out of bounds");
+				CrCommandBufferAssertMsg(renderTargetDescriptor.slice < texture->GetSliceCount(), "Render target slice out of bounds");
+
+				TransitionTexture(texture, renderTargetDescriptor.mipmap, 1, renderTargetDescriptor.slice, 1, crgfx::TexturePlane::Plane0,
+					renderTargetDescriptor.initialState, renderTargetDescriptor.usageState);
+			}
+
+			const RenderTargetDescriptor& depthDescriptor = renderPassDescriptor.depth;
+
+			if (depthDescriptor.texture)
+			{
+				CrCommandBufferAssertMsg(depthDescriptor.texture->IsDepthStencil(), "Texture %s must be a depth stencil", depthDescriptor.texture->GetDebugName());
+				CrCommandBufferAssertMsg(depthDescriptor.mipmap < depthDescriptor.texture->GetMipmapCount(), "Depth target mipmap out of bounds");
+				CrCommandBufferAssertMsg(depthDescriptor.slice < depthDescriptor.texture->GetSliceCount(), "Depth target slice out of bounds");
+
+				TransitionTexture(depthDescriptor.texture, depthDescriptor.mipmap, 1, depthDescriptor.slice, 1, crgfx::TexturePlane::Plane0,
+					depthDescriptor.initialState, depthDescriptor.usageState);
+			}
+		}
+	}
+
+	void CommandBufferNull::EndRenderPassPS()
+	{
+		const crgfx::RenderPassDescriptor& renderPassDescriptor = m_currentState.m_currentRenderPass;
+
+		if (renderPassDescriptor.type == crgfx::RenderPassType::Graphics)
+		{
+			for (uint32_t i = 0; i < renderPassDescriptor.color.size(); ++i)
+			{
+				const RenderTargetDescriptor& renderTargetDescriptor = renderPassDescriptor.color[i];
+
+				TransitionTexture(renderTargetDescriptor.texture, renderTargetDescriptor.mipmap, 1, renderTargetDescriptor.slice, 1, crgfx::TexturePlane::Plane0,
+					renderTargetDescriptor.usageState, renderTargetDescriptor.finalState);
+			}
+
+			const RenderTargetDescriptor& depthDescriptor = renderPassDescriptor.depth;
+
+			if (depthDescriptor.texture)
+			{
+				TransitionTexture(depthDescriptor.texture, depthDescriptor.mipmap, 1, depthDescriptor.slice, 1, crgfx::TexturePlane::Plane0,
+					depthDescriptor.usageState, depthDescriptor.finalState);
+			}
+		}
+
+		ProcessTextureTransitions(renderPassDescriptor.endTextures);
+
+		ProcessBufferTransitions(renderPassDescriptor.endBuffers);
+	}
+
+	void CommandBufferNull::ProcessTextureTransitions(const crgfx::RenderPassDescriptor::TextureTransitionVector& textures)
+	{
+		for (const RenderPassTextureDescriptor& textureDescriptor : textures)
+		{
+			TransitionTexture(textureDescriptor.texture, textureDescriptor.mipmapStart, textureDescriptor.mipmapCount,
+				textureDescriptor.sliceStart, textureDescriptor.sliceCount, textureDescriptor.texturePlane, textureDescriptor.sourceState, textureDescriptor.destinationState);
+		}
+	}
+
+	void CommandBufferNull::ProcessBufferTransitions(const crgfx::RenderPassDescriptor::BufferTransitionVector& buffers)
+	{
+		for (const RenderPassBufferDescriptor& bufferDescriptor : buffers)
+		{
+			const CrHardwareGPUBufferNull* nullBuffer = static_cast<const CrHardwareGPUBufferNull*>(bufferDescriptor.hardwareBuffer);
+			crgfx::BufferState::T trackedState = nullBuffer->GetTrackedState();
+
+			CrCommandBufferAssertMsg
+			(
+				trackedState == crgfx::BufferState::Undefined || bufferDescriptor.sourceState == crgfx::BufferState::Undefined || trackedState == bufferDescriptor.sourceState,
+				"Buffer %s is in state %s but the transition expects %s", nullBuffer->GetDebugName(),
+				crgfx::BufferState::ToString(trackedState), crgfx::BufferState::ToString(bufferDescriptor.sourceState)
+			);
+
+			nullBuffer->SetTrackedState(bufferDescriptor.destinationState);
+		}
+	}
+
+	void CommandBufferNull::TransitionTexture
+	(
+		const crgfx::ITexture* texture, uint32_t mipmapStart, uint32_t mipmapCount, uint32_t sliceStart, uint32_t sliceCount,
+		crgfx::TexturePlane::T texturePlane, const crgfx::TextureState& sourceState, const crgfx::TextureState& destinationState
+	)
+	{
+		const TextureNull* nullTexture = static_cast<const TextureNull*>(texture);
+
+		CrCommandBufferAssertMsg(mipmapStart < texture->GetMipmapCount(), "Transition mipmap out of bounds for texture %s", texture->GetDebugName());
+		CrCommandBufferAssertMsg(sliceStart < texture->GetSliceCount(), "Transition slice out of bounds for texture %s", texture->GetDebugName());
+		CrCommandBufferAssertMsg(destinationState.layout != crgfx::TextureLayout::Undefined, "Transitioning texture %s into an undefined layout", texture->GetDebugName());
+
+		uint32_t mipmapEnd = mipmapStart + CrMin(mipmapCount, texture->GetMipmapCount() - mipmapStart);
+
+		// Slices and planes aren't tracked separately. A transition that leaves the rest of the texture behind makes its
+		// layout unknown until one covers all of it again
+		bool coversTexture = sliceStart == 0 && sliceCount >= texture->GetSliceCount() && texturePlane == crgfx::TexturePlane::Plane0;
+
+		for (uint32_t mip = mipmapStart; mip < mipmapEnd; ++mip)
+		{
+			const crgfx::TextureState& trackedState = nullTexture->GetTrackedState(mip);
+
+			CrCommandBufferAssertMsg
+			(
+				trackedState.layout == crgfx::TextureLayout::Undefined || sourceState.layout == crgfx::TextureLayout::Undefined || trackedState.layout == sourceState.layout,
+				"Texture %s mip %i is in layout %s but the transition expects %s", texture->GetDebugName(), mip,
+				crgfx::TextureLayout::ToString(trackedState.layout), crgfx::TextureLayout::ToString(sourceState.layout)
+			);
+
+			nullTexture->SetTrackedState(mip, coversTexture ? destinationState : crgfx::TextureState());
+		}
+	}
+
+	void CommandBufferNull::ValidateShaderBindings(const ShaderBindingLayout& bindingLayout) const
+	{
+		bindingLayout.ForEachConstantBuffer([&](crgfx::ShaderStage::T, ConstantBuffers::T id, bindpoint_t)
+		{
+			CrCommandBufferAssertMsg(m_currentState.m_constantBuffers[id].buffer != nullptr, "Shader reads constant buffer %i but nothing is bound", id);
+		});
+
+		bindingLayout.ForEachSampler([&](crgfx::ShaderStage::T, Samplers::T id, bindpoint_t)
+		{
+			CrCommandBufferAssertMsg(m_currentState.m_samplers[id] != nullptr, "Shader reads sampler %i but nothing is bound", id);
+		});
+
+		bindingLayout.ForEachTexture([&](crgfx::ShaderStage::T, Textures::T id, bindpoint_t)
+		{
+			const TextureBinding& binding = m_currentState.m_textures[id];
+			CrCommandBufferAssertMsg(binding.texture != nullptr, "Shader reads texture %i but nothing is bound", id);
+
+			if (binding.texture)
+			{
+				// Sampling a texture that is being written to or presented reads undefined contents
+				crgfx::TextureLayout::T layout = static_cast<const TextureNull*>(binding.texture)->GetTrackedState(binding.view.mipmapStart).layout;
+				CrCommandBufferAssertMsg
+				(
+					layout != crgfx::TextureLayout::RenderTarget && layout != crgfx::TextureLayout::CopyDestination && layout != crgfx::TextureLayout::Present,
+					"Texture %s is bound for reading while in layout %s", binding.texture->GetDebugName(), crgfx::TextureLayout::ToString(layout)
+				);
+			}
+		});
+
+		bindingLayout.ForEachRWTexture([&](crgfx::ShaderStage::T, RWTextures::T id, bindpoint_t)
+		{
+			const RWTextureBinding& binding = m_currentState.m_rwTextures[id];
+			CrCommandBufferAssertMsg(binding.texture != nullptr, "Shader writes RW texture %i but nothing is bound", id);
+
+			if (binding.texture)
+			{
+				crgfx::TextureLayout::T layout = static_cast<const TextureNull*>(binding.texture)->GetTrackedState(binding.mip).layout;
+				CrCommandBufferAssertMsg
+				(
+					layout == crgfx::TextureLayout::Undefined || layout == crgfx::TextureLayout::RWTexture,
+					"Texture %s is bound as RW texture while in layout %s", binding.texture->GetDebugName(), crgfx::TextureLayout::ToString(layout)
+				);
+			}
+		});
+
+		bindingLayout.ForEachStorageBuffer([&](crgfx::ShaderStage::T, StorageBuffers::T id, bindpoint_t)
+		{
+			CrCommandBufferAssertMsg(m_currentState.m_storageBuffers[id].buffer != nullptr, "Shader reads storage buffer %i but nothing is bound", id);
+		});
+
+		bindingLayout.ForEachRWStorageBuffer([&](crgfx::ShaderStage::T, RWStorageBuffers::T id, bindpoint_t)
+		{
+			CrCommandBufferAssertMsg(m_currentState.m_rwStorageBuffers[id].buffer != nullptr, "Shader writes RW storage buffer %i but nothing is bound", id);
+		});
+
+		bindingLayout.ForEachRWTypedBuffer([&](crgfx::ShaderStage::T, RWTypedBuffers::T id, bindpoint_t)
+		{
+			CrCommandBufferAssertMsg(m_currentState.m_rwTypedBuffers[id].buffer != nullptr, "Shader writes RW typed buffer %i but nothing is bound", id);
+		});
+	}
+
+	void CommandBufferNull::ValidateIndirectBuffer(const IHardwareGPUBuffer* indirectBuffer, uint32_t offset, uint32_t argumentSizeBytes, uint32_t count) const
+	{
+		CrCommandBufferAssertMsg(m_recording, "Command buffer is not recording");
+		CrCommandBufferAssertMsg(indirectBuffer->HasUsage(crgfx::BufferUsage::Indirect), "Buffer %s must have indirect usage", indirectBuffer->GetDebugName());
+		CrCommandBufferAssertMsg((uint64_t)offset + (uint64_t)argumentSizeBytes * count <= indirectBuffer->GetSizeBytes(), "Indirect arguments past the end of buffer %s", indirectBuffer->GetDebugName());
+
+		crgfx::BufferState::T trackedState = static_cast<const CrHardwareGPUBufferNull*>(indirectBuffer)->GetTrackedState();
+		CrCommandBufferAssertMsg
+		(
+			trackedState == crgfx::BufferState::Undefined || trackedState == crgfx::BufferState::IndirectArgument,
+			"Buffer %s is used for indirect arguments while in state %s", indirectBuffer->GetDebugName(), crgfx::BufferState::ToString(trackedState)
+		);
+	}
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Graphics/ICommandBuffer.h"
+#include "Graphics/CrGraphics.h"
+
+namespace crgfx
+{
+	class ShaderBindingLayout;
+
+	// Nothing is executed, so commands are checked and resource states tracked as they are recorded. Recording is
+	// the same as executing here, which means a command buffer that is recorded and never submitted still moves its
+	// resources into new states
+	class CommandBufferNull final : public ICommandBuffer
+	{
+	public:
+
+		CommandBufferNull(crgfx::IDevice* renderDevice, const crgfx::CommandBufferDescriptor& descriptor);
+
+		bool IsRecording() const { return m_recording; }
+
+	private:
+
+		virtual void BeginPS() override;
+
+		virtual void EndPS() override;
+
+		virtual void ClearRenderTargetPS(const crgfx::ITexture* renderTarget, const float4& color, uint32_t mip, uint32_t slice, uint32_t mipCount, uint32_t sliceCount) override;
+
+		virtual void DrawPS(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) override;
+
+		virtual void DrawIndexedPS(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, uint32_t vertexOffset, uint32_t firstInstance) override;
+
+		virtual void DispatchPS(uint32_t threadGroupCountX, uint32_t threadGroupCountY, uint32_t threadGroupCountZ) override;
+
+		virtual void DrawIndirectPS(const IHardwareGPUBuffer* indirectBuffer, uint32_t offset, uint32_t count) override;
+
+		virtual void DrawIndexedIndirectPS(const IHardwareGPUBuffer* indirectBuffer, uint32_t offset, uint32_t count) override;
+
+		virtual void DispatchIndirectPS(const IHardwareGPUBuffer* indirectBuffer, uint32_t offset) override;
+
+		virtual void BeginDebugEventPS(const char* eventName, const float4& color) override;
+
+		virtual void EndDebugEventPS() override;
+
+		virtual void InsertDebugMarkerPS(const char* markerName, const float4& color) override;
+
+		virtual void BeginTimestampQueryPS(const IGPUQueryPool* queryPool, CrGPUQueryId query) override;
+
+		virtual void EndTimestampQueryPS(const IGPUQueryPool* queryPool, CrGPUQueryId query) override;
+
+		virtual void ResetGPUQueriesPS(const IGPUQueryPool* queryPool, uint32_t start, uint32_t count) override;
+
+		virtual void ResolveGPUQueriesPS(const IGPUQueryPool* queryPool, uint32_t start, uint32_t count) override;
+
+		virtual void FlushGraphicsRenderStatePS() override;
+
+		virtual void FlushComputeRenderStatePS() override;
+
+		virtual void BeginRenderPassPS(const crgfx::RenderPassDescriptor& renderPassDescriptor) override;
+
+		virtual void EndRenderPassPS() override;
+
+		void ProcessTextureTransitions(const crgfx::RenderPassDescriptor::TextureTransitionVector& textures);
+
+		void ProcessBufferTransitions(const crgfx::RenderPassDescriptor::BufferTransitionVector& buffers);
+
+		// Checks the source state against the tracked one, then tracks the destination state. Counts larger than the
+		// texture are clamped, as they mean all the remaining mips or slices
+		void TransitionTexture
+		(
+			const crgfx::ITexture* texture, uint32_t mipmapStart, uint32_t mipmapCount, uint32_t sliceStart, uint32_t sliceCount,
+			crgfx::TexturePlane::T texturePlane, const crgfx::TextureState& sourceState, const crgfx::TextureState& destinationState
+		);
+
+		void ValidateShaderBindings(const ShaderBindingLayout& bindingLayout) const;
+
+		void ValidateIndirectBuffer(const IHardwareGPUBuffer* indirectBuffer, uint32_t offset, uint32_t argumentSizeBytes, uint32_t count) const;
+
+		uint32_t m_debugEventDepth;
+	};
+};
@@ -0,0 +1,276 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "DeviceNull.h"
+#include "CommandBufferNull.h"
+#include "TextureNull.h"
+#include "SamplerNull.h"
+#include "SwapchainNull.h"
+#include "GPUBufferNull.h"
+#include "GPUQueryPoolNull.h"
+#include "GPUSynchronizationNull.h"
+#include "ShaderNull.h"
+#include "PipelineNull.h"
+
+#include "Core/CrMacros.h"
+
+namespace crgfx
+{
+	DeviceNull::DeviceNull(IGraphicsSystem* renderSystem, const DeviceDescriptor& descriptor) : IDevice(renderSystem, descriptor)
+	{
+		m_deviceProperties.graphicsApiDisplay = crgfx::GraphicsApi::ToString(crgfx::GraphicsApi::Null);
+		m_deviceProperties.description = "Null Device";
+		m_deviceProperties.isUMA = true;
+
+		// Limits of a typical desktop GPU, so that content that runs on one also validates here
+		m_deviceProperties.maxConstantBufferRange = 65536;
+		m_deviceProperties.maxTextureDimension1D = 16384;
+		m_deviceProperties.maxTextureDimension2D = 16384;
+		m_deviceProperties.maxTextureDimension3D = 2048;
+
+		m_deviceProperties.features.compressionBC = true;
+		m_deviceProperties.features.textureFormatCasting = true;
+
+		CrLog("Created %s", m_deviceProperties.description.c_str());
+	}
+
+	DeviceNull::~DeviceNull()
+	{
+
+	}
+
+	uint64_t DeviceNull::GetTimestampNanoseconds() const
+	{
+		return (uint64_t)(m_timestampTimer.elapsed().milliseconds() * 1000000.0);
+	}
+
+	crgfx::ICommandBuffer* DeviceNull::CreateCommandBufferPS(const crgfx::CommandBufferDescriptor& descriptor)
+	{
+		return new CommandBufferNull(this, descriptor);
+	}
+
+	IGPUFence* DeviceNull::CreateGPUFencePS(bool signaled)
+	{
+		return new GPUFenceNull(this, signaled);
+	}
+
+	IGPUSemaphore* DeviceNull::CreateGPUSemaphorePS()
+	{
+		return new GPUSemaphoreNull(this);
+	}
+
+	IGraphicsShader* DeviceNull::CreateGraphicsShaderPS(const GraphicsShaderDescriptor& graphicsShaderDescriptor)
+	{
+		return new GraphicsShaderNull(this, graphicsShaderDescriptor);
+	}
+
+	IComputeShader* DeviceNull::CreateComputeShaderPS(const ComputeShaderDescriptor& computeShaderDescriptor)
+	{
+		return new ComputeShaderNull(this, computeShaderDescriptor);
+	}
+
+	IHardwareGPUBuffer* DeviceNull::CreateHardwareGPUBufferPS(const HardwareGPUBufferDescriptor& descriptor)
+	{
+		return new CrHardwareGPUBufferNull(this, descriptor);
+	}
+
+	ISampler* DeviceNull::CreateSamplerPS(const crgfx::SamplerDescriptor& descriptor)
+	{
+		return new SamplerNull(this, descriptor);
+	}
+
+	ISwapchain* DeviceNull::CreateSwapchainPS(const crgfx::SwapchainDescriptor& swapchainDescriptor)
+	{
+		return new SwapchainNull(this, swapchainDescriptor);
+	}
+
+	ITexture* DeviceNull::CreateTexturePS(const crgfx::TextureDescriptor& descriptor)
+	{
+		return new TextureNull(this, descriptor);
+	}
+
+	IGraphicsPipeline* DeviceNull::CreateGraphicsPipelinePS
+	(
+		const GraphicsPipelineDescriptor& pipelineDescriptor, const crgfx::GraphicsShaderHandle& graphicsShader, const VertexDescriptor& vertexDescriptor
+	)
+	{
+		return new GraphicsPipelineNull(this, pipelineDescriptor, graphicsShader, vertexDescriptor);
+	}
+
+	IComputePipeline* DeviceNull::CreateComputePipelinePS(const ComputeShaderHandle& computeShader)
+	{
+		return new ComputePipelineNull(this, computeShader);
+	}
+
+	IGPUQueryPool* DeviceNull::CreateGPUQueryPoolPS(const GPUQueryPoolDescriptor& queryPoolDescriptor)
+	{
+		return new CrGPUQueryPoolNull(this, queryPoolDescriptor);
+	}
+
+	crgfx::GPUFenceResult DeviceNull::WaitForFencePS(const IGPUFence* fence, uint64_t timeoutNanoseconds)
+	{
+		// Nothing is in flight, so waiting can't change the result. Waiting on a fence nobody signals would
+		// hang a real device
+		crgfx::GPUFenceResult result = GetFenceStatusPS(fence);
+		CrAssertMsg(result == crgfx::GPUFenceResult::Success || timeoutNanoseconds != UINT64_MAX, "Waiting forever on fence that is never signaled");
+		return result;
+	}
+
+	crgfx::GPUFenceResult DeviceNull::GetFenceStatusPS(const IGPUFence* fence) const
+	{
+		const GPUFenceNull* nullFence = static_cast<const GPUFenceNull*>(fence);
+
+		if (nullFence->IsSignaled())
+		{
+			return crgfx::GPUFenceResult::Success;
+		}
+		else
+		{
+			return crgfx::GPUFenceResult::TimeoutOrNotReady;
+		}
+	}
+
+	void DeviceNull::SignalFencePS(crgfx::CommandQueueType::T queueType, const IGPUFence* fence)
+	{
+		unused_parameter(queueType);
+
+		static_cast<const GPUFenceNull*>(fence)->SetSignaled(true);
+	}
+
+	void DeviceNull::ResetFencePS(const IGPUFence* fence)
+	{
+		static_cast<const GPUFenceNull*>(fence)->SetSignaled(false);
+	}
+
+	void DeviceNull::WaitIdlePS()
+	{
+		// Work completes on submission, so the device is always idle
+	}
+
+	uint8_t* DeviceNull::BeginTextureUploadPS(const crgfx::ITexture* texture)
+	{
+		HardwareGPUBufferDescriptor stagingBufferDescriptor(crgfx::BufferUsage::TransferSrc, crgfx::MemoryAccess::StagingUpload, texture->GetUsedGPUMemory());
+		stagingBufferDescriptor.name = "Texture Upload Staging Buffer";
+
+		TextureUpload textureUpload;
+		textureUpload.stagingBuffer = CreateHardwareGPUBuffer(stagingBufferDescriptor);
+		textureUpload.mipmapStart = 0;
+		textureUpload.mipmapCount = texture->GetMipmapCount();
+		textureUpload.sliceStart = 0;
+		textureUpload.sliceCount = texture->GetSliceCount();
+
+		CrHash textureHash(&texture, sizeof(texture));
+
+		// Add to the open uploads for when we end the texture upload
+		m_openTextureUploads.insert(textureHash, textureUpload);
+
+		return (uint8_t*)static_cast<CrHardwareGPUBufferNull*>(textureUpload.stagingBuffer.get())->Lock();
+	}
+
+	void DeviceNull::EndTextureUploadPS(const crgfx::ITexture* destinationTexture)
+	{
+		CrHash textureHash(&destinationTexture, sizeof(destinationTexture));
+		const auto textureUploadIter = m_openTextureUploads.find(textureHash);
+		CrAssertMsg(textureUploadIter != m_openTextureUploads.end(), "Tried ending texture upload with no begin");
+
+		const TextureUpload& textureUpload = textureUploadIter->second;
+
+		const TextureNull* nullDestinationTexture = static_cast<const TextureNull*>(destinationTexture);
+		CrHardwareGPUBufferNull* nullStagingBuffer = static_cast<CrHardwareGPUBufferNull*>(textureUpload.stagingBuffer.get());
+
+		nullStagingBuffer->Unlock();
+
+		// The staging buffer has the same layout as the texture, so the whole of it goes in one copy
+		memcpy(nullDestinationTexture->GetMemory(), nullStagingBuffer->GetMemory(), nullStagingBuffer->GetSizeBytes());
+
+		// The upload leaves every mip in the default state, like it does on the other platforms
+		for (uint32_t mip = 0; mip < destinationTexture->GetMipmapCount(); ++mip)
+		{
+			nullDestinationTexture->SetTrackedState(mip, destinationTexture->GetDefaultState());
+		}
+
+		m_openTextureUploads.erase(textureUploadIter);
+	}
+
+	uint8_t* DeviceNull::BeginBufferUploadPS(const IHardwareGPUBuffer* destinationBuffer)
+	{
+		uint32_t stagingBufferSizeBytes = destinationBuffer->GetSizeBytes();
+
+		HardwareGPUBufferDescriptor stagingBufferDescriptor(crgfx::BufferUsage::TransferSrc, crgfx::MemoryAccess::StagingUpload, stagingBufferSizeBytes);
+		stagingBufferDescriptor.name = "Buffer Upload Staging Buffer";
+
+		BufferUpload bufferUpload;
+		bufferUpload.stagingBuffer = CreateHardwareGPUBuffer(stagingBufferDescriptor);
+		bufferUpload.destinationBuffer = destinationBuffer;
+		bufferUpload.sizeBytes = destinationBuffer->GetSizeBytes();
+		bufferUpload.sourceOffsetBytes = 0;
+		bufferUpload.destinationOffsetBytes = 0;
+
+		CrHash bufferHash(&destinationBuffer, sizeof(destinationBuffer));
+
+		// Add to the open uploads for when we end the buffer upload
+		m_openBufferUploads.insert(bufferHash, bufferUpload);
+
+		return (uint8_t*)static_cast<CrHardwareGPUBufferNull*>(bufferUpload.stagingBuffer.get())->Lock();
+	}
+
+	void DeviceNull::EndBufferUploadPS(const IHardwareGPUBuffer* destinationBuffer)
+	{
+		CrHash bufferHash(&destinationBuffer, sizeof(destinationBuffer));
+		const auto bufferUploadIter = m_openBufferUploads.find(bufferHash);
+		CrAssertMsg(bufferUploadIter != m_openBufferUploads.end(), "Tried ending buffer upload with no begin");
+
+		static_cast<CrHardwareGPUBufferNull*>(bufferUploadIter->second.stagingBuffer.get())->Unlock();
+
+		CopyBufferUploadsPS(&bufferUploadIter->second, 1);
+
+		m_openBufferUploads.erase(bufferUploadIter);
+	}
+
+	void DeviceNull::CopyBufferUploadsPS(const BufferUpload* bufferUploads, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const BufferUpload& bufferUpload = bufferUploads[i];
+			const CrHardwareGPUBufferNull* nullDestinationBuffer = static_cast<const CrHardwareGPUBufferNull*>(bufferUpload.destinationBuffer);
+			const CrHardwareGPUBufferNull* nullStagingBuffer = static_cast<const CrHardwareGPUBufferNull*>(bufferUpload.stagingBuffer.get());
+
+			CrAssertMsg(bufferUpload.sourceOffsetBytes + bufferUpload.sizeBytes <= nullStagingBuffer->GetSizeBytes(), "Upload reads past the end of the staging buffer");
+			CrAssertMsg(bufferUpload.destinationOffsetBytes + bufferUpload.sizeBytes <= nullDestinationBuffer->GetSizeBytes(), "Upload writes past the end of buffer %s", nullDestinationBuffer->GetDebugName());
+
+			memcpy
+			(
+				nullDestinationBuffer->GetMemory() + bufferUpload.destinationOffsetBytes,
+				nullStagingBuffer->GetMemory() + bufferUpload.sourceOffsetBytes,
+				bufferUpload.sizeBytes
+			);
+		}
+	}
+
+	HardwareGPUBufferHandle DeviceNull::DownloadBufferPS(const IHardwareGPUBuffer* sourceBuffer)
+	{
+		const CrHardwareGPUBufferNull* nullSourceBuffer = static_cast<const CrHardwareGPUBufferNull*>(sourceBuffer);
+
+		HardwareGPUBufferDescriptor stagingBufferDescriptor(crgfx::BufferUsage::TransferDst, crgfx::MemoryAccess::StagingDownload, sourceBuffer->GetSizeBytes());
+		HardwareGPUBufferHandle stagingBuffer = CreateHardwareGPUBuffer(stagingBufferDescriptor);
+		const CrHardwareGPUBufferNull* nullStagingBuffer = static_cast<const CrHardwareGPUBufferNull*>(stagingBuffer.get());
+
+		memcpy(nullStagingBuffer->GetMemory(), nullSourceBuffer->GetMemory(), sourceBuffer->GetSizeBytes());
+
+		return stagingBuffer;
+	}
+
+	void DeviceNull::SubmitCommandBufferPS(const crgfx::ICommandBuffer* commandBuffer, const IGPUSemaphore* waitSemaphore, const IGPUSemaphore* signalSemaphore, const IGPUFence* signalFence)
+	{
+		unused_parameter(waitSemaphore);
+		unused_parameter(signalSemaphore);
+
+		const CommandBufferNull* nullCommandBuffer = static_cast<const CommandBufferNull*>(commandBuffer);
+		CrAssertMsg(!nullCommandBuffer->IsRecording(), "Submitting command buffer that is still recording");
+
+		// Commands were validated as they were recorded, so by now they have completed
+		if (signalFence)
+		{
+			SignalFencePS(crgfx::CommandQueueType::Graphics, signalFence);
+		}
+	}
+};
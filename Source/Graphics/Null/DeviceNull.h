@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Graphics/IDevice.h"
+
+#include "Graphics/IGPUSynchronization.h"
+
+#include "crstl/timer.h"
+
+namespace crgfx
+{
+	// Device that runs nothing, but keeps resources in CPU memory and validates what command buffers record. Work
+	// completes as soon as it's submitted, so uploads and downloads are plain copies and fences are signaled on submit
+	class DeviceNull final : public crgfx::IDevice
+	{
+	public:
+
+		DeviceNull(IGraphicsSystem* renderSystem, const crgfx::DeviceDescriptor& descriptor);
+
+		~DeviceNull();
+
+		// Time since the device was created. Timestamp queries write this
+		uint64_t GetTimestampNanoseconds() const;
+
+	private:
+
+		//------------------
+		// Resource Creation
+		//------------------
+
+		virtual crgfx::ICommandBuffer* CreateCommandBufferPS(const crgfx::CommandBufferDescriptor& descriptor) override;
+
+		virtual crgfx::IGPUFence* CreateGPUFencePS(bool signaled) override;
+
+		virtual IGPUSemaphore* CreateGPUSemaphorePS() override;
+
+		virtual IGraphicsShader* CreateGraphicsShaderPS(const GraphicsShaderDescriptor& graphicsShaderDescriptor) override;
+
+		virtual IComputeShader* CreateComputeShaderPS(const ComputeShaderDescriptor& computeShaderDescriptor) override;
+
+		virtual IHardwareGPUBuffer* CreateHardwareGPUBufferPS(const HardwareGPUBufferDescriptor& descriptor) override;
+
+		virtual crgfx::ISampler* CreateSamplerPS(const crgfx::SamplerDescriptor& descriptor) override;
+
+		virtual ISwapchain* CreateSwapchainPS(const crgfx::SwapchainDescriptor& swapchainDescriptor) override;
+
+		virtual crgfx::ITexture* CreateTexturePS(const crgfx::TextureDescriptor& descriptor) override;
+
+		virtual IGraphicsPipeline* CreateGraphicsPipelinePS(const GraphicsPipelineDescriptor& pipelineDescriptor, const crgfx::GraphicsShaderHandle& graphicsShader, const VertexDescriptor& vertexDescriptor) override;
+
+		virtual IComputePipeline* CreateComputePipelinePS(const ComputeShaderHandle& computeShader) override;
+
+		virtual IGPUQueryPool* CreateGPUQueryPoolPS(const GPUQueryPoolDescriptor& queryPoolDescriptor) override;
+
+		//--------------------
+		// GPU Synchronization
+		//--------------------
+
+		virtual crgfx::GPUFenceResult WaitForFencePS(const IGPUFence* fence, uint64_t timeoutNanoseconds) override;
+
+		virtual crgfx::GPUFenceResult GetFenceStatusPS(const IGPUFence* fence) const override;
+
+		virtual void SignalFencePS(crgfx::CommandQueueType::T queueType, const IGPUFence* signalFence) override;
+
+		virtual void ResetFencePS(const IGPUFence* fence) override;
+
+		virtual void WaitIdlePS() override;
+
+		//--------------------
+		// Download and Upload
+		//--------------------
+
+		virtual uint8_t* BeginTextureUploadPS(const crgfx::ITexture* texture) override;
+
+		virtual void EndTextureUploadPS(const crgfx::ITexture* texture) override;
+
+		virtual uint8_t* BeginBufferUploadPS(const IHardwareGPUBuffer* destinationBuffer) override;
+
+		virtual void EndBufferUploadPS(const IHardwareGPUBuffer* destinationBuffer) override;
+
+		virtual void CopyBufferUploadsPS(const BufferUpload* bufferUploads, uint32_t count) override;
+
+		virtual HardwareGPUBufferHandle DownloadBufferPS(const IHardwareGPUBuffer* sourceBuffer) override;
+
+		virtual void SubmitCommandBufferPS(const crgfx::ICommandBuffer* commandBuffer, const IGPUSemaphore* waitSemaphore, const IGPUSemaphore* signalSemaphore, const IGPUFence* signalFence) override;
+
+		crstl::timer m_timestampTimer;
+	};
+};
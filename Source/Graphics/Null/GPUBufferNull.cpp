@@ -0,0 +1,57 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "GPUBufferNull.h"
+
+#include "Graphics/IDevice.h"
+
+#include "Core/Logging/ICrDebug.h"
+
+namespace crgfx
+{
+	CrHardwareGPUBufferNull::CrHardwareGPUBufferNull(crgfx::IDevice* renderDevice, const HardwareGPUBufferDescriptor& descriptor)
+		: IHardwareGPUBuffer(renderDevice, descriptor)
+		, m_lockCount(0)
+		, m_trackedState(crgfx::BufferState::Undefined)
+	{
+		CrAssertMsg(m_sizeBytes > 0, "Buffer %s has no size", descriptor.name ? descriptor.name : "");
+
+		m_memory.resize(m_sizeBytes);
+
+		if (descriptor.initialData)
+		{
+			CrAssertMsg(descriptor.initialDataSize <= m_sizeBytes, "Not enough memory in buffer");
+
+			if (descriptor.access == crgfx::MemoryAccess::GPUOnlyWrite)
+			{
+				uint8_t* bufferData = m_renderDevice->BeginBufferUpload(this);
+				{
+					memcpy(bufferData, descriptor.initialData, descriptor.initialDataSize);
+				}
+				m_renderDevice->EndBufferUpload(this);
+			}
+			else
+			{
+				memcpy(m_memory.data(), descriptor.initialData, descriptor.initialDataSize);
+			}
+		}
+	}
+
+	CrHardwareGPUBufferNull::~CrHardwareGPUBufferNull()
+	{
+
+	}
+
+	void* CrHardwareGPUBufferNull::LockPS()
+	{
+		m_lockCount++;
+		m_mapped = true;
+		return m_memory.data();
+	}
+
+	void CrHardwareGPUBufferNull::UnlockPS()
+	{
+		CrAssertMsg(m_lockCount > 0, "Unlocking buffer %s that isn't locked", GetDebugName());
+		m_lockCount--;
+		m_mapped = m_lockCount > 0;
+	}
+};
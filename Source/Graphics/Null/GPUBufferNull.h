@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Graphics/GPUBuffer.h"
+
+#include "crstl/vector.h"
+
+namespace crgfx
+{
+	class CrHardwareGPUBufferNull final : public IHardwareGPUBuffer
+	{
+	public:
+
+		CrHardwareGPUBufferNull(crgfx::IDevice* renderDevice, const HardwareGPUBufferDescriptor& descriptor);
+
+		virtual ~CrHardwareGPUBufferNull() override;
+
+		virtual void* LockPS() override;
+
+		virtual void UnlockPS() override;
+
+		// Memory the device copies to and from. Unlike Lock it's available whatever the access
+		uint8_t* GetMemory() const { return m_memory.data(); }
+
+		// State the last transition left the buffer in. Undefined until the first one, which means nothing is known
+		crgfx::BufferState::T GetTrackedState() const { return m_trackedState; }
+
+		void SetTrackedState(crgfx::BufferState::T state) const { m_trackedState = state; }
+
+	private:
+
+		mutable crstl::vector<uint8_t> m_memory;
+
+		// Maps nest, like they do in the APIs
+		uint32_t m_lockCount;
+
+		mutable crgfx::BufferState::T m_trackedState;
+	};
+};
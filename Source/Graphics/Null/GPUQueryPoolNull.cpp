@@ -0,0 +1,49 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "GPUQueryPoolNull.h"
+
+#include "Core/Logging/ICrDebug.h"
+
+namespace crgfx
+{
+	CrGPUQueryPoolNull::CrGPUQueryPoolNull(crgfx::IDevice* renderDevice, const GPUQueryPoolDescriptor& descriptor) : IGPUQueryPool(renderDevice, descriptor)
+	{
+		m_querySize = sizeof(uint64_t);
+
+		m_timestampPeriod = 1.0;
+
+		m_queryData.resize(descriptor.count, 0);
+	}
+
+	void CrGPUQueryPoolNull::WriteQuery(uint32_t queryIndex, uint64_t value) const
+	{
+		CrAssertMsg(queryIndex < m_queryData.size(), "Query %i is out of bounds", queryIndex);
+		m_queryData[queryIndex] = value;
+	}
+
+	void CrGPUQueryPoolNull::ResetQueries(uint32_t start, uint32_t count) const
+	{
+		CrAssertMsg(start + count <= m_queryData.size(), "Query range is out of bounds");
+
+		for (uint32_t i = start; i < start + count; ++i)
+		{
+			m_queryData[i] = 0;
+		}
+	}
+
+	void CrGPUQueryPoolNull::GetTimingDataPS(GPUTimestamp* timingData, uint32_t timingCount)
+	{
+		for (uint32_t i = 0; i < timingCount; i++)
+		{
+			timingData[i].ticks = m_queryData[i];
+		}
+	}
+
+	void CrGPUQueryPoolNull::GetOcclusionDataPS(GPUOcclusion* occlusionData, uint32_t occlusionCount)
+	{
+		for (uint32_t i = 0; i < occlusionCount; i++)
+		{
+			occlusionData[i].visibilitySamples = m_queryData[i];
+		}
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Graphics/IGPUQueryPool.h"
+
+#include "crstl/vector.h"
+
+namespace crgfx
+{
+	class IDevice;
+
+	// Results are written by the command buffer as it records, in nanoseconds for timestamps
+	class CrGPUQueryPoolNull final : public IGPUQueryPool
+	{
+	public:
+
+		CrGPUQueryPoolNull(crgfx::IDevice* renderDevice, const GPUQueryPoolDescriptor& descriptor);
+
+		void WriteQuery(uint32_t queryIndex, uint64_t value) const;
+
+		void ResetQueries(uint32_t start, uint32_t count) const;
+
+	protected:
+
+		virtual void GetTimingDataPS(GPUTimestamp* timingData, uint32_t timingCount) override;
+
+		virtual void GetOcclusionDataPS(GPUOcclusion* occlusionData, uint32_t count) override;
+
+		mutable crstl::vector<uint64_t> m_queryData;
+	};
+};
@@ -0,0 +1,17 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "GPUSynchronizationNull.h"
+
+namespace crgfx
+{
+	GPUFenceNull::GPUFenceNull(crgfx::IDevice* renderDevice, bool signaled) : IGPUFence(renderDevice)
+		, m_signaled(signaled)
+	{
+
+	}
+
+	GPUSemaphoreNull::GPUSemaphoreNull(crgfx::IDevice* renderDevice) : IGPUSemaphore(renderDevice)
+	{
+
+	}
+};
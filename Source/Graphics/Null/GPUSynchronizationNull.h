@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Graphics/IGPUSynchronization.h"
+
+namespace crgfx
+{
+	class IDevice;
+
+	// Work completes as soon as it's submitted, so a fence is signaled by the submission itself
+	class GPUFenceNull final : public IGPUFence
+	{
+	public:
+
+		GPUFenceNull(crgfx::IDevice* renderDevice, bool signaled);
+
+		bool IsSignaled() const { return m_signaled; }
+
+		void SetSignaled(bool signaled) const { m_signaled = signaled; }
+
+	private:
+
+		mutable bool m_signaled;
+	};
+
+	class GPUSemaphoreNull final : public IGPUSemaphore
+	{
+	public:
+
+		GPUSemaphoreNull(crgfx::IDevice* renderDevice);
+	};
+};
@@ -0,0 +1,18 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "GraphicsSystemNull.h"
+#include "DeviceNull.h"
+
+namespace crgfx
+{
+	GraphicsSystemNull::GraphicsSystemNull(const crgfx::GraphicsSystemDescriptor& graphicsSystemDescriptor)
+		: IGraphicsSystem(graphicsSystemDescriptor)
+	{
+
+	}
+
+	crgfx::IDevice* GraphicsSystemNull::CreateDevicePS(const crgfx::DeviceDescriptor& descriptor)
+	{
+		return new DeviceNull(this, descriptor);
+	}
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Graphics/IGraphicsSystem.h"
+
+namespace crgfx
+{
+	// Graphics system that doesn't talk to any driver. Devices it creates keep every resource in CPU memory and
+	// validate what command buffers record, so frames can run headless, e.g. on build machines
+	class GraphicsSystemNull final : public IGraphicsSystem
+	{
+	public:
+
+		GraphicsSystemNull(const crgfx::GraphicsSystemDescriptor& graphicsSystemDescriptor);
+
+		virtual crgfx::IDevice* CreateDevicePS(const crgfx::DeviceDescriptor& descriptor) override;
+	};
+};
@@ -0,0 +1,48 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "PipelineNull.h"
+
+#include "Graphics/IShader.h"
+
+#include "Core/CrMacros.h"
+#include "Core/Logging/ICrDebug.h"
+
+namespace crgfx
+{
+	GraphicsPipelineNull::GraphicsPipelineNull
+	(
+		crgfx::IDevice* renderDevice, const GraphicsPipelineDescriptor& pipelineDescriptor,
+		const crgfx::GraphicsShaderHandle& graphicsShader, const VertexDescriptor& vertexDescriptor
+	)
+		: IGraphicsPipeline(renderDevice, pipelineDescriptor, graphicsShader, vertexDescriptor)
+		, m_renderTargetFormats(pipelineDescriptor.renderTargets)
+	{
+		CrAssertMsg(graphicsShader, "Graphics pipeline has no shader");
+	}
+
+#if !defined(CR_CONFIG_FINAL)
+
+	void GraphicsPipelineNull::RecompilePS(crgfx::IDevice* renderDevice, const crgfx::GraphicsShaderHandle& graphicsShader)
+	{
+		unused_parameter(renderDevice);
+		CrAssertMsg(graphicsShader, "Graphics pipeline has no shader");
+	}
+
+#endif
+
+	ComputePipelineNull::ComputePipelineNull(crgfx::IDevice* renderDevice, const crgfx::ComputeShaderHandle& computeShader)
+		: IComputePipeline(renderDevice, computeShader)
+	{
+		CrAssertMsg(GetGroupSizeX() > 0 && GetGroupSizeY() > 0 && GetGroupSizeZ() > 0, "Compute shader %s has an empty thread group", computeShader->GetDebugName());
+	}
+
+#if !defined(CR_CONFIG_FINAL)
+
+	void ComputePipelineNull::RecompilePS(crgfx::IDevice* renderDevice, const crgfx::ComputeShaderHandle& computeShader)
+	{
+		unused_parameter(renderDevice);
+		unused_parameter(computeShader);
+	}
+
+#endif
+};
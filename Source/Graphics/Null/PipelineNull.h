@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Graphics/IPipeline.h"
+
+namespace crgfx
+{
+	class GraphicsPipelineNull final : public IGraphicsPipeline
+	{
+	public:
+
+		GraphicsPipelineNull
+		(
+			crgfx::IDevice* renderDevice, const GraphicsPipelineDescriptor& pipelineDescriptor,
+			const crgfx::GraphicsShaderHandle& graphicsShader, const VertexDescriptor& vertexDescriptor
+		);
+
+		// Formats the pipeline was created for, which must match the render targets it draws into
+		const crgfx::RenderTargetFormatDescriptor& GetRenderTargetFormats() const { return m_renderTargetFormats; }
+
+#if !defined(CR_CONFIG_FINAL)
+
+		virtual void RecompilePS(crgfx::IDevice* renderDevice, const crgfx::GraphicsShaderHandle& graphicsShader) override;
+
+#endif
+
+	private:
+
+		crgfx::RenderTargetFormatDescriptor m_renderTargetFormats;
+	};
+
+	class ComputePipelineNull final : public IComputePipeline
+	{
+	public:
+
+		ComputePipelineNull(crgfx::IDevice* renderDevice, const crgfx::ComputeShaderHandle& computeShader);
+
+#if !defined(CR_CONFIG_FINAL)
+
+		virtual void RecompilePS(crgfx::IDevice* renderDevice, const crgfx::ComputeShaderHandle& computeShader) override;
+
+#endif
+	};
+};
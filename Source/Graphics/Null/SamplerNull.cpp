@@ -0,0 +1,15 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "SamplerNull.h"
+
+#include "Core/Logging/ICrDebug.h"
+
+namespace crgfx
+{
+	SamplerNull::SamplerNull(crgfx::IDevice* renderDevice, const crgfx::SamplerDescriptor& descriptor) : ISampler(renderDevice)
+	{
+		// Same limits every API enforces when creating the sampler object
+		CrAssertMsg(!descriptor.enableAnisotropy || (descriptor.maxAnisotropy >= 1 && descriptor.maxAnisotropy <= 16), "Sampler %s: anisotropy must be between 1 and 16", descriptor.name.c_str());
+		CrAssertMsg(descriptor.minLod <= descriptor.maxLod, "Sampler %s: minimum lod is larger than the maximum", descriptor.name.c_str());
+	}
+}
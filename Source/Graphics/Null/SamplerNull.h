@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Graphics/ISampler.h"
+
+namespace crgfx
+{
+	class IDevice;
+
+	class SamplerNull final : public ISampler
+	{
+	public:
+
+		SamplerNull(crgfx::IDevice* renderDevice, const crgfx::SamplerDescriptor& descriptor);
+	};
+}
@@ -0,0 +1,32 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "ShaderNull.h"
+
+#include "Graphics/CrShaderResourceMetadata.h"
+#include "Graphics/IShader.inl"
+
+namespace crgfx
+{
+	GraphicsShaderNull::GraphicsShaderNull(crgfx::IDevice* renderDevice, const crgfx::GraphicsShaderDescriptor& graphicsShaderDescriptor)
+		: IGraphicsShader(renderDevice, graphicsShaderDescriptor)
+	{
+		ShaderBindingLayoutResources resources;
+
+		for (const ShaderBytecodeHandle& shaderBytecode : graphicsShaderDescriptor.m_bytecodes)
+		{
+			const CrShaderReflectionHeader& reflectionHeader = shaderBytecode->GetReflection();
+			ShaderBindingLayout::AddResources(reflectionHeader, resources, [](crgfx::ShaderStage::T, const CrShaderReflectionResource&){});
+		}
+
+		m_bindingLayout = crstl::unique_ptr<ShaderBindingLayout>(new ShaderBindingLayout(resources));
+	}
+
+	ComputeShaderNull::ComputeShaderNull(crgfx::IDevice* renderDevice, const crgfx::ComputeShaderDescriptor& computeShaderDescriptor)
+		: IComputeShader(renderDevice, computeShaderDescriptor)
+	{
+		ShaderBindingLayoutResources resources;
+		const CrShaderReflectionHeader& reflectionHeader = computeShaderDescriptor.m_bytecode->GetReflection();
+		ShaderBindingLayout::AddResources(reflectionHeader, resources, [](crgfx::ShaderStage::T, const CrShaderReflectionResource&){});
+		m_bindingLayout = crstl::unique_ptr<ShaderBindingLayout>(new ShaderBindingLayout(resources));
+	}
+};
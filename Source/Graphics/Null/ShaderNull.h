@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Graphics/IShader.h"
+
+namespace crgfx
+{
+	// Shaders only keep their binding layout, built from the reflection in the bytecode
+	class GraphicsShaderNull final : public IGraphicsShader
+	{
+	public:
+
+		GraphicsShaderNull(crgfx::IDevice* renderDevice, const GraphicsShaderDescriptor& graphicsShaderDescriptor);
+	};
+
+	class ComputeShaderNull final : public IComputeShader
+	{
+	public:
+
+		ComputeShaderNull(crgfx::IDevice* renderDevice, const ComputeShaderDescriptor& computeShaderDescriptor);
+	};
+};
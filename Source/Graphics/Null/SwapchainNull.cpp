@@ -0,0 +1,81 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "SwapchainNull.h"
+#include "TextureNull.h"
+
+#include "Graphics/IDevice.h"
+
+#include "Core/CrMacros.h"
+#include "Core/Logging/ICrDebug.h"
+
+#include "Math/CrMath.h"
+
+namespace crgfx
+{
+	SwapchainNull::SwapchainNull(crgfx::IDevice* renderDevice, const crgfx::SwapchainDescriptor& swapchainDescriptor)
+		: ISwapchain(renderDevice, swapchainDescriptor)
+	{
+		// Without a window nothing limits the size, so the requested one is taken as it is
+		m_width = CrMax(swapchainDescriptor.requestedWidth, 1u);
+		m_height = CrMax(swapchainDescriptor.requestedHeight, 1u);
+		m_format = swapchainDescriptor.format;
+		m_imageCount = CrMax(swapchainDescriptor.requestedBufferCount, 1u);
+
+		CreateSwapchainTextures();
+	}
+
+	crgfx::CrSwapchainResult SwapchainNull::AcquireNextImagePS(uint64_t timeoutNanoseconds)
+	{
+		unused_parameter(timeoutNanoseconds);
+
+		// Acquiring again before presenting hands out the same image, like the window does when it's created
+		m_imageAcquired = true;
+
+		return crgfx::CrSwapchainResult::Success;
+	}
+
+	void SwapchainNull::PresentPS()
+	{
+		CrAssertMsg(m_imageAcquired, "Swapchain %s presented an image it didn't acquire", m_name.c_str());
+
+		const TextureNull* nullTexture = static_cast<const TextureNull*>(m_textures[m_currentBufferIndex].get());
+		crgfx::TextureLayout::T layout = nullTexture->GetTrackedState(0).layout;
+
+		CrAssertMsg(layout == crgfx::TextureLayout::Present || layout == crgfx::TextureLayout::Undefined,
+			"Swapchain %s presented an image in layout %s", m_name.c_str(), crgfx::TextureLayout::ToString(layout));
+
+		m_currentBufferIndex = (m_currentBufferIndex + 1) % m_imageCount;
+		m_imageAcquired = false;
+	}
+
+	void SwapchainNull::ResizePS(uint32_t width, uint32_t height)
+	{
+		m_width = width;
+		m_height = height;
+
+		// An image that was acquired stays acquired, it's just a new one
+		m_textures.clear();
+		m_currentBufferIndex = 0;
+
+		CreateSwapchainTextures();
+	}
+
+	void SwapchainNull::CreateSwapchainTextures()
+	{
+		crgfx::TextureDescriptor swapchainTextureParams;
+		swapchainTextureParams.width = m_width;
+		swapchainTextureParams.height = m_height;
+		swapchainTextureParams.format = m_format;
+		swapchainTextureParams.usage = crgfx::TextureUsage::SwapChain;
+
+		m_textures.reserve(m_imageCount);
+
+		for (uint32_t i = 0; i < m_imageCount; i++)
+		{
+			crstl::fixed_string128 swapchainName(m_name);
+			swapchainName.append_sprintf(" Texture %i", i);
+			swapchainTextureParams.name = swapchainName.c_str();
+			m_textures.push_back(m_renderDevice->CreateTexture(swapchainTextureParams));
+		}
+	}
+};
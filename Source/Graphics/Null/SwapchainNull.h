@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Graphics/ISwapchain.h"
+
+namespace crgfx
+{
+	// Swapchain with no window behind it. Images are plain textures that are handed out in order, and presenting
+	// only checks that the frame acquired the image and left it ready for presentation
+	class SwapchainNull final : public ISwapchain
+	{
+	public:
+
+		SwapchainNull(crgfx::IDevice* renderDevice, const crgfx::SwapchainDescriptor& swapchainDescriptor);
+
+		virtual crgfx::CrSwapchainResult AcquireNextImagePS(uint64_t timeoutNanoseconds = UINT64_MAX) override;
+
+		virtual void PresentPS() override;
+
+		virtual void ResizePS(uint32_t width, uint32_t height) override;
+
+	private:
+
+		void CreateSwapchainTextures();
+	};
+};
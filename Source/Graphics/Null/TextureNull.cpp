@@ -0,0 +1,68 @@
+#include "Graphics/CrRendering_pch.h"
+
+#include "TextureNull.h"
+
+#include "Graphics/IDevice.h"
+
+#include "Core/Logging/ICrDebug.h"
+
+namespace crgfx
+{
+	TextureNull::TextureNull(crgfx::IDevice* renderDevice, const crgfx::TextureDescriptor& descriptor)
+		: ITexture(renderDevice, descriptor)
+	{
+		CrAssertMsg(m_width > 0 && m_height > 0, "Texture %s has no size", descriptor.name ? descriptor.name : "");
+		CrAssertMsg(m_mipmapCount <= crgfx::MaxMipmaps, "Texture %s has too many mipmaps", descriptor.name ? descriptor.name : "");
+
+		// Textures are laid out like a DDS file, which is also how initial data comes in
+		for (uint32_t mip = 0; mip < m_mipmapCount; ++mip)
+		{
+			crgfx::MipmapLayout genericMipLayout = GetDDSMipSliceLayout(mip, 0);
+			crgfx::MipmapLayout& mipmapLayout = m_hardwareMipmapLayouts[mip];
+			mipmapLayout.rowPitchBytes = genericMipLayout.rowPitchBytes;
+			mipmapLayout.offsetBytes = genericMipLayout.offsetBytes;
+			mipmapLayout.heightInPixelsBlocks = genericMipLayout.heightInPixelsBlocks;
+		}
+
+		uint32_t sliceSizeBytes = GetDDSMipSliceLayout(m_mipmapCount, 0).offsetBytes;
+
+		m_slicePitchBytes = m_arraySize > 1 ? sliceSizeBytes : 0;
+
+		m_totalSizeBytes = sliceSizeBytes * m_arraySize;
+
+		m_usedGPUMemoryBytes = m_totalSizeBytes;
+
+		for (uint32_t mip = 0; mip < m_mipmapCount; ++mip)
+		{
+			m_trackedStates[mip] = m_defaultState;
+		}
+
+		if (descriptor.initialData)
+		{
+			CrAssertMsg(descriptor.initialDataSize == 0 || descriptor.initialDataSize <= m_totalSizeBytes, "Not enough memory in texture");
+
+			if (m_usage & crgfx::TextureUsage::Default)
+			{
+				uint8_t* textureData = m_renderDevice->BeginTextureUpload(this);
+				{
+					CopyIntoTextureMemory(textureData, descriptor.initialData, 0, m_mipmapCount, 0, m_arraySize);
+				}
+				m_renderDevice->EndTextureUpload(this);
+			}
+			else if (m_usage & crgfx::TextureUsage::CPUReadable)
+			{
+				CopyIntoTextureMemory(GetMemory(), descriptor.initialData, 0, m_mipmapCount, 0, m_arraySize);
+			}
+		}
+	}
+
+	uint8_t* TextureNull::GetMemory() const
+	{
+		if (m_memory.empty())
+		{
+			m_memory.resize(m_totalSizeBytes);
+		}
+
+		return m_memory.data();
+	}
+};
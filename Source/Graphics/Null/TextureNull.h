@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Graphics/ITexture.h"
+
+#include "crstl/array.h"
+#include "crstl/vector.h"
+
+namespace crgfx
+{
+	class TextureNull final : public ITexture
+	{
+	public:
+
+		TextureNull(crgfx::IDevice* renderDevice, const crgfx::TextureDescriptor& descriptor);
+
+		// Allocated on the first upload, as most textures are never read back on the CPU
+		uint8_t* GetMemory() const;
+
+		// Layout the last transition left a mip in. A layout of Undefined means it isn't known, because a transition
+		// only covered some of its slices or one of its planes, and nothing is validated against it
+		const crgfx::TextureState& GetTrackedState(uint32_t mip) const { return m_trackedStates[mip]; }
+
+		void SetTrackedState(uint32_t mip, const crgfx::TextureState& state) const { m_trackedStates[mip] = state; }
+
+	private:
+
+		uint32_t m_totalSizeBytes;
+
+		mutable crstl::vector<uint8_t> m_memory;
+
+		mutable crstl::array<crgfx::TextureState, crgfx::MaxMipmaps> m_trackedStates;
+	};
+};
@@ -8,9 +8,17 @@
 
 #include "Graphics/CrCPUStackAllocator.h"
 #include "Graphics/CrBuiltinPipelines.h"
+#include "Graphics/CrMaterial.h"
+#include "Graphics/CrStreamedTexture.h"
+
+#include "Core/CrFrameTime.h"
+
+#include "Math/CrMath.h"
 
 #include "crstl/sort.h"
 
+#include <float.h>
+
 #include "Core/Logging/ICrDebug.h"
 
 #define RENDER_WORLD_VALIDATION
@@ -163,6 +171,13 @@ void CrRenderWorld::ComputeVisibilityAndRenderPackets()
 {
 	m_visibleModelInstances.clear();
 
+	m_meshletCullingStatistics = CrMeshletCullingStatistics();
+
+	const uint64_t frameIndex = CrFrameTime::GetFrameIndex();
+
+	// Pixels a unit of distance covers on screen at a distance of 1
+	const float pixelsPerUnitDistance = m_camera->GetResolutionHeight() * m_camera->GetNearPlane() / m_camera->GetNearPlaneHeight();
+
 	for (CrModelInstanceIndex instanceIndex(0); instanceIndex < m_numModelInstances; ++instanceIndex)
 	{
 		const CrModelInstance& modelInstance = GetModelInstance(instanceIndex);
@@ -212,6 +227,9 @@ void CrRenderWorld::ComputeVisibilityAndRenderPackets()
 
 		bool computeMouseSelection = GetMouseSelectionEnabled();
 
+		// Largest scale of the transform, to take texture coordinate density from model to world space
+		float transformScale = sqrtf(CrMax(CrMax(dot(transform[0].xyz, transform[0].xyz), dot(transform[1].xyz, transform[1].xyz)), dot(transform[2].xyz, transform[2].xyz)));
+
 		for (uint32_t meshIndex = 0; meshIndex < meshCount; ++meshIndex)
 		{
 			const auto& meshMaterial       = renderModel->GetRenderMeshMaterial(meshIndex);
@@ -220,98 +238,133 @@ void CrRenderWorld::ComputeVisibilityAndRenderPackets()
 
 			const CrBoundingBox& meshBoundingBox = renderMesh->GetBoundingBox();
 
-			CrBoxVertices meshProjectedCorners;
-			CrVisibility::ComputeObbProjection(meshBoundingBox, transform, m_camera->GetWorld2ProjectionMatrix(), meshProjectedCorners);
+			// Meshes the model uses in several places are drawn once per instance transform. Each visible instance gets
+			// its own packet and the renderer batches them back together since they share mesh and material
+			const crstl::vector<float4x4>& instanceTransforms = renderMesh->GetInstanceTransforms();
+			uint32_t meshInstanceCount = instanceTransforms.empty() ? 1 : (uint32_t)instanceTransforms.size();
 
-			// Compute mesh visibility and don't render if outside frustum
-			if (!CrVisibility::AreProjectedPointsOnScreen(meshProjectedCorners))
+			bool needsMeshTransforms = !instanceTransforms.empty() || renderMesh->GetHasQuantizedPositions();
+
+			for (uint32_t meshInstanceIndex = 0; meshInstanceIndex < meshInstanceCount; ++meshInstanceIndex)
 			{
-				continue;
-			}
+				float4x4 instanceTransform = instanceTransforms.empty() ? transform : mul(instanceTransforms[meshInstanceIndex], transform);
 
-			float3 obbCenterWorld = mul(float4(meshBoundingBox.center, 1.0f), transform).xyz;
+				CrBoxVertices meshProjectedCorners;
+				CrVisibility::ComputeObbProjection(meshBoundingBox, instanceTransform, m_camera->GetWorld2ProjectionMatrix(), meshProjectedCorners);
 
-			float3 cameraToMesh = obbCenterWorld - m_camera->GetPosition();
+				// Compute mesh visibility and don't render if outside frustum
+				if (!CrVisibility::AreProjectedPointsOnScreen(meshProjectedCorners))
+				{
+					continue;
+				}
 
-			float squaredDistance = dot(cameraToMesh, cameraToMesh);
+				float3 obbCenterWorld = mul(float4(meshBoundingBox.center, 1.0f), instanceTransform).xyz;
 
-			uint32_t depthUint = *reinterpret_cast<uint32_t*>(&squaredDistance);
+				float3 cameraToMesh = obbCenterWorld - m_camera->GetPosition();
 
-			// TODO How to do fading?
-			// TODO How to do LOD selection?
+				float squaredDistance = dot(cameraToMesh, cameraToMesh);
 
-			CrRenderPacket mainPacket;
-			mainPacket.transforms   = transforms;
-			mainPacket.renderMesh   = renderMesh;
-			mainPacket.material     = material;
-			mainPacket.numInstances = 1;
-			mainPacket.extra        = nullptr;
+				uint32_t depthUint = *reinterpret_cast<uint32_t*>(&squaredDistance);
 
-			const crgfx::IGraphicsPipeline* transparencyPipeline = renderModel->GetPipeline(meshIndex, CrMaterialPipelineVariant::Transparency).get();
-			const crgfx::IGraphicsPipeline* gBufferPipeline      = renderModel->GetPipeline(meshIndex, CrMaterialPipelineVariant::GBuffer).get();
-			const crgfx::IGraphicsPipeline* debugPipeline        = renderModel->GetPipeline(meshIndex, CrMaterialPipelineVariant::Debug).get();
+				RequestTextureResolution(material, renderMesh, sqrtf(squaredDistance), length(meshBoundingBox.extents) * transformScale, transformScale, pixelsPerUnitDistance, frameIndex);
 
-			// The default rendering for everything is opaque. However, the shading model or options in the material
-			// can make a material go down the transparency path instead. It doesn't make sense to render the same mesh
-			// as both opaque and transparent though
-			if (gBufferPipeline)
-			{
-				mainPacket.pipeline = gBufferPipeline;
-				mainPacket.sortKey = CreateStandardSortKey(depthUint, mainPacket.pipeline, renderMesh, material);
-				m_renderLists[CrRenderListUsage::GBuffer].AddPacket(mainPacket);
-			}
-			else if (transparencyPipeline)
-			{
-				// Create render packets and add to the render lists
-				mainPacket.pipeline = transparencyPipeline;
-				mainPacket.sortKey = CreateTransparencySortKey(depthUint, mainPacket.pipeline, renderMesh, material);
-				m_renderLists[CrRenderListUsage::Transparency].AddPacket(mainPacket);
-			}
+				if (m_meshletCullingEnabled)
+				{
+					const crstl::vector<CrMeshlet>& meshlets = renderMesh->GetMeshlets();
+
+					m_visibleMeshlets.clear();
+					CrMeshletCuller::Cull
+					(
+						meshlets.data(), (uint32_t)meshlets.size(), instanceTransform, m_camera->GetWorld2ProjectionMatrix(),
+						m_camera->GetPosition(), renderMesh->GetIsDoubleSided(), m_visibleMeshlets, m_meshletCullingStatistics
+					);
+				}
 
-#if defined(CR_EDITOR)
+				// Instances and quantized positions need a transform of their own. Quantized positions go back to mesh space first
+				float4x4* meshTransforms = transforms;
 
-			if (computeMouseSelection)
-			{
-				// Compute bounding box in pixel space and check whether the mouse cursor is inside it
-				// If it is, add to the mouse selection list. This can cause slowdowns during rendering
-				// Speeding it up can also have the added benefit that we could continously do this process
-				const float4 uvScale = float4(0.5f, -0.5f, 0.0f, 0.0f);
-				const float4 uvBias = float4(0.5f, 0.5f, 0.0f, 0.0f);
-				float4 uvPositionMin( 1000.0f);
-				float4 uvPositionMax(-1000.0f);
-
-				for (uint32_t i = 0; i < meshProjectedCorners.size(); ++i)
+				if (needsMeshTransforms)
 				{
-					float4 screenPosition = meshProjectedCorners[i] / meshProjectedCorners[i].wwww;
-					float4 uvPosition = screenPosition * uvScale + uvBias;
-					uvPositionMin = min(uvPositionMin, uvPosition);
-					uvPositionMax = max(uvPositionMax, uvPosition);
+					meshTransforms = m_renderingStream->Allocate<float4x4>(1).memory;
+					meshTransforms[0] = renderMesh->GetHasQuantizedPositions() ? mul(renderMesh->GetPositionDequantization(), instanceTransform) : instanceTransform;
 				}
 
-				float4 resolution = float4(m_camera->GetResolutionWidth(), m_camera->GetResolutionHeight(), 1.0f, 1.0f);
-				float4 pixelPositionMin = uvPositionMin * resolution;
-				float4 pixelPositionMax = uvPositionMax * resolution;
+				// TODO How to do fading?
+				// TODO How to do LOD selection?
+
+				CrRenderPacket mainPacket;
+				mainPacket.transforms   = meshTransforms;
+				mainPacket.renderMesh   = renderMesh;
+				mainPacket.material     = material;
+				mainPacket.numInstances = 1;
+				mainPacket.extra        = nullptr;
+
+				const crgfx::IGraphicsPipeline* transparencyPipeline = renderModel->GetPipeline(meshIndex, CrMaterialPipelineVariant::Transparency).get();
+				const crgfx::IGraphicsPipeline* gBufferPipeline      = renderModel->GetPipeline(meshIndex, CrMaterialPipelineVariant::GBuffer).get();
+				const crgfx::IGraphicsPipeline* debugPipeline        = renderModel->GetPipeline(meshIndex, CrMaterialPipelineVariant::Debug).get();
 
-				if (m_mouseSelectionBoundingRectangle.x >= pixelPositionMin.x &&
-					m_mouseSelectionBoundingRectangle.x <= pixelPositionMax.x &&
-					m_mouseSelectionBoundingRectangle.y >= pixelPositionMin.y &&
-					m_mouseSelectionBoundingRectangle.y <= pixelPositionMax.y)
+				// The default rendering for everything is opaque. However, the shading model or options in the material
+				// can make a material go down the transparency path instead. It doesn't make sense to render the same mesh
+				// as both opaque and transparent though
+				if (gBufferPipeline)
 				{
-					mainPacket.pipeline = debugPipeline;
+					mainPacket.pipeline = gBufferPipeline;
 					mainPacket.sortKey = CreateStandardSortKey(depthUint, mainPacket.pipeline, renderMesh, material);
-					mainPacket.extra = (void*)(uintptr_t)entityID.instanceID;
-					m_renderLists[CrRenderListUsage::MouseSelection].AddPacket(mainPacket);
+					m_renderLists[CrRenderListUsage::GBuffer].AddPacket(mainPacket);
+				}
+				else if (transparencyPipeline)
+				{
+					// Create render packets and add to the render lists
+					mainPacket.pipeline = transparencyPipeline;
+					mainPacket.sortKey = CreateTransparencySortKey(depthUint, mainPacket.pipeline, renderMesh, material);
+					m_renderLists[CrRenderListUsage::Transparency].AddPacket(mainPacket);
 				}
-			}
 
-			if (isEditorEdgeHighlight)
-			{
-				mainPacket.pipeline = debugPipeline;
-				mainPacket.sortKey = CreateStandardSortKey(depthUint, mainPacket.pipeline, renderMesh, material);
-				m_renderLists[CrRenderListUsage::EdgeSelection].AddPacket(mainPacket);
-			}
+#if defined(CR_EDITOR)
+
+				if (computeMouseSelection)
+				{
+					// Compute bounding box in pixel space and check whether the mouse cursor is inside it
+					// If it is, add to the mouse selection list. This can cause slowdowns during rendering
+					// Speeding it up can also have the added benefit that we could continously do this process
+					const float4 uvScale = float4(0.5f, -0.5f, 0.0f, 0.0f);
+					const float4 uvBias = float4(0.5f, 0.5f, 0.0f, 0.0f);
+					float4 uvPositionMin( 1000.0f);
+					float4 uvPositionMax(-1000.0f);
+
+					for (uint32_t i = 0; i < meshProjectedCorners.size(); ++i)
+					{
+						float4 screenPosition = meshProjectedCorners[i] / meshProjectedCorners[i].wwww;
+						float4 uvPosition = screenPosition * uvScale + uvBias;
+						uvPositionMin = min(uvPositionMin, uvPosition);
+						uvPositionMax = max(uvPositionMax, uvPosition);
+					}
+
+					float4 resolution = float4(m_camera->GetResolutionWidth(), m_camera->GetResolutionHeight(), 1.0f, 1.0f);
+					float4 pixelPositionMin = uvPositionMin * resolution;
+					float4 pixelPositionMax = uvPositionMax * resolution;
+
+					if (m_mouseSelectionBoundingRectangle.x >= pixelPositionMin.x &&
+						m_mouseSelectionBoundingRectangle.x <= pixelPositionMax.x &&
+						m_mouseSelectionBoundingRectangle.y >= pixelPositionMin.y &&
+						m_mouseSelectionBoundingRectangle.y <= pixelPositionMax.y)
+					{
+						mainPacket.pipeline = debugPipeline;
+						mainPacket.sortKey = CreateStandardSortKey(depthUint, mainPacket.pipeline, renderMesh, material);
+						mainPacket.extra = (void*)(uintptr_t)entityID.instanceID;
+						m_renderLists[CrRenderListUsage::MouseSelection].AddPacket(mainPacket);
+					}
+				}
+
+				if (isEditorEdgeHighlight)
+				{
+					mainPacket.pipeline = debugPipeline;
+					mainPacket.sortKey = CreateStandardSortKey(depthUint, mainPacket.pipeline, renderMesh, material);
+					m_renderLists[CrRenderListUsage::EdgeSelection].AddPacket(mainPacket);
+				}
 
 #endif
+			}
 		}
 	}
 
@@ -322,6 +375,32 @@ void CrRenderWorld::ComputeVisibilityAndRenderPackets()
 	}
 }
 
+void CrRenderWorld::RequestTextureResolution
+(
+	const CrMaterial* material, const CrRenderMesh* renderMesh, float distance, float radius, float transformScale,
+	float pixelsPerUnitDistance, uint64_t frameIndex
+)
+{
+	// Unknown density requests the full texture, which is what it would have without streaming
+	float resolution = FLT_MAX;
+
+	if (renderMesh->GetUVDensity() > 0.0f)
+	{
+		// The closest part of the mesh needs the most detail. Inside the bounds we're as close as the near plane
+		float closestDistance = CrMax(distance - radius, m_camera->GetNearPlane());
+		float pixelsPerUnitModel = pixelsPerUnitDistance * transformScale / closestDistance;
+		resolution = pixelsPerUnitModel / renderMesh->GetUVDensity();
+	}
+
+	for (const CrMaterial::TextureBinding& binding : material->m_textures)
+	{
+		if (binding.streamedTexture)
+		{
+			binding.streamedTexture->RequestResolution(resolution, frameIndex);
+		}
+	}
+}
+
 void CrRenderWorld::BeginRendering(const crstl::intrusive_ptr<CrCPUStackAllocator>& renderingStream)
 {
 	m_renderingStream = renderingStream;
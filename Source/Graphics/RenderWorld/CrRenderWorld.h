@@ -7,6 +7,7 @@
 #include "Graphics/CrGraphicsForwardDeclarations.h"
 #include "Graphics/CrRenderModel.h"
 #include "Graphics/CrLight.h"
+#include "Graphics/CrMeshlet.h"
 #include "Graphics/RenderWorld/CrModelInstance.h"
 
 #include "Math/CrHlslppMatrixFloatType.h"
@@ -132,6 +133,7 @@ public:
 		}
 	}
 
+	// Also requests the resolution streamed textures need for the visible meshes
 	void ComputeVisibilityAndRenderPackets();
 
 	// Traverse visible model instances
@@ -149,6 +151,15 @@ public:
 
 	void EndRendering();
 
+	// Runs the CPU meshlet culler on every visible mesh to measure how much cluster culling would remove. It doesn't
+	// change what is drawn
+	void SetMeshletCullingEnabled(bool enable) { m_meshletCullingEnabled = enable; }
+
+	bool GetMeshletCullingEnabled() const { return m_meshletCullingEnabled; }
+
+	// Results of the last visibility pass. Empty unless meshlet culling is enabled
+	const CrMeshletCullingStatistics& GetMeshletCullingStatistics() const { return m_meshletCullingStatistics; }
+
 private:
 
 	CrModelInstanceIndex GetModelInstanceIndex(CrModelInstanceID instanceId) const
@@ -157,6 +168,14 @@ private:
 	CrModelInstanceID GetModelInstanceId(CrModelInstanceIndex instanceIndex) const
 	{ return m_modelInstanceIndexToId[instanceIndex.id]; }
 
+	// Tells the streamed textures of the material how much detail the mesh needs from them, from the screen
+	// space density of its texture coordinates
+	void RequestTextureResolution
+	(
+		const CrMaterial* material, const CrRenderMesh* renderMesh, float distance, float radius, float transformScale,
+		float pixelsPerUnitDistance, uint64_t frameIndex
+	);
+
 	// Model Instance Data
 
 	crstl::vector<CrModelInstance>      m_modelInstances;
@@ -192,6 +211,13 @@ private:
 	// Visible model instances
 	crstl::vector<CrModelInstanceIndex> m_visibleModelInstances;
 
+	bool m_meshletCullingEnabled = false;
+
+	CrMeshletCullingStatistics m_meshletCullingStatistics;
+
+	// Meshlets of the mesh being culled that survive. Kept around to avoid allocating for every mesh
+	crstl::vector<uint32_t> m_visibleMeshlets;
+
 #if defined(CR_EDITOR)
 
 public:
@@ -3,10 +3,17 @@
 #include "CrShaderCompiler.h"
 #include "CrBuiltinShaderBuilder.h"
 #include "CrShaderCompilerUtilities.h"
+#include "CrShaderCompilerServer.h"
 
 #include "Core/Logging/ICrDebug.h"
 
+#include "Core/Threading/CrThreadPool.h"
+
 #include "crstl/filesystem.h"
+#include "crstl/sort.h"
+#include "crstl/timer.h"
+
+#include <stdio.h>
 
 // RapidYAML
 #define RYML_USE_ASSERT 0
@@ -20,7 +27,9 @@ void CrBuiltinShaderBuilder::ProcessBuiltinShaders(const CrBuiltinShadersDescrip
 	crstl::vector<CrShaderInfo> shaderInfos;
 
 	// Find every .shaders file in the specified directory
-	crstl::for_each_directory_entry(builtinShadersDescriptor.inputPath.c_str(), true, [&compilationJobs, &builtinShadersDescriptor, &shaderInfos](const crstl::directory_entry& entry)
+	crstl::vector<crstl::string> shadersFilePaths;
+
+	crstl::for_each_directory_entry(builtinShadersDescriptor.inputPath.c_str(), true, [&shadersFilePaths](const crstl::directory_entry& entry)
 	{
 		// TODO Replace extension with a path_view
 		CrFixedPath filename = entry.filename;
@@ -28,183 +37,273 @@ void CrBuiltinShaderBuilder::ProcessBuiltinShaders(const CrBuiltinShadersDescrip
 		if (filename.extension() == ".shaders")
 		{
 			CrFixedPath shadersFilePath = CrFixedPath(entry.directory) / entry.filename;
+			shadersFilePaths.push_back(shadersFilePath.c_str());
+		}
 
-			// Load .shaders file
-			crstl::file file = crstl::file(shadersFilePath.c_str(), crstl::file_flags::read);
+		return true;
+	});
 
-			// Read in data
-			crstl::string shadersFile;
-			shadersFile.resize(file.get_size());
-			file.read(shadersFile.data(), shadersFile.size());
+	// Directory iteration order depends on the file system. Sort the files so that the builtin shader
+	// enums and tables come out the same on every machine and WriteToFileIfChanged doesn't touch them
+	crstl::sort(shadersFilePaths.begin(), shadersFilePaths.end());
 
-			// Assume we have an hlsl file with the same name where the entry points defined in the .shaders file live
-			CrFixedPath hlslFilePath = shadersFilePath;
-			hlslFilePath.replace_extension(".hlsl");
+	for (const crstl::string& shadersFilePathString : shadersFilePaths)
+	{
+		CrFixedPath shadersFilePath = shadersFilePathString.c_str();
 
-			// Set the error callback to print out 
-			c4::yml::Callbacks callbacks;
-			callbacks.m_error = [](const char* msg, size_t /*msg_len*/, c4::yml::Location /*location*/, void* /*user_data*/)
-			{
-				CrLog(msg);
-			};
+		// Load .shaders file
+		crstl::file file = crstl::file(shadersFilePath.c_str(), crstl::file_flags::read);
 
-			c4::yml::set_callbacks(callbacks);
+		// Read in data
+		crstl::string shadersFile;
+		shadersFile.resize(file.get_size());
+		file.read(shadersFile.data(), shadersFile.size());
 
-			// Parse YAML
-			ryml::Tree tree = ryml::parse(ryml::substr(shadersFile.data(), shadersFile.size()));
-			ryml::NodeRef root = tree.rootref();
+		// Assume we have an hlsl file with the same name where the entry points defined in the .shaders file live
+		CrFixedPath hlslFilePath = shadersFilePath;
+		hlslFilePath.replace_extension(".hlsl");
 
-			// For every shader declared in the document, process the yaml and construct a compilation descriptor
-			// to process the appropriate shader
-			for (ryml::NodeRef shader : root.children())
-			{
-				const c4::csubstr& shaderKey = shader.key();
-				crstl::string shaderName(shaderKey.str, shaderKey.len);
+		// Set the error callback to print out 
+		c4::yml::Callbacks callbacks;
+		callbacks.m_error = [](const char* msg, size_t /*msg_len*/, c4::yml::Location /*location*/, void* /*user_data*/)
+		{
+			CrLog(msg);
+		};
 
-				if (shaderName.find(" ") != shaderName.npos)
-				{
-					crstl::string errorMessage;
-					errorMessage.append_sprintf("Invalid shader name %s. Did you miss a ':'? Make sure YAML syntax is followed", shaderName.c_str());
-					CrShaderCompilerUtilities::QuitWithMessage(errorMessage.c_str());
-				}
+		c4::yml::set_callbacks(callbacks);
 
-				crstl::string stageName;
+		// Parse YAML
+		ryml::Tree tree = ryml::parse(ryml::substr(shadersFile.data(), shadersFile.size()));
+		ryml::NodeRef root = tree.rootref();
 
-				CrShaderCompilationJob compilationJob;
-				CompilationDescriptor& compilationDescriptor = compilationJob.compilationDescriptor;
-				compilationDescriptor.inputPath = hlslFilePath;
-				compilationDescriptor.platform = builtinShadersDescriptor.platform;
+		// For every shader declared in the document, process the yaml and construct a compilation descriptor
+		// to process the appropriate shader
+		for (ryml::NodeRef shader : root.children())
+		{
+			const c4::csubstr& shaderKey = shader.key();
+			crstl::string shaderName(shaderKey.str, shaderKey.len);
 
-				crgfx::ShaderStage::T shaderStage = crgfx::ShaderStage::Count;
+			if (shaderName.find(" ") != shaderName.npos)
+			{
+				crstl::string errorMessage;
+				errorMessage.append_sprintf("Invalid shader name %s. Did you miss a ':'? Make sure YAML syntax is followed", shaderName.c_str());
+				CrShaderCompilerUtilities::QuitWithMessage(errorMessage.c_str());
+			}
 
-				ryml::NodeRef entryPointNode = shader["entrypoint"];
-				if (entryPointNode.is_keyval())
-				{
-					c4::csubstr entryPointValue = entryPointNode.val();
-					compilationDescriptor.entryPoint = crstl::string(entryPointValue.str, entryPointValue.len);
-				}
-				else
-				{
-					continue;
-				}
+			crstl::string stageName;
 
-				ryml::NodeRef stageNode = shader["stage"];
-				if (stageNode.is_keyval())
-				{
-					c4::csubstr stageValue = stageNode.val();
-					if (stageValue == "Vertex")        { shaderStage = crgfx::ShaderStage::Vertex; }
-					else if (stageValue == "Pixel")    { shaderStage = crgfx::ShaderStage::Pixel; }
-					else if (stageValue == "Geometry") { shaderStage = crgfx::ShaderStage::Geometry; }
-					else if (stageValue == "Hull")     { shaderStage = crgfx::ShaderStage::Hull; }
-					else if (stageValue == "Domain")   { shaderStage = crgfx::ShaderStage::Domain; }
-					else if (stageValue == "Compute")  { shaderStage = crgfx::ShaderStage::Compute; }
-					else if (stageValue == "RootSignature") { shaderStage = crgfx::ShaderStage::RootSignature; }
-					else
-					{
-						crstl::string errorMessage;
-						crstl::string invalidStageString(stageValue.str, stageValue.len);
-						errorMessage.append_sprintf("Invalid shader stage '%s' in shader %s. Remember that stage must be upper case", invalidStageString.c_str(), shaderName.c_str());
-						CrShaderCompilerUtilities::QuitWithMessage(errorMessage.c_str());
-					}
+			CrShaderCompilationJob compilationJob;
+			CompilationDescriptor& compilationDescriptor = compilationJob.compilationDescriptor;
+			compilationDescriptor.inputPath = hlslFilePath;
+			compilationDescriptor.platform = builtinShadersDescriptor.platform;
 
-					compilationDescriptor.shaderStage = shaderStage;
+			crgfx::ShaderStage::T shaderStage = crgfx::ShaderStage::Count;
 
-					stageName = crgfx::ShaderStage::ToString(shaderStage);
-				}
+			ryml::NodeRef entryPointNode = shader["entrypoint"];
+			if (entryPointNode.is_keyval())
+			{
+				c4::csubstr entryPointValue = entryPointNode.val();
+				compilationDescriptor.entryPoint = crstl::string(entryPointValue.str, entryPointValue.len);
+			}
+			else
+			{
+				continue;
+			}
+
+			ryml::NodeRef stageNode = shader["stage"];
+			if (stageNode.is_keyval())
+			{
+				c4::csubstr stageValue = stageNode.val();
+				if (stageValue == "Vertex")        { shaderStage = crgfx::ShaderStage::Vertex; }
+				else if (stageValue == "Pixel")    { shaderStage = crgfx::ShaderStage::Pixel; }
+				else if (stageValue == "Geometry") { shaderStage = crgfx::ShaderStage::Geometry; }
+				else if (stageValue == "Hull")     { shaderStage = crgfx::ShaderStage::Hull; }
+				else if (stageValue == "Domain")   { shaderStage = crgfx::ShaderStage::Domain; }
+				else if (stageValue == "Compute")  { shaderStage = crgfx::ShaderStage::Compute; }
+				else if (stageValue == "RootSignature") { shaderStage = crgfx::ShaderStage::RootSignature; }
 				else
 				{
-					continue;
+					crstl::string errorMessage;
+					crstl::string invalidStageString(stageValue.str, stageValue.len);
+					errorMessage.append_sprintf("Invalid shader stage '%s' in shader %s. Remember that stage must be upper case", invalidStageString.c_str(), shaderName.c_str());
+					CrShaderCompilerUtilities::QuitWithMessage(errorMessage.c_str());
 				}
 
-				ryml::NodeRef definesNode = shader["defines"];
-				if (definesNode.is_keyval())
+				compilationDescriptor.shaderStage = shaderStage;
+
+				stageName = crgfx::ShaderStage::ToString(shaderStage);
+			}
+			else
+			{
+				continue;
+			}
+
+			ryml::NodeRef definesNode = shader["defines"];
+			if (definesNode.is_keyval())
+			{
+				const c4::csubstr& defineValue = definesNode.val();
+				compilationDescriptor.defines.push_back(crstl::string(defineValue.str, defineValue.len));
+			}
+			else if (definesNode.is_seq())
+			{
+				for (const ryml::NodeRef& defineNode : definesNode.children())
 				{
-					const c4::csubstr& defineValue = definesNode.val();
+					c4::csubstr defineValue = defineNode.val();
 					compilationDescriptor.defines.push_back(crstl::string(defineValue.str, defineValue.len));
 				}
-				else if (definesNode.is_seq())
-				{
-					for (const ryml::NodeRef& defineNode : definesNode.children())
-					{
-						c4::csubstr defineValue = defineNode.val();
-						compilationDescriptor.defines.push_back(crstl::string(defineValue.str, defineValue.len));
-					}
-				}
-				else
-				{
-					// This is a valid case, there are just no defines present
-				}
+			}
+			else
+			{
+				// This is a valid case, there are just no defines present
+			}
 
-				CrShaderInfo shaderInfo;
-				shaderInfo.name = shaderName;
-				shaderInfo.pipelineType = shaderStage == crgfx::ShaderStage::Compute ? CrPipelineType::Compute : CrPipelineType::Graphics;
-				shaderInfos.push_back(shaderInfo);
-				compilationJob.name = shaderName;
+			CrShaderInfo shaderInfo;
+			shaderInfo.name = shaderName;
+			shaderInfo.pipelineType = shaderStage == crgfx::ShaderStage::Compute ? CrPipelineType::Compute : CrPipelineType::Graphics;
+			shaderInfos.push_back(shaderInfo);
+			compilationJob.name = shaderName;
 
-				for(uint32_t i = 0; i < builtinShadersDescriptor.graphicsApis.size(); ++i)
-				{
-					crgfx::GraphicsApi::T graphicsApi = builtinShadersDescriptor.graphicsApis[i];
-					
-					const char* shaderBinaryExtension = ".bin";
-
-					crstl::string uniqueShaderName =
-						shaderName + "_" + 
-						compilationDescriptor.entryPoint + "_" + 
-						stageName + "_" + 
-						crgfx::GraphicsApi::ToString(graphicsApi);
-
-					CrFixedPath binaryFilePath = builtinShadersDescriptor.outputPath;
-					binaryFilePath /= uniqueShaderName.c_str();
-					binaryFilePath.replace_extension(shaderBinaryExtension);
-
-					CrFixedPath tempPath = builtinShadersDescriptor.outputPath;
-					tempPath /= uniqueShaderName.c_str();
-					tempPath.replace_extension(".temp");
-
-					compilationDescriptor.uniqueBinaryName = uniqueShaderName + shaderBinaryExtension;
-					compilationDescriptor.outputPath = binaryFilePath;
-					compilationDescriptor.tempPath = tempPath;
-					compilationDescriptor.graphicsApi = graphicsApi;
-
-					compilationJobs[i].push_back(compilationJob);
-				}
+			for(uint32_t i = 0; i < builtinShadersDescriptor.graphicsApis.size(); ++i)
+			{
+				crgfx::GraphicsApi::T graphicsApi = builtinShadersDescriptor.graphicsApis[i];
+				
+				const char* shaderBinaryExtension = ".bin";
+
+				crstl::string uniqueShaderName =
+					shaderName + "_" + 
+					compilationDescriptor.entryPoint + "_" + 
+					stageName + "_" + 
+					crgfx::GraphicsApi::ToString(graphicsApi);
+
+				CrFixedPath binaryFilePath = builtinShadersDescriptor.outputPath;
+				binaryFilePath /= uniqueShaderName.c_str();
+				binaryFilePath.replace_extension(shaderBinaryExtension);
+
+				CrFixedPath tempPath = builtinShadersDescriptor.outputPath;
+				tempPath /= uniqueShaderName.c_str();
+				tempPath.replace_extension(".temp");
+
+				compilationDescriptor.uniqueBinaryName = uniqueShaderName + shaderBinaryExtension;
+				compilationDescriptor.outputPath = binaryFilePath;
+				compilationDescriptor.tempPath = tempPath;
+				compilationDescriptor.graphicsApi = graphicsApi;
+
+				compilationJobs[i].push_back(compilationJob);
 			}
 		}
+	}
 
-		return true;
-	});
+	ExecuteCompilationJobs(builtinShadersDescriptor, compilationJobs);
+
+	if (builtinShadersDescriptor.buildBuiltinHeaders)
+	{
+		// Once all compilation jobs are finished and successful, build binary and metadata from them
+		BuildBuiltinShaderMetadataAndHeaderFiles(builtinShadersDescriptor, shaderInfos, compilationJobs);
+	}
+}
+
+void CrBuiltinShaderBuilder::ExecuteCompilationJobs
+(
+	const CrBuiltinShadersDescriptor& builtinShadersDescriptor,
+	const crstl::vector<crstl::vector<CrShaderCompilationJob>>& compilationJobs
+)
+{
+	// Flatten the jobs so that each one has a fixed slot for its result. Jobs can finish in any order
+	// but we report them in the order they were declared, so the output is the same on every run
+	crstl::vector<const CrShaderCompilationJob*> flattenedJobs;
 
-	// Execute all compilation jobs.
-	// TODO This part can be multithreaded very easily
 	for (const auto& graphicsApiCompilationJobs : compilationJobs)
 	{
 		for (const CrShaderCompilationJob& compilationJob : graphicsApiCompilationJobs)
 		{
-			const CompilationDescriptor& compilationDescriptor = compilationJob.compilationDescriptor;
+			flattenedJobs.push_back(&compilationJob);
+		}
+	}
+
+	crstl::vector<CrShaderCompilationResult> compilationResults;
+	compilationResults.resize(flattenedJobs.size());
+
+	uint32_t maxConcurrentJobs = builtinShadersDescriptor.maxConcurrentJobs;
+
+	if (maxConcurrentJobs == 0)
+	{
+		maxConcurrentJobs = CrThreadPool::GetHardwareThreadCount();
+	}
+
+	// No point in creating more threads than there are jobs
+	if (maxConcurrentJobs > flattenedJobs.size())
+	{
+		maxConcurrentJobs = flattenedJobs.size() > 0 ? (uint32_t)flattenedJobs.size() : 1;
+	}
+
+	crstl::timer totalCompilationTime;
+
+	{
+		CrThreadPool threadPool(maxConcurrentJobs);
+
+		// Every job writes to its own output and temp files and only touches its own result,
+		// so they don't need any synchronization between them
+		threadPool.ParallelFor((uint32_t)flattenedJobs.size(), [&flattenedJobs, &compilationResults, &builtinShadersDescriptor](uint32_t jobIndex)
+		{
+			const CompilationDescriptor& compilationDescriptor = flattenedJobs[jobIndex]->compilationDescriptor;
+			CrShaderCompilationResult& compilationResult = compilationResults[jobIndex];
 
 			// Add conditions here under which a job cannot be compiled. We still need to process it to add the entry
 			// to the builtin shader table. This means e.g. the Vulkan backend has a dummy entry for a root signature
 			// This generally only happens on Desktop, where we support multiple APIs
-			bool excludeCompilationJob =
+			compilationResult.excluded =
 				compilationDescriptor.shaderStage == crgfx::ShaderStage::RootSignature && compilationDescriptor.graphicsApi != crgfx::GraphicsApi::D3D12;
 
-			if (!excludeCompilationJob)
+			if (!compilationResult.excluded)
 			{
-				crstl::string compilationStatus;
-				bool success = CrShaderCompiler::Compile(compilationDescriptor, compilationStatus);
+				crstl::timer compilationTime;
+
+				bool compiled = false;
 
-				if (!success)
+				if (!builtinShadersDescriptor.serverName.empty())
 				{
-					CrShaderCompilerUtilities::QuitWithMessage(compilationStatus.c_str());
+					CrShaderCompilerClient shaderCompilerClient;
+
+					if (shaderCompilerClient.Connect(builtinShadersDescriptor.serverName.c_str()))
+					{
+						compilationResult.success = shaderCompilerClient.CompileToFile(compilationDescriptor, compilationResult.compilationStatus, &compilationResult.cacheHit);
+
+						// If we lost the connection the shader didn't compile, compile it ourselves
+						compiled = shaderCompilerClient.IsConnected();
+					}
 				}
+
+				if (!compiled)
+				{
+					compilationResult.success = CrShaderCompiler::Compile(compilationDescriptor, compilationResult.compilationStatus);
+				}
+
+				compilationResult.compilationTimeMs = (float)compilationTime.elapsed().milliseconds();
 			}
+		});
+	}
+
+	for (uint32_t jobIndex = 0; jobIndex < flattenedJobs.size(); ++jobIndex)
+	{
+		const CompilationDescriptor& compilationDescriptor = flattenedJobs[jobIndex]->compilationDescriptor;
+		const CrShaderCompilationResult& compilationResult = compilationResults[jobIndex];
+
+		if (!compilationResult.excluded)
+		{
+			printf("%s %s (%.2f ms%s)\n", compilationResult.success ? "Compiled" : "Failed", compilationDescriptor.uniqueBinaryName.c_str(),
+				compilationResult.compilationTimeMs, compilationResult.cacheHit ? ", server cache" : "");
 		}
 	}
-	
-	if (builtinShadersDescriptor.buildBuiltinHeaders)
+
+	printf("Compiled %u builtin shaders using %u threads (%.2f ms)\n", (uint32_t)flattenedJobs.size(), maxConcurrentJobs, (float)totalCompilationTime.elapsed().milliseconds());
+
+	// Report the first failure in declaration order, not the first one to finish
+	for (const CrShaderCompilationResult& compilationResult : compilationResults)
 	{
-		// Once all compilation jobs are finished and successful, build binary and metadata from them
-		BuildBuiltinShaderMetadataAndHeaderFiles(builtinShadersDescriptor, shaderInfos, compilationJobs);
+		if (!compilationResult.excluded && !compilationResult.success)
+		{
+			CrShaderCompilerUtilities::QuitWithMessage(compilationResult.compilationStatus.c_str());
+		}
 	}
 }
 
@@ -257,12 +356,14 @@ void CrBuiltinShaderBuilder::BuildBuiltinShaderMetadataAndHeaderFiles
 
 	builtinShadersGenericHeader += "struct CrBuiltinShaderMetadata\n"
 		"{\n"
-		"\tCrBuiltinShaderMetadata(const crstl::string& name, const crstl::string& entryPoint, const crstl::string& uniqueBinaryName, crgfx::ShaderStage::T shaderStage, uint8_t* shaderCode, uint32_t shaderCodeSize)\n"
-		"\t: name(name), entryPoint(entryPoint), uniqueBinaryName(uniqueBinaryName), shaderStage(shaderStage), shaderCode(shaderCode), shaderCodeSize(shaderCodeSize) {}\n\n"
-		"\tCrBuiltinShaderMetadata() : CrBuiltinShaderMetadata(\"\", \"\", \"\", crgfx::ShaderStage::Count, nullptr, 0) {}\n\n"
+		"\tCrBuiltinShaderMetadata(const crstl::string& name, const crstl::string& entryPoint, const crstl::string& uniqueBinaryName, const crstl::string& sourceFile, const crstl::string& defines, crgfx::ShaderStage::T shaderStage, uint8_t* shaderCode, uint32_t shaderCodeSize)\n"
+		"\t: name(name), entryPoint(entryPoint), uniqueBinaryName(uniqueBinaryName), sourceFile(sourceFile), defines(defines), shaderStage(shaderStage), shaderCode(shaderCode), shaderCodeSize(shaderCodeSize) {}\n\n"
+		"\tCrBuiltinShaderMetadata() : CrBuiltinShaderMetadata(\"\", \"\", \"\", \"\", \"\", crgfx::ShaderStage::Count, nullptr, 0) {}\n\n"
 		"\tcrstl::string name;\n"
 		"\tcrstl::string entryPoint;\n"
 		"\tcrstl::string uniqueBinaryName;\n"
+		"\tcrstl::string sourceFile; // Filename of the source, to recompile it when it changes\n"
+		"\tcrstl::string defines; // Separated by semicolons\n"
 		"\tcrgfx::ShaderStage::T shaderStage;\n"
 		"\tuint8_t* shaderCode;\n"
 		"\tuint32_t shaderCodeSize;\n"
@@ -270,12 +371,14 @@ void CrBuiltinShaderBuilder::BuildBuiltinShaderMetadataAndHeaderFiles
 
 	builtinShadersGenericHeader += "struct CrBuiltinComputeMetadata\n"
 	"{\n"
-		"\tCrBuiltinComputeMetadata(const crstl::string& name, const crstl::string& entryPoint, const crstl::string& uniqueBinaryName, uint8_t* shaderCode, uint32_t shaderCodeSize)\n"
-		"\t: name(name), entryPoint(entryPoint), uniqueBinaryName(uniqueBinaryName), shaderCode(shaderCode), shaderCodeSize(shaderCodeSize) {}\n\n"
-		"\tCrBuiltinComputeMetadata() : CrBuiltinComputeMetadata(\"\", \"\", \"\", nullptr, 0) {}\n\n"
+		"\tCrBuiltinComputeMetadata(const crstl::string& name, const crstl::string& entryPoint, const crstl::string& uniqueBinaryName, const crstl::string& sourceFile, const crstl::string& defines, uint8_t* shaderCode, uint32_t shaderCodeSize)\n"
+		"\t: name(name), entryPoint(entryPoint), uniqueBinaryName(uniqueBinaryName), sourceFile(sourceFile), defines(defines), shaderCode(shaderCode), shaderCodeSize(shaderCodeSize) {}\n\n"
+		"\tCrBuiltinComputeMetadata() : CrBuiltinComputeMetadata(\"\", \"\", \"\", \"\", \"\", nullptr, 0) {}\n\n"
 		"\tcrstl::string name;\n"
 		"\tcrstl::string entryPoint;\n"
 		"\tcrstl::string uniqueBinaryName;\n"
+		"\tcrstl::string sourceFile; // Filename of the source, to recompile it when it changes\n"
+		"\tcrstl::string defines; // Separated by semicolons\n"
 		"\tuint8_t* shaderCode;\n"
 		"\tuint32_t shaderCodeSize;\n"
 	"};\n\n";
@@ -292,11 +395,14 @@ void CrBuiltinShaderBuilder::BuildBuiltinShaderMetadataAndHeaderFiles
 	builtinShadersGenericCpp += "#include \"Graphics/CrRendering_pch.h\"\n";
 	builtinShadersGenericCpp += "\n";
 
-	for(crgfx::GraphicsApi::T graphicsApi : builtinShadersDescriptor.graphicsApis)
+	for (uint32_t apiIndex = 0; apiIndex < builtinShadersDescriptor.graphicsApis.size(); ++apiIndex)
 	{
+		crgfx::GraphicsApi::T graphicsApi = builtinShadersDescriptor.graphicsApis[apiIndex];
+
 		const char* graphicsApiString = crgfx::GraphicsApi::ToString(graphicsApi);
 
-		const crstl::vector<CrShaderCompilationJob>& graphicsApiCompilationJobs = compilationJobs[graphicsApi];
+		// Jobs are stored in the same order as the requested graphics APIs
+		const crstl::vector<CrShaderCompilationJob>& graphicsApiCompilationJobs = compilationJobs[apiIndex];
 
 		builtinShadersGenericHeaderGetFunction += "\t\tif(graphicsApi == crgfx::GraphicsApi::";
 		builtinShadersGenericHeaderGetFunction += graphicsApiString;
@@ -325,6 +431,19 @@ void CrBuiltinShaderBuilder::BuildBuiltinShaderMetadataAndHeaderFiles
 			const crstl::string& shaderName = shaderJob.name;
 			const CompilationDescriptor& compilationDescriptor = shaderJob.compilationDescriptor;
 
+			// Source and defines let the runtime recompile the shader when its source changes
+			crstl::string sourceAndDefines = "\"";
+			sourceAndDefines += compilationDescriptor.inputPath.filename().c_str();
+			sourceAndDefines += "\", \"";
+
+			for (uint32_t i = 0; i < compilationDescriptor.defines.size(); ++i)
+			{
+				sourceAndDefines += i > 0 ? ";" : "";
+				sourceAndDefines += compilationDescriptor.defines[i];
+			}
+
+			sourceAndDefines += "\", ";
+
 			// Load binary file
 			crstl::string shaderStageString = "crgfx::ShaderStage::";
 			shaderStageString += crgfx::ShaderStage::ToString(compilationDescriptor.shaderStage);
@@ -359,7 +478,7 @@ void CrBuiltinShaderBuilder::BuildBuiltinShaderMetadataAndHeaderFiles
 					builtinComputeDataCpp += shaderBinaryName + " =\n\t\t{";
 					builtinComputeMetadataTable +=
 						"\t\t\tCrBuiltinComputeMetadata(\"" + shaderName + "\", \"" + compilationDescriptor.entryPoint + "\", \"" + compilationDescriptor.uniqueBinaryName + "\", " +
-						shaderName + "ShaderCode, " + crstl::string(codeSize) + "),\n";
+						sourceAndDefines + shaderName + "ShaderCode, " + crstl::string(codeSize) + "),\n";
 
 					CopyBytecodeData(builtinComputeDataCpp);
 
@@ -370,7 +489,7 @@ void CrBuiltinShaderBuilder::BuildBuiltinShaderMetadataAndHeaderFiles
 					builtinShaderDataCpp += shaderBinaryName + " =\n\t\t{";
 					builtinShadersMetadataTable +=
 						"\t\t\tCrBuiltinShaderMetadata(\"" + shaderName + "\", \"" + compilationDescriptor.entryPoint + "\", \"" + compilationDescriptor.uniqueBinaryName + "\", " +
-						shaderStageString.c_str() + ", " + shaderName + "ShaderCode, " + crstl::string(codeSize) + "),\n";
+						sourceAndDefines + shaderStageString.c_str() + ", " + shaderName + "ShaderCode, " + crstl::string(codeSize) + "),\n";
 
 					CopyBytecodeData(builtinShaderDataCpp);
 
@@ -381,12 +500,12 @@ void CrBuiltinShaderBuilder::BuildBuiltinShaderMetadataAndHeaderFiles
 			{
 				if (compilationDescriptor.shaderStage == crgfx::ShaderStage::Compute)
 				{
-					builtinComputeMetadataTable += "\t\t\tCrBuiltinComputeMetadata(\"" + shaderName + "\", \"\", \"" + compilationDescriptor.uniqueBinaryName + "\", nullptr, " + crstl::string(0) + "), \n";
+					builtinComputeMetadataTable += "\t\t\tCrBuiltinComputeMetadata(\"" + shaderName + "\", \"\", \"" + compilationDescriptor.uniqueBinaryName + "\", " + sourceAndDefines + "nullptr, " + crstl::string(0) + "), \n";
 				}
 				else
 				{
 					builtinShadersMetadataTable += "\t\t\tCrBuiltinShaderMetadata(\"" + shaderName + "\", \"\", \"" + compilationDescriptor.uniqueBinaryName + "\", " + 
-						shaderStageString.c_str() + ", nullptr, " + crstl::string(0) + "), \n";
+						sourceAndDefines + shaderStageString.c_str() + ", nullptr, " + crstl::string(0) + "), \n";
 				}
 			}
 		}
@@ -20,6 +20,13 @@ struct CrBuiltinShadersDescriptor
 	// Whether to build the headers from the binaries by creating headers and cpp files
 	// This is useful as part of the main build, but not when live recompiling
 	bool buildBuiltinHeaders;
+
+	// Maximum number of shaders compiled at the same time. 0 uses every hardware thread
+	uint32_t maxConcurrentJobs = 0;
+
+	// If not empty, shaders are compiled through the shader compiler server with this name. We fall back
+	// to compiling here if the server can't be reached
+	crstl::string serverName;
 };
 
 struct CompilationDescriptor;
@@ -45,6 +52,19 @@ struct CrShaderCompilationJob
 	CompilationDescriptor compilationDescriptor;
 };
 
+struct CrShaderCompilationResult
+{
+	crstl::string compilationStatus;
+
+	float compilationTimeMs = 0.0f;
+
+	bool excluded = false;
+
+	bool cacheHit = false;
+
+	bool success = false;
+};
+
 class CrBuiltinShaderBuilder
 {
 public:
@@ -53,6 +73,12 @@ public:
 
 private:
 
+	static void ExecuteCompilationJobs
+	(
+		const CrBuiltinShadersDescriptor& builtinShadersDescriptor,
+		const crstl::vector<crstl::vector<CrShaderCompilationJob>>& compilationJobs
+	);
+
 	static void BuildBuiltinShaderMetadataAndHeaderFiles
 	(
 		const CrBuiltinShadersDescriptor& builtinShadersDescriptor, 
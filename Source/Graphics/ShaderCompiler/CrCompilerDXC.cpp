@@ -20,7 +20,7 @@
 #include "Graphics/CrGraphics.h"
 #include "Graphics/CrShaderReflectionHeader.h"
 
-#include "Core/Streams/CrFileStream.h"
+#include "Core/Streams/CrBufferStream.h"
 #include "Core/CrHash.h"
 
 #include "CrShaderCompilerUtilities.h"
@@ -142,6 +142,16 @@ public:
 		return S_OK;
 	}
 
+	void GetIncludedFiles(crstl::vector<crstl::string>& includedFiles) const
+	{
+		for (const auto& includeFileIter : m_includeFiles)
+		{
+			crstl::string filename;
+			filename.append_convert<wchar_t>(includeFileIter.first.c_str());
+			includedFiles.push_back(filename);
+		}
+	}
+
 private:
 
 	crstl::open_hashmap<crstl::wstring, CComPtr<IDxcBlobEncoding>> m_includeFiles;
@@ -151,6 +161,28 @@ private:
 	crstl::atomic<uint32_t> m_dwRef = 0;
 };
 
+// Creating the DXC instances is expensive, so we keep them alive to reuse them across compilations.
+// They are not thread safe, so every thread that compiles gets its own
+struct CrDxcContext
+{
+	CComPtr<IDxcUtils> dxcUtils;
+
+	CComPtr<IDxcCompiler3> dxcCompiler;
+};
+
+static CrDxcContext& GetDxcContext()
+{
+	static thread_local CrDxcContext DxcContext;
+
+	if (!DxcContext.dxcCompiler)
+	{
+		DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&DxcContext.dxcUtils));
+		DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&DxcContext.dxcCompiler));
+	}
+
+	return DxcContext;
+}
+
 // This code was adapted from spirv_reflect utils/stripper.cpp
 // Removes the PDB instructions
 bool SpvStripDebugData(crstl::vector<uint32_t>& spirvData)
@@ -260,15 +292,27 @@ HRESULT CompileShaderDXC
 	CComPtr<IDxcResult>& dxcCompilationResult
 )
 {
-	if (crstl::file sourceCodeFile = crstl::file(compilationDescriptor.inputPath.c_str(), crstl::file_flags::read))
+	// Read in source code, unless it was given to us in memory
+	crstl::vector<uint8_t> sourceCode;
+
+	if (compilationDescriptor.inputSource.empty())
 	{
-		// Read in source code
-		crstl::vector<uint8_t> sourceCode;
+		if (crstl::file sourceCodeFile = crstl::file(compilationDescriptor.inputPath.c_str(), crstl::file_flags::read))
+		{
+			sourceCode.resize(sourceCodeFile.get_size());
+			sourceCodeFile.read(sourceCode.data(), sourceCode.size());
+		}
+		else
+		{
+			return E_FAIL;
+		}
+	}
 
-		sourceCode.resize(sourceCodeFile.get_size());
-		sourceCodeFile.read(sourceCode.data(), sourceCode.size());
+	{
+		const void* sourceCodeData = compilationDescriptor.inputSource.empty() ? (const void*)sourceCode.data() : (const void*)compilationDescriptor.inputSource.data();
+		size_t sourceCodeSize = compilationDescriptor.inputSource.empty() ? sourceCode.size() : compilationDescriptor.inputSource.size();
 
-		DxcBuffer sourceCodeBuffer = { sourceCode.data(), (uint32_t)sourceCode.size(), 0 };
+		DxcBuffer sourceCodeBuffer = { sourceCodeData, (uint32_t)sourceCodeSize, 0 };
 
 		// Add command line parameters. These are the same as the ones DXC uses
 		crstl::wstring wInputPath;
@@ -333,11 +377,13 @@ HRESULT CompileShaderDXC
 			arguments.push_back(wDefines[i].c_str());
 		}
 
-		return dxcCompiler->Compile(&sourceCodeBuffer, arguments.data(), (uint32_t)arguments.size(), dxcIncludeHandler, IID_PPV_ARGS(&dxcCompilationResult));
-	}
-	else
-	{
-		return E_FAIL;
+		HRESULT hResult = dxcCompiler->Compile(&sourceCodeBuffer, arguments.data(), (uint32_t)arguments.size(), dxcIncludeHandler, IID_PPV_ARGS(&dxcCompilationResult));
+
+		// Let the caller know which files this compilation depends on
+		compilationDescriptor.includedFiles.clear();
+		dxcIncludeHandler->GetIncludedFiles(compilationDescriptor.includedFiles);
+
+		return hResult;
 	}
 }
 
@@ -427,11 +473,9 @@ void InsertResourceIntoHeader(CrShaderReflectionHeader& reflectionHeader, const
 
 bool CrCompilerDXC::HLSLtoSPIRV(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint32_t>& bytecode, crstl::string& compilationStatus)
 {
-	CComPtr<IDxcUtils> dxcUtils;
-	DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&dxcUtils));
-
-	CComPtr<IDxcCompiler3> dxcCompiler;
-	DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&dxcCompiler));
+	CrDxcContext& dxcContext = GetDxcContext();
+	const CComPtr<IDxcUtils>& dxcUtils = dxcContext.dxcUtils;
+	const CComPtr<IDxcCompiler3>& dxcCompiler = dxcContext.dxcCompiler;
 
 	CComPtr<CrDxcIncludeHandler> dxcIncludeHandler = new CrDxcIncludeHandler(dxcUtils);
 
@@ -472,7 +516,7 @@ bool CrCompilerDXC::HLSLtoSPIRV(const CompilationDescriptor& compilationDescript
 	}
 }
 
-bool CrCompilerDXC::HLSLtoSPIRV(const CompilationDescriptor& compilationDescriptor, crstl::string& compilationStatus)
+bool CrCompilerDXC::HLSLtoSPIRV(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus)
 {
 	crstl::vector<uint32_t> spirvBytecode;
 	if (CrCompilerDXC::HLSLtoSPIRV(compilationDescriptor, spirvBytecode, compilationStatus))
@@ -570,12 +614,12 @@ bool CrCompilerDXC::HLSLtoSPIRV(const CompilationDescriptor& compilationDescript
 		SpvStripDebugData(spirvBytecode);
 
 		// Write reflection header and shader bytecode
-		CrWriteFileStream writeFileStream(compilationDescriptor.outputPath.c_str());
-		writeFileStream << reflectionHeader;
+		CrWriteBufferStream outputStream(compilationOutput);
+		outputStream << reflectionHeader;
 
 		// Reinterpret our current vector as a uint8_t vector to serialize back in
 		crstl::vector<uint8_t> uint8Bytecode(crstl_move(spirvBytecode));
-		writeFileStream << uint8Bytecode;
+		outputStream << uint8Bytecode;
 
 		return true;
 	}
@@ -641,13 +685,11 @@ crgfx::ShaderInterfaceBuiltinType::T GetShaderInterfaceType(const D3D12_SIGNATUR
 	}
 }
 
-bool CrCompilerDXC::HLSLtoDXIL(const CompilationDescriptor& compilationDescriptor, crstl::string& compilationStatus)
+bool CrCompilerDXC::HLSLtoDXIL(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus)
 {
-	CComPtr<IDxcUtils> dxcUtils;
-	DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&dxcUtils));
-
-	CComPtr<IDxcCompiler3> dxcCompiler;
-	DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&dxcCompiler));
+	CrDxcContext& dxcContext = GetDxcContext();
+	const CComPtr<IDxcUtils>& dxcUtils = dxcContext.dxcUtils;
+	const CComPtr<IDxcCompiler3>& dxcCompiler = dxcContext.dxcCompiler;
 	
 	CComPtr<CrDxcIncludeHandler> dxcIncludeHandler = new CrDxcIncludeHandler(dxcUtils);
 	
@@ -771,10 +813,10 @@ bool CrCompilerDXC::HLSLtoDXIL(const CompilationDescriptor& compilationDescripto
 			}
 		}
 
-		// Write reflection header out
-		CrWriteFileStream writeFileStream(compilationDescriptor.outputPath.c_str());
-		writeFileStream << reflectionHeader;
-		writeFileStream << bytecode;
+		// Write reflection header and shader bytecode
+		CrWriteBufferStream outputStream(compilationOutput);
+		outputStream << reflectionHeader;
+		outputStream << bytecode;
 
 		return true;
 	}
@@ -782,11 +824,9 @@ bool CrCompilerDXC::HLSLtoDXIL(const CompilationDescriptor& compilationDescripto
 
 bool CrCompilerDXC::PreprocessHLSL(const crstl::string& shaderSource, const crstl::fixed_path512& shadeSourcePath, crstl::string& preprocessedSource)
 {
-	CComPtr<IDxcUtils> dxcUtils;
-	DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&dxcUtils));
-
-	CComPtr<IDxcCompiler3> dxcCompiler;
-	DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&dxcCompiler));
+	CrDxcContext& dxcContext = GetDxcContext();
+	const CComPtr<IDxcUtils>& dxcUtils = dxcContext.dxcUtils;
+	const CComPtr<IDxcCompiler3>& dxcCompiler = dxcContext.dxcCompiler;
 
 	CComPtr<CrDxcIncludeHandler> dxcIncludeHandler = new CrDxcIncludeHandler(dxcUtils);
 
@@ -10,9 +10,10 @@ public:
 
 	static bool HLSLtoSPIRV(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint32_t>& bytecode, crstl::string& compilationStatus);
 
-	static bool HLSLtoSPIRV(const CompilationDescriptor& compilationDescriptor, crstl::string& compilationStatus);
+	// Produces the reflection header followed by the bytecode, in the same layout as the compiled shader files
+	static bool HLSLtoSPIRV(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus);
 
-	static bool HLSLtoDXIL(const CompilationDescriptor& compilationDescriptor, crstl::string& compilationStatus);
+	static bool HLSLtoDXIL(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus);
 
 	static bool PreprocessHLSL(const crstl::string& shaderSource, const crstl::string& rootPath, crstl::string& preprocessedSource);
 };
\ No newline at end of file
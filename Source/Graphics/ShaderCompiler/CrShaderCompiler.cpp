@@ -1,16 +1,10 @@
 ﻿#include "Graphics/ShaderCompiler/CrShaderCompiler_pch.h"
 
 #include "CrShaderCompiler.h"
-#include "CrShaderMetadataBuilder.h"
-#include "CrBuiltinShaderBuilder.h"
-#include "CrShaderCompilerUtilities.h"
 
 #include "Core/CrPlatform.h"
-#include "Core/CrCommandLine.h"
 #include "Core/FileSystem/CrFixedPath.h"
-#include "Core/Logging/ICrDebug.h"
-#include "Core/CrMacros.h"
-#include "Core/CrGlobalPaths.h"
+#include "Core/Threading/CrMutex.h"
 
 #include "crstl/filesystem.h"
 
@@ -20,29 +14,7 @@ void CompilationDescriptor::Process() const
 {
 	if (!processed)
 	{
-		switch (shaderStage)
-		{
-			case crgfx::ShaderStage::Vertex:   defines.push_back("VERTEX_SHADER"); break;
-			case crgfx::ShaderStage::Pixel:    defines.push_back("PIXEL_SHADER"); break;
-			case crgfx::ShaderStage::Hull:     defines.push_back("HULL_SHADER"); break;
-			case crgfx::ShaderStage::Domain:   defines.push_back("DOMAIN_SHADER"); break;
-			case crgfx::ShaderStage::Geometry: defines.push_back("GEOMETRY_SHADER"); break;
-			case crgfx::ShaderStage::Compute:  defines.push_back("COMPUTE_SHADER"); break;
-			default: break;
-		}
-
-		switch (platform)
-		{
-			case cr::Platform::Windows: defines.push_back("WINDOWS_TARGET"); break;
-			default: break;
-		}
-
-		switch (graphicsApi)
-		{
-			case crgfx::GraphicsApi::Vulkan: defines.push_back("VULKAN_API"); break;
-			case crgfx::GraphicsApi::D3D12: defines.push_back("D3D12_API"); break;
-			default: break;
-		}
+		CrShaderCompiler::AddImplicitDefines(shaderStage, platform, graphicsApi, defines);
 
 		processed = true;
 	}
@@ -54,6 +26,9 @@ CrFixedPath CrShaderCompiler::PDBDirectory;
 
 CrFixedPath CrShaderCompiler::PDBDirectories[cr::Platform::Count][crgfx::GraphicsApi::Count];
 
+// Shaders compile on several threads at once, and the first one to need a directory creates it
+static CrMutex PDBDirectoriesMutex;
+
 const crstl::string& CrShaderCompiler::GetExecutableDirectory()
 {
 	return ExecutableDirectory;
@@ -74,285 +49,80 @@ void CrShaderCompiler::Finalize()
 	
 }
 
-bool CrShaderCompiler::Compile(const CompilationDescriptor& compilationDescriptor, crstl::string& compilationStatus)
+void CrShaderCompiler::CreatePDBDirectory(cr::Platform::T platform, crgfx::GraphicsApi::T graphicsApi)
 {
-	// Patches the compilation descriptor with information derived from the current state (such as defines that identify
-	// the shader stage, the platform, etc)
-	compilationDescriptor.Process();
+	CrScopedLock lock(PDBDirectoriesMutex);
 
-	// The graphics API will tell us which compilation pipeline we want to use. The compilationDescriptor
-	// also includes which platform we want to be targeting so that we can make more informed decisions
-	// within (such as what level of support to expect e.g. in Vulkan, etc)
-	switch (compilationDescriptor.graphicsApi)
+	CrFixedPath& pdbPath = PDBDirectories[platform][graphicsApi];
+
+	if (!pdbPath.empty())
 	{
-		case crgfx::GraphicsApi::Vulkan:
-		{
-			return CrCompilerDXC::HLSLtoSPIRV(compilationDescriptor, compilationStatus);
-		}
-		case crgfx::GraphicsApi::D3D12:
-		{
-			return CrCompilerDXC::HLSLtoDXIL(compilationDescriptor, compilationStatus);
-		}
-		default:
-			break;
+		return;
 	}
 
-	return false;
-}
+	pdbPath = PDBDirectory;
+	pdbPath /= cr::Platform::ToString(platform);
+	pdbPath += "_";
+	pdbPath += crgfx::GraphicsApi::ToString(graphicsApi);
 
-static crgfx::ShaderStage::T ParseShaderStage(const crstl::string& stageString)
-{
-	if (stageString == "vertex")
-	{
-		return crgfx::ShaderStage::Vertex;
-	}
-	else if (stageString == "pixel")
+	if (!crstl::exists(pdbPath.c_str()))
 	{
-		return crgfx::ShaderStage::Pixel;
+		crstl::create_directories(pdbPath.c_str());
 	}
-	else if (stageString == "hull")
-	{
-		return crgfx::ShaderStage::Hull;
-	}
-	else if (stageString == "domain")
-	{
-		return crgfx::ShaderStage::Domain;
-	}
-	else if (stageString == "geometry")
-	{
-		return crgfx::ShaderStage::Geometry;
-	}
-	else if (stageString == "compute")
-	{
-		return crgfx::ShaderStage::Compute;
-	}
-
-	return crgfx::ShaderStage::Count;
 }
 
-static cr::Platform::T ParsePlatform(const crstl::string& platformString)
+bool CrShaderCompiler::Compile(const CompilationDescriptor& compilationDescriptor, crstl::string& compilationStatus)
 {
-	if (platformString == "windows")
+	crstl::vector<uint8_t> compilationOutput;
+
+	// Only write the output once we know compilation succeeded, so that a failed compilation never leaves a truncated file behind
+	if (Compile(compilationDescriptor, compilationOutput, compilationStatus))
 	{
-		return cr::Platform::Windows;
+		return WriteOutputFile(compilationDescriptor, compilationOutput, compilationStatus);
 	}
 	else
 	{
-		return cr::Platform::Count;
+		return false;
 	}
 }
 
-static crgfx::GraphicsApi::T ParseGraphicsApi(const crstl::string& graphicsApiString)
+bool CrShaderCompiler::WriteOutputFile(const CompilationDescriptor& compilationDescriptor, const crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus)
 {
-	if (graphicsApiString.comparei("vulkan") == 0)
-	{
-		return crgfx::GraphicsApi::Vulkan;
-	}
-	else if (graphicsApiString.comparei("d3d12") == 0)
+	if (crstl::file outputFile = crstl::file(compilationDescriptor.outputPath.c_str(), crstl::file_flags::force_create | crstl::file_flags::write))
 	{
-		return crgfx::GraphicsApi::D3D12;
+		outputFile.write(compilationOutput.data(), compilationOutput.size());
+		return true;
 	}
 	else
 	{
-		return crgfx::GraphicsApi::Count;
+		compilationStatus += "Failed to write output file ";
+		compilationStatus += compilationDescriptor.outputPath.c_str();
+		return false;
 	}
 }
 
-// Usage:
-// -input sourceFile.hlsl : Source file to be compiled
-// -output outputFile.bin : Destination the compiled shader is written to
-// -entryPoint MainPS     : Entry point for the compiled shader
-// -stage pixel           : Shader stage this entry point runs in
-// -platform windows      : Platform to compile this shader for
-// -graphicsapi vulkan    : Graphics API for this platform
-// -D DEFINE1 -D DEFINE2  : Add defines for the compilation
-// -reflection            : Append custom reflection to the shader. This makes it unreadable to compilers (e.g. fxc/dxc)
-//                          and is for use in the engine. It strips out the built-in reflection data
-// 
-// -metadata metadataPath : Where C++ metadata is stored
-// -builtin               : Build builtin shaders
-// -builtin-headers       : Build metadata headers for the build to consume. Don't pass in when live recompiling
-// -pdb pdbPath           : Create a PDB for this shader and store in pdbPath
-//                          The PDB is uniquely identified with a hash stored in the reflection data
-
-int main(int argc, char* argv[])
+bool CrShaderCompiler::Compile(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus)
 {
-	CrCommandLineParser commandLine(argc, argv);
-	
-	CrFixedPath executablePath = argv[0];
-	executablePath.remove_filename();
-
-	CrShaderCompiler::ExecutableDirectory = executablePath.c_str();
-
-	CrFixedPath inputFilePath              = commandLine("-input").c_str();
-	CrFixedPath outputFilePath             = commandLine("-output").c_str();
-	bool buildMetadata                     = commandLine["-metadata"];
-	bool buildBuiltinShaders               = commandLine["-builtin"];
-	bool buildBuiltinHeaders               = commandLine["-builtin-headers"];
-	const crstl::string& entryPoint        = commandLine("-entrypoint");
-	const crstl::string& shaderStageString = commandLine("-stage");
-	const crstl::string& platformString    = commandLine("-platform");
-
-	CrShaderCompiler::PDBDirectory    = commandLine("-pdb").c_str();
-
-	crstl::vector<crstl::string> graphicsApiStrings;
-	commandLine.for_each("-graphicsapi", [&graphicsApiStrings](const crstl::string& value)
-	{
-		graphicsApiStrings.push_back(value);
-	});
-
-	crstl::vector<crstl::string> defines;
-	commandLine.for_each("-D",[&defines](const crstl::string& value)
-	{
-		defines.push_back(value);
-	});
-
-	// If no PDB directory was supplied, use the temp folder
-	if (CrShaderCompiler::PDBDirectory.empty())
-	{
-		CrShaderCompiler::PDBDirectory = CrGlobalPaths::GetTempEngineDirectory() + "Shader PDBs";
-	}
-
-	crstl::string inputPath = inputFilePath.c_str();
-	crstl::string outputPath = outputFilePath.c_str();
-
-	if (inputPath.empty())
-	{
-		CrShaderCompilerUtilities::QuitWithMessage("Error: no input specified\n");
-	}
-
-	if (outputPath.empty())
-	{
-		CrShaderCompilerUtilities::QuitWithMessage("Error: no output specified\n");
-	}
-
-	cr::Platform::T platform = ParsePlatform(platformString);
-
-	if (!CrShaderCompiler::PDBDirectory.empty())
-	{
-		for (const crstl::string& graphicsApiString : graphicsApiStrings)
-		{
-			crgfx::GraphicsApi::T graphicsApi = ParseGraphicsApi(graphicsApiString);
-			CrFixedPath& pdbPath = CrShaderCompiler::PDBDirectories[platform][graphicsApi];
-			pdbPath = CrShaderCompiler::PDBDirectory;
-			pdbPath /= cr::Platform::ToString(platform);
-			pdbPath += "_";
-			pdbPath += crgfx::GraphicsApi::ToString(graphicsApi);
-
-			if (!crstl::exists(pdbPath.c_str()))
-			{
-				crstl::create_directories(pdbPath.c_str());
-			}
-		}
-	}
-
-	CrShaderCompiler::Initialize();
-
-	// If we've been asked to create metadata
-	if (buildMetadata)
-	{
-		if (entryPoint.empty())
-		{
-			CrShaderCompilerUtilities::QuitWithMessage("No entry point specified\n");
-		}
-
-		CompilationDescriptor compilationDescriptor;
-		compilationDescriptor.inputPath = inputPath;
-		compilationDescriptor.outputPath = outputPath;
-		compilationDescriptor.entryPoint = entryPoint;
-		compilationDescriptor.shaderStage = crgfx::ShaderStage::Pixel;
-
-		// Make sure resources aren't stripped out
-		compilationDescriptor.optimization = OptimizationLevel::None;
-		compilationDescriptor.metadata = true;
-
-		crstl::string compilationStatus;
-		bool success = CrShaderMetadataBuilder::BuildMetadata(compilationDescriptor, compilationStatus);
-
-		if (!success)
-		{
-			CrShaderCompilerUtilities::QuitWithMessage(compilationStatus);
-		}
-	}
-	else if (buildBuiltinShaders)
-	{
-		if (platform == cr::Platform::Count)
-		{
-			CrShaderCompilerUtilities::QuitWithMessage("No platform specified\n");
-		}
-
-		CrBuiltinShadersDescriptor builtinShadersDescriptor;
-		builtinShadersDescriptor.inputPath = inputFilePath;
-		builtinShadersDescriptor.outputPath = outputFilePath;
-		builtinShadersDescriptor.buildBuiltinHeaders = buildBuiltinHeaders;
-
-		crstl::create_directories(outputFilePath.c_str());
-
-		for (const crstl::string& graphicsApiString : graphicsApiStrings)
-		{
-			crgfx::GraphicsApi::T graphicsApi = ParseGraphicsApi(graphicsApiString);
-
-			if (graphicsApi == crgfx::GraphicsApi::Count)
-			{
-				CrShaderCompilerUtilities::QuitWithMessage("No graphics API specified\n");
-			}
-
-			builtinShadersDescriptor.graphicsApis.push_back(graphicsApi);
-		}
-
-		builtinShadersDescriptor.platform = platform;
+	// Patches the compilation descriptor with information derived from the current state (such as defines that identify
+	// the shader stage, the platform, etc)
+	compilationDescriptor.Process();
 
-		CrBuiltinShaderBuilder::ProcessBuiltinShaders(builtinShadersDescriptor);
-	}
-	else
+	// The graphics API will tell us which compilation pipeline we want to use. The compilationDescriptor
+	// also includes which platform we want to be targeting so that we can make more informed decisions
+	// within (such as what level of support to expect e.g. in Vulkan, etc)
+	switch (compilationDescriptor.graphicsApi)
 	{
-		if (platform == cr::Platform::Count)
-		{
-			CrShaderCompilerUtilities::QuitWithMessage("No platform specified\n");
-		}
-
-		crgfx::GraphicsApi::T graphicsApi = ParseGraphicsApi(graphicsApiStrings[0]);
-
-		if (graphicsApi == crgfx::GraphicsApi::Count)
-		{
-			CrShaderCompilerUtilities::QuitWithMessage("No graphics API specified\n");
-		}
-
-		if (entryPoint.empty())
-		{
-			CrShaderCompilerUtilities::QuitWithMessage("No entry point specified\n");
-		}
-
-		crgfx::ShaderStage::T shaderStage = ParseShaderStage(shaderStageString);
-
-		if (shaderStage == crgfx::ShaderStage::Count)
+		case crgfx::GraphicsApi::Vulkan:
 		{
-			CrShaderCompilerUtilities::QuitWithMessage("No shader stage specified\n");
+			return CrCompilerDXC::HLSLtoSPIRV(compilationDescriptor, compilationOutput, compilationStatus);
 		}
-
-		CrFixedPath tempPath = outputFilePath;
-		tempPath.replace_extension(".temp");
-
-		CompilationDescriptor compilationDescriptor;
-		compilationDescriptor.inputPath       = inputFilePath;
-		compilationDescriptor.outputPath      = outputFilePath;
-		compilationDescriptor.tempPath        = tempPath;
-		compilationDescriptor.entryPoint      = entryPoint;
-		compilationDescriptor.defines         = defines;
-		compilationDescriptor.platform        = platform;
-		compilationDescriptor.graphicsApi     = graphicsApi;
-		compilationDescriptor.shaderStage     = shaderStage;
-
-		crstl::string compilationStatus;
-		bool success = CrShaderCompiler::Compile(compilationDescriptor, compilationStatus);
-
-		if (!success)
+		case crgfx::GraphicsApi::D3D12:
 		{
-			CrShaderCompilerUtilities::QuitWithMessage(compilationStatus.c_str());
+			return CrCompilerDXC::HLSLtoDXIL(compilationDescriptor, compilationOutput, compilationStatus);
 		}
+		default:
+			break;
 	}
 
-	CrShaderCompiler::Finalize();
-
-	return 0;
+	return false;
 }
@@ -33,11 +33,13 @@ struct CompilationDescriptor
 	void Process() const;
 
 	CrFixedPath inputPath;
+	crstl::string inputSource; // Source code to compile. If empty it's read from inputPath, which is still used to resolve includes
 	CrFixedPath outputPath;
 	CrFixedPath tempPath; // Filename compiler can use to dump intermediate data
 	crstl::string entryPoint;
 	crstl::string uniqueBinaryName;
 	mutable crstl::vector<crstl::string> defines;
+	mutable crstl::vector<crstl::string> includedFiles; // Filled in by the compiler with every file the source included
 	cr::Platform::T platform;
 	crgfx::GraphicsApi::T graphicsApi;
 	crgfx::ShaderStage::T shaderStage;
@@ -53,6 +55,35 @@ class CrShaderCompiler
 {
 public:
 
+	// Defines the compiler adds to every shader. Anything that needs to know what the compiler sees, such as hashing
+	// preprocessed sources, needs to add them too
+	static void AddImplicitDefines(crgfx::ShaderStage::T shaderStage, cr::Platform::T platform, crgfx::GraphicsApi::T graphicsApi, crstl::vector<crstl::string>& defines)
+	{
+		switch (shaderStage)
+		{
+			case crgfx::ShaderStage::Vertex:   defines.push_back("VERTEX_SHADER"); break;
+			case crgfx::ShaderStage::Pixel:    defines.push_back("PIXEL_SHADER"); break;
+			case crgfx::ShaderStage::Hull:     defines.push_back("HULL_SHADER"); break;
+			case crgfx::ShaderStage::Domain:   defines.push_back("DOMAIN_SHADER"); break;
+			case crgfx::ShaderStage::Geometry: defines.push_back("GEOMETRY_SHADER"); break;
+			case crgfx::ShaderStage::Compute:  defines.push_back("COMPUTE_SHADER"); break;
+			default: break;
+		}
+
+		switch (platform)
+		{
+			case cr::Platform::Windows: defines.push_back("WINDOWS_TARGET"); break;
+			default: break;
+		}
+
+		switch (graphicsApi)
+		{
+			case crgfx::GraphicsApi::Vulkan: defines.push_back("VULKAN_API"); break;
+			case crgfx::GraphicsApi::D3D12: defines.push_back("D3D12_API"); break;
+			default: break;
+		}
+	}
+
 	static const crstl::string& GetExecutableDirectory();
 
 	static crstl::string ExecutableDirectory;
@@ -67,5 +98,15 @@ public:
 
 	static void Finalize();
 
+	// Can be called from any thread. Does nothing if the directory has already been created
+	static void CreatePDBDirectory(cr::Platform::T platform, crgfx::GraphicsApi::T graphicsApi);
+
+	// Compiles and writes the result to the output path of the compilation descriptor
 	static bool Compile(const CompilationDescriptor& compilationDescriptor, crstl::string& compilationStatus);
+
+	static bool WriteOutputFile(const CompilationDescriptor& compilationDescriptor, const crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus);
+
+	// Compiles into memory. The output is laid out the same way as the compiled file, i.e. the reflection
+	// header followed by the bytecode, so it can be deserialized straight into a ShaderBytecode
+	static bool Compile(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus);
 };
\ No newline at end of file
@@ -0,0 +1,526 @@
+#include "Graphics/ShaderCompiler/CrShaderCompiler_pch.h"
+
+#include "CrShaderCompiler.h"
+#include "CrShaderMetadataBuilder.h"
+#include "CrBuiltinShaderBuilder.h"
+#include "CrShaderCompilerUtilities.h"
+#include "CrShaderCompilerServer.h"
+
+#include "Core/CrPlatform.h"
+#include "Core/CrCommandLine.h"
+#include "Core/FileSystem/CrFixedPath.h"
+#include "Core/Logging/ICrDebug.h"
+#include "Core/CrMacros.h"
+#include "Core/CrGlobalPaths.h"
+#include "Core/FileSystem/CrPackedArchive.h"
+#include "Core/Streams/CrFileStream.h"
+
+#include "Graphics/CrShaderDiskCache.h"
+
+#include "crstl/filesystem.h"
+#include "crstl/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static crgfx::ShaderStage::T ParseShaderStage(const crstl::string& stageString)
+{
+	if (stageString == "vertex")
+	{
+		return crgfx::ShaderStage::Vertex;
+	}
+	else if (stageString == "pixel")
+	{
+		return crgfx::ShaderStage::Pixel;
+	}
+	else if (stageString == "hull")
+	{
+		return crgfx::ShaderStage::Hull;
+	}
+	else if (stageString == "domain")
+	{
+		return crgfx::ShaderStage::Domain;
+	}
+	else if (stageString == "geometry")
+	{
+		return crgfx::ShaderStage::Geometry;
+	}
+	else if (stageString == "compute")
+	{
+		return crgfx::ShaderStage::Compute;
+	}
+
+	return crgfx::ShaderStage::Count;
+}
+
+static cr::Platform::T ParsePlatform(const crstl::string& platformString)
+{
+	if (platformString == "windows")
+	{
+		return cr::Platform::Windows;
+	}
+	else
+	{
+		return cr::Platform::Count;
+	}
+}
+
+static crgfx::GraphicsApi::T ParseGraphicsApi(const crstl::string& graphicsApiString)
+{
+	if (graphicsApiString.comparei("vulkan") == 0)
+	{
+		return crgfx::GraphicsApi::Vulkan;
+	}
+	else if (graphicsApiString.comparei("d3d12") == 0)
+	{
+		return crgfx::GraphicsApi::D3D12;
+	}
+	else
+	{
+		return crgfx::GraphicsApi::Count;
+	}
+}
+
+static void InspectArchive(const CrFixedPath& archivePath)
+{
+	if (!crstl::exists(CrPackedArchive::GetArchiveFilePath(archivePath).c_str()))
+	{
+		CrShaderCompilerUtilities::QuitWithMessage("Error: archive not found\n");
+	}
+
+	CrPackedArchive archive;
+
+	if (!archive.OpenReadOnly(archivePath))
+	{
+		CrShaderCompilerUtilities::QuitWithMessage("Error: archive could not be read\n");
+	}
+
+	printf("Archive %s\n", archivePath.c_str());
+	printf("  Entries    : %llu\n", (unsigned long long)archive.GetEntryCount());
+	printf("  Size       : %llu bytes\n", (unsigned long long)archive.GetArchiveSize());
+	printf("  Dead space : %llu bytes\n", (unsigned long long)archive.GetDeadBytes());
+
+	archive.ForEachEntry([](uint64_t key, const CrPackedArchiveData& archiveData)
+	{
+		printf("  %016llx : %llu bytes\n", (unsigned long long)key, (unsigned long long)archiveData.size);
+	});
+}
+
+static bool ReadShaderDiskCacheManifest(const CrFixedPath& manifestPath, CrShaderDiskCacheManifest& manifest)
+{
+	CrMappedFileStream manifestFile(manifestPath.c_str());
+	CrReadBufferStream& manifestStream = manifestFile.GetStream();
+	manifestStream << manifest;
+	return manifest.IsCurrent() && manifestStream.IsValid();
+}
+
+// The disk cache evicts bytecode its manifest doesn't list, so merging caches needs to merge their manifests as well.
+// The output's own entries are kept, and later inputs replace the entries of earlier ones
+static bool MergeShaderDiskCaches(const CrFixedPath& outputCachePath, const crstl::vector<CrFixedPath>& inputCachePaths, const char* manifestFilename)
+{
+	crstl::open_hashmap<CrHash, CrShaderDiskCacheEntry> mergedEntries;
+
+	auto mergeManifest = [&mergedEntries](const CrShaderDiskCacheManifest& manifest)
+	{
+		for (const CrShaderDiskCacheEntry& entry : manifest.entries)
+		{
+			CrHash entryKey = CrShaderDiskCache::GetEntryKey(entry.hash, entry.graphicsApi);
+			mergedEntries.erase(entryKey);
+			mergedEntries.insert(entryKey, entry);
+		}
+	};
+
+	CrFixedPath outputManifestPath = CrShaderDiskCache::GetManifestPath(outputCachePath, manifestFilename);
+
+	if (crstl::exists(outputManifestPath.c_str()))
+	{
+		CrShaderDiskCacheManifest outputManifest;
+
+		if (ReadShaderDiskCacheManifest(outputManifestPath, outputManifest))
+		{
+			mergeManifest(outputManifest);
+		}
+	}
+
+	crstl::vector<CrFixedPath> inputArchivePaths;
+
+	for (const CrFixedPath& inputCachePath : inputCachePaths)
+	{
+		CrFixedPath inputManifestPath = CrShaderDiskCache::GetManifestPath(inputCachePath, manifestFilename);
+
+		CrShaderDiskCacheManifest inputManifest;
+
+		if (!crstl::exists(inputManifestPath.c_str()) || !ReadShaderDiskCacheManifest(inputManifestPath, inputManifest))
+		{
+			printf("Error: %s is missing or has an outdated manifest\n", inputCachePath.c_str());
+			return false;
+		}
+
+		mergeManifest(inputManifest);
+
+		inputArchivePaths.push_back(CrShaderDiskCache::GetArchivePath(inputCachePath));
+	}
+
+	// Write the bytecode before the manifest, so that the manifest never lists bytecode that isn't there
+	if (!CrPackedArchive::Merge(CrShaderDiskCache::GetArchivePath(outputCachePath), inputArchivePaths))
+	{
+		return false;
+	}
+
+	CrShaderDiskCacheManifest mergedManifest;
+	mergedManifest.entries.reserve(mergedEntries.size());
+
+	for (const auto& entryIterator : mergedEntries)
+	{
+		mergedManifest.entries.push_back(entryIterator.second);
+	}
+
+	CrWriteFileStream manifestFile(outputManifestPath.c_str());
+	manifestFile << mergedManifest;
+
+	return true;
+}
+
+static bool RunClientRequest(const crstl::string& serverName, const crstl::string& request)
+{
+	CrShaderCompilerClient shaderCompilerClient;
+
+	if (!shaderCompilerClient.Connect(serverName.c_str()))
+	{
+		printf("Could not connect to shader compiler server %s\n", serverName.c_str());
+		return false;
+	}
+
+	crstl::timer requestTime;
+	bool success = false;
+
+	if (request == "ping")
+	{
+		success = shaderCompilerClient.Ping();
+	}
+	else if (request == "stats")
+	{
+		crstl::string statistics;
+		success = shaderCompilerClient.GetStatistics(statistics);
+		printf("%s", statistics.c_str());
+	}
+	else if (request == "shutdown")
+	{
+		success = shaderCompilerClient.Shutdown();
+	}
+	else
+	{
+		printf("Unknown request %s\n", request.c_str());
+		return false;
+	}
+
+	printf("Request %s %s (%.2f ms)\n", request.c_str(), success ? "succeeded" : "failed", requestTime.elapsed().milliseconds());
+
+	return success;
+}
+
+// Usage:
+// -input sourceFile.hlsl : Source file to be compiled
+// -output outputFile.bin : Destination the compiled shader is written to
+// -entryPoint MainPS     : Entry point for the compiled shader
+// -stage pixel           : Shader stage this entry point runs in
+// -platform windows      : Platform to compile this shader for
+// -graphicsapi vulkan    : Graphics API for this platform
+// -D DEFINE1 -D DEFINE2  : Add defines for the compilation
+// -reflection            : Append custom reflection to the shader. This makes it unreadable to compilers (e.g. fxc/dxc)
+//                          and is for use in the engine. It strips out the built-in reflection data
+// 
+// -metadata metadataPath : Where C++ metadata is stored
+// -builtin               : Build builtin shaders
+// -builtin-headers       : Build metadata headers for the build to consume. Don't pass in when live recompiling
+// -jobs 8                : Maximum number of builtin shaders compiled in parallel. Defaults to the hardware thread count
+// -pdb pdbPath           : Create a PDB for this shader and store in pdbPath
+//                          The PDB is uniquely identified with a hash stored in the reflection data
+//
+// -archive-inspect path  : Print the contents of a packed archive (path without extension)
+// -archive-merge         : Merge every -input archive into the -output archive. Later inputs win
+// -manifest name         : Merge shader disk caches instead. -input and -output are cache directories, and the
+//                          manifests with this name next to them are merged too. Without the merged manifest the
+//                          engine evicts the merged bytecode
+//
+// -server                : Run as a shader compiler server, serving up to -jobs connections at the same time
+// -servername name       : Name the server listens on or clients connect to. Defaults to CrShaderCompilerServer
+// -useserver             : Compile the shader or builtin shaders through the server instead of in this process
+// -client ping           : Send a single request to the server and print the response. Requests are ping, stats and shutdown
+
+int main(int argc, char* argv[])
+{
+	CrCommandLineParser commandLine(argc, argv);
+	
+	CrFixedPath executablePath = argv[0];
+	executablePath.remove_filename();
+
+	CrShaderCompiler::ExecutableDirectory = executablePath.c_str();
+
+	CrFixedPath inputFilePath              = commandLine("-input").c_str();
+	CrFixedPath outputFilePath             = commandLine("-output").c_str();
+	bool buildMetadata                     = commandLine["-metadata"];
+	bool buildBuiltinShaders               = commandLine["-builtin"];
+	bool buildBuiltinHeaders               = commandLine["-builtin-headers"];
+	const crstl::string& entryPoint        = commandLine("-entrypoint");
+	const crstl::string& shaderStageString = commandLine("-stage");
+	const crstl::string& platformString    = commandLine("-platform");
+	const crstl::string& jobsString        = commandLine("-jobs");
+	const crstl::string& clientRequest     = commandLine("-client");
+	bool runServer                         = commandLine["-server"];
+	bool useServer                         = commandLine["-useserver"];
+
+	crstl::string serverName = commandLine("-servername");
+
+	if (serverName.empty())
+	{
+		serverName = CrShaderCompilerServer::DefaultName;
+	}
+
+	uint32_t maxConcurrentJobs = jobsString.empty() ? 0 : (uint32_t)atoi(jobsString.c_str());
+
+	CrShaderCompiler::PDBDirectory    = commandLine("-pdb").c_str();
+
+	crstl::vector<crstl::string> graphicsApiStrings;
+	commandLine.for_each("-graphicsapi", [&graphicsApiStrings](const crstl::string& value)
+	{
+		graphicsApiStrings.push_back(value);
+	});
+
+	crstl::vector<crstl::string> defines;
+	commandLine.for_each("-D",[&defines](const crstl::string& value)
+	{
+		defines.push_back(value);
+	});
+
+	// If no PDB directory was supplied, use the temp folder
+	if (CrShaderCompiler::PDBDirectory.empty())
+	{
+		CrShaderCompiler::PDBDirectory = CrGlobalPaths::GetTempEngineDirectory() + "Shader PDBs";
+	}
+
+	// Archive tools don't compile anything, process them upfront
+	const crstl::string& archiveInspectPath = commandLine("-archive-inspect");
+
+	if (!archiveInspectPath.empty())
+	{
+		InspectArchive(archiveInspectPath.c_str());
+		return 0;
+	}
+
+	if (commandLine["-archive-merge"])
+	{
+		crstl::vector<CrFixedPath> inputArchivePaths;
+		commandLine.for_each("-input", [&inputArchivePaths](const crstl::string& value)
+		{
+			inputArchivePaths.push_back(CrFixedPath(value.c_str()));
+		});
+
+		if (inputArchivePaths.empty() || outputFilePath.empty())
+		{
+			CrShaderCompilerUtilities::QuitWithMessage("Error: merging archives needs -input and -output\n");
+		}
+
+		const crstl::string& manifestFilename = commandLine("-manifest");
+
+		if (!manifestFilename.empty())
+		{
+			if (!MergeShaderDiskCaches(outputFilePath, inputArchivePaths, manifestFilename.c_str()))
+			{
+				CrShaderCompilerUtilities::QuitWithMessage("Error: could not merge shader disk caches\n");
+			}
+
+			InspectArchive(CrShaderDiskCache::GetArchivePath(outputFilePath));
+			return 0;
+		}
+
+		if (!CrPackedArchive::Merge(outputFilePath, inputArchivePaths))
+		{
+			CrShaderCompilerUtilities::QuitWithMessage("Error: could not merge archives\n");
+		}
+
+		InspectArchive(outputFilePath);
+		return 0;
+	}
+
+	if (runServer)
+	{
+		CrShaderCompiler::Initialize();
+		bool serverRan = CrShaderCompilerServer::Run(serverName.c_str(), maxConcurrentJobs);
+		CrShaderCompiler::Finalize();
+		return serverRan ? 0 : 1;
+	}
+
+	if (!clientRequest.empty())
+	{
+		return RunClientRequest(serverName, clientRequest) ? 0 : 1;
+	}
+
+	crstl::string inputPath = inputFilePath.c_str();
+	crstl::string outputPath = outputFilePath.c_str();
+
+	if (inputPath.empty())
+	{
+		CrShaderCompilerUtilities::QuitWithMessage("Error: no input specified\n");
+	}
+
+	if (outputPath.empty())
+	{
+		CrShaderCompilerUtilities::QuitWithMessage("Error: no output specified\n");
+	}
+
+	cr::Platform::T platform = ParsePlatform(platformString);
+
+	if (!CrShaderCompiler::PDBDirectory.empty())
+	{
+		for (const crstl::string& graphicsApiString : graphicsApiStrings)
+		{
+			crgfx::GraphicsApi::T graphicsApi = ParseGraphicsApi(graphicsApiString);
+			CrShaderCompiler::CreatePDBDirectory(platform, graphicsApi);
+		}
+	}
+
+	CrShaderCompiler::Initialize();
+
+	// If we've been asked to create metadata
+	if (buildMetadata)
+	{
+		if (entryPoint.empty())
+		{
+			CrShaderCompilerUtilities::QuitWithMessage("No entry point specified\n");
+		}
+
+		CompilationDescriptor compilationDescriptor;
+		compilationDescriptor.inputPath = inputPath;
+		compilationDescriptor.outputPath = outputPath;
+		compilationDescriptor.entryPoint = entryPoint;
+		compilationDescriptor.shaderStage = crgfx::ShaderStage::Pixel;
+
+		// Make sure resources aren't stripped out
+		compilationDescriptor.optimization = OptimizationLevel::None;
+		compilationDescriptor.metadata = true;
+
+		crstl::string compilationStatus;
+		bool success = CrShaderMetadataBuilder::BuildMetadata(compilationDescriptor, compilationStatus);
+
+		if (!success)
+		{
+			CrShaderCompilerUtilities::QuitWithMessage(compilationStatus);
+		}
+	}
+	else if (buildBuiltinShaders)
+	{
+		if (platform == cr::Platform::Count)
+		{
+			CrShaderCompilerUtilities::QuitWithMessage("No platform specified\n");
+		}
+
+		CrBuiltinShadersDescriptor builtinShadersDescriptor;
+		builtinShadersDescriptor.inputPath = inputFilePath;
+		builtinShadersDescriptor.outputPath = outputFilePath;
+		builtinShadersDescriptor.buildBuiltinHeaders = buildBuiltinHeaders;
+		builtinShadersDescriptor.maxConcurrentJobs = maxConcurrentJobs;
+
+		if (useServer)
+		{
+			builtinShadersDescriptor.serverName = serverName;
+		}
+
+		crstl::create_directories(outputFilePath.c_str());
+
+		for (const crstl::string& graphicsApiString : graphicsApiStrings)
+		{
+			crgfx::GraphicsApi::T graphicsApi = ParseGraphicsApi(graphicsApiString);
+
+			if (graphicsApi == crgfx::GraphicsApi::Count)
+			{
+				CrShaderCompilerUtilities::QuitWithMessage("No graphics API specified\n");
+			}
+
+			builtinShadersDescriptor.graphicsApis.push_back(graphicsApi);
+		}
+
+		builtinShadersDescriptor.platform = platform;
+
+		CrBuiltinShaderBuilder::ProcessBuiltinShaders(builtinShadersDescriptor);
+	}
+	else
+	{
+		if (platform == cr::Platform::Count)
+		{
+			CrShaderCompilerUtilities::QuitWithMessage("No platform specified\n");
+		}
+
+		crgfx::GraphicsApi::T graphicsApi = ParseGraphicsApi(graphicsApiStrings[0]);
+
+		if (graphicsApi == crgfx::GraphicsApi::Count)
+		{
+			CrShaderCompilerUtilities::QuitWithMessage("No graphics API specified\n");
+		}
+
+		if (entryPoint.empty())
+		{
+			CrShaderCompilerUtilities::QuitWithMessage("No entry point specified\n");
+		}
+
+		crgfx::ShaderStage::T shaderStage = ParseShaderStage(shaderStageString);
+
+		if (shaderStage == crgfx::ShaderStage::Count)
+		{
+			CrShaderCompilerUtilities::QuitWithMessage("No shader stage specified\n");
+		}
+
+		CrFixedPath tempPath = outputFilePath;
+		tempPath.replace_extension(".temp");
+
+		CompilationDescriptor compilationDescriptor;
+		compilationDescriptor.inputPath       = inputFilePath;
+		compilationDescriptor.outputPath      = outputFilePath;
+		compilationDescriptor.tempPath        = tempPath;
+		compilationDescriptor.entryPoint      = entryPoint;
+		compilationDescriptor.defines         = defines;
+		compilationDescriptor.platform        = platform;
+		compilationDescriptor.graphicsApi     = graphicsApi;
+		compilationDescriptor.shaderStage     = shaderStage;
+
+		crstl::string compilationStatus;
+		bool success = false;
+		bool compiled = false;
+
+		if (useServer)
+		{
+			CrShaderCompilerClient shaderCompilerClient;
+
+			if (shaderCompilerClient.Connect(serverName.c_str()))
+			{
+				crstl::timer compilationTime;
+				bool cacheHit = false;
+				success = shaderCompilerClient.CompileToFile(compilationDescriptor, compilationStatus, &cacheHit);
+				compiled = shaderCompilerClient.IsConnected();
+
+				if (success)
+				{
+					printf("Compiled %s through %s (%.2f ms%s)\n", entryPoint.c_str(), serverName.c_str(), compilationTime.elapsed().milliseconds(), cacheHit ? ", cache hit" : "");
+				}
+			}
+			else
+			{
+				printf("Could not connect to shader compiler server %s, compiling locally\n", serverName.c_str());
+			}
+		}
+
+		if (!compiled)
+		{
+			success = CrShaderCompiler::Compile(compilationDescriptor, compilationStatus);
+		}
+
+		if (!success)
+		{
+			CrShaderCompilerUtilities::QuitWithMessage(compilationStatus.c_str());
+		}
+	}
+
+	CrShaderCompiler::Finalize();
+
+	return 0;
+}
@@ -0,0 +1,562 @@
+#include "Graphics/ShaderCompiler/CrShaderCompiler_pch.h"
+
+#include "CrShaderCompilerServer.h"
+#include "CrShaderCompiler.h"
+
+#include "Core/CrHash.h"
+#include "Core/FileSystem/CrFileUtilities.h"
+#include "Core/Streams/CrBufferStream.h"
+#include "Core/Threading/CrMutex.h"
+#include "Core/Threading/CrThreadPool.h"
+
+#include "crstl/filesystem.h"
+#include "crstl/open_hashmap.h"
+#include "crstl/timer.h"
+
+#include <stdio.h>
+
+const char* CrShaderCompilerServer::DefaultName = "CrShaderCompilerServer";
+
+struct CrShaderCompilerFileDependency
+{
+	crstl::string filename;
+
+	CrHash hash;
+};
+
+struct CrShaderCompilerCacheEntry
+{
+	crstl::vector<uint8_t> compilationOutput;
+
+	// The input file (unless the source was sent with the request) and every file it included
+	crstl::vector<CrShaderCompilerFileDependency> dependencies;
+};
+
+struct CrShaderCompilerServerState
+{
+	crstl::string name;
+
+	CrMutex mutex;
+
+	crstl::open_hashmap<CrHash, CrShaderCompilerCacheEntry> cache;
+
+	// Connections that are currently being served, so that we can disconnect them on shutdown
+	crstl::vector<CrLocalSocket*> connections;
+
+	bool shutdown = false;
+
+	uint64_t requestCount = 0;
+
+	uint64_t cacheHitCount = 0;
+
+	uint64_t compilationCount = 0;
+
+	uint64_t failedCompilationCount = 0;
+
+	double compilationTimeMs = 0.0;
+};
+
+// Both ends of the connection serialize the same way, so that reading and writing can't go out of sync
+template<typename StreamT>
+static void SerializeCompilationDescriptor(StreamT& stream, CompilationDescriptor& compilationDescriptor)
+{
+	crstl::string inputPath = compilationDescriptor.inputPath.c_str();
+	stream << inputPath;
+	compilationDescriptor.inputPath = inputPath.c_str();
+
+	stream << compilationDescriptor.inputSource;
+	stream << compilationDescriptor.entryPoint;
+
+	uint32_t defineCount = (uint32_t)compilationDescriptor.defines.size();
+	stream << defineCount;
+	compilationDescriptor.defines.resize(defineCount);
+
+	for (crstl::string& define : compilationDescriptor.defines)
+	{
+		stream << define;
+	}
+
+	stream << compilationDescriptor.platform;
+	stream << compilationDescriptor.graphicsApi;
+	stream << compilationDescriptor.shaderStage;
+	stream << compilationDescriptor.optimization;
+	stream << compilationDescriptor.metadata;
+}
+
+template<typename StreamT>
+static void SerializeResponse(StreamT& stream, bool& success, bool& cacheHit, crstl::string& status, crstl::vector<uint8_t>& output)
+{
+	stream << success;
+	stream << cacheHit;
+	stream << status;
+	stream << output;
+}
+
+static bool HashFile(const crstl::string& filename, CrHash& hash)
+{
+	if (crstl::file file = crstl::file(filename.c_str(), crstl::file_flags::read))
+	{
+		crstl::vector<uint8_t> fileData;
+		fileData.resize(file.get_size());
+		file.read(fileData.data(), fileData.size());
+		hash = CrHash(fileData.data(), fileData.size());
+		return true;
+	}
+
+	return false;
+}
+
+static bool AreDependenciesValid(const crstl::vector<CrShaderCompilerFileDependency>& dependencies)
+{
+	for (const CrShaderCompilerFileDependency& dependency : dependencies)
+	{
+		CrHash currentHash;
+
+		if (!HashFile(dependency.filename, currentHash) || currentHash != dependency.hash)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool SendConnectionStatus(CrLocalSocket& connection, CrShaderCompilerConnectionStatus::T connectionStatus)
+{
+	crstl::vector<uint8_t> handshakeBuffer;
+	CrWriteBufferStream handshakeStream(handshakeBuffer);
+	uint32_t version = CrShaderCompilerServerVersion::CurrentVersion;
+	handshakeStream << version;
+	handshakeStream << connectionStatus;
+	return connection.SendBuffer(handshakeBuffer);
+}
+
+static void ProcessCompileRequest
+(
+	CrShaderCompilerServerState* state,
+	CompilationDescriptor& compilationDescriptor,
+	const CrHash& requestHash,
+	bool& success,
+	bool& cacheHit,
+	crstl::string& status,
+	crstl::vector<uint8_t>& output
+)
+{
+	CrShaderCompilerCacheEntry cacheEntry;
+	bool foundCacheEntry = false;
+
+	{
+		CrScopedLock lock(state->mutex);
+
+		const auto cacheIterator = state->cache.find(requestHash);
+
+		if (cacheIterator != state->cache.end())
+		{
+			cacheEntry = cacheIterator->second;
+			foundCacheEntry = true;
+		}
+	}
+
+	CrShaderCompiler::CreatePDBDirectory(compilationDescriptor.platform, compilationDescriptor.graphicsApi);
+
+	// Validate outside of the lock, as it needs to read every dependency from disk
+	if (foundCacheEntry && AreDependenciesValid(cacheEntry.dependencies))
+	{
+		success = true;
+		cacheHit = true;
+		output = cacheEntry.compilationOutput;
+
+		CrScopedLock lock(state->mutex);
+		state->cacheHitCount++;
+		return;
+	}
+
+	crstl::timer compilationTime;
+	success = CrShaderCompiler::Compile(compilationDescriptor, output, status);
+	double compilationTimeMs = compilationTime.elapsed().milliseconds();
+
+	if (success)
+	{
+		cacheEntry.compilationOutput = output;
+		cacheEntry.dependencies.clear();
+
+		crstl::vector<crstl::string> dependencyFilenames = compilationDescriptor.includedFiles;
+
+		if (compilationDescriptor.inputSource.empty())
+		{
+			dependencyFilenames.push_back(compilationDescriptor.inputPath.c_str());
+		}
+
+		for (const crstl::string& dependencyFilename : dependencyFilenames)
+		{
+			CrShaderCompilerFileDependency dependency;
+			dependency.filename = dependencyFilename;
+			HashFile(dependencyFilename, dependency.hash);
+			cacheEntry.dependencies.push_back(dependency);
+		}
+	}
+
+	CrScopedLock lock(state->mutex);
+
+	state->compilationCount++;
+	state->compilationTimeMs += compilationTimeMs;
+
+	if (success)
+	{
+		state->cache.erase(requestHash);
+		state->cache.insert(requestHash, cacheEntry);
+	}
+	else
+	{
+		state->failedCompilationCount++;
+	}
+}
+
+static void ServeConnection(CrShaderCompilerServerState* state, CrLocalSocket* connection)
+{
+	crstl::vector<uint8_t> requestBuffer;
+
+	while (connection->ReceiveBuffer(requestBuffer))
+	{
+		bool success = false;
+		bool cacheHit = false;
+		crstl::string status;
+		crstl::vector<uint8_t> output;
+
+		CrReadBufferStream requestStream(requestBuffer.data(), requestBuffer.size());
+
+		uint32_t version = 0;
+		requestStream << version;
+
+		CrShaderCompilerRequestType::T requestType = CrShaderCompilerRequestType::Count;
+
+		if (version == CrShaderCompilerServerVersion::CurrentVersion)
+		{
+			requestStream << requestType;
+		}
+		else
+		{
+			status.append_sprintf("Shader compiler server version %u doesn't match client version %u", CrShaderCompilerServerVersion::CurrentVersion, version);
+		}
+
+		{
+			CrScopedLock lock(state->mutex);
+			state->requestCount++;
+		}
+
+		switch (requestType)
+		{
+			case CrShaderCompilerRequestType::Ping:
+			{
+				success = true;
+				break;
+			}
+			case CrShaderCompilerRequestType::Compile:
+			{
+				// The request uniquely identifies the compilation, as it contains everything the compiler gets as input
+				CrHash requestHash(requestBuffer.data(), requestBuffer.size());
+
+				CompilationDescriptor compilationDescriptor;
+				SerializeCompilationDescriptor(requestStream, compilationDescriptor);
+
+				if (requestStream.IsValid())
+				{
+					ProcessCompileRequest(state, compilationDescriptor, requestHash, success, cacheHit, status, output);
+				}
+				else
+				{
+					status = "Compile request is truncated";
+				}
+				break;
+			}
+			case CrShaderCompilerRequestType::Statistics:
+			{
+				CrScopedLock lock(state->mutex);
+				status.append_sprintf("Requests: %llu\nCached results: %llu\nCache hits: %llu\nCompilations: %llu (%llu failed, %.2f ms)\n",
+					(unsigned long long)state->requestCount,
+					(unsigned long long)state->cache.size(),
+					(unsigned long long)state->cacheHitCount,
+					(unsigned long long)state->compilationCount,
+					(unsigned long long)state->failedCompilationCount,
+					state->compilationTimeMs);
+				success = true;
+				break;
+			}
+			case CrShaderCompilerRequestType::Shutdown:
+			{
+				CrScopedLock lock(state->mutex);
+				state->shutdown = true;
+				success = true;
+				break;
+			}
+			default:
+				break;
+		}
+
+		crstl::vector<uint8_t> responseBuffer;
+		CrWriteBufferStream responseStream(responseBuffer);
+		uint32_t responseVersion = CrShaderCompilerServerVersion::CurrentVersion;
+		responseStream << responseVersion;
+		SerializeResponse(responseStream, success, cacheHit, status, output);
+
+		if (!connection->SendBuffer(responseBuffer) || requestType == CrShaderCompilerRequestType::Shutdown)
+		{
+			break;
+		}
+	}
+
+	bool shutdown = false;
+
+	{
+		CrScopedLock lock(state->mutex);
+
+		for (uint32_t i = 0; i < state->connections.size(); ++i)
+		{
+			if (state->connections[i] == connection)
+			{
+				state->connections[i] = state->connections.back();
+				state->connections.pop_back();
+				break;
+			}
+		}
+
+		shutdown = state->shutdown;
+	}
+
+	delete connection;
+
+	// The main thread is blocked waiting for connections. Connect to wake it up so that it sees the shutdown
+	if (shutdown)
+	{
+		CrLocalSocket wakeUpConnection;
+		wakeUpConnection.Connect(state->name.c_str());
+	}
+}
+
+bool CrShaderCompilerServer::Run(const char* name, uint32_t maxConcurrentConnections)
+{
+	CrLocalSocketServer socketServer;
+
+	if (!socketServer.Listen(name))
+	{
+		printf("Shader compiler server could not listen on %s. Is another server running?\n", name);
+		return false;
+	}
+
+	printf("Shader compiler server listening on %s\n", name);
+
+	CrShaderCompilerServerState state;
+	state.name = name;
+
+	{
+		CrThreadPool threadPool(maxConcurrentConnections);
+
+		while (true)
+		{
+			CrLocalSocket connection;
+
+			if (!socketServer.Accept(connection))
+			{
+				break;
+			}
+
+			CrLocalSocket* servedConnection = nullptr;
+			bool busy = false;
+
+			{
+				CrScopedLock lock(state.mutex);
+
+				if (state.shutdown)
+				{
+					// Connections that are still open would keep the server alive
+					for (CrLocalSocket* openConnection : state.connections)
+					{
+						openConnection->Disconnect();
+					}
+
+					break;
+				}
+
+				// A connection is served until the client disconnects, so if every thread is taken this one could
+				// wait indefinitely. Turn it away so the client compiles by itself instead
+				busy = state.connections.size() >= maxConcurrentConnections;
+
+				if (!busy)
+				{
+					servedConnection = new CrLocalSocket(crstl_move(connection));
+					state.connections.push_back(servedConnection);
+				}
+			}
+
+			if (busy)
+			{
+				SendConnectionStatus(connection, CrShaderCompilerConnectionStatus::Busy);
+				continue;
+			}
+
+			SendConnectionStatus(*servedConnection, CrShaderCompilerConnectionStatus::Accepted);
+
+			CrShaderCompilerServerState* statePointer = &state;
+			threadPool.Submit([statePointer, servedConnection]()
+			{
+				ServeConnection(statePointer, servedConnection);
+			});
+		}
+	}
+
+	printf("Shader compiler server shut down after %llu requests\n", (unsigned long long)state.requestCount);
+
+	return true;
+}
+
+bool CrShaderCompilerClient::Connect(const char* name)
+{
+	if (!m_socket.Connect(name))
+	{
+		return false;
+	}
+
+	m_socket.SetReceiveTimeout(ConnectionTimeoutMilliseconds);
+
+	crstl::vector<uint8_t> handshakeBuffer;
+
+	if (m_socket.ReceiveBuffer(handshakeBuffer))
+	{
+		CrReadBufferStream handshakeStream(handshakeBuffer.data(), handshakeBuffer.size());
+
+		uint32_t version = 0;
+		CrShaderCompilerConnectionStatus::T connectionStatus = CrShaderCompilerConnectionStatus::Busy;
+		handshakeStream << version;
+		handshakeStream << connectionStatus;
+
+		if (handshakeStream.IsValid() && version == CrShaderCompilerServerVersion::CurrentVersion && connectionStatus == CrShaderCompilerConnectionStatus::Accepted)
+		{
+			m_socket.SetReceiveTimeout(RequestTimeoutMilliseconds);
+			return true;
+		}
+	}
+
+	m_socket.Close();
+	return false;
+}
+
+bool CrShaderCompilerClient::SendRequest
+(
+	CrShaderCompilerRequestType::T requestType,
+	const CompilationDescriptor* compilationDescriptor,
+	bool& success,
+	bool& cacheHit,
+	crstl::string& status,
+	crstl::vector<uint8_t>& output
+)
+{
+	if (!m_socket.IsValid())
+	{
+		return false;
+	}
+
+	crstl::vector<uint8_t> requestBuffer;
+	CrWriteBufferStream requestStream(requestBuffer);
+
+	uint32_t version = CrShaderCompilerServerVersion::CurrentVersion;
+	requestStream << version;
+	requestStream << requestType;
+
+	if (compilationDescriptor)
+	{
+		CompilationDescriptor serializedDescriptor = *compilationDescriptor;
+
+		// The server doesn't share our working directory, so relative paths would resolve to the wrong file
+		if (!serializedDescriptor.inputPath.empty())
+		{
+			serializedDescriptor.inputPath = crcore::GetAbsolutePath(serializedDescriptor.inputPath);
+		}
+
+		SerializeCompilationDescriptor(requestStream, serializedDescriptor);
+	}
+
+	crstl::vector<uint8_t> responseBuffer;
+
+	if (!m_socket.SendBuffer(requestBuffer) || !m_socket.ReceiveBuffer(responseBuffer))
+	{
+		m_socket.Close();
+		return false;
+	}
+
+	CrReadBufferStream responseStream(responseBuffer.data(), responseBuffer.size());
+
+	uint32_t responseVersion = 0;
+	responseStream << responseVersion;
+
+	if (responseVersion != CrShaderCompilerServerVersion::CurrentVersion)
+	{
+		m_socket.Close();
+		return false;
+	}
+
+	SerializeResponse(responseStream, success, cacheHit, status, output);
+
+	if (!responseStream.IsValid())
+	{
+		m_socket.Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool CrShaderCompilerClient::Compile(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus, bool* cacheHit)
+{
+	bool success = false;
+	bool responseCacheHit = false;
+
+	if (SendRequest(CrShaderCompilerRequestType::Compile, &compilationDescriptor, success, responseCacheHit, compilationStatus, compilationOutput))
+	{
+		if (cacheHit)
+		{
+			*cacheHit = responseCacheHit;
+		}
+
+		return success;
+	}
+
+	return false;
+}
+
+bool CrShaderCompilerClient::CompileToFile(const CompilationDescriptor& compilationDescriptor, crstl::string& compilationStatus, bool* cacheHit)
+{
+	crstl::vector<uint8_t> compilationOutput;
+
+	if (Compile(compilationDescriptor, compilationOutput, compilationStatus, cacheHit))
+	{
+		return CrShaderCompiler::WriteOutputFile(compilationDescriptor, compilationOutput, compilationStatus);
+	}
+
+	return false;
+}
+
+bool CrShaderCompilerClient::Ping()
+{
+	bool success = false;
+	bool cacheHit = false;
+	crstl::string status;
+	crstl::vector<uint8_t> output;
+	return SendRequest(CrShaderCompilerRequestType::Ping, nullptr, success, cacheHit, status, output) && success;
+}
+
+bool CrShaderCompilerClient::GetStatistics(crstl::string& statistics)
+{
+	bool success = false;
+	bool cacheHit = false;
+	crstl::vector<uint8_t> output;
+	return SendRequest(CrShaderCompilerRequestType::Statistics, nullptr, success, cacheHit, statistics, output) && success;
+}
+
+bool CrShaderCompilerClient::Shutdown()
+{
+	bool success = false;
+	bool cacheHit = false;
+	crstl::string status;
+	crstl::vector<uint8_t> output;
+	return SendRequest(CrShaderCompilerRequestType::Shutdown, nullptr, success, cacheHit, status, output) && success;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Core/IPC/CrLocalSocket.h"
+
+#include "crstl/string.h"
+#include "crstl/vector.h"
+
+struct CompilationDescriptor;
+
+namespace CrShaderCompilerServerVersion
+{
+	enum T : uint32_t
+	{
+		InitialVersion,
+		ConnectionHandshake,
+		CurrentVersion = ConnectionHandshake
+	};
+};
+
+// Sent by the server as soon as a client connects
+namespace CrShaderCompilerConnectionStatus
+{
+	enum T : uint32_t
+	{
+		Accepted,
+		Busy, // Every thread is serving another connection. The client should compile by itself
+	};
+};
+
+namespace CrShaderCompilerRequestType
+{
+	enum T : uint32_t
+	{
+		Ping,
+		Compile,
+		Statistics,
+		Shutdown,
+		Count
+	};
+};
+
+// Long-lived shader compiler process. It keeps the compiler warm between requests and caches results in memory,
+// so that every tool that compiles shaders (the runtime, the builtin shader builder, etc) can share them. Cached
+// results are only reused while the source and every file it included are unchanged
+class CrShaderCompilerServer
+{
+public:
+
+	static const char* DefaultName;
+
+	// Listens on the given name and serves requests until a shutdown request is received. Every connection is
+	// served by one of up to maxConcurrentConnections threads, and connections beyond those are told the server
+	// is busy and closed, rather than waiting for a thread. Returns false if the server couldn't be started
+	static bool Run(const char* name, uint32_t maxConcurrentConnections);
+};
+
+// Connection to a shader compiler server. A client is meant to be used by one thread at a time
+class CrShaderCompilerClient
+{
+public:
+
+	// How long we wait for the server to accept the connection
+	static const uint32_t ConnectionTimeoutMilliseconds = 5000;
+
+	// How long we wait for the response to a request. Past this we assume the server is stuck, and disconnect
+	static const uint32_t RequestTimeoutMilliseconds = 120000;
+
+	// Returns false if there is no server, or it is busy serving other connections
+	bool Connect(const char* name);
+
+	bool IsConnected() const { return m_socket.IsValid(); }
+
+	// Returns false if the shader failed to compile or the connection was lost. In the latter case
+	// the client gets disconnected and compilationStatus remains empty
+	bool Compile(const CompilationDescriptor& compilationDescriptor, crstl::vector<uint8_t>& compilationOutput, crstl::string& compilationStatus, bool* cacheHit = nullptr);
+
+	// Compiles through the server and writes the result to the output path of the compilation descriptor
+	bool CompileToFile(const CompilationDescriptor& compilationDescriptor, crstl::string& compilationStatus, bool* cacheHit = nullptr);
+
+	bool Ping();
+
+	bool GetStatistics(crstl::string& statistics);
+
+	bool Shutdown();
+
+private:
+
+	bool SendRequest(CrShaderCompilerRequestType::T requestType, const CompilationDescriptor* compilationDescriptor, bool& success, bool& cacheHit, crstl::string& status, crstl::vector<uint8_t>& output);
+
+	CrLocalSocket m_socket;
+};
@@ -14,6 +14,7 @@
 
 #include "Core/CrCommandLine.h"
 #include "Core/Logging/ICrDebug.h"
+#include "Core/Streams/CrFileStream.h"
 
 #include "Math/CrMath.h"
 
@@ -84,22 +85,25 @@ namespace crgfx
 		CrAssert(vkResult == VK_SUCCESS);
 
 		// Load serialized pipeline cache from disk. This pipeline cache is invalid if the uuid doesn't match
-		crstl::vector<char> pipelineCacheData;
-		LoadPipelineCache(pipelineCacheData);
+		CrMappedFileStream pipelineCacheFile;
+		const uint8_t* pipelineCacheData = nullptr;
+		uint64_t pipelineCacheSize = 0;
+		LoadPipelineCache(pipelineCacheFile, pipelineCacheData, pipelineCacheSize);
 
 		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 
-		if (!pipelineCacheData.empty())
+		// The mapping is only needed until the pipeline cache has been created from it
+		if (pipelineCacheSize >= sizeof(VkPipelineCacheHeader))
 		{
-			const VkPipelineCacheHeader& pipelineCacheHeader = reinterpret_cast<VkPipelineCacheHeader&>(*pipelineCacheData.data());
+			const VkPipelineCacheHeader& pipelineCacheHeader = *reinterpret_cast<const VkPipelineCacheHeader*>(pipelineCacheData);
 			bool matchesUUID = memcmp(pipelineCacheHeader.uuid, m_vkPhysicalDeviceProperties2.properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
 
 			if (matchesUUID)
 			{
 				CrLog("Serialized pipeline cache matches UUID");
-				pipelineCacheCreateInfo.pInitialData = pipelineCacheData.data();
-				pipelineCacheCreateInfo.initialDataSize = pipelineCacheData.size();
+				pipelineCacheCreateInfo.pInitialData = pipelineCacheData;
+				pipelineCacheCreateInfo.initialDataSize = (size_t)pipelineCacheSize;
 			}
 			else
 			{
@@ -364,6 +368,55 @@ namespace crgfx
 		m_openBufferUploads.erase(bufferUploadIter);
 	}
 
+	void DeviceVulkan::CopyBufferUploadsPS(const BufferUpload* bufferUploads, uint32_t count)
+	{
+		CommandBufferVulkan* vulkanCommandBuffer = static_cast<CommandBufferVulkan*>(GetAuxiliaryCommandBuffer().get());
+
+		// All the barriers go in one batch before the copies and one after, rather than a pair per copy
+		crstl::vector<VkBufferMemoryBarrier> bufferMemoryBarriers;
+		bufferMemoryBarriers.resize(count);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const CrHardwareGPUBufferVulkan* vulkanDestinationBuffer = static_cast<const CrHardwareGPUBufferVulkan*>(bufferUploads[i].destinationBuffer);
+
+			VkBufferMemoryBarrier& bufferMemoryBarrier = bufferMemoryBarriers[i];
+			bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			bufferMemoryBarrier.pNext = nullptr;
+			bufferMemoryBarrier.srcAccessMask = VK_ACCESS_NONE_KHR;
+			bufferMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferMemoryBarrier.buffer = vulkanDestinationBuffer->GetVkBuffer();
+			bufferMemoryBarrier.offset = bufferUploads[i].destinationOffsetBytes;
+			bufferMemoryBarrier.size = bufferUploads[i].sizeBytes;
+		}
+
+		vkCmdPipelineBarrier(vulkanCommandBuffer->GetVkCommandBuffer(), VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, count, bufferMemoryBarriers.data(), 0, nullptr);
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const BufferUpload& bufferUpload = bufferUploads[i];
+			const CrHardwareGPUBufferVulkan* vulkanDestinationBuffer = static_cast<const CrHardwareGPUBufferVulkan*>(bufferUpload.destinationBuffer);
+			const CrHardwareGPUBufferVulkan* vulkanStagingBuffer = static_cast<const CrHardwareGPUBufferVulkan*>(bufferUpload.stagingBuffer.get());
+
+			VkBufferCopy bufferCopyRegion;
+			bufferCopyRegion.size = bufferUpload.sizeBytes;
+			bufferCopyRegion.srcOffset = bufferUpload.sourceOffsetBytes;
+			bufferCopyRegion.dstOffset = bufferUpload.destinationOffsetBytes;
+
+			vkCmdCopyBuffer(vulkanCommandBuffer->GetVkCommandBuffer(), vulkanStagingBuffer->GetVkBuffer(), vulkanDestinationBuffer->GetVkBuffer(), 1, &bufferCopyRegion);
+		}
+
+		for (VkBufferMemoryBarrier& bufferMemoryBarrier : bufferMemoryBarriers)
+		{
+			bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+
+		vkCmdPipelineBarrier(vulkanCommandBuffer->GetVkCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, count, bufferMemoryBarriers.data(), 0, nullptr);
+	}
+
 	HardwareGPUBufferHandle DeviceVulkan::DownloadBufferPS(const IHardwareGPUBuffer* sourceBuffer)
 	{
 		uint32_t stagingBufferSizeBytes = sourceBuffer->GetSizeBytes();
@@ -105,6 +105,8 @@ namespace crgfx
 
 		virtual void EndBufferUploadPS(const IHardwareGPUBuffer* destinationBuffer) override;
 
+		virtual void CopyBufferUploadsPS(const BufferUpload* bufferUploads, uint32_t count) override;
+
 		virtual HardwareGPUBufferHandle DownloadBufferPS(const IHardwareGPUBuffer* sourceBuffer) override;
 
 		virtual void SubmitCommandBufferPS(const crgfx::ICommandBuffer* commandBuffer, const IGPUSemaphore* waitSemaphore, const IGPUSemaphore* signalSemaphore, const IGPUFence* signalFence) override;
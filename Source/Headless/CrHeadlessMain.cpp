@@ -0,0 +1,85 @@
+#include "Graphics/IGraphicsSystem.h"
+#include "Graphics/IDevice.h"
+#include "Graphics/CrRendererConfig.h"
+#include "CrEngineInitialization.h"
+#include "CrFrame.h"
+
+#include "Core/Input/CrInputManager.h"
+#include "Core/CrCommandLine.h"
+#include "Core/Logging/ICrDebug.h"
+
+#include "Core/CrGlobalPaths.h"
+
+#include "CrOSWindow.h"
+
+#include <stdlib.h>
+
+// Runs a number of frames on the Null graphics system without opening a window or needing a GPU, so
+// that continuous integration can check the renderer initializes, records and presents frames. Anything
+// the Null device finds invalid asserts
+//
+// CrHeadless -root <data path> [-frames <count>] [-resolution <width>x<height>] [-textureBudget <megabytes>]
+int main(int argc, char* argv[])
+{
+	crcore::CommandLine = CrCommandLineParser(argc, argv);
+
+	const crstl::string& dataPath = crcore::CommandLine("-root");
+	const crstl::string& framesString = crcore::CommandLine("-frames");
+
+	if (dataPath.empty())
+	{
+		CrLog("No root on the command line");
+		return 1;
+	}
+
+	uint32_t frameCount = 10;
+
+	if (!framesString.empty())
+	{
+		frameCount = (uint32_t)atoi(framesString.c_str());
+	}
+
+	uint32_t screenWidth = 1280;
+	uint32_t screenHeight = 720;
+
+	crstl::string resolution = crcore::CommandLine("-resolution").c_str();
+	if (!resolution.empty() && !CrParseResolution(resolution, screenWidth, screenHeight))
+	{
+		return 1;
+	}
+
+	CrGlobalPaths::SetupGlobalPaths(argv[0], dataPath.c_str());
+
+	crgfx::GraphicsSystemDescriptor graphicsSystemDescriptor;
+	graphicsSystemDescriptor.graphicsApi = crgfx::GraphicsApi::Null;
+
+	crgfx::DeviceDescriptor graphicsDeviceDescriptor;
+
+	CrInitializeEngine(graphicsSystemDescriptor, graphicsDeviceDescriptor);
+
+	CrOSWindowDescriptor osWindowDescriptor;
+	osWindowDescriptor.swapchainFormat = CrRendererConfig::SwapchainFormat;
+	osWindowDescriptor.width = screenWidth;
+	osWindowDescriptor.height = screenHeight;
+	osWindowDescriptor.name = "Headless Window";
+	crstl::intrusive_ptr<CrOSWindow> mainWindow = crstl::intrusive_ptr<CrOSWindow>(new CrOSWindow(osWindowDescriptor));
+
+	CrFrame frame;
+	frame.Initialize(mainWindow);
+
+	for (uint32_t i = 0; i < frameCount; ++i)
+	{
+		CrInput.Update();
+		frame.Process();
+	}
+
+	crgfx::GetDevice()->WaitIdle();
+
+	frame.Deinitialize();
+
+	CrDeinitializeEngine();
+
+	CrLog("Ran %u frames on the Null graphics system", frameCount);
+
+	return 0;
+}
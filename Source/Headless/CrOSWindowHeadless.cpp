@@ -0,0 +1,132 @@
+#include "CrOSWindow.h"
+
+#include "Core/CrMacros.h"
+
+#include "Graphics/IGraphicsSystem.h"
+#include "Graphics/IDevice.h"
+
+// A window without a native window behind it, for running frames where there is no display. It only owns its
+// swapchain, which takes the size of the window. There's nothing to show, so it's never minimized or focused
+
+CrOSWindow::CrOSWindow(const CrOSWindowDescriptor& windowDescriptor)
+{
+	// There's no native handle, so the window stands in for its own until it's destroyed
+	m_hwnd = this;
+
+	if (windowDescriptor.swapchainFormat != crgfx::DataFormat::Invalid)
+	{
+		crgfx::SwapchainDescriptor swapchainDescriptor = {};
+		swapchainDescriptor.name = windowDescriptor.name.c_str();
+		swapchainDescriptor.window = this;
+		swapchainDescriptor.requestedWidth = windowDescriptor.width;
+		swapchainDescriptor.requestedHeight = windowDescriptor.height;
+		swapchainDescriptor.format = windowDescriptor.swapchainFormat;
+		swapchainDescriptor.requestedBufferCount = 3;
+		m_swapchain = crgfx::GetDevice()->CreateSwapchain(swapchainDescriptor);
+		m_swapchain->AcquireNextImage();
+	}
+}
+
+CrOSWindow::~CrOSWindow()
+{
+	Destroy();
+}
+
+void CrOSWindow::Initialize()
+{
+
+}
+
+void CrOSWindow::SetCursor(CursorType::T cursorType)
+{
+	unused_parameter(cursorType);
+}
+
+void CrOSWindow::Destroy()
+{
+	m_hwnd = nullptr;
+}
+
+bool CrOSWindow::GetIsMinimized() const
+{
+	return false;
+}
+
+bool CrOSWindow::GetIsFocused() const
+{
+	return false;
+}
+
+bool CrOSWindow::GetIsDestroyed() const
+{
+	return m_hwnd == nullptr;
+}
+
+void* CrOSWindow::GetNativeWindowHandle() const
+{
+	return nullptr;
+}
+
+void* CrOSWindow::GetParentWindowHandle() const
+{
+	return nullptr;
+}
+
+void* CrOSWindow::GetNativeInstanceHandle() const
+{
+	return nullptr;
+}
+
+void CrOSWindow::GetPosition(uint32_t& positionX, uint32_t& positionY) const
+{
+	positionX = 0;
+	positionY = 0;
+}
+
+void CrOSWindow::GetSizePixels(uint32_t& width, uint32_t& height) const
+{
+	if (m_swapchain)
+	{
+		width = m_swapchain->GetWidth();
+		height = m_swapchain->GetHeight();
+	}
+	else
+	{
+		width = 1;
+		height = 1;
+	}
+}
+
+void CrOSWindow::SetPosition(uint32_t positionX, uint32_t positionY)
+{
+	unused_parameter(positionX);
+	unused_parameter(positionY);
+}
+
+void CrOSWindow::SetSizePixels(uint32_t width, uint32_t height)
+{
+	if (m_swapchain)
+	{
+		m_swapchain->Resize(width, height);
+	}
+}
+
+void CrOSWindow::SetFocus()
+{
+
+}
+
+void CrOSWindow::SetTitle(const char* title)
+{
+	unused_parameter(title);
+}
+
+void CrOSWindow::SetTransparencyAlpha(float alpha)
+{
+	unused_parameter(alpha);
+}
+
+void CrOSWindow::Show()
+{
+
+}
@@ -0,0 +1,338 @@
+#include "Resource/CrResource_pch.h"
+
+#include "Resource/CrResource.h"
+#include "Resource/CrResourceManager.h"
+#include "Resource/CrTextureStreamer.h"
+
+#include "Core/Logging/ICrDebug.h"
+#include "Core/Streams/CrFileStream.h"
+
+#include "Graphics/CommonResources.h"
+#include "Graphics/CrImage.h"
+#include "Graphics/IGraphicsSystem.h"
+#include "Graphics/IDevice.h"
+#include "Graphics/ITexture.h"
+#include "Graphics/GPUBuffer.h"
+#include "Graphics/CrMaterial.h"
+#include "Graphics/CrMaterialCompiler.h"
+#include "Graphics/CrRenderMesh.h"
+#include "Graphics/CrRenderModel.h"
+#include "Graphics/CrCommonVertexLayouts.h"
+
+#include "Resource/Image/ICrImageCodec.h"
+#include "Resource/Image/CrTextureCooker.h"
+#include "Resource/Model/ICrModelDecoder.h"
+#include "Resource/Model/CrModelData.h"
+#include "Resource/Model/CrCookedModel.h"
+
+#include "crstl/filesystem.h"
+
+// Bound in place of a texture that failed to load, so that the material still renders with a neutral value
+static const crgfx::TextureHandle& GetFallbackTexture(Textures::T semantic)
+{
+	switch (semantic)
+	{
+		case Textures::NormalTexture0: return crgfx::NormalsSmallTexture;
+		case Textures::EmissiveTexture0: return crgfx::BlackSmallTexture;
+		default: return crgfx::WhiteSmallTexture;
+	}
+}
+
+CrResource::CrResource(CrResourceType::T type, const CrFixedPath& path)
+	: m_type(type)
+	, m_state(CrResourceState::Pending)
+	, m_priority(CrResourcePriority::Normal)
+	, m_path(path)
+	, m_cacheKey(0)
+	, m_loadSucceeded(false)
+	, m_cancelled(false)
+	, m_loadingTime(0.0)
+	, m_loadingCPUTime(0.0)
+{
+
+}
+
+CrResource::~CrResource()
+{
+	if (ResourceManager)
+	{
+		ResourceManager->RemoveFromCache(this);
+	}
+}
+
+CrTextureResource::CrTextureResource(const CrFixedPath& path, Textures::T semantic)
+	: CrResource(CrResourceType::Texture, path)
+	, m_semantic(semantic)
+{
+
+}
+
+bool CrTextureResource::Load(crstl::file& file)
+{
+	crstl::unique_ptr<ICrImageDecoder> imageDecoder = ICrImageDecoder::Create(GetPath());
+
+	// DDS files are already in their final form
+	if (GetPath().extension().comparei(".dds") == 0)
+	{
+		m_image = imageDecoder->Decode(file);
+		m_streamingPath = GetPath();
+		return m_image != nullptr;
+	}
+
+	// The cooked texture is found by the contents of the source, so we need all of it anyway. Map it so that
+	// hashing and decoding work on it in place
+	CrMappedFileStream sourceFile(GetPath().c_str());
+
+	if (!sourceFile)
+	{
+		return false;
+	}
+
+	CrTextureCookSettings cookSettings(m_semantic);
+	CrHash cacheKey = CrTextureCooker::GetCacheKey(sourceFile.GetData(), sourceFile.GetSize(), cookSettings);
+
+	m_image = CrTextureCooker::LoadFromCache(cacheKey);
+
+	bool isCached = m_image != nullptr;
+
+	if (!m_image)
+	{
+		CrImageHandle sourceImage = imageDecoder->Decode((void*)sourceFile.GetData(), sourceFile.GetSize());
+
+		if (sourceImage)
+		{
+			m_image = CrTextureCooker::Cook(sourceImage, cookSettings);
+
+			// The next time the texture is loaded it only needs copying
+			isCached = CrTextureCooker::SaveToCache(m_image, cacheKey);
+		}
+	}
+
+	// Mips are streamed from the cooked texture
+	if (isCached)
+	{
+		m_streamingPath = CrTextureCooker::GetCachePath(cacheKey);
+	}
+
+	return m_image != nullptr;
+}
+
+bool CrTextureResource::Finalize()
+{
+	m_streamedTexture = TextureStreamer->CreateStreamedTexture(m_image, m_streamingPath, GetPath().c_str());
+
+	// The texture has its own copy of the data now, and the streamer loads the rest from the file
+	m_image = nullptr;
+
+	return m_streamedTexture != nullptr;
+}
+
+CrModelResource::CrModelResource(const CrFixedPath& path) : CrResource(CrResourceType::Model, path)
+{
+
+}
+
+CrModelResource::~CrModelResource()
+{
+
+}
+
+bool CrModelResource::Load(crstl::file& file)
+{
+	m_modelData = crstl::unique_ptr<CrModelData>(new CrModelData());
+	m_modelData->SetUploadDevice(crgfx::GetDevice().get());
+
+	bool modelLoaded = false;
+
+	if (GetPath().extension().comparei(".crmodel") == 0)
+	{
+		modelLoaded = CrCookedModel::Load(GetPath(), 0, *m_modelData);
+	}
+	else
+	{
+		// Prefer the cooked model if it's there. It needs no processing other than copying the streams into buffers
+		CrFixedPath cookedModelPath = CrCookedModel::GetCookedModelPath(GetPath());
+
+		if (crstl::exists(cookedModelPath.c_str()))
+		{
+			// Hashing reads the whole source, but that's much cheaper than decoding it. Any edit makes it out of date
+			uint64_t sourceHash = CrCookedModel::ComputeSourceHash(GetPath());
+
+			modelLoaded = sourceHash != 0 && CrCookedModel::Load(cookedModelPath, sourceHash, *m_modelData);
+
+			if (!modelLoaded)
+			{
+				// Start over with the source asset
+				m_modelData = crstl::unique_ptr<CrModelData>(new CrModelData());
+				m_modelData->SetUploadDevice(crgfx::GetDevice().get());
+			}
+		}
+
+		if (!modelLoaded)
+		{
+			crstl::unique_ptr<ICrModelDecoder> modelDecoder = ICrModelDecoder::Create(GetPath(), ResourceManager->GetDecodingThreadPool());
+			modelLoaded = modelDecoder->Decode(file, *m_modelData);
+		}
+	}
+
+	if (modelLoaded)
+	{
+		crstl::vector<CrMaterialDescriptor> materialDescriptors;
+		materialDescriptors.reserve(m_modelData->materials.size());
+
+		for (const CrModelMaterialData& materialData : m_modelData->materials)
+		{
+			CrMaterialDescriptor materialDescriptor;
+			materialDescriptor.color = materialData.color;
+			materialDescriptor.textureMode = materialData.textures.empty() ? CrMaterialTextureMode::Untextured : CrMaterialTextureMode::Textured;
+			materialDescriptors.push_back(materialDescriptor);
+
+			for (const CrModelTextureData& textureData : materialData.textures)
+			{
+				CrTextureDependency textureDependency;
+				textureDependency.path = GetPath().parent_path() / textureData.path;
+				textureDependency.semantic = textureData.semantic;
+				m_textureDependencies.push_back(textureDependency);
+			}
+		}
+
+		// Compile all materials together so that their shaders are compiled in parallel. Doing it here keeps
+		// shader compilation off the main thread, and it overlaps with the loading of the textures
+		MaterialCompiler->CompileMaterials(materialDescriptors, m_materials);
+
+		for (uint32_t m = 0; m < m_materials.size(); ++m)
+		{
+			m_materials[m]->m_color = materialDescriptors[m].color;
+		}
+	}
+
+	return modelLoaded;
+}
+
+bool CrModelResource::Finalize()
+{
+	const crgfx::DeviceHandle& renderDevice = crgfx::GetDevice();
+
+	CrRenderModelDescriptor modelDescriptor;
+
+	for (uint32_t m = 0; m < m_modelData->materials.size(); ++m)
+	{
+		const CrModelMaterialData& materialData = m_modelData->materials[m];
+		const CrMaterialHandle& material = m_materials[m];
+
+		for (const CrModelTextureData& textureData : materialData.textures)
+		{
+			// Textures are dependencies of the model so they have finished by now, but they may have failed
+			CrStreamedTextureHandle texture = ResourceManager->GetTexture(GetPath().parent_path() / textureData.path, textureData.semantic);
+
+			if (texture)
+			{
+				material->AddTexture(texture, textureData.semantic);
+			}
+			else
+			{
+				CrLog("Texture %s of %s is missing, using a default", textureData.path.c_str(), GetPath().c_str());
+				material->AddTexture(GetFallbackTexture(textureData.semantic), textureData.semantic);
+			}
+		}
+
+		modelDescriptor.AddMaterial(material);
+	}
+
+	for (const CrModelMeshData& meshData : m_modelData->meshes)
+	{
+		if (meshData.vertexCount == 0 || meshData.materialIndex >= m_modelData->materials.size())
+		{
+			CrLog("Invalid mesh in %s", GetPath().c_str());
+			continue;
+		}
+
+		CrRenderMeshHandle renderMesh = CrRenderMeshHandle(new CrRenderMesh());
+
+		const crgfx::VertexDescriptor& positionVertexDescriptor = GetPositionVertexDescriptor(meshData.positionFormat);
+
+		crgfx::VertexBufferHandle positionBuffer = renderDevice->CreateVertexBuffer(crgfx::MemoryAccess::GPUOnlyRead, positionVertexDescriptor, meshData.vertexCount);
+		crgfx::VertexBufferHandle additionalBuffer = renderDevice->CreateVertexBuffer(crgfx::MemoryAccess::GPUOnlyRead, AdditionalVertexDescriptor, meshData.vertexCount);
+
+		QueueStreamUpload(positionBuffer->GetHardwareBuffer(), meshData.positions);
+		QueueStreamUpload(additionalBuffer->GetHardwareBuffer(), meshData.additionalVertices);
+
+		renderMesh->AddVertexBuffer(positionBuffer);
+		renderMesh->AddVertexBuffer(additionalBuffer);
+
+		renderMesh->SetBoundingBox(meshData.boundingBox);
+
+		if (meshData.positionFormat != CrVertexPositionFormat::Half)
+		{
+			renderMesh->SetPositionDequantization(meshData.positionScale, meshData.positionOffset);
+		}
+
+		renderMesh->SetUVDensity(meshData.uvDensity);
+
+		if (meshData.instanceTransforms)
+		{
+			renderMesh->SetInstanceTransforms(meshData.instanceTransforms, meshData.instanceCount);
+		}
+
+		if (meshData.meshlets)
+		{
+			renderMesh->SetMeshlets
+			(
+				meshData.meshlets, meshData.meshletCount, meshData.meshletVertices, meshData.meshletVertexCount,
+				meshData.meshletTriangles, meshData.meshletTriangleCount
+			);
+		}
+
+		if (meshData.indices)
+		{
+			crgfx::IndexBufferHandle indexBuffer = renderDevice->CreateIndexBuffer(crgfx::MemoryAccess::GPUOnlyRead, meshData.indexFormat, meshData.indexCount);
+
+			QueueStreamUpload(indexBuffer->GetHardwareBuffer(), meshData.indices);
+
+			renderMesh->SetIndexBuffer(indexBuffer);
+		}
+
+		modelDescriptor.AddRenderMesh(renderMesh, (uint8_t)meshData.materialIndex);
+	}
+
+	m_model = CrRenderModelHandle(new CrRenderModel(modelDescriptor));
+
+	// Free the streams, or unmap the cooked model. The render model holds on to the materials now
+	m_modelData = nullptr;
+	m_materials.clear();
+
+	return true;
+}
+
+bool CrModelResource::AreUploadsComplete() const
+{
+	const crgfx::DeviceHandle& renderDevice = crgfx::GetDevice();
+
+	for (crgfx::GPUUploadId uploadId : m_uploads)
+	{
+		if (!renderDevice->IsUploadComplete(uploadId))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Streams the decoder wrote into upload memory are queued as they are. Anything else is copied into a staging page
+void CrModelResource::QueueStreamUpload(const crgfx::IHardwareGPUBuffer* buffer, const void* stream)
+{
+	const crgfx::DeviceHandle& renderDevice = crgfx::GetDevice();
+
+	// Resource and upload priorities line up
+	crgfx::UploadPriority::T uploadPriority = (crgfx::UploadPriority::T)GetPriority();
+
+	if (crgfx::UploadMemory* uploadMemory = m_modelData->FindUploadMemory(stream))
+	{
+		m_uploads.push_back(renderDevice->QueueBufferUpload(buffer, *uploadMemory, uploadPriority));
+	}
+	else
+	{
+		m_uploads.push_back(renderDevice->QueueBufferUpload(buffer, stream, uploadPriority));
+	}
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "Core/FileSystem/CrFixedPath.h"
+#include "Graphics/CrGraphicsForwardDeclarations.h"
+#include "Graphics/CrStreamedTexture.h"
+#include "Image/CrImageForwardDeclarations.h"
+
+#include "crstl/intrusive_ptr.h"
+#include "crstl/unique_ptr.h"
+#include "crstl/vector.h"
+
+class CrModelData;
+
+class CrResource;
+using CrResourceHandle = crstl::intrusive_ptr<CrResource>;
+
+class CrTextureResource;
+using CrTextureResourceHandle = crstl::intrusive_ptr<CrTextureResource>;
+
+class CrModelResource;
+using CrModelResourceHandle = crstl::intrusive_ptr<CrModelResource>;
+
+namespace CrResourceType
+{
+	enum T : uint8_t
+	{
+		Texture,
+		Model,
+		Count
+	};
+};
+
+namespace CrResourceState
+{
+	enum T : uint8_t
+	{
+		Pending,                // Waiting for a loading thread, or being loaded on one
+		WaitingForDependencies, // Loaded, but some of the resources it needs are not ready yet
+		WaitingForUploads,      // Finalized, but the device hasn't copied all of its data to the GPU yet
+		Loaded,
+		Failed,
+		Cancelled
+	};
+};
+
+namespace CrResourcePriority
+{
+	enum T : uint8_t
+	{
+		Low,
+		Normal,
+		High,
+		Count
+	};
+};
+
+// A texture a resource needs, and the material slot it's bound to, which decides how it's cooked
+struct CrTextureDependency
+{
+	CrFixedPath path;
+
+	Textures::T semantic;
+};
+
+// Anything the resource manager loads. Loading happens in two steps. Load reads and decodes the file on a loading
+// thread, and Finalize runs on the main thread once the resource and everything it depends on has loaded, and creates
+// whatever needs the graphics device. Handles must only be copied and released on the main thread
+class CrResource : public crstl::intrusive_ptr_interface_delete
+{
+public:
+
+	CrResource(CrResourceType::T type, const CrFixedPath& path);
+
+	virtual ~CrResource();
+
+	CrResourceType::T GetType() const { return m_type; }
+
+	const CrFixedPath& GetPath() const { return m_path; }
+
+	CrResourceState::T GetState() const { return m_state; }
+
+	CrResourcePriority::T GetPriority() const { return m_priority; }
+
+	// Whether the resource has been loaded, has failed or has been cancelled. Its state won't change anymore
+	bool IsFinished() const { return m_state >= CrResourceState::Loaded; }
+
+	bool IsLoaded() const { return m_state == CrResourceState::Loaded; }
+
+protected:
+
+	// Runs on a loading thread, so it must not use the graphics device
+	virtual bool Load(crstl::file& file) = 0;
+
+	// Runs on the main thread once the resource and its dependencies have finished loading
+	virtual bool Finalize() { return true; }
+
+	// Polled after Finalize. The resource stays in WaitingForUploads until it returns true
+	virtual bool AreUploadsComplete() const { return true; }
+
+	// Textures found while loading. They are requested with the same priority and need to finish before Finalize
+	crstl::vector<CrTextureDependency> m_textureDependencies;
+
+private:
+
+	friend class CrResourceManager;
+
+	CrResourceType::T m_type;
+
+	CrResourceState::T m_state;
+
+	CrResourcePriority::T m_priority;
+
+	CrFixedPath m_path;
+
+	uint64_t m_cacheKey;
+
+	crstl::vector<CrResourceHandle> m_dependencies;
+
+	// Written by the loading thread and read by the main thread, both under the resource manager's lock
+	bool m_loadSucceeded;
+
+	bool m_cancelled;
+
+	double m_loadingTime;
+
+	double m_loadingCPUTime;
+};
+
+// Loads the cooked version of the image on a loading thread, cooking it first if it isn't in the texture cache,
+// and creates the texture from it on the main thread. The texture starts with its smallest mips and the texture
+// streamer loads the rest from the cooked DDS when they are needed
+class CrTextureResource final : public CrResource
+{
+public:
+
+	CrTextureResource(const CrFixedPath& path, Textures::T semantic);
+
+	const crgfx::TextureHandle& GetTexture() const { return m_streamedTexture->GetTexture(); }
+
+	const CrStreamedTextureHandle& GetStreamedTexture() const { return m_streamedTexture; }
+
+protected:
+
+	virtual bool Load(crstl::file& file) override;
+
+	virtual bool Finalize() override;
+
+private:
+
+	// Only kept until the texture is created
+	CrImageHandle m_image;
+
+	// DDS file the streamer loads the mips from. Empty if there is none
+	CrFixedPath m_streamingPath;
+
+	Textures::T m_semantic;
+
+	CrStreamedTextureHandle m_streamedTexture;
+};
+
+// Decodes the model on a loading thread, or maps its cooked version if there is an up to date one, and compiles
+// its materials there too. The model is created on the main thread once its textures have loaded
+class CrModelResource final : public CrResource
+{
+public:
+
+	CrModelResource(const CrFixedPath& path);
+
+	~CrModelResource();
+
+	const CrRenderModelHandle& GetModel() const { return m_model; }
+
+protected:
+
+	virtual bool Load(crstl::file& file) override;
+
+	virtual bool Finalize() override;
+
+	virtual bool AreUploadsComplete() const override;
+
+private:
+
+	void QueueStreamUpload(const crgfx::IHardwareGPUBuffer* buffer, const void* stream);
+
+	// Only kept until the model is created
+	crstl::unique_ptr<CrModelData> m_modelData;
+
+	// One per material in the model data, compiled while loading. Textures are added once they have loaded
+	crstl::vector<CrMaterialHandle> m_materials;
+
+	// Uploads of the vertex and index buffers, queued in the device with the priority of the resource
+	crstl::vector<crgfx::GPUUploadId> m_uploads;
+
+	CrRenderModelHandle m_model;
+};
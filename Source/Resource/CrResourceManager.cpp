@@ -10,90 +10,483 @@
 #include "Core/CrCommandLine.h"
 #include "Core/Logging/ICrDebug.h"
 #include "Core/FileSystem/CrFixedPath.h"
+#include "Core/Streams/CrFileStream.h"
+#include "Core/Threading/CrThreadPool.h"
 
 #include "Resource/Image/CrImageCodecDDS.h"
 #include "Resource/Image/CrImageCodecSTB.h"
 #include "Resource/Image/CrImageCodecWuffs.h"
 
-#include "Resource/Model/ICrModelDecoder.h"
-#include "Resource/Model/CrModelDecoderASSIMP.h"
-#include "Resource/Model/CrModelDecoderCGLTF.h"
-#include "Resource/Model/CrModelDecoderUFBX.h"
+CrResourceManager* ResourceManager;
 
-CrRenderModelHandle CrResourceManager::LoadModel(const CrFixedPath& fullPath)
+void CrResourceManager::Initialize()
 {
-	crstl::file file(fullPath.c_str(), crstl::file_flags::read);
+	CrAssert(ResourceManager == nullptr);
+	ResourceManager = new CrResourceManager();
+}
 
-	if (file)
+void CrResourceManager::Deinitialize()
+{
+	CrAssert(ResourceManager != nullptr);
+	delete ResourceManager;
+	ResourceManager = nullptr;
+}
+
+CrResourceManager::CrResourceManager()
+{
+	// Loading is a mix of disk access and decoding, so we use every hardware thread. The main thread
+	// is also busy rendering, so leaving it out doesn't make much of a difference
+	m_loadingThreadPool = crstl::unique_ptr<CrThreadPool>(new CrThreadPool());
+
+	// Models fan out their meshes so that a single large model doesn't keep one loading thread busy on its own
+	m_decodingThreadPool = crstl::unique_ptr<CrThreadPool>(new CrThreadPool());
+}
+
+CrResourceManager::~CrResourceManager()
+{
+	// Anything that hasn't started loading is dropped, then we wait for the rest
 	{
-		crstl::unique_ptr<ICrModelDecoder> modelDecoder;
-		CrFixedPath extension = fullPath.extension();
-		if (extension.comparei(".gltf") == 0 || extension.comparei(".glb") == 0)
+		CrScopedLock lock(m_mutex);
+
+		for (uint32_t p = 0; p < CrResourcePriority::Count; ++p)
 		{
-			modelDecoder = crstl::unique_ptr<ICrModelDecoder>(new CrModelDecoderCGLTF());
+			m_queuedResources[p].clear();
 		}
-		else if (extension.comparei(".fbx") == 0 || extension.comparei(".obj") == 0)
+	}
+
+	// Loading threads may be waiting on decoding jobs, so they go first
+	m_loadingThreadPool = nullptr;
+	m_decodingThreadPool = nullptr;
+
+	m_loadedResources.clear();
+
+	// Resources that outlive the manager must not try to remove themselves from the cache
+	for (auto cacheIterator = m_resourceCache.begin(); cacheIterator != m_resourceCache.end(); ++cacheIterator)
+	{
+		cacheIterator->second->m_cacheKey = 0;
+	}
+
+	m_resourceCache.clear();
+	m_pendingResources.clear();
+}
+
+CrModelResourceHandle CrResourceManager::LoadModel(const CrFixedPath& fullPath, CrResourcePriority::T priority)
+{
+	return RequestResource<CrModelResource>(CrResourceType::Model, fullPath, priority);
+}
+
+CrTextureResourceHandle CrResourceManager::LoadTexture(const CrFixedPath& fullPath, Textures::T semantic, CrResourcePriority::T priority)
+{
+	return RequestResource<CrTextureResource>(CrResourceType::Texture, fullPath, priority, semantic);
+}
+
+CrStreamedTextureHandle CrResourceManager::GetTexture(const CrFixedPath& fullPath, Textures::T semantic)
+{
+	CrTextureResourceHandle texture = LoadTexture(fullPath, semantic, CrResourcePriority::High);
+	Wait(CrResourceHandle(texture.get()));
+	return texture->GetStreamedTexture();
+}
+
+template<typename ResourceT, typename... ArgsT>
+crstl::intrusive_ptr<ResourceT> CrResourceManager::RequestResource(CrResourceType::T type, const CrFixedPath& fullPath, CrResourcePriority::T priority, const ArgsT&... args)
+{
+	CrHash cacheKey(fullPath.c_str(), (uint32_t)fullPath.length());
+	cacheKey << CrHash(type);
+
+	m_statistics.requestedCount++;
+
+	const auto cacheIterator = m_resourceCache.find(cacheKey.GetHash());
+
+	if (cacheIterator != m_resourceCache.end())
+	{
+		CrResource* cachedResource = cacheIterator->second;
+
+		bool cancelled;
+
 		{
-			modelDecoder = crstl::unique_ptr<ICrModelDecoder>(new CrModelDecoderUFBX());
+			CrScopedLock lock(m_mutex);
+			cancelled = cachedResource->m_cancelled;
 		}
-		else
+
+		// A cancelled resource is loaded again from scratch. One that was cancelled while loading is still pending,
+		// but it's discarded once the loading thread is done with it, so it cannot be handed out either
+		if (!cancelled && cachedResource->GetState() != CrResourceState::Cancelled)
 		{
-			modelDecoder = crstl::unique_ptr<ICrModelDecoder>(new CrModelDecoderASSIMP());
+			m_statistics.cacheHitCount++;
+
+			if (priority > cachedResource->GetPriority())
+			{
+				SetPriority(CrResourceHandle(cachedResource), priority);
+			}
+
+			return crstl::intrusive_ptr<ResourceT>(static_cast<ResourceT*>(cachedResource));
 		}
 
-		CrRenderModelHandle model = modelDecoder->Decode(file);
+		cachedResource->m_cacheKey = 0;
+		m_resourceCache.erase(cacheIterator);
+	}
+
+	ResourceT* resource = new ResourceT(fullPath, args...);
+	resource->m_priority = priority;
+	resource->m_cacheKey = cacheKey.GetHash();
+	m_resourceCache.insert(cacheKey.GetHash(), resource);
 
-		return model;
+	if (m_pendingResources.empty())
+	{
+		m_loadingStartTime = crstl::time::now();
+	}
+
+	m_pendingResources.push_back(CrResourceHandle(resource));
+
+	{
+		CrScopedLock lock(m_mutex);
+		m_queuedResources[priority].push_back(resource);
+	}
+
+	// Every job loads whichever resource has the highest priority at the time it runs, not necessarily this one
+	m_loadingThreadPool->Submit([this]() { LoadNextResource(); });
+
+	return crstl::intrusive_ptr<ResourceT>(resource);
+}
+
+void CrResourceManager::SetPriority(const CrResourceHandle& resource, CrResourcePriority::T priority)
+{
+	if (resource->m_priority == priority)
+	{
+		return;
+	}
+
+	if (RemoveFromQueue(resource.get()))
+	{
+		CrScopedLock lock(m_mutex);
+		m_queuedResources[priority].push_back(resource.get());
+	}
+
+	resource->m_priority = priority;
+}
+
+void CrResourceManager::Cancel(const CrResourceHandle& resource)
+{
+	if (resource->IsFinished())
+	{
+		return;
+	}
+
+	if (resource->m_state == CrResourceState::WaitingForDependencies || resource->m_state == CrResourceState::WaitingForUploads || RemoveFromQueue(resource.get()))
+	{
+		FinishResource(resource.get(), CrResourceState::Cancelled);
 	}
 	else
 	{
-		return nullptr;
+		// It's loading right now. We'll discard it when the loading thread is done with it
+		CrScopedLock lock(m_mutex);
+		resource->m_cancelled = true;
 	}
 }
 
-CrFixedPath CrResourceManager::GetFullResourcePath(const CrFixedPath& relativePath)
+void CrResourceManager::Wait(const CrResourceHandle& resource)
 {
-	crstl::string dataPath = crcore::CommandLine("-root").c_str();
-	return CrFixedPath(dataPath.c_str()) / relativePath;
+	while (!resource->IsFinished())
+	{
+		if (resource->m_state == CrResourceState::WaitingForDependencies)
+		{
+			// Copy them as finalizing the resource clears them
+			crstl::vector<CrResourceHandle> dependencies = resource->m_dependencies;
+
+			for (const CrResourceHandle& dependency : dependencies)
+			{
+				Wait(dependency);
+			}
+
+			TryFinalizeResource(resource.get());
+		}
+		else if (resource->m_state == CrResourceState::WaitingForUploads)
+		{
+			// Record every queued copy now rather than wait for the budget of later frames
+			crgfx::GetDevice()->FlushUploads();
+			FinishResource(resource.get(), CrResourceState::Loaded);
+		}
+		else if (RemoveFromQueue(resource.get()))
+		{
+			// Rather than wait for a loading thread to pick it up, load it here
+			LoadResource(resource.get());
+		}
+		else
+		{
+			// A loading thread has it, wait until it hands it over
+			CrScopedLock lock(m_mutex);
+
+			while (true)
+			{
+				bool loaded = false;
+
+				for (uint32_t i = 0; i < m_loadedResources.size(); ++i)
+				{
+					if (m_loadedResources[i] == resource.get())
+					{
+						m_loadedResources.erase(m_loadedResources.begin() + i);
+						loaded = true;
+						break;
+					}
+				}
+
+				if (loaded)
+				{
+					break;
+				}
+
+				m_resourceLoaded.Wait(m_mutex);
+			}
+		}
+
+		// The resource is either loaded or waiting for dependencies we have requested
+		if (resource->m_state == CrResourceState::Pending)
+		{
+			ProcessLoadedResource(resource.get());
+		}
+	}
 }
 
-CrImageHandle CrResourceManager::LoadImageFromDisk(const CrFixedPath& fullPath)
+void CrResourceManager::Update()
 {
-	CrFixedPath extension = fullPath.extension();
+	crstl::vector<CrResource*> loadedResources;
 
-	crstl::file file(fullPath.c_str(), crstl::file_flags::read);
+	{
+		CrScopedLock lock(m_mutex);
+		loadedResources.swap(m_loadedResources);
+	}
 
-	crstl::unique_ptr<ICrImageDecoder> imageDecoder;
+	for (CrResource* resource : loadedResources)
+	{
+		ProcessLoadedResource(resource);
+	}
 
-	if (file)
+	// Index based as finalizing a resource can request new ones
+	for (uint32_t i = 0; i < m_pendingResources.size(); ++i)
 	{
-		if (extension.comparei(".dds") == 0)
+		CrResource* resource = m_pendingResources[i].get();
+
+		if (resource->m_state == CrResourceState::WaitingForDependencies)
 		{
-			imageDecoder = crstl::unique_ptr<ICrImageDecoder>(new CrImageDecoderDDS());
+			TryFinalizeResource(resource);
 		}
-		else if
-		(
-			extension.comparei(".png") == 0 ||
-			extension.comparei(".tga") == 0 ||
-			extension.comparei(".jpg") == 0 ||
-			extension.comparei(".jpeg") == 0 ||
-			extension.comparei(".gif") == 0 ||
-			extension.comparei(".bmp") == 0 ||
-			extension.comparei(".wbmp") == 0 ||
-			extension.comparei(".nie") == 0
-		)
+		else if (resource->m_state == CrResourceState::WaitingForUploads && resource->AreUploadsComplete())
+		{
+			FinishResource(resource, CrResourceState::Loaded);
+		}
+	}
+
+	// Release the finished resources. Those nobody else holds are unloaded here
+	bool hadPendingResources = !m_pendingResources.empty();
+
+	for (uint32_t i = 0; i < m_pendingResources.size();)
+	{
+		if (m_pendingResources[i]->IsFinished())
 		{
-			imageDecoder = crstl::unique_ptr<ICrImageDecoder>(new CrImageDecoderWuffs());
+			m_pendingResources[i] = m_pendingResources.back();
+			m_pendingResources.pop_back();
 		}
 		else
 		{
-			imageDecoder = crstl::unique_ptr<ICrImageDecoder>(new CrImageDecoderSTB());
+			++i;
 		}
 	}
 
-	if (imageDecoder)
+	if (hadPendingResources && m_pendingResources.empty())
+	{
+		double loadingWallTime = (crstl::time::now() - m_loadingStartTime).milliseconds();
+		m_statistics.wallTime += loadingWallTime;
+
+		CrLog("Finished loading resources in %.2f ms. So far %u loaded, %u failed, %u cancelled, %u cache hits. Loading took %.2f ms wall time, "
+			"%.2f ms on loading threads (%.2f ms CPU) and %.2f ms finalizing on the main thread",
+			loadingWallTime, m_statistics.loadedCount, m_statistics.failedCount, m_statistics.cancelledCount, m_statistics.cacheHitCount,
+			m_statistics.wallTime, m_statistics.loadingTime, m_statistics.loadingCPUTime, m_statistics.finalizeTime);
+	}
+}
+
+void CrResourceManager::LoadNextResource()
+{
+	CrResource* resource = nullptr;
+
+	{
+		CrScopedLock lock(m_mutex);
+
+		for (int32_t p = CrResourcePriority::Count - 1; p >= 0 && !resource; --p)
+		{
+			crstl::vector<CrResource*>& queuedResources = m_queuedResources[p];
+
+			if (!queuedResources.empty())
+			{
+				resource = queuedResources.front();
+				queuedResources.erase(queuedResources.begin());
+			}
+		}
+	}
+
+	// The resource this job was submitted for may have been cancelled or loaded by the main thread
+	if (resource)
+	{
+		LoadResource(resource);
+	}
+}
+
+void CrResourceManager::LoadResource(CrResource* resource)
+{
+	crstl::timer loadingTime;
+	double cpuTimeStart = CrThreadPool::GetCurrentThreadCPUTimeMilliseconds();
+
+	bool loadSucceeded = false;
+
+	crstl::file file(resource->m_path.c_str(), crstl::file_flags::read);
+
+	if (file)
+	{
+		loadSucceeded = resource->Load(file);
+	}
+	else
+	{
+		CrLog("Could not open %s", resource->m_path.c_str());
+	}
+
+	double cpuTime = CrThreadPool::GetCurrentThreadCPUTimeMilliseconds() - cpuTimeStart;
+
+	{
+		CrScopedLock lock(m_mutex);
+		resource->m_loadSucceeded = loadSucceeded;
+		resource->m_loadingTime = loadingTime.elapsed().milliseconds();
+		resource->m_loadingCPUTime = cpuTime;
+		m_loadedResources.push_back(resource);
+	}
+
+	m_resourceLoaded.NotifyAll();
+}
+
+bool CrResourceManager::RemoveFromQueue(CrResource* resource)
+{
+	CrScopedLock lock(m_mutex);
+
+	crstl::vector<CrResource*>& queuedResources = m_queuedResources[resource->m_priority];
+
+	for (uint32_t i = 0; i < queuedResources.size(); ++i)
+	{
+		if (queuedResources[i] == resource)
+		{
+			queuedResources.erase(queuedResources.begin() + i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void CrResourceManager::ProcessLoadedResource(CrResource* resource)
+{
+	bool cancelled, loadSucceeded;
+
+	{
+		CrScopedLock lock(m_mutex);
+		cancelled = resource->m_cancelled;
+		loadSucceeded = resource->m_loadSucceeded;
+		m_statistics.loadingTime += resource->m_loadingTime;
+		m_statistics.loadingCPUTime += resource->m_loadingCPUTime;
+	}
+
+	if (cancelled)
+	{
+		FinishResource(resource, CrResourceState::Cancelled);
+	}
+	else if (!loadSucceeded)
+	{
+		CrLog("Failed to load %s", resource->m_path.c_str());
+		FinishResource(resource, CrResourceState::Failed);
+	}
+	else
+	{
+		for (const CrTextureDependency& textureDependency : resource->m_textureDependencies)
+		{
+			CrTextureResourceHandle texture = LoadTexture(textureDependency.path, textureDependency.semantic, resource->m_priority);
+			resource->m_dependencies.push_back(CrResourceHandle(texture.get()));
+		}
+
+		resource->m_textureDependencies.clear();
+		resource->m_state = CrResourceState::WaitingForDependencies;
+
+		TryFinalizeResource(resource);
+	}
+}
+
+void CrResourceManager::TryFinalizeResource(CrResource* resource)
+{
+	for (const CrResourceHandle& dependency : resource->m_dependencies)
+	{
+		if (!dependency->IsFinished())
+		{
+			return;
+		}
+	}
+
+	crstl::timer finalizeTime;
+
+	bool finalized = resource->Finalize();
+
+	m_statistics.finalizeTime += finalizeTime.elapsed().milliseconds();
+
+	if (!finalized)
+	{
+		FinishResource(resource, CrResourceState::Failed);
+	}
+	else if (!resource->AreUploadsComplete())
+	{
+		resource->m_state = CrResourceState::WaitingForUploads;
+	}
+	else
+	{
+		FinishResource(resource, CrResourceState::Loaded);
+	}
+}
+
+void CrResourceManager::FinishResource(CrResource* resource, CrResourceState::T state)
+{
+	resource->m_state = state;
+	resource->m_dependencies.clear();
+
+	switch (state)
+	{
+		case CrResourceState::Loaded: m_statistics.loadedCount++; break;
+		case CrResourceState::Failed: m_statistics.failedCount++; break;
+		case CrResourceState::Cancelled: m_statistics.cancelledCount++; break;
+		default: break;
+	}
+}
+
+void CrResourceManager::RemoveFromCache(CrResource* resource)
+{
+	if (resource->m_cacheKey != 0)
+	{
+		m_resourceCache.erase(resource->m_cacheKey);
+	}
+}
+
+CrFixedPath CrResourceManager::GetFullResourcePath(const CrFixedPath& relativePath)
+{
+	crstl::string dataPath = crcore::CommandLine("-root").c_str();
+	return CrFixedPath(dataPath.c_str()) / relativePath;
+}
+
+CrImageHandle CrResourceManager::LoadImageFromDisk(const CrFixedPath& fullPath)
+{
+	// DDS reads its mips straight into the image, other formats decode from the mapped file
+	if (fullPath.extension().comparei(".dds") == 0)
+	{
+		crstl::file file(fullPath.c_str(), crstl::file_flags::read);
+		return file ? ICrImageDecoder::Create(fullPath)->Decode(file) : nullptr;
+	}
+
+	CrMappedFileStream file(fullPath.c_str());
+
+	if (file)
 	{
-		return imageDecoder->Decode(file);
+		return ICrImageDecoder::Create(fullPath)->Decode((void*)file.GetData(), file.GetSize());
 	}
 	else
 	{
@@ -1,21 +1,151 @@
 #pragma once
 
 #include "Core/CrCoreForwardDeclarations.h"
+#include "Core/Threading/CrMutex.h"
 #include "Graphics/CrGraphicsForwardDeclarations.h"
 #include "Image/CrImageForwardDeclarations.h"
+#include "Resource/CrResource.h"
+
+#include "crstl/open_hashmap.h"
+#include "crstl/timer.h"
+#include "crstl/unique_ptr.h"
+#include "crstl/vector.h"
 
 class CrShader;
+class CrThreadPool;
+
+struct CrResourceLoadingStatistics
+{
+	uint32_t requestedCount = 0;
+
+	// Requests for resources that were already loaded or being loaded
+	uint32_t cacheHitCount = 0;
+
+	uint32_t loadedCount = 0;
+
+	uint32_t failedCount = 0;
+
+	uint32_t cancelledCount = 0;
+
+	// Time during which there were resources loading, from the first request to the last one finishing
+	double wallTime = 0.0;
+
+	// Time spent loading on the loading threads, added together, and how much of it was spent running on a CPU
+	// rather than waiting for the disk. Compared to wall time it shows how well loading is spread across threads
+	double loadingTime = 0.0;
+
+	double loadingCPUTime = 0.0;
+
+	// Time spent creating GPU resources on the main thread
+	double finalizeTime = 0.0;
+};
 
+// Loads resources asynchronously on a pool of loading threads. Resources are cached by path, so requesting
+// a resource that is already loaded or on its way returns the same handle. The cache doesn't keep resources
+// alive: once every handle to a resource is released, it is unloaded. Requests are served in priority order
+// and can be cancelled until they finish. All functions must be called from the main thread
 class CrResourceManager
 {
 public:
 
-	static CrRenderModelHandle LoadModel(const CrFixedPath& filePath);
+	static void Initialize();
+
+	static void Deinitialize();
+
+	~CrResourceManager();
+
+	CrModelResourceHandle LoadModel(const CrFixedPath& fullPath, CrResourcePriority::T priority = CrResourcePriority::Normal);
+
+	// The semantic is the material slot the texture is bound to, which decides how it's cooked. A texture is only
+	// loaded once, so the first request decides it
+	CrTextureResourceHandle LoadTexture(const CrFixedPath& fullPath, Textures::T semantic, CrResourcePriority::T priority = CrResourcePriority::Normal);
+
+	// Loads the texture if needed and waits for it
+	CrStreamedTextureHandle GetTexture(const CrFixedPath& fullPath, Textures::T semantic);
+
+	// Raises or lowers the priority of a resource that hasn't started loading
+	void SetPriority(const CrResourceHandle& resource, CrResourcePriority::T priority);
+
+	// A resource that hasn't started loading is removed from the queue. Otherwise its result is discarded
+	void Cancel(const CrResourceHandle& resource);
+
+	// Blocks until the resource has finished. A resource that hasn't started loading is loaded right away
+	void Wait(const CrResourceHandle& resource);
+
+	// Finalizes the resources that have loaded since the last call. Call it once per frame
+	void Update();
+
+	bool IsIdle() const { return m_pendingResources.empty(); }
+
+	const CrResourceLoadingStatistics& GetStatistics() const { return m_statistics; }
+
+	// Pool resources can split their loading work across. Loading threads can't wait on jobs of their own pool
+	CrThreadPool* GetDecodingThreadPool() const { return m_decodingThreadPool.get(); }
 
 	static CrFixedPath GetFullResourcePath(const CrFixedPath& relativePath);
 
-	// TODO Also allow image loading to take a data pointer, so we can do the upload directly via the map
+	// Images decode into their own memory and are copied into the texture when it's created on the main thread. Unlike
+	// models they can't decode straight into upload memory, as the layout of a texture in upload memory is platform
+	// specific and only known once the texture exists
 	static CrImageHandle LoadImageFromDisk(const CrFixedPath& filePath);
 
 	static void SaveImageToDisk(const CrImageHandle& image, const CrFixedPath& fullPath);
+
+private:
+
+	friend class CrResource;
+
+	CrResourceManager();
+
+	// Arguments after the priority are passed on to the constructor of the resource if it isn't cached
+	template<typename ResourceT, typename... ArgsT>
+	crstl::intrusive_ptr<ResourceT> RequestResource(CrResourceType::T type, const CrFixedPath& fullPath, CrResourcePriority::T priority, const ArgsT&... args);
+
+	// Runs on a loading thread. Takes the highest priority resource from the queue
+	void LoadNextResource();
+
+	// Loads the resource on the calling thread and hands it over to the main thread
+	void LoadResource(CrResource* resource);
+
+	// Removes the resource from the queue if it's still there
+	bool RemoveFromQueue(CrResource* resource);
+
+	// Requests the dependencies of a resource that has just loaded, or finishes it if it failed or was cancelled
+	void ProcessLoadedResource(CrResource* resource);
+
+	// Finalizes the resource if all its dependencies have finished
+	void TryFinalizeResource(CrResource* resource);
+
+	void FinishResource(CrResource* resource, CrResourceState::T state);
+
+	// Called when the last handle to a resource goes away
+	void RemoveFromCache(CrResource* resource);
+
+	crstl::unique_ptr<CrThreadPool> m_loadingThreadPool;
+
+	crstl::unique_ptr<CrThreadPool> m_decodingThreadPool;
+
+	// Protects everything shared with the loading threads
+	CrMutex m_mutex;
+
+	// Signaled when a loading thread finishes a resource
+	CrConditionVariable m_resourceLoaded;
+
+	crstl::vector<CrResource*> m_queuedResources[CrResourcePriority::Count];
+
+	// Resources the loading threads have finished, waiting for the main thread
+	crstl::vector<CrResource*> m_loadedResources;
+
+	// Resources that have been requested and haven't finished. The manager keeps them alive until they do
+	crstl::vector<CrResourceHandle> m_pendingResources;
+
+	// Resources by path and type. It doesn't own them, they remove themselves when they're destroyed
+	crstl::open_hashmap<uint64_t, CrResource*> m_resourceCache;
+
+	CrResourceLoadingStatistics m_statistics;
+
+	// When the pending resources went from none to some
+	crstl::time m_loadingStartTime;
 };
+
+extern CrResourceManager* ResourceManager;
@@ -0,0 +1,380 @@
+#include "Resource/CrResource_pch.h"
+
+#include "Resource/CrTextureStreamer.h"
+
+#include "Core/CrFrameTime.h"
+#include "Core/Logging/ICrDebug.h"
+#include "Core/Threading/CrThreadPool.h"
+
+#include "Math/CrMath.h"
+
+#include "Graphics/CrImage.h"
+#include "Graphics/CrStreamedTexture.h"
+#include "Graphics/IDevice.h"
+#include "Graphics/IGraphicsSystem.h"
+#include "Graphics/ITexture.h"
+#include "Graphics/DataFormats.h"
+
+#include "Resource/Image/CrImageCodecDDS.h"
+#include "Resource/Image/CrTextureCooker.h"
+
+#include "crstl/filesystem.h"
+#include "crstl/sort.h"
+
+#include <math.h>
+
+CrTextureStreamer* TextureStreamer;
+
+// Textures that have gone unseen the longest lose their mips first, then the ones that need the least detail
+struct CrEvictionCandidate
+{
+	bool operator < (const CrEvictionCandidate& other) const
+	{
+		return lastRequestedFrame != other.lastRequestedFrame ? lastRequestedFrame < other.lastRequestedFrame : detail < other.detail;
+	}
+
+	uint64_t lastRequestedFrame;
+
+	float detail;
+
+	uint32_t textureIndex;
+};
+
+void CrTextureStreamer::Initialize(const CrTextureStreamingSettings& settings)
+{
+	CrAssert(TextureStreamer == nullptr);
+	TextureStreamer = new CrTextureStreamer(settings);
+}
+
+void CrTextureStreamer::Deinitialize()
+{
+	CrAssert(TextureStreamer != nullptr);
+	delete TextureStreamer;
+	TextureStreamer = nullptr;
+}
+
+CrTextureStreamer::CrTextureStreamer(const CrTextureStreamingSettings& settings) : m_settings(settings)
+{
+	m_loadingThreadPool = crstl::unique_ptr<CrThreadPool>(new CrThreadPool(1));
+}
+
+CrTextureStreamer::~CrTextureStreamer()
+{
+	// Wait for the loads in flight before throwing them away
+	m_loadingThreadPool = nullptr;
+
+	for (CrStreamingLoad* streamingLoad : m_finishedLoads)
+	{
+		delete streamingLoad;
+	}
+
+	m_finishedLoads.clear();
+	m_textures.clear();
+}
+
+CrStreamedTextureHandle CrTextureStreamer::CreateStreamedTexture(const CrImageHandle& image, const CrFixedPath& path, const char* name)
+{
+	CrStreamingTexture texture;
+	texture.path = path;
+	texture.format = image->GetFormat();
+	texture.initialMipmap = 0;
+	texture.targetMipmap = 0;
+	texture.loading = false;
+	texture.failed = false;
+
+	bool isStreamable =
+		image->GetType() == crgfx::TextureType::Tex2D && image->GetDepth() == 1 && image->GetMipmapCount() > 1 &&
+		!path.empty() && crstl::exists(path.c_str());
+
+	if (isStreamable)
+	{
+		// Smallest mip that can be the top mip. Block compressed textures need a multiple of 4 size in their top mip
+		bool isCompressed = crgfx::DataFormats[image->GetFormat()].compressed;
+		uint32_t lastMipmap = 0;
+
+		while (lastMipmap + 1 < image->GetMipmapCount())
+		{
+			uint32_t mipWidth = image->GetWidth() >> (lastMipmap + 1);
+			uint32_t mipHeight = image->GetHeight() >> (lastMipmap + 1);
+
+			if (mipWidth == 0 || mipHeight == 0 || (isCompressed && ((mipWidth % 4) != 0 || (mipHeight % 4) != 0)))
+			{
+				break;
+			}
+
+			lastMipmap++;
+		}
+
+		texture.initialMipmap = lastMipmap;
+
+		for (uint32_t mip = 0; mip < lastMipmap; ++mip)
+		{
+			if (CrMax(image->GetWidth() >> mip, image->GetHeight() >> mip) <= m_settings.initialResidentSize)
+			{
+				texture.initialMipmap = mip;
+				break;
+			}
+		}
+	}
+
+	crgfx::TextureHandle initialTexture = CreateTexture(image, texture.initialMipmap, name);
+
+	if (!initialTexture)
+	{
+		return nullptr;
+	}
+
+	texture.streamedTexture = CrStreamedTextureHandle(new CrStreamedTexture
+	(
+		initialTexture, image->GetWidth(), image->GetHeight(), image->GetMipmapCount(), texture.initialMipmap
+	));
+
+	// Small textures are always fully resident, there's nothing to stream
+	if (texture.initialMipmap > 0)
+	{
+		texture.targetMipmap = texture.initialMipmap;
+		m_textures.push_back(texture);
+	}
+
+	return texture.streamedTexture;
+}
+
+void CrTextureStreamer::Update()
+{
+	// Replace the textures whose mips have finished loading
+	crstl::vector<CrStreamingLoad*> finishedLoads;
+	{
+		CrScopedLock lock(m_mutex);
+		finishedLoads.swap(m_finishedLoads);
+	}
+
+	for (CrStreamingLoad* streamingLoad : finishedLoads)
+	{
+		for (CrStreamingTexture& texture : m_textures)
+		{
+			if (texture.streamedTexture.get() != streamingLoad->streamedTexture)
+			{
+				continue;
+			}
+
+			texture.loading = false;
+
+			const CrStreamedTextureHandle& streamedTexture = texture.streamedTexture;
+			crgfx::TextureHandle loadedTexture;
+
+			if (streamingLoad->image && streamingLoad->image->GetMipmapCount() == streamedTexture->GetMipmapCount() - streamingLoad->firstMipmap)
+			{
+				loadedTexture = CreateTexture(streamingLoad->image, 0, texture.path.c_str());
+			}
+
+			if (loadedTexture)
+			{
+				if (streamingLoad->firstMipmap < streamedTexture->GetResidentMipmap())
+				{
+					m_statistics.streamedInCount++;
+				}
+				else
+				{
+					m_statistics.evictedCount++;
+				}
+
+				streamedTexture->SetTexture(loadedTexture, streamingLoad->firstMipmap);
+			}
+			else
+			{
+				// Keep what it has. Trying again every frame won't make the file any better
+				CrLog("Could not stream mips of %s", texture.path.c_str());
+				texture.failed = true;
+			}
+
+			break;
+		}
+
+		delete streamingLoad;
+	}
+
+	// The streamer holding the last reference means every material that used the texture is gone
+	for (uint32_t i = 0; i < m_textures.size();)
+	{
+		if (!m_textures[i].loading && m_textures[i].streamedTexture->get_ref() == 1)
+		{
+			m_textures[i] = m_textures.back();
+			m_textures.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	// Work out the mips each texture needs. Textures that weren't visible this frame keep what they have, unless
+	// the budget needs the memory
+	const uint64_t frameIndex = CrFrameTime::GetFrameIndex();
+
+	uint64_t requestedMemory = 0;
+
+	crstl::vector<CrEvictionCandidate> evictionCandidates;
+	evictionCandidates.reserve(m_textures.size());
+
+	for (uint32_t i = 0; i < m_textures.size(); ++i)
+	{
+		CrStreamingTexture& texture = m_textures[i];
+		const CrStreamedTextureHandle& streamedTexture = texture.streamedTexture;
+
+		float fullSize = (float)CrMax(streamedTexture->GetWidth(), streamedTexture->GetHeight());
+
+		if (streamedTexture->GetLastRequestedFrame() == frameIndex)
+		{
+			// Mip m has fullSize / 2^m texels across a unit of texture coordinates, so we want the smallest mip that
+			// still has as many texels as pixels
+			float resolution = streamedTexture->GetRequestedResolution();
+
+			if (resolution >= fullSize)
+			{
+				texture.targetMipmap = 0;
+			}
+			else if (resolution <= 0.0f)
+			{
+				texture.targetMipmap = texture.initialMipmap;
+			}
+			else
+			{
+				texture.targetMipmap = CrMin((uint32_t)floorf(log2f(fullSize / resolution)), texture.initialMipmap);
+			}
+		}
+		else
+		{
+			texture.targetMipmap = streamedTexture->GetResidentMipmap();
+		}
+
+		requestedMemory += GetResidentMemory(texture, texture.targetMipmap);
+
+		CrEvictionCandidate evictionCandidate;
+		evictionCandidate.lastRequestedFrame = streamedTexture->GetLastRequestedFrame();
+		evictionCandidate.detail = streamedTexture->GetRequestedResolution() / fullSize;
+		evictionCandidate.textureIndex = i;
+		evictionCandidates.push_back(evictionCandidate);
+	}
+
+	crstl::sort(evictionCandidates.begin(), evictionCandidates.end());
+
+	// Take a mip away from every texture in eviction order until we fit. Going one mip at a time spreads the loss
+	// of detail instead of taking every mip from the first texture before touching the next one
+	uint64_t budgetedMemory = requestedMemory;
+	bool mipmapEvicted = true;
+
+	while (budgetedMemory > m_settings.memoryBudget && mipmapEvicted)
+	{
+		mipmapEvicted = false;
+
+		for (const CrEvictionCandidate& evictionCandidate : evictionCandidates)
+		{
+			CrStreamingTexture& texture = m_textures[evictionCandidate.textureIndex];
+
+			if (texture.targetMipmap < texture.initialMipmap)
+			{
+				budgetedMemory -= GetResidentMemory(texture, texture.targetMipmap) - GetResidentMemory(texture, texture.targetMipmap + 1);
+				texture.targetMipmap++;
+				mipmapEvicted = true;
+
+				if (budgetedMemory <= m_settings.memoryBudget)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	// Start loading the textures that need different mips, the most important ones first
+	uint32_t pendingLoadCount = 0;
+
+	for (const CrStreamingTexture& texture : m_textures)
+	{
+		pendingLoadCount += texture.loading ? 1 : 0;
+	}
+
+	for (uint32_t i = (uint32_t)evictionCandidates.size(); i > 0 && pendingLoadCount < m_settings.maxPendingLoads; --i)
+	{
+		CrStreamingTexture& texture = m_textures[evictionCandidates[i - 1].textureIndex];
+
+		if (texture.loading || texture.failed || texture.targetMipmap == texture.streamedTexture->GetResidentMipmap())
+		{
+			continue;
+		}
+
+		CrStreamingLoad* streamingLoad = new CrStreamingLoad();
+		streamingLoad->streamedTexture = texture.streamedTexture.get();
+		streamingLoad->path = texture.path;
+		streamingLoad->firstMipmap = texture.targetMipmap;
+
+		texture.loading = true;
+		pendingLoadCount++;
+
+		m_loadingThreadPool->Submit([this, streamingLoad]() { LoadMipmaps(streamingLoad); });
+	}
+
+	m_statistics.textureCount = (uint32_t)m_textures.size();
+	m_statistics.pendingLoadCount = pendingLoadCount;
+	m_statistics.requestedMemory = requestedMemory;
+	m_statistics.residentMemory = 0;
+
+	for (const CrStreamingTexture& texture : m_textures)
+	{
+		m_statistics.residentMemory += GetResidentMemory(texture, texture.streamedTexture->GetResidentMipmap());
+	}
+}
+
+void CrTextureStreamer::LoadMipmaps(CrStreamingLoad* streamingLoad)
+{
+	crstl::file file(streamingLoad->path.c_str(), crstl::file_flags::read);
+
+	if (file)
+	{
+		CrImageDecoderDDS imageDecoder;
+		streamingLoad->image = imageDecoder.Decode(file, streamingLoad->firstMipmap);
+	}
+
+	CrScopedLock lock(m_mutex);
+	m_finishedLoads.push_back(streamingLoad);
+}
+
+crgfx::TextureHandle CrTextureStreamer::CreateTexture(const CrImageHandle& image, uint32_t firstMipmap, const char* name) const
+{
+	const crgfx::DeviceHandle& renderDevice = crgfx::GetDevice();
+
+	crgfx::TextureDescriptor textureDescriptor;
+	textureDescriptor.width = CrMax(image->GetWidth() >> firstMipmap, 1u);
+	textureDescriptor.height = CrMax(image->GetHeight() >> firstMipmap, 1u);
+	textureDescriptor.format = image->GetFormat();
+	textureDescriptor.mipmapCount = image->GetMipmapCount() - firstMipmap;
+	textureDescriptor.usage = crgfx::TextureUsage::Default;
+	textureDescriptor.name = name;
+
+	crgfx::TextureHandle texture = renderDevice->CreateTexture(textureDescriptor);
+
+	if (texture)
+	{
+		// The mips we want are the end of the mip chain
+		const uint8_t* mipmapData = image->GetData() + CrTextureCooker::GetMipChainSize(image->GetFormat(), image->GetWidth(), image->GetHeight(), 1, firstMipmap);
+
+		uint8_t* textureData = renderDevice->BeginTextureUpload(texture.get());
+		{
+			texture->CopyIntoTextureMemory(textureData, mipmapData, 0, textureDescriptor.mipmapCount, 0, 1);
+		}
+		renderDevice->EndTextureUpload(texture.get());
+	}
+
+	return texture;
+}
+
+uint64_t CrTextureStreamer::GetResidentMemory(const CrStreamingTexture& texture, uint32_t topMipmap) const
+{
+	const CrStreamedTextureHandle& streamedTexture = texture.streamedTexture;
+
+	return CrTextureCooker::GetMipChainSize
+	(
+		texture.format,
+		CrMax(streamedTexture->GetWidth() >> topMipmap, 1u), CrMax(streamedTexture->GetHeight() >> topMipmap, 1u), 1,
+		streamedTexture->GetMipmapCount() - topMipmap
+	);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Core/FileSystem/CrFixedPath.h"
+#include "Core/Threading/CrMutex.h"
+#include "Graphics/CrGraphicsForwardDeclarations.h"
+#include "Image/CrImageForwardDeclarations.h"
+
+#include "crstl/intrusive_ptr.h"
+#include "crstl/unique_ptr.h"
+#include "crstl/vector.h"
+
+class CrThreadPool;
+
+struct CrTextureStreamingSettings
+{
+	// Memory the resident mips of all streamed textures can take up. When the mips the render world asks for don't
+	// fit, textures lose their top mips, starting with the ones that haven't been visible for longest
+	uint64_t memoryBudget = 512ull * 1024 * 1024;
+
+	// Textures start with the mips up to this size, and are never evicted below them
+	uint32_t initialResidentSize = 128;
+
+	// Loads that can be in flight at the same time
+	uint32_t maxPendingLoads = 8;
+};
+
+struct CrTextureStreamingStatistics
+{
+	uint32_t textureCount = 0;
+
+	uint32_t pendingLoadCount = 0;
+
+	// Memory of the mips that are resident right now
+	uint64_t residentMemory = 0;
+
+	// Memory of the mips the render world asked for, before fitting them in the budget
+	uint64_t requestedMemory = 0;
+
+	uint32_t streamedInCount = 0;
+
+	uint32_t evictedCount = 0;
+};
+
+// Keeps the mips of textures resident according to how much detail they need on screen. Textures start with their
+// smallest mips. The render world requests a resolution for the textures it sees, and every update the streamer
+// works out the mips each of them needs, drops top mips until they fit in the budget, and reloads the textures
+// whose mips changed from their cooked DDS. Loading only reads the part of the file with the mips we want, and
+// the new texture is uploaded through the device and replaces the old one. The old one is freed once the GPU is
+// done with it. All functions must be called from the main thread
+class CrTextureStreamer
+{
+public:
+
+	static void Initialize(const CrTextureStreamingSettings& settings);
+
+	static void Deinitialize();
+
+	~CrTextureStreamer();
+
+	// Creates the streamed texture with the initial mips of the image, which must have its full mip chain. The rest
+	// of the mips are loaded from the DDS file at path when they are needed. Textures that can't be streamed get
+	// all their mips and are never registered
+	CrStreamedTextureHandle CreateStreamedTexture(const CrImageHandle& image, const CrFixedPath& path, const char* name);
+
+	// Call once per frame, after the render world has computed visibility
+	void Update();
+
+	void SetMemoryBudget(uint64_t memoryBudget) { m_settings.memoryBudget = memoryBudget; }
+
+	const CrTextureStreamingStatistics& GetStatistics() const { return m_statistics; }
+
+private:
+
+	struct CrStreamingTexture
+	{
+		CrStreamedTextureHandle streamedTexture;
+
+		CrFixedPath path;
+
+		crgfx::DataFormat::T format;
+
+		// Top mip it starts with. It is never evicted past it
+		uint32_t initialMipmap;
+
+		// Top mip after fitting in the budget
+		uint32_t targetMipmap;
+
+		bool loading;
+
+		// Loading its mips failed once, so it stays as it is
+		bool failed;
+	};
+
+	struct CrStreamingLoad
+	{
+		CrStreamedTexture* streamedTexture;
+
+		CrFixedPath path;
+
+		uint32_t firstMipmap;
+
+		CrImageHandle image;
+	};
+
+	CrTextureStreamer(const CrTextureStreamingSettings& settings);
+
+	// Runs on the loading thread
+	void LoadMipmaps(CrStreamingLoad* streamingLoad);
+
+	// Creates the texture with the mips from firstMipmap onwards and uploads them
+	crgfx::TextureHandle CreateTexture(const CrImageHandle& image, uint32_t firstMipmap, const char* name) const;
+
+	uint64_t GetResidentMemory(const CrStreamingTexture& texture, uint32_t topMipmap) const;
+
+	CrTextureStreamingSettings m_settings;
+
+	crstl::vector<CrStreamingTexture> m_textures;
+
+	// A single thread is enough, loads are mostly disk access and a copy
+	crstl::unique_ptr<CrThreadPool> m_loadingThreadPool;
+
+	// Protects the finished loads, which the loading thread writes to
+	CrMutex m_mutex;
+
+	crstl::vector<CrStreamingLoad*> m_finishedLoads;
+
+	CrTextureStreamingStatistics m_statistics;
+};
+
+extern CrTextureStreamer* TextureStreamer;
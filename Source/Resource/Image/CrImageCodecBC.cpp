@@ -0,0 +1,1027 @@
+#include "Resource/CrResource_pch.h"
+
+#include "CrImageCodecBC.h"
+#include "CrImageCodecDDS.h"
+#include "CrTextureCooker.h"
+
+#include "Core/Logging/ICrDebug.h"
+#include "Core/Threading/CrThreadPool.h"
+
+#include "Math/CrMath.h"
+
+#include "Graphics/CrImage.h"
+#include "Graphics/CrGraphics.h"
+#include "Graphics/DataFormats.h"
+
+#include "crstl/timer.h"
+#include "crstl/vector.h"
+
+#include <float.h>
+#include <math.h>
+
+// Texels of a block as floats. Unorm formats are in [0, 255], BC6H works on the bit patterns of half floats
+typedef float CrBlockTexels[16][4];
+
+static const uint32_t BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct CrBlockBitWriter
+{
+	CrBlockBitWriter(uint8_t* block) : block(block), bitPosition(0)
+	{
+		memset(block, 0, 16);
+	}
+
+	void Write(uint32_t value, uint32_t bitCount)
+	{
+		for (uint32_t i = 0; i < bitCount; ++i)
+		{
+			block[bitPosition >> 3] |= (uint8_t)(((value >> i) & 1) << (bitPosition & 7));
+			bitPosition++;
+		}
+	}
+
+	uint8_t* block;
+
+	uint32_t bitPosition;
+};
+
+static uint16_t FloatToHalfBits(float value)
+{
+	// Only unsigned halves are needed. Negative values and NaN become 0, and anything too large the largest half
+	if (!(value > 0.0f))
+	{
+		return 0;
+	}
+
+	if (value >= 65504.0f)
+	{
+		return 0x7bff;
+	}
+
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+		{
+			return 0;
+		}
+
+		uint32_t mantissa = (bits & 0x7fffff) | 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		return (uint16_t)((mantissa >> shift) + ((mantissa >> (shift - 1)) & 1));
+	}
+
+	uint32_t half = ((uint32_t)exponent << 10) | ((bits >> 13) & 0x3ff);
+	half += (bits >> 12) & 1;
+	return (uint16_t)CrMin(half, 0x7bffu);
+}
+
+static float HalfBitsToFloat(uint32_t half)
+{
+	uint32_t exponent = (half >> 10) & 0x1f;
+	uint32_t mantissa = half & 0x3ff;
+
+	if (exponent == 0)
+	{
+		return ldexpf((float)mantissa, -24);
+	}
+
+	return ldexpf((float)(1024 + mantissa), (int)exponent - 25);
+}
+
+// Finds the line through the block that best fits its texels, and the endpoints of the texels along it
+template<uint32_t ChannelCount>
+static void FitEndpoints(const CrBlockTexels& texels, float endpoint0[4], float endpoint1[4])
+{
+	float mean[4] = {};
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < ChannelCount; ++c)
+		{
+			mean[c] += texels[i][c] / 16.0f;
+		}
+	}
+
+	float covariance[4][4] = {};
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c0 = 0; c0 < ChannelCount; ++c0)
+		{
+			for (uint32_t c1 = 0; c1 < ChannelCount; ++c1)
+			{
+				covariance[c0][c1] += (texels[i][c0] - mean[c0]) * (texels[i][c1] - mean[c1]);
+			}
+		}
+	}
+
+	// Power iteration converges to the principal axis
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	for (uint32_t iteration = 0; iteration < 8; ++iteration)
+	{
+		float nextAxis[4] = {};
+		float lengthSquared = 0.0f;
+
+		for (uint32_t c0 = 0; c0 < ChannelCount; ++c0)
+		{
+			for (uint32_t c1 = 0; c1 < ChannelCount; ++c1)
+			{
+				nextAxis[c0] += covariance[c0][c1] * axis[c1];
+			}
+
+			lengthSquared += nextAxis[c0] * nextAxis[c0];
+		}
+
+		// A flat block has no axis. Both endpoints end up at the mean
+		if (lengthSquared < 1e-12f)
+		{
+			break;
+		}
+
+		float inverseLength = 1.0f / sqrtf(lengthSquared);
+
+		for (uint32_t c = 0; c < ChannelCount; ++c)
+		{
+			axis[c] = nextAxis[c] * inverseLength;
+		}
+	}
+
+	float minProjection = FLT_MAX;
+	float maxProjection = -FLT_MAX;
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float projection = 0.0f;
+
+		for (uint32_t c = 0; c < ChannelCount; ++c)
+		{
+			projection += (texels[i][c] - mean[c]) * axis[c];
+		}
+
+		minProjection = CrMin(minProjection, projection);
+		maxProjection = CrMax(maxProjection, projection);
+	}
+
+	for (uint32_t c = 0; c < ChannelCount; ++c)
+	{
+		endpoint0[c] = mean[c] + axis[c] * minProjection;
+		endpoint1[c] = mean[c] + axis[c] * maxProjection;
+	}
+}
+
+// Least squares endpoints for the texels, given how far along the line between endpoints each of them is
+template<uint32_t ChannelCount>
+static bool SolveEndpoints(const CrBlockTexels& texels, const float weights[16], float minValue, float maxValue, float endpoint0[4], float endpoint1[4])
+{
+	float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+	float ax[4] = {};
+	float bx[4] = {};
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float a = 1.0f - weights[i];
+		float b = weights[i];
+
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+
+		for (uint32_t c = 0; c < ChannelCount; ++c)
+		{
+			ax[c] += a * texels[i][c];
+			bx[c] += b * texels[i][c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+
+	if (fabsf(determinant) < 1e-6f)
+	{
+		return false;
+	}
+
+	for (uint32_t c = 0; c < ChannelCount; ++c)
+	{
+		endpoint0[c] = CrClamp((bb * ax[c] - ab * bx[c]) / determinant, minValue, maxValue);
+		endpoint1[c] = CrClamp((aa * bx[c] - ab * ax[c]) / determinant, minValue, maxValue);
+	}
+
+	return true;
+}
+
+template<uint32_t ChannelCount, uint32_t PaletteSize>
+static float FindIndices(const CrBlockTexels& texels, const float palette[PaletteSize][4], uint32_t indices[16])
+{
+	float totalError = 0.0f;
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float bestError = FLT_MAX;
+
+		for (uint32_t p = 0; p < PaletteSize; ++p)
+		{
+			float error = 0.0f;
+
+			for (uint32_t c = 0; c < ChannelCount; ++c)
+			{
+				float difference = texels[i][c] - palette[p][c];
+				error += difference * difference;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				indices[i] = p;
+			}
+		}
+
+		totalError += bestError;
+	}
+
+	return totalError;
+}
+
+//----
+// BC1
+//----
+
+static uint16_t To565(const float color[4])
+{
+	uint32_t r = (uint32_t)CrClamp(color[0] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+	uint32_t g = (uint32_t)CrClamp(color[1] * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f);
+	uint32_t b = (uint32_t)CrClamp(color[2] * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void From565(uint16_t color, float rgb[4])
+{
+	uint32_t r = (color >> 11) & 31;
+	uint32_t g = (color >> 5) & 63;
+	uint32_t b = color & 31;
+	rgb[0] = (float)((r << 3) | (r >> 2));
+	rgb[1] = (float)((g << 2) | (g >> 4));
+	rgb[2] = (float)((b << 3) | (b >> 2));
+	rgb[3] = 255.0f;
+}
+
+// Encodes the colors in four color mode, which is the only mode the color block of BC3 has
+static void EncodeBC1Colors(const CrBlockTexels& texels, uint8_t* block, CrBlockTexels& decoded)
+{
+	float endpoint0[4], endpoint1[4];
+	FitEndpoints<3>(texels, endpoint0, endpoint1);
+
+	float bestError = FLT_MAX;
+	uint16_t bestColors[2] = {};
+	uint32_t bestIndices[16] = {};
+	float bestPalette[4][4] = {};
+
+	for (uint32_t iteration = 0; iteration < 2; ++iteration)
+	{
+		uint16_t color0 = To565(endpoint1);
+		uint16_t color1 = To565(endpoint0);
+
+		// Four color mode needs the first color to be the larger one
+		if (color0 < color1)
+		{
+			uint16_t temporary = color0;
+			color0 = color1;
+			color1 = temporary;
+		}
+
+		float palette[4][4];
+		From565(color0, palette[0]);
+		From565(color1, palette[1]);
+
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+
+		uint32_t indices[16];
+		float error = FindIndices<3, 4>(texels, palette, indices);
+
+		if (error < bestError)
+		{
+			bestError = error;
+			bestColors[0] = color0;
+			bestColors[1] = color1;
+			memcpy(bestIndices, indices, sizeof(indices));
+			memcpy(bestPalette, palette, sizeof(palette));
+		}
+
+		const float IndexWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		float weights[16];
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			weights[i] = IndexWeights[indices[i]];
+		}
+
+		// The solved endpoints come out in palette order, i.e. endpoint0 is the first color
+		if (!SolveEndpoints<3>(texels, weights, 0.0f, 255.0f, endpoint1, endpoint0))
+		{
+			break;
+		}
+	}
+
+	uint32_t packedIndices = 0;
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		// With equal colors the block decodes in three color mode, where the last index is black
+		uint32_t index = bestColors[0] == bestColors[1] ? 0 : bestIndices[i];
+		packedIndices |= index << (2 * i);
+		memcpy(decoded[i], bestPalette[index], sizeof(decoded[i]));
+	}
+
+	memcpy(block + 0, &bestColors[0], 2);
+	memcpy(block + 2, &bestColors[1], 2);
+	memcpy(block + 4, &packedIndices, 4);
+}
+
+//----
+// BC4
+//----
+
+static void EncodeBC4Channel(const CrBlockTexels& texels, uint32_t channel, uint8_t* block, CrBlockTexels& decoded)
+{
+	float minValue = 255.0f;
+	float maxValue = 0.0f;
+
+	CrBlockTexels values;
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		values[i][0] = texels[i][channel];
+		minValue = CrMin(minValue, values[i][0]);
+		maxValue = CrMax(maxValue, values[i][0]);
+	}
+
+	// The first value being the larger selects the mode with six interpolated values
+	uint8_t value0 = (uint8_t)(maxValue + 0.5f);
+	uint8_t value1 = (uint8_t)(minValue + 0.5f);
+
+	float palette[8][4] = {};
+	palette[0][0] = value0;
+	palette[1][0] = value1;
+
+	if (value0 > value1)
+	{
+		for (uint32_t p = 2; p < 8; ++p)
+		{
+			palette[p][0] = ((8 - p) * value0 + (p - 1) * value1) / 7.0f;
+		}
+	}
+	else
+	{
+		for (uint32_t p = 2; p < 6; ++p)
+		{
+			palette[p][0] = ((6 - p) * value0 + (p - 1) * value1) / 5.0f;
+		}
+
+		palette[6][0] = 0.0f;
+		palette[7][0] = 255.0f;
+	}
+
+	uint32_t indices[16];
+	FindIndices<1, 8>(values, palette, indices);
+
+	uint64_t packedIndices = 0;
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		packedIndices |= (uint64_t)indices[i] << (3 * i);
+		decoded[i][channel] = palette[indices[i]][0];
+	}
+
+	block[0] = value0;
+	block[1] = value1;
+
+	for (uint32_t b = 0; b < 6; ++b)
+	{
+		block[2 + b] = (uint8_t)(packedIndices >> (8 * b));
+	}
+}
+
+//----
+// BC7
+//----
+
+// Mode 6 endpoints have 7 bits per channel plus a bit shared by all channels
+static float QuantizeBC7Endpoint(const float endpoint[4], uint32_t quantized[4], uint32_t& pBit)
+{
+	float bestError = FLT_MAX;
+
+	for (uint32_t p = 0; p < 2; ++p)
+	{
+		uint32_t candidate[4];
+		float error = 0.0f;
+
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			candidate[c] = (uint32_t)CrClamp((endpoint[c] - p) * 0.5f + 0.5f, 0.0f, 127.0f);
+			float difference = (float)((candidate[c] << 1) | p) - endpoint[c];
+			error += difference * difference;
+		}
+
+		if (error < bestError)
+		{
+			bestError = error;
+			pBit = p;
+			memcpy(quantized, candidate, sizeof(candidate));
+		}
+	}
+
+	return bestError;
+}
+
+static void EncodeBC7Block(const CrBlockTexels& texels, uint8_t* block, CrBlockTexels& decoded)
+{
+	float endpoint0[4], endpoint1[4];
+	FitEndpoints<4>(texels, endpoint0, endpoint1);
+
+	float bestError = FLT_MAX;
+	uint32_t bestEndpoints[2][4] = {};
+	uint32_t bestPBits[2] = {};
+	uint32_t bestIndices[16] = {};
+	float bestPalette[16][4] = {};
+
+	for (uint32_t iteration = 0; iteration < 3; ++iteration)
+	{
+		uint32_t quantized[2][4];
+		uint32_t pBits[2];
+		QuantizeBC7Endpoint(endpoint0, quantized[0], pBits[0]);
+		QuantizeBC7Endpoint(endpoint1, quantized[1], pBits[1]);
+
+		float palette[16][4];
+
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			uint32_t value0 = (quantized[0][c] << 1) | pBits[0];
+			uint32_t value1 = (quantized[1][c] << 1) | pBits[1];
+
+			for (uint32_t p = 0; p < 16; ++p)
+			{
+				palette[p][c] = (float)(((64 - BC7Weights4[p]) * value0 + BC7Weights4[p] * value1 + 32) >> 6);
+			}
+		}
+
+		uint32_t indices[16];
+		float error = FindIndices<4, 16>(texels, palette, indices);
+
+		if (error < bestError)
+		{
+			bestError = error;
+			memcpy(bestEndpoints, quantized, sizeof(quantized));
+			memcpy(bestPBits, pBits, sizeof(pBits));
+			memcpy(bestIndices, indices, sizeof(indices));
+			memcpy(bestPalette, palette, sizeof(palette));
+		}
+
+		float weights[16];
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			weights[i] = BC7Weights4[indices[i]] / 64.0f;
+		}
+
+		if (!SolveEndpoints<4>(texels, weights, 0.0f, 255.0f, endpoint0, endpoint1))
+		{
+			break;
+		}
+	}
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		memcpy(decoded[i], bestPalette[bestIndices[i]], sizeof(decoded[i]));
+	}
+
+	// The first index is stored without its top bit, so it must be in the first half of the palette. The palette
+	// is symmetric, so swapping the endpoints and inverting the indices decodes to the same texels
+	if (bestIndices[0] & 8)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			uint32_t temporary = bestEndpoints[0][c];
+			bestEndpoints[0][c] = bestEndpoints[1][c];
+			bestEndpoints[1][c] = temporary;
+		}
+
+		uint32_t temporary = bestPBits[0];
+		bestPBits[0] = bestPBits[1];
+		bestPBits[1] = temporary;
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			bestIndices[i] = 15 - bestIndices[i];
+		}
+	}
+
+	CrBlockBitWriter bitWriter(block);
+	bitWriter.Write(1 << 6, 7);
+
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		bitWriter.Write(bestEndpoints[0][c], 7);
+		bitWriter.Write(bestEndpoints[1][c], 7);
+	}
+
+	bitWriter.Write(bestPBits[0], 1);
+	bitWriter.Write(bestPBits[1], 1);
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		bitWriter.Write(bestIndices[i], i == 0 ? 3 : 4);
+	}
+}
+
+//-----
+// BC6H
+//-----
+
+static uint32_t UnquantizeBC6H(uint32_t quantized)
+{
+	if (quantized == 0)
+	{
+		return 0;
+	}
+	else if (quantized == 1023)
+	{
+		return 0xffff;
+	}
+	else
+	{
+		return ((quantized << 16) + 0x8000) >> 10;
+	}
+}
+
+// Interpolated values are scaled back to the bit pattern of a half at the end
+static uint32_t FinishUnquantizeBC6H(uint32_t value)
+{
+	return (value * 31) >> 6;
+}
+
+static uint32_t QuantizeBC6H(float halfBits)
+{
+	int32_t guess = (int32_t)(halfBits / 31.0f);
+
+	uint32_t bestQuantized = 0;
+	float bestError = FLT_MAX;
+
+	for (int32_t candidate = guess - 1; candidate <= guess + 1; ++candidate)
+	{
+		uint32_t quantized = (uint32_t)CrClamp(candidate, 0, 1023);
+		float error = fabsf((float)FinishUnquantizeBC6H(UnquantizeBC6H(quantized)) - halfBits);
+
+		if (error < bestError)
+		{
+			bestError = error;
+			bestQuantized = quantized;
+		}
+	}
+
+	return bestQuantized;
+}
+
+// Endpoints and interpolation work on the bit patterns of halves, which is roughly logarithmic
+static void EncodeBC6HBlock(const CrBlockTexels& texels, uint8_t* block, CrBlockTexels& decoded)
+{
+	float endpoint0[4], endpoint1[4];
+	FitEndpoints<3>(texels, endpoint0, endpoint1);
+
+	float bestError = FLT_MAX;
+	uint32_t bestEndpoints[2][3] = {};
+	uint32_t bestIndices[16] = {};
+	float bestPalette[16][4] = {};
+
+	for (uint32_t iteration = 0; iteration < 3; ++iteration)
+	{
+		uint32_t quantized[2][3];
+		float palette[16][4] = {};
+
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			quantized[0][c] = QuantizeBC6H(endpoint0[c]);
+			quantized[1][c] = QuantizeBC6H(endpoint1[c]);
+
+			uint32_t value0 = UnquantizeBC6H(quantized[0][c]);
+			uint32_t value1 = UnquantizeBC6H(quantized[1][c]);
+
+			for (uint32_t p = 0; p < 16; ++p)
+			{
+				palette[p][c] = (float)FinishUnquantizeBC6H(((64 - BC7Weights4[p]) * value0 + BC7Weights4[p] * value1 + 32) >> 6);
+			}
+		}
+
+		uint32_t indices[16];
+		float error = FindIndices<3, 16>(texels, palette, indices);
+
+		if (error < bestError)
+		{
+			bestError = error;
+			memcpy(bestEndpoints, quantized, sizeof(quantized));
+			memcpy(bestIndices, indices, sizeof(indices));
+			memcpy(bestPalette, palette, sizeof(palette));
+		}
+
+		float weights[16];
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			weights[i] = BC7Weights4[indices[i]] / 64.0f;
+		}
+
+		if (!SolveEndpoints<3>(texels, weights, 0.0f, (float)0x7bff, endpoint0, endpoint1))
+		{
+			break;
+		}
+	}
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			decoded[i][c] = HalfBitsToFloat((uint32_t)bestPalette[bestIndices[i]][c]);
+		}
+	}
+
+	// Same as BC7, the first index must be in the first half of the palette
+	if (bestIndices[0] & 8)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			uint32_t temporary = bestEndpoints[0][c];
+			bestEndpoints[0][c] = bestEndpoints[1][c];
+			bestEndpoints[1][c] = temporary;
+		}
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			bestIndices[i] = 15 - bestIndices[i];
+		}
+	}
+
+	// Mode 11: one region with 10-bit endpoints
+	CrBlockBitWriter bitWriter(block);
+	bitWriter.Write(0x03, 5);
+
+	for (uint32_t e = 0; e < 2; ++e)
+	{
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			bitWriter.Write(bestEndpoints[e][c], 10);
+		}
+	}
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		bitWriter.Write(bestIndices[i], i == 0 ? 3 : 4);
+	}
+}
+
+//-------
+// Images
+//-------
+
+struct CrBlockSourceFormat
+{
+	uint32_t texelSize;
+	uint32_t channelCount;
+	bool isBGRA;
+	bool isHalf;
+	bool isFloat;
+};
+
+static bool GetBlockSourceFormat(crgfx::DataFormat::T format, CrBlockSourceFormat& sourceFormat)
+{
+	switch (format)
+	{
+		case crgfx::DataFormat::R8_Unorm:     sourceFormat = { 1, 1, false, false, false }; return true;
+		case crgfx::DataFormat::RG8_Unorm:    sourceFormat = { 2, 2, false, false, false }; return true;
+		case crgfx::DataFormat::RGBA8_Unorm:  sourceFormat = { 4, 4, false, false, false }; return true;
+		case crgfx::DataFormat::RGBA8_SRGB:   sourceFormat = { 4, 4, false, false, false }; return true;
+		case crgfx::DataFormat::BGRA8_Unorm:  sourceFormat = { 4, 4, true, false, false };  return true;
+		case crgfx::DataFormat::BGRA8_SRGB:   sourceFormat = { 4, 4, true, false, false };  return true;
+		case crgfx::DataFormat::RGBA16_Float: sourceFormat = { 8, 4, false, true, false };  return true;
+		case crgfx::DataFormat::RGBA32_Float: sourceFormat = { 16, 4, false, false, true }; return true;
+		default: return false;
+	}
+}
+
+static bool IsBC6H(crgfx::DataFormat::T format)
+{
+	return format == crgfx::DataFormat::BC6H_UFloat || format == crgfx::DataFormat::BC6H_SFloat;
+}
+
+// Texels past the edge of the mip repeat the last row or column. Unorm channels are in [0, 255]. Float channels are
+// returned as they are, and also as half bit patterns for BC6H
+static void FetchBlock
+(
+	const uint8_t* mipData, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY,
+	const CrBlockSourceFormat& sourceFormat, CrBlockTexels& texels, CrBlockTexels& floatTexels
+)
+{
+	for (uint32_t y = 0; y < 4; ++y)
+	{
+		uint32_t sourceY = CrMin(blockY * 4 + y, height - 1);
+
+		for (uint32_t x = 0; x < 4; ++x)
+		{
+			uint32_t sourceX = CrMin(blockX * 4 + x, width - 1);
+			const uint8_t* texel = mipData + ((uint64_t)sourceY * width + sourceX) * sourceFormat.texelSize;
+
+			float* values = texels[y * 4 + x];
+			float* floatValues = floatTexels[y * 4 + x];
+
+			if (sourceFormat.isFloat || sourceFormat.isHalf)
+			{
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					if (sourceFormat.isFloat)
+					{
+						memcpy(&floatValues[c], texel + c * sizeof(float), sizeof(float));
+						values[c] = FloatToHalfBits(floatValues[c]);
+					}
+					else
+					{
+						uint16_t half;
+						memcpy(&half, texel + c * sizeof(uint16_t), sizeof(uint16_t));
+
+						// Negative halves become 0, same as BC6H_UFloat does
+						half = (half & 0x8000) ? 0 : CrMin(half, (uint16_t)0x7bff);
+						values[c] = half;
+						floatValues[c] = HalfBitsToFloat(half);
+					}
+				}
+			}
+			else
+			{
+				values[0] = 0.0f;
+				values[1] = 0.0f;
+				values[2] = 0.0f;
+				values[3] = 255.0f;
+
+				for (uint32_t c = 0; c < sourceFormat.channelCount; ++c)
+				{
+					values[c] = texel[c];
+				}
+
+				if (sourceFormat.isBGRA)
+				{
+					float temporary = values[0];
+					values[0] = values[2];
+					values[2] = temporary;
+				}
+			}
+		}
+	}
+}
+
+static uint32_t GetBlockSize(crgfx::DataFormat::T format)
+{
+	switch (format)
+	{
+		case crgfx::DataFormat::BC1_RGB_Unorm:
+		case crgfx::DataFormat::BC1_RGB_SRGB:
+		case crgfx::DataFormat::BC1_RGBA_Unorm:
+		case crgfx::DataFormat::BC1_RGBA_SRGB:
+		case crgfx::DataFormat::BC4_Unorm:
+			return 8;
+		default:
+			return 16;
+	}
+}
+
+// Channels the format stores, which are the ones that count towards the error
+static uint32_t GetCompressedChannelCount(crgfx::DataFormat::T format)
+{
+	switch (format)
+	{
+		case crgfx::DataFormat::BC4_Unorm:
+			return 1;
+		case crgfx::DataFormat::BC5_Unorm:
+			return 2;
+		case crgfx::DataFormat::BC1_RGB_Unorm:
+		case crgfx::DataFormat::BC1_RGB_SRGB:
+		case crgfx::DataFormat::BC1_RGBA_Unorm:
+		case crgfx::DataFormat::BC1_RGBA_SRGB:
+		case crgfx::DataFormat::BC6H_UFloat:
+			return 3;
+		default:
+			return 4;
+	}
+}
+
+static void EncodeBlock(crgfx::DataFormat::T format, const CrBlockTexels& texels, uint8_t* block, CrBlockTexels& decoded)
+{
+	switch (format)
+	{
+		case crgfx::DataFormat::BC1_RGB_Unorm:
+		case crgfx::DataFormat::BC1_RGB_SRGB:
+		case crgfx::DataFormat::BC1_RGBA_Unorm:
+		case crgfx::DataFormat::BC1_RGBA_SRGB:
+			EncodeBC1Colors(texels, block, decoded);
+			break;
+		case crgfx::DataFormat::BC3_Unorm:
+		case crgfx::DataFormat::BC3_SRGB:
+			// Colors go first as they write an opaque alpha to the decoded texels
+			EncodeBC1Colors(texels, block + 8, decoded);
+			EncodeBC4Channel(texels, 3, block, decoded);
+			break;
+		case crgfx::DataFormat::BC4_Unorm:
+			EncodeBC4Channel(texels, 0, block, decoded);
+			break;
+		case crgfx::DataFormat::BC5_Unorm:
+			EncodeBC4Channel(texels, 0, block, decoded);
+			EncodeBC4Channel(texels, 1, block + 8, decoded);
+			break;
+		case crgfx::DataFormat::BC6H_UFloat:
+			EncodeBC6HBlock(texels, block, decoded);
+			break;
+		case crgfx::DataFormat::BC7_Unorm:
+		case crgfx::DataFormat::BC7_SRGB:
+			EncodeBC7Block(texels, block, decoded);
+			break;
+		default:
+			break;
+	}
+}
+
+struct CrBlockRowError
+{
+	double squaredError;
+
+	float peak;
+};
+
+CrImageEncoderBC::CrImageEncoderBC(crgfx::DataFormat::T format, CrThreadPool* threadPool)
+	: m_format(format)
+	, m_threadPool(threadPool)
+{
+	CrAssertMsg
+	(
+		format == crgfx::DataFormat::BC1_RGB_Unorm || format == crgfx::DataFormat::BC1_RGB_SRGB ||
+		format == crgfx::DataFormat::BC1_RGBA_Unorm || format == crgfx::DataFormat::BC1_RGBA_SRGB ||
+		format == crgfx::DataFormat::BC3_Unorm || format == crgfx::DataFormat::BC3_SRGB ||
+		format == crgfx::DataFormat::BC4_Unorm || format == crgfx::DataFormat::BC5_Unorm ||
+		format == crgfx::DataFormat::BC6H_UFloat ||
+		format == crgfx::DataFormat::BC7_Unorm || format == crgfx::DataFormat::BC7_SRGB,
+		"Format not allowed"
+	);
+
+	m_containerFormat = CrImageContainerFormat::DDS;
+}
+
+CrImageHandle CrImageEncoderBC::Compress(const CrImageHandle& image, CrBlockCompressionStatistics* statistics) const
+{
+	crstl::timer compressionTime;
+
+	CrBlockSourceFormat sourceFormat;
+
+	if (!IsImageFormatSupported(image->GetFormat()) || !GetBlockSourceFormat(image->GetFormat(), sourceFormat) || image->GetType() != crgfx::TextureType::Tex2D)
+	{
+		CrAssertMsg(false, "Cannot compress image");
+		return nullptr;
+	}
+
+	const crgfx::DataFormat::T format = m_format;
+	const uint32_t blockSize = GetBlockSize(format);
+	const uint32_t channelCount = GetCompressedChannelCount(format);
+	const bool isHDR = IsBC6H(format);
+
+	CrImageHandle compressedImage = CrImageHandle(new CrImage());
+	compressedImage->m_width = image->GetWidth();
+	compressedImage->m_height = image->GetHeight();
+	compressedImage->m_depth = 1;
+	compressedImage->m_mipmapCount = image->GetMipmapCount();
+	compressedImage->m_type = image->GetType();
+	compressedImage->m_format = format;
+	compressedImage->m_data.resize_uninitialized(CrTextureCooker::GetMipChainSize(format, image->GetWidth(), image->GetHeight(), 1, image->GetMipmapCount()));
+
+	double squaredError = 0.0;
+	float peak = isHDR ? 0.0f : 255.0f;
+	uint64_t sampleCount = 0;
+
+	for (uint32_t mip = 0; mip < image->GetMipmapCount(); ++mip)
+	{
+		const uint32_t width = CrMax(image->GetWidth() >> mip, 1u);
+		const uint32_t height = CrMax(image->GetHeight() >> mip, 1u);
+		const uint32_t blocksX = (width + 3) / 4;
+		const uint32_t blocksY = (height + 3) / 4;
+
+		const uint8_t* sourceMip = image->GetData() + CrTextureCooker::GetMipChainSize(image->GetFormat(), image->GetWidth(), image->GetHeight(), 1, mip);
+		uint8_t* compressedMip = compressedImage->m_data.data() + CrTextureCooker::GetMipChainSize(format, image->GetWidth(), image->GetHeight(), 1, mip);
+
+		// Every row of blocks keeps its own error so that rows don't contend with each other
+		crstl::vector<CrBlockRowError> rowErrors;
+		rowErrors.resize(blocksY);
+
+		const auto CompressBlockRow = [&](uint32_t blockY)
+		{
+			CrBlockRowError& rowError = rowErrors[blockY];
+			rowError.squaredError = 0.0;
+			rowError.peak = 0.0f;
+
+			for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+			{
+				CrBlockTexels texels, floatTexels, decoded;
+				FetchBlock(sourceMip, width, height, blockX, blockY, sourceFormat, texels, floatTexels);
+
+				EncodeBlock(format, texels, compressedMip + ((uint64_t)blockY * blocksX + blockX) * blockSize, decoded);
+
+				const CrBlockTexels& reference = isHDR ? floatTexels : texels;
+
+				// Only texels inside the mip count towards the error
+				for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; ++y)
+				{
+					for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; ++x)
+					{
+						for (uint32_t c = 0; c < channelCount; ++c)
+						{
+							double difference = (double)decoded[y * 4 + x][c] - (double)reference[y * 4 + x][c];
+							rowError.squaredError += difference * difference;
+							rowError.peak = CrMax(rowError.peak, reference[y * 4 + x][c]);
+						}
+					}
+				}
+			}
+		};
+
+		if (m_threadPool)
+		{
+			m_threadPool->ParallelFor(blocksY, CompressBlockRow);
+		}
+		else
+		{
+			for (uint32_t blockY = 0; blockY < blocksY; ++blockY)
+			{
+				CompressBlockRow(blockY);
+			}
+		}
+
+		for (const CrBlockRowError& rowError : rowErrors)
+		{
+			squaredError += rowError.squaredError;
+
+			if (isHDR)
+			{
+				peak = CrMax(peak, rowError.peak);
+			}
+		}
+
+		sampleCount += (uint64_t)width * height * channelCount;
+	}
+
+	if (statistics)
+	{
+		double meanSquaredError = squaredError / (double)sampleCount;
+
+		// A perfect match has no noise, we cap it to something representable
+		statistics->psnr = meanSquaredError > 0.0 ? 10.0 * log10((double)peak * peak / meanSquaredError) : 100.0;
+		statistics->compressionTime = compressionTime.elapsed().milliseconds();
+	}
+
+	return compressedImage;
+}
+
+void CrImageEncoderBC::Encode(const CrImageHandle& image, CrWriteFileStream& fileStream) const
+{
+	CrImageHandle compressedImage = Compress(image);
+
+	if (compressedImage)
+	{
+		CrImageEncoderDDS().Encode(compressedImage, fileStream);
+	}
+}
+
+void CrImageEncoderBC::Encode(const CrImageHandle& image, void* data, uint64_t dataSize) const
+{
+	CrImageHandle compressedImage = Compress(image);
+
+	if (compressedImage)
+	{
+		CrImageEncoderDDS().Encode(compressedImage, data, dataSize);
+	}
+}
+
+bool CrImageEncoderBC::IsImageFormatSupported(crgfx::DataFormat::T format) const
+{
+	CrBlockSourceFormat sourceFormat;
+
+	if (!GetBlockSourceFormat(format, sourceFormat))
+	{
+		return false;
+	}
+
+	// BC6H needs HDR data, and the rest of the formats 8-bit data
+	bool isFloatSource = sourceFormat.isFloat || sourceFormat.isHalf;
+	return IsBC6H(m_format) ? isFloatSource : !isFloatSource;
+}
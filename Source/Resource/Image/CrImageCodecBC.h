@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ICrImageCodec.h"
+
+class CrThreadPool;
+
+struct CrBlockCompressionStatistics
+{
+	// Peak signal to noise ratio of every mip against the source, in dB. Higher is better. The peak is 255 for LDR
+	// formats and the largest value in the source for BC6H
+	double psnr = 0.0;
+
+	double compressionTime = 0.0;
+};
+
+// Compresses images to BC formats and writes them as DDS. BC1, BC3, BC4 and BC5 fit their endpoints along the
+// principal axis of each block and refine them once, which is fast. BC6H and BC7 refine their endpoints over
+// several passes. They only use the single subset modes, BC6H mode 11 and BC7 mode 6
+class CrImageEncoderBC final : public ICrImageEncoder
+{
+public:
+
+	// Blocks are compressed across the thread pool, or on the calling thread if there isn't one. The pool must
+	// not be the one the calling thread belongs to
+	CrImageEncoderBC(crgfx::DataFormat::T format, CrThreadPool* threadPool = nullptr);
+
+	virtual void Encode(const CrImageHandle& image, CrWriteFileStream& fileStream) const override;
+
+	virtual void Encode(const CrImageHandle& image, void* data, uint64_t dataSize) const override;
+
+	// Whether images in this format can be compressed to the format of the encoder
+	virtual bool IsImageFormatSupported(crgfx::DataFormat::T format) const override;
+
+	// Compresses every mip of a 2D image
+	CrImageHandle Compress(const CrImageHandle& image, CrBlockCompressionStatistics* statistics = nullptr) const;
+
+private:
+
+	crgfx::DataFormat::T m_format;
+
+	CrThreadPool* m_threadPool;
+};
@@ -3,9 +3,12 @@
 #include "CrImageCodecDDS.h"
 
 #include "Core/Streams/CrMemoryStream.h"
+#include "Core/Streams/CrBufferStream.h"
 #include "Core/Streams/CrFileStream.h"
 #include "Core/CrMacros.h"
 
+#include "Math/CrMath.h"
+
 #include "Graphics/CrImage.h"
 #include "Graphics/CrGraphics.h"
 #include "Graphics/DataFormats.h"
@@ -16,16 +19,30 @@ static crgfx::DataFormat::T DXGItoDataFormat(ddspp::DXGIFormat format)
 {
 	switch (format)
 	{
-		case ddspp::BC1_UNORM: 
-			return crgfx::DataFormat::BC1_RGBA_Unorm;
-		case ddspp::BC3_UNORM: 
-			return crgfx::DataFormat::BC3_Unorm;
-		case ddspp::BC4_UNORM: 
-			return crgfx::DataFormat::BC4_Unorm;
-		case ddspp::BC5_UNORM:
-			return crgfx::DataFormat::BC5_Unorm;
-		case ddspp::BC7_UNORM: 
-			return crgfx::DataFormat::BC7_Unorm;
+		case ddspp::R8_UNORM:            return crgfx::DataFormat::R8_Unorm;
+		case ddspp::R8G8_UNORM:          return crgfx::DataFormat::RG8_Unorm;
+		case ddspp::R8G8B8A8_UNORM:      return crgfx::DataFormat::RGBA8_Unorm;
+		case ddspp::R8G8B8A8_UNORM_SRGB: return crgfx::DataFormat::RGBA8_SRGB;
+		case ddspp::B8G8R8A8_UNORM:      return crgfx::DataFormat::BGRA8_Unorm;
+		case ddspp::B8G8R8A8_UNORM_SRGB: return crgfx::DataFormat::BGRA8_SRGB;
+
+		case ddspp::R16G16B16A16_FLOAT:  return crgfx::DataFormat::RGBA16_Float;
+		case ddspp::R32G32B32A32_FLOAT:  return crgfx::DataFormat::RGBA32_Float;
+
+		case ddspp::BC1_UNORM:           return crgfx::DataFormat::BC1_RGBA_Unorm;
+		case ddspp::BC1_UNORM_SRGB:      return crgfx::DataFormat::BC1_RGBA_SRGB;
+		case ddspp::BC2_UNORM:           return crgfx::DataFormat::BC2_Unorm;
+		case ddspp::BC2_UNORM_SRGB:      return crgfx::DataFormat::BC2_SRGB;
+		case ddspp::BC3_UNORM:           return crgfx::DataFormat::BC3_Unorm;
+		case ddspp::BC3_UNORM_SRGB:      return crgfx::DataFormat::BC3_SRGB;
+		case ddspp::BC4_UNORM:           return crgfx::DataFormat::BC4_Unorm;
+		case ddspp::BC4_SNORM:           return crgfx::DataFormat::BC4_Snorm;
+		case ddspp::BC5_UNORM:           return crgfx::DataFormat::BC5_Unorm;
+		case ddspp::BC5_SNORM:           return crgfx::DataFormat::BC5_Snorm;
+		case ddspp::BC6H_UF16:           return crgfx::DataFormat::BC6H_UFloat;
+		case ddspp::BC6H_SF16:           return crgfx::DataFormat::BC6H_SFloat;
+		case ddspp::BC7_UNORM:           return crgfx::DataFormat::BC7_Unorm;
+		case ddspp::BC7_UNORM_SRGB:      return crgfx::DataFormat::BC7_SRGB;
 		default:
 			return crgfx::DataFormat::RGBA8_Unorm;
 	}
@@ -183,7 +200,8 @@ CrImageHandle CrImageDecoderDDS::Decode(crstl::file& file) const
 	ddspp::Descriptor desc;
 	ddspp::Result result = ddspp::decode_header(ddsHeaderData, desc);
 
-	if (result == ddspp::Success)
+	// A file that is cut short doesn't even have all the header
+	if (result == ddspp::Success && file.get_size() >= desc.headerSize)
 	{
 		CrImageHandle image = CrImageHandle(new CrImage());
 
@@ -213,7 +231,7 @@ CrImageHandle CrImageDecoderDDS::Decode(void* data, uint64_t dataSize) const
 	ddspp::Descriptor desc;
 	ddspp::Result result = ddspp::decode_header(ddsHeaderData, desc);
 
-	if (result == ddspp::Success)
+	if (result == ddspp::Success && dataSize >= desc.headerSize)
 	{
 		CrImageHandle image = CrImageHandle(new CrImage());
 
@@ -234,6 +252,43 @@ CrImageHandle CrImageDecoderDDS::Decode(void* data, uint64_t dataSize) const
 	}
 }
 
+CrImageHandle CrImageDecoderDDS::Decode(crstl::file& file, uint32_t firstMipmap) const
+{
+	unsigned char ddsHeaderData[ddspp::MAX_HEADER_SIZE];
+	file.read(ddsHeaderData, ddspp::MAX_HEADER_SIZE);
+
+	ddspp::Descriptor desc;
+	ddspp::Result result = ddspp::decode_header(ddsHeaderData, desc);
+
+	if (result != ddspp::Success || desc.type != ddspp::Texture2D || desc.arraySize > 1 || firstMipmap >= desc.numMips)
+	{
+		return nullptr;
+	}
+
+	// Mips are stored from largest to smallest, so the ones we want are the end of the file
+	uint64_t mipmapOffset = desc.headerSize + ddspp::get_offset(desc, firstMipmap, 0);
+
+	if (file.get_size() < mipmapOffset)
+	{
+		return nullptr;
+	}
+
+	CrImageHandle image = CrImageHandle(new CrImage());
+
+	uint64_t textureDataSize = file.get_size() - mipmapOffset;
+	image->m_data.resize_uninitialized(textureDataSize);
+	file.seek(crstl::file_seek_origin::begin, mipmapOffset);
+	file.read(image->m_data.data(), textureDataSize);
+
+	SetImageProperties(image, desc);
+
+	image->m_width = CrMax(desc.width >> firstMipmap, 1u);
+	image->m_height = CrMax(desc.height >> firstMipmap, 1u);
+	image->m_mipmapCount = desc.numMips - firstMipmap;
+
+	return image;
+}
+
 void CrImageDecoderDDS::SetImageProperties(CrImageHandle& image, const ddspp::Descriptor& desc) const
 {
 	image->m_width = desc.width;
@@ -279,6 +334,12 @@ void CrImageEncoderDDS::Encode(const CrImageHandle& image, void* data, uint64_t
 	EncodeInternal(image, memoryStream);
 }
 
+void CrImageEncoderDDS::Encode(const CrImageHandle& image, crstl::vector<uint8_t>& data) const
+{
+	CrWriteBufferStream bufferStream(data);
+	EncodeInternal(image, bufferStream);
+}
+
 bool CrImageEncoderDDS::IsImageFormatSupported(crgfx::DataFormat::T format) const
 {
 	return ::IsImageFormatSupported(format);
@@ -2,6 +2,8 @@
 
 #include "ICrImageCodec.h"
 
+#include "crstl/vector.h"
+
 namespace ddspp
 {
 	struct Descriptor;
@@ -17,6 +19,10 @@ public:
 
 	virtual CrImageHandle Decode(void* data, uint64_t dataSize) const override;
 
+	// Reads the mips from firstMipmap onwards, as an image whose top mip is firstMipmap. Only the part of the file
+	// with those mips is read. Only for 2D textures
+	CrImageHandle Decode(crstl::file& file, uint32_t firstMipmap) const;
+
 private:
 
 	void SetImageProperties(CrImageHandle& image, const ddspp::Descriptor& desc) const;
@@ -32,6 +38,9 @@ public:
 
 	virtual void Encode(const CrImageHandle& image, void* data, uint64_t dataSize) const override;
 
+	// Encode to memory without knowing the size upfront. The vector is replaced with the encoded image
+	void Encode(const CrImageHandle& image, crstl::vector<uint8_t>& data) const;
+
 	virtual bool IsImageFormatSupported(crgfx::DataFormat::T format) const override;
 
 private:
@@ -0,0 +1,439 @@
+#include "Resource/CrResource_pch.h"
+
+#include "CrImageMipmapGenerator.h"
+#include "CrTextureCooker.h"
+
+#include "Core/Logging/ICrDebug.h"
+
+#include "Math/CrMath.h"
+
+#include "Graphics/CrImage.h"
+#include "Graphics/CrGraphics.h"
+#include "Graphics/DataFormats.h"
+
+#include "crstl/vector.h"
+
+#include <math.h>
+
+// The filters work on one RGBA texel at a time. The SIMD loops operate on whole float4s, and the scalar ones
+// on the floats inside them
+static_assert(sizeof(float4) == 4 * sizeof(float), "Texels must be tightly packed");
+
+static const uint32_t MaxFilterTaps = 8;
+
+// Weights of a separable filter that halves the size of an image. Destination texel x is the weighted sum of
+// source texels 2 * x + firstTap onwards, clamped to the edges
+struct CrMipmapKernel
+{
+	int32_t firstTap;
+	uint32_t tapCount;
+	float weights[MaxFilterTaps];
+};
+
+static float BesselI0(float x)
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+	float halfX = x * 0.5f;
+
+	for (uint32_t k = 1; k < 32 && term > 1e-8f * sum; ++k)
+	{
+		term *= (halfX / k) * (halfX / k);
+		sum += term;
+	}
+
+	return sum;
+}
+
+static float Sinc(float x)
+{
+	return x == 0.0f ? 1.0f : sinf(CrMath::Pi * x) / (CrMath::Pi * x);
+}
+
+static CrMipmapKernel CreateKernel(CrMipmapFilter::T filter)
+{
+	CrMipmapKernel kernel = {};
+
+	if (filter == CrMipmapFilter::Kaiser)
+	{
+		// Sinc windowed to 2 destination texels on either side, i.e. 8 source texels, with the usual alpha of 4.
+		// Source texel centers are at 0.25, 0.75, 1.25 and 1.75 destination texels from the destination center
+		const float Width = 2.0f;
+		const float Alpha = 4.0f;
+
+		kernel.firstTap = -3;
+		kernel.tapCount = 8;
+
+		float weightSum = 0.0f;
+
+		for (uint32_t t = 0; t < kernel.tapCount; ++t)
+		{
+			float distance = ((float)t - 3.5f) * 0.5f;
+			float windowPosition = distance / Width;
+			float window = BesselI0(CrMath::Pi * Alpha * sqrtf(1.0f - windowPosition * windowPosition)) / BesselI0(CrMath::Pi * Alpha);
+
+			kernel.weights[t] = Sinc(distance) * window;
+			weightSum += kernel.weights[t];
+		}
+
+		for (uint32_t t = 0; t < kernel.tapCount; ++t)
+		{
+			kernel.weights[t] /= weightSum;
+		}
+	}
+	else
+	{
+		kernel.firstTap = 0;
+		kernel.tapCount = 2;
+		kernel.weights[0] = 0.5f;
+		kernel.weights[1] = 0.5f;
+	}
+
+	return kernel;
+}
+
+static float SRGBToLinear(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSRGB(float value)
+{
+	return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static const float* GetSRGBToLinearTable()
+{
+	static const struct SRGBToLinearTable
+	{
+		SRGBToLinearTable()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				values[i] = SRGBToLinear(i / 255.0f);
+			}
+		}
+
+		float values[256];
+	} table;
+
+	return table.values;
+}
+
+// Horizontal pass, from a source mip into one that only has the destination width
+static void FilterRowsSIMD(const float4* source, uint32_t sourceWidth, uint32_t rowCount, float4* destination, uint32_t width, const CrMipmapKernel& kernel)
+{
+	float4 weights[MaxFilterTaps];
+
+	for (uint32_t t = 0; t < kernel.tapCount; ++t)
+	{
+		weights[t] = float4(kernel.weights[t], kernel.weights[t], kernel.weights[t], kernel.weights[t]);
+	}
+
+	for (uint32_t y = 0; y < rowCount; ++y)
+	{
+		const float4* sourceRow = source + (uint64_t)y * sourceWidth;
+		float4* destinationRow = destination + (uint64_t)y * width;
+
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			int32_t firstTap = 2 * (int32_t)x + kernel.firstTap;
+
+			float4 sum = float4(0.0f, 0.0f, 0.0f, 0.0f);
+
+			for (uint32_t t = 0; t < kernel.tapCount; ++t)
+			{
+				int32_t sourceX = CrClamp(firstTap + (int32_t)t, 0, (int32_t)sourceWidth - 1);
+				sum = sum + sourceRow[sourceX] * weights[t];
+			}
+
+			destinationRow[x] = sum;
+		}
+	}
+}
+
+// Vertical pass. Whole rows are accumulated at a time so that memory is read in order
+static void FilterColumnsSIMD(const float4* source, uint32_t sourceHeight, uint32_t width, float4* destination, uint32_t height, const CrMipmapKernel& kernel)
+{
+	float4 weights[MaxFilterTaps];
+
+	for (uint32_t t = 0; t < kernel.tapCount; ++t)
+	{
+		weights[t] = float4(kernel.weights[t], kernel.weights[t], kernel.weights[t], kernel.weights[t]);
+	}
+
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		float4* destinationRow = destination + (uint64_t)y * width;
+
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			destinationRow[x] = float4(0.0f, 0.0f, 0.0f, 0.0f);
+		}
+
+		int32_t firstTap = 2 * (int32_t)y + kernel.firstTap;
+
+		for (uint32_t t = 0; t < kernel.tapCount; ++t)
+		{
+			int32_t sourceY = CrClamp(firstTap + (int32_t)t, 0, (int32_t)sourceHeight - 1);
+			const float4* sourceRow = source + (uint64_t)sourceY * width;
+
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				destinationRow[x] = destinationRow[x] + sourceRow[x] * weights[t];
+			}
+		}
+	}
+}
+
+static void FilterRowsScalar(const float4* source, uint32_t sourceWidth, uint32_t rowCount, float4* destination, uint32_t width, const CrMipmapKernel& kernel)
+{
+	for (uint32_t y = 0; y < rowCount; ++y)
+	{
+		const float* sourceRow = (const float*)(source + (uint64_t)y * sourceWidth);
+		float* destinationRow = (float*)(destination + (uint64_t)y * width);
+
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			int32_t firstTap = 2 * (int32_t)x + kernel.firstTap;
+
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				float sum = 0.0f;
+
+				for (uint32_t t = 0; t < kernel.tapCount; ++t)
+				{
+					int32_t sourceX = CrClamp(firstTap + (int32_t)t, 0, (int32_t)sourceWidth - 1);
+					sum += sourceRow[sourceX * 4 + c] * kernel.weights[t];
+				}
+
+				destinationRow[x * 4 + c] = sum;
+			}
+		}
+	}
+}
+
+static void FilterColumnsScalar(const float4* source, uint32_t sourceHeight, uint32_t width, float4* destination, uint32_t height, const CrMipmapKernel& kernel)
+{
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		float* destinationRow = (float*)(destination + (uint64_t)y * width);
+
+		int32_t firstTap = 2 * (int32_t)y + kernel.firstTap;
+
+		for (uint32_t x = 0; x < width * 4; ++x)
+		{
+			float sum = 0.0f;
+
+			for (uint32_t t = 0; t < kernel.tapCount; ++t)
+			{
+				int32_t sourceY = CrClamp(firstTap + (int32_t)t, 0, (int32_t)sourceHeight - 1);
+				sum += ((const float*)(source + (uint64_t)sourceY * width))[x] * kernel.weights[t];
+			}
+
+			destinationRow[x] = sum;
+		}
+	}
+}
+
+static float ComputeAlphaCoverage(const float4* texels, uint64_t texelCount, float alphaCutoff, float alphaScale)
+{
+	uint64_t coveredTexels = 0;
+
+	for (uint64_t i = 0; i < texelCount; ++i)
+	{
+		float alpha = ((const float*)&texels[i])[3];
+		coveredTexels += alpha * alphaScale > alphaCutoff ? 1 : 0;
+	}
+
+	return (float)coveredTexels / (float)texelCount;
+}
+
+// Binary search for the scale that gives the mip the coverage of the top mip
+static float FindAlphaScale(const float4* texels, uint64_t texelCount, float alphaCutoff, float targetCoverage)
+{
+	float minScale = 0.0f;
+	float maxScale = 4.0f;
+	float alphaScale = 1.0f;
+
+	for (uint32_t i = 0; i < 16; ++i)
+	{
+		float coverage = ComputeAlphaCoverage(texels, texelCount, alphaCutoff, alphaScale);
+
+		if (coverage < targetCoverage)
+		{
+			minScale = alphaScale;
+		}
+		else if (coverage > targetCoverage)
+		{
+			maxScale = alphaScale;
+		}
+		else
+		{
+			break;
+		}
+
+		alphaScale = (minScale + maxScale) * 0.5f;
+	}
+
+	return alphaScale;
+}
+
+struct CrMipmapFormat
+{
+	uint32_t channelCount;
+	bool isFloat;
+	bool isSRGB;
+};
+
+static bool GetMipmapFormat(crgfx::DataFormat::T format, CrMipmapFormat& mipmapFormat)
+{
+	switch (format)
+	{
+		case crgfx::DataFormat::R8_Unorm:     mipmapFormat = { 1, false, false }; return true;
+		case crgfx::DataFormat::RG8_Unorm:    mipmapFormat = { 2, false, false }; return true;
+		case crgfx::DataFormat::RGBA8_Unorm:  mipmapFormat = { 4, false, false }; return true;
+		case crgfx::DataFormat::RGBA8_SRGB:   mipmapFormat = { 4, false, true };  return true;
+		case crgfx::DataFormat::BGRA8_Unorm:  mipmapFormat = { 4, false, false }; return true;
+		case crgfx::DataFormat::BGRA8_SRGB:   mipmapFormat = { 4, false, true };  return true;
+		case crgfx::DataFormat::RGBA32_Float: mipmapFormat = { 4, true, false };  return true;
+		default: return false;
+	}
+}
+
+// Converts the top mip to floating point RGBA. Missing channels are black and opaque
+static void LoadTexels(const uint8_t* data, uint64_t texelCount, const CrMipmapFormat& mipmapFormat, bool linearize, float4* texels)
+{
+	if (mipmapFormat.isFloat)
+	{
+		memcpy(texels, data, texelCount * sizeof(float4));
+		return;
+	}
+
+	const float* srgbToLinear = GetSRGBToLinearTable();
+
+	for (uint64_t i = 0; i < texelCount; ++i)
+	{
+		const uint8_t* texel = data + i * mipmapFormat.channelCount;
+		float values[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+		for (uint32_t c = 0; c < mipmapFormat.channelCount; ++c)
+		{
+			// Alpha is always linear
+			values[c] = linearize && c < 3 ? srgbToLinear[texel[c]] : texel[c] / 255.0f;
+		}
+
+		texels[i] = float4(values[0], values[1], values[2], values[3]);
+	}
+}
+
+static void StoreTexels(const float4* texels, uint64_t texelCount, const CrMipmapFormat& mipmapFormat, bool linearized, float alphaScale, uint8_t* data)
+{
+	for (uint64_t i = 0; i < texelCount; ++i)
+	{
+		const float* values = (const float*)&texels[i];
+
+		if (mipmapFormat.isFloat)
+		{
+			float* texel = (float*)data + i * 4;
+			texel[0] = values[0];
+			texel[1] = values[1];
+			texel[2] = values[2];
+			texel[3] = values[3] * alphaScale;
+		}
+		else
+		{
+			uint8_t* texel = data + i * mipmapFormat.channelCount;
+
+			for (uint32_t c = 0; c < mipmapFormat.channelCount; ++c)
+			{
+				// Sharpening filters can overshoot
+				float value = CrClamp(c == 3 ? values[c] * alphaScale : values[c], 0.0f, 1.0f);
+
+				if (linearized && c < 3)
+				{
+					value = LinearToSRGB(value);
+				}
+
+				texel[c] = (uint8_t)(value * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+bool CrImageMipmapGenerator::IsFormatSupported(crgfx::DataFormat::T format)
+{
+	CrMipmapFormat mipmapFormat;
+	return GetMipmapFormat(format, mipmapFormat);
+}
+
+void CrImageMipmapGenerator::Generate(CrImage& image, const CrMipmapSettings& settings)
+{
+	CrMipmapFormat mipmapFormat;
+
+	if (!GetMipmapFormat(image.GetFormat(), mipmapFormat) || image.GetType() != crgfx::TextureType::Tex2D)
+	{
+		CrAssertMsg(false, "Cannot generate mipmaps for this image");
+		return;
+	}
+
+	const CrMipmapKernel kernel = CreateKernel(settings.filter);
+	const bool linearize = mipmapFormat.isSRGB && settings.gammaCorrect;
+	const bool preserveAlphaCoverage = settings.alphaCoverageCutoff > 0.0f && mipmapFormat.channelCount == 4;
+
+	uint32_t width = image.GetWidth();
+	uint32_t height = image.GetHeight();
+	uint32_t mipmapCount = CrTextureCooker::GetFullMipChainCount(width, height);
+
+	crstl::vector<uint8_t> mipmapData;
+	mipmapData.resize_uninitialized(CrTextureCooker::GetMipChainSize(image.GetFormat(), width, height, 1, mipmapCount));
+
+	// The top mip is kept as it is
+	uint64_t topMipSize = CrTextureCooker::GetMipChainSize(image.GetFormat(), width, height, 1, 1);
+	memcpy(mipmapData.data(), image.GetData(), topMipSize);
+
+	crstl::vector<float4> sourceTexels;
+	crstl::vector<float4> filteredRows;
+	crstl::vector<float4> destinationTexels;
+
+	sourceTexels.resize_uninitialized((uint64_t)width * height);
+	filteredRows.resize_uninitialized((uint64_t)CrMax(width / 2, 1u) * height);
+	destinationTexels.resize_uninitialized((uint64_t)CrMax(width / 2, 1u) * CrMax(height / 2, 1u));
+
+	LoadTexels(image.GetData(), (uint64_t)width * height, mipmapFormat, linearize, sourceTexels.data());
+
+	float targetCoverage = preserveAlphaCoverage ? ComputeAlphaCoverage(sourceTexels.data(), (uint64_t)width * height, settings.alphaCoverageCutoff, 1.0f) : 0.0f;
+
+	uint8_t* mipData = mipmapData.data() + topMipSize;
+
+	for (uint32_t mip = 1; mip < mipmapCount; ++mip)
+	{
+		uint32_t mipWidth = CrMax(width >> 1, 1u);
+		uint32_t mipHeight = CrMax(height >> 1, 1u);
+		uint64_t mipTexelCount = (uint64_t)mipWidth * mipHeight;
+
+		if (settings.scalarReference)
+		{
+			FilterRowsScalar(sourceTexels.data(), width, height, filteredRows.data(), mipWidth, kernel);
+			FilterColumnsScalar(filteredRows.data(), height, mipWidth, destinationTexels.data(), mipHeight, kernel);
+		}
+		else
+		{
+			FilterRowsSIMD(sourceTexels.data(), width, height, filteredRows.data(), mipWidth, kernel);
+			FilterColumnsSIMD(filteredRows.data(), height, mipWidth, destinationTexels.data(), mipHeight, kernel);
+		}
+
+		float alphaScale = preserveAlphaCoverage ? FindAlphaScale(destinationTexels.data(), mipTexelCount, settings.alphaCoverageCutoff, targetCoverage) : 1.0f;
+
+		StoreTexels(destinationTexels.data(), mipTexelCount, mipmapFormat, linearize, alphaScale, mipData);
+		mipData += CrTextureCooker::GetMipChainSize(image.GetFormat(), mipWidth, mipHeight, 1, 1);
+
+		// The next mip is filtered from this one before quantization. Alpha is scaled on the way out only
+		sourceTexels.swap(destinationTexels);
+		width = mipWidth;
+		height = mipHeight;
+	}
+
+	image.m_data.swap(mipmapData);
+	image.m_mipmapCount = mipmapCount;
+}
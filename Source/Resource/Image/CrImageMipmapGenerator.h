@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Graphics/CrGraphicsForwardDeclarations.h"
+
+class CrImage;
+
+namespace CrMipmapFilter
+{
+	enum T : uint8_t
+	{
+		Box,    // Average of 2x2 texels. Fast, but blurry and prone to aliasing
+		Kaiser, // Kaiser-windowed sinc. Sharper mips with little ringing
+		Count
+	};
+};
+
+struct CrMipmapSettings
+{
+	CrMipmapFilter::T filter = CrMipmapFilter::Kaiser;
+
+	// Filter sRGB images in linear space. Averaging the encoded values makes mips darker than they should be
+	bool gammaCorrect = true;
+
+	// Alpha tested textures lose coverage in their mips as alpha gets averaged out. If not 0, alpha is scaled in every
+	// mip so that the same fraction of texels passes this cutoff as in the top mip
+	float alphaCoverageCutoff = 0.0f;
+
+	// Run the plain C++ loops instead of the SIMD ones. Only meant for validating them
+	bool scalarReference = false;
+};
+
+// Generates the full mip chain of an image from its top mip. Mips are filtered in floating point, each from the
+// unquantized previous one, and converted back to the format of the image at the end
+class CrImageMipmapGenerator
+{
+public:
+
+	static bool IsFormatSupported(crgfx::DataFormat::T format);
+
+	// Replaces the mips of a 2D image with the ones generated from its top mip
+	static void Generate(CrImage& image, const CrMipmapSettings& settings);
+};
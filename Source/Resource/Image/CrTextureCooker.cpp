@@ -0,0 +1,313 @@
+#include "Resource/CrResource_pch.h"
+
+#include "CrTextureCooker.h"
+#include "CrImageCodecBC.h"
+#include "CrImageCodecDDS.h"
+#include "CrImageMipmapGenerator.h"
+
+#include "Core/CrGlobalPaths.h"
+#include "Core/FileSystem/CrFileUtilities.h"
+#include "Core/Logging/ICrDebug.h"
+
+#include "Math/CrMath.h"
+
+#include "Graphics/CrImage.h"
+#include "Graphics/CrGraphics.h"
+#include "Graphics/DataFormats.h"
+
+#include "GeneratedShaders/ShaderMetadata.h"
+
+#include "crstl/filesystem.h"
+
+#include <stdio.h>
+
+static crgfx::DataFormat::T GetSRGBFormat(crgfx::DataFormat::T format)
+{
+	switch (format)
+	{
+		case crgfx::DataFormat::RGBA8_Unorm:    return crgfx::DataFormat::RGBA8_SRGB;
+		case crgfx::DataFormat::BGRA8_Unorm:    return crgfx::DataFormat::BGRA8_SRGB;
+		case crgfx::DataFormat::BC1_RGB_Unorm:  return crgfx::DataFormat::BC1_RGB_SRGB;
+		case crgfx::DataFormat::BC1_RGBA_Unorm: return crgfx::DataFormat::BC1_RGBA_SRGB;
+		case crgfx::DataFormat::BC2_Unorm:      return crgfx::DataFormat::BC2_SRGB;
+		case crgfx::DataFormat::BC3_Unorm:      return crgfx::DataFormat::BC3_SRGB;
+		case crgfx::DataFormat::BC7_Unorm:      return crgfx::DataFormat::BC7_SRGB;
+		default:                                return format;
+	}
+}
+
+static bool IsOpaque(const CrImage& image)
+{
+	const crgfx::DataFormatInfo& formatInfo = crgfx::DataFormats[image.GetFormat()];
+
+	if (formatInfo.numComponents < 4)
+	{
+		return true;
+	}
+
+	// Only the top mip is checked, filtering doesn't make alpha less opaque
+	uint64_t texelCount = (uint64_t)image.GetWidth() * image.GetHeight();
+
+	for (uint64_t i = 0; i < texelCount; ++i)
+	{
+		if (image.GetData()[i * 4 + 3] != 255)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static crgfx::DataFormat::T GetCompressedFormat(const CrImage& image, CrTextureCompression::T compression)
+{
+	switch (image.GetFormat())
+	{
+		case crgfx::DataFormat::R8_Unorm:
+			return crgfx::DataFormat::BC4_Unorm;
+		case crgfx::DataFormat::RG8_Unorm:
+			return crgfx::DataFormat::BC5_Unorm;
+		case crgfx::DataFormat::RGBA8_Unorm:
+		case crgfx::DataFormat::RGBA8_SRGB:
+		case crgfx::DataFormat::BGRA8_Unorm:
+		case crgfx::DataFormat::BGRA8_SRGB:
+		{
+			if (compression == CrTextureCompression::Quality)
+			{
+				return crgfx::DataFormat::BC7_Unorm;
+			}
+			else
+			{
+				return IsOpaque(image) ? crgfx::DataFormat::BC1_RGB_Unorm : crgfx::DataFormat::BC3_Unorm;
+			}
+		}
+		case crgfx::DataFormat::RGBA16_Float:
+		case crgfx::DataFormat::RGBA32_Float:
+			return crgfx::DataFormat::BC6H_UFloat;
+		default:
+			return crgfx::DataFormat::Invalid;
+	}
+}
+
+CrTextureCookSettings::CrTextureCookSettings() : format(crgfx::DataFormat::Invalid)
+{
+
+}
+
+CrTextureCookSettings::CrTextureCookSettings(Textures::T semantic) : CrTextureCookSettings()
+{
+	srgb = semantic == Textures::DiffuseTexture0 || semantic == Textures::EmissiveTexture0;
+}
+
+CrHash CrTextureCookSettings::GetHash() const
+{
+	CrHash hash(format);
+	hash << CrHash(generateMipmaps);
+	hash << CrHash(mipmaps.filter);
+	hash << CrHash(mipmaps.gammaCorrect);
+	hash << CrHash(mipmaps.alphaCoverageCutoff);
+	hash << CrHash(srgb);
+	hash << CrHash(compression);
+	return hash;
+}
+
+CrImageHandle CrTextureCooker::Cook
+(
+	const CrImageHandle& sourceImage, const CrTextureCookSettings& settings,
+	CrThreadPool* threadPool, CrBlockCompressionStatistics* statistics
+)
+{
+	// Compressed sources have already been through some other cooker, and there is nothing we can do to them
+	if (crgfx::DataFormats[sourceImage->GetFormat()].compressed)
+	{
+		return sourceImage;
+	}
+
+	// The format is decided first so that mips of sRGB textures are filtered in linear space
+	crgfx::DataFormat::T format = settings.srgb ? GetSRGBFormat(sourceImage->GetFormat()) : sourceImage->GetFormat();
+
+	CrImageHandle cookedImage = CrImageHandle(new CrImage());
+	cookedImage->m_width = sourceImage->GetWidth();
+	cookedImage->m_height = sourceImage->GetHeight();
+	cookedImage->m_depth = sourceImage->GetDepth();
+	cookedImage->m_mipmapCount = sourceImage->GetMipmapCount();
+	cookedImage->m_type = sourceImage->GetType();
+	cookedImage->m_format = format;
+	cookedImage->m_data = sourceImage->m_data;
+
+	if (settings.generateMipmaps && sourceImage->GetMipmapCount() <= 1 &&
+		sourceImage->GetType() == crgfx::TextureType::Tex2D && CrImageMipmapGenerator::IsFormatSupported(format))
+	{
+		CrImageMipmapGenerator::Generate(*cookedImage, settings.mipmaps);
+	}
+
+	crgfx::DataFormat::T compressedFormat = settings.format;
+
+	if (compressedFormat == crgfx::DataFormat::Invalid && settings.compression != CrTextureCompression::None)
+	{
+		compressedFormat = GetCompressedFormat(*cookedImage, settings.compression);
+	}
+
+	if (compressedFormat == crgfx::DataFormat::Invalid)
+	{
+		return cookedImage;
+	}
+
+	compressedFormat = settings.srgb ? GetSRGBFormat(compressedFormat) : compressedFormat;
+
+	if (compressedFormat == format)
+	{
+		return cookedImage;
+	}
+
+	if (compressedFormat < crgfx::DataFormat::FirstBC || compressedFormat > crgfx::DataFormat::LastBC)
+	{
+		CrLog("Cooking textures to %s is not supported, keeping %s", crgfx::DataFormats[compressedFormat].name, crgfx::DataFormats[format].name);
+		return cookedImage;
+	}
+
+	// Block compressed textures need whole blocks in their top mip
+	if (cookedImage->GetType() != crgfx::TextureType::Tex2D || (cookedImage->GetWidth() % 4) != 0 || (cookedImage->GetHeight() % 4) != 0)
+	{
+		CrLog("Cannot compress %ux%u texture to %s, keeping %s", cookedImage->GetWidth(), cookedImage->GetHeight(),
+			crgfx::DataFormats[compressedFormat].name, crgfx::DataFormats[format].name);
+		return cookedImage;
+	}
+
+	CrImageEncoderBC imageEncoder(compressedFormat, threadPool);
+
+	if (!imageEncoder.IsImageFormatSupported(format))
+	{
+		CrLog("Cannot compress %s to %s, keeping %s", crgfx::DataFormats[format].name, crgfx::DataFormats[compressedFormat].name, crgfx::DataFormats[format].name);
+		return cookedImage;
+	}
+
+	return imageEncoder.Compress(cookedImage, statistics);
+}
+
+CrHash CrTextureCooker::GetCacheKey(const uint8_t* sourceData, uint64_t sourceDataSize, const CrTextureCookSettings& settings)
+{
+	CrHash cacheKey(sourceData, sourceDataSize);
+	cacheKey << settings.GetHash();
+	cacheKey << CrHash(CrCookedTextureVersion::CurrentVersion);
+	return cacheKey;
+}
+
+CrFixedPath CrTextureCooker::GetCachePath(const CrHash& cacheKey)
+{
+	char cacheFilename[32];
+	snprintf(cacheFilename, sizeof(cacheFilename), "%016llx.dds", (unsigned long long)cacheKey.GetHash());
+
+	CrFixedPath cachePath = CrGlobalPaths::GetTempEngineDirectory().c_str();
+	cachePath /= "Texture Cache";
+	cachePath /= cacheFilename;
+	return cachePath;
+}
+
+CrImageHandle CrTextureCooker::LoadFromCache(const CrHash& cacheKey)
+{
+	CrFixedPath cachePath = GetCachePath(cacheKey);
+
+	if (!crstl::exists(cachePath.c_str()))
+	{
+		return nullptr;
+	}
+
+	crstl::file file(cachePath.c_str(), crstl::file_flags::read);
+
+	if (!file)
+	{
+		return nullptr;
+	}
+
+	CrImageDecoderDDS imageDecoder;
+	CrImageHandle image = imageDecoder.Decode(file);
+
+	// Textures are written to the cache from the loading threads, and one may have been interrupted
+	if (image && image->GetDataSize() < GetMipChainSize(image->GetFormat(), image->GetWidth(), image->GetHeight(), image->GetDepth(), image->GetMipmapCount()))
+	{
+		CrLog("Cooked texture %s is incomplete", cachePath.c_str());
+		return nullptr;
+	}
+
+	return image;
+}
+
+bool CrTextureCooker::SaveToCache(const CrImageHandle& image, const CrHash& cacheKey)
+{
+	CrFixedPath cachePath = GetCachePath(cacheKey);
+
+	CrFixedPath cacheDirectory = cachePath.parent_path();
+
+	if (!crstl::exists(cacheDirectory.c_str()))
+	{
+		crstl::create_directories(cacheDirectory.c_str());
+	}
+
+	// Encode in memory first so that the file is written in one go
+	crstl::vector<uint8_t> encodedImage;
+	CrImageEncoderDDS imageEncoder;
+	imageEncoder.Encode(image, encodedImage);
+
+	// Loading threads and the texture streamer may be reading the cooked texture, or another loading thread may be
+	// cooking the same one, so it's written elsewhere and moved into place once it's complete
+	CrFixedPath temporaryFilePath = crcore::GetTemporaryFilePath(cachePath);
+
+	bool written = false;
+
+	if (crstl::file cacheFile = crstl::file(temporaryFilePath.c_str(), crstl::file_flags::write | crstl::file_flags::force_create))
+	{
+		written = cacheFile.write(encodedImage.data(), encodedImage.size()) == encodedImage.size();
+	}
+	else
+	{
+		CrLog("Could not create %s", temporaryFilePath.c_str());
+		return false;
+	}
+
+	if (!written || !crcore::MoveFileOver(temporaryFilePath, cachePath))
+	{
+		CrLog("Could not write %s", cachePath.c_str());
+		crstl::delete_file(temporaryFilePath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+uint64_t CrTextureCooker::GetMipChainSize(crgfx::DataFormat::T format, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipmapCount)
+{
+	const crgfx::DataFormatInfo& formatInfo = crgfx::DataFormats[format];
+	uint32_t blockWidth = formatInfo.blockWidth;
+	uint32_t blockHeight = formatInfo.blockHeight;
+	uint32_t blockSize = formatInfo.dataOrBlockSize;
+
+	uint64_t mipChainSize = 0;
+
+	for (uint32_t mip = 0; mip < mipmapCount; ++mip)
+	{
+		uint32_t mipWidth = CrMax(width >> mip, 1u);
+		uint32_t mipHeight = CrMax(height >> mip, 1u);
+		uint32_t mipDepth = CrMax(depth >> mip, 1u);
+
+		uint64_t blockCount = (uint64_t)((mipWidth + blockWidth - 1) / blockWidth) * ((mipHeight + blockHeight - 1) / blockHeight) * mipDepth;
+		mipChainSize += blockCount * blockSize;
+	}
+
+	return mipChainSize;
+}
+
+uint32_t CrTextureCooker::GetFullMipChainCount(uint32_t width, uint32_t height)
+{
+	uint32_t largestDimension = CrMax(width, height);
+
+	uint32_t mipmapCount = 1;
+
+	while (largestDimension > 1)
+	{
+		largestDimension >>= 1;
+		mipmapCount++;
+	}
+
+	return mipmapCount;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Core/FileSystem/CrFixedPath.h"
+#include "Core/CrHash.h"
+
+#include "Graphics/CrGraphicsForwardDeclarations.h"
+
+#include "Resource/Image/CrImageForwardDeclarations.h"
+#include "Resource/Image/CrImageMipmapGenerator.h"
+
+class CrThreadPool;
+struct CrBlockCompressionStatistics;
+
+namespace CrCookedTextureVersion
+{
+	enum T : uint32_t
+	{
+		InitialVersion,
+		FilteredMipmaps, // Mipmaps come from the mipmap generator instead of a box filter
+		BlockCompressed, // Textures are compressed to BC formats
+		CurrentVersion = BlockCompressed
+	};
+};
+
+namespace CrTextureCompression
+{
+	enum T : uint8_t
+	{
+		None,    // Keep the uncompressed format
+		Fast,    // BC1 or BC3 for color, BC4 and BC5 for one and two channels
+		Quality, // BC7 for color, BC4 and BC5 for one and two channels
+	};
+};
+
+// How a source image is turned into its cooked texture. Any change to them produces a different cached texture
+struct CrTextureCookSettings
+{
+	CrHash GetHash() const;
+
+	// Format of the cooked texture. Invalid chooses one from the source and the compression setting
+	crgfx::DataFormat::T format;
+
+	// Floating point sources are always compressed to BC6H unless compression is None
+	CrTextureCompression::T compression = CrTextureCompression::Quality;
+
+	// Generates the full mip chain if the source doesn't have one
+	bool generateMipmaps = true;
+
+	CrMipmapSettings mipmaps;
+
+	// The source is color data in sRGB space, so the cooked texture uses the sRGB variant of its format
+	bool srgb = true;
+
+	CrTextureCookSettings();
+
+	// Settings for a texture bound to this material slot. Only color slots, i.e. diffuse and emissive, are sRGB
+	explicit CrTextureCookSettings(Textures::T semantic);
+};
+
+// Turns source images into textures in their final form, i.e. with their mip chain and in the format the GPU
+// consumes, and keeps them in a cache keyed by the contents of the source and the cook settings. Cooked textures
+// are stored as DDS, so loading one is reading the file and copying it into the texture
+class CrTextureCooker
+{
+public:
+
+	// Block compression runs across the thread pool if there is one. Statistics are only filled in if the texture
+	// was compressed
+	static CrImageHandle Cook
+	(
+		const CrImageHandle& sourceImage, const CrTextureCookSettings& settings,
+		CrThreadPool* threadPool = nullptr, CrBlockCompressionStatistics* statistics = nullptr
+	);
+
+	static CrHash GetCacheKey(const uint8_t* sourceData, uint64_t sourceDataSize, const CrTextureCookSettings& settings);
+
+	static CrFixedPath GetCachePath(const CrHash& cacheKey);
+
+	// Returns null if there is no cooked texture for the key, or it's incomplete
+	static CrImageHandle LoadFromCache(const CrHash& cacheKey);
+
+	static bool SaveToCache(const CrImageHandle& image, const CrHash& cacheKey);
+
+	// Size of the mip chain of an image, with mips laid out one after the other the way DDS stores them
+	static uint64_t GetMipChainSize(crgfx::DataFormat::T format, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipmapCount);
+
+	static uint32_t GetFullMipChainCount(uint32_t width, uint32_t height);
+};
@@ -0,0 +1,34 @@
+#include "Resource/CrResource_pch.h"
+
+#include "ICrImageCodec.h"
+#include "CrImageCodecDDS.h"
+#include "CrImageCodecSTB.h"
+#include "CrImageCodecWuffs.h"
+
+crstl::unique_ptr<ICrImageDecoder> ICrImageDecoder::Create(const CrFixedPath& filePath)
+{
+	CrFixedPath extension = filePath.extension();
+
+	if (extension.comparei(".dds") == 0)
+	{
+		return crstl::unique_ptr<ICrImageDecoder>(new CrImageDecoderDDS());
+	}
+	else if
+	(
+		extension.comparei(".png") == 0 ||
+		extension.comparei(".tga") == 0 ||
+		extension.comparei(".jpg") == 0 ||
+		extension.comparei(".jpeg") == 0 ||
+		extension.comparei(".gif") == 0 ||
+		extension.comparei(".bmp") == 0 ||
+		extension.comparei(".wbmp") == 0 ||
+		extension.comparei(".nie") == 0
+	)
+	{
+		return crstl::unique_ptr<ICrImageDecoder>(new CrImageDecoderWuffs());
+	}
+	else
+	{
+		return crstl::unique_ptr<ICrImageDecoder>(new CrImageDecoderSTB());
+	}
+}
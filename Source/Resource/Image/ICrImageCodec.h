@@ -4,8 +4,11 @@
 #include "Core/CrCoreForwardDeclarations.h"
 #include "Resource/Image/CrImageForwardDeclarations.h"
 
+#include "Core/FileSystem/CrFixedPath.h"
 #include "Core/Streams/CrFileStream.h" // TODO Delete once crstl is good
 
+#include "crstl/unique_ptr.h"
+
 #include <stdint.h>
 
 class ICrImageCodec
@@ -28,6 +31,9 @@ public:
 
 	// Decode image in provided data
 	virtual CrImageHandle Decode(void* data, uint64_t dataSize) const = 0;
+
+	// Creates the decoder for the format of the file
+	static crstl::unique_ptr<ICrImageDecoder> Create(const CrFixedPath& filePath);
 };
 
 class ICrImageEncoder : public ICrImageCodec
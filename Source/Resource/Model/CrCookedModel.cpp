@@ -0,0 +1,457 @@
+#include "Resource/CrResource_pch.h"
+
+#include "CrCookedModel.h"
+#include "CrModelData.h"
+
+#include "Core/Logging/ICrDebug.h"
+#include "Core/FileSystem/CrFileUtilities.h"
+#include "Core/Streams/CrFileStream.h"
+#include "Core/CrHash.h"
+
+#include "crstl/filesystem.h"
+#include "crstl/vector.h"
+
+warnings_off
+#include <meshoptimizer.h>
+warnings_on
+
+static uint64_t AlignStreamOffset(uint64_t offset)
+{
+	return (offset + CrCookedModel::StreamAlignment - 1) & ~(uint64_t)(CrCookedModel::StreamAlignment - 1);
+}
+
+template<typename T>
+static void CopyToBuffer(crstl::vector<uint8_t>& buffer, uint64_t offset, const T* data, uint64_t count)
+{
+	memcpy(buffer.data() + offset, data, count * sizeof(T));
+}
+
+// Vertex and index streams of a mesh the way they go into the file
+struct CrCookedMeshStreams
+{
+	const uint8_t* positions;
+	const uint8_t* additional;
+	const uint8_t* indices;
+
+	crstl::vector<uint8_t> encodedPositions;
+	crstl::vector<uint8_t> encodedAdditional;
+	crstl::vector<uint8_t> encodedIndices;
+};
+
+static void EncodeVertexStream(crstl::vector<uint8_t>& encodedStream, const void* vertices, uint32_t vertexCount, uint32_t vertexSize)
+{
+	encodedStream.resize_uninitialized(meshopt_encodeVertexBufferBound(vertexCount, vertexSize));
+	encodedStream.resize(meshopt_encodeVertexBuffer(encodedStream.data(), encodedStream.size(), vertices, vertexCount, vertexSize));
+}
+
+static void EncodeIndexStream(crstl::vector<uint8_t>& encodedStream, const uint8_t* indices, uint32_t indexCount, crgfx::DataFormat::T indexFormat)
+{
+	// The encoder takes 32-bit indices, but decodes to either size
+	crstl::vector<uint32_t> indices32;
+	indices32.resize_uninitialized(indexCount);
+
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		indices32[i] = indexFormat == crgfx::DataFormat::R16_Uint ? ((const uint16_t*)indices)[i] : ((const uint32_t*)indices)[i];
+	}
+
+	encodedStream.resize_uninitialized(meshopt_encodeIndexBufferBound(indexCount, indexCount));
+	encodedStream.resize(meshopt_encodeIndexBuffer(encodedStream.data(), encodedStream.size(), indices32.data(), indexCount));
+}
+
+bool CrCookedModel::Write(const CrModelData& modelData, uint64_t sourceHash, const CrFixedPath& cookedModelPath, bool compressStreams)
+{
+	uint32_t textureCount = 0;
+
+	for (const CrModelMaterialData& materialData : modelData.materials)
+	{
+		textureCount += (uint32_t)materialData.textures.size();
+	}
+
+	CrCookedModelHeader header = {};
+	header.magic = CrCookedModelHeader::Magic;
+	header.version = CrCookedModelVersion::CurrentVersion;
+	header.sourceHash = sourceHash;
+	header.materialCount = (uint32_t)modelData.materials.size();
+	header.textureCount = textureCount;
+	header.meshCount = (uint32_t)modelData.meshes.size();
+
+	uint64_t materialTableOffset = sizeof(CrCookedModelHeader);
+	uint64_t textureTableOffset = materialTableOffset + header.materialCount * sizeof(CrCookedModelMaterial);
+	uint64_t meshTableOffset = textureTableOffset + header.textureCount * sizeof(CrCookedModelTexture);
+	uint64_t pathsOffset = meshTableOffset + header.meshCount * sizeof(CrCookedModelMesh);
+
+	// Lay out the texture paths and then every stream
+	crstl::vector<CrCookedModelMaterial> cookedMaterials;
+	crstl::vector<CrCookedModelTexture> cookedTextures;
+	crstl::vector<CrCookedModelMesh> cookedMeshes;
+	crstl::vector<CrCookedMeshStreams> cookedMeshStreams;
+	cookedMeshStreams.resize(modelData.meshes.size());
+
+	uint64_t currentOffset = pathsOffset;
+
+	for (const CrModelMaterialData& materialData : modelData.materials)
+	{
+		CrCookedModelMaterial cookedMaterial = {};
+		cookedMaterial.color[0] = materialData.color.x;
+		cookedMaterial.color[1] = materialData.color.y;
+		cookedMaterial.color[2] = materialData.color.z;
+		cookedMaterial.color[3] = materialData.color.w;
+		cookedMaterial.firstTexture = (uint32_t)cookedTextures.size();
+		cookedMaterial.textureCount = (uint32_t)materialData.textures.size();
+		cookedMaterials.push_back(cookedMaterial);
+
+		for (const CrModelTextureData& textureData : materialData.textures)
+		{
+			CrCookedModelTexture cookedTexture = {};
+			cookedTexture.semantic = textureData.semantic;
+			cookedTexture.pathLength = (uint32_t)textureData.path.length();
+			cookedTexture.pathOffset = currentOffset;
+			cookedTextures.push_back(cookedTexture);
+
+			currentOffset += cookedTexture.pathLength + 1;
+		}
+	}
+
+	for (uint32_t m = 0; m < modelData.meshes.size(); ++m)
+	{
+		const CrModelMeshData& meshData = modelData.meshes[m];
+		CrCookedMeshStreams& meshStreams = cookedMeshStreams[m];
+
+		CrCookedModelMesh cookedMesh = {};
+		cookedMesh.vertexCount = meshData.vertexCount;
+		cookedMesh.indexCount = meshData.indexCount;
+		cookedMesh.indexFormat = meshData.indexFormat;
+		cookedMesh.materialIndex = meshData.materialIndex;
+		cookedMesh.boundingBoxCenter[0] = meshData.boundingBox.center.x;
+		cookedMesh.boundingBoxCenter[1] = meshData.boundingBox.center.y;
+		cookedMesh.boundingBoxCenter[2] = meshData.boundingBox.center.z;
+		cookedMesh.boundingBoxExtents[0] = meshData.boundingBox.extents.x;
+		cookedMesh.boundingBoxExtents[1] = meshData.boundingBox.extents.y;
+		cookedMesh.boundingBoxExtents[2] = meshData.boundingBox.extents.z;
+		cookedMesh.positionFormat = meshData.positionFormat;
+		cookedMesh.positionOrigin[0] = meshData.positionOffset.x;
+		cookedMesh.positionOrigin[1] = meshData.positionOffset.y;
+		cookedMesh.positionOrigin[2] = meshData.positionOffset.z;
+		cookedMesh.positionScale = meshData.positionScale;
+		cookedMesh.uvDensity = meshData.uvDensity;
+
+		uint32_t positionSize = GetPositionVertexDescriptor(meshData.positionFormat).GetDataSize();
+
+		meshStreams.positions = meshData.positions;
+		meshStreams.additional = (const uint8_t*)meshData.additionalVertices;
+		meshStreams.indices = meshData.indices;
+		cookedMesh.positionStreamSize = meshData.vertexCount * (uint64_t)positionSize;
+		cookedMesh.additionalStreamSize = meshData.vertexCount * sizeof(ComplexVertexAdditional);
+		cookedMesh.indexStreamSize = meshData.indexCount * (uint64_t)CrModelData::GetIndexSize(meshData.indexFormat);
+
+		// The index codec only understands triangle lists
+		if (compressStreams && meshData.indexCount % 3 == 0)
+		{
+			EncodeVertexStream(meshStreams.encodedPositions, meshData.positions, meshData.vertexCount, positionSize);
+			EncodeVertexStream(meshStreams.encodedAdditional, meshData.additionalVertices, meshData.vertexCount, sizeof(ComplexVertexAdditional));
+			meshStreams.positions = meshStreams.encodedPositions.data();
+			meshStreams.additional = meshStreams.encodedAdditional.data();
+			cookedMesh.positionStreamSize = meshStreams.encodedPositions.size();
+			cookedMesh.additionalStreamSize = meshStreams.encodedAdditional.size();
+
+			if (meshData.indices)
+			{
+				EncodeIndexStream(meshStreams.encodedIndices, meshData.indices, meshData.indexCount, meshData.indexFormat);
+				meshStreams.indices = meshStreams.encodedIndices.data();
+				cookedMesh.indexStreamSize = meshStreams.encodedIndices.size();
+			}
+
+			cookedMesh.flags |= CrCookedModelMeshFlags::CompressedStreams;
+		}
+
+		cookedMesh.positionOffset = AlignStreamOffset(currentOffset);
+		currentOffset = cookedMesh.positionOffset + cookedMesh.positionStreamSize;
+
+		cookedMesh.additionalOffset = AlignStreamOffset(currentOffset);
+		currentOffset = cookedMesh.additionalOffset + cookedMesh.additionalStreamSize;
+
+		cookedMesh.indexOffset = AlignStreamOffset(currentOffset);
+		currentOffset = cookedMesh.indexOffset + cookedMesh.indexStreamSize;
+
+		cookedMesh.meshletCount = meshData.meshletCount;
+		cookedMesh.meshletVertexCount = meshData.meshletVertexCount;
+		cookedMesh.meshletTriangleCount = meshData.meshletTriangleCount;
+
+		cookedMesh.meshletOffset = AlignStreamOffset(currentOffset);
+		currentOffset = cookedMesh.meshletOffset + meshData.meshletCount * sizeof(CrMeshlet);
+
+		cookedMesh.meshletVertexOffset = AlignStreamOffset(currentOffset);
+		currentOffset = cookedMesh.meshletVertexOffset + meshData.meshletVertexCount * sizeof(uint32_t);
+
+		cookedMesh.meshletTriangleOffset = AlignStreamOffset(currentOffset);
+		currentOffset = cookedMesh.meshletTriangleOffset + meshData.meshletTriangleCount * 3;
+
+		cookedMesh.instanceCount = meshData.instanceCount;
+		cookedMesh.instanceOffset = AlignStreamOffset(currentOffset);
+		currentOffset = cookedMesh.instanceOffset + meshData.instanceCount * sizeof(float4x4);
+
+		cookedMeshes.push_back(cookedMesh);
+	}
+
+	// Build the whole file in memory so that it's written in one go
+	crstl::vector<uint8_t> fileData;
+	fileData.resize(currentOffset);
+
+	CopyToBuffer(fileData, 0, &header, 1);
+	CopyToBuffer(fileData, materialTableOffset, cookedMaterials.data(), cookedMaterials.size());
+	CopyToBuffer(fileData, textureTableOffset, cookedTextures.data(), cookedTextures.size());
+	CopyToBuffer(fileData, meshTableOffset, cookedMeshes.data(), cookedMeshes.size());
+
+	uint32_t textureIndex = 0;
+
+	for (const CrModelMaterialData& materialData : modelData.materials)
+	{
+		for (const CrModelTextureData& textureData : materialData.textures)
+		{
+			// The terminator comes from the zero-initialized buffer
+			CopyToBuffer(fileData, cookedTextures[textureIndex].pathOffset, textureData.path.c_str(), textureData.path.length());
+			textureIndex++;
+		}
+	}
+
+	for (uint32_t m = 0; m < modelData.meshes.size(); ++m)
+	{
+		const CrModelMeshData& meshData = modelData.meshes[m];
+		const CrCookedModelMesh& cookedMesh = cookedMeshes[m];
+		const CrCookedMeshStreams& meshStreams = cookedMeshStreams[m];
+
+		CopyToBuffer(fileData, cookedMesh.positionOffset, meshStreams.positions, cookedMesh.positionStreamSize);
+		CopyToBuffer(fileData, cookedMesh.additionalOffset, meshStreams.additional, cookedMesh.additionalStreamSize);
+
+		if (meshStreams.indices)
+		{
+			CopyToBuffer(fileData, cookedMesh.indexOffset, meshStreams.indices, cookedMesh.indexStreamSize);
+		}
+
+		if (meshData.meshlets)
+		{
+			CopyToBuffer(fileData, cookedMesh.meshletOffset, meshData.meshlets, meshData.meshletCount);
+			CopyToBuffer(fileData, cookedMesh.meshletVertexOffset, meshData.meshletVertices, meshData.meshletVertexCount);
+			CopyToBuffer(fileData, cookedMesh.meshletTriangleOffset, meshData.meshletTriangles, meshData.meshletTriangleCount * 3);
+		}
+
+		if (meshData.instanceTransforms)
+		{
+			CopyToBuffer(fileData, cookedMesh.instanceOffset, meshData.instanceTransforms, meshData.instanceCount);
+		}
+	}
+
+	CrFixedPath temporaryFilePath = crcore::GetTemporaryFilePath(cookedModelPath);
+
+	bool written = false;
+
+	if (crstl::file cookedModelFile = crstl::file(temporaryFilePath.c_str(), crstl::file_flags::write | crstl::file_flags::force_create))
+	{
+		written = cookedModelFile.write(fileData.data(), fileData.size()) == fileData.size();
+	}
+	else
+	{
+		CrLog("Could not create %s", temporaryFilePath.c_str());
+		return false;
+	}
+
+	if (!written || !crcore::MoveFileOver(temporaryFilePath, cookedModelPath))
+	{
+		CrLog("Could not write %s", cookedModelPath.c_str());
+		crstl::delete_file(temporaryFilePath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool CrCookedModel::Load(const CrFixedPath& cookedModelPath, uint64_t sourceHash, CrModelData& modelData)
+{
+	if (!modelData.MapFile(cookedModelPath))
+	{
+		return false;
+	}
+
+	const uint8_t* fileData = modelData.GetMappedFile().GetData();
+	uint64_t fileSize = modelData.GetMappedFile().GetSize();
+
+	if (fileSize < sizeof(CrCookedModelHeader))
+	{
+		return false;
+	}
+
+	const CrCookedModelHeader& header = *(const CrCookedModelHeader*)fileData;
+
+	if (header.magic != CrCookedModelHeader::Magic || header.version != CrCookedModelVersion::CurrentVersion)
+	{
+		CrLog("Cooked model %s has an unsupported version", cookedModelPath.c_str());
+		return false;
+	}
+
+	if (sourceHash != 0 && header.sourceHash != sourceHash)
+	{
+		CrLog("Cooked model %s is out of date", cookedModelPath.c_str());
+		return false;
+	}
+
+	uint64_t materialTableOffset = sizeof(CrCookedModelHeader);
+	uint64_t textureTableOffset = materialTableOffset + header.materialCount * sizeof(CrCookedModelMaterial);
+	uint64_t meshTableOffset = textureTableOffset + header.textureCount * sizeof(CrCookedModelTexture);
+	uint64_t pathsOffset = meshTableOffset + header.meshCount * sizeof(CrCookedModelMesh);
+
+	// Anything pointing outside the file means the cooked model is corrupt
+	const auto IsInFile = [fileSize](uint64_t offset, uint64_t size)
+	{
+		return offset <= fileSize && size <= fileSize - offset;
+	};
+
+	if (!IsInFile(0, pathsOffset))
+	{
+		CrLog("Cooked model %s is corrupt", cookedModelPath.c_str());
+		return false;
+	}
+
+	const CrCookedModelMaterial* cookedMaterials = (const CrCookedModelMaterial*)(fileData + materialTableOffset);
+	const CrCookedModelTexture* cookedTextures = (const CrCookedModelTexture*)(fileData + textureTableOffset);
+	const CrCookedModelMesh* cookedMeshes = (const CrCookedModelMesh*)(fileData + meshTableOffset);
+
+	modelData.materials.resize(header.materialCount);
+
+	for (uint32_t m = 0; m < header.materialCount; ++m)
+	{
+		const CrCookedModelMaterial& cookedMaterial = cookedMaterials[m];
+		CrModelMaterialData& materialData = modelData.materials[m];
+
+		if (cookedMaterial.firstTexture > header.textureCount || cookedMaterial.textureCount > header.textureCount - cookedMaterial.firstTexture)
+		{
+			CrLog("Cooked model %s is corrupt", cookedModelPath.c_str());
+			return false;
+		}
+
+		materialData.color = float4(cookedMaterial.color[0], cookedMaterial.color[1], cookedMaterial.color[2], cookedMaterial.color[3]);
+
+		for (uint32_t t = 0; t < cookedMaterial.textureCount; ++t)
+		{
+			const CrCookedModelTexture& cookedTexture = cookedTextures[cookedMaterial.firstTexture + t];
+
+			// Paths are null terminated
+			if (!IsInFile(cookedTexture.pathOffset, cookedTexture.pathLength + 1ull) || fileData[cookedTexture.pathOffset + cookedTexture.pathLength] != 0)
+			{
+				CrLog("Cooked model %s is corrupt", cookedModelPath.c_str());
+				return false;
+			}
+
+			CrModelTextureData textureData;
+			textureData.semantic = (Textures::T)cookedTexture.semantic;
+			textureData.path = (const char*)(fileData + cookedTexture.pathOffset);
+			materialData.textures.push_back(textureData);
+		}
+	}
+
+	modelData.meshes.resize(header.meshCount);
+
+	for (uint32_t m = 0; m < header.meshCount; ++m)
+	{
+		const CrCookedModelMesh& cookedMesh = cookedMeshes[m];
+		CrModelMeshData& meshData = modelData.meshes[m];
+
+		crgfx::DataFormat::T indexFormat = (crgfx::DataFormat::T)cookedMesh.indexFormat;
+		CrVertexPositionFormat::T positionFormat = (CrVertexPositionFormat::T)cookedMesh.positionFormat;
+
+		if (indexFormat >= crgfx::DataFormat::Count || positionFormat >= CrVertexPositionFormat::Count)
+		{
+			CrLog("Cooked model %s is corrupt", cookedModelPath.c_str());
+			return false;
+		}
+
+		uint32_t positionSize = GetPositionVertexDescriptor(positionFormat).GetDataSize();
+		uint32_t indexSize = CrModelData::GetIndexSize(indexFormat);
+		bool hasCompressedStreams = (cookedMesh.flags & CrCookedModelMeshFlags::CompressedStreams) != 0;
+
+		// Uncompressed streams must be exactly the size of their contents
+		if ((!hasCompressedStreams &&
+			(cookedMesh.positionStreamSize != cookedMesh.vertexCount * (uint64_t)positionSize ||
+			cookedMesh.additionalStreamSize != cookedMesh.vertexCount * sizeof(ComplexVertexAdditional) ||
+			cookedMesh.indexStreamSize != cookedMesh.indexCount * (uint64_t)indexSize)) ||
+			!IsInFile(cookedMesh.positionOffset, cookedMesh.positionStreamSize) ||
+			!IsInFile(cookedMesh.additionalOffset, cookedMesh.additionalStreamSize) ||
+			!IsInFile(cookedMesh.indexOffset, cookedMesh.indexStreamSize) ||
+			!IsInFile(cookedMesh.meshletOffset, cookedMesh.meshletCount * sizeof(CrMeshlet)) ||
+			!IsInFile(cookedMesh.meshletVertexOffset, cookedMesh.meshletVertexCount * sizeof(uint32_t)) ||
+			!IsInFile(cookedMesh.meshletTriangleOffset, cookedMesh.meshletTriangleCount * 3ull) ||
+			!IsInFile(cookedMesh.instanceOffset, cookedMesh.instanceCount * sizeof(float4x4)))
+		{
+			CrLog("Cooked model %s is corrupt", cookedModelPath.c_str());
+			return false;
+		}
+
+		if (hasCompressedStreams)
+		{
+			uint8_t* positions = modelData.AllocateStreamBytes(cookedMesh.vertexCount * (uint64_t)positionSize);
+			uint8_t* additionalVertices = modelData.AllocateStreamBytes(cookedMesh.vertexCount * sizeof(ComplexVertexAdditional));
+			uint8_t* indices = cookedMesh.indexCount > 0 ? modelData.AllocateStreamBytes(cookedMesh.indexCount * (uint64_t)indexSize) : nullptr;
+
+			if (meshopt_decodeVertexBuffer(positions, cookedMesh.vertexCount, positionSize, fileData + cookedMesh.positionOffset, cookedMesh.positionStreamSize) != 0 ||
+				meshopt_decodeVertexBuffer(additionalVertices, cookedMesh.vertexCount, sizeof(ComplexVertexAdditional), fileData + cookedMesh.additionalOffset, cookedMesh.additionalStreamSize) != 0 ||
+				(indices && meshopt_decodeIndexBuffer(indices, cookedMesh.indexCount, indexSize, fileData + cookedMesh.indexOffset, cookedMesh.indexStreamSize) != 0))
+			{
+				CrLog("Cooked model %s is corrupt", cookedModelPath.c_str());
+				return false;
+			}
+
+			meshData.positions = positions;
+			meshData.additionalVertices = (const ComplexVertexAdditional*)additionalVertices;
+			meshData.indices = indices;
+		}
+		else
+		{
+			meshData.positions = fileData + cookedMesh.positionOffset;
+			meshData.additionalVertices = (const ComplexVertexAdditional*)(fileData + cookedMesh.additionalOffset);
+			meshData.indices = cookedMesh.indexCount > 0 ? fileData + cookedMesh.indexOffset : nullptr;
+		}
+
+		meshData.positionFormat = positionFormat;
+		meshData.positionScale = cookedMesh.positionScale;
+		meshData.positionOffset = float3(cookedMesh.positionOrigin[0], cookedMesh.positionOrigin[1], cookedMesh.positionOrigin[2]);
+		meshData.vertexCount = cookedMesh.vertexCount;
+		meshData.indexCount = cookedMesh.indexCount;
+		meshData.indexFormat = indexFormat;
+		meshData.materialIndex = cookedMesh.materialIndex;
+		meshData.uvDensity = cookedMesh.uvDensity;
+		meshData.meshlets = cookedMesh.meshletCount > 0 ? (const CrMeshlet*)(fileData + cookedMesh.meshletOffset) : nullptr;
+		meshData.meshletCount = cookedMesh.meshletCount;
+		meshData.meshletVertices = cookedMesh.meshletCount > 0 ? (const uint32_t*)(fileData + cookedMesh.meshletVertexOffset) : nullptr;
+		meshData.meshletVertexCount = cookedMesh.meshletVertexCount;
+		meshData.meshletTriangles = cookedMesh.meshletCount > 0 ? fileData + cookedMesh.meshletTriangleOffset : nullptr;
+		meshData.meshletTriangleCount = cookedMesh.meshletTriangleCount;
+		meshData.instanceTransforms = cookedMesh.instanceCount > 0 ? (const float4x4*)(fileData + cookedMesh.instanceOffset) : nullptr;
+		meshData.instanceCount = cookedMesh.instanceCount;
+		meshData.boundingBox = CrBoundingBox
+		(
+			float3(cookedMesh.boundingBoxCenter[0], cookedMesh.boundingBoxCenter[1], cookedMesh.boundingBoxCenter[2]),
+			float3(cookedMesh.boundingBoxExtents[0], cookedMesh.boundingBoxExtents[1], cookedMesh.boundingBoxExtents[2])
+		);
+	}
+
+	return true;
+}
+
+uint64_t CrCookedModel::ComputeSourceHash(const CrFixedPath& sourcePath)
+{
+	CrMappedFileStream sourceFile(sourcePath.c_str());
+
+	if (!sourceFile)
+	{
+		return 0;
+	}
+
+	return CrHash(sourceFile.GetData(), sourceFile.GetSize()).GetHash();
+}
+
+CrFixedPath CrCookedModel::GetCookedModelPath(const CrFixedPath& sourcePath)
+{
+	CrFixedPath cookedModelPath = sourcePath;
+	cookedModelPath += ".crmodel";
+	return cookedModelPath;
+}
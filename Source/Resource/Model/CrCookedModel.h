@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Core/FileSystem/CrFixedPath.h"
+
+class CrModelData;
+
+namespace CrCookedModelVersion
+{
+	enum T : uint32_t
+	{
+		InitialVersion,
+		Meshlets, // Meshes have their meshlets
+		QuantizedPositions, // Positions can be quantized, and streams can be compressed
+		Instances, // Meshes can have instance transforms
+		UVDensity, // Meshes store their texture coordinate density
+		SourceHash, // The source is identified by the hash of its contents instead of its size
+		CurrentVersion = SourceHash
+	};
+};
+
+// A cooked model is laid out as the header, the material, texture and mesh tables, the texture paths and
+// finally the vertex, index, meshlet and instance streams. Offsets are from the start of the file, and streams are aligned
+// so that they can be used straight from a memory mapping
+struct CrCookedModelHeader
+{
+	static const uint32_t Magic = 0x444D5243; // CRMD
+
+	uint32_t magic;
+	uint32_t version;
+
+	// Hash of the contents of the source asset. A cooked model whose source hashes differently is out of date
+	uint64_t sourceHash;
+
+	uint32_t materialCount;
+	uint32_t textureCount;
+	uint32_t meshCount;
+	uint32_t padding;
+};
+
+struct CrCookedModelMaterial
+{
+	float color[4];
+	uint32_t firstTexture;
+	uint32_t textureCount;
+};
+
+namespace CrCookedModelMeshFlags
+{
+	enum T : uint32_t
+	{
+		None = 0,
+		CompressedStreams = 1 << 0, // Vertex and index streams are encoded with the meshoptimizer codecs
+	};
+};
+
+struct CrCookedModelTexture
+{
+	uint32_t semantic;
+	uint32_t pathLength;
+	uint64_t pathOffset;
+};
+
+struct CrCookedModelMesh
+{
+	uint64_t positionOffset;
+	uint64_t additionalOffset;
+	uint64_t indexOffset;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexFormat;
+	uint32_t materialIndex;
+	float boundingBoxCenter[3];
+	float boundingBoxExtents[3];
+	uint64_t meshletOffset;
+	uint64_t meshletVertexOffset;
+	uint64_t meshletTriangleOffset;
+	uint32_t meshletCount;
+	uint32_t meshletVertexCount;
+	uint32_t meshletTriangleCount;
+	uint32_t positionFormat;
+	float positionOrigin[3];
+	float positionScale;
+	uint32_t flags;
+	float uvDensity;
+
+	// Size of the vertex and index streams in the file. They only differ from their decoded size when compressed
+	uint64_t positionStreamSize;
+	uint64_t additionalStreamSize;
+	uint64_t indexStreamSize;
+
+	// Instance transforms are 16 floats each
+	uint64_t instanceOffset;
+	uint32_t instanceCount;
+	uint32_t instancePadding;
+};
+
+// Reads and writes models in their final form, so that loading them doesn't need to process the source asset.
+// The model cooker writes them offline, and the resource manager loads them instead of the source when present
+class CrCookedModel
+{
+public:
+
+	static const uint32_t StreamAlignment = 16;
+
+	// Compressed streams make the file smaller but have to be decoded into memory when loading, instead of being
+	// used straight from the mapping
+	// The file is written under a temporary name and moved into place once complete, so an interrupted cook
+	// never leaves a partial cooked model behind
+	static bool Write(const CrModelData& modelData, uint64_t sourceHash, const CrFixedPath& cookedModelPath, bool compressStreams = false);
+
+	// Maps the cooked model and points the model data into the mapping, or decodes its streams if they are compressed.
+	// Compressed streams are decoded into upload memory if the model data has an upload device. If sourceHash isn't 0,
+	// a model cooked from a source with different contents is rejected
+	static bool Load(const CrFixedPath& cookedModelPath, uint64_t sourceHash, CrModelData& modelData);
+
+	// Hash of the contents of the source asset, as stored in the cooked model. 0 if the source can't be read
+	static uint64_t ComputeSourceHash(const CrFixedPath& sourcePath);
+
+	// The cooked model lives next to its source, e.g. model.fbx is cooked to model.fbx.crmodel
+	static CrFixedPath GetCookedModelPath(const CrFixedPath& sourcePath);
+};
@@ -0,0 +1,312 @@
+#include "Resource/CrResource_pch.h"
+
+#include "ICrModelDecoder.h"
+#include "CrModelData.h"
+#include "CrCookedModel.h"
+
+#include "Resource/Image/ICrImageCodec.h"
+#include "Resource/Image/CrImageCodecBC.h"
+#include "Resource/Image/CrTextureCooker.h"
+
+#include "Graphics/CrImage.h"
+#include "Graphics/DataFormats.h"
+
+#include "Core/CrCommandLine.h"
+#include "Core/Threading/CrThreadPool.h"
+#include "Core/FileSystem/CrFixedPath.h"
+
+#include "crstl/filesystem.h"
+#include "crstl/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Cooks the texture into the texture cache, where the resource manager looks for it
+static bool CookTexture(const CrFixedPath& sourcePath, const CrTextureCookSettings& cookSettings, CrThreadPool& threadPool)
+{
+	crstl::timer cookingTime;
+
+	// DDS textures are loaded as they are
+	if (sourcePath.extension().comparei(".dds") == 0)
+	{
+		return true;
+	}
+
+	crstl::file file(sourcePath.c_str(), crstl::file_flags::read);
+
+	if (!file)
+	{
+		printf("Error: could not open %s\n", sourcePath.c_str());
+		return false;
+	}
+
+	crstl::vector<uint8_t> sourceData;
+	sourceData.resize_uninitialized(file.get_size());
+	file.read(sourceData.data(), sourceData.size());
+
+	CrHash cacheKey = CrTextureCooker::GetCacheKey(sourceData.data(), sourceData.size(), cookSettings);
+	CrFixedPath cachePath = CrTextureCooker::GetCachePath(cacheKey);
+
+	if (crstl::exists(cachePath.c_str()))
+	{
+		printf("%s is up to date\n", sourcePath.c_str());
+		return true;
+	}
+
+	CrImageHandle sourceImage = ICrImageDecoder::Create(sourcePath)->Decode(sourceData.data(), sourceData.size());
+
+	if (!sourceImage)
+	{
+		printf("Error: could not decode %s\n", sourcePath.c_str());
+		return false;
+	}
+
+	CrBlockCompressionStatistics compressionStatistics;
+	CrImageHandle cookedImage = CrTextureCooker::Cook(sourceImage, cookSettings, &threadPool, &compressionStatistics);
+
+	if (!CrTextureCooker::SaveToCache(cookedImage, cacheKey))
+	{
+		printf("Error: could not write %s\n", cachePath.c_str());
+		return false;
+	}
+
+	printf("Cooked %s to %s: %ux%u %s, %u mips, %llu bytes (%.2f ms)\n",
+		sourcePath.c_str(), cachePath.c_str(), cookedImage->GetWidth(), cookedImage->GetHeight(), crgfx::DataFormats[cookedImage->GetFormat()].name,
+		cookedImage->GetMipmapCount(), (unsigned long long)cookedImage->GetDataSize(), cookingTime.elapsed().milliseconds());
+
+	if (crgfx::DataFormats[cookedImage->GetFormat()].compressed && cookedImage != sourceImage)
+	{
+		printf("  Compressed with %.2f dB PSNR (%.2f ms)\n", compressionStatistics.psnr, compressionStatistics.compressionTime);
+	}
+
+	return true;
+}
+
+static bool CookModel
+(
+	const CrFixedPath& sourcePath, const CrFixedPath& cookedModelPath, const CrVertexQuantizationSettings& quantizationSettings,
+	bool compressStreams, CrThreadPool& threadPool
+)
+{
+	crstl::timer cookingTime;
+
+	crstl::file file(sourcePath.c_str(), crstl::file_flags::read);
+
+	if (!file)
+	{
+		printf("Error: could not open %s\n", sourcePath.c_str());
+		return false;
+	}
+
+	CrModelData modelData;
+
+	crstl::unique_ptr<ICrModelDecoder> modelDecoder = ICrModelDecoder::Create(sourcePath, &threadPool);
+	modelDecoder->SetQuantizationSettings(quantizationSettings);
+
+	if (!modelDecoder->Decode(file, modelData))
+	{
+		printf("Error: could not decode %s\n", sourcePath.c_str());
+		return false;
+	}
+
+	if (!CrCookedModel::Write(modelData, CrCookedModel::ComputeSourceHash(sourcePath), cookedModelPath, compressStreams))
+	{
+		printf("Error: could not write %s\n", cookedModelPath.c_str());
+		return false;
+	}
+
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	uint32_t meshletCount = 0;
+	uint32_t instancedMeshCount = 0;
+	uint32_t instanceCount = 0;
+	uint32_t positionFormatCounts[CrVertexPositionFormat::Count] = {};
+
+	for (const CrModelMeshData& meshData : modelData.meshes)
+	{
+		vertexCount += meshData.vertexCount;
+		indexCount += meshData.indexCount;
+		meshletCount += meshData.meshletCount;
+		positionFormatCounts[meshData.positionFormat]++;
+
+		if (meshData.instanceCount > 0)
+		{
+			instancedMeshCount++;
+			instanceCount += meshData.instanceCount;
+		}
+	}
+
+	printf("Cooked %s to %s: %u meshes, %u materials, %u vertices, %u indices, %u meshlets (%.2f ms)\n",
+		sourcePath.c_str(), cookedModelPath.c_str(), (uint32_t)modelData.meshes.size(), (uint32_t)modelData.materials.size(),
+		vertexCount, indexCount, meshletCount, cookingTime.elapsed().milliseconds());
+
+	printf("  Positions of %u meshes in half, %u in unorm16 and %u in unorm10\n",
+		positionFormatCounts[CrVertexPositionFormat::Half], positionFormatCounts[CrVertexPositionFormat::Unorm16], positionFormatCounts[CrVertexPositionFormat::Unorm10]);
+
+	if (instancedMeshCount > 0)
+	{
+		printf("  %u meshes shared by %u instances\n", instancedMeshCount, instanceCount);
+	}
+
+	bool texturesCooked = true;
+
+	for (const CrModelMaterialData& materialData : modelData.materials)
+	{
+		for (const CrModelTextureData& textureData : materialData.textures)
+		{
+			texturesCooked &= CookTexture(sourcePath.parent_path() / textureData.path, CrTextureCookSettings(textureData.semantic), threadPool);
+		}
+	}
+
+	return texturesCooked;
+}
+
+// Decodes the model several times on the calling thread and then across the thread pool, and prints the average of
+// each. Meshes come out the same either way
+static bool BenchmarkModel(const CrFixedPath& sourcePath, uint32_t iterationCount, CrThreadPool& threadPool)
+{
+	double decodingTimes[2] = {};
+	uint32_t meshCount = 0;
+
+	for (uint32_t parallel = 0; parallel < 2; ++parallel)
+	{
+		for (uint32_t i = 0; i < iterationCount; ++i)
+		{
+			crstl::file file(sourcePath.c_str(), crstl::file_flags::read);
+
+			if (!file)
+			{
+				printf("Error: could not open %s\n", sourcePath.c_str());
+				return false;
+			}
+
+			CrModelData modelData;
+
+			crstl::timer decodingTime;
+
+			if (!ICrModelDecoder::Create(sourcePath, parallel ? &threadPool : nullptr)->Decode(file, modelData))
+			{
+				printf("Error: could not decode %s\n", sourcePath.c_str());
+				return false;
+			}
+
+			decodingTimes[parallel] += decodingTime.elapsed().milliseconds();
+			meshCount = (uint32_t)modelData.meshes.size();
+		}
+	}
+
+	double serialTime = decodingTimes[0] / iterationCount;
+	double parallelTime = decodingTimes[1] / iterationCount;
+
+	printf("Decoded %s: %u meshes, %.2f ms serial, %.2f ms on %u threads (%.2fx)\n",
+		sourcePath.c_str(), meshCount, serialTime, parallelTime, threadPool.GetThreadCount(), parallelTime > 0.0 ? serialTime / parallelTime : 0.0);
+
+	return true;
+}
+
+// Usage:
+// -input model.fbx       : Source model to cook, along with the textures it uses. Can be passed multiple times
+// -output model.crmodel  : Destination of the cooked model. Only valid with a single input. Defaults to
+//                          next to the source model, which is where the resource manager looks for it
+// -texture texture.png   : Source texture to cook into the texture cache. Can be passed multiple times
+// -benchmark 10          : Decodes every input model 10 times serially and in parallel and prints the average
+//                          times instead of cooking, e.g. for the bundled nyra, jaina and DamagedHelmet models
+// -positionFormat half   : Stores the positions of every mesh as half, unorm16 or unorm10. By default each mesh
+//                          gets the smallest format that is within the position tolerance
+// -positionTolerance 0.001 : Largest position error allowed for automatic formats, in model space units
+// -compressStreams       : Compresses the vertex and index streams with the meshoptimizer codecs
+int main(int argc, char* argv[])
+{
+	CrCommandLineParser commandLine(argc, argv);
+
+	crstl::vector<CrFixedPath> inputFilePaths;
+	commandLine.for_each("-input", [&inputFilePaths](const crstl::string& value)
+	{
+		inputFilePaths.push_back(CrFixedPath(value.c_str()));
+	});
+
+	crstl::vector<CrFixedPath> textureFilePaths;
+	commandLine.for_each("-texture", [&textureFilePaths](const crstl::string& value)
+	{
+		textureFilePaths.push_back(CrFixedPath(value.c_str()));
+	});
+
+	CrFixedPath outputFilePath = commandLine("-output").c_str();
+
+	uint32_t benchmarkIterationCount = (uint32_t)atoi(commandLine("-benchmark").c_str());
+
+	CrVertexQuantizationSettings quantizationSettings;
+
+	const crstl::string& positionFormat = commandLine("-positionFormat");
+
+	if (!positionFormat.empty())
+	{
+		quantizationSettings.automaticPositionFormat = false;
+
+		if (positionFormat == "half")
+		{
+			quantizationSettings.positionFormat = CrVertexPositionFormat::Half;
+		}
+		else if (positionFormat == "unorm16")
+		{
+			quantizationSettings.positionFormat = CrVertexPositionFormat::Unorm16;
+		}
+		else if (positionFormat == "unorm10")
+		{
+			quantizationSettings.positionFormat = CrVertexPositionFormat::Unorm10;
+		}
+		else
+		{
+			printf("Error: unknown position format %s\n", positionFormat.c_str());
+			return 1;
+		}
+	}
+
+	if (!commandLine("-positionTolerance").empty())
+	{
+		quantizationSettings.positionTolerance = (float)atof(commandLine("-positionTolerance").c_str());
+	}
+
+	bool compressStreams = commandLine["-compressStreams"];
+
+	if (inputFilePaths.empty() && textureFilePaths.empty())
+	{
+		printf("Error: no input specified\n");
+		return 1;
+	}
+
+	if (!outputFilePath.empty() && inputFilePaths.size() > 1)
+	{
+		printf("Error: -output can only be used with a single input\n");
+		return 1;
+	}
+
+	// Meshes are decoded and textures are compressed across all cores
+	CrThreadPool threadPool;
+
+	bool success = true;
+
+	if (benchmarkIterationCount > 0)
+	{
+		for (const CrFixedPath& inputFilePath : inputFilePaths)
+		{
+			success &= BenchmarkModel(inputFilePath, benchmarkIterationCount, threadPool);
+		}
+
+		return success ? 0 : 1;
+	}
+
+	for (const CrFixedPath& inputFilePath : inputFilePaths)
+	{
+		CrFixedPath cookedModelPath = outputFilePath.empty() ? CrCookedModel::GetCookedModelPath(inputFilePath) : outputFilePath;
+		success &= CookModel(inputFilePath, cookedModelPath, quantizationSettings, compressStreams, threadPool);
+	}
+
+	for (const CrFixedPath& textureFilePath : textureFilePaths)
+	{
+		// Without a model we don't know what the texture is for, so it's cooked as color
+		success &= CookTexture(textureFilePath, CrTextureCookSettings(), threadPool);
+	}
+
+	return success ? 0 : 1;
+}
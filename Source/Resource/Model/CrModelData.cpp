@@ -0,0 +1,387 @@
+#include "Resource/CrResource_pch.h"
+
+#include "CrModelData.h"
+
+#include "Graphics/DataFormats.h"
+#include "Graphics/IDevice.h"
+#include "Graphics/GPUBuffer.h"
+
+#include "Math/CrMath.h"
+
+#include <math.h>
+
+warnings_off
+#include <meshoptimizer.h>
+warnings_on
+
+CrModelData::CrModelData() {}
+
+CrModelData::~CrModelData()
+{
+	for (uint8_t* allocation : m_allocations)
+	{
+		delete[] allocation;
+	}
+
+	// Upload memory no buffer consumed is still locked
+	for (crgfx::UploadMemory& uploadMemory : m_uploadMemory)
+	{
+		if (uploadMemory.stagingBuffer)
+		{
+			uploadMemory.stagingBuffer->Unlock();
+		}
+	}
+}
+
+uint8_t* CrModelData::AllocateBytes(uint64_t size)
+{
+	uint8_t* allocation = new uint8_t[size];
+
+	CrScopedLock lock(m_allocationMutex);
+	m_allocations.push_back(allocation);
+	return allocation;
+}
+
+uint8_t* CrModelData::AllocateStreamBytes(uint64_t size)
+{
+	if (!m_uploadDevice || size == 0)
+	{
+		return AllocateBytes(size);
+	}
+
+	crgfx::UploadMemory uploadMemory = m_uploadDevice->AllocateUploadMemory(size);
+	uint8_t* data = uploadMemory.data;
+
+	CrScopedLock lock(m_allocationMutex);
+	m_uploadMemory.push_back(uploadMemory);
+	return data;
+}
+
+crgfx::UploadMemory* CrModelData::FindUploadMemory(const void* stream)
+{
+	for (crgfx::UploadMemory& uploadMemory : m_uploadMemory)
+	{
+		if (uploadMemory.data && uploadMemory.data == stream)
+		{
+			return &uploadMemory;
+		}
+	}
+
+	return nullptr;
+}
+
+float3 CrModelMeshData::GetPosition(uint32_t vertexIndex) const
+{
+	switch (positionFormat)
+	{
+		case CrVertexPositionFormat::Unorm16:
+		{
+			const auto& position = ((const ComplexVertexPositionUnorm16*)positions)[vertexIndex].position.data;
+			return float3((float)position.x, (float)position.y, (float)position.z) * (positionScale / 65535.0f) + positionOffset;
+		}
+		case CrVertexPositionFormat::Unorm10:
+		{
+			uint32_t position = ((const ComplexVertexPositionUnorm10*)positions)[vertexIndex].position;
+			return float3((float)(position & 1023), (float)((position >> 10) & 1023), (float)((position >> 20) & 1023)) * (positionScale / 1023.0f) + positionOffset;
+		}
+		default:
+		{
+			const auto& position = ((const ComplexVertexPosition*)positions)[vertexIndex].position.data;
+			return float3((float)position.x, (float)position.y, (float)position.z);
+		}
+	}
+}
+
+// Position as the format stores it, in integer steps of the cube of side scale that starts at origin. Half positions
+// aren't quantized and only go through the conversion
+static void QuantizePosition(const float* position, CrVertexPositionFormat::T positionFormat, const float* origin, float inverseScale, float quantized[3])
+{
+	float maxValue = positionFormat == CrVertexPositionFormat::Unorm16 ? 65535.0f : 1023.0f;
+
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		if (positionFormat == CrVertexPositionFormat::Half)
+		{
+			quantized[c] = (float)(half)position[c];
+		}
+		else
+		{
+			float normalized = CrClamp((position[c] - origin[c]) * inverseScale, 0.0f, 1.0f);
+			quantized[c] = (float)(uint32_t)(normalized * maxValue + 0.5f);
+		}
+	}
+}
+
+// Largest distance between a source position and the position the format would store. It works from the source so
+// that the stream can be written once, to memory that is only written to
+static float MeasurePositionError
+(
+	const float* positions, uint32_t stride, uint32_t vertexCount, CrVertexPositionFormat::T positionFormat, const float* origin, float scale
+)
+{
+	// A flat or empty mesh still needs a valid scale
+	float inverseScale = scale > 0.0f ? 1.0f / scale : 0.0f;
+	float stepSize = scale / (positionFormat == CrVertexPositionFormat::Unorm16 ? 65535.0f : 1023.0f);
+
+	float maxError = 0.0f;
+
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		const float* position = (const float*)((const uint8_t*)positions + (uint64_t)v * stride);
+
+		float quantized[3];
+		QuantizePosition(position, positionFormat, origin, inverseScale, quantized);
+
+		float squaredError = 0.0f;
+
+		for (uint32_t c = 0; c < 3; ++c)
+		{
+			float stored = positionFormat == CrVertexPositionFormat::Half ? quantized[c] : quantized[c] * stepSize + origin[c];
+			squaredError += (stored - position[c]) * (stored - position[c]);
+		}
+
+		maxError = CrMax(maxError, sqrtf(squaredError));
+	}
+
+	return maxError;
+}
+
+// Writes the positions into the stream in the format. Quantized positions are relative to the cube of side scale that
+// starts at origin
+static void QuantizePositions
+(
+	uint8_t* positionData, const float* positions, uint32_t stride, uint32_t vertexCount, CrVertexPositionFormat::T positionFormat,
+	const float* origin, float scale
+)
+{
+	float inverseScale = scale > 0.0f ? 1.0f / scale : 0.0f;
+
+	for (uint32_t v = 0; v < vertexCount; ++v)
+	{
+		const float* position = (const float*)((const uint8_t*)positions + (uint64_t)v * stride);
+
+		if (positionFormat == CrVertexPositionFormat::Half)
+		{
+			((ComplexVertexPosition*)positionData)[v].position = { (half)position[0], (half)position[1], (half)position[2], 1.0_h };
+		}
+		else
+		{
+			float quantized[3];
+			QuantizePosition(position, positionFormat, origin, inverseScale, quantized);
+
+			if (positionFormat == CrVertexPositionFormat::Unorm16)
+			{
+				((ComplexVertexPositionUnorm16*)positionData)[v].position = { (uint16_t)quantized[0], (uint16_t)quantized[1], (uint16_t)quantized[2], 65535 };
+			}
+			else
+			{
+				((ComplexVertexPositionUnorm10*)positionData)[v].position = (uint32_t)quantized[0] | ((uint32_t)quantized[1] << 10) | ((uint32_t)quantized[2] << 20) | (3u << 30);
+			}
+		}
+	}
+}
+
+void CrModelData::BuildPositions(CrModelMeshData& meshData, const float* positions, uint32_t stride, const CrVertexQuantizationSettings& settings)
+{
+	float3 minVertex = float3(FLT_MAX);
+	float3 maxVertex = float3(-FLT_MAX);
+
+	for (uint32_t v = 0; v < meshData.vertexCount; ++v)
+	{
+		const float* position = (const float*)((const uint8_t*)positions + (uint64_t)v * stride);
+		minVertex = min(minVertex, float3(position[0], position[1], position[2]));
+		maxVertex = max(maxVertex, float3(position[0], position[1], position[2]));
+	}
+
+	if (meshData.vertexCount == 0)
+	{
+		minVertex = maxVertex = float3(0.0f, 0.0f, 0.0f);
+	}
+
+	meshData.boundingBox = CrBoundingBox((maxVertex + minVertex) * 0.5f, (maxVertex - minVertex) * 0.5f);
+
+	float3 extents = maxVertex - minVertex;
+	float scale = CrMax(CrMax((float)extents.x, (float)extents.y), (float)extents.z);
+	float origin[3] = { (float)minVertex.x, (float)minVertex.y, (float)minVertex.z };
+
+	CrVertexPositionFormat::T positionFormat = settings.positionFormat;
+
+	if (settings.automaticPositionFormat)
+	{
+		// Take the smallest format within tolerance, or the most precise one if none of them is
+		const CrVertexPositionFormat::T candidateFormats[] = { CrVertexPositionFormat::Unorm10, CrVertexPositionFormat::Unorm16, CrVertexPositionFormat::Half };
+
+		float bestError = FLT_MAX;
+
+		for (CrVertexPositionFormat::T candidateFormat : candidateFormats)
+		{
+			float error = MeasurePositionError(positions, stride, meshData.vertexCount, candidateFormat, origin, scale);
+
+			if (error < bestError)
+			{
+				positionFormat = candidateFormat;
+				bestError = error;
+			}
+
+			if (error <= settings.positionTolerance)
+			{
+				positionFormat = candidateFormat;
+				break;
+			}
+		}
+
+		if (bestError > settings.positionTolerance)
+		{
+			CrLog("Mesh positions can't be stored within a tolerance of %f. Largest error is %f", settings.positionTolerance, bestError);
+		}
+	}
+
+	uint32_t positionStride = GetPositionVertexDescriptor(positionFormat).GetDataSize();
+	uint8_t* positionData = AllocateStreamBytes((uint64_t)meshData.vertexCount * positionStride);
+	QuantizePositions(positionData, positions, stride, meshData.vertexCount, positionFormat, origin, scale);
+
+	meshData.positions = positionData;
+	meshData.positionFormat = positionFormat;
+	meshData.positionScale = positionFormat == CrVertexPositionFormat::Half ? 1.0f : scale;
+	meshData.positionOffset = positionFormat == CrVertexPositionFormat::Half ? float3(0.0f, 0.0f, 0.0f) : minVertex;
+}
+
+void CrModelData::BuildMeshlets(CrModelMeshData& meshData, const float* positions, uint32_t stride, const uint32_t* indices)
+{
+	if (!meshData.indices || meshData.indexCount == 0 ||
+		(meshData.indexFormat != crgfx::DataFormat::R16_Uint && meshData.indexFormat != crgfx::DataFormat::R32_Uint))
+	{
+		return;
+	}
+
+	size_t maxMeshletCount = meshopt_buildMeshletsBound(meshData.indexCount, MeshletMaxVertices, MeshletMaxTriangles);
+
+	crstl::vector<meshopt_Meshlet> meshoptMeshlets;
+	meshoptMeshlets.resize_uninitialized(maxMeshletCount);
+
+	crstl::vector<uint32_t> meshletVertices;
+	meshletVertices.resize_uninitialized(maxMeshletCount * MeshletMaxVertices);
+
+	crstl::vector<uint8_t> meshletTriangles;
+	meshletTriangles.resize_uninitialized(maxMeshletCount * MeshletMaxTriangles * 3);
+
+	// A cone weight of 0.25 trades a bit of meshlet compactness for narrower normal cones
+	size_t meshletCount = meshopt_buildMeshlets
+	(
+		meshoptMeshlets.data(), meshletVertices.data(), meshletTriangles.data(), indices, meshData.indexCount,
+		positions, meshData.vertexCount, stride, MeshletMaxVertices, MeshletMaxTriangles, 0.25f
+	);
+
+	if (meshletCount == 0)
+	{
+		return;
+	}
+
+	const meshopt_Meshlet& lastMeshlet = meshoptMeshlets[meshletCount - 1];
+	uint32_t meshletVertexCount = lastMeshlet.vertex_offset + lastMeshlet.vertex_count;
+	uint32_t meshletTriangleCount = 0;
+
+	for (size_t m = 0; m < meshletCount; ++m)
+	{
+		meshletTriangleCount += meshoptMeshlets[m].triangle_count;
+	}
+
+	CrMeshlet* meshlets = Allocate<CrMeshlet>(meshletCount);
+
+	// Meshoptimizer pads the triangles of each meshlet to 4 bytes. We pack them so that triangles can be indexed
+	uint8_t* meshletTriangleData = AllocateBytes(meshletTriangleCount * 3);
+	uint32_t triangleOffset = 0;
+
+	for (size_t m = 0; m < meshletCount; ++m)
+	{
+		const meshopt_Meshlet& meshoptMeshlet = meshoptMeshlets[m];
+
+		meshopt_Bounds bounds = meshopt_computeMeshletBounds
+		(
+			&meshletVertices[meshoptMeshlet.vertex_offset], &meshletTriangles[meshoptMeshlet.triangle_offset], meshoptMeshlet.triangle_count,
+			positions, meshData.vertexCount, stride
+		);
+
+		CrMeshlet& meshlet = meshlets[m];
+		meshlet.vertexOffset = meshoptMeshlet.vertex_offset;
+		meshlet.triangleOffset = triangleOffset;
+		meshlet.vertexCount = meshoptMeshlet.vertex_count;
+		meshlet.triangleCount = meshoptMeshlet.triangle_count;
+		memcpy(meshlet.center, bounds.center, sizeof(meshlet.center));
+		meshlet.radius = bounds.radius;
+		memcpy(meshlet.coneApex, bounds.cone_apex, sizeof(meshlet.coneApex));
+		memcpy(meshlet.coneAxis, bounds.cone_axis, sizeof(meshlet.coneAxis));
+		meshlet.coneCutoff = bounds.cone_cutoff;
+		meshlet.padding = 0;
+
+		memcpy(meshletTriangleData + triangleOffset * 3, &meshletTriangles[meshoptMeshlet.triangle_offset], meshoptMeshlet.triangle_count * 3);
+		triangleOffset += meshoptMeshlet.triangle_count;
+	}
+
+	uint32_t* meshletVertexData = Allocate<uint32_t>(meshletVertexCount);
+	memcpy(meshletVertexData, meshletVertices.data(), meshletVertexCount * sizeof(uint32_t));
+
+	meshData.meshlets = meshlets;
+	meshData.meshletCount = (uint32_t)meshletCount;
+	meshData.meshletVertices = meshletVertexData;
+	meshData.meshletVertexCount = meshletVertexCount;
+	meshData.meshletTriangles = meshletTriangleData;
+	meshData.meshletTriangleCount = meshletTriangleCount;
+}
+
+float CrModelData::ComputeUVDensity
+(
+	const float* positions, uint32_t positionStride, const float* uvs, uint32_t uvStride,
+	const uint32_t* indices, uint32_t vertexCount, uint32_t indexCount
+)
+{
+	uint32_t triangleCount = indices ? indexCount / 3 : vertexCount / 3;
+
+	double uvArea = 0.0;
+	double modelArea = 0.0;
+
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		const float* p[3];
+		const float* uv[3];
+
+		for (uint32_t v = 0; v < 3; ++v)
+		{
+			uint32_t vertexIndex = indices ? indices[t * 3 + v] : t * 3 + v;
+			p[v] = (const float*)((const uint8_t*)positions + (uint64_t)vertexIndex * positionStride);
+			uv[v] = (const float*)((const uint8_t*)uvs + (uint64_t)vertexIndex * uvStride);
+		}
+
+		float e1x = p[1][0] - p[0][0], e1y = p[1][1] - p[0][1], e1z = p[1][2] - p[0][2];
+		float e2x = p[2][0] - p[0][0], e2y = p[2][1] - p[0][1], e2z = p[2][2] - p[0][2];
+
+		float cx = e1y * e2z - e1z * e2y;
+		float cy = e1z * e2x - e1x * e2z;
+		float cz = e1x * e2y - e1y * e2x;
+
+		modelArea += 0.5 * sqrt((double)(cx * cx + cy * cy + cz * cz));
+
+		float u1 = uv[1][0] - uv[0][0], v1 = uv[1][1] - uv[0][1];
+		float u2 = uv[2][0] - uv[0][0], v2 = uv[2][1] - uv[0][1];
+
+		uvArea += 0.5 * fabs((double)(u1 * v2 - v1 * u2));
+	}
+
+	if (modelArea <= 0.0 || uvArea <= 0.0)
+	{
+		return 0.0f;
+	}
+
+	return (float)sqrt(uvArea / modelArea);
+}
+
+bool CrModelData::MapFile(const CrFixedPath& filePath)
+{
+	m_mappedFile = CrMemoryMappedFile(filePath.c_str());
+	return m_mappedFile.IsValid();
+}
+
+uint32_t CrModelData::GetIndexSize(crgfx::DataFormat::T indexFormat)
+{
+	return crgfx::DataFormats[indexFormat].dataOrBlockSize;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "Core/FileSystem/CrFixedPath.h"
+#include "Core/FileSystem/CrMemoryMappedFile.h"
+#include "Core/Threading/CrMutex.h"
+
+#include "Graphics/CrCommonVertexLayouts.h"
+#include "Graphics/CrGraphicsForwardDeclarations.h"
+#include "Graphics/CrMeshlet.h"
+#include "Graphics/CrVisibility.h"
+
+#include "crstl/vector.h"
+
+struct CrModelTextureData
+{
+	Textures::T semantic;
+
+	// Relative to the directory the model is in
+	CrFixedPath path;
+};
+
+struct CrModelMaterialData
+{
+	float4 color = float4(1.0f, 1.0f, 1.0f, 1.0f);
+
+	crstl::vector<CrModelTextureData> textures;
+};
+
+// How decoders store the positions of meshes
+struct CrVertexQuantizationSettings
+{
+	// Picks the smallest position format whose error is within the tolerance. Otherwise positionFormat is used
+	bool automaticPositionFormat = true;
+
+	CrVertexPositionFormat::T positionFormat = CrVertexPositionFormat::Half;
+
+	// Largest distance a stored position can be from the source, in model space units. Small meshes fit in 10 bits
+	// while large ones need 16
+	float positionTolerance = 0.0005f;
+};
+
+// Final vertex and index streams of a render mesh, ready to be copied into GPU buffers
+struct CrModelMeshData
+{
+	// Position in model space of a vertex of the stream
+	float3 GetPosition(uint32_t vertexIndex) const;
+
+	// Stream of positions in positionFormat, see GetPositionVertexDescriptor
+	const uint8_t* positions = nullptr;
+
+	CrVertexPositionFormat::T positionFormat = CrVertexPositionFormat::Half;
+
+	// Quantized positions go back to model space as position * positionScale + positionOffset
+	float positionScale = 1.0f;
+
+	float3 positionOffset = float3(0.0f, 0.0f, 0.0f);
+
+	const ComplexVertexAdditional* additionalVertices = nullptr;
+
+	uint32_t vertexCount = 0;
+
+	const uint8_t* indices = nullptr;
+
+	uint32_t indexCount = 0;
+
+	crgfx::DataFormat::T indexFormat = crgfx::DataFormat::R16_Uint;
+
+	CrBoundingBox boundingBox;
+
+	uint32_t materialIndex = 0;
+
+	// Transforms from the space of the mesh to the space of the model, for meshes the model uses in several places.
+	// Without them the mesh is already in model space
+	const float4x4* instanceTransforms = nullptr;
+
+	uint32_t instanceCount = 0;
+
+	// Texture coordinate units per unit of distance in model space, see CrModelData::ComputeUVDensity
+	float uvDensity = 0.0f;
+
+	// Meshlets and the streams they index into. Only indexed meshes have them
+	const CrMeshlet* meshlets = nullptr;
+
+	uint32_t meshletCount = 0;
+
+	const uint32_t* meshletVertices = nullptr;
+
+	uint32_t meshletVertexCount = 0;
+
+	// Three bytes per triangle
+	const uint8_t* meshletTriangles = nullptr;
+
+	uint32_t meshletTriangleCount = 0;
+};
+
+// Everything needed to create a render model without looking at the source asset again. Model decoders
+// produce it on a loading thread, the model cooker writes it to disk, and the cooked model loader points
+// it straight into a mapping of the cooked file. The streams the meshes point to are owned by the model data.
+// With an upload device the vertex and index streams are allocated in its upload memory, so that decoders
+// write them where the GPU copies from and creating the render model doesn't copy them again
+class CrModelData
+{
+public:
+
+	CrModelData();
+
+	~CrModelData();
+
+	CrModelData(const CrModelData&) = delete;
+
+	CrModelData& operator = (const CrModelData&) = delete;
+
+	// Allocates memory that lives as long as the model data, for decoders to build streams into. Decoders can call
+	// it from several jobs at once
+	template<typename T>
+	T* Allocate(uint64_t count)
+	{
+		return (T*)AllocateBytes(count * sizeof(T));
+	}
+
+	uint8_t* AllocateBytes(uint64_t size);
+
+	// Allocates a vertex or index stream, which goes to the GPU as it is. It's in upload memory if there is an upload
+	// device, and upload memory is slow to read, so decoders only write to it. Anything else they compute from
+	// their own copy of the data
+	template<typename T>
+	T* AllocateStream(uint64_t count)
+	{
+		return (T*)AllocateStreamBytes(count * sizeof(T));
+	}
+
+	uint8_t* AllocateStreamBytes(uint64_t size);
+
+	// Set it before decoding into the model data. Without one streams are allocated in regular memory
+	void SetUploadDevice(crgfx::IDevice* uploadDevice) { m_uploadDevice = uploadDevice; }
+
+	// Upload memory the stream was allocated in, or null if it is in regular memory
+	crgfx::UploadMemory* FindUploadMemory(const void* stream);
+
+	// Stores the positions of the mesh in the format the settings choose, and sets its bounding box from them. The
+	// source positions are three floats each, stride bytes apart
+	void BuildPositions(CrModelMeshData& meshData, const float* positions, uint32_t stride, const CrVertexQuantizationSettings& settings);
+
+	// Splits an indexed mesh into meshlets and computes their bounds and normal cones. Decoders call it once the
+	// vertex and index streams of the mesh are final, with their own copy of the positions and the indices, as
+	// three floats each, stride bytes apart, and 32-bit indices
+	void BuildMeshlets(CrModelMeshData& meshData, const float* positions, uint32_t stride, const uint32_t* indices);
+
+	// Texture coordinate units per unit of distance, from the ratio of the area the triangles cover in texture space
+	// to the area they cover in model space. Texture coordinates are two floats each, uvStride bytes apart, and
+	// indices can be null for meshes that aren't indexed
+	static float ComputeUVDensity
+	(
+		const float* positions, uint32_t positionStride, const float* uvs, uint32_t uvStride,
+		const uint32_t* indices, uint32_t vertexCount, uint32_t indexCount
+	);
+
+	static const uint32_t MeshletMaxVertices = 64;
+
+	static const uint32_t MeshletMaxTriangles = 124;
+
+	// Maps a file for the meshes to point into. It stays mapped as long as the model data is alive
+	bool MapFile(const CrFixedPath& filePath);
+
+	const CrMemoryMappedFile& GetMappedFile() const { return m_mappedFile; }
+
+	static uint32_t GetIndexSize(crgfx::DataFormat::T indexFormat);
+
+	crstl::vector<CrModelMaterialData> materials;
+
+	crstl::vector<CrModelMeshData> meshes;
+
+private:
+
+	crstl::vector<uint8_t*> m_allocations;
+
+	crgfx::IDevice* m_uploadDevice = nullptr;
+
+	crstl::vector<crgfx::UploadMemory> m_uploadMemory;
+
+	CrMutex m_allocationMutex;
+
+	CrMemoryMappedFile m_mappedFile;
+};
@@ -1,19 +1,11 @@
 #include "Resource/CrResource_pch.h"
 
 #include "CrModelDecoderASSIMP.h"
+#include "CrModelData.h"
 
 #include "Core/FileSystem/CrFixedPath.h"
 #include "Core/CrMacros.h"
 
-#include "Graphics/IGraphicsSystem.h"
-#include "Graphics/IDevice.h"
-#include "Graphics/ITexture.h"
-#include "Graphics/GPUBuffer.h"
-#include "Graphics/CrMaterial.h"
-#include "Graphics/CrMaterialCompiler.h"
-#include "Graphics/CrRenderModel.h"
-#include "Graphics/CrRenderMesh.h"
-#include "Graphics/CrImage.h"
 #include "Graphics/CrCommonVertexLayouts.h"
 
 #include "crstl/filesystem.h"
@@ -46,7 +38,11 @@ static Textures::T GetTextureSemantic(aiTextureType textureType)
 	}
 }
 
-static void ProcessNode(const aiScene* scene, const aiNode* parentNode, const aiMatrix4x4& cumulativeTransform, CrRenderModelDescriptor& modelDescriptor)
+static void ProcessNode
+(
+	const aiScene* scene, const aiNode* parentNode, const aiMatrix4x4& cumulativeTransform,
+	const CrVertexQuantizationSettings& quantizationSettings, CrModelData& modelData
+)
 {
 	for (uint32_t c = 0; c < parentNode->mNumChildren; ++c)
 	{
@@ -57,15 +53,26 @@ static void ProcessNode(const aiScene* scene, const aiNode* parentNode, const ai
 		for (uint32_t m = 0; m < childNode->mNumMeshes; ++m)
 		{
 			const aiMesh* mesh = scene->mMeshes[childNode->mMeshes[m]];
-			CrRenderMeshHandle renderMesh = CrModelDecoderASSIMP::LoadMesh(scene, mesh, childTransform);
-			modelDescriptor.AddRenderMesh(renderMesh, (uint8_t)mesh->mMaterialIndex);
+			CrModelMeshData meshData;
+			CrModelDecoderASSIMP::LoadMesh(scene, mesh, childTransform, quantizationSettings, modelData, meshData);
+			meshData.materialIndex = mesh->mMaterialIndex;
+			modelData.meshes.push_back(meshData);
 		}
 
-		ProcessNode(scene, childNode, childTransform, modelDescriptor);
+		ProcessNode(scene, childNode, childTransform, quantizationSettings, modelData);
 	}
 }
 
-CrRenderModelHandle CrModelDecoderASSIMP::Decode(const crstl::file& file)
+static const aiTextureType TextureTypes[] =
+{
+	aiTextureType_DIFFUSE,
+	aiTextureType_NORMALS,
+	aiTextureType_SPECULAR,
+	aiTextureType_EMISSIVE,
+	aiTextureType_DISPLACEMENT,
+};
+
+bool CrModelDecoderASSIMP::Decode(const crstl::file& file, CrModelData& modelData)
 {
 	// Read the raw data:
 	uint64_t fileSize = file.get_size();
@@ -73,7 +80,7 @@ CrRenderModelHandle CrModelDecoderASSIMP::Decode(const crstl::file& file)
 	if (file.read(fileRawData, fileSize) != fileSize)
 	{
 		free(fileRawData);
-		return nullptr;
+		return false;
 	}
 
 	//bool bakeTransforms = true;
@@ -85,31 +92,30 @@ CrRenderModelHandle CrModelDecoderASSIMP::Decode(const crstl::file& file)
 	free(fileRawData); // We are done with the raw data.
 	if (!scene)
 	{
-		return nullptr;
+		return false;
 	}
 
-	CrRenderModelDescriptor modelDescriptor;
-
-	ProcessNode(scene, scene->mRootNode, scene->mRootNode->mTransformation, modelDescriptor);
+	ProcessNode(scene, scene->mRootNode, scene->mRootNode->mTransformation, m_quantizationSettings, modelData);
 
-	// Load all materials contained in the mesh. The loading of materials will trigger loading of associated resources too
-	// TODO Rework this with path_view
-	const CrFixedPath filePath = file.get_path().c_str();
+	modelData.materials.resize(scene->mNumMaterials);
 
 	for (size_t m = 0; m < scene->mNumMaterials; ++m)
 	{
-		CrMaterialHandle material = LoadMaterial(scene->mMaterials[m], filePath);
-		modelDescriptor.AddMaterial(material);
+		LoadMaterial(scene->mMaterials[m], modelData.materials[m]);
 	}
 
-	importer.FreeScene();
-
-	return CrRenderModelHandle(new CrRenderModel(modelDescriptor));
+	return true;
 }
 
-CrRenderMeshHandle CrModelDecoderASSIMP::LoadMesh(const aiScene* scene, const aiMesh* mesh, const aiMatrix4x4& transform)
+void CrModelDecoderASSIMP::LoadMesh
+(
+	const aiScene* scene, const aiMesh* mesh, const aiMatrix4x4& transform,
+	const CrVertexQuantizationSettings& quantizationSettings, CrModelData& modelData, CrModelMeshData& meshData
+)
 {
-	CrRenderMeshHandle renderMesh = CrRenderMeshHandle(new CrRenderMesh());
+	meshData.vertexCount = mesh->mNumVertices;
+	meshData.indexCount = mesh->mNumFaces * 3;
+	meshData.indexFormat = meshData.vertexCount > 0xffff ? crgfx::DataFormat::R32_Uint : crgfx::DataFormat::R16_Uint;
 
 	bool hasTextureCoords      = mesh->HasTextureCoords(0);
 	bool hasNormals            = mesh->HasNormals();
@@ -120,27 +126,17 @@ CrRenderMeshHandle CrModelDecoderASSIMP::LoadMesh(const aiScene* scene, const ai
 	aiColor4D materialColor(1.0f, 1.0f, 1.0f, 1.0f);
 	aiGetMaterialColor(material, AI_MATKEY_COLOR_DIFFUSE, &materialColor);
 
-	const crgfx::DeviceHandle& renderDevice = crgfx::GetDevice();
-
-	crgfx::VertexBufferHandle positionBuffer   = renderDevice->CreateVertexBuffer(crgfx::MemoryAccess::GPUOnlyRead, PositionVertexDescriptor, (uint32_t)mesh->mNumVertices);
-	crgfx::VertexBufferHandle additionalBuffer = renderDevice->CreateVertexBuffer(crgfx::MemoryAccess::GPUOnlyRead, AdditionalVertexDescriptor, (uint32_t)mesh->mNumVertices);
-
-	float3 minVertex = float3( FLT_MAX);
-	float3 maxVertex = float3(-FLT_MAX);
-
 	aiMatrix4x4 inverseTransform = transform;
 	inverseTransform.Inverse().Transpose();
 
-	ComplexVertexPosition* positionBufferData = (ComplexVertexPosition*)renderDevice->BeginBufferUpload(positionBuffer->GetHardwareBuffer());
-	ComplexVertexAdditional* additionalBufferData = (ComplexVertexAdditional*)renderDevice->BeginBufferUpload(additionalBuffer->GetHardwareBuffer());
+	crstl::vector<aiVector3D> positions;
+	positions.resize_uninitialized(meshData.vertexCount);
+
+	ComplexVertexAdditional* additionalBufferData = modelData.AllocateStream<ComplexVertexAdditional>(meshData.vertexCount);
 	{
 		for (size_t vertexIndex = 0; vertexIndex < mesh->mNumVertices; ++vertexIndex)
 		{
-			const aiVector3D& vertex = transform * mesh->mVertices[vertexIndex];
-			positionBufferData[vertexIndex].position = { (half)vertex.x, (half)vertex.y, (half)vertex.z };
-
-			minVertex = min(minVertex, float3(vertex.x, vertex.y, vertex.z));
-			maxVertex = max(maxVertex, float3(vertex.x, vertex.y, vertex.z));
+			positions[vertexIndex] = transform * mesh->mVertices[vertexIndex];
 
 			// Normals
 			if (hasNormals)
@@ -201,83 +197,71 @@ CrRenderMeshHandle CrModelDecoderASSIMP::LoadMesh(const aiScene* scene, const ai
 			}
 		}
 	}
-	renderDevice->EndBufferUpload(positionBuffer->GetHardwareBuffer());
-	renderDevice->EndBufferUpload(additionalBuffer->GetHardwareBuffer());
 
-	renderMesh->AddVertexBuffer(positionBuffer);
-	renderMesh->AddVertexBuffer(additionalBuffer);
+	modelData.BuildPositions(meshData, (const float*)positions.data(), sizeof(aiVector3D), quantizationSettings);
+	meshData.additionalVertices = additionalBufferData;
 
-	renderMesh->SetBoundingBox(CrBoundingBox((maxVertex + minVertex) * 0.5f, (maxVertex - minVertex) * 0.5f));
+	// The streams can be in upload memory, so anything computed from the indices uses this copy
+	crstl::vector<uint32_t> indices;
+	indices.resize_uninitialized(meshData.indexCount);
 
-	crgfx::IndexBufferHandle indexBuffer = renderDevice->CreateIndexBuffer(crgfx::MemoryAccess::GPUOnlyRead, crgfx::DataFormat::R16_Uint, (uint32_t)mesh->mNumFaces * 3);
-
-	size_t index = 0;
-	uint16_t* indexData = (uint16_t*)renderDevice->BeginBufferUpload(indexBuffer->GetHardwareBuffer());
+	for (size_t j = 0; j < mesh->mNumFaces; ++j)
 	{
-		for (size_t j = 0; j < mesh->mNumFaces; ++j)
+		const aiFace& triangle = mesh->mFaces[j];
+
+		for (int k = 0; k < 3; ++k)
 		{
-			const aiFace& triangle = mesh->mFaces[j];
+			indices[j * 3 + k] = triangle.mIndices[k];
+		}
+	}
 
-			for (int k = 0; k < 3; ++k)
-			{
-				indexData[index++] = (uint16_t)(triangle.mIndices[k]);
-			}
+	if (meshData.indexFormat == crgfx::DataFormat::R16_Uint)
+	{
+		uint16_t* indexData = modelData.AllocateStream<uint16_t>(meshData.indexCount);
+
+		for (size_t index = 0; index < indices.size(); ++index)
+		{
+			indexData[index] = (uint16_t)indices[index];
 		}
+
+		meshData.indices = (const uint8_t*)indexData;
+	}
+	else
+	{
+		uint32_t* indexData = modelData.AllocateStream<uint32_t>(meshData.indexCount);
+		memcpy(indexData, indices.data(), indices.size() * sizeof(uint32_t));
+		meshData.indices = (const uint8_t*)indexData;
 	}
-	renderDevice->EndBufferUpload(indexBuffer->GetHardwareBuffer());
 
-	renderMesh->SetIndexBuffer(indexBuffer);
+	if (hasTextureCoords)
+	{
+		meshData.uvDensity = CrModelData::ComputeUVDensity
+		(
+			(const float*)positions.data(), sizeof(aiVector3D), (const float*)mesh->mTextureCoords[0], sizeof(aiVector3D),
+			indices.data(), meshData.vertexCount, meshData.indexCount
+		);
+	}
 
-	return renderMesh;
+	modelData.BuildMeshlets(meshData, (const float*)positions.data(), sizeof(aiVector3D), indices.data());
 }
 
-CrMaterialHandle CrModelDecoderASSIMP::LoadMaterial(const aiMaterial* aiMaterial, const CrFixedPath& materialPath)
+void CrModelDecoderASSIMP::LoadMaterial(const aiMaterial* aiMaterial, CrModelMaterialData& materialData)
 {
-	CrMaterialDescriptor materialDescriptor;
-	CrMaterialHandle material = MaterialCompiler->CompileMaterial(materialDescriptor);
-
 	aiString name;
 	aiMaterial->Get(AI_MATKEY_NAME, name);
 
-	aiTextureType textureTypes[] =
-	{
-		aiTextureType_DIFFUSE,
-		aiTextureType_NORMALS,
-		aiTextureType_SPECULAR,
-		aiTextureType_EMISSIVE,
-		aiTextureType_DISPLACEMENT,
-	};
-
 	aiString aiTexturePath; // Path is relative to location of imported asset
 
-	for (aiTextureType textureType : textureTypes)
+	for (aiTextureType textureType : TextureTypes)
 	{
 		for (uint32_t t = 0; t < aiMaterial->GetTextureCount(textureType); ++t)
 		{
 			aiMaterial->GetTexture(textureType, 0, &aiTexturePath);
 
-			CrFixedPath imagePath = materialPath.parent_path() / aiTexturePath.C_Str();
-			CrImageHandle image = CrResourceManager::LoadImageFromDisk(imagePath);
-
-			crgfx::TextureDescriptor textureDescriptor;
-			textureDescriptor.width = image->GetWidth();
-			textureDescriptor.height = image->GetHeight();
-			textureDescriptor.format = image->GetFormat();
-			textureDescriptor.initialData = image->GetData();
-			textureDescriptor.initialDataSize = image->GetDataSize();
-			textureDescriptor.mipmapCount = image->m_mipmapCount;
-			textureDescriptor.usage = crgfx::TextureUsage::Default;
-
-			crgfx::TextureHandle texture = crgfx::GetDevice()->CreateTexture(textureDescriptor);
-
-			if (!texture)
-			{
-				CrAssertMsg(false, "Texture not loaded");
-			}
-
-			material->AddTexture(texture, GetTextureSemantic(textureType));
+			CrModelTextureData textureData;
+			textureData.semantic = GetTextureSemantic(textureType);
+			textureData.path = aiTexturePath.C_Str();
+			materialData.textures.push_back(textureData);
 		}
 	}
-
-	return material;
 }
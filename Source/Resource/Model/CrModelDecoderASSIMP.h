@@ -4,6 +4,7 @@
 
 #include "Graphics/CrGraphicsForwardDeclarations.h"
 
+
 struct aiScene;
 struct aiMesh;
 struct aiMaterial;
@@ -14,9 +15,13 @@ class CrModelDecoderASSIMP final : public ICrModelDecoder
 {
 public:
 
-	virtual CrRenderModelHandle Decode(const crstl::file& file) override;
+	virtual bool Decode(const crstl::file& file, CrModelData& modelData) override;
 
-	static CrRenderMeshHandle LoadMesh(const aiScene* scene, const aiMesh* mesh, const aiMatrix4x4& transform);
+	static void LoadMesh
+	(
+		const aiScene* scene, const aiMesh* mesh, const aiMatrix4x4& transform,
+		const CrVertexQuantizationSettings& quantizationSettings, CrModelData& modelData, CrModelMeshData& meshData
+	);
 
-	static CrMaterialHandle LoadMaterial(const aiMaterial* material, const CrFixedPath& relativePath);
+	static void LoadMaterial(const aiMaterial* material, CrModelMaterialData& materialData);
 };
\ No newline at end of file
@@ -1,26 +1,19 @@
 #include "Resource/CrResource_pch.h"
 
 #include "CrModelDecoderCGLTF.h"
+#include "CrModelData.h"
 
-#include "Graphics/IGraphicsSystem.h"
-#include "Graphics/IDevice.h"
-#include "Graphics/CrMaterialCompiler.h"
-#include "Graphics/CrMaterial.h"
-#include "Graphics/CrRenderModel.h"
-#include "Graphics/CrRenderMesh.h"
-#include "Graphics/ITexture.h"
-#include "Graphics/CrImage.h"
 #include "Graphics/CrCommonVertexLayouts.h"
-#include "Graphics/CrGraphicsForwardDeclarations.h"
-#include "Graphics/GPUBuffer.h"
 
 #include "GeneratedShaders/ShaderMetadata.h"
 
 #include "Core/FileSystem/CrFixedPath.h"
 #include "Core/Logging/ICrDebug.h"
+#include "Core/Threading/CrThreadPool.h"
 
 #include "crstl/open_hashmap.h"
 #include "crstl/filesystem.h"
+#include "crstl/unique_ptr.h"
 
 #define CGLTF_IMPLEMENTATION
 #include "cgltf.h"
@@ -58,18 +51,19 @@ void LoadAttribute(crstl::vector<T>& targetBuffer, const unsigned char* sourceBu
 	}
 }
 
-CrRenderMeshHandle LoadMesh(const cgltf_primitive& gltfPrimitive)
+// Only reads the parsed data, so primitives can be loaded in parallel
+static void LoadMesh(const cgltf_primitive& gltfPrimitive, const CrVertexQuantizationSettings& quantizationSettings, CrModelData& modelData, CrModelMeshData& meshData)
 {
-	CrRenderMeshHandle mesh = CrRenderMeshHandle(new CrRenderMesh());
+	// Indices as 32 bits for everything computed from them, since the index stream can be in upload memory
+	crstl::vector<uint32_t> indices;
 
 	// Index data
 	if (gltfPrimitive.indices != nullptr)
 	{
 		const cgltf_accessor* gltfIndexAccessor = gltfPrimitive.indices;
 	
-		// Create the buffer
-		crgfx::DataFormat::T format = ToDataFormat(gltfIndexAccessor->component_type);
-		crgfx::IndexBufferHandle indexBuffer = crgfx::GetDevice()->CreateIndexBuffer(crgfx::MemoryAccess::CPUStreamToGPU, format, (uint32_t)gltfIndexAccessor->count);
+		meshData.indexFormat = ToDataFormat(gltfIndexAccessor->component_type);
+		meshData.indexCount = (uint32_t)gltfIndexAccessor->count;
 
 		// Use the buffer view to copy the data
 		const cgltf_buffer_view* gltfBufferView = gltfIndexAccessor->buffer_view;
@@ -77,11 +71,19 @@ CrRenderMeshHandle LoadMesh(const cgltf_primitive& gltfPrimitive)
 		data = data + (gltfIndexAccessor->offset + gltfBufferView->offset);
 	
 		CrAssertMsg(gltfBufferView->stride == 0, "Invalid stride");
-		void* indexData = indexBuffer->Lock();
-		memcpy(indexData, data, gltfBufferView->size);
-		indexBuffer->Unlock();
-	
-		mesh->SetIndexBuffer(indexBuffer);
+		uint32_t indexSize = CrModelData::GetIndexSize(meshData.indexFormat);
+		uint64_t indexDataSize = meshData.indexCount * indexSize;
+		uint8_t* indexData = modelData.AllocateStreamBytes(indexDataSize);
+		memcpy(indexData, data, indexDataSize);
+
+		meshData.indices = indexData;
+
+		indices.resize_uninitialized(meshData.indexCount);
+
+		for (uint32_t i = 0; i < meshData.indexCount; ++i)
+		{
+			indices[i] = indexSize == 1 ? data[i] : indexSize == 2 ? ((const uint16_t*)data)[i] : ((const uint32_t*)data)[i];
+		}
 	}
 	
 	// Vertex data
@@ -142,27 +144,12 @@ CrRenderMeshHandle LoadMesh(const cgltf_primitive& gltfPrimitive)
 		bool hasTextureCoords = !texCoords.empty();
 		bool hasColor = !colors.empty();
 
-		float3 minVertex = float3(FLT_MAX);
-		float3 maxVertex = float3(-FLT_MAX);
+		meshData.vertexCount = (uint32_t)positions.size();
 
-		// Create the vertex buffer
-		crgfx::VertexBufferHandle positionBuffer = crgfx::GetDevice()->CreateVertexBuffer(crgfx::MemoryAccess::CPUStreamToGPU, PositionVertexDescriptor, (uint32_t)positions.size());
-		crgfx::VertexBufferHandle additionalBuffer = crgfx::GetDevice()->CreateVertexBuffer(crgfx::MemoryAccess::CPUStreamToGPU, AdditionalVertexDescriptor, (uint32_t)positions.size());
-
-		ComplexVertexPosition* positionBufferData = (ComplexVertexPosition*)positionBuffer->Lock();
-		ComplexVertexAdditional* additionalBufferData = (ComplexVertexAdditional*)additionalBuffer->Lock();
+		ComplexVertexAdditional* additionalBufferData = modelData.AllocateStream<ComplexVertexAdditional>(meshData.vertexCount);
 		{
 			for (size_t vertexIndex = 0; vertexIndex < positions.size(); ++vertexIndex)
 			{
-				if (hasPositions)
-				{
-					const GLTFFloat3& position = positions[vertexIndex];
-					positionBufferData[vertexIndex].position = { (half)position.x, (half)position.y, (half)position.z };
-
-					minVertex = min(minVertex, float3(position.x, position.y, position.z));
-					maxVertex = max(maxVertex, float3(position.x, position.y, position.z));
-				}
-
 				if (hasNormals)
 				{
 					const GLTFFloat3& normal = normals[vertexIndex];
@@ -209,16 +196,30 @@ CrRenderMeshHandle LoadMesh(const cgltf_primitive& gltfPrimitive)
 				}
 			}
 		}
-		positionBuffer->Unlock();
-		additionalBuffer->Unlock();
 
-		mesh->AddVertexBuffer(positionBuffer);
-		mesh->AddVertexBuffer(additionalBuffer);
+		meshData.additionalVertices = additionalBufferData;
 
-		mesh->SetBoundingBox(CrBoundingBox((maxVertex + minVertex) * 0.5f, (maxVertex - minVertex) * 0.5f));
-	}
+		if (hasPositions)
+		{
+			const float* positionData = (const float*)positions.data();
+			const uint32_t* indexData = indices.empty() ? nullptr : indices.data();
+
+			modelData.BuildPositions(meshData, positionData, sizeof(GLTFFloat3), quantizationSettings);
+
+			if (hasTextureCoords)
+			{
+				meshData.uvDensity = CrModelData::ComputeUVDensity
+				(
+					positionData, sizeof(GLTFFloat3), (const float*)texCoords.data(), sizeof(GLTFFloat2), indexData, meshData.vertexCount, meshData.indexCount
+				);
+			}
 
-	return mesh;
+			if (indexData)
+			{
+				modelData.BuildMeshlets(meshData, positionData, sizeof(GLTFFloat3), indexData);
+			}
+		}
+	}
 }
 
 struct CgltfUserData
@@ -281,8 +282,20 @@ static void cgltfFileRelease(const struct cgltf_memory_options* memory_options,
 	memfree(memory_options->user_data, data);
 }
 
-CrRenderModelHandle CrModelDecoderCGLTF::Decode(const crstl::file& file)
+static void AddMaterialTexture(CrModelMaterialData& materialData, const cgltf_texture* gltfTexture, Textures::T semantic)
+{
+	if (gltfTexture && gltfTexture->image)
+	{
+		CrModelTextureData textureData;
+		textureData.semantic = semantic;
+		textureData.path = gltfTexture->image->uri;
+		materialData.textures.push_back(textureData);
+	}
+}
+
+bool CrModelDecoderCGLTF::Decode(const crstl::file& file, CrModelData& modelData)
 {
+	// The parsed data points into the file data, so both need to live until we're done
 	uint64_t fileSize = file.get_size();
 	crstl::unique_ptr<uint8_t[]> fileData = crstl::unique_ptr<uint8_t[]>(new uint8_t[fileSize]);
 	file.read(fileData.get(), fileSize);
@@ -297,101 +310,82 @@ CrRenderModelHandle CrModelDecoderCGLTF::Decode(const crstl::file& file)
 
 	cgltf_data* gltfData = nullptr;
 	cgltf_result gltfResult = cgltf_parse(&gltfOptions, fileData.get(), fileSize, &gltfData);
-	if (gltfResult == cgltf_result_success)
-	{
-		gltfResult = cgltf_load_buffers(&gltfOptions, gltfData, "");
-
-		CrRenderModelDescriptor modelDescriptor;
 
-		crstl::open_hashmap<void*, crgfx::TextureHandle> textureMap;
+	if (gltfResult != cgltf_result_success)
+	{
+		return false;
+	}
 
-		for (uint32_t t = 0; t < gltfData->textures_count; ++t)
-		{
-			const cgltf_texture& gltfTexture = gltfData->textures[t];
+	gltfResult = cgltf_load_buffers(&gltfOptions, gltfData, "");
 
-			CrFixedPath imagePath = userData.parentPath / gltfTexture.image->uri;
+	if (gltfResult != cgltf_result_success)
+	{
+		cgltf_free(gltfData);
+		return false;
+	}
 
-			CrImageHandle image = CrResourceManager::LoadImageFromDisk(imagePath);
+	crstl::open_hashmap<void*, uint32_t> materialMap;
 
-			crgfx::TextureDescriptor textureDescriptor;
-			textureDescriptor.width = image->GetWidth();
-			textureDescriptor.height = image->GetHeight();
-			textureDescriptor.format = image->GetFormat();
-			textureDescriptor.initialData = image->GetData();
-			textureDescriptor.initialDataSize = image->GetDataSize();
-			textureDescriptor.mipmapCount = image->m_mipmapCount;
-			textureDescriptor.usage = crgfx::TextureUsage::Default;
+	// Store materials in table so meshes can index into them
+	modelData.materials.resize(gltfData->materials_count);
 
-			crgfx::TextureHandle texture = crgfx::GetDevice()->CreateTexture(textureDescriptor);
+	for (uint32_t m = 0; m < gltfData->materials_count; ++m)
+	{
+		const cgltf_material& cgltfMaterial = gltfData->materials[m];
+		CrModelMaterialData& materialData = modelData.materials[m];
 
-			if (!texture)
-			{
-				CrAssertMsg(false, "Texture not loaded");
-			}
+		AddMaterialTexture(materialData, cgltfMaterial.pbr_metallic_roughness.base_color_texture.texture, Textures::DiffuseTexture0);
+		AddMaterialTexture(materialData, cgltfMaterial.pbr_metallic_roughness.metallic_roughness_texture.texture, Textures::SpecularTexture0);
+		AddMaterialTexture(materialData, cgltfMaterial.normal_texture.texture, Textures::NormalTexture0);
 
-			textureMap.insert(&gltfData->textures[t], texture);
-		}
+		materialMap.insert(&gltfData->materials[m], m);
+	}
 
-		const auto ProcessMaterialTexture = [&](const CrMaterialHandle& material, void* cgltfKey, Textures::T semantic)
-		{
-			const auto textureIter = textureMap.find(cgltfKey);
-			if (textureIter != textureMap.end())
-			{
-				const crgfx::TextureHandle& texture = textureIter->second;
-				material->AddTexture(texture, semantic);
-			}
-		};
+	// Gather the primitives first so that meshes come out in the same order regardless of when each one finishes loading
+	crstl::vector<const cgltf_primitive*> gltfPrimitives;
 
-		crstl::open_hashmap<void*, uint32_t> materialMap;
+	for (uint32_t m = 0; m < gltfData->meshes_count; ++m)
+	{
+		const cgltf_mesh& gltfMesh = gltfData->meshes[m];
 
-		// Load materials. Store materials in table to meshes can index into them
-		for (uint32_t m = 0; m < gltfData->materials_count; ++m)
+		for (uint32_t p = 0; p < gltfMesh.primitives_count; ++p)
 		{
-			const cgltf_material& cgltfMaterial = gltfData->materials[m];
-			CrMaterialDescriptor materialDescriptor;
-			CrMaterialHandle material = MaterialCompiler->CompileMaterial(materialDescriptor);
-
-			ProcessMaterialTexture(material, cgltfMaterial.pbr_metallic_roughness.base_color_texture.texture, Textures::DiffuseTexture0);
-			ProcessMaterialTexture(material, cgltfMaterial.pbr_metallic_roughness.metallic_roughness_texture.texture, Textures::SpecularTexture0);
-			ProcessMaterialTexture(material, cgltfMaterial.normal_texture.texture, Textures::NormalTexture0);
-			//ProcessMaterialTexture(material, cgltfMaterial.pbr_metallic_roughness.base_color_texture.texture, Textures::DiffuseTexture0);
-			//ProcessMaterialTexture(material, cgltfMaterial.pbr_metallic_roughness.base_color_texture.texture, Textures::DiffuseTexture0);
-
-			modelDescriptor.AddMaterial(material);
-
-			materialMap.insert(&gltfData->materials[m], m);
+			gltfPrimitives.push_back(&gltfMesh.primitives[p]);
 		}
+	}
 
-		// Create the render model and setup the material. Note that by now, images have been loaded
-		// and textures created within the loader callback
-		for (uint32_t m = 0; m < gltfData->meshes_count; ++m)
-		{
-			const cgltf_mesh& gltfMesh = gltfData->meshes[m];
+	// Each job writes to its own mesh
+	modelData.meshes.resize(gltfPrimitives.size());
 
-			for (uint32_t p = 0; p < gltfMesh.primitives_count; ++p)
-			{
-				const cgltf_primitive& cgltfPrimitive = gltfMesh.primitives[p];
-				CrRenderMeshHandle renderMesh = LoadMesh(cgltfPrimitive);
+	auto LoadMeshJob = [&](uint32_t m)
+	{
+		const cgltf_primitive& cgltfPrimitive = *gltfPrimitives[m];
+		CrModelMeshData& meshData = modelData.meshes[m];
 
-				// Find material
-				const auto materialIndexIter = materialMap.find(cgltfPrimitive.material);
-				uint8_t materialIndex = 0;
+		LoadMesh(cgltfPrimitive, m_quantizationSettings, modelData, meshData);
 
-				if (materialIndexIter != materialMap.end())
-				{
-					materialIndex = (uint8_t)materialIndexIter->second;
-				}
+		// Find material
+		const auto materialIndexIter = materialMap.find(cgltfPrimitive.material);
 
-				modelDescriptor.AddRenderMesh(renderMesh, materialIndex);
-			}
+		if (materialIndexIter != materialMap.end())
+		{
+			meshData.materialIndex = materialIndexIter->second;
 		}
+	};
 
-		cgltf_free(gltfData);
-
-		return CrRenderModelHandle(new CrRenderModel(modelDescriptor));
+	if (m_threadPool)
+	{
+		m_threadPool->ParallelFor((uint32_t)gltfPrimitives.size(), LoadMeshJob);
 	}
 	else
 	{
-		return nullptr;
+		for (uint32_t m = 0; m < gltfPrimitives.size(); ++m)
+		{
+			LoadMeshJob(m);
+		}
 	}
-}
\ No newline at end of file
+
+	cgltf_free(gltfData);
+
+	return true;
+}
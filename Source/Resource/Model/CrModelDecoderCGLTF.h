@@ -1,10 +1,12 @@
 #pragma once
 
 #include "ICrModelDecoder.h"
-#include "Core/CrCoreForwardDeclarations.h"
 
 class CrModelDecoderCGLTF final : public ICrModelDecoder
 {
 public:
-	virtual CrRenderModelHandle Decode(const crstl::file& file) override;
+
+	CrModelDecoderCGLTF(CrThreadPool* threadPool) : ICrModelDecoder(threadPool) {}
+
+	virtual bool Decode(const crstl::file& file, CrModelData& modelData) override;
 };
\ No newline at end of file
@@ -1,15 +1,9 @@
 #include "Resource/CrResource_pch.h"
 
 #include "CrModelDecoderUFBX.h"
+#include "CrModelData.h"
 
-#include "Graphics/IGraphicsSystem.h"
-#include "Graphics/IDevice.h"
-#include "Graphics/CrRenderModel.h"
-#include "Graphics/CrMaterial.h"
-#include "Graphics/CrImage.h"
-#include "Graphics/CrMaterialCompiler.h"
 #include "Graphics/CrCommonVertexLayouts.h"
-#include "Graphics/GPUBuffer.h"
 
 #include "GeneratedShaders/ShaderMetadata.h"
 
@@ -18,6 +12,7 @@
 #include "crstl/vector.h"
 
 #include "Core/Logging/ICrDebug.h"
+#include "Core/Threading/CrThreadPool.h"
 
 warnings_off
 // Make sure to compile the static library with this define as well
@@ -61,6 +56,15 @@ struct CrImportMesh
 	crstl::vector<uint32_t> indices;
 };
 
+static const FBXTextureTranslation TextureTypes[] =
+{
+	{ UFBX_MATERIAL_PBR_BASE_COLOR, UFBX_MATERIAL_FBX_DIFFUSE_COLOR },
+	{ UFBX_MATERIAL_PBR_NORMAL_MAP, UFBX_MATERIAL_FBX_NORMAL_MAP },
+	{ UFBX_MATERIAL_PBR_SPECULAR_COLOR, UFBX_MATERIAL_FBX_SPECULAR_COLOR },
+	{ UFBX_MATERIAL_PBR_EMISSION_COLOR, UFBX_MATERIAL_FBX_EMISSION_COLOR },
+	{ UFBX_MATERIAL_PBR_DISPLACEMENT_MAP, UFBX_MATERIAL_FBX_DISPLACEMENT }
+};
+
 static Textures::T GetTextureSemantic(const FBXTextureTranslation& textureType)
 {
 	switch (textureType.ufbxPbrMap)
@@ -96,9 +100,9 @@ void MikkTSpaceGetPosition(const SMikkTSpaceContext* pContext, float fvPosOut[],
 	CrImportMesh* importMesh = (CrImportMesh*)pContext->m_pUserData;
 	const CrImportTriangle& importTriangle = importMesh->triangles[iFace];
 	const CrImportVertex& importVertex = importMesh->vertices[importTriangle.indices[iVert]];
-	fvPosOut[0] = importVertex.position.x;
-	fvPosOut[1] = importVertex.position.y;
-	fvPosOut[2] = importVertex.position.z;
+	fvPosOut[0] = (float)importVertex.position.x;
+	fvPosOut[1] = (float)importVertex.position.y;
+	fvPosOut[2] = (float)importVertex.position.z;
 }
 
 void MikkTSpaceGetNormal(const SMikkTSpaceContext* pContext, float fvNormOut[], const int iFace, const int iVert)
@@ -137,13 +141,16 @@ void MikkTSpaceSetTSpaceBasic(const SMikkTSpaceContext* pContext, const float fv
 //
 //}
 
-static CrMaterialHandle LoadMaterial(const ufbx_material* ufbxMaterial, const CrFixedPath& materialPath)
+static const ufbx_texture* GetMaterialTexture(const ufbx_material* ufbxMaterial, const FBXTextureTranslation& textureType)
 {
-	(void)materialPath;
+	const ufbx_material_map& pbrMaterialMap = ufbxMaterial->pbr.maps[textureType.ufbxPbrMap];
+	const ufbx_material_map& fbxMaterialMap = ufbxMaterial->fbx.maps[textureType.ufbxPbrMap];
 
-	CrMaterialDescriptor materialDescriptor;
-	CrMaterialHandle material = MaterialCompiler->CompileMaterial(materialDescriptor);
+	return pbrMaterialMap.texture ? pbrMaterialMap.texture : fbxMaterialMap.texture;
+}
 
+static void LoadMaterial(const ufbx_material* ufbxMaterial, CrModelMaterialData& materialData)
+{
 	for (size_t p = 0; p < ufbxMaterial->props.props.count; ++p)
 	{
 		const ufbx_prop& ufbxProp = ufbxMaterial->props.props[p];
@@ -153,54 +160,22 @@ static CrMaterialHandle LoadMaterial(const ufbx_material* ufbxMaterial, const Cr
 		// Colors in the FBX format are assumed to come in as sRGB, so we convert to linear directly
 		if (ufbxPropName.compare("DiffuseColor") == 0)
 		{
-			material->m_color = float4(pow(float3(ufbxProp.value_vec4.x, ufbxProp.value_vec4.y, ufbxProp.value_vec4.z), 2.2f), ufbxProp.value_vec4.w);
+			materialData.color = float4(pow(float3(ufbxProp.value_vec4.x, ufbxProp.value_vec4.y, ufbxProp.value_vec4.z), 2.2f), ufbxProp.value_vec4.w);
 		}
 	}
 
-	crstl::string materialName(ufbxMaterial->name.data, ufbxMaterial->name.length);
-
-	FBXTextureTranslation textureTypes[] =
+	for (const FBXTextureTranslation& textureType : TextureTypes)
 	{
-		{ UFBX_MATERIAL_PBR_BASE_COLOR, UFBX_MATERIAL_FBX_DIFFUSE_COLOR },
-		{ UFBX_MATERIAL_PBR_NORMAL_MAP, UFBX_MATERIAL_FBX_NORMAL_MAP },
-		{ UFBX_MATERIAL_PBR_SPECULAR_COLOR, UFBX_MATERIAL_FBX_SPECULAR_COLOR },
-		{ UFBX_MATERIAL_PBR_EMISSION_COLOR, UFBX_MATERIAL_FBX_EMISSION_COLOR },
-		{ UFBX_MATERIAL_PBR_DISPLACEMENT_MAP, UFBX_MATERIAL_FBX_DISPLACEMENT }
-	};
-
-	for (const FBXTextureTranslation& textureType : textureTypes)
-	{
-		const ufbx_material_map& pbrMaterialMap = ufbxMaterial->pbr.maps[textureType.ufbxPbrMap];
-		const ufbx_material_map& fbxMaterialMap = ufbxMaterial->fbx.maps[textureType.ufbxPbrMap];
-
-		ufbx_texture* availableTexture = pbrMaterialMap.texture ? pbrMaterialMap.texture : fbxMaterialMap.texture;
+		const ufbx_texture* availableTexture = GetMaterialTexture(ufbxMaterial, textureType);
 
 		if (availableTexture)
 		{
-			CrFixedPath imagePath = materialPath.parent_path() / availableTexture->filename.data;
-			CrImageHandle image = CrResourceManager::LoadImageFromDisk(imagePath);
-
-			crgfx::TextureDescriptor textureDescriptor;
-			textureDescriptor.width = image->GetWidth();
-			textureDescriptor.height = image->GetHeight();
-			textureDescriptor.format = image->GetFormat();
-			textureDescriptor.initialData = image->GetData();
-			textureDescriptor.initialDataSize = image->GetDataSize();
-			textureDescriptor.mipmapCount = image->m_mipmapCount;
-			textureDescriptor.usage = crgfx::TextureUsage::Default;
-
-			crgfx::TextureHandle texture = crgfx::GetDevice()->CreateTexture(textureDescriptor);
-
-			if (!texture)
-			{
-				CrAssertMsg(false, "Texture not loaded");
-			}
-
-			material->AddTexture(texture, GetTextureSemantic(textureType));
+			CrModelTextureData textureData;
+			textureData.semantic = GetTextureSemantic(textureType);
+			textureData.path = availableTexture->filename.data;
+			materialData.textures.push_back(textureData);
 		}
 	}
-
-	return material;
 }
 
 static bool IsRightHandedCoordinateSystem(ufbx_coordinate_axes axes)
@@ -224,7 +199,321 @@ static bool IsRightHandedCoordinateSystem(ufbx_coordinate_axes axes)
 	}
 }
 
-CrRenderModelHandle CrModelDecoderUFBX::Decode(const crstl::file& file)
+// Transform in the row vector convention we use everywhere else
+static float4x4 ToFloat4x4(const ufbx_matrix& ufbxMatrix)
+{
+	return float4x4
+	(
+		ufbxMatrix.cols[0].x, ufbxMatrix.cols[0].y, ufbxMatrix.cols[0].z, 0.0f,
+		ufbxMatrix.cols[1].x, ufbxMatrix.cols[1].y, ufbxMatrix.cols[1].z, 0.0f,
+		ufbxMatrix.cols[2].x, ufbxMatrix.cols[2].y, ufbxMatrix.cols[2].z, 0.0f,
+		ufbxMatrix.cols[3].x, ufbxMatrix.cols[3].y, ufbxMatrix.cols[3].z, 1.0f
+	);
+}
+
+template<typename T>
+static void HashVertexAttribute(CrHash& hash, const T& ufbxVertexAttribute)
+{
+	if (ufbxVertexAttribute.exists)
+	{
+		hash << CrHash(ufbxVertexAttribute.values.data, ufbxVertexAttribute.values.count * sizeof(ufbxVertexAttribute.values.data[0]));
+		hash << CrHash(ufbxVertexAttribute.indices.data, ufbxVertexAttribute.indices.count * sizeof(uint32_t));
+	}
+}
+
+// Hash of everything LoadMesh reads from the mesh, so that copies of the same geometry can share a single mesh
+static CrHash ComputeMeshContentHash(const ufbx_mesh* ufbxMesh, const crstl::open_hashmap<const ufbx_material*, uint32_t>& materialMap)
+{
+	uint64_t counts[] = { ufbxMesh->num_vertices, ufbxMesh->num_indices, ufbxMesh->num_faces, ufbxMesh->materials.count };
+
+	CrHash hash(counts, sizeof(counts));
+	hash << CrHash(ufbxMesh->faces.data, ufbxMesh->faces.count * sizeof(ufbx_face));
+
+	HashVertexAttribute(hash, ufbxMesh->vertex_position);
+	HashVertexAttribute(hash, ufbxMesh->vertex_normal);
+	HashVertexAttribute(hash, ufbxMesh->vertex_tangent);
+
+	if (ufbxMesh->vertex_uv.exists)
+	{
+		HashVertexAttribute(hash, ufbxMesh->uv_sets[0].vertex_uv);
+	}
+
+	if (ufbxMesh->vertex_color.exists)
+	{
+		HashVertexAttribute(hash, ufbxMesh->color_sets[0].vertex_color);
+	}
+
+	for (size_t materialIndex = 0; materialIndex < ufbxMesh->materials.count; ++materialIndex)
+	{
+		const ufbx_mesh_material& ufbxMeshMaterial = ufbxMesh->materials.data[materialIndex];
+
+		auto materialIter = materialMap.find(ufbxMeshMaterial.material);
+		uint32_t modelMaterialIndex = materialIter != materialMap.end() ? materialIter->second : 0xffffffff;
+
+		hash << CrHash(modelMaterialIndex);
+		hash << CrHash(ufbxMeshMaterial.face_indices.data, ufbxMeshMaterial.face_indices.count * sizeof(uint32_t));
+	}
+
+	return hash;
+}
+
+// Triangulates the faces of the mesh that use the material, generates tangents if the mesh doesn't have them, removes
+// duplicated vertices and optimizes the result for the vertex cache. Vertices are transformed by meshToModel. Only
+// reads the scene, so meshes can be loaded in parallel
+static void LoadMesh
+(
+	const ufbx_mesh* ufbxMesh, const ufbx_matrix& ufbxMeshToModel, const ufbx_mesh_material* ufbxMeshMaterial, bool needsWindingOrderFlip,
+	const CrVertexQuantizationSettings& quantizationSettings, CrModelData& modelData, CrModelMeshData& meshData
+)
+{
+	bool hasUVs = ufbxMesh->vertex_uv.exists;
+	bool hasNormals = ufbxMesh->vertex_normal.exists;
+	bool hasColors = ufbxMesh->vertex_color.exists;
+	bool hasTangents = ufbxMesh->vertex_tangent.exists;
+
+	// Allocate necessary data. Note that the number of vertices and indices is the same, as we load the mesh
+	// without deduplicating vertices so we can later generate tangents, etc. After the import mesh is loaded
+	// we'll preprocess it appropriately
+	CrImportMesh importMesh;
+	importMesh.vertices.resize_uninitialized(ufbxMeshMaterial->num_triangles * 3);
+	importMesh.triangles.resize_uninitialized(ufbxMeshMaterial->num_triangles);
+	importMesh.indices.resize_uninitialized(ufbxMeshMaterial->num_triangles * 3);
+
+	crstl::array<uint32_t, 128 * 3> tempIndices;
+
+	uint32_t currentVertex = 0;
+	uint32_t currentTriangle = 0;
+
+	// This remapping table allows us to efficiently remap the indices when we change handedness
+	uint32_t vertexIndexRemap[3];
+	vertexIndexRemap[0] = needsWindingOrderFlip ? 1 : 0;
+	vertexIndexRemap[1] = needsWindingOrderFlip ? 0 : 1;
+	vertexIndexRemap[2] = 2;
+
+	// Loop through every face, triangulating if necessary
+	for (size_t faceIndex = 0; faceIndex < ufbxMeshMaterial->num_faces; ++faceIndex)
+	{
+		ufbx_face face = ufbxMesh->faces[ufbxMeshMaterial->face_indices.data[faceIndex]];
+
+		size_t triangleCount = ufbx_triangulate_face(tempIndices.data(), tempIndices.size(), ufbxMesh, face);
+
+		for (uint32_t triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex)
+		{
+			CrImportTriangle& triangle = importMesh.triangles[currentTriangle];
+
+			for (size_t i = 0; i < 3; ++i)
+			{
+				size_t triangleVertexIndex = vertexIndexRemap[i];
+
+				size_t ufbxVertexIndex = tempIndices[triangleIndex * 3 + triangleVertexIndex];
+
+				CrImportVertex importVertex;
+
+				ufbx_vec3 ufbxPosition = ufbx_get_vertex_vec3(&ufbxMesh->vertex_position, ufbxVertexIndex);
+				ufbx_vec3 ufbxTransformedPosition = ufbx_transform_position(&ufbxMeshToModel, ufbxPosition);
+				importVertex.position = float3(ufbxTransformedPosition.x, ufbxTransformedPosition.y, ufbxTransformedPosition.z);
+
+				if (hasNormals)
+				{
+					ufbx_vec3 ufbxNormal = ufbx_get_vertex_vec3(&ufbxMesh->vertex_normal, ufbxVertexIndex);
+					ufbx_vec3 ufbxTransformedNormal = ufbx_transform_direction(&ufbxMeshToModel, ufbxNormal);
+					importVertex.normal = normalize(float3(ufbxTransformedNormal.x, ufbxTransformedNormal.y, ufbxTransformedNormal.z));
+				}
+
+				if (hasTangents)
+				{
+					ufbx_vec3 ufbxTangent = ufbx_get_vertex_vec3(&ufbxMesh->vertex_tangent, ufbxVertexIndex);
+					importVertex.tangent = normalize(float3(ufbxTangent.x, ufbxTangent.y, ufbxTangent.z));
+				}
+
+				if (hasUVs)
+				{
+					ufbx_vec2 ufbxUV = ufbx_get_vertex_vec2(&ufbxMesh->uv_sets[0].vertex_uv, ufbxVertexIndex);
+					importVertex.uv = float2(ufbxUV.x, 1.0f - ufbxUV.y);
+				}
+
+				if (hasColors)
+				{
+					ufbx_vec4 ufbxColor = ufbx_get_vertex_vec4(&ufbxMesh->color_sets[0].vertex_color, ufbxVertexIndex);
+					importVertex.color = float4(ufbxColor.x, ufbxColor.y, ufbxColor.z, ufbxColor.w);
+				}
+
+				importMesh.vertices[currentVertex] = importVertex;
+				triangle.indices[triangleVertexIndex] = currentVertex;
+
+				currentVertex++;
+			}
+
+			currentTriangle++;
+		}
+	}
+
+	CrAssertMsg(currentVertex > 0, "No vertices present");
+	CrAssertMsg(currentTriangle > 0, "No triangles present");
+
+	CrAssertMsg(currentVertex == importMesh.vertices.size(), "Incorrect vertex count");
+	CrAssertMsg(currentTriangle == importMesh.triangles.size(), "Incorrect triangle count");
+
+	// Compute Tangent space if needed
+	if (!hasTangents)
+	{
+		SMikkTSpaceInterface mikkTSpaceInterface;
+		mikkTSpaceInterface.m_getNumFaces = MikkTSpaceGetNumFaces;
+		mikkTSpaceInterface.m_getNumVerticesOfFace = MikkTSpaceGetNumVerticesOfFace;
+		mikkTSpaceInterface.m_getPosition = MikkTSpaceGetPosition;
+		mikkTSpaceInterface.m_getNormal = MikkTSpaceGetNormal;
+		mikkTSpaceInterface.m_getTexCoord = MikkTSpaceGetTexCoord;
+		mikkTSpaceInterface.m_setTSpaceBasic = MikkTSpaceSetTSpaceBasic;
+		mikkTSpaceInterface.m_setTSpace = nullptr;
+
+		SMikkTSpaceContext mikktSpaceContext;
+		mikktSpaceContext.m_pInterface = &mikkTSpaceInterface;
+		mikktSpaceContext.m_pUserData = (void*)&importMesh;
+
+		genTangSpaceDefault(&mikktSpaceContext);
+	}
+
+	// 1. Remove duplicated vertices
+	{
+		crstl::vector<uint32_t> remappingTable;
+		size_t indexCount = importMesh.triangles.size() * 3;
+		size_t unindexedVertexCount = importMesh.vertices.size();
+		remappingTable.resize_uninitialized(indexCount);
+		size_t indexedVertexCount = meshopt_generateVertexRemap(remappingTable.data(), nullptr, indexCount, importMesh.vertices.data(), indexCount, sizeof(CrImportVertex));
+
+		meshopt_remapIndexBuffer(importMesh.indices.data(), nullptr, indexCount, remappingTable.data());
+		meshopt_remapVertexBuffer(importMesh.vertices.data(), importMesh.vertices.data(), unindexedVertexCount, sizeof(CrImportVertex), remappingTable.data());
+
+		CrAssertMsg(importMesh.vertices.size() >= indexedVertexCount, "Vertex buffer remapping failed");
+
+		// Resize vertices to correct size after deduplication
+		importMesh.vertices.resize(indexedVertexCount);
+	}
+
+	// 2. Optimize vertex cache
+
+	meshopt_optimizeVertexCache(importMesh.indices.data(), importMesh.indices.data(), importMesh.indices.size(), importMesh.vertices.size());
+
+	// 3. Convert to the final vertex and index streams
+
+	meshData.vertexCount = (uint32_t)importMesh.vertices.size();
+	meshData.indexCount = (uint32_t)importMesh.indices.size();
+	meshData.indexFormat = meshData.vertexCount > 0xffff ? crgfx::DataFormat::R32_Uint : crgfx::DataFormat::R16_Uint;
+
+	// Positions and texture coordinates are kept as floats for everything computed from them, since the streams can
+	// be in upload memory
+	crstl::vector<float> positions;
+	positions.resize_uninitialized(meshData.vertexCount * 3);
+
+	crstl::vector<float> uvs;
+	uvs.resize(meshData.vertexCount * 2);
+
+	ComplexVertexAdditional* additionalBufferData = modelData.AllocateStream<ComplexVertexAdditional>(meshData.vertexCount);
+	{
+		for (size_t vertexIndex = 0; vertexIndex < importMesh.vertices.size(); ++vertexIndex)
+		{
+			const CrImportVertex& importVertex = importMesh.vertices[vertexIndex];
+
+			positions[vertexIndex * 3 + 0] = (float)importVertex.position.x;
+			positions[vertexIndex * 3 + 1] = (float)importVertex.position.y;
+			positions[vertexIndex * 3 + 2] = (float)importVertex.position.z;
+
+			if (hasNormals)
+			{
+				float3 normal = importVertex.normal * 127.0f;
+				additionalBufferData[vertexIndex].normal =
+				{
+					(int8_t)normal.x,
+					(int8_t)normal.y,
+					(int8_t)normal.z,
+					0
+				};
+			}
+			else
+			{
+				additionalBufferData[vertexIndex].normal = { 0, 127, 0, 0 };
+			}
+
+			if (hasTangents)
+			{
+				float3 tangent = (importVertex.tangent * 0.5f + 0.5f) * 255.0f;
+				additionalBufferData[vertexIndex].tangent =
+				{
+					(uint8_t)tangent.x,
+					(uint8_t)tangent.y,
+					(uint8_t)tangent.z,
+					0
+				};
+			}
+			else
+			{
+				additionalBufferData[vertexIndex].tangent = { 255, 0, 0, 0 };
+			}
+
+			if (hasUVs)
+			{
+				uvs[vertexIndex * 2 + 0] = (float)importVertex.uv.x;
+				uvs[vertexIndex * 2 + 1] = (float)importVertex.uv.y;
+				additionalBufferData[vertexIndex].uv = { (half)importVertex.uv.x, (half)importVertex.uv.y };
+			}
+			else
+			{
+				additionalBufferData[vertexIndex].uv = { 0.0_h, 0.0_h };
+			}
+
+			if (hasColors)
+			{
+				additionalBufferData[vertexIndex].color =
+				{
+					(uint8_t)(importVertex.color.x * 255.0f + 0.5f),
+					(uint8_t)(importVertex.color.y * 255.0f + 0.5f),
+					(uint8_t)(importVertex.color.z * 255.0f + 0.5f),
+					(uint8_t)(importVertex.color.w * 255.0f + 0.5f)
+				};
+			}
+			else
+			{
+				additionalBufferData[vertexIndex].color =
+				{
+					(uint8_t)255.0f,
+					(uint8_t)255.0f,
+					(uint8_t)255.0f,
+					(uint8_t)255.0f
+				};
+			}
+		}
+	}
+
+	modelData.BuildPositions(meshData, positions.data(), sizeof(float) * 3, quantizationSettings);
+	meshData.additionalVertices = additionalBufferData;
+
+	if (meshData.indexFormat == crgfx::DataFormat::R16_Uint)
+	{
+		uint16_t* indexData = modelData.AllocateStream<uint16_t>(meshData.indexCount);
+
+		for (size_t index = 0; index < importMesh.indices.size(); ++index)
+		{
+			indexData[index] = (uint16_t)importMesh.indices[index];
+		}
+
+		meshData.indices = (const uint8_t*)indexData;
+	}
+	else
+	{
+		uint32_t* indexData = modelData.AllocateStream<uint32_t>(meshData.indexCount);
+		memcpy(indexData, importMesh.indices.data(), importMesh.indices.size() * sizeof(uint32_t));
+		meshData.indices = (const uint8_t*)indexData;
+	}
+
+	meshData.uvDensity = CrModelData::ComputeUVDensity
+	(
+		positions.data(), sizeof(float) * 3, uvs.data(), sizeof(float) * 2, importMesh.indices.data(), meshData.vertexCount, meshData.indexCount
+	);
+
+	modelData.BuildMeshlets(meshData, positions.data(), sizeof(float) * 3, importMesh.indices.data());
+}
+
+bool CrModelDecoderUFBX::Decode(const crstl::file& file, CrModelData& modelData)
 {
 	// Read the raw data
 	uint64_t fileSize = file.get_size();
@@ -234,7 +523,7 @@ CrRenderModelHandle CrModelDecoderUFBX::Decode(const crstl::file& file)
 
 	if (file.read(fileRawData.data(), fileSize) != fileSize)
 	{
-		return nullptr;
+		return false;
 	}
 
 	ufbx_load_opts ufbxOptions = {};
@@ -252,310 +541,169 @@ CrRenderModelHandle CrModelDecoderUFBX::Decode(const crstl::file& file)
 
 	if (ufbxError.type != UFBX_ERROR_NONE || !ufbxScene)
 	{
-		return nullptr;
+		return false;
 	}
 
 	bool needsWindingOrderFlip = IsRightHandedCoordinateSystem(ufbxScene->settings.axes);
 
-	CrRenderModelDescriptor modelDescriptor;
-
-	crstl::open_hashmap<ufbx_material*, uint32_t> materialMap;
+	crstl::open_hashmap<const ufbx_material*, uint32_t> materialMap;
 
-	// Load all materials contained in the mesh. The loading of materials will trigger loading of associated resources too
-	// TODO Rework using path_view
-	const CrFixedPath filePath = file.get_path().c_str();
+	modelData.materials.resize(ufbxScene->materials.count);
 
 	for (size_t m = 0; m < ufbxScene->materials.count; ++m)
 	{
 		ufbx_material* ufbxMaterial = ufbxScene->materials[m];
-		CrMaterialHandle material = LoadMaterial(ufbxMaterial, filePath);
-		modelDescriptor.AddMaterial(material);
+		LoadMaterial(ufbxMaterial, modelData.materials[m]);
 		materialMap.insert(ufbxMaterial, (uint32_t)m);
 	}
 
-	crstl::array<uint32_t, 128 * 3> tempIndices;
-
-	for (size_t nodeIndex = 0; nodeIndex < ufbxScene->nodes.count; nodeIndex++)
+	// Group the nodes by the geometry they use. Nodes that share a ufbx mesh, or have meshes with the same contents,
+	// all use the first mesh of their group
+	struct CrUFBXMeshGroup
 	{
-		ufbx_node* ufbxNode = ufbxScene->nodes[nodeIndex];
-
-		ufbx_matrix ufbxNodeToWorld = ufbxNode->node_to_world;
-
-		ufbx_mesh* ufbxMesh = ufbxNode->mesh;
-
-		// TODO This might not be unique per node. Need a map/set that determines whether a mesh
-		// has been created already, if we want internal instancing
-		if (ufbxMesh)
-		{
-			CrAssertMsg(ufbxMesh->instances.count == 1, "Only one instance supported");
-
-			// There is only one material per rendered mesh. Ufbx has a list of indices that use a certain material
-			// so we'll use that to build our meshes
-			for (size_t materialIndex = 0; materialIndex < ufbxMesh->materials.count; ++materialIndex)
-			{
-				ufbx_mesh_material* ufbxMeshMaterial = &ufbxMesh->materials.data[materialIndex];
-
-				if (ufbxMeshMaterial->num_faces == 0)
-				{
-					continue;
-				}
-
-				CrRenderMeshHandle renderMesh = CrRenderMeshHandle(new CrRenderMesh());
+		const ufbx_mesh* ufbxMesh;
 
-				const crgfx::DeviceHandle& renderDevice = crgfx::GetDevice();
-
-				bool hasUVs = ufbxMesh->vertex_uv.exists;
-				bool hasNormals = ufbxMesh->vertex_normal.exists;
-				bool hasColors = ufbxMesh->vertex_color.exists;
-				bool hasTangents = ufbxMesh->vertex_tangent.exists;
-
-				// Allocate necessary data. Note that the number of vertices and indices is the same, as we load the mesh
-				// without deduplicating vertices so we can later generate tangents, etc. After the import mesh is loaded
-				// we'll preprocess it appropriately
-				CrImportMesh importMesh;
-				importMesh.vertices.resize_uninitialized(ufbxMeshMaterial->num_triangles * 3);
-				importMesh.triangles.resize_uninitialized(ufbxMeshMaterial->num_triangles);
-				importMesh.indices.resize_uninitialized(ufbxMeshMaterial->num_triangles * 3);
-
-				uint32_t currentVertex = 0;
-				uint32_t currentTriangle = 0;
-
-				// This remapping table allows us to efficiently remap the indices when we change handedness
-				uint32_t vertexIndexRemap[3];
-				vertexIndexRemap[0] = needsWindingOrderFlip ? 1 : 0;
-				vertexIndexRemap[1] = needsWindingOrderFlip ? 0 : 1;
-				vertexIndexRemap[2] = 2;
-
-				// Loop through every face, triangulating if necessary
-				for (size_t faceIndex = 0; faceIndex < ufbxMeshMaterial->num_faces; ++faceIndex)
-				{
-					ufbx_face face = ufbxMesh->faces[ufbxMeshMaterial->face_indices.data[faceIndex]];
+		crstl::vector<const ufbx_node*> ufbxNodes;
+	};
 
-					size_t triangleCount = ufbx_triangulate_face(tempIndices.data(), tempIndices.size(), ufbxMesh, face);
+	crstl::vector<CrUFBXMeshGroup> meshGroups;
 
-					for (uint32_t triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex)
-					{
-						CrImportTriangle& triangle = importMesh.triangles[currentTriangle];
+	crstl::open_hashmap<const ufbx_mesh*, uint32_t> meshGroupMap;
 
-						for (size_t i = 0; i < 3; ++i)
-						{
-							size_t triangleVertexIndex = vertexIndexRemap[i];
+	crstl::open_hashmap<CrHash, uint32_t> meshContentGroupMap;
 
-							size_t ufbxVertexIndex = tempIndices[triangleIndex * 3 + triangleVertexIndex];
+	for (size_t nodeIndex = 0; nodeIndex < ufbxScene->nodes.count; nodeIndex++)
+	{
+		const ufbx_node* ufbxNode = ufbxScene->nodes[nodeIndex];
 
-							CrImportVertex importVertex;
+		const ufbx_mesh* ufbxMesh = ufbxNode->mesh;
 
-							ufbx_vec3 ufbxPosition = ufbx_get_vertex_vec3(&ufbxMesh->vertex_position, ufbxVertexIndex);
-							ufbx_vec3 ufbxTransformedPosition = ufbx_transform_position(&ufbxNodeToWorld, ufbxPosition);
-							importVertex.position = float3(ufbxTransformedPosition.x, ufbxTransformedPosition.y, ufbxTransformedPosition.z);
+		if (!ufbxMesh)
+		{
+			continue;
+		}
 
-							if (hasNormals)
-							{
-								ufbx_vec3 ufbxNormal = ufbx_get_vertex_vec3(&ufbxMesh->vertex_normal, ufbxVertexIndex);
-								ufbx_vec3 ufbxTransformedNormal = ufbx_transform_direction(&ufbxNodeToWorld, ufbxNormal);
-								importVertex.normal = normalize(float3(ufbxTransformedNormal.x, ufbxTransformedNormal.y, ufbxTransformedNormal.z));
-							}
+		uint32_t meshGroupIndex;
 
-							if (hasTangents)
-							{
-								ufbx_vec3 ufbxTangent = ufbx_get_vertex_vec3(&ufbxMesh->vertex_tangent, ufbxVertexIndex);
-								importVertex.tangent = normalize(float3(ufbxTangent.x, ufbxTangent.y, ufbxTangent.z));
-							}
+		auto meshGroupIter = meshGroupMap.find(ufbxMesh);
 
-							if (hasUVs)
-							{
-								ufbx_vec2 ufbxUV = ufbx_get_vertex_vec2(&ufbxMesh->uv_sets[0].vertex_uv, ufbxVertexIndex);
-								importVertex.uv = float2(ufbxUV.x, 1.0f - ufbxUV.y);
-							}
+		if (meshGroupIter != meshGroupMap.end())
+		{
+			meshGroupIndex = meshGroupIter->second;
+		}
+		else
+		{
+			CrHash contentHash = ComputeMeshContentHash(ufbxMesh, materialMap);
 
-							if (hasColors)
-							{
-								ufbx_vec4 ufbxColor = ufbx_get_vertex_vec4(&ufbxMesh->color_sets[0].vertex_color, ufbxVertexIndex);
-								importVertex.color = float4(ufbxColor.x, ufbxColor.y, ufbxColor.z, ufbxColor.w);
-							}
+			auto meshContentGroupIter = meshContentGroupMap.find(contentHash);
 
-							importMesh.vertices[currentVertex] = importVertex;
-							triangle.indices[triangleVertexIndex] = currentVertex;
+			if (meshContentGroupIter != meshContentGroupMap.end())
+			{
+				meshGroupIndex = meshContentGroupIter->second;
+			}
+			else
+			{
+				meshGroupIndex = (uint32_t)meshGroups.size();
+				CrUFBXMeshGroup& meshGroup = meshGroups.push_back();
+				meshGroup.ufbxMesh = ufbxMesh;
+				meshContentGroupMap.insert(contentHash, meshGroupIndex);
+			}
 
-							currentVertex++;
-						}
+			meshGroupMap.insert(ufbxMesh, meshGroupIndex);
+		}
 
-						currentTriangle++;
-					}
-				}
+		meshGroups[meshGroupIndex].ufbxNodes.push_back(ufbxNode);
+	}
 
-				CrAssertMsg(currentVertex > 0, "No vertices present");
-				CrAssertMsg(currentTriangle > 0, "No triangles present");
+	// Gather the meshes first so that they come out in the same order regardless of when each one finishes loading
+	struct CrUFBXMeshJob
+	{
+		const CrUFBXMeshGroup* meshGroup;
 
-				CrAssertMsg(currentVertex == importMesh.vertices.size(), "Incorrect vertex count");
-				CrAssertMsg(currentTriangle == importMesh.triangles.size(), "Incorrect triangle count");
+		const ufbx_mesh_material* ufbxMeshMaterial;
 
-				// Compute Tangent space if needed
-				if (!hasTangents)
-				{
-					SMikkTSpaceInterface mikkTSpaceInterface;
-					mikkTSpaceInterface.m_getNumFaces = MikkTSpaceGetNumFaces;
-					mikkTSpaceInterface.m_getNumVerticesOfFace = MikkTSpaceGetNumVerticesOfFace;
-					mikkTSpaceInterface.m_getPosition = MikkTSpaceGetPosition;
-					mikkTSpaceInterface.m_getNormal = MikkTSpaceGetNormal;
-					mikkTSpaceInterface.m_getTexCoord = MikkTSpaceGetTexCoord;
-					mikkTSpaceInterface.m_setTSpaceBasic = MikkTSpaceSetTSpaceBasic;
-					mikkTSpaceInterface.m_setTSpace = nullptr;
-
-					SMikkTSpaceContext mikktSpaceContext;
-					mikktSpaceContext.m_pInterface = &mikkTSpaceInterface;
-					mikktSpaceContext.m_pUserData = (void*)&importMesh;
-
-					genTangSpaceDefault(&mikktSpaceContext);
-				}
+		uint32_t materialIndex;
+	};
 
-				// 1. Remove duplicated vertices
-				{
-					crstl::vector<uint32_t> remappingTable;
-					size_t indexCount = importMesh.triangles.size() * 3;
-					size_t unindexedVertexCount = importMesh.vertices.size();
-					remappingTable.resize_uninitialized(indexCount);
-					size_t indexedVertexCount = meshopt_generateVertexRemap(remappingTable.data(), nullptr, indexCount, importMesh.vertices.data(), indexCount, sizeof(CrImportVertex));
+	crstl::vector<CrUFBXMeshJob> meshJobs;
 
-					meshopt_remapIndexBuffer(importMesh.indices.data(), nullptr, indexCount, remappingTable.data());
-					meshopt_remapVertexBuffer(importMesh.vertices.data(), importMesh.vertices.data(), unindexedVertexCount, sizeof(CrImportVertex), remappingTable.data());
+	for (const CrUFBXMeshGroup& meshGroup : meshGroups)
+	{
+		const ufbx_mesh* ufbxMesh = meshGroup.ufbxMesh;
 
-					CrAssertMsg(importMesh.vertices.size() >= indexedVertexCount, "Vertex buffer remapping failed");
+		// There is only one material per rendered mesh. Ufbx has a list of indices that use a certain material
+		// so we'll use that to build our meshes
+		for (size_t materialIndex = 0; materialIndex < ufbxMesh->materials.count; ++materialIndex)
+		{
+			const ufbx_mesh_material* ufbxMeshMaterial = &ufbxMesh->materials.data[materialIndex];
 
-					// Resize vertices to correct size after deduplication
-					importMesh.vertices.resize(indexedVertexCount);
-				}
+			if (ufbxMeshMaterial->num_faces == 0)
+			{
+				continue;
+			}
 
-				// 2. Optimize vertex cache
+			auto materialIter = materialMap.find(ufbxMeshMaterial->material);
 
-				meshopt_optimizeVertexCache(importMesh.indices.data(), importMesh.indices.data(), importMesh.indices.size(), importMesh.vertices.size());
+			if (materialIter == materialMap.end())
+			{
+				CrLog("Material not found");
+				continue;
+			}
 
-				float3 minVertex = float3(FLT_MAX);
-				float3 maxVertex = float3(-FLT_MAX);
+			CrUFBXMeshJob meshJob;
+			meshJob.meshGroup = &meshGroup;
+			meshJob.ufbxMeshMaterial = ufbxMeshMaterial;
+			meshJob.materialIndex = materialIter->second;
+			meshJobs.push_back(meshJob);
+		}
+	}
 
-				crgfx::VertexBufferHandle positionBuffer = renderDevice->CreateVertexBuffer(crgfx::MemoryAccess::GPUOnlyRead, PositionVertexDescriptor, (uint32_t)importMesh.vertices.size());
-				crgfx::VertexBufferHandle additionalBuffer = renderDevice->CreateVertexBuffer(crgfx::MemoryAccess::GPUOnlyRead, AdditionalVertexDescriptor, (uint32_t)importMesh.vertices.size());
+	// Each job writes to its own mesh
+	modelData.meshes.resize(meshJobs.size());
 
-				ComplexVertexPosition* positionBufferData = (ComplexVertexPosition*)renderDevice->BeginBufferUpload(positionBuffer->GetHardwareBuffer());
-				ComplexVertexAdditional* additionalBufferData = (ComplexVertexAdditional*)renderDevice->BeginBufferUpload(additionalBuffer->GetHardwareBuffer());
-				{
-					for (size_t vertexIndex = 0; vertexIndex < importMesh.vertices.size(); ++vertexIndex)
-					{
-						const CrImportVertex& importVertex = importMesh.vertices[vertexIndex];
-
-						minVertex = min(minVertex, importVertex.position);
-						maxVertex = max(maxVertex, importVertex.position);
-
-						positionBufferData[vertexIndex].position = { (half)importVertex.position.x, (half)importVertex.position.y, (half)importVertex.position.z };
-
-						if (hasNormals)
-						{
-							float3 normal = importVertex.normal * 127.0f;
-							additionalBufferData[vertexIndex].normal =
-							{
-								(int8_t)normal.x,
-								(int8_t)normal.y,
-								(int8_t)normal.z,
-								0
-							};
-						}
-						else
-						{
-							additionalBufferData[vertexIndex].normal = { 0, 127, 0, 0 };
-						}
-
-						if (hasTangents)
-						{
-							float3 tangent = (importVertex.tangent * 0.5f + 0.5f) * 255.0f;
-							additionalBufferData[vertexIndex].tangent =
-							{
-								(uint8_t)tangent.x,
-								(uint8_t)tangent.y,
-								(uint8_t)tangent.z,
-								0
-							};
-						}
-						else
-						{
-							additionalBufferData[vertexIndex].tangent = { 255, 0, 0, 0 };
-						}
-
-						if (hasUVs)
-						{
-							additionalBufferData[vertexIndex].uv = { (half)importVertex.uv.x, (half)importVertex.uv.y };
-						}
-						else
-						{
-							additionalBufferData[vertexIndex].uv = { 0.0_h, 0.0_h };
-						}
-
-						if (hasColors)
-						{
-							additionalBufferData[vertexIndex].color =
-							{
-								(uint8_t)(importVertex.color.x * 255.0f + 0.5f),
-								(uint8_t)(importVertex.color.y * 255.0f + 0.5f),
-								(uint8_t)(importVertex.color.z * 255.0f + 0.5f),
-								(uint8_t)(importVertex.color.w * 255.0f + 0.5f)
-							};
-						}
-						else
-						{
-							additionalBufferData[vertexIndex].color =
-							{
-								(uint8_t)255.0f,
-								(uint8_t)255.0f,
-								(uint8_t)255.0f,
-								(uint8_t)255.0f
-							};
-						}
-					}
-				}
-				renderDevice->EndBufferUpload(positionBuffer->GetHardwareBuffer());
-				renderDevice->EndBufferUpload(additionalBuffer->GetHardwareBuffer());
+	auto LoadMeshJob = [&](uint32_t m)
+	{
+		const CrUFBXMeshJob& meshJob = meshJobs[m];
+		const CrUFBXMeshGroup& meshGroup = *meshJob.meshGroup;
+		CrModelMeshData& meshData = modelData.meshes[m];
 
-				renderMesh->AddVertexBuffer(positionBuffer);
-				renderMesh->AddVertexBuffer(additionalBuffer);
+		// A mesh used by a single node is baked into model space. Otherwise it stays in its own space and every node
+		// becomes an instance of it
+		if (meshGroup.ufbxNodes.size() == 1)
+		{
+			LoadMesh(meshGroup.ufbxMesh, meshGroup.ufbxNodes[0]->node_to_world, meshJob.ufbxMeshMaterial, needsWindingOrderFlip, m_quantizationSettings, modelData, meshData);
+		}
+		else
+		{
+			LoadMesh(meshGroup.ufbxMesh, ufbx_identity_matrix, meshJob.ufbxMeshMaterial, needsWindingOrderFlip, m_quantizationSettings, modelData, meshData);
 
-				renderMesh->SetBoundingBox(CrBoundingBox((maxVertex + minVertex) * 0.5f, (maxVertex - minVertex) * 0.5f));
+			float4x4* instanceTransforms = modelData.Allocate<float4x4>(meshGroup.ufbxNodes.size());
 
-				crgfx::IndexBufferHandle indexBuffer = renderDevice->CreateIndexBuffer(crgfx::MemoryAccess::GPUOnlyRead, crgfx::DataFormat::R16_Uint, (uint32_t)importMesh.triangles.size() * 3);
+			for (uint32_t i = 0; i < meshGroup.ufbxNodes.size(); ++i)
+			{
+				instanceTransforms[i] = ToFloat4x4(meshGroup.ufbxNodes[i]->node_to_world);
+			}
 
-				uint16_t* indexData = (uint16_t*)renderDevice->BeginBufferUpload(indexBuffer->GetHardwareBuffer());
-				{
-					//size_t index = 0;
-					//for (size_t triangleIndex = 0; triangleIndex < importMesh.triangles.size(); ++triangleIndex)
-					//{
-					//	const CrImportTriangle& triangle = importMesh.triangles[triangleIndex];
-					//	indexData[index++] = (uint16_t)triangle.indices[0];
-					//	indexData[index++] = (uint16_t)triangle.indices[1];
-					//	indexData[index++] = (uint16_t)triangle.indices[2];
-					//}
-
-					for (size_t vertexIndex = 0; vertexIndex < importMesh.indices.size(); ++vertexIndex)
-					{
-						indexData[vertexIndex] = (uint16_t)importMesh.indices[vertexIndex];
-					}
-				}
-				renderDevice->EndBufferUpload(indexBuffer->GetHardwareBuffer());
+			meshData.instanceTransforms = instanceTransforms;
+			meshData.instanceCount = (uint32_t)meshGroup.ufbxNodes.size();
+		}
 
-				renderMesh->SetIndexBuffer(indexBuffer);
+		meshData.materialIndex = meshJob.materialIndex;
+	};
 
-				ufbx_material* ufbxMaterial = ufbxMeshMaterial->material;
-				
-				auto materialIter = materialMap.find(ufbxMaterial);
-				
-				if (materialIter != materialMap.end())
-				{
-					modelDescriptor.AddRenderMesh(renderMesh, (uint8_t)materialIter->second);
-				}
-				else
-				{
-					CrLog("Material not found");
-				}
-			}
+	if (m_threadPool)
+	{
+		m_threadPool->ParallelFor((uint32_t)meshJobs.size(), LoadMeshJob);
+	}
+	else
+	{
+		for (uint32_t m = 0; m < meshJobs.size(); ++m)
+		{
+			LoadMeshJob(m);
 		}
 	}
 
-	return CrRenderModelHandle(new CrRenderModel(modelDescriptor));
-}
\ No newline at end of file
+	ufbx_free_scene(ufbxScene);
+
+	return true;
+}
@@ -2,11 +2,11 @@
 
 #include "ICrModelDecoder.h"
 
-#include "Graphics/CrGraphicsForwardDeclarations.h"
-
 class CrModelDecoderUFBX final : public ICrModelDecoder
 {
 public:
 
-	virtual CrRenderModelHandle Decode(const crstl::file& file) override;
+	CrModelDecoderUFBX(CrThreadPool* threadPool) : ICrModelDecoder(threadPool) {}
+
+	virtual bool Decode(const crstl::file& file, CrModelData& modelData) override;
 };
\ No newline at end of file
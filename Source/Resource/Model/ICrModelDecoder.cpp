@@ -0,0 +1,24 @@
+#include "Resource/CrResource_pch.h"
+
+#include "ICrModelDecoder.h"
+#include "CrModelDecoderASSIMP.h"
+#include "CrModelDecoderCGLTF.h"
+#include "CrModelDecoderUFBX.h"
+
+crstl::unique_ptr<ICrModelDecoder> ICrModelDecoder::Create(const CrFixedPath& filePath, CrThreadPool* threadPool)
+{
+	CrFixedPath extension = filePath.extension();
+
+	if (extension.comparei(".gltf") == 0 || extension.comparei(".glb") == 0)
+	{
+		return crstl::unique_ptr<ICrModelDecoder>(new CrModelDecoderCGLTF(threadPool));
+	}
+	else if (extension.comparei(".fbx") == 0 || extension.comparei(".obj") == 0)
+	{
+		return crstl::unique_ptr<ICrModelDecoder>(new CrModelDecoderUFBX(threadPool));
+	}
+	else
+	{
+		return crstl::unique_ptr<ICrModelDecoder>(new CrModelDecoderASSIMP());
+	}
+}
@@ -1,13 +1,35 @@
 #pragma once
 
 #include "Core/CrCoreForwardDeclarations.h"
-#include "Resource/CrResourceManager.h"
+#include "Core/FileSystem/CrFixedPath.h"
 
+#include "Resource/Model/CrModelData.h"
+
+#include "crstl/unique_ptr.h"
+
+class CrThreadPool;
+
+// Decodes a source asset into the final vertex and index streams of its meshes and the description of its
+// materials. Decoding runs on loading threads and in the model cooker, so it must not use the graphics device
 class ICrModelDecoder
 {
 public:
 
+	ICrModelDecoder(CrThreadPool* threadPool = nullptr) : m_threadPool(threadPool) {}
+
 	virtual ~ICrModelDecoder() {}
 
-	virtual CrRenderModelHandle Decode(const crstl::file& file) = 0;
-};
\ No newline at end of file
+	virtual bool Decode(const crstl::file& file, CrModelData& modelData) = 0;
+
+	// Creates the decoder for the format of the file. Decoders that support it process their meshes across the
+	// thread pool. The pool must not be the one the calling thread belongs to
+	static crstl::unique_ptr<ICrModelDecoder> Create(const CrFixedPath& filePath, CrThreadPool* threadPool = nullptr);
+
+	void SetQuantizationSettings(const CrVertexQuantizationSettings& quantizationSettings) { m_quantizationSettings = quantizationSettings; }
+
+protected:
+
+	CrThreadPool* m_threadPool;
+
+	CrVertexQuantizationSettings m_quantizationSettings;
+};
@@ -26,13 +26,17 @@ Win64PlatformFilter = "platforms:"..MSVCWin64..' or '..ClangWin64
 
 -- Project Names
 ProjectCorsairEngine    = 'Corsair Engine'
+ProjectHeadless         = 'CrHeadless'
 ProjectMath             = 'CrMath'
 ProjectGraphics         = 'CrGraphics'
 ProjectShaderCompiler   = 'CrShaderCompiler'
+ProjectShaderCompilerLibrary = 'CrShaderCompilerLibrary'
 ProjectShaders          = 'CrShaders'
 ProjectBuiltinShaders   = 'CrBuiltinShaders'
 ProjectResource         = 'CrResource'
+ProjectModelCooker      = 'CrModelCooker'
 ProjectCore             = 'CrCore'
+ProjectHashBenchmark    = 'CrHashBenchmark'
 ProjectEditor           = 'CrEditor'
 ProjectWorld            = 'World'
 
@@ -289,6 +293,15 @@ project (ProjectCorsairEngine)
 	LinkLibrary(XInputLibrary)
 	LinkLibrary(NVAPILibrary)
 
+	-- Shaders are compiled in process where the shader compiler can run
+	filter { Win64PlatformFilter }
+		links { ProjectShaderCompilerLibrary }
+		LinkLibrary(SPIRVReflectLibrary)
+		LinkLibrary(DxcLibrary)
+		LinkLibrary(RapidYAMLLibrary)
+
+	filter {}
+
 	-- Copy necessary files or DLLs
 	postbuildcommands
 	{
@@ -297,6 +310,55 @@ project (ProjectCorsairEngine)
 	
 	filter {}
 
+SourceHeadlessDirectory = SourceDirectory..'/Headless'
+
+-- Runs frames on the Null graphics system without a window or GPU, for continuous integration. It shares the
+-- frame with the main executable, and its window replaces the platform one
+project (ProjectHeadless)
+	kind('ConsoleApp')
+	files
+	{
+		SourceHeadlessDirectory..'/*.cpp',
+		SourceDirectory..'/CrFrame.h', SourceDirectory..'/CrFrame.cpp',
+		SourceDirectory..'/CrEngineInitialization.h', SourceDirectory..'/CrEngineInitialization.cpp',
+		SourceDirectory..'/CrOSWindow.h'
+	}
+
+	links
+	{
+		ProjectCore,
+		ProjectEditor,
+		ProjectGraphics,
+		ProjectResource,
+		ProjectWorld
+	}
+
+	AddLibraryIncludes(AssimpLibrary)
+	LinkLibrary(AssimpLibrary)
+	LinkLibrary(UfbxLibrary)
+	LinkLibrary(MeshOptimizerLibrary)
+	LinkLibrary(MikkTSpaceLibrary)
+	LinkLibrary(StbLibrary)
+	LinkLibrary(WuffsLibrary)
+
+	AddLibraryIncludes(ImguiLibrary)
+	LinkLibrary(ImguiLibrary)
+
+	-- The graphics library contains every backend the platform supports, even if only Null is created. The workspace
+	-- only generates Win64 platforms for now, so there is no configuration for other hosts yet
+	filter { Win64PlatformFilter }
+		LinkLibrary(VulkanLibrary)
+		LinkLibrary(D3D12Library)
+		LinkLibrary(WinPixEventRuntimeLibrary)
+		LinkLibrary(XInputLibrary)
+		LinkLibrary(NVAPILibrary)
+		links { ProjectShaderCompilerLibrary }
+		LinkLibrary(SPIRVReflectLibrary)
+		LinkLibrary(DxcLibrary)
+		LinkLibrary(RapidYAMLLibrary)
+
+	filter {}
+
 group('Graphics')
 
 SourceShaderCompilerDirectory = SourceGraphicsDirectory..'/ShaderCompiler'
@@ -323,6 +385,7 @@ project(ProjectGraphics)
 		SourceGraphicsDirectory..'/FrameCapture/*',
 		SourceGraphicsDirectory..'/RenderWorld/*',
 		SourceGraphicsDirectory..'/Material/*',
+		SourceGraphicsDirectory..'/Null/*',
 
 		-- The files below are autogenerated, but are manually specified so they take part in the build process
 		ShaderMetadataHeader,
@@ -343,6 +406,7 @@ project(ProjectGraphics)
 		files { SourceGraphicsDirectory..'/Vulkan/**' }
 		files { SourceGraphicsDirectory..'/D3D12/**' }
 		files { SourceGraphicsDirectory..'/Extensions/**' }
+		defines { 'CR_SHADER_COMPILER_IN_PROCESS' }
 		AddLibraryIncludes(VulkanLibrary)
 		AddLibraryIncludes(WinPixEventRuntimeLibrary)
 		AddLibraryIncludes(NVAPILibrary)
@@ -436,19 +500,31 @@ project(ProjectBuiltinShaders)
 		
 	filter {}
 
+ShaderCompilerMainFile = SourceShaderCompilerDirectory..'/CrShaderCompilerMain.cpp'
+
+-- The shader compiler is a library so that the runtime can compile shaders without launching a process
+project(ProjectShaderCompilerLibrary)
+	kind('StaticLib')
+	files { SourceShaderCompilerDirectory..'/**' }
+	removefiles { ShaderCompilerMainFile }
+
+	pchheader('Graphics/ShaderCompiler/CrShaderCompiler_pch.h')
+	pchsource(SourceShaderCompilerDirectory..'/CrShaderCompiler_pch.cpp')
+
+	AddLibraryIncludes(SPIRVReflectLibrary)
+	AddLibraryIncludes(DxcLibrary)
+	AddLibraryIncludes(RapidYAMLLibrary)
+
 project(ProjectShaderCompiler)
 	kind('ConsoleApp')
-	files { SourceShaderCompilerDirectory..'/**' }
+	files { ShaderCompilerMainFile, SourceShaderCompilerDirectory..'/CrShaderCompiler_pch.cpp' }
 	
 	pchheader('Graphics/ShaderCompiler/CrShaderCompiler_pch.h')
 	pchsource(SourceShaderCompilerDirectory..'/CrShaderCompiler_pch.cpp')
 	
-	links { ProjectCore }
+	links { ProjectShaderCompilerLibrary, ProjectCore }
 
-	AddLibraryIncludes(SPIRVReflectLibrary)
 	LinkLibrary(SPIRVReflectLibrary)
-	
-	AddLibraryIncludes(DxcLibrary)
 	LinkLibrary(DxcLibrary)
 	
 	AddLibraryIncludes(RapidYAMLLibrary)
@@ -466,6 +542,7 @@ group('Resource')
 SourceResourceDirectory = SourceDirectory..'/Resource'
 SourceImageDirectory = SourceResourceDirectory..'/Image'
 SourceModelDirectory = SourceResourceDirectory..'/Model'
+ModelCookerMainFile = SourceModelDirectory..'/CrModelCookerMain.cpp'
 
 project(ProjectResource)
 	kind('StaticLib')
@@ -476,6 +553,7 @@ project(ProjectResource)
 	{
 		SourceResourceDirectory..'/**'
 	}
+	removefiles { ModelCookerMainFile }
 
 	AddLibraryIncludes(AssimpLibrary)
 	AddLibraryIncludes(CGLTFLibrary)
@@ -485,9 +563,31 @@ project(ProjectResource)
 	AddLibraryIncludes(UfbxLibrary)
 	AddLibraryIncludes(WuffsLibrary)
 
+-- Offline tool that decodes source models and textures and writes them in their final form for the runtime to load
+project(ProjectModelCooker)
+	kind('ConsoleApp')
+	files { ModelCookerMainFile, SourceResourceDirectory..'/CrResource_pch.cpp' }
+
+	pchheader('Resource/CrResource_pch.h')
+	pchsource(SourceResourceDirectory..'/CrResource_pch.cpp')
+	dependson { ProjectShaders }
+
+	links { ProjectResource, ProjectGraphics, ProjectCore }
+
+	AddLibraryIncludes(AssimpLibrary)
+	LinkLibrary(AssimpLibrary)
+	LinkLibrary(UfbxLibrary)
+	LinkLibrary(MeshOptimizerLibrary)
+	LinkLibrary(MikkTSpaceLibrary)
+
+	-- Textures are decoded with the same image decoders as the runtime
+	LinkLibrary(StbLibrary)
+	LinkLibrary(WuffsLibrary)
+
 group('Core')
 
 SourceCoreDirectory = SourceDirectory..'/Core'
+HashBenchmarkMainFile = SourceCoreDirectory..'/CrHashBenchmarkMain.cpp'
 
 project(ProjectCore)
 	kind('StaticLib')
@@ -500,6 +600,7 @@ project(ProjectCore)
 		SourceCoreDirectory..'/**',
 		xxHashLibrary.includeDirs..'/xxhash.h'
 	}
+	removefiles { HashBenchmarkMainFile }
 
 	AddLibraryFiles(CRSTLLibrary)
 	AddLibraryNatvis(CRSTLLibrary)
@@ -517,6 +618,16 @@ project(ProjectCore)
 
 	filter {}
 
+-- Checks CrHash for collisions and avalanche, and benchmarks it against XXH64. Fails if any of the checks fails
+project(ProjectHashBenchmark)
+	kind('ConsoleApp')
+	files { HashBenchmarkMainFile, SourceCoreDirectory..'/CrCore_pch.cpp' }
+
+	pchheader('Core/CrCore_pch.h')
+	pchsource(SourceCoreDirectory..'/CrCore_pch.cpp')
+
+	links { ProjectCore }
+
 project(ProjectMath)
 	kind('StaticLib')
 	files { MathDirectory..'/**' }